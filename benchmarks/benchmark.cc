@@ -27,6 +27,9 @@
 
 #include <string.h>
 
+#include <fstream>
+#include <string>
+
 #include "google/ads/googleads/v13/services/google_ads_service.upbdefs.h"
 #include "google/protobuf/descriptor.pb.h"
 #include "absl/container/flat_hash_set.h"
@@ -34,14 +37,126 @@
 #include "benchmarks/descriptor.pb.h"
 #include "benchmarks/descriptor.upb.h"
 #include "benchmarks/descriptor.upbdefs.h"
+#include "benchmarks/deep_nesting.upb.h"
 #include "benchmarks/descriptor_sv.pb.h"
+#include "benchmarks/extension_heavy.upb.h"
+#include "benchmarks/extension_heavy.upbdefs.h"
+#include "benchmarks/map_heavy.pb.h"
+#include "benchmarks/map_heavy.upb.h"
+#include "benchmarks/string_heavy.pb.h"
+#include "benchmarks/string_heavy.upb.h"
 #include "upb/base/log2.h"
+#include "upb/hash/common.h"
+#include "upb/json/decode.h"
+#include "upb/json/encode.h"
 #include "upb/mem/arena.h"
+#include "upb/message/message.h"
+#include "upb/mini_descriptor/decode.h"
+#include "upb/mini_descriptor/internal/encode.h"
 #include "upb/reflection/def.hpp"
+#include "upb/wire/decode.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 upb_StringView descriptor = benchmarks_descriptor_proto_upbdefinit.descriptor;
 namespace protobuf = ::google::protobuf;
 
+// Measures hardware events across a benchmark loop with perf_event and
+// reports them through the Google Benchmark counter API, so that compare.py
+// can show why a change regressed (cache misses, branch mispredicts) and not
+// just that it did.  Counters that the kernel refuses to open (eg. inside
+// containers without perf access) are silently skipped; on non-Linux
+// platforms the whole class is a no-op.
+class PerfCounters {
+ public:
+  PerfCounters() {
+#ifdef __linux__
+    for (size_t i = 0; i < kNumEvents; i++) {
+      struct perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = kEvents[i].type;
+      attr.config = kEvents[i].config;
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      fds_[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (size_t i = 0; i < kNumEvents; i++) {
+      if (fds_[i] >= 0) close(fds_[i]);
+    }
+#endif
+  }
+
+  void Start() {
+#ifdef __linux__
+    for (size_t i = 0; i < kNumEvents; i++) {
+      if (fds_[i] < 0) continue;
+      ioctl(fds_[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  // Stops counting and reports per-iteration counter values.  If
+  // |bytes_per_iter| is nonzero and the cycle counter is available, also
+  // reports bytes-per-cycle for throughput triage.
+  void Report(benchmark::State& state, size_t bytes_per_iter) {
+#ifdef __linux__
+    uint64_t cycles = 0;
+    for (size_t i = 0; i < kNumEvents; i++) {
+      if (fds_[i] < 0) continue;
+      ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+      uint64_t value = 0;
+      if (read(fds_[i], &value, sizeof(value)) != sizeof(value)) continue;
+      state.counters[kEvents[i].name] = benchmark::Counter(
+          value, benchmark::Counter::kAvgIterations);
+      if (strcmp(kEvents[i].name, "cycles") == 0) cycles = value;
+    }
+    if (bytes_per_iter > 0 && cycles > 0) {
+      state.counters["bytes_per_cycle"] =
+          (double)(bytes_per_iter * state.iterations()) / cycles;
+    }
+#endif
+  }
+
+ private:
+#ifdef __linux__
+  struct Event {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+  };
+  static constexpr Event kEvents[] = {
+      {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+      {"l1d_misses", PERF_TYPE_HW_CACHE,
+       PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+      {"llc_misses", PERF_TYPE_HW_CACHE,
+       PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+  };
+  static constexpr size_t kNumEvents = sizeof(kEvents) / sizeof(kEvents[0]);
+  int fds_[kNumEvents];
+#endif
+};
+
+#ifdef __linux__
+constexpr PerfCounters::Event PerfCounters::kEvents[];
+#endif
+
 // A buffer big enough to parse descriptor.proto without going to heap.
 // We use 64-bit ints here to force alignment.
 int64_t buf[8191];
@@ -121,6 +236,83 @@ static void BM_ArenaFuseBalanced(benchmark::State& state) {
 }
 BENCHMARK(BM_ArenaFuseBalanced)->Range(2, 128);
 
+// Concurrent arena benchmarks.  Unlike the single-threaded BM_ArenaFuse*
+// benchmarks above, these measure the atomics in _upb_Arena_FindRoot() and
+// upb_Arena_Fuse() under cross-thread contention: threads fuse freshly
+// created arenas into one shared root while others allocate from the group
+// and poll its footprint.
+//
+// Arenas fused into the root stay in its group until the root dies, so the
+// iteration count is pinned to bound the group's growth and keep runs
+// comparable.
+
+static void BM_ArenaConcurrentFuse(benchmark::State& state) {
+  static upb_Arena* root = nullptr;
+  if (state.thread_index() == 0) root = upb_Arena_New();
+  size_t n = 0;
+  for (auto _ : state) {
+    upb_Arena* arena = upb_Arena_New();
+    upb_Arena_Fuse(root, arena);
+    upb_Arena_Free(arena);
+    n++;
+  }
+  state.SetItemsProcessed(n);
+  if (state.thread_index() == 0) {
+    upb_Arena_Free(root);
+    root = nullptr;
+  }
+}
+BENCHMARK(BM_ArenaConcurrentFuse)->ThreadRange(1, 8)->Iterations(50000);
+
+// Threads take one of three roles, round-robin by thread index: poll the
+// group's footprint with upb_Arena_SpaceAllocated(), fuse fresh arenas into
+// the shared root, or bump-allocate from an arena already fused into the
+// group.  Run with a multiple of 3 threads for one of each.
+static void BM_ArenaConcurrentFuseAllocPoll(benchmark::State& state) {
+  static upb_Arena* root = nullptr;
+  if (state.thread_index() == 0) root = upb_Arena_New();
+  size_t n = 0;
+  switch (state.thread_index() % 3) {
+    case 0:
+      for (auto _ : state) {
+        benchmark::DoNotOptimize(upb_Arena_SpaceAllocated(root));
+        n++;
+      }
+      break;
+    case 1:
+      for (auto _ : state) {
+        upb_Arena* arena = upb_Arena_New();
+        upb_Arena_Fuse(root, arena);
+        upb_Arena_Free(arena);
+        n++;
+      }
+      break;
+    case 2: {
+      // The arena is created lazily because only code inside the iteration
+      // loop is ordered after thread 0's creation of the root.
+      upb_Arena* arena = nullptr;
+      for (auto _ : state) {
+        if (!arena) {
+          arena = upb_Arena_New();
+          upb_Arena_Fuse(root, arena);
+        }
+        benchmark::DoNotOptimize(upb_Arena_Malloc(arena, 64));
+        n++;
+      }
+      if (arena) upb_Arena_Free(arena);
+      break;
+    }
+  }
+  state.SetItemsProcessed(n);
+  if (state.thread_index() == 0) {
+    upb_Arena_Free(root);
+    root = nullptr;
+  }
+}
+BENCHMARK(BM_ArenaConcurrentFuseAllocPoll)
+    ->DenseThreadRange(3, 9, 3)
+    ->Iterations(5000);
+
 enum LoadDescriptorMode {
   NoLayout,
   WithLayout,
@@ -259,6 +451,8 @@ enum ArenaMode {
 
 template <ArenaMode AMode, CopyStrings Copy>
 static void BM_Parse_Upb_FileDesc(benchmark::State& state) {
+  PerfCounters counters;
+  counters.Start();
   for (auto _ : state) {
     upb_Arena* arena;
     if (AMode == InitBlock) {
@@ -276,6 +470,7 @@ static void BM_Parse_Upb_FileDesc(benchmark::State& state) {
     }
     upb_Arena_Free(arena);
   }
+  counters.Report(state, descriptor.size);
   state.SetBytesProcessed(state.iterations() * descriptor.size);
 }
 BENCHMARK_TEMPLATE(BM_Parse_Upb_FileDesc, UseArena, Copy);
@@ -283,6 +478,217 @@ BENCHMARK_TEMPLATE(BM_Parse_Upb_FileDesc, UseArena, Alias);
 BENCHMARK_TEMPLATE(BM_Parse_Upb_FileDesc, InitBlock, Copy);
 BENCHMARK_TEMPLATE(BM_Parse_Upb_FileDesc, InitBlock, Alias);
 
+// Builds a mini table for a message with a single packed repeated field of
+// the given type, eg. `message M { repeated double d = 1 [packed = true]; }`.
+static const upb_MiniTable* PackedMiniTable(upb_FieldType type,
+                                            upb_Arena* arena) {
+  upb_MtDataEncoder e;
+  char buf[64];
+  char* ptr = buf;
+  e.end = buf + sizeof(buf);
+  ptr = upb_MtDataEncoder_StartMessage(&e, ptr, 0);
+  ptr = upb_MtDataEncoder_PutField(
+      &e, ptr, type, 1,
+      kUpb_FieldModifier_IsRepeated | kUpb_FieldModifier_IsPacked);
+  upb_Status status;
+  upb_Status_Clear(&status);
+  const upb_MiniTable* mt =
+      upb_MiniTable_Build(buf, ptr - buf, arena, &status);
+  if (!mt) {
+    printf("Failed to build mini table.\n");
+    exit(1);
+  }
+  return mt;
+}
+
+// Serializes a packed fixed-width payload: tag, length, then |count| elements
+// of |elem_size| bytes each (the element bytes themselves are arbitrary).
+static std::string PackedFixedPayload(size_t count, size_t elem_size) {
+  std::string out;
+  out.push_back(0x0a);  // Field 1, wire type delimited.
+  size_t len = count * elem_size;
+  while (len >= 0x80) {
+    out.push_back((len & 0x7f) | 0x80);
+    len >>= 7;
+  }
+  out.push_back(len);
+  out.append(count * elem_size, '\x42');
+  return out;
+}
+
+template <upb_FieldType kType, size_t kElemSize>
+static void BM_Parse_Upb_PackedFixed(benchmark::State& state) {
+  upb_Arena* mt_arena = upb_Arena_New();
+  const upb_MiniTable* mt = PackedMiniTable(kType, mt_arena);
+  std::string payload = PackedFixedPayload(128 * 1024, kElemSize);
+  for (auto _ : state) {
+    upb_Arena* arena = upb_Arena_New();
+    upb_Message* msg = upb_Message_New(mt, arena);
+    upb_DecodeStatus result = upb_Decode(payload.data(), payload.size(), msg,
+                                         mt, NULL, 0, arena);
+    if (result != kUpb_DecodeStatus_Ok) {
+      printf("Failed to parse.\n");
+      exit(1);
+    }
+    upb_Arena_Free(arena);
+  }
+  state.SetBytesProcessed(state.iterations() * payload.size());
+  upb_Arena_Free(mt_arena);
+}
+BENCHMARK_TEMPLATE(BM_Parse_Upb_PackedFixed, kUpb_FieldType_Float, 4);
+BENCHMARK_TEMPLATE(BM_Parse_Upb_PackedFixed, kUpb_FieldType_Double, 8);
+BENCHMARK_TEMPLATE(BM_Parse_Upb_PackedFixed, kUpb_FieldType_Fixed32, 4);
+BENCHMARK_TEMPLATE(BM_Parse_Upb_PackedFixed, kUpb_FieldType_Fixed64, 8);
+
+// Synthetic workload shapes (see gen_synthetic_protos.py) covering production
+// pain points that descriptor.proto does not exercise: giant maps, long
+// strings, deep nesting, and extension walls.
+
+static std::string MapHeavyPayload(size_t entries) {
+  upb_benchmark::MapHeavy proto;
+  for (size_t i = 0; i < entries; i++) {
+    int32_t key = static_cast<int32_t>(i);
+    std::string str_key = "key_" + std::to_string(i);
+    (*proto.mutable_int32_map())[key] = key;
+    (*proto.mutable_int64_map())[key] = key;
+    (*proto.mutable_string_map())[str_key] = std::string(32, 'x');
+    upb_benchmark::MapValue value;
+    value.set_a(key);
+    value.set_b(str_key);
+    (*proto.mutable_message_map())[str_key] = value;
+  }
+  return proto.SerializeAsString();
+}
+
+static void BM_Parse_Upb_MapHeavy(benchmark::State& state) {
+  std::string payload = MapHeavyPayload(state.range(0));
+  for (auto _ : state) {
+    upb_Arena* arena = upb_Arena_New();
+    upb_benchmark_MapHeavy* msg =
+        upb_benchmark_MapHeavy_parse(payload.data(), payload.size(), arena);
+    if (!msg) {
+      printf("Failed to parse.\n");
+      exit(1);
+    }
+    upb_Arena_Free(arena);
+  }
+  state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_Parse_Upb_MapHeavy)->Range(16, 4096);
+
+static std::string StringHeavyPayload(size_t len) {
+  upb_benchmark::StringHeavy proto;
+  proto.set_name(std::string(len, 'n'));
+  proto.set_id(std::string(len, 'i'));
+  proto.set_payload(std::string(len, 'p'));
+  for (int i = 0; i < 64; i++) {
+    proto.add_values(std::string(len, 'v'));
+  }
+  return proto.SerializeAsString();
+}
+
+template <CopyStrings kCopy>
+static void BM_Parse_Upb_StringHeavy(benchmark::State& state) {
+  std::string payload = StringHeavyPayload(state.range(0));
+  for (auto _ : state) {
+    upb_Arena* arena = upb_Arena_New();
+    upb_benchmark_StringHeavy* msg = upb_benchmark_StringHeavy_parse_ex(
+        payload.data(), payload.size(), NULL,
+        kCopy == Alias ? kUpb_DecodeOption_AliasString : 0, arena);
+    if (!msg) {
+      printf("Failed to parse.\n");
+      exit(1);
+    }
+    upb_Arena_Free(arena);
+  }
+  state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK_TEMPLATE(BM_Parse_Upb_StringHeavy, Copy)->Range(8, 8192);
+BENCHMARK_TEMPLATE(BM_Parse_Upb_StringHeavy, Alias)->Range(8, 8192);
+
+// Builds a payload for deep_nesting.proto by wrapping an innermost
+// `int32 leaf = 2` in `depth - 1` levels of submessage field 1.
+static std::string DeepNestingPayload(int depth) {
+  std::string out;
+  out.push_back(0x10);  // leaf, varint.
+  out.push_back(42);
+  for (int i = 1; i < depth; i++) {
+    std::string wrapped;
+    wrapped.push_back(0x0a);  // child, delimited.
+    size_t len = out.size();
+    while (len >= 0x80) {
+      wrapped.push_back((len & 0x7f) | 0x80);
+      len >>= 7;
+    }
+    wrapped.push_back(len);
+    wrapped += out;
+    out = std::move(wrapped);
+  }
+  return out;
+}
+
+static void BM_Parse_Upb_DeepNesting(benchmark::State& state) {
+  std::string payload = DeepNestingPayload(60);
+  for (auto _ : state) {
+    upb_Arena* arena = upb_Arena_New();
+    upb_benchmark_Nested1* msg =
+        upb_benchmark_Nested1_parse(payload.data(), payload.size(), arena);
+    if (!msg) {
+      printf("Failed to parse.\n");
+      exit(1);
+    }
+    upb_Arena_Free(arena);
+  }
+  state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_Parse_Upb_DeepNesting);
+
+// A run of small varint extension fields 1..count, as produced by
+// extension_heavy.proto's extension wall.
+static std::string ExtensionHeavyPayload(int count) {
+  std::string out;
+  for (int i = 1; i <= count; i++) {
+    uint32_t tag = i << 3;  // Varint wire type.
+    while (tag >= 0x80) {
+      out.push_back((tag & 0x7f) | 0x80);
+      tag >>= 7;
+    }
+    out.push_back(tag);
+    out.push_back(i & 0x7f);
+  }
+  return out;
+}
+
+enum ExtensionMode {
+  WithRegistry,     // Extensions are parsed into extension storage.
+  WithoutRegistry,  // Extensions fall into the unknown-field path.
+};
+
+template <ExtensionMode kMode>
+static void BM_Parse_Upb_ExtensionHeavy(benchmark::State& state) {
+  upb::DefPool defpool;
+  const upb_ExtensionRegistry* extreg = NULL;
+  if (kMode == WithRegistry) {
+    // Loading the file into the def pool registers the generated extensions.
+    upb_benchmark_ExtensionHeavy_getmsgdef(defpool.ptr());
+    extreg = upb_DefPool_ExtensionRegistry(defpool.ptr());
+  }
+  std::string payload = ExtensionHeavyPayload(200);
+  for (auto _ : state) {
+    upb_Arena* arena = upb_Arena_New();
+    upb_benchmark_ExtensionHeavy* msg = upb_benchmark_ExtensionHeavy_parse_ex(
+        payload.data(), payload.size(), extreg, 0, arena);
+    if (!msg) {
+      printf("Failed to parse.\n");
+      exit(1);
+    }
+    upb_Arena_Free(arena);
+  }
+  state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK_TEMPLATE(BM_Parse_Upb_ExtensionHeavy, WithRegistry);
+BENCHMARK_TEMPLATE(BM_Parse_Upb_ExtensionHeavy, WithoutRegistry);
+
 template <ArenaMode AMode, class P>
 struct Proto2Factory;
 
@@ -347,6 +753,320 @@ BENCHMARK_TEMPLATE(BM_Parse_Proto2, FileDesc, UseArena, Copy);
 BENCHMARK_TEMPLATE(BM_Parse_Proto2, FileDesc, InitBlock, Copy);
 BENCHMARK_TEMPLATE(BM_Parse_Proto2, FileDescSV, InitBlock, Alias);
 
+// Adversarial-input benchmarks.  Crafted payloads — colliding map keys,
+// unknown-field floods, pathological group nesting — can degrade decode
+// throughput far below the friendly-input benchmarks above, so worst-case
+// behavior is tracked as a performance property of its own.
+
+static void AppendVarint(std::string& out, uint64_t val) {
+  while (val >= 0x80) {
+    out.push_back((val & 0x7f) | 0x80);
+    val >>= 7;
+  }
+  out.push_back(val);
+}
+
+// Returns |count| map keys whose _upb_Hash() values agree in their low
+// |bits| bits, which chains them into the same strtable buckets.
+static std::vector<std::string> CollidingMapKeys(size_t count, int bits) {
+  std::vector<std::string> keys;
+  uint32_t mask = (1u << bits) - 1;
+  for (uint64_t i = 0; keys.size() < count; i++) {
+    std::string key = "key_" + std::to_string(i);
+    if ((_upb_Hash(key.data(), key.size(), 0) & mask) == 0) {
+      keys.push_back(key);
+    }
+  }
+  return keys;
+}
+
+enum MapKeyPattern {
+  kSequentialKeys,
+  kCollidingKeys,
+};
+
+template <MapKeyPattern kPattern>
+static void BM_Parse_Upb_MapCollisions(benchmark::State& state) {
+  size_t count = state.range(0);
+  upb_benchmark::MapHeavy proto;
+  if (kPattern == kCollidingKeys) {
+    for (const auto& key : CollidingMapKeys(count, 10)) {
+      (*proto.mutable_string_map())[key] = "v";
+    }
+  } else {
+    for (size_t i = 0; i < count; i++) {
+      (*proto.mutable_string_map())["key_" + std::to_string(i)] = "v";
+    }
+  }
+  std::string payload = proto.SerializeAsString();
+  for (auto _ : state) {
+    upb_Arena* arena = upb_Arena_New();
+    upb_benchmark_MapHeavy* msg =
+        upb_benchmark_MapHeavy_parse(payload.data(), payload.size(), arena);
+    if (!msg) {
+      printf("Failed to parse.\n");
+      exit(1);
+    }
+    upb_Arena_Free(arena);
+  }
+  state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK_TEMPLATE(BM_Parse_Upb_MapCollisions, kSequentialKeys)
+    ->Range(256, 4096);
+BENCHMARK_TEMPLATE(BM_Parse_Upb_MapCollisions, kCollidingKeys)->Range(256,
+                                                                      4096);
+
+// |size| bytes of fields unknown to the target message: alternating small
+// varints and 128-byte blobs with field numbers above 1000, all of which
+// take the unknown-field preservation path.
+static std::string UnknownFloodPayload(size_t size) {
+  std::string out;
+  uint32_t field_number = 1000;
+  while (out.size() < size) {
+    AppendVarint(out, (field_number << 3) | 0);  // Varint.
+    out.push_back(1);
+    AppendVarint(out, (field_number << 3) | 2);  // Delimited.
+    AppendVarint(out, 128);
+    out.append(128, 'u');
+    field_number++;
+  }
+  return out;
+}
+
+static void BM_Parse_Upb_UnknownFlood(benchmark::State& state) {
+  std::string payload = UnknownFloodPayload(state.range(0));
+  for (auto _ : state) {
+    upb_Arena* arena = upb_Arena_New();
+    upb_benchmark_MapValue* msg =
+        upb_benchmark_MapValue_parse(payload.data(), payload.size(), arena);
+    if (!msg) {
+      printf("Failed to parse.\n");
+      exit(1);
+    }
+    upb_Arena_Free(arena);
+  }
+  state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_Parse_Upb_UnknownFlood)->Range(1 << 16, 1 << 22);
+
+// Runs of unknown groups nested |depth| deep.  Unlike unknown delimited
+// fields, groups carry no length, so the decoder must scan for each matching
+// end-group tag instead of skipping a known number of bytes.
+static std::string DeepGroupPayload(int depth, int repeats) {
+  std::string group;
+  for (int i = 0; i < depth; i++) {
+    AppendVarint(group, (999 << 3) | 3);  // Start group.
+  }
+  for (int i = 0; i < depth; i++) {
+    AppendVarint(group, (999 << 3) | 4);  // End group.
+  }
+  std::string out;
+  for (int i = 0; i < repeats; i++) out += group;
+  return out;
+}
+
+static void BM_Parse_Upb_DeepGroupSkip(benchmark::State& state) {
+  std::string payload = DeepGroupPayload(90, 1000);
+  for (auto _ : state) {
+    upb_Arena* arena = upb_Arena_New();
+    upb_benchmark_MapValue* msg =
+        upb_benchmark_MapValue_parse(payload.data(), payload.size(), arena);
+    if (!msg) {
+      printf("Failed to parse.\n");
+      exit(1);
+    }
+    upb_Arena_Free(arena);
+  }
+  state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_Parse_Upb_DeepGroupSkip);
+
+static void BM_Parse_Upb_BinaryCorpus(benchmark::State& state,
+                                      std::string payload) {
+  for (auto _ : state) {
+    upb_Arena* arena = upb_Arena_New();
+    // Corpus entries are often intentionally malformed; a failed parse is
+    // still a measured decode attempt, not an error.
+    benchmark::DoNotOptimize(upb_benchmark_FileDescriptorProto_parse(
+        payload.data(), payload.size(), arena));
+    upb_Arena_Free(arena);
+  }
+  state.SetBytesProcessed(state.iterations() * payload.size());
+}
+
+// Registers one BM_Parse_Upb_BinaryCorpus benchmark per file in the
+// UPB_DECODE_CORPUS environment variable (colon-separated paths), decoded as
+// upb_benchmark.FileDescriptorProto.  Fuzzer findings and abuse-team samples
+// are fed through this without being checked into the repo.
+class RegisterBinaryCorpus {
+ public:
+  RegisterBinaryCorpus() {
+    const char* env = getenv("UPB_DECODE_CORPUS");
+    if (!env) return;
+    std::string files(env);
+    size_t start = 0;
+    while (start < files.size()) {
+      size_t end = files.find(':', start);
+      if (end == std::string::npos) end = files.size();
+      std::string path = files.substr(start, end - start);
+      if (!path.empty()) {
+        std::ifstream in(path);
+        if (!in) {
+          fprintf(stderr, "Could not open decode corpus file: %s\n",
+                  path.c_str());
+          exit(1);
+        }
+        std::string contents((std::istreambuf_iterator<char>(in)),
+                             std::istreambuf_iterator<char>());
+        benchmark::RegisterBenchmark(
+            ("BM_Parse_Upb_BinaryCorpus/" + path).c_str(),
+            BM_Parse_Upb_BinaryCorpus, contents);
+      }
+      start = end + 1;
+    }
+  }
+};
+static RegisterBinaryCorpus register_binary_corpus;
+
+// JSON benchmarks.  These exercise upb/json/decode.c and encode.c over the
+// same descriptor.proto payload as the binary-format benchmarks, plus any
+// user-supplied corpus documents (see RegisterJsonCorpus below).
+
+// Parses the compiled-in descriptor into a message typed by reflection.
+static upb_Message* ParseDescriptorViaReflection(const upb_MessageDef* m,
+                                                 upb_Arena* arena) {
+  const upb_MiniTable* mt = upb_MessageDef_MiniTable(m);
+  upb_Message* msg = upb_Message_New(mt, arena);
+  upb_DecodeStatus status =
+      upb_Decode(descriptor.data, descriptor.size, msg, mt, NULL, 0, arena);
+  if (status != kUpb_DecodeStatus_Ok) {
+    printf("Failed to parse.\n");
+    exit(1);
+  }
+  return msg;
+}
+
+static std::string DescriptorJson(const upb_MessageDef* m,
+                                  const upb_Message* msg) {
+  upb_Status status;
+  upb_Status_Clear(&status);
+  size_t size = upb_JsonEncode(msg, m, NULL, 0, NULL, 0, &status);
+  std::string json(size + 1, '\0');
+  upb_JsonEncode(msg, m, NULL, 0, &json[0], json.size(), &status);
+  if (!upb_Status_IsOk(&status)) {
+    printf("Failed to encode JSON.\n");
+    exit(1);
+  }
+  json.resize(size);
+  return json;
+}
+
+template <int kDecodeOptions>
+static void BM_JsonParse_Upb(benchmark::State& state) {
+  upb::DefPool defpool;
+  const upb_MessageDef* m =
+      upb_benchmark_FileDescriptorProto_getmsgdef(defpool.ptr());
+  upb_Arena* setup_arena = upb_Arena_New();
+  std::string json =
+      DescriptorJson(m, ParseDescriptorViaReflection(m, setup_arena));
+  upb_Arena_Free(setup_arena);
+  const upb_MiniTable* mt = upb_MessageDef_MiniTable(m);
+  for (auto _ : state) {
+    upb_Arena* arena = upb_Arena_New();
+    upb_Message* msg = upb_Message_New(mt, arena);
+    upb_Status status;
+    upb_Status_Clear(&status);
+    if (!upb_JsonDecode(json.data(), json.size(), msg, m, NULL,
+                        kDecodeOptions, arena, &status)) {
+      printf("Failed to parse JSON: %s\n", upb_Status_ErrorMessage(&status));
+      exit(1);
+    }
+    upb_Arena_Free(arena);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+BENCHMARK_TEMPLATE(BM_JsonParse_Upb, 0);
+BENCHMARK_TEMPLATE(BM_JsonParse_Upb, upb_JsonDecode_IgnoreUnknown);
+
+template <int kEncodeOptions>
+static void BM_JsonSerialize_Upb(benchmark::State& state) {
+  upb::DefPool defpool;
+  const upb_MessageDef* m =
+      upb_benchmark_FileDescriptorProto_getmsgdef(defpool.ptr());
+  upb_Arena* arena = upb_Arena_New();
+  upb_Message* msg = ParseDescriptorViaReflection(m, arena);
+  upb_Status status;
+  upb_Status_Clear(&status);
+  size_t size = upb_JsonEncode(msg, m, NULL, kEncodeOptions, NULL, 0, &status);
+  std::string out(size + 1, '\0');
+  int64_t total = 0;
+  for (auto _ : state) {
+    total += upb_JsonEncode(msg, m, NULL, kEncodeOptions, &out[0], out.size(),
+                            &status);
+  }
+  state.SetBytesProcessed(total);
+  upb_Arena_Free(arena);
+}
+BENCHMARK_TEMPLATE(BM_JsonSerialize_Upb, 0);
+BENCHMARK_TEMPLATE(BM_JsonSerialize_Upb, upb_JsonEncode_EmitDefaults);
+BENCHMARK_TEMPLATE(BM_JsonSerialize_Upb, upb_JsonEncode_UseProtoNames);
+
+static void BM_JsonParse_Upb_Corpus(benchmark::State& state,
+                                    std::string json) {
+  upb::DefPool defpool;
+  const upb_MessageDef* m =
+      upb_benchmark_FileDescriptorProto_getmsgdef(defpool.ptr());
+  const upb_MiniTable* mt = upb_MessageDef_MiniTable(m);
+  for (auto _ : state) {
+    upb_Arena* arena = upb_Arena_New();
+    upb_Message* msg = upb_Message_New(mt, arena);
+    upb_Status status;
+    upb_Status_Clear(&status);
+    if (!upb_JsonDecode(json.data(), json.size(), msg, m, NULL,
+                        upb_JsonDecode_IgnoreUnknown, arena, &status)) {
+      printf("Failed to parse JSON corpus file: %s\n",
+             upb_Status_ErrorMessage(&status));
+      exit(1);
+    }
+    upb_Arena_Free(arena);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+// Registers one BM_JsonParse_Upb_Corpus benchmark per file in the
+// UPB_JSON_CORPUS environment variable (colon-separated paths).  Each file
+// must be a JSON document matching upb_benchmark.FileDescriptorProto; this is
+// how anonymized production documents are fed through the JSON decoder
+// without being checked into the repo.
+class RegisterJsonCorpus {
+ public:
+  RegisterJsonCorpus() {
+    const char* env = getenv("UPB_JSON_CORPUS");
+    if (!env) return;
+    std::string files(env);
+    size_t start = 0;
+    while (start < files.size()) {
+      size_t end = files.find(':', start);
+      if (end == std::string::npos) end = files.size();
+      std::string path = files.substr(start, end - start);
+      if (!path.empty()) {
+        std::ifstream in(path);
+        if (!in) {
+          fprintf(stderr, "Could not open JSON corpus file: %s\n",
+                  path.c_str());
+          exit(1);
+        }
+        std::string contents((std::istreambuf_iterator<char>(in)),
+                             std::istreambuf_iterator<char>());
+        benchmark::RegisterBenchmark(("BM_JsonParse_Upb_Corpus/" + path).c_str(),
+                                     BM_JsonParse_Upb_Corpus, contents);
+      }
+      start = end + 1;
+    }
+  }
+};
+static RegisterJsonCorpus register_json_corpus;
+
 static void BM_SerializeDescriptor_Proto2(benchmark::State& state) {
   upb_benchmark::FileDescriptorProto proto;
   proto.ParseFromArray(descriptor.data, descriptor.size);
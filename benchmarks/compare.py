@@ -53,7 +53,8 @@ def GitWorktree(commit):
 def Run(cmd):
   subprocess.check_call(cmd, shell=True)
 
-def Benchmark(outbase, bench_cpu=True, runs=12, fasttable=False):
+def Benchmark(outbase, bench_cpu=True, runs=12, fasttable=False,
+              bench_filter=None):
   tmpfile = "/tmp/bench-output.json"
   Run("rm -rf {}".format(tmpfile))
   #Run("CC=clang bazel test ...")
@@ -64,10 +65,21 @@ def Benchmark(outbase, bench_cpu=True, runs=12, fasttable=False):
 
   if bench_cpu:
     Run("CC=clang bazel build -c opt --copt=-march=native benchmarks:benchmark" + extra_args)
-    Run("./bazel-bin/benchmarks/benchmark --benchmark_out_format=json --benchmark_out={} --benchmark_repetitions={} --benchmark_min_time=0.05 --benchmark_enable_random_interleaving=true".format(tmpfile, runs))
+    filter_arg = " --benchmark_filter='{}'".format(bench_filter) if bench_filter else ""
+    Run("./bazel-bin/benchmarks/benchmark --benchmark_out_format=json --benchmark_out={} --benchmark_repetitions={} --benchmark_min_time=0.05 --benchmark_enable_random_interleaving=true".format(tmpfile, runs) + filter_arg)
     with open(tmpfile) as f:
       bench_json = json.load(f)
 
+    # JSON keys that are part of the benchmark run structure itself; any other
+    # numeric key is a user counter (eg. the perf_event counters reported by
+    # benchmark.cc) and gets its own value/unit pair on the benchstat line.
+    structural_keys = {
+        "name", "run_name", "run_type", "family_index",
+        "per_family_instance_index", "repetitions", "repetition_index",
+        "threads", "iterations", "real_time", "cpu_time", "time_unit",
+        "aggregate_name", "label", "error_occurred", "error_message",
+    }
+
     # Translate into the format expected by benchstat.
     txt_filename = outbase + ".txt"
     with open(txt_filename, "w") as f:
@@ -77,9 +89,33 @@ def Benchmark(outbase, bench_cpu=True, runs=12, fasttable=False):
         name = run["name"]
         name = name.replace(" ", "")
         name = re.sub(r'^BM_', 'Benchmark', name)
-        values = (name, run["iterations"], run["cpu_time"])
-        print("{} {} {} ns/op".format(*values), file=f)
-    Run("sort {} -o {} ".format(txt_filename, txt_filename))
+        line = "{} {} {} ns/op".format(name, run["iterations"], run["cpu_time"])
+        for key in sorted(run.keys()):
+          if key in structural_keys:
+            continue
+          value = run[key]
+          if isinstance(value, (int, float)):
+            line += " {} {}".format(value, key)
+        print(line, file=f)
+
+  # Size benchmarks: per-message MiniTable bytes, the fasttable delta, and
+  # .upb section sizes across the synthetic corpus, appended in benchstat
+  # form so benchstat diffs them alongside the CPU numbers.
+  txt_filename = outbase + ".txt"
+  targets = subprocess.check_output(
+      "bazel query \"filter('_upb_binary$', //benchmarks:all)\"",
+      shell=True, text=True).split()
+  names = [t.split(":")[1] for t in targets]
+  with tempfile.TemporaryDirectory() as plain_dir:
+    Run("CC=clang bazel build -c opt " + " ".join(targets))
+    for name in names:
+      Run("cp -f bazel-bin/benchmarks/{} {}/".format(name, plain_dir))
+    Run("CC=clang bazel build -c opt --//:fasttable_enabled=true " +
+        " ".join(targets))
+    pairs = " ".join("{}/{}:bazel-bin/benchmarks/{}".format(plain_dir, n, n)
+                     for n in names)
+    Run("./benchmarks/gen_size_report.py {} >> {}".format(pairs, txt_filename))
+  Run("sort {} -o {} ".format(txt_filename, txt_filename))
 
   Run("CC=clang bazel build -c opt --copt=-g --copt=-march=native :conformance_upb"
       + extra_args)
@@ -89,20 +125,27 @@ def Benchmark(outbase, bench_cpu=True, runs=12, fasttable=False):
 baseline = "main"
 bench_cpu = True
 fasttable = False
+bench_filter = None
 
-if len(sys.argv) > 1:
-  baseline = sys.argv[1]
+for arg in sys.argv[1:]:
+  if arg.startswith("--filter="):
+    # Restrict the CPU benchmarks, eg. --filter=MapHeavy to compare only the
+    # map-heavy synthetic workload.
+    bench_filter = arg[len("--filter="):]
+  else:
+    baseline = arg
 
-  # Quickly verify that the baseline exists.
-  with GitWorktree(baseline):
-    pass
+    # Quickly verify that the baseline exists.
+    with GitWorktree(baseline):
+      pass
 
 # Benchmark our current directory first, since it's more likely to be broken.
-Benchmark("/tmp/new", bench_cpu, fasttable=fasttable)
+Benchmark("/tmp/new", bench_cpu, fasttable=fasttable, bench_filter=bench_filter)
 
 # Benchmark the baseline.
 with GitWorktree(baseline):
-  Benchmark("/tmp/old", bench_cpu, fasttable=fasttable)
+  Benchmark("/tmp/old", bench_cpu, fasttable=fasttable,
+            bench_filter=bench_filter)
 
 print()
 print()
@@ -0,0 +1,92 @@
+#!/usr/bin/python3
+#
+# Copyright (c) 2009-2021, Google LLC
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#     * Neither the name of Google LLC nor the
+#       names of its contributors may be used to endorse or promote products
+#       derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+"""Reports generated-code sizes in benchstat-consumable form.
+
+Each argument is a linked *_upb_binary, optionally paired with a fasttable
+build of the same binary as PLAIN_PATH:FASTTABLE_PATH.  For each binary we
+emit one Go-benchmark-format line per message with the size of its
+upb_MiniTable symbol (<Message>_msg_init), plus a summary line with the
+total MiniTable bytes and the text/data/bss section sizes.  When a
+fasttable build is supplied, the summary also reports the extra MiniTable
+bytes that fasttable costs (the table doubles in size, see decode_fast.c).
+
+The output concatenates cleanly with the CPU benchmark lines written by
+compare.py, so benchstat diffs size and speed side by side.
+"""
+
+import os
+import re
+import subprocess
+import sys
+
+
+def Symbols(path):
+  """Returns {symbol name: size in bytes} for defined symbols in |path|."""
+  syms = {}
+  output = subprocess.check_output(
+      ['nm', '--print-size', '--defined-only', path], text=True)
+  for line in output.splitlines():
+    parts = line.split()
+    if len(parts) == 4:
+      _, size, _, name = parts
+      syms[name] = int(size, 16)
+  return syms
+
+
+def MiniTables(syms):
+  return {name: size for name, size in syms.items()
+          if name.endswith('_msg_init')}
+
+
+def Sections(path):
+  """Returns (text, data, bss) sizes in bytes.  GNU format counts rodata
+  (where MiniTables typically live) with data, not text."""
+  output = subprocess.check_output(['size', '--format=GNU', path], text=True)
+  text, data, bss = output.splitlines()[-1].split()[:3]
+  return int(text), int(data), int(bss)
+
+
+for arg in sys.argv[1:]:
+  paths = arg.split(':')
+  path = paths[0]
+  base = re.sub(r'_upb_binary$', '', os.path.basename(path))
+  minitables = MiniTables(Symbols(path))
+  total_minitable = sum(minitables.values())
+  text, data, bss = Sections(path)
+
+  line = 'BenchmarkSize_{} 1 {} minitable-bytes {} text-bytes {} data-bytes {} bss-bytes'.format(
+      base, total_minitable, text, data, bss)
+  if len(paths) > 1:
+    fasttable_total = sum(MiniTables(Symbols(paths[1])).values())
+    line += ' {} fasttable-bytes'.format(fasttable_total - total_minitable)
+  print(line)
+
+  for name in sorted(minitables):
+    message = name[:-len('_msg_init')]
+    print('BenchmarkSize_{}/{} 1 {} minitable-bytes'.format(
+        base, message, minitables[name]))
@@ -116,3 +116,62 @@ with open(base + "/200_fields.proto", "w") as f:
     f.write('  {label} {field_type} field{i} = {i};\n'.format(i=i, label=label,field_type=field_type))
     i += 1
   f.write('}\n')
+
+# Parameterized generators for synthetic workload shapes that descriptor.proto
+# does not exercise: giant maps, long strings, deep nesting, and extension
+# walls.  Each takes its shape parameters explicitly so new sizes can be added
+# without copying the writer logic.
+
+def gen_map_heavy(path):
+  with open(path, "w") as f:
+    f.write('syntax = "proto3";\n')
+    f.write('package upb_benchmark;\n')
+    f.write('message MapValue {\n')
+    f.write('  int32 a = 1;\n')
+    f.write('  string b = 2;\n')
+    f.write('}\n')
+    f.write('message MapHeavy {\n')
+    f.write('  map<int32, int32> int32_map = 1;\n')
+    f.write('  map<int64, int64> int64_map = 2;\n')
+    f.write('  map<string, string> string_map = 3;\n')
+    f.write('  map<string, MapValue> message_map = 4;\n')
+    f.write('}\n')
+
+def gen_string_heavy(path):
+  with open(path, "w") as f:
+    f.write('syntax = "proto3";\n')
+    f.write('package upb_benchmark;\n')
+    f.write('message StringHeavy {\n')
+    f.write('  string name = 1;\n')
+    f.write('  string id = 2;\n')
+    f.write('  bytes payload = 3;\n')
+    f.write('  repeated string values = 4;\n')
+    f.write('}\n')
+
+def gen_deep_nesting(path, depth):
+  with open(path, "w") as f:
+    f.write('syntax = "proto3";\n')
+    f.write('package upb_benchmark;\n')
+    for i in range(1, depth + 1):
+      f.write('message Nested{i} {{\n'.format(i=i))
+      if i < depth:
+        f.write('  Nested{child} child = 1;\n'.format(child=i + 1))
+      f.write('  int32 leaf = 2;\n')
+      f.write('}\n')
+
+def gen_extension_heavy(path, num_extensions):
+  with open(path, "w") as f:
+    f.write('syntax = "proto2";\n')
+    f.write('package upb_benchmark;\n')
+    f.write('message ExtensionHeavy {\n')
+    f.write('  extensions 1 to 10000;\n')
+    f.write('}\n')
+    f.write('extend ExtensionHeavy {\n')
+    for i in range(1, num_extensions + 1):
+      f.write('  optional int32 ext{i} = {i};\n'.format(i=i))
+    f.write('}\n')
+
+gen_map_heavy(base + "/map_heavy.proto")
+gen_string_heavy(base + "/string_heavy.proto")
+gen_deep_nesting(base + "/deep_nesting.proto", depth=60)
+gen_extension_heavy(base + "/extension_heavy.proto", num_extensions=200)
@@ -184,6 +184,47 @@ static void lupb_cacheset(lua_State* L, const void* key) {
   lua_pop(L, 1); /* Pop table. */
 }
 
+char strcache_key;
+
+/* lupb_strcacheinit()
+ *
+ * Creates the global string cache used by lupb_strcache_pushtable().  It maps
+ * each message wrapper to a table of {upb_FieldDef* -> Lua string} holding the
+ * interned Lua string for each string/bytes field that has been read.  The
+ * keys are weak so that the per-message tables die with their wrappers.
+ */
+static void lupb_strcacheinit(lua_State* L) {
+  lua_newtable(L);
+
+  /* Cache metatable gives the cache weak keys. */
+  lua_createtable(L, 0, 1);
+  lua_pushstring(L, "k");
+  lua_setfield(L, -2, "__mode");
+  lua_setmetatable(L, -2);
+
+  lua_rawsetp(L, LUA_REGISTRYINDEX, &strcache_key);
+}
+
+/* lupb_strcache_pushtable()
+ *
+ * Pushes the per-message string cache table for the message wrapper at
+ * |msgarg|, creating it if this message has none yet.
+ */
+static void lupb_strcache_pushtable(lua_State* L, int msgarg) {
+  msgarg = lua_absindex(L, msgarg);
+  lua_rawgetp(L, LUA_REGISTRYINDEX, &strcache_key);
+  lua_pushvalue(L, msgarg);
+  lua_rawget(L, -2);
+  if (lua_isnil(L, -1)) {
+    lua_pop(L, 1);
+    lua_newtable(L);
+    lua_pushvalue(L, msgarg);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, -4);
+  }
+  lua_replace(L, -2); /* Remove outer cache table. */
+}
+
 /* lupb_Arena *****************************************************************/
 
 /* lupb_Arena only exists to wrap a upb_Arena.  It is never exposed to users; it
@@ -486,6 +527,28 @@ static const struct luaL_Reg lupb_array_mm[] = {
     {"__newindex", lupb_Array_Newindex},
     {NULL, NULL}};
 
+/**
+ * lupb_Array_ToTable()
+ *
+ * Handles:
+ *   t = upb.totable(array)
+ *
+ * Converts the array into a plain Lua table in a single pass.  The table's
+ * array part is preallocated to the final size, so elements are stored
+ * without per-element rehashing or metamethod dispatch, which is much faster
+ * than indexing the array wrapper element by element from a script.
+ */
+static int lupb_Array_ToTable(lua_State* L) {
+  lupb_array* larray = lupb_array_check(L, 1);
+  size_t size = upb_Array_Size(larray->arr);
+  lua_createtable(L, size, 0);
+  for (size_t i = 0; i < size; i++) {
+    lupb_pushmsgval(L, 1, larray->type, upb_Array_Get(larray->arr, i));
+    lua_rawseti(L, -2, i + 1);
+  }
+  return 1;
+}
+
 /* lupb_map *******************************************************************/
 
 typedef struct {
@@ -824,9 +887,28 @@ static int lupb_msg_index(lua_State* L) {
       lupb_Message_Newwrapper(L, 1, f, val);
     }
   } else {
+    upb_CType type = upb_FieldDef_CType(f);
+    if (type == kUpb_CType_String || type == kUpb_CType_Bytes) {
+      /* Interning a Lua string hashes the full contents, which dominates if
+       * the same field is read repeatedly.  Cache the interned string per
+       * field and reuse it until the field is written. */
+      lupb_strcache_pushtable(L, 1);
+      lua_rawgetp(L, -1, f);
+      if (!lua_isnil(L, -1)) {
+        lua_replace(L, -2); /* Remove cache table. */
+        return 1;
+      }
+      lua_pop(L, 1);
+      upb_MessageValue val = upb_Message_GetFieldByDef(msg, f);
+      lua_pushlstring(L, val.str_val.data, val.str_val.size);
+      lua_pushvalue(L, -1);
+      lua_rawsetp(L, -3, f);
+      lua_replace(L, -2); /* Remove cache table. */
+      return 1;
+    }
     /* Value type, just push value and return .*/
     upb_MessageValue val = upb_Message_GetFieldByDef(msg, f);
-    lupb_pushmsgval(L, 0, upb_FieldDef_CType(f), val);
+    lupb_pushmsgval(L, 0, type, val);
   }
 
   return 1;
@@ -874,8 +956,16 @@ static int lupb_Message_Newindex(lua_State* L) {
     lupb_msg_typechecksubmsg(L, 3, 1, f);
     msgval.msg_val = msg;
   } else {
-    msgval = lupb_tomsgval(L, upb_FieldDef_CType(f), 3, 1, LUPB_COPY);
+    upb_CType type = upb_FieldDef_CType(f);
+    msgval = lupb_tomsgval(L, type, 3, 1, LUPB_COPY);
     merge_arenas = false;
+    if (type == kUpb_CType_String || type == kUpb_CType_Bytes) {
+      /* Invalidate the cached Lua string for this field, if any. */
+      lupb_strcache_pushtable(L, 1);
+      lua_pushnil(L);
+      lua_rawsetp(L, -2, f);
+      lua_pop(L, 1);
+    }
   }
 
   if (merge_arenas) {
@@ -1090,7 +1180,8 @@ static const struct luaL_Reg lupb_msg_toplevel_m[] = {
     {"Array", lupb_Array_New},        {"Map", lupb_Map_New},
     {"decode", lupb_decode},          {"encode", lupb_Encode},
     {"json_decode", lupb_jsondecode}, {"json_encode", lupb_jsonencode},
-    {"text_encode", lupb_textencode}, {NULL, NULL}};
+    {"text_encode", lupb_textencode}, {"totable", lupb_Array_ToTable},
+    {NULL, NULL}};
 
 void lupb_msg_registertypes(lua_State* L) {
   lupb_setfuncs(L, lupb_msg_toplevel_m);
@@ -1113,4 +1204,5 @@ void lupb_msg_registertypes(lua_State* L) {
   lupb_setfieldi(L, "JSONDEC_IGNOREUNKNOWN", upb_JsonDecode_IgnoreUnknown);
 
   lupb_cacheinit(L);
+  lupb_strcacheinit(L);
 }
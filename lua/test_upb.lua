@@ -120,6 +120,23 @@ function test_msg_map()
   assert_equal(12, msg2.map_int32_int32[6])
 end
 
+function test_wrapper_identity()
+  -- Every access to the same underlying message, array, or map must return
+  -- the same Lua wrapper (via the weak object cache), so that scripts which
+  -- touch submessages repeatedly do not allocate a userdata per access.
+  local msg = test_messages_proto3.TestAllTypesProto3()
+  msg.optional_nested_message = test_messages_proto3.TestAllTypesProto3.NestedMessage{a = 7}
+  assert_equal(msg.optional_nested_message, msg.optional_nested_message)
+  assert_equal(msg.repeated_int32, msg.repeated_int32)
+  assert_equal(msg.map_int32_int32, msg.map_int32_int32)
+
+  -- The same holds for wrappers materialized lazily after a decode.
+  local msg2 = upb.decode(test_messages_proto3.TestAllTypesProto3,
+                          upb.encode(msg))
+  assert_equal(msg2.optional_nested_message, msg2.optional_nested_message)
+  assert_equal(7, msg2.optional_nested_message.a)
+end
+
 function test_map_sorting()
   function msg_with_int32_entries(start, expand)
     local msg = test_messages_proto3.TestAllTypesProto3()
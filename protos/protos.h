@@ -276,6 +276,27 @@ const upb_Message_Extension* GetOrPromoteExtension(
 
 }  // namespace internal
 
+// Transfers |message| onto |arena| without copying when possible: if the
+// two arenas are identical or can be fused (extending both lifetimes to
+// their union), the returned proxy reuses the underlying message handle;
+// otherwise this falls back to a deep clone like CloneMessage().  Note that
+// after a fusing transfer the source still aliases the message.
+template <typename T>
+typename T::Proxy MoveMessage(Ptr<T> message, ::upb::Arena& arena) {
+  static_assert(!std::is_const_v<T>, "");
+  upb_Arena* source = ::protos::internal::GetArena(message);
+  if (source == arena.ptr() || upb_Arena_Fuse(arena.ptr(), source)) {
+    return ::protos::internal::CreateMessageProxy<T>(
+        ::protos::internal::GetInternalMsg(message), arena.ptr());
+  }
+  return CloneMessage(message, arena);
+}
+
+template <typename T>
+typename T::Proxy MoveMessage(T* message, ::upb::Arena& arena) {
+  return MoveMessage(Ptr<T>(message), arena);
+}
+
 class ExtensionRegistry {
  public:
   ExtensionRegistry(
@@ -465,6 +486,77 @@ absl::StatusOr<T> Parse(absl::string_view bytes,
   return MessageDecodeError(status);
 }
 
+// Owns a resettable arena that many messages can be parsed into, so that a
+// request handler can invalidate all of them in O(1) when the request ends.
+// Reset() rewinds the arena in place when possible (keeping its warm,
+// already-faulted blocks) and replaces it otherwise, in which case the freed
+// blocks land in the thread-local block cache for the next context to reuse.
+// Not thread-safe; intended to live for the duration of one request on one
+// thread.
+class ParseContext {
+ public:
+  ParseContext() : arena_(upb_Arena_New()) {}
+  ~ParseContext() { upb_Arena_Free(arena_); }
+
+  ParseContext(const ParseContext&) = delete;
+  ParseContext& operator=(const ParseContext&) = delete;
+
+  // Parses `bytes` into a fresh message allocated from this context's arena.
+  // The returned proxy (and everything reachable from it) is valid until the
+  // next Reset() or until the context is destroyed.
+  template <typename T>
+  absl::StatusOr<typename T::Proxy> Parse(absl::string_view bytes) {
+    return ParseWithExtensionRegistry<T>(bytes, /* extreg= */ nullptr);
+  }
+
+  template <typename T>
+  absl::StatusOr<typename T::Proxy> Parse(
+      absl::string_view bytes,
+      const ::protos::ExtensionRegistry& extension_registry) {
+    return ParseWithExtensionRegistry<T>(
+        bytes, ::protos::internal::GetUpbExtensions(extension_registry));
+  }
+
+  // Creates an empty message bound to this context's arena, e.g. for building
+  // a response alongside the parsed request.
+  template <typename T>
+  typename T::Proxy CreateMessage() {
+    return ::protos::internal::CreateMessageProxy<T>(
+        upb_Message_New(T::minitable(), arena_), arena_);
+  }
+
+  // Invalidates every message obtained from this context in O(1), without
+  // walking them.  Memory is retained where upb_Arena_Reset() permits
+  // (i.e. the arena was not fused with another one).
+  void Reset() {
+    if (!upb_Arena_Reset(arena_)) {
+      upb_Arena_Free(arena_);
+      arena_ = upb_Arena_New();
+    }
+  }
+
+  upb_Arena* arena() const { return arena_; }
+
+ private:
+  template <typename T>
+  absl::StatusOr<typename T::Proxy> ParseWithExtensionRegistry(
+      absl::string_view bytes, const upb_ExtensionRegistry* extreg) {
+    upb_Message* msg = upb_Message_New(T::minitable(), arena_);
+    if (!msg) {
+      return MessageAllocationError();
+    }
+    upb_DecodeStatus status =
+        upb_Decode(bytes.data(), bytes.size(), msg, T::minitable(), extreg,
+                   /* options= */ 0, arena_);
+    if (status != kUpb_DecodeStatus_Ok) {
+      return MessageDecodeError(status);
+    }
+    return ::protos::internal::CreateMessageProxy<T>(msg, arena_);
+  }
+
+  upb_Arena* arena_;
+};
+
 template <typename T>
 absl::StatusOr<absl::string_view> Serialize(const T* message, upb::Arena& arena,
                                             int options = 0) {
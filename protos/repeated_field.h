@@ -34,6 +34,7 @@
 
 #include "absl/base/attributes.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "protos/protos.h"
 #include "protos/protos_traits.h"
 #include "protos/repeated_field_iterator.h"
@@ -243,6 +244,31 @@ class RepeatedFieldScalarProxy
     upb_Array_Append(this->arr_, message_value, this->arena_);
   }
 
+  // Contiguous access to the underlying upb_Array storage, so numeric
+  // kernels can run (e.g. SIMD) loops directly over the arena memory
+  // instead of copying element-wise.  The pointer is invalidated by any
+  // operation that resizes the field.
+  T* data() const { return this->arr_ ? unsafe_array() : nullptr; }
+
+  absl::Span<T> as_span() const {
+    return absl::Span<T>(data(), this->size());
+  }
+
+  // Replaces the contents with |values|: one resize, one memcpy.  Returns
+  // false if the resize failed (allocation failure).
+  template <int&... DeductionBlocker, bool b = !kIsConst,
+            typename = std::enable_if_t<b>>
+  bool Assign(absl::Span<const value_type> values) {
+    if (!upb_Array_Resize(this->arr_, values.size(), this->arena_)) {
+      return false;
+    }
+    if (!values.empty()) {
+      memcpy(unsafe_array(), values.data(),
+             values.size() * sizeof(value_type));
+    }
+    return true;
+  }
+
   iterator begin() const { return iterator({unsafe_array()}); }
   iterator cbegin() const { return begin(); }
   iterator end() const { return iterator({unsafe_array() + this->size()}); }
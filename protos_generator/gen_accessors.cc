@@ -118,6 +118,11 @@ void WriteFieldAccessorsInHeader(const protobuf::Descriptor* desc,
         output(R"cc(
                  $0 $1() const;
                  void set_$1($0 value);
+                 // Stores `value` by reference instead of copying it into the
+                 // arena, like kUpb_DecodeOption_AliasString does on parse.
+                 // The caller must guarantee that the bytes outlive all arenas
+                 // this message may become associated with.
+                 void set_alias_$1($0 value);
                )cc",
                CppConstType(field), resolved_field_name);
       } else if (field->cpp_type() ==
@@ -254,6 +259,16 @@ void WriteAccessorsInSource(const protobuf::Descriptor* desc, Output& output) {
             )cc",
             class_name, CppConstType(field), resolved_field_name,
             resolved_upbc_name, MessageName(desc), arena_expression);
+        // Set string without copying (aliasing the caller's buffer).
+        output(
+            R"cc(
+              void $0::set_alias_$2($1 value) {
+                $4_set_$3(msg_, upb_StringView_FromDataAndSize(value.data(),
+                                                               value.size()));
+              }
+            )cc",
+            class_name, CppConstType(field), resolved_field_name,
+            resolved_upbc_name, MessageName(desc));
       } else if (field->cpp_type() ==
                  protobuf::FieldDescriptor::CPPTYPE_MESSAGE) {
         output(
@@ -466,6 +481,10 @@ void WriteUsingAccessorsInHeader(const protobuf::Descriptor* desc,
         output("using $0Access::$1;\n", class_name, resolved_field_name);
         if (!read_only) {
           output("using $0Access::set_$1;\n", class_name, resolved_field_name);
+          if (field->cpp_type() == protobuf::FieldDescriptor::CPPTYPE_STRING) {
+            output("using $0Access::set_alias_$1;\n", class_name,
+                   resolved_field_name);
+          }
         }
       }
     }
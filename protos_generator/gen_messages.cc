@@ -63,6 +63,9 @@ void WriteModelCProxyDeclaration(const protobuf::Descriptor* descriptor,
                                  Output& output);
 void WriteInternalForwardDeclarationsInHeader(
     const protobuf::Descriptor* message, Output& output);
+void WriteFieldLayoutDeclarations(const protobuf::Descriptor* descriptor,
+                                  const upbc::DefPoolPair& pools,
+                                  Output& output);
 void WriteDefaultInstanceHeader(const protobuf::Descriptor* message,
                                 Output& output);
 void WriteExtensionIdentifiersImplementation(
@@ -82,7 +85,7 @@ void WriteMessageClassDeclarations(
     const protobuf::Descriptor* descriptor,
     const std::vector<const protobuf::FieldDescriptor*>& file_exts,
     const std::vector<const protobuf::EnumDescriptor*>& file_enums,
-    Output& output) {
+    const upbc::DefPoolPair& pools, Output& output) {
   if (IsMapEntryMessage(descriptor)) {
     // Skip map entry generation. Low level accessors for maps are
     // generated that don't require a separate map type.
@@ -96,6 +99,8 @@ void WriteMessageClassDeclarations(
   output("\n");
   WriteInternalForwardDeclarationsInHeader(descriptor, output);
   output("\n");
+  WriteFieldLayoutDeclarations(descriptor, pools, output);
+  output("\n");
   output("}  // namespace internal\n\n");
   WriteModelPublicDeclaration(descriptor, file_exts, file_enums, output);
   output("namespace internal {\n");
@@ -184,6 +189,17 @@ void WriteModelPublicDeclaration(
             owned_arena_ = std::move(m.owned_arena_);
             return *this;
           }
+
+          // Takes the message held by |m| without copying when its arena
+          // can be fused into (or already is) this message's arena; falls
+          // back to a deep clone otherwise.  After a fusing move the proxy
+          // still aliases the message, and both arenas live until the last
+          // of them is freed.
+          $0(Proxy&& m) : $0Access() { TakeOrClone(std::move(m)); }
+          $0& operator=(Proxy&& m) {
+            TakeOrClone(std::move(m));
+            return *this;
+          }
       )cc",
       ClassName(descriptor), ::upbc::MessageInit(descriptor->full_name()),
       MessageName(descriptor), QualifiedClassName(descriptor));
@@ -217,6 +233,17 @@ void WriteModelPublicDeclaration(
           arena_ = owned_arena_.ptr();
           upb_Arena_Fuse(arena_, arena);
         }
+        void TakeOrClone(Proxy&& m) {
+          arena_ = owned_arena_.ptr();
+          upb_Arena* source = static_cast<upb_Arena*>(m.GetInternalArena());
+          upb_Message* msg = static_cast<upb_Message*>(
+              ::protos::internal::GetInternalMsg(::protos::Ptr<$2>(m)));
+          if (source == arena_ || upb_Arena_Fuse(arena_, source)) {
+            msg_ = ($1*)msg;
+          } else {
+            msg_ = ($1*)upb_Message_DeepClone(msg, minitable(), arena_);
+          }
+        }
         ::protos::Arena owned_arena_;
         friend Proxy;
         friend CProxy;
@@ -432,6 +459,147 @@ void WriteInternalForwardDeclarationsInHeader(
       ClassName(message));
 }
 
+namespace {
+
+std::string FieldTypeConstant(const protobuf::FieldDescriptor* field) {
+  switch (field->type()) {
+    case protobuf::FieldDescriptor::TYPE_DOUBLE:
+      return "kUpb_FieldType_Double";
+    case protobuf::FieldDescriptor::TYPE_FLOAT:
+      return "kUpb_FieldType_Float";
+    case protobuf::FieldDescriptor::TYPE_INT64:
+      return "kUpb_FieldType_Int64";
+    case protobuf::FieldDescriptor::TYPE_UINT64:
+      return "kUpb_FieldType_UInt64";
+    case protobuf::FieldDescriptor::TYPE_INT32:
+      return "kUpb_FieldType_Int32";
+    case protobuf::FieldDescriptor::TYPE_FIXED64:
+      return "kUpb_FieldType_Fixed64";
+    case protobuf::FieldDescriptor::TYPE_FIXED32:
+      return "kUpb_FieldType_Fixed32";
+    case protobuf::FieldDescriptor::TYPE_BOOL:
+      return "kUpb_FieldType_Bool";
+    case protobuf::FieldDescriptor::TYPE_STRING:
+      return "kUpb_FieldType_String";
+    case protobuf::FieldDescriptor::TYPE_GROUP:
+      return "kUpb_FieldType_Group";
+    case protobuf::FieldDescriptor::TYPE_MESSAGE:
+      return "kUpb_FieldType_Message";
+    case protobuf::FieldDescriptor::TYPE_BYTES:
+      return "kUpb_FieldType_Bytes";
+    case protobuf::FieldDescriptor::TYPE_UINT32:
+      return "kUpb_FieldType_UInt32";
+    case protobuf::FieldDescriptor::TYPE_ENUM:
+      return "kUpb_FieldType_Enum";
+    case protobuf::FieldDescriptor::TYPE_SFIXED32:
+      return "kUpb_FieldType_SFixed32";
+    case protobuf::FieldDescriptor::TYPE_SFIXED64:
+      return "kUpb_FieldType_SFixed64";
+    case protobuf::FieldDescriptor::TYPE_SINT32:
+      return "kUpb_FieldType_SInt32";
+    case protobuf::FieldDescriptor::TYPE_SINT64:
+      return "kUpb_FieldType_SInt64";
+  }
+  return "";
+}
+
+std::string CTypeConstant(const protobuf::FieldDescriptor* field) {
+  switch (field->cpp_type()) {
+    case protobuf::FieldDescriptor::CPPTYPE_BOOL:
+      return "kUpb_CType_Bool";
+    case protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+      return "kUpb_CType_Float";
+    case protobuf::FieldDescriptor::CPPTYPE_INT32:
+      return "kUpb_CType_Int32";
+    case protobuf::FieldDescriptor::CPPTYPE_UINT32:
+      return "kUpb_CType_UInt32";
+    case protobuf::FieldDescriptor::CPPTYPE_ENUM:
+      return "kUpb_CType_Enum";
+    case protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+      return "kUpb_CType_Message";
+    case protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+      return "kUpb_CType_Double";
+    case protobuf::FieldDescriptor::CPPTYPE_INT64:
+      return "kUpb_CType_Int64";
+    case protobuf::FieldDescriptor::CPPTYPE_UINT64:
+      return "kUpb_CType_UInt64";
+    case protobuf::FieldDescriptor::CPPTYPE_STRING:
+      return field->type() == protobuf::FieldDescriptor::TYPE_BYTES
+                 ? "kUpb_CType_Bytes"
+                 : "kUpb_CType_String";
+  }
+  return "";
+}
+
+// Emits an expression selecting the 32- or 64-bit layout value by pointer
+// size.  We cannot use UPB_SIZE() here because the minitable headers included
+// above run upb/port/undef.inc at their end.
+std::string ArchDependentValue(int64_t value32, int64_t value64) {
+  if (value32 == value64) return absl::StrCat(value32);
+  return absl::StrCat("(sizeof(void*) == 8 ? ", value64, " : ", value32, ")");
+}
+
+}  // namespace
+
+// Writes compile-time field layout constants for a message, specialized by
+// field number.  These mirror the runtime mini table, so template code can
+// locate fields with zero mini-table consultation (and no runtime lookup by
+// field number).
+void WriteFieldLayoutDeclarations(const protobuf::Descriptor* descriptor,
+                                  const upbc::DefPoolPair& pools,
+                                  Output& output) {
+  output(
+      R"cc(
+        template <int kFieldNumber>
+        struct $0FieldLayout;
+      )cc",
+      ClassName(descriptor));
+  for (int i = 0; i < descriptor->field_count(); i++) {
+    const protobuf::FieldDescriptor* field = descriptor->field(i);
+    const upb_MiniTableField* f32 =
+        pools.GetField32(descriptor->full_name().c_str(), field->number());
+    const upb_MiniTableField* f64 =
+        pools.GetField64(descriptor->full_name().c_str(), field->number());
+    output(
+        R"cc(
+          template <>
+          struct $0FieldLayout<$1> {
+            static constexpr uint32_t kNumber = $1;
+            static constexpr size_t kOffset = $2;
+            // >0: hasbit index; <0: ~(oneof case offset); 0: no presence bit.
+            static constexpr int16_t kPresence = $3;
+            static constexpr upb_FieldType kType = $4;
+            static constexpr upb_CType kCType = $5;
+            static constexpr bool kRepeated = $6;
+            static constexpr bool kMap = $7;
+          };
+        )cc",
+        ClassName(descriptor), field->number(),
+        ArchDependentValue(f32->offset, f64->offset),
+        ArchDependentValue(f32->presence, f64->presence),
+        FieldTypeConstant(field), CTypeConstant(field),
+        field->is_repeated() ? "true" : "false",
+        field->is_map() ? "true" : "false");
+  }
+  output(
+      R"cc(
+        struct $0Layout {
+          static constexpr size_t kFieldCount = $1;
+          template <typename F>
+          static constexpr void ForEachField(F&& f) {
+      )cc",
+      ClassName(descriptor), descriptor->field_count());
+  for (int i = 0; i < descriptor->field_count(); i++) {
+    output("    f($0FieldLayout<$1>());\n", ClassName(descriptor),
+           descriptor->field(i)->number());
+  }
+  output(
+      R"cc(
+        }
+      };
+      )cc");
+}
+
 void WriteExtensionIdentifiersInClassHeader(
     const protobuf::Descriptor* message,
     const std::vector<const protobuf::FieldDescriptor*>& file_exts,
@@ -30,6 +30,7 @@
 
 #include "google/protobuf/descriptor.h"
 #include "protos_generator/output.h"
+#include "upbc/file_layout.h"
 
 namespace protos_generator {
 namespace protobuf = ::google::protobuf;
@@ -38,7 +39,7 @@ void WriteMessageClassDeclarations(
     const protobuf::Descriptor* descriptor,
     const std::vector<const protobuf::FieldDescriptor*>& file_exts,
     const std::vector<const protobuf::EnumDescriptor*>& file_enums,
-    Output& output);
+    const upbc::DefPoolPair& pools, Output& output);
 void WriteMessageImplementation(
     const protobuf::Descriptor* descriptor,
     const std::vector<const protobuf::FieldDescriptor*>& file_exts,
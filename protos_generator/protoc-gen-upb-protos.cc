@@ -26,6 +26,8 @@
 #include <memory>
 
 #include "google/protobuf/descriptor.pb.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
 #include "google/protobuf/compiler/code_generator.h"
 #include "google/protobuf/compiler/plugin.h"
 #include "google/protobuf/descriptor.h"
@@ -46,7 +48,8 @@ using FileDescriptor = ::google::protobuf::FileDescriptor;
 
 void WriteSource(const protobuf::FileDescriptor* file, Output& output,
                  bool fasttable_enabled);
-void WriteHeader(const protobuf::FileDescriptor* file, Output& output);
+void WriteHeader(const protobuf::FileDescriptor* file,
+                 const upbc::DefPoolPair& pools, Output& output);
 void WriteForwardingHeader(const protobuf::FileDescriptor* file,
                            Output& output);
 void WriteMessageImplementations(const protobuf::FileDescriptor* file,
@@ -59,6 +62,34 @@ void WriteHeaderMessageForwardDecls(
     const protobuf::FileDescriptor* file,
     Output& output);
 
+// Adds |file| and its transitive dependencies to |pools| so that the header
+// writer can consult the upb minitable layouts for both platforms.
+bool AddFileToPools(const protobuf::FileDescriptor* file,
+                    upbc::DefPoolPair* pools,
+                    absl::flat_hash_set<std::string>* files_seen,
+                    std::string* error) {
+  if (!files_seen->insert(file->name()).second) return true;
+  for (int i = 0; i < file->dependency_count(); i++) {
+    if (!AddFileToPools(file->dependency(i), pools, files_seen, error)) {
+      return false;
+    }
+  }
+  protobuf::FileDescriptorProto file_proto;
+  file->CopyTo(&file_proto);
+  std::string serialized = file_proto.SerializeAsString();
+  upb::Arena arena;
+  upb::Status status;
+  google_protobuf_FileDescriptorProto* upb_file_proto =
+      google_protobuf_FileDescriptorProto_parse(serialized.data(),
+                                                serialized.size(), arena.ptr());
+  if (!upb_file_proto || !pools->AddFile(upb_file_proto, &status)) {
+    *error = absl::StrCat("could not build layout for ", file->name(), ": ",
+                          status.error_message());
+    return false;
+  }
+  return true;
+}
+
 class Generator : public protoc::CodeGenerator {
  public:
   ~Generator() override {}
@@ -87,13 +118,21 @@ bool Generator::Generate(const protobuf::FileDescriptor* file,
     }
   }
 
+  // Build the upb minitable layouts for this file and its dependencies so
+  // that the header can embed compile-time layout constants.
+  upbc::DefPoolPair pools;
+  absl::flat_hash_set<std::string> files_seen;
+  if (!AddFileToPools(file, &pools, &files_seen, error)) {
+    return false;
+  }
+
   // Write model.upb.fwd.h
   Output forwarding_header_output(
       context->Open(ForwardingHeaderFilename(file)));
   WriteForwardingHeader(file, forwarding_header_output);
   // Write model.upb.proto.h
   Output header_output(context->Open(CppHeaderFilename(file)));
-  WriteHeader(file, header_output);
+  WriteHeader(file, pools, header_output);
   // Write model.upb.proto.cc
   Output cc_output(context->Open(CppSourceFilename(file)));
   WriteSource(file, cc_output, fasttable_enabled);
@@ -126,7 +165,8 @@ void WriteForwardingHeader(const protobuf::FileDescriptor* file,
   output("#endif  /* $0_UPB_FWD_H_ */\n", ToPreproc(file->name()));
 }
 
-void WriteHeader(const protobuf::FileDescriptor* file, Output& output) {
+void WriteHeader(const protobuf::FileDescriptor* file,
+                 const upbc::DefPoolPair& pools, Output& output) {
   EmitFileWarning(file, output);
   output(
       R"cc(
@@ -177,7 +217,7 @@ void WriteHeader(const protobuf::FileDescriptor* file, Output& output) {
 
   for (auto message : this_file_messages) {
     WriteMessageClassDeclarations(message, this_file_exts, this_file_enums,
-                                  output);
+                                  pools, output);
   }
   output("\n");
 
@@ -282,7 +282,7 @@ bool PyUpb_PyToUpb(PyObject* obj, const upb_FieldDef* f, upb_MessageValue* val,
   }
 }
 
-bool upb_Message_IsEqual(const upb_Message* msg1, const upb_Message* msg2,
+bool PyUpb_Message_IsEqualByDef(const upb_Message* msg1, const upb_Message* msg2,
                          const upb_MessageDef* m);
 
 // -----------------------------------------------------------------------------
@@ -311,7 +311,7 @@ bool PyUpb_ValueEq(upb_MessageValue val1, upb_MessageValue val2,
              memcmp(val1.str_val.data, val2.str_val.data, val1.str_val.size) ==
                  0;
     case kUpb_CType_Message:
-      return upb_Message_IsEqual(val1.msg_val, val2.msg_val,
+      return PyUpb_Message_IsEqualByDef(val1.msg_val, val2.msg_val,
                                  upb_FieldDef_MessageSubDef(f));
     default:
       return false;
@@ -380,7 +380,7 @@ bool PyUpb_Array_IsEqual(const upb_Array* arr1, const upb_Array* arr2,
   return true;
 }
 
-bool upb_Message_IsEqual(const upb_Message* msg1, const upb_Message* msg2,
+bool PyUpb_Message_IsEqualByDef(const upb_Message* msg1, const upb_Message* msg2,
                          const upb_MessageDef* m) {
   if (msg1 == msg2) return true;
   if (upb_Message_ExtensionCount(msg1) != upb_Message_ExtensionCount(msg2))
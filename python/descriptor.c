@@ -46,6 +46,9 @@ typedef struct {
   PyObject* pool;     // We own a ref.
   const void* def;    // Type depends on the class. Kept alive by "pool".
   PyObject* options;  // NULL if not present or not cached.
+  // Message descriptors only: lazily-built dict of interned field name (str)
+  // -> upb_FieldDef* (boxed in a PyLong).  NULL until first use.
+  PyObject* field_cache;
 } PyUpb_DescriptorBase;
 
 PyObject* PyUpb_AnyDescriptor_GetPool(PyObject* desc) {
@@ -68,6 +71,7 @@ static PyUpb_DescriptorBase* PyUpb_DescriptorBase_DoCreate(
   base->pool = PyUpb_DescriptorPool_Get(upb_FileDef_Pool(file));
   base->def = def;
   base->options = NULL;
+  base->field_cache = NULL;
 
   PyUpb_ObjCache_Add(def, &base->ob_base);
   return base;
@@ -193,6 +197,7 @@ static void PyUpb_DescriptorBase_Dealloc(PyUpb_DescriptorBase* base) {
   PyUpb_ObjCache_Delete(base->def);
   Py_DECREF(base->pool);
   Py_XDECREF(base->options);
+  Py_XDECREF(base->field_cache);
   PyUpb_Dealloc(base);
 }
 
@@ -211,6 +216,47 @@ PyObject* PyUpb_Descriptor_Get(const upb_MessageDef* m) {
   return PyUpb_DescriptorBase_Get(kPyUpb_Descriptor, m, file);
 }
 
+// Returns the upb_FieldDef* for the field of this message descriptor named
+// |py_name|, or NULL (without setting an exception) if there is no such
+// field.  Lookups go through a lazily-built dict keyed by interned name
+// objects, so kwarg and attribute names (which CPython interns) resolve by
+// pointer identity instead of re-decoding UTF-8 into a upb name lookup on
+// every message construction.
+const upb_FieldDef* PyUpb_Descriptor_LookupFieldByPyName(PyObject* _self,
+                                                         PyObject* py_name) {
+  PyUpb_DescriptorBase* self = (PyUpb_DescriptorBase*)_self;
+  if (!self->field_cache) {
+    const upb_MessageDef* m = self->def;
+    PyObject* cache = PyDict_New();
+    if (!cache) {
+      PyErr_Clear();
+      return NULL;
+    }
+    int n = upb_MessageDef_FieldCount(m);
+    for (int i = 0; i < n; i++) {
+      const upb_FieldDef* f = upb_MessageDef_Field(m, i);
+      PyObject* key = PyUnicode_InternFromString(upb_FieldDef_Name(f));
+      PyObject* val = key ? PyLong_FromVoidPtr((void*)f) : NULL;
+      if (!val || PyDict_SetItem(cache, key, val) < 0) {
+        Py_XDECREF(key);
+        Py_XDECREF(val);
+        Py_DECREF(cache);
+        PyErr_Clear();
+        return NULL;
+      }
+      Py_DECREF(key);
+      Py_DECREF(val);
+    }
+    self->field_cache = cache;
+  }
+  PyObject* val = PyDict_GetItemWithError(self->field_cache, py_name);
+  if (!val) {
+    PyErr_Clear();  // Unknown field; the caller falls back to the slow path.
+    return NULL;
+  }
+  return PyLong_AsVoidPtr(val);
+}
+
 PyObject* PyUpb_Descriptor_GetClass(const upb_MessageDef* m) {
   PyObject* ret = PyUpb_ObjCache_Get(upb_MessageDef_MiniTable(m));
   return ret;
@@ -62,6 +62,12 @@ PyObject* PyUpb_Descriptor_GetOrCreateWrapper(const upb_MessageDef* msg);
 PyObject* PyUpb_ServiceDescriptor_Get(const upb_ServiceDef* s);
 PyObject* PyUpb_MethodDescriptor_Get(const upb_MethodDef* s);
 
+// Fast field lookup for a message descriptor wrapper: resolves |py_name| via
+// a cached dict of interned name objects, returning NULL (with no exception
+// set) when the name is not a field of this message.
+const upb_FieldDef* PyUpb_Descriptor_LookupFieldByPyName(PyObject* _self,
+                                                         PyObject* py_name);
+
 // Returns the underlying |def| for a given wrapper object. The caller must
 // have already verified that the given Python object is of the expected type.
 const upb_FileDef* PyUpb_FileDescriptor_GetDef(PyObject* file);
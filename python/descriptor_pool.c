@@ -59,12 +59,12 @@ const upb_MessageDef* PyUpb_DescriptorPool_GetFileProtoDef(void) {
 }
 
 static PyObject* PyUpb_DescriptorPool_DoCreateWithCache(
-    PyTypeObject* type, PyObject* db, PyUpb_WeakMap* obj_cache) {
+    PyTypeObject* type, PyObject* db, PyUpb_ObjCache* obj_cache) {
   PyUpb_DescriptorPool* pool = (void*)PyType_GenericAlloc(type, 0);
   pool->symtab = upb_DefPool_New();
   pool->db = db;
   Py_XINCREF(pool->db);
-  PyUpb_WeakMap_Add(obj_cache, pool->symtab, &pool->ob_base);
+  PyUpb_ObjCache_AddTo(obj_cache, pool->symtab, &pool->ob_base);
   return &pool->ob_base;
 }
 
@@ -217,7 +217,7 @@ static PyObject* PyUpb_DescriptorPool_DoAddSerializedFile(
       goto done;
     }
     const upb_MessageDef* m = PyUpb_DescriptorPool_GetFileProtoDef();
-    if (upb_Message_IsEqual(proto, existing, m)) {
+    if (PyUpb_Message_IsEqualByDef(proto, existing, m)) {
       result = PyUpb_FileDescriptor_Get(file);
       goto done;
     }
@@ -287,6 +287,84 @@ static PyObject* PyUpb_DescriptorPool_AddSerializedFile(
   return PyUpb_DescriptorPool_DoAddSerializedFile(_self, serialized_pb);
 }
 
+/*
+ * PyUpb_DescriptorPool_AddSerializedFileDescriptorSet()
+ *
+ * Implements:
+ *   DescriptorPool.AddSerializedFileDescriptorSet(self, serialized)
+ *
+ * Adds every file in the given serialized FileDescriptorSet to the pool in a
+ * single pass, sharing one arena for all of the parsed file protos instead of
+ * round-tripping each file through AddSerializedFile().  Files must appear
+ * after their dependencies, which is the order protoc emits.  Returns the list
+ * of FileDescriptor objects.
+ */
+static PyObject* PyUpb_DescriptorPool_AddSerializedFileDescriptorSet(
+    PyObject* _self, PyObject* serialized_pb) {
+  PyUpb_DescriptorPool* self = (PyUpb_DescriptorPool*)_self;
+  if (self->db) {
+    PyErr_SetString(
+        PyExc_ValueError,
+        "Cannot call AddSerializedFileDescriptorSet on a DescriptorPool that "
+        "uses a DescriptorDatabase. Add your files to the underlying "
+        "database.");
+    return NULL;
+  }
+
+  upb_Arena* arena = upb_Arena_New();
+  if (!arena) PYUPB_RETURN_OOM;
+  PyObject* result = NULL;
+
+  char* buf;
+  Py_ssize_t size;
+  if (PyBytes_AsStringAndSize(serialized_pb, &buf, &size) < 0) {
+    goto done;
+  }
+
+  google_protobuf_FileDescriptorSet* set =
+      google_protobuf_FileDescriptorSet_parse(buf, size, arena);
+  if (!set) {
+    PyErr_SetString(PyExc_TypeError, "Couldn't parse file content!");
+    goto done;
+  }
+
+  size_t n;
+  const google_protobuf_FileDescriptorProto* const* files =
+      google_protobuf_FileDescriptorSet_file(set, &n);
+  PyObject* list = PyList_New(n);
+  if (!list) goto done;
+
+  for (size_t i = 0; i < n; i++) {
+    const google_protobuf_FileDescriptorProto* proto = files[i];
+    upb_StringView name = google_protobuf_FileDescriptorProto_name(proto);
+    const upb_FileDef* filedef =
+        upb_DefPool_FindFileByNameWithSize(self->symtab, name.data, name.size);
+    if (!filedef) {
+      upb_Status status;
+      upb_Status_Clear(&status);
+      filedef = upb_DefPool_AddFile(self->symtab, proto, &status);
+      if (!filedef) {
+        PyErr_Format(PyExc_TypeError,
+                     "Couldn't build proto file into descriptor pool: %s",
+                     upb_Status_ErrorMessage(&status));
+        Py_DECREF(list);
+        goto done;
+      }
+    }
+    PyObject* file = PyUpb_FileDescriptor_Get(filedef);
+    if (!file) {
+      Py_DECREF(list);
+      goto done;
+    }
+    PyList_SetItem(list, i, file);
+  }
+  result = list;
+
+done:
+  upb_Arena_Free(arena);
+  return result;
+}
+
 static PyObject* PyUpb_DescriptorPool_Add(PyObject* _self,
                                           PyObject* file_desc) {
   PyUpb_DescriptorPool* self = (PyUpb_DescriptorPool*)_self;
@@ -591,6 +669,9 @@ static PyMethodDef PyUpb_DescriptorPool_Methods[] = {
      "Adds the FileDescriptorProto and its types to this pool."},
     {"AddSerializedFile", PyUpb_DescriptorPool_AddSerializedFile, METH_O,
      "Adds a serialized FileDescriptorProto to this pool."},
+    {"AddSerializedFileDescriptorSet",
+     PyUpb_DescriptorPool_AddSerializedFileDescriptorSet, METH_O,
+     "Adds all files in a serialized FileDescriptorSet to this pool."},
     {"FindFileByName", PyUpb_DescriptorPool_FindFileByName, METH_O,
      "Searches for a file descriptor by its .proto name."},
     {"FindMessageTypeByName", PyUpb_DescriptorPool_FindMessageTypeByName,
@@ -69,6 +69,19 @@ static const upb_FieldDef* PyUpb_MapContainer_GetField(
   return (const upb_FieldDef*)(self->field & ~(uintptr_t)1);
 }
 
+static PyUpb_WrapperFreelist* PyUpb_MapContainer_Freelist(
+    PyUpb_ModuleState* state, PyTypeObject* cls) {
+  return cls == state->scalar_map_container_type
+             ? &state->scalar_map_container_freelist
+             : &state->message_map_container_freelist;
+}
+
+static PyObject* PyUpb_MapContainer_Alloc(PyTypeObject* cls) {
+  PyUpb_ModuleState* state = PyUpb_ModuleState_Get();
+  return PyUpb_WrapperFreelist_Alloc(PyUpb_MapContainer_Freelist(state, cls),
+                                     cls, sizeof(PyUpb_MapContainer));
+}
+
 static void PyUpb_MapContainer_Dealloc(void* _self) {
   PyUpb_MapContainer* self = _self;
   Py_DECREF(self->arena);
@@ -79,7 +92,12 @@ static void PyUpb_MapContainer_Dealloc(void* _self) {
   } else {
     PyUpb_ObjCache_Delete(self->ptr.map);
   }
-  PyUpb_Dealloc(_self);
+  PyUpb_ModuleState* state = PyUpb_ModuleState_MaybeGet();
+  if (!state ||
+      !PyUpb_WrapperFreelist_Free(
+          PyUpb_MapContainer_Freelist(state, Py_TYPE(_self)), _self)) {
+    PyUpb_Dealloc(_self);
+  }
 }
 
 PyTypeObject* PyUpb_MapContainer_GetClass(const upb_FieldDef* f) {
@@ -98,7 +116,7 @@ PyObject* PyUpb_MapContainer_NewStub(PyObject* parent, const upb_FieldDef* f,
   // this is not an invariant: the parent could become reified at any time.
   assert(PyUpb_Message_GetIfReified(parent) == NULL);
   PyTypeObject* cls = PyUpb_MapContainer_GetClass(f);
-  PyUpb_MapContainer* map = (void*)PyType_GenericAlloc(cls, 0);
+  PyUpb_MapContainer* map = (void*)PyUpb_MapContainer_Alloc(cls);
   map->arena = arena;
   map->field = (uintptr_t)f | 1;
   map->ptr.parent = parent;
@@ -308,6 +326,69 @@ static PyObject* PyUpb_MapContainer_MergeFrom(PyObject* _self, PyObject* _arg) {
   Py_RETURN_NONE;
 }
 
+// Inserts every entry of |dict| into the map in one pass: the map is
+// pre-sized with upb_Map_Reserve() so no insertion rehashes, and the entry
+// field defs and arena are hoisted out of the loop instead of being
+// re-derived per __setitem__ call.
+static int PyUpb_MapContainer_UpdateFromDict(PyUpb_MapContainer* self,
+                                             PyObject* dict) {
+  Py_ssize_t size = PyDict_Size(dict);
+  if (size == 0) return 0;
+  upb_Map* map = PyUpb_MapContainer_EnsureReified((PyObject*)self);
+  const upb_FieldDef* f = PyUpb_MapContainer_GetField(self);
+  const upb_MessageDef* entry_m = upb_FieldDef_MessageSubDef(f);
+  const upb_FieldDef* key_f = upb_MessageDef_Field(entry_m, 0);
+  const upb_FieldDef* val_f = upb_MessageDef_Field(entry_m, 1);
+  upb_Arena* arena = PyUpb_Arena_Get(self->arena);
+  if (!upb_Map_Reserve(map, upb_Map_Size(map) + size, arena)) {
+    PyErr_NoMemory();
+    return -1;
+  }
+  Py_ssize_t pos = 0;
+  PyObject* key;
+  PyObject* val;
+  while (PyDict_Next(dict, &pos, &key, &val)) {
+    upb_MessageValue u_key, u_val;
+    if (!PyUpb_PyToUpb(key, key_f, &u_key, arena) ||
+        !PyUpb_PyToUpb(val, val_f, &u_val, arena)) {
+      return -1;
+    }
+    if (upb_Map_Insert(map, u_key, u_val, arena) ==
+        kUpb_MapInsertStatus_OutOfMemory) {
+      PyErr_NoMemory();
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// update(other=None, **kwargs), with dict.update() semantics: |other| may be
+// a dict, another mapping, or an iterable of key/value pairs.  Non-dict
+// sources are normalized through dict() so that the batched path above does
+// all of the inserting.
+static PyObject* PyUpb_MapContainer_Update(PyObject* _self, PyObject* args,
+                                           PyObject* kwargs) {
+  PyUpb_MapContainer* self = (PyUpb_MapContainer*)_self;
+  PyObject* other = NULL;
+  if (!PyArg_ParseTuple(args, "|O:update", &other)) return NULL;
+  if (other) {
+    PyObject* dict = NULL;
+    if (!PyDict_Check(other)) {
+      dict = PyObject_CallFunctionObjArgs((PyObject*)&PyDict_Type, other,
+                                          NULL);
+      if (!dict) return NULL;
+      other = dict;
+    }
+    int ok = PyUpb_MapContainer_UpdateFromDict(self, other);
+    Py_XDECREF(dict);
+    if (ok < 0) return NULL;
+  }
+  if (kwargs && PyUpb_MapContainer_UpdateFromDict(self, kwargs) < 0) {
+    return NULL;
+  }
+  Py_RETURN_NONE;
+}
+
 static PyObject* PyUpb_MapContainer_Repr(PyObject* _self) {
   PyUpb_MapContainer* self = (PyUpb_MapContainer*)_self;
   upb_Map* map = PyUpb_MapContainer_GetIfReified(self);
@@ -345,7 +426,7 @@ PyObject* PyUpb_MapContainer_GetOrCreateWrapper(upb_Map* map,
   if (ret) return &ret->ob_base;
 
   PyTypeObject* cls = PyUpb_MapContainer_GetClass(f);
-  ret = (void*)PyType_GenericAlloc(cls, 0);
+  ret = (void*)PyUpb_MapContainer_Alloc(cls);
   ret->arena = arena;
   ret->field = (uintptr_t)f;
   ret->ptr.map = map;
@@ -370,6 +451,9 @@ static PyMethodDef PyUpb_ScalarMapContainer_Methods[] = {
      "Return the class used to build Entries of (key, value) pairs."},
     {"MergeFrom", PyUpb_MapContainer_MergeFrom, METH_O,
      "Merges a map into the current map."},
+    {"update", (PyCFunction)PyUpb_MapContainer_Update,
+     METH_VARARGS | METH_KEYWORDS,
+     "Updates the map with key/value pairs from a mapping or iterable."},
     /*
    { "__deepcopy__", (PyCFunction)DeepCopy, METH_VARARGS,
      "Makes a deep copy of the class." },
@@ -451,8 +535,9 @@ typedef struct {
 
 static PyObject* PyUpb_MapIterator_New(PyUpb_MapContainer* map) {
   PyUpb_ModuleState* state = PyUpb_ModuleState_Get();
-  PyUpb_MapIterator* iter =
-      (void*)PyType_GenericAlloc(state->map_iterator_type, 0);
+  PyUpb_MapIterator* iter = (void*)PyUpb_WrapperFreelist_Alloc(
+      &state->map_iterator_freelist, state->map_iterator_type,
+      sizeof(PyUpb_MapIterator));
   iter->map = map;
   iter->iter = kUpb_Map_Begin;
   iter->version = map->version;
@@ -463,7 +548,11 @@ static PyObject* PyUpb_MapIterator_New(PyUpb_MapContainer* map) {
 static void PyUpb_MapIterator_Dealloc(void* _self) {
   PyUpb_MapIterator* self = (PyUpb_MapIterator*)_self;
   Py_DECREF(&self->map->ob_base);
-  PyUpb_Dealloc(_self);
+  PyUpb_ModuleState* state = PyUpb_ModuleState_MaybeGet();
+  if (!state ||
+      !PyUpb_WrapperFreelist_Free(&state->map_iterator_freelist, _self)) {
+    PyUpb_Dealloc(_self);
+  }
 }
 
 PyObject* PyUpb_MapIterator_IterNext(PyObject* _self) {
@@ -281,6 +281,26 @@ static bool PyUpb_Message_LookupName(PyUpb_Message* self, PyObject* py_name,
                                      const upb_OneofDef** o,
                                      PyObject* exc_type) {
   assert(f || o);
+  const upb_MessageDef* cached_msgdef = _PyUpb_Message_GetMsgdef(self);
+
+  // Fast path: kwarg and attribute names are interned strs, which the
+  // descriptor's name cache resolves by pointer identity without decoding
+  // UTF-8.  Misses (oneof names, bytes names, unknown names) fall through to
+  // the slow path below, which owns the error reporting.
+  if (f && PyUnicode_Check(py_name)) {
+    PyObject* descriptor = PyUpb_Descriptor_Get(cached_msgdef);
+    if (descriptor) {
+      const upb_FieldDef* cached =
+          PyUpb_Descriptor_LookupFieldByPyName(descriptor, py_name);
+      Py_DECREF(descriptor);
+      if (cached) {
+        *f = cached;
+        if (o) *o = NULL;
+        return true;
+      }
+    }
+  }
+
   Py_ssize_t size;
   const char* name = NULL;
   if (PyUnicode_Check(py_name)) {
@@ -294,7 +314,7 @@ static bool PyUpb_Message_LookupName(PyUpb_Message* self, PyObject* py_name,
                  py_name);
     return false;
   }
-  const upb_MessageDef* msgdef = _PyUpb_Message_GetMsgdef(self);
+  const upb_MessageDef* msgdef = cached_msgdef;
 
   if (!upb_MessageDef_FindByNameWithSize(msgdef, name, size, f, o)) {
     if (exc_type) {
@@ -590,7 +610,7 @@ static bool PyUpb_Message_IsEqual(PyUpb_Message* m1, PyObject* _m2) {
   const bool e2 = PyUpb_Message_IsEmpty(m2_msg, m1_msgdef, symtab);
   if (e1 || e2) return e1 && e2;
 
-  return upb_Message_IsEqual(m1_msg, m2_msg, m1_msgdef);
+  return PyUpb_Message_IsEqualByDef(m1_msg, m2_msg, m1_msgdef);
 }
 
 static const upb_FieldDef* PyUpb_Message_InitAsMsg(PyUpb_Message* m,
@@ -1255,21 +1275,20 @@ static PyObject* PyUpb_Message_UnknownFields(PyObject* _self, PyObject* arg) {
   return NULL;
 }
 
+// Payloads at least this large release the GIL around upb_Decode() and
+// upb_Encode() so that other Python threads can run; below it the GIL
+// round-trip costs more than the wire work we would overlap.
+enum { kPyUpb_GilReleaseThreshold = 64 * 1024 };
+
 PyObject* PyUpb_Message_MergeFromString(PyObject* _self, PyObject* arg) {
   PyUpb_Message* self = (void*)_self;
-  char* buf;
-  Py_ssize_t size;
-  PyObject* bytes = NULL;
-
-  if (PyMemoryView_Check(arg)) {
-    bytes = PyBytes_FromObject(arg);
-    // Cannot fail when passed something of the correct type.
-    int err = PyBytes_AsStringAndSize(bytes, &buf, &size);
-    (void)err;
-    assert(err >= 0);
-  } else if (PyBytes_AsStringAndSize(arg, &buf, &size) < 0) {
+  Py_buffer buffer;
+
+  if (PyObject_GetBuffer(arg, &buffer, PyBUF_SIMPLE) < 0) {
     return NULL;
   }
+  const char* buf = buffer.buf;
+  Py_ssize_t size = buffer.len;
 
   PyUpb_Message_EnsureReified(self);
   const upb_MessageDef* msgdef = _PyUpb_Message_GetMsgdef(self);
@@ -1282,9 +1301,21 @@ PyObject* PyUpb_Message_MergeFromString(PyObject* _self, PyObject* arg) {
   int options = upb_DecodeOptions_MaxDepth(
       state->allow_oversize_protos ? UINT16_MAX
                                    : kUpb_WireFormat_DefaultDepthLimit);
-  upb_DecodeStatus status =
-      upb_Decode(buf, size, self->ptr.msg, layout, extreg, options, arena);
-  Py_XDECREF(bytes);
+  upb_DecodeStatus status;
+  if (size >= kPyUpb_GilReleaseThreshold) {
+    // The decoder only reads |buf| (pinned by the Py_buffer) and writes into
+    // the arena, never touching the interpreter, so it can run without the
+    // GIL.  Concurrent mutation of this message tree from another thread is
+    // undefined with or without the GIL held here.
+    Py_BEGIN_ALLOW_THREADS;
+    status = upb_Decode(buf, size, self->ptr.msg, layout, extreg, options,
+                        arena);
+    Py_END_ALLOW_THREADS;
+  } else {
+    status = upb_Decode(buf, size, self->ptr.msg, layout, extreg, options,
+                        arena);
+  }
+  PyBuffer_Release(&buffer);
   if (status != kUpb_DecodeStatus_Ok) {
     PyErr_Format(state->decode_error_class, "Error parsing message");
     return NULL;
@@ -1518,45 +1549,50 @@ done:
   Py_DECREF(errors);
 }
 
-PyObject* PyUpb_Message_SerializeInternal(PyObject* _self, PyObject* args,
-                                          PyObject* kwargs,
-                                          bool check_required) {
+// Encodes the message into |arena| and points *pb/*size at the result. A
+// stub message yields a zero-length result with *pb == NULL. On failure
+// sets a Python error and returns false.
+static bool PyUpb_Message_EncodeMessage(PyObject* _self, bool check_required,
+                                        int deterministic, upb_Arena* arena,
+                                        char** pb, size_t* size) {
   PyUpb_Message* self = (void*)_self;
-  if (!PyUpb_Message_Verify((PyObject*)self)) return NULL;
-  static const char* kwlist[] = {"deterministic", NULL};
-  int deterministic = 0;
-  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|p", (char**)(kwlist),
-                                   &deterministic)) {
-    return NULL;
-  }
-
   const upb_MessageDef* msgdef = _PyUpb_Message_GetMsgdef(self);
   if (PyUpb_Message_IsStub(self)) {
     // Nothing to serialize, but we do have to check whether the message is
     // initialized.
     PyUpb_ModuleState* state = PyUpb_ModuleState_Get();
     PyObject* errors = PyUpb_Message_FindInitializationErrors(_self, NULL);
-    if (!errors) return NULL;
+    if (!errors) return false;
     if (PyList_Size(errors) == 0) {
       Py_DECREF(errors);
-      return PyBytes_FromStringAndSize(NULL, 0);
+      *pb = NULL;
+      *size = 0;
+      return true;
     }
     PyUpb_Message_ReportInitializationErrors(msgdef, errors,
                                              state->encode_error_class);
-    return NULL;
+    return false;
   }
 
-  upb_Arena* arena = upb_Arena_New();
   const upb_MiniTable* layout = upb_MessageDef_MiniTable(msgdef);
-  size_t size = 0;
   // Python does not currently have any effective limit on serialization depth.
   int options = upb_EncodeOptions_MaxDepth(UINT16_MAX);
   if (check_required) options |= kUpb_EncodeOption_CheckRequired;
   if (deterministic) options |= kUpb_EncodeOption_Deterministic;
-  char* pb;
-  upb_EncodeStatus status =
-      upb_Encode(self->ptr.msg, layout, options, arena, &pb, &size);
-  PyObject* ret = NULL;
+  upb_EncodeStatus status;
+  // The serialized size is unknown until we encode, so gate the GIL release
+  // on the footprint of the arena holding the message, which bounds how much
+  // data there is to serialize.
+  if (upb_Arena_SpaceAllocated(PyUpb_Arena_Get(self->arena)) >=
+      kPyUpb_GilReleaseThreshold) {
+    // The encoder only reads the message and writes into the function-local
+    // |arena|, never touching the interpreter, so it can run without the GIL.
+    Py_BEGIN_ALLOW_THREADS;
+    status = upb_Encode(self->ptr.msg, layout, options, arena, pb, size);
+    Py_END_ALLOW_THREADS;
+  } else {
+    status = upb_Encode(self->ptr.msg, layout, options, arena, pb, size);
+  }
 
   if (status != kUpb_EncodeStatus_Ok) {
     PyUpb_ModuleState* state = PyUpb_ModuleState_Get();
@@ -1567,10 +1603,69 @@ PyObject* PyUpb_Message_SerializeInternal(PyObject* _self, PyObject* args,
     } else {
       PyErr_Format(state->encode_error_class, "Failed to serialize proto");
     }
+    return false;
+  }
+  return true;
+}
+
+PyObject* PyUpb_Message_SerializeInternal(PyObject* _self, PyObject* args,
+                                          PyObject* kwargs,
+                                          bool check_required) {
+  PyUpb_Message* self = (void*)_self;
+  if (!PyUpb_Message_Verify((PyObject*)self)) return NULL;
+  static const char* kwlist[] = {"deterministic", NULL};
+  int deterministic = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|p", (char**)(kwlist),
+                                   &deterministic)) {
+    return NULL;
+  }
+
+  upb_Arena* arena = upb_Arena_New();
+  char* pb = NULL;
+  size_t size = 0;
+  PyObject* ret = NULL;
+  if (PyUpb_Message_EncodeMessage(_self, check_required, deterministic, arena,
+                                  &pb, &size)) {
+    ret = PyBytes_FromStringAndSize(pb, size);
+  }
+  upb_Arena_Free(arena);
+  return ret;
+}
+
+static PyObject* PyUpb_Message_SerializeToBuffer(PyObject* _self,
+                                                 PyObject* args,
+                                                 PyObject* kwargs) {
+  PyUpb_Message* self = (void*)_self;
+  if (!PyUpb_Message_Verify((PyObject*)self)) return NULL;
+  static const char* kwlist[] = {"buffer", "deterministic", NULL};
+  PyObject* buffer_obj = NULL;
+  int deterministic = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|p", (char**)(kwlist),
+                                   &buffer_obj, &deterministic)) {
+    return NULL;
+  }
+
+  upb_Arena* arena = upb_Arena_New();
+  char* pb = NULL;
+  size_t size = 0;
+  PyObject* ret = NULL;
+  if (!PyUpb_Message_EncodeMessage(_self, /* check_required= */ true,
+                                   deterministic, arena, &pb, &size)) {
     goto done;
   }
 
-  ret = PyBytes_FromStringAndSize(pb, size);
+  Py_buffer view;
+  if (PyObject_GetBuffer(buffer_obj, &view, PyBUF_WRITABLE) < 0) goto done;
+  if ((size_t)view.len < size) {
+    PyErr_Format(PyExc_ValueError,
+                 "Buffer of %zd bytes is too small for message of %zu bytes",
+                 view.len, size);
+    PyBuffer_Release(&view);
+    goto done;
+  }
+  if (size) memcpy(view.buf, pb, size);
+  PyBuffer_Release(&view);
+  ret = PyLong_FromSize_t(size);
 
 done:
   upb_Arena_Free(arena);
@@ -1681,6 +1776,10 @@ static PyMethodDef PyUpb_Message_Methods[] = {
      (PyCFunction)PyUpb_Message_SerializePartialToString,
      METH_VARARGS | METH_KEYWORDS,
      "Serializes the message to a string, even if it isn't initialized."},
+    {"SerializeToBuffer", (PyCFunction)PyUpb_Message_SerializeToBuffer,
+     METH_VARARGS | METH_KEYWORDS,
+     "Serializes the message into a writable buffer and returns the number "
+     "of bytes written."},
     {"SerializeToString", (PyCFunction)PyUpb_Message_SerializeToString,
      METH_VARARGS | METH_KEYWORDS,
      "Serializes the message to a string, only for initialized messages."},
@@ -36,9 +36,58 @@
 #include "python/repeated.h"
 #include "python/unknown_fields.h"
 
+// -----------------------------------------------------------------------------
+// Wrapper freelists
+// -----------------------------------------------------------------------------
+
+// Free objects are chained through the first pointer-sized slot after the
+// object header; every recycled type's body starts with a pointer member, so
+// the slot is always present.
+static PyObject** PyUpb_WrapperFreelist_Link(PyObject* obj) {
+  return (PyObject**)(obj + 1);
+}
+
+PyObject* PyUpb_WrapperFreelist_Alloc(PyUpb_WrapperFreelist* list,
+                                      PyTypeObject* type, size_t basicsize) {
+  PyObject* obj = list->head;
+  if (obj && Py_TYPE(obj) == type) {
+    list->head = *PyUpb_WrapperFreelist_Link(obj);
+    list->count--;
+    // Match what PyType_GenericAlloc() hands out: zeroed body, refcount of
+    // one.  The object kept its reference to |type| while it sat on the
+    // freelist, so the type's refcount is already correct.
+    memset((char*)obj + sizeof(PyObject), 0, basicsize - sizeof(PyObject));
+    obj->ob_refcnt = 1;
+    return obj;
+  }
+  return PyType_GenericAlloc(type, 0);
+}
+
+bool PyUpb_WrapperFreelist_Free(PyUpb_WrapperFreelist* list, PyObject* obj) {
+  if (list->count >= kPyUpb_WrapperFreelist_MaxCount) return false;
+  *PyUpb_WrapperFreelist_Link(obj) = list->head;
+  list->head = obj;
+  list->count++;
+  return true;
+}
+
+void PyUpb_WrapperFreelist_Drain(PyUpb_WrapperFreelist* list) {
+  while (list->head) {
+    PyObject* obj = list->head;
+    list->head = *PyUpb_WrapperFreelist_Link(obj);
+    PyUpb_Dealloc(obj);
+  }
+  list->count = 0;
+}
+
 static void PyUpb_ModuleDealloc(void* module) {
   PyUpb_ModuleState* s = PyModule_GetState(module);
-  PyUpb_WeakMap_Free(s->obj_cache);
+  PyUpb_WrapperFreelist_Drain(&s->map_iterator_freelist);
+  PyUpb_WrapperFreelist_Drain(&s->message_map_container_freelist);
+  PyUpb_WrapperFreelist_Drain(&s->scalar_map_container_freelist);
+  PyUpb_WrapperFreelist_Drain(&s->repeated_composite_container_freelist);
+  PyUpb_WrapperFreelist_Drain(&s->repeated_scalar_container_freelist);
+  PyUpb_ObjCache_Free(s->obj_cache);
   if (s->c_descriptor_symtab) {
     upb_DefPool_Free(s->c_descriptor_symtab);
   }
@@ -187,13 +236,70 @@ void PyUpb_WeakMap_DeleteIter(PyUpb_WeakMap* map, intptr_t* iter) {
 // ObjCache
 // -----------------------------------------------------------------------------
 
-PyUpb_WeakMap* PyUpb_ObjCache_Instance(void) {
+// The cache is consulted on every wrapper creation, including from paths
+// that release the GIL around parsing, and under free-threaded Python (PEP
+// 703) those paths run concurrently.  A single map would serialize them, so
+// the cache is split into shards selected by pointer; threads touching
+// unrelated objects take different locks and proceed in parallel.  With the
+// GIL the per-shard locks are always uncontended.
+#define kPyUpb_ObjCache_ShardCount 16  // Must be a power of two.
+
+typedef struct {
+  PyThread_type_lock lock;
+  upb_inttable table;
+  // Per-shard arena: inserts into different shards can run concurrently, and
+  // arena allocation is not thread-safe, so the shards cannot share one.
+  upb_Arena* arena;
+} PyUpb_ObjCacheShard;
+
+struct PyUpb_ObjCache {
+  PyUpb_ObjCacheShard shards[kPyUpb_ObjCache_ShardCount];
+};
+
+PyUpb_ObjCache* PyUpb_ObjCache_New(void) {
+  PyUpb_ObjCache* cache = PyMem_Malloc(sizeof(*cache));
+  for (int i = 0; i < kPyUpb_ObjCache_ShardCount; i++) {
+    PyUpb_ObjCacheShard* shard = &cache->shards[i];
+    shard->lock = PyThread_allocate_lock();
+    shard->arena = upb_Arena_New();
+    upb_inttable_init(&shard->table, shard->arena);
+  }
+  return cache;
+}
+
+void PyUpb_ObjCache_Free(PyUpb_ObjCache* cache) {
+  for (int i = 0; i < kPyUpb_ObjCache_ShardCount; i++) {
+    PyUpb_ObjCacheShard* shard = &cache->shards[i];
+    PyThread_free_lock(shard->lock);
+    upb_Arena_Free(shard->arena);
+  }
+  PyMem_Free(cache);
+}
+
+static PyUpb_ObjCacheShard* PyUpb_ObjCache_GetShard(PyUpb_ObjCache* cache,
+                                                    const void* key) {
+  // The shift in PyUpb_WeakMap_GetKey() already removed the always-zero
+  // alignment bits, so the low bits of the shifted key are well distributed.
+  uintptr_t k = PyUpb_WeakMap_GetKey(key);
+  return &cache->shards[k & (kPyUpb_ObjCache_ShardCount - 1)];
+}
+
+PyUpb_ObjCache* PyUpb_ObjCache_Instance(void) {
   PyUpb_ModuleState* state = PyUpb_ModuleState_Get();
   return state->obj_cache;
 }
 
+void PyUpb_ObjCache_AddTo(PyUpb_ObjCache* cache, const void* key,
+                          PyObject* py_obj) {
+  PyUpb_ObjCacheShard* shard = PyUpb_ObjCache_GetShard(cache, key);
+  PyThread_acquire_lock(shard->lock, WAIT_LOCK);
+  upb_inttable_insert(&shard->table, PyUpb_WeakMap_GetKey(key),
+                      upb_value_ptr(py_obj), shard->arena);
+  PyThread_release_lock(shard->lock);
+}
+
 void PyUpb_ObjCache_Add(const void* key, PyObject* py_obj) {
-  PyUpb_WeakMap_Add(PyUpb_ObjCache_Instance(), key, py_obj);
+  PyUpb_ObjCache_AddTo(PyUpb_ObjCache_Instance(), key, py_obj);
 }
 
 void PyUpb_ObjCache_Delete(const void* key) {
@@ -205,11 +311,31 @@ void PyUpb_ObjCache_Delete(const void* key) {
     // map.
     return;
   }
-  PyUpb_WeakMap_Delete(state->obj_cache, key);
+  PyUpb_ObjCacheShard* shard = PyUpb_ObjCache_GetShard(state->obj_cache, key);
+  PyThread_acquire_lock(shard->lock, WAIT_LOCK);
+  upb_value val;
+  bool removed =
+      upb_inttable_remove(&shard->table, PyUpb_WeakMap_GetKey(key), &val);
+  PyThread_release_lock(shard->lock);
+  (void)removed;
+  assert(removed);
 }
 
 PyObject* PyUpb_ObjCache_Get(const void* key) {
-  return PyUpb_WeakMap_Get(PyUpb_ObjCache_Instance(), key);
+  PyUpb_ObjCacheShard* shard =
+      PyUpb_ObjCache_GetShard(PyUpb_ObjCache_Instance(), key);
+  PyObject* ret = NULL;
+  PyThread_acquire_lock(shard->lock, WAIT_LOCK);
+  upb_value val;
+  if (upb_inttable_lookup(&shard->table, PyUpb_WeakMap_GetKey(key), &val)) {
+    ret = upb_value_getptr(val);
+    // The INCREF must happen before the lock is dropped: without the GIL a
+    // concurrent Dealloc() could otherwise delete the entry and free the
+    // object between our lookup and our taking a reference.
+    Py_INCREF(ret);
+  }
+  PyThread_release_lock(shard->lock);
+  return ret;
 }
 
 // -----------------------------------------------------------------------------
@@ -334,7 +460,7 @@ __attribute__((visibility("default"))) PyMODINIT_FUNC PyInit__message(void) {
 
   state->allow_oversize_protos = false;
   state->wkt_bases = NULL;
-  state->obj_cache = PyUpb_WeakMap_New();
+  state->obj_cache = PyUpb_ObjCache_New();
   state->c_descriptor_symtab = NULL;
 
   if (!PyUpb_InitDescriptorContainers(m) || !PyUpb_InitDescriptorPool(m) ||
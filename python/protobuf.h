@@ -55,6 +55,42 @@
 struct PyUpb_WeakMap;
 typedef struct PyUpb_WeakMap PyUpb_WeakMap;
 
+struct PyUpb_ObjCache;
+typedef struct PyUpb_ObjCache PyUpb_ObjCache;
+
+// -----------------------------------------------------------------------------
+// Wrapper freelists
+// -----------------------------------------------------------------------------
+
+// Recycles the memory of hot, fixed-size wrapper objects (repeated and map
+// containers, map iterators) instead of round-tripping it through the Python
+// allocator: dealloc pushes the dying object onto its type's freelist
+// (keeping the object's reference to its heap type alive), and the next
+// allocation of that exact type pops it, zeroes the body, and resurrects it
+// with a refcount of one.  Message wrappers are deliberately not recycled:
+// their classes are GC-tracked heap subclasses with per-class sizes, and the
+// object caches already keep them stable across repeated attribute access.
+
+typedef struct {
+  PyObject* head;  // Free objects, chained through their first body word.
+  int count;
+} PyUpb_WrapperFreelist;
+
+enum { kPyUpb_WrapperFreelist_MaxCount = 64 };
+
+// Pops a recycled object of |type|, or falls back to PyType_GenericAlloc().
+// |basicsize| must be the tp_basicsize of |type|.
+PyObject* PyUpb_WrapperFreelist_Alloc(PyUpb_WrapperFreelist* list,
+                                      PyTypeObject* type, size_t basicsize);
+
+// Captures a dying object (refcount zero, fields already released) for
+// reuse.  Returns false if the freelist is full, in which case the caller
+// must free the object with PyUpb_Dealloc().
+bool PyUpb_WrapperFreelist_Free(PyUpb_WrapperFreelist* list, PyObject* obj);
+
+// Frees all captured objects; called at module teardown.
+void PyUpb_WrapperFreelist_Drain(PyUpb_WrapperFreelist* list);
+
 // -----------------------------------------------------------------------------
 // ModuleState
 // -----------------------------------------------------------------------------
@@ -88,6 +124,9 @@ typedef struct {
   PyTypeObject* map_iterator_type;
   PyTypeObject* message_map_container_type;
   PyTypeObject* scalar_map_container_type;
+  PyUpb_WrapperFreelist map_iterator_freelist;
+  PyUpb_WrapperFreelist message_map_container_freelist;
+  PyUpb_WrapperFreelist scalar_map_container_freelist;
 
   // From message.c
   PyObject* decode_error_class;
@@ -103,11 +142,13 @@ typedef struct {
   bool allow_oversize_protos;
   PyObject* wkt_bases;
   PyTypeObject* arena_type;
-  PyUpb_WeakMap* obj_cache;
+  PyUpb_ObjCache* obj_cache;
 
   // From repeated.c
   PyTypeObject* repeated_composite_container_type;
   PyTypeObject* repeated_scalar_container_type;
+  PyUpb_WrapperFreelist repeated_composite_container_freelist;
+  PyUpb_WrapperFreelist repeated_scalar_container_freelist;
 
   // From unknown_fields.c
   PyTypeObject* unknown_fields_type;
@@ -173,12 +214,23 @@ void PyUpb_WeakMap_DeleteIter(PyUpb_WeakMap* map, intptr_t* iter);
 // ObjCache
 // -----------------------------------------------------------------------------
 
-// The object cache is a global WeakMap for mapping upb objects to the
-// corresponding wrapper.
+// The object cache is a global weak map for mapping upb objects to the
+// corresponding wrapper.  Unlike PyUpb_WeakMap it is sharded by pointer, with
+// a lock per shard: it is consulted on every wrapper creation, including from
+// paths that release the GIL around parsing, so lookups of unrelated objects
+// must be able to proceed in parallel (PEP 703).
+PyUpb_ObjCache* PyUpb_ObjCache_New(void);
+void PyUpb_ObjCache_Free(PyUpb_ObjCache* cache);
+
 void PyUpb_ObjCache_Add(const void* key, PyObject* py_obj);
 void PyUpb_ObjCache_Delete(const void* key);
 PyObject* PyUpb_ObjCache_Get(const void* key);  // returns NULL if not present.
-PyUpb_WeakMap* PyUpb_ObjCache_Instance(void);
+PyUpb_ObjCache* PyUpb_ObjCache_Instance(void);
+
+// Like PyUpb_ObjCache_Add(), but for use during module startup when the
+// module state cannot yet be looked up from thread-local state.
+void PyUpb_ObjCache_AddTo(PyUpb_ObjCache* cache, const void* key,
+                          PyObject* py_obj);
 
 // -----------------------------------------------------------------------------
 // Arena
@@ -135,6 +135,20 @@ upb_Array* PyUpb_RepeatedContainer_EnsureReified(PyObject* _self) {
   return arr;
 }
 
+static PyUpb_WrapperFreelist* PyUpb_RepeatedContainer_Freelist(
+    PyUpb_ModuleState* state, PyTypeObject* cls) {
+  return cls == state->repeated_scalar_container_type
+             ? &state->repeated_scalar_container_freelist
+             : &state->repeated_composite_container_freelist;
+}
+
+static PyObject* PyUpb_RepeatedContainer_Alloc(PyTypeObject* cls) {
+  PyUpb_ModuleState* state = PyUpb_ModuleState_Get();
+  return PyUpb_WrapperFreelist_Alloc(
+      PyUpb_RepeatedContainer_Freelist(state, cls), cls,
+      sizeof(PyUpb_RepeatedContainer));
+}
+
 static void PyUpb_RepeatedContainer_Dealloc(PyObject* _self) {
   PyUpb_RepeatedContainer* self = (PyUpb_RepeatedContainer*)_self;
   Py_DECREF(self->arena);
@@ -146,7 +160,12 @@ static void PyUpb_RepeatedContainer_Dealloc(PyObject* _self) {
     PyUpb_ObjCache_Delete(self->ptr.arr);
   }
   Py_DECREF(PyUpb_RepeatedContainer_GetFieldDescriptor(self));
-  PyUpb_Dealloc(self);
+  PyUpb_ModuleState* state = PyUpb_ModuleState_MaybeGet();
+  if (!state ||
+      !PyUpb_WrapperFreelist_Free(
+          PyUpb_RepeatedContainer_Freelist(state, Py_TYPE(_self)), _self)) {
+    PyUpb_Dealloc(self);
+  }
 }
 
 static PyTypeObject* PyUpb_RepeatedContainer_GetClass(const upb_FieldDef* f) {
@@ -169,7 +188,8 @@ PyObject* PyUpb_RepeatedContainer_NewStub(PyObject* parent,
   // this is not an invariant: the parent could become reified at any time.
   assert(PyUpb_Message_GetIfReified(parent) == NULL);
   PyTypeObject* cls = PyUpb_RepeatedContainer_GetClass(f);
-  PyUpb_RepeatedContainer* repeated = (void*)PyType_GenericAlloc(cls, 0);
+  PyUpb_RepeatedContainer* repeated =
+      (void*)PyUpb_RepeatedContainer_Alloc(cls);
   repeated->arena = arena;
   repeated->field = (uintptr_t)PyUpb_FieldDescriptor_Get(f) | 1;
   repeated->ptr.parent = parent;
@@ -185,7 +205,8 @@ PyObject* PyUpb_RepeatedContainer_GetOrCreateWrapper(upb_Array* arr,
   if (ret) return ret;
 
   PyTypeObject* cls = PyUpb_RepeatedContainer_GetClass(f);
-  PyUpb_RepeatedContainer* repeated = (void*)PyType_GenericAlloc(cls, 0);
+  PyUpb_RepeatedContainer* repeated =
+      (void*)PyUpb_RepeatedContainer_Alloc(cls);
   repeated->arena = arena;
   repeated->field = (uintptr_t)PyUpb_FieldDescriptor_Get(f);
   repeated->ptr.arr = arr;
@@ -201,7 +222,7 @@ static PyObject* PyUpb_RepeatedContainer_MergeFrom(PyObject* _self,
 PyObject* PyUpb_RepeatedContainer_DeepCopy(PyObject* _self, PyObject* value) {
   PyUpb_RepeatedContainer* self = (PyUpb_RepeatedContainer*)_self;
   PyUpb_RepeatedContainer* clone =
-      (void*)PyType_GenericAlloc(Py_TYPE(_self), 0);
+      (void*)PyUpb_RepeatedContainer_Alloc(Py_TYPE(_self));
   if (clone == NULL) return NULL;
   const upb_FieldDef* f = PyUpb_RepeatedContainer_GetField(self);
   clone->arena = PyUpb_Arena_New();
@@ -769,6 +790,103 @@ static PyMethodDef PyUpb_RepeatedScalarContainer_Methods[] = {
      "Merges a repeated container into the current container."},
     {NULL, NULL}};
 
+// The buffer protocol is not available under the limited API before Python
+// 3.11 (Py_buffer and the Py_bf_* slots were added to it in 3.11).
+#if !defined(Py_LIMITED_API) || Py_LIMITED_API >= 0x030b0000
+#define PYUPB_HAVE_BUFFER_PROTOCOL 1
+#endif
+
+#ifdef PYUPB_HAVE_BUFFER_PROTOCOL
+
+// Returns the struct-module format character and element size for |f|, or
+// NULL for element types (string, bytes) that are not stored as flat data.
+static const char* PyUpb_RepeatedScalarContainer_Format(const upb_FieldDef* f,
+                                                        Py_ssize_t* itemsize) {
+  switch (upb_FieldDef_CType(f)) {
+    case kUpb_CType_Bool:
+      *itemsize = 1;
+      return "?";
+    case kUpb_CType_Float:
+      *itemsize = 4;
+      return "f";
+    case kUpb_CType_Double:
+      *itemsize = 8;
+      return "d";
+    case kUpb_CType_Int32:
+    case kUpb_CType_Enum:
+      *itemsize = 4;
+      return "i";
+    case kUpb_CType_UInt32:
+      *itemsize = 4;
+      return "I";
+    case kUpb_CType_Int64:
+      *itemsize = 8;
+      return "q";
+    case kUpb_CType_UInt64:
+      *itemsize = 8;
+      return "Q";
+    default:
+      return NULL;
+  }
+}
+
+// Exports the upb_Array's contiguous storage as a read-only 1-D buffer, so
+// that numpy.frombuffer()/memoryview() can lift a scalar repeated field out
+// of a message without boxing each element.  The view holds a reference to
+// the container (and through it the PyUpb_Arena object), which keeps the
+// data alive: arenas never free individual allocations, so the memory stays
+// valid even if the repeated field is resized while a view is outstanding
+// (the view then sees the old contents).
+static int PyUpb_RepeatedScalarContainer_GetBuffer(PyObject* _self,
+                                                   Py_buffer* view,
+                                                   int flags) {
+  PyUpb_RepeatedContainer* self = (PyUpb_RepeatedContainer*)_self;
+  view->obj = NULL;
+  if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError,
+                    "repeated field buffers are read-only");
+    return -1;
+  }
+  const upb_FieldDef* f = PyUpb_RepeatedContainer_GetField(self);
+  Py_ssize_t itemsize;
+  const char* format = PyUpb_RepeatedScalarContainer_Format(f, &itemsize);
+  if (!format) {
+    PyErr_SetString(PyExc_BufferError,
+                    "string and bytes repeated fields do not support the "
+                    "buffer protocol");
+    return -1;
+  }
+  upb_Array* arr = PyUpb_RepeatedContainer_GetIfReified(self);
+  Py_ssize_t size = arr ? (Py_ssize_t)upb_Array_Size(arr) : 0;
+  Py_ssize_t* dims = PyMem_Malloc(2 * sizeof(Py_ssize_t));
+  if (!dims) {
+    PyErr_NoMemory();
+    return -1;
+  }
+  dims[0] = size;      // shape
+  dims[1] = itemsize;  // stride
+  Py_INCREF(_self);
+  view->obj = _self;
+  view->buf = size ? (void*)upb_Array_DataPtr(arr) : NULL;
+  view->len = size * itemsize;
+  view->readonly = 1;
+  view->itemsize = itemsize;
+  view->format = (flags & PyBUF_FORMAT) == PyBUF_FORMAT ? (char*)format : NULL;
+  view->ndim = 1;
+  view->shape = (flags & PyBUF_ND) == PyBUF_ND ? &dims[0] : NULL;
+  view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &dims[1] : NULL;
+  view->suboffsets = NULL;
+  view->internal = dims;
+  return 0;
+}
+
+static void PyUpb_RepeatedScalarContainer_ReleaseBuffer(PyObject* _self,
+                                                        Py_buffer* view) {
+  PyMem_Free(view->internal);
+}
+
+#endif  // PYUPB_HAVE_BUFFER_PROTOCOL
+
 static PyType_Slot PyUpb_RepeatedScalarContainer_Slots[] = {
     {Py_tp_dealloc, PyUpb_RepeatedContainer_Dealloc},
     {Py_tp_methods, PyUpb_RepeatedScalarContainer_Methods},
@@ -782,6 +900,10 @@ static PyType_Slot PyUpb_RepeatedScalarContainer_Slots[] = {
     {Py_mp_ass_subscript, PyUpb_RepeatedContainer_AssignSubscript},
     {Py_tp_richcompare, PyUpb_RepeatedContainer_RichCompare},
     {Py_tp_hash, PyObject_HashNotImplemented},
+#ifdef PYUPB_HAVE_BUFFER_PROTOCOL
+    {Py_bf_getbuffer, PyUpb_RepeatedScalarContainer_GetBuffer},
+    {Py_bf_releasebuffer, PyUpb_RepeatedScalarContainer_ReleaseBuffer},
+#endif
     {0, NULL}};
 
 static PyType_Spec PyUpb_RepeatedScalarContainer_Spec = {
@@ -0,0 +1,101 @@
+#!/usr/bin/python
+#
+# Copyright (c) 2009-2021, Google LLC
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#     * Neither the name of Google LLC nor the
+#       names of its contributors may be used to endorse or promote products
+#       derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+"""Converts upb decoder branch traces into a hints header.
+
+Build the decoder with -DUPB_DECODE_BRANCH_TRACE, run a representative
+workload, and write the counters with upb_DecodeBranchTrace_Dump(); each
+line of the dump is "site taken total".  This script merges one or more
+such dumps and emits a header that redefines the decoder's per-site branch
+expectations.  Rebuild (without the trace flag) passing
+
+    -DUPB_DECODE_HINTS_FILE='"path/to/hints.h"'
+
+to get a decoder specialized for the traced workload.  See
+upb/wire/decode_trace.h for the mechanism.
+"""
+
+import argparse
+import sys
+
+
+def ParseTrace(path, sites):
+  with open(path) as f:
+    for lineno, line in enumerate(f, 1):
+      line = line.strip()
+      if not line or line.startswith("#"):
+        continue
+      parts = line.split()
+      if len(parts) != 3:
+        raise SystemExit(f"{path}:{lineno}: expected 'site taken total'")
+      site, taken, total = parts[0], int(parts[1]), int(parts[2])
+      old_taken, old_total = sites.get(site, (0, 0))
+      sites[site] = (old_taken + taken, old_total + total)
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument("traces", nargs="+", help="trace dump file(s) to merge")
+  parser.add_argument("-o", "--output", default="-",
+                      help="output header path (default: stdout)")
+  parser.add_argument("--min-count", type=int, default=1000,
+                      help="sites with fewer samples than this keep their "
+                           "built-in default (default: %(default)s)")
+  args = parser.parse_args()
+
+  sites = {}
+  for path in args.traces:
+    ParseTrace(path, sites)
+
+  lines = [
+      "// Generated by tools/decode_trace_to_hints.py; do not edit.",
+      "//",
+      "// Per-site branch expectations for upb/wire/decode.c, derived from",
+      f"// {len(args.traces)} trace dump(s).  Pass",
+      "// -DUPB_DECODE_HINTS_FILE='\"<this file>\"' when compiling upb.",
+      "",
+  ]
+  for site in sorted(sites):
+    taken, total = sites[site]
+    if total < args.min_count:
+      lines.append(f"// {site}: only {total} samples, keeping default.")
+      continue
+    likely = 1 if taken * 2 >= total else 0
+    pct = 100.0 * taken / total
+    lines.append(f"#define UPB_DECODE_BRANCH_HINT_{site} {likely}"
+                 f"  // taken {pct:.1f}% of {total}")
+  out = "\n".join(lines) + "\n"
+
+  if args.output == "-":
+    sys.stdout.write(out)
+  else:
+    with open(args.output, "w") as f:
+      f.write(out)
+
+
+if __name__ == "__main__":
+  main()
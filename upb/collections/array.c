@@ -29,6 +29,12 @@
 
 #include "upb/collections/array_internal.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 // Must be last.
 #include "upb/port/def.inc"
 
@@ -47,7 +53,8 @@ const char _upb_Array_CTypeSizeLg2Table[] = {
 };
 
 upb_Array* upb_Array_New(upb_Arena* a, upb_CType type) {
-  return _upb_Array_New(a, 4, _upb_Array_CTypeSizeLg2(type));
+  const int lg2 = _upb_Array_CTypeSizeLg2(type);
+  return _upb_Array_New(a, _upb_Array_InitialCapacity(lg2), lg2);
 }
 
 const void* upb_Array_DataPtr(const upb_Array* arr) {
@@ -60,9 +67,13 @@ size_t upb_Array_Size(const upb_Array* arr) { return arr->size; }
 
 upb_MessageValue upb_Array_Get(const upb_Array* arr, size_t i) {
   upb_MessageValue ret;
+  UPB_ASSERT(i < arr->size);
+  if (UPB_UNLIKELY(_upb_Array_IsCompactPtr(arr))) {
+    ret.msg_val = _upb_Array_CompactPtrGet(arr, i);
+    return ret;
+  }
   const char* data = _upb_array_constptr(arr);
   int lg2 = arr->data & 7;
-  UPB_ASSERT(i < arr->size);
   memcpy(&ret, data + (i << lg2), 1 << lg2);
   return ret;
 }
@@ -71,6 +82,9 @@ void upb_Array_Set(upb_Array* arr, size_t i, upb_MessageValue val) {
   char* data = _upb_array_ptr(arr);
   int lg2 = arr->data & 7;
   UPB_ASSERT(i < arr->size);
+  // In-place writes to storage borrowed by upb_Message_CloneShared() would
+  // corrupt the lending array; materialize first (see copy.h).
+  UPB_ASSERT(arr->capacity >= arr->size);
   memcpy(data + (i << lg2), &val, 1 << lg2);
 }
 
@@ -83,8 +97,31 @@ bool upb_Array_Append(upb_Array* arr, upb_MessageValue val, upb_Arena* arena) {
   return true;
 }
 
+bool upb_Array_Reserve(upb_Array* arr, size_t capacity, upb_Arena* arena) {
+  UPB_ASSERT(arena);
+  if (arr->capacity >= capacity) return true;
+  return _upb_array_realloc(arr, capacity, arena);
+}
+
+bool upb_Array_AppendRange(upb_Array* arr, const void* data, size_t count,
+                           upb_Arena* arena) {
+  UPB_ASSERT(arena);
+  UPB_ASSERT(count + arr->size >= count);
+  const size_t oldsize = arr->size;
+  if (UPB_UNLIKELY(
+          !_upb_Array_ResizeUninitialized(arr, oldsize + count, arena))) {
+    return false;
+  }
+  const int lg2 = arr->data & 7;
+  char* dst = _upb_array_ptr(arr);
+  memcpy(dst + (oldsize << lg2), data, count << lg2);
+  return true;
+}
+
 void upb_Array_Move(upb_Array* arr, size_t dst_idx, size_t src_idx,
                     size_t count) {
+  // See upb_Array_Set() regarding borrowed storage.
+  UPB_ASSERT(arr->capacity >= arr->size);
   const int lg2 = arr->data & 7;
   char* data = _upb_array_ptr(arr);
   memmove(&data[dst_idx << lg2], &data[src_idx << lg2], count << lg2);
@@ -115,6 +152,292 @@ void upb_Array_Delete(upb_Array* arr, size_t i, size_t count) {
   arr->size -= count;
 }
 
+// Introsort, instantiated once per element type so that comparisons and
+// element moves compile down to direct machine operations (qsort()'s
+// callback-per-comparison is several times slower on large numeric arrays).
+// Quicksort with median-of-three pivots, insertion sort for small
+// partitions, and a heapsort fallback when recursion depth degenerates.
+
+#define UPB_SORT_SMALL_PARTITION 32
+
+#define UPB_DEFINE_SORT(name, type)                                        \
+  static void _upb_Sort_Insertion_##name(type* a, size_t n) {              \
+    for (size_t i = 1; i < n; i++) {                                       \
+      const type v = a[i];                                                 \
+      size_t j = i;                                                        \
+      for (; j > 0 && v < a[j - 1]; j--) a[j] = a[j - 1];                  \
+      a[j] = v;                                                            \
+    }                                                                      \
+  }                                                                        \
+  static void _upb_Sort_SiftDown_##name(type* a, size_t root, size_t n) {  \
+    for (;;) {                                                             \
+      size_t child = 2 * root + 1;                                         \
+      if (child >= n) return;                                              \
+      if (child + 1 < n && a[child] < a[child + 1]) child++;               \
+      if (!(a[root] < a[child])) return;                                   \
+      const type tmp = a[root];                                            \
+      a[root] = a[child];                                                  \
+      a[child] = tmp;                                                      \
+      root = child;                                                        \
+    }                                                                      \
+  }                                                                        \
+  static void _upb_Sort_Heap_##name(type* a, size_t n) {                   \
+    for (size_t i = n / 2; i > 0; i--) {                                   \
+      _upb_Sort_SiftDown_##name(a, i - 1, n);                              \
+    }                                                                      \
+    for (size_t i = n; i > 1; i--) {                                       \
+      const type tmp = a[0];                                               \
+      a[0] = a[i - 1];                                                     \
+      a[i - 1] = tmp;                                                      \
+      _upb_Sort_SiftDown_##name(a, 0, i - 1);                              \
+    }                                                                      \
+  }                                                                        \
+  static void _upb_Sort_##name(type* a, size_t n, int depth) {             \
+    while (n > UPB_SORT_SMALL_PARTITION) {                                 \
+      if (depth-- == 0) {                                                  \
+        _upb_Sort_Heap_##name(a, n);                                       \
+        return;                                                            \
+      }                                                                    \
+      /* Median-of-three: order a[0], a[n/2], a[n-1]. */                   \
+      type tmp;                                                            \
+      const size_t mid = n / 2;                                            \
+      if (a[mid] < a[0]) tmp = a[0], a[0] = a[mid], a[mid] = tmp;          \
+      if (a[n - 1] < a[0]) tmp = a[0], a[0] = a[n - 1], a[n - 1] = tmp;    \
+      if (a[n - 1] < a[mid]) {                                             \
+        tmp = a[mid], a[mid] = a[n - 1], a[n - 1] = tmp;                   \
+      }                                                                    \
+      const type pivot = a[mid];                                           \
+      /* Hoare partition. */                                               \
+      size_t i = (size_t)-1, j = n;                                        \
+      for (;;) {                                                           \
+        do i++;                                                            \
+        while (a[i] < pivot);                                              \
+        do j--;                                                            \
+        while (pivot < a[j]);                                              \
+        if (i >= j) break;                                                 \
+        tmp = a[i], a[i] = a[j], a[j] = tmp;                               \
+      }                                                                    \
+      /* Recurse into the smaller side; loop on the larger one so stack */ \
+      /* depth stays O(lg n). */                                           \
+      const size_t lo_n = j + 1;                                           \
+      if (lo_n < n - lo_n) {                                               \
+        _upb_Sort_##name(a, lo_n, depth);                                  \
+        a += lo_n;                                                         \
+        n -= lo_n;                                                         \
+      } else {                                                             \
+        _upb_Sort_##name(a + lo_n, n - lo_n, depth);                       \
+        n = lo_n;                                                          \
+      }                                                                    \
+    }                                                                      \
+    _upb_Sort_Insertion_##name(a, n);                                      \
+  }
+
+UPB_DEFINE_SORT(b1, uint8_t)
+UPB_DEFINE_SORT(i4, int32_t)
+UPB_DEFINE_SORT(u4, uint32_t)
+UPB_DEFINE_SORT(f4, float)
+UPB_DEFINE_SORT(i8, int64_t)
+UPB_DEFINE_SORT(u8, uint64_t)
+UPB_DEFINE_SORT(f8, double)
+
+#undef UPB_DEFINE_SORT
+
+void upb_Array_Sort(upb_Array* arr, upb_CType type) {
+  // See upb_Array_Set() regarding borrowed storage.
+  UPB_ASSERT(arr->capacity >= arr->size);
+  void* data = _upb_array_ptr(arr);
+  const size_t n = arr->size;
+  if (n < 2) return;
+  int depth = 0;  // Heapsort fallback kicks in below 2 * floor(lg n).
+  for (size_t m = n; m > 1; m >>= 1) depth += 2;
+  switch (type) {
+    case kUpb_CType_Bool:
+      _upb_Sort_b1(data, n, depth);
+      break;
+    case kUpb_CType_Int32:
+    case kUpb_CType_Enum:
+      _upb_Sort_i4(data, n, depth);
+      break;
+    case kUpb_CType_UInt32:
+      _upb_Sort_u4(data, n, depth);
+      break;
+    case kUpb_CType_Float:
+      _upb_Sort_f4(data, n, depth);
+      break;
+    case kUpb_CType_Int64:
+      _upb_Sort_i8(data, n, depth);
+      break;
+    case kUpb_CType_UInt64:
+      _upb_Sort_u8(data, n, depth);
+      break;
+    case kUpb_CType_Double:
+      _upb_Sort_f8(data, n, depth);
+      break;
+    default:
+      UPB_ASSERT(!"upb_Array_Sort: non-scalar element type");
+  }
+}
+
+// Delta transform (see array.h).  All arithmetic is unsigned so wraparound
+// makes the transform lossless for arbitrary data, not just monotone data.
+
+static void upb_Array_PrefixSum32(uint32_t* data, size_t n) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  __m128i running = _mm_setzero_si128();
+  for (; i + 4 <= n; i += 4) {
+    __m128i x = _mm_loadu_si128((__m128i*)(data + i));
+    x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+    x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+    x = _mm_add_epi32(x, running);
+    _mm_storeu_si128((__m128i*)(data + i), x);
+    running = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  uint32x4_t zero = vdupq_n_u32(0);
+  uint32x4_t running = zero;
+  for (; i + 4 <= n; i += 4) {
+    uint32x4_t x = vld1q_u32(data + i);
+    x = vaddq_u32(x, vextq_u32(zero, x, 3));
+    x = vaddq_u32(x, vextq_u32(zero, x, 2));
+    x = vaddq_u32(x, running);
+    vst1q_u32(data + i, x);
+    running = vdupq_laneq_u32(x, 3);
+  }
+#endif
+  uint32_t acc = i ? data[i - 1] : 0;
+  for (; i < n; i++) {
+    acc += data[i];
+    data[i] = acc;
+  }
+}
+
+static void upb_Array_PrefixSum64(uint64_t* data, size_t n) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  __m128i running = _mm_setzero_si128();
+  for (; i + 2 <= n; i += 2) {
+    __m128i x = _mm_loadu_si128((__m128i*)(data + i));
+    x = _mm_add_epi64(x, _mm_slli_si128(x, 8));
+    x = _mm_add_epi64(x, running);
+    _mm_storeu_si128((__m128i*)(data + i), x);
+    running = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 2, 3, 2));
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  uint64x2_t zero = vdupq_n_u64(0);
+  uint64x2_t running = zero;
+  for (; i + 2 <= n; i += 2) {
+    uint64x2_t x = vld1q_u64(data + i);
+    x = vaddq_u64(x, vextq_u64(zero, x, 1));
+    x = vaddq_u64(x, running);
+    vst1q_u64(data + i, x);
+    running = vdupq_laneq_u64(x, 1);
+  }
+#endif
+  uint64_t acc = i ? data[i - 1] : 0;
+  for (; i < n; i++) {
+    acc += data[i];
+    data[i] = acc;
+  }
+}
+
+// Returns the element width in bytes for delta-transformable types, or 0.
+static int upb_Array_DeltaElemSize(upb_CType type) {
+  switch (type) {
+    case kUpb_CType_Int32:
+    case kUpb_CType_UInt32:
+    case kUpb_CType_Enum:
+      return 4;
+    case kUpb_CType_Int64:
+    case kUpb_CType_UInt64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+bool upb_Array_EncodeDelta(upb_Array* arr, upb_CType type) {
+  const int elem_size = upb_Array_DeltaElemSize(type);
+  if (elem_size == 0) return false;
+  const size_t n = arr->size;
+  void* data = _upb_array_ptr(arr);
+  // Walk backwards so each element still sees its original predecessor.
+  if (elem_size == 4) {
+    uint32_t* vals = data;
+    for (size_t i = n; i > 1; i--) vals[i - 1] -= vals[i - 2];
+  } else {
+    uint64_t* vals = data;
+    for (size_t i = n; i > 1; i--) vals[i - 1] -= vals[i - 2];
+  }
+  return true;
+}
+
+bool upb_Array_DecodeDelta(upb_Array* arr, upb_CType type) {
+  const int elem_size = upb_Array_DeltaElemSize(type);
+  if (elem_size == 0) return false;
+  void* data = _upb_array_ptr(arr);
+  if (elem_size == 4) {
+    upb_Array_PrefixSum32(data, arr->size);
+  } else {
+    upb_Array_PrefixSum64(data, arr->size);
+  }
+  return true;
+}
+
+// Pointer compaction (see array.h).  Offsets are stored relative to the
+// lowest element pointer, with that base kept in a pointer-sized slot
+// directly before the offset storage so that decoding needs no state beyond
+// the array itself.
+
+bool upb_Array_CompactPointers(upb_Array* arr, upb_Arena* arena) {
+  UPB_ASSERT(arena);
+  if (sizeof(void*) == 4) return true;  // Pointers are already 4 bytes.
+  if (_upb_Array_IsCompactPtr(arr)) return true;
+  UPB_ASSERT((arr->data & 7) == UPB_SIZE(2, 3));  // Message element size.
+  const size_t n = arr->size;
+  void* const* elems = _upb_array_constptr(arr);
+  uintptr_t min = n ? (uintptr_t)elems[0] : 0;
+  uintptr_t max = min;
+  for (size_t i = 1; i < n; i++) {
+    const uintptr_t p = (uintptr_t)elems[i];
+    if (p < min) min = p;
+    if (p > max) max = p;
+  }
+  if (max - min > UINT32_MAX) return false;
+
+  char* mem = upb_Arena_Malloc(arena, sizeof(char*) + n * sizeof(uint32_t));
+  if (!mem) return false;
+  *(const char**)mem = (const char*)min;
+  uint32_t* offs = (uint32_t*)(mem + sizeof(char*));
+  for (size_t i = 0; i < n; i++) {
+    offs[i] = (uint32_t)((uintptr_t)elems[i] - min);
+  }
+  UPB_ASSERT(((uintptr_t)offs & 7) == 0);
+  arr->data = (uintptr_t)offs | kUpb_Array_CompactPtrTag;
+  arr->capacity = n;
+  return true;
+}
+
+bool upb_Array_ExpandPointers(upb_Array* arr, upb_Arena* arena) {
+  UPB_ASSERT(arena);
+  if (!_upb_Array_IsCompactPtr(arr)) return true;
+  const size_t n = arr->size;
+  const int lg2 = UPB_SIZE(2, 3);
+  if (n == 0) {
+    arr->data = _upb_tag_arrptr(NULL, lg2);
+    arr->capacity = 0;
+    return true;
+  }
+  const void** elems = upb_Arena_Malloc(arena, n * sizeof(void*));
+  if (!elems) return false;
+  for (size_t i = 0; i < n; i++) {
+    elems[i] = _upb_Array_CompactPtrGet(arr, i);
+  }
+  arr->data = _upb_tag_arrptr((void*)elems, lg2);
+  arr->capacity = n;
+  return true;
+}
+
 bool upb_Array_Resize(upb_Array* arr, size_t size, upb_Arena* arena) {
   const size_t oldsize = arr->size;
   if (UPB_UNLIKELY(!_upb_Array_ResizeUninitialized(arr, size, arena))) {
@@ -134,7 +457,11 @@ bool upb_Array_Resize(upb_Array* arr, size_t size, upb_Arena* arena) {
 bool _upb_array_realloc(upb_Array* arr, size_t min_capacity, upb_Arena* arena) {
   size_t new_capacity = UPB_MAX(arr->capacity, 4);
   int elem_size_lg2 = arr->data & 7;
-  size_t old_bytes = arr->capacity << elem_size_lg2;
+  // A capacity smaller than the size marks storage borrowed from another
+  // array by upb_Message_CloneShared().  Borrowed storage must move to fresh
+  // memory -- never extend in place -- so the lender's elements stay intact.
+  const bool borrowed = arr->capacity < arr->size;
+  size_t old_bytes = (borrowed ? arr->size : arr->capacity) << elem_size_lg2;
   size_t new_bytes;
   void* ptr = _upb_array_ptr(arr);
 
@@ -142,8 +469,22 @@ bool _upb_array_realloc(upb_Array* arr, size_t min_capacity, upb_Arena* arena) {
   while (new_capacity < min_capacity) new_capacity *= 2;
 
   new_bytes = new_capacity << elem_size_lg2;
-  ptr = upb_Arena_Realloc(arena, ptr, old_bytes, new_bytes);
-  if (!ptr) return false;
+  if (new_bytes >= 256) {
+    // Large arrays come out 64-byte aligned so that post-parse numeric
+    // kernels can run aligned vector loads directly on the array storage.
+    void* new_ptr = upb_Arena_MallocAligned(arena, new_bytes, 64);
+    if (!new_ptr) return false;
+    if (old_bytes) memcpy(new_ptr, ptr, old_bytes);
+    ptr = new_ptr;
+  } else if (borrowed) {
+    void* new_ptr = upb_Arena_Malloc(arena, new_bytes);
+    if (!new_ptr) return false;
+    if (old_bytes) memcpy(new_ptr, ptr, old_bytes);
+    ptr = new_ptr;
+  } else {
+    ptr = upb_Arena_Realloc(arena, ptr, old_bytes, new_bytes);
+    if (!ptr) return false;
+  }
 
   arr->data = _upb_tag_arrptr(ptr, elem_size_lg2);
   arr->capacity = new_capacity;
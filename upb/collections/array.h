@@ -55,6 +55,21 @@ UPB_API void upb_Array_Set(upb_Array* arr, size_t i, upb_MessageValue val);
 UPB_API bool upb_Array_Append(upb_Array* array, upb_MessageValue val,
                               upb_Arena* arena);
 
+// Ensures that the array has capacity for at least `capacity` elements, so
+// that subsequent appends up to that size will not reallocate.
+// Returns false on allocation failure.
+UPB_API bool upb_Array_Reserve(upb_Array* array, size_t capacity,
+                               upb_Arena* arena);
+
+// Appends `count` elements copied from `data`, with a single capacity check
+// and a single memcpy().  `data` must point to `count` consecutive elements
+// in the array's native representation (the same layout returned by
+// upb_Array_DataPtr()): the element's C type for scalars, or upb_StringView
+// for strings/bytes.  Not usable for message arrays, whose elements are
+// internal tagged pointers.  Returns false on allocation failure.
+UPB_API bool upb_Array_AppendRange(upb_Array* array, const void* data,
+                                   size_t count, upb_Arena* arena);
+
 // Moves elements within the array using memmove().
 // Like memmove(), the source and destination elements may be overlapping.
 UPB_API void upb_Array_Move(upb_Array* array, size_t dst_idx, size_t src_idx,
@@ -76,6 +91,48 @@ UPB_API void upb_Array_Delete(upb_Array* array, size_t i, size_t count);
 // Returns false on allocation failure.
 UPB_API bool upb_Array_Resize(upb_Array* array, size_t size, upb_Arena* arena);
 
+// Sorts the array's elements in place, in ascending order.  Only valid for
+// scalar element types (bool, integers, enums, floats); not for string,
+// bytes, or message arrays.  `type` must match the type the array was
+// created with.  Sorting happens directly in the arena-resident element
+// buffer, so no per-element copies or allocations are made.  Floating-point
+// arrays are ordered by the C `<` operator; the position of NaN elements is
+// unspecified.  The sort is not stable (equal scalars are indistinguishable
+// anyway).
+UPB_API void upb_Array_Sort(upb_Array* array, upb_CType type);
+
+// Replaces each element (after the first) with its difference from the
+// predecessor, in place.  For sorted data (eg. timestamps) this leaves small
+// deltas that encode to far fewer varint bytes through a normal upb_Encode().
+// Arithmetic is unsigned with wraparound, so the transform is lossless for
+// arbitrary data.  Only valid for 32/64-bit integer and enum element types;
+// returns false (leaving the array untouched) for any other type.  `type`
+// must match the type the array was created with.
+UPB_API bool upb_Array_EncodeDelta(upb_Array* array, upb_CType type);
+
+// Inverse of upb_Array_EncodeDelta(): reconstructs original values with an
+// in-place prefix sum (SIMD where available).  Call after upb_Decode() when
+// the producer delta-encoded the field.
+UPB_API bool upb_Array_DecodeDelta(upb_Array* array, upb_CType type);
+
+// Converts a message array's elements from native pointers to 32-bit offsets
+// in place, halving per-element memory on 64-bit hosts.  Offsets are taken
+// relative to the lowest element pointer, so the transform requires all
+// elements to lie within 4GB of each other; it returns false (leaving the
+// array untouched) when they do not.  Messages compacted onto a single-block
+// arena with upb_Message_Compact() always satisfy this.  A compacted array
+// is read-only: upb_Array_Get() decodes it transparently, but generated
+// accessors and all mutating operations require the pointer representation,
+// so call upb_Array_ExpandPointers() before mutating.  Only valid for
+// message element types.  On 32-bit hosts pointers are already 4 bytes and
+// this is a successful no-op.
+UPB_API bool upb_Array_CompactPointers(upb_Array* array, upb_Arena* arena);
+
+// Inverse of upb_Array_CompactPointers(): restores the native pointer
+// representation.  Returns false on allocation failure.  A no-op (returning
+// true) if the array is not compacted.
+UPB_API bool upb_Array_ExpandPointers(upb_Array* array, upb_Arena* arena);
+
 // Returns pointer to array data.
 UPB_API const void* upb_Array_DataPtr(const upb_Array* arr);
 
@@ -48,6 +48,27 @@ struct upb_Array {
 };
 // LINT.ThenChange(GoogleInternalName1)
 
+// Tag value (in the low 3 bits of |data|, where lg2(elem size) normally
+// lives) marking a message array converted to 32-bit offsets by
+// upb_Array_CompactPointers().  The element storage is then a uint32_t
+// offset per element, preceded by one pointer-sized slot holding the base
+// address the offsets are relative to.  Real lg2 values are <= 4, so this
+// cannot collide.
+#define kUpb_Array_CompactPtrTag 5
+
+UPB_INLINE bool _upb_Array_IsCompactPtr(const upb_Array* arr) {
+  return (arr->data & 7) == kUpb_Array_CompactPtrTag;
+}
+
+// Decodes element |i| of a compacted message array.
+UPB_INLINE const void* _upb_Array_CompactPtrGet(const upb_Array* arr,
+                                                size_t i) {
+  UPB_ASSERT(_upb_Array_IsCompactPtr(arr));
+  const uint32_t* offs = (const uint32_t*)(arr->data & ~(uintptr_t)7);
+  const char* base = ((const char* const*)offs)[-1];
+  return base + offs[i];
+}
+
 UPB_INLINE size_t _upb_Array_ElementSizeLg2(const upb_Array* arr) {
   size_t ret = arr->data & 7;
   UPB_ASSERT(ret <= 4);
@@ -80,6 +101,18 @@ UPB_INLINE size_t _upb_Array_CTypeSizeLg2(upb_CType ctype) {
   return _upb_Array_CTypeSizeLg2Table[ctype];
 }
 
+// Initial capacity that makes the array header plus inline elements fill one
+// 64-byte cache line.  Most repeated fields hold only a handful of elements,
+// so sizing the first (header-inline) allocation this way makes the common
+// case exactly one allocation and one cache line, with no separate data
+// block to chase.
+UPB_INLINE size_t _upb_Array_InitialCapacity(int elem_size_lg2) {
+  const size_t arr_size = UPB_ALIGN_UP(sizeof(upb_Array), UPB_MALLOC_ALIGN);
+  const size_t bytes = arr_size < 64 ? 64 - arr_size : 16;
+  const size_t cap = bytes >> elem_size_lg2;
+  return cap < 2 ? 2 : cap;
+}
+
 UPB_INLINE upb_Array* _upb_Array_New(upb_Arena* a, size_t init_capacity,
                                      int elem_size_lg2) {
   UPB_ASSERT(elem_size_lg2 <= 4);
@@ -81,6 +81,45 @@ UPB_API_INLINE bool upb_Array_AppendUInt64Split(upb_Array* array, uint32_t hi,
   return upb_Array_Append(array, val, arena);
 }
 
+#if UPB_NATIVE_INT64
+
+// Whole-value variants for hosts that do support 64-bit ints (e.g. wasm32,
+// which has native i64): one load or store instead of a hi/lo pair.
+
+UPB_API_INLINE int64_t upb_Array_GetInt64(const upb_Array* array, size_t i) {
+  return upb_Array_Get(array, i).int64_val;
+}
+
+UPB_API_INLINE void upb_Array_SetInt64(upb_Array* array, size_t i,
+                                       int64_t value) {
+  const upb_MessageValue val = {.int64_val = value};
+  upb_Array_Set(array, i, val);
+}
+
+UPB_API_INLINE bool upb_Array_AppendInt64(upb_Array* array, int64_t value,
+                                          upb_Arena* arena) {
+  const upb_MessageValue val = {.int64_val = value};
+  return upb_Array_Append(array, val, arena);
+}
+
+UPB_API_INLINE uint64_t upb_Array_GetUInt64(const upb_Array* array, size_t i) {
+  return upb_Array_Get(array, i).uint64_val;
+}
+
+UPB_API_INLINE void upb_Array_SetUInt64(upb_Array* array, size_t i,
+                                        uint64_t value) {
+  const upb_MessageValue val = {.uint64_val = value};
+  upb_Array_Set(array, i, val);
+}
+
+UPB_API_INLINE bool upb_Array_AppendUInt64(upb_Array* array, uint64_t value,
+                                           upb_Arena* arena) {
+  const upb_MessageValue val = {.uint64_val = value};
+  return upb_Array_Append(array, val, arena);
+}
+
+#endif  // UPB_NATIVE_INT64
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
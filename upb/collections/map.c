@@ -29,6 +29,7 @@
 
 #include <string.h>
 
+#include "upb/base/log2.h"
 #include "upb/collections/map_internal.h"
 #include "upb/mem/arena.h"
 
@@ -55,6 +56,22 @@ upb_Map* upb_Map_New(upb_Arena* a, upb_CType key_type, upb_CType value_type) {
                       _upb_Map_CTypeSize(value_type));
 }
 
+bool upb_Map_Reserve(upb_Map* map, size_t size, upb_Arena* arena) {
+  UPB_ASSERT(arena);
+  if (map->is_flat) {
+    // Match the flat layout's 7/8 load limit.
+    size_t need_slots = size + size / 7 + 1;
+    int size_lg2 = upb_Log2Ceiling(need_slots);
+    if (map->flat_ctrl && size_lg2 <= map->flat_size_lg2) return true;
+    return _upb_FlatMap_Resize(map, size_lg2, arena);
+  }
+  // Match the sizing rule of upb_strtable_init().
+  size_t need_entries = (size + 1) * 1204 / 1024;
+  int size_lg2 = upb_Log2Ceiling(need_entries);
+  if (size_lg2 <= map->table.t.size_lg2) return true;
+  return upb_strtable_resize(&map->table, size_lg2, arena);
+}
+
 size_t upb_Map_Size(const upb_Map* map) { return _upb_Map_Size(map); }
 
 bool upb_Map_Get(const upb_Map* map, upb_MessageValue key,
@@ -80,6 +97,13 @@ bool upb_Map_Delete(upb_Map* map, upb_MessageValue key, upb_MessageValue* val) {
 
 bool upb_Map_Next(const upb_Map* map, upb_MessageValue* key,
                   upb_MessageValue* val, size_t* iter) {
+  if (map->is_flat) {
+    const char* slot = _upb_FlatMap_Next(map, iter);
+    if (!slot) return false;
+    memcpy(key, slot, map->key_size);
+    memcpy(val, slot + map->key_size, map->val_size);
+    return true;
+  }
   upb_StringView k;
   upb_value v;
   const bool ok = upb_strtable_next2(&map->table, &k, &v, (intptr_t*)iter);
@@ -90,8 +114,52 @@ bool upb_Map_Next(const upb_Map* map, upb_MessageValue* key,
   return ok;
 }
 
+typedef struct {
+  const upb_Map* map;
+  upb_Map_VisitCallback* callback;
+  void* ctx;
+} upb_Map_VisitRangeState;
+
+static void upb_Map_VisitRangeEntry(upb_StringView key, upb_value val,
+                                    void* ctx) {
+  const upb_Map_VisitRangeState* state = ctx;
+  upb_MessageValue k, v;
+  _upb_map_fromkey(key, &k, state->map->key_size);
+  _upb_map_fromvalue(val, &v, state->map->val_size);
+  state->callback(k, v, state->ctx);
+}
+
+void upb_Map_VisitRange(const upb_Map* map, size_t partition_index,
+                        size_t partition_count,
+                        upb_Map_VisitCallback* callback, void* ctx) {
+  if (map->is_flat) {
+    const size_t cap = _upb_FlatMap_Capacity(map);
+    const size_t slot_size = map->key_size + map->val_size;
+    const size_t begin = cap * partition_index / partition_count;
+    const size_t end = cap * (partition_index + 1) / partition_count;
+    for (size_t i = begin; i < end; i++) {
+      if (map->flat_ctrl[i] != kUpb_FlatMap_Full) continue;
+      const char* slot = map->flat_slots + i * slot_size;
+      upb_MessageValue k, v;
+      memcpy(&k, slot, map->key_size);
+      memcpy(&v, slot + map->key_size, map->val_size);
+      callback(k, v, ctx);
+    }
+    return;
+  }
+  upb_Map_VisitRangeState state = {map, callback, ctx};
+  upb_strtable_visitpart(&map->table, partition_index, partition_count,
+                         &upb_Map_VisitRangeEntry, &state);
+}
+
 UPB_API void upb_Map_SetEntryValue(upb_Map* map, size_t iter,
                                    upb_MessageValue val) {
+  if (map->is_flat) {
+    UPB_ASSERT(map->flat_ctrl[iter] == kUpb_FlatMap_Full);
+    char* slot = map->flat_slots + iter * (map->key_size + map->val_size);
+    memcpy(slot + map->key_size, &val, map->val_size);
+    return;
+  }
   upb_value v;
   _upb_map_tovalue(&val, map->val_size, &v, NULL);
   upb_strtable_setentryvalue(&map->table, iter, v);
@@ -102,8 +170,9 @@ bool upb_MapIterator_Next(const upb_Map* map, size_t* iter) {
 }
 
 bool upb_MapIterator_Done(const upb_Map* map, size_t iter) {
-  upb_strtable_iter i;
   UPB_ASSERT(iter != kUpb_Map_Begin);
+  if (map->is_flat) return iter >= _upb_FlatMap_Capacity(map);
+  upb_strtable_iter i;
   i.t = &map->table;
   i.index = iter;
   return upb_strtable_done(&i);
@@ -111,8 +180,14 @@ bool upb_MapIterator_Done(const upb_Map* map, size_t iter) {
 
 // Returns the key and value for this entry of the map.
 upb_MessageValue upb_MapIterator_Key(const upb_Map* map, size_t iter) {
-  upb_strtable_iter i;
   upb_MessageValue ret;
+  if (map->is_flat) {
+    const char* slot =
+        map->flat_slots + iter * (map->key_size + map->val_size);
+    memcpy(&ret, slot, map->key_size);
+    return ret;
+  }
+  upb_strtable_iter i;
   i.t = &map->table;
   i.index = iter;
   _upb_map_fromkey(upb_strtable_iter_key(&i), &ret, map->key_size);
@@ -120,8 +195,14 @@ upb_MessageValue upb_MapIterator_Key(const upb_Map* map, size_t iter) {
 }
 
 upb_MessageValue upb_MapIterator_Value(const upb_Map* map, size_t iter) {
-  upb_strtable_iter i;
   upb_MessageValue ret;
+  if (map->is_flat) {
+    const char* slot =
+        map->flat_slots + iter * (map->key_size + map->val_size);
+    memcpy(&ret, slot + map->key_size, map->val_size);
+    return ret;
+  }
+  upb_strtable_iter i;
   i.t = &map->table;
   i.index = iter;
   _upb_map_fromvalue(upb_strtable_iter_value(&i), &ret, map->val_size);
@@ -134,9 +215,193 @@ upb_Map* _upb_Map_New(upb_Arena* a, size_t key_size, size_t value_size) {
   upb_Map* map = upb_Arena_Malloc(a, sizeof(upb_Map));
   if (!map) return NULL;
 
-  upb_strtable_init(&map->table, 4, a);
   map->key_size = key_size;
   map->val_size = value_size;
+  map->is_borrowed = false;
+  // Scalar-key/scalar-value maps (message values count: they are one tagged
+  // pointer) store entries inline in the flat layout; string keys or values
+  // need the strtable's variable-length key storage and boxed values.  Flat
+  // slot storage is allocated lazily on the first insert.
+  map->is_flat =
+      key_size != UPB_MAPTYPE_STRING && value_size != UPB_MAPTYPE_STRING;
+  map->flat_ctrl = NULL;
+  map->flat_slots = NULL;
+  map->flat_count = 0;
+  map->flat_used = 0;
+  map->flat_size_lg2 = 0;
+  if (map->is_flat) {
+    memset(&map->table, 0, sizeof(map->table));
+  } else {
+    upb_strtable_init(&map->table, 4, a);
+  }
+  map->arena = a;
 
   return map;
 }
+
+bool _upb_Map_EnsureOwned(upb_Map* map) {
+  if (!map->is_borrowed) return true;
+  if (map->is_flat) {
+    // Entries live inline in the slot array, so copying the slot and control
+    // arrays wholesale is a full deep copy.
+    const size_t cap = _upb_FlatMap_Capacity(map);
+    if (cap) {
+      const size_t slot_size = map->key_size + map->val_size;
+      uint8_t* ctrl = upb_Arena_Malloc(map->arena, cap);
+      char* slots = upb_Arena_Malloc(map->arena, cap * slot_size);
+      if (!ctrl || !slots) return false;
+      memcpy(ctrl, map->flat_ctrl, cap);
+      memcpy(slots, map->flat_slots, cap * slot_size);
+      map->flat_ctrl = ctrl;
+      map->flat_slots = slots;
+    }
+    map->is_borrowed = false;
+    return true;
+  }
+  // Re-slotting by cached hash copies only the table; key strings and boxed
+  // values stay shared, which is safe because inserts always write fresh
+  // boxes rather than mutating old ones.
+  if (!upb_strtable_resize(&map->table, map->table.t.size_lg2, map->arena)) {
+    return false;
+  }
+  map->is_borrowed = false;
+  return true;
+}
+
+/* Flat layout ****************************************************************/
+
+// Multiplicative (Fibonacci) hash.  Scalar keys are at most eight bytes, so
+// one multiply plus taking the top bits spreads them well enough for linear
+// probing.
+static size_t _upb_FlatMap_Bucket(const upb_Map* map, const void* key) {
+  uint64_t k = 0;
+  memcpy(&k, key, map->key_size);
+  return (k * 0x9E3779B97F4A7C15ull) >> (64 - map->flat_size_lg2);
+}
+
+bool _upb_FlatMap_Get(const upb_Map* map, const void* key, void* val) {
+  if (!map->flat_ctrl) return false;
+  const size_t mask = _upb_FlatMap_Capacity(map) - 1;
+  const size_t slot_size = map->key_size + map->val_size;
+  size_t i = _upb_FlatMap_Bucket(map, key);
+  while (true) {
+    const uint8_t ctrl = map->flat_ctrl[i];
+    if (ctrl == kUpb_FlatMap_Empty) return false;
+    if (ctrl == kUpb_FlatMap_Full) {
+      const char* slot = map->flat_slots + i * slot_size;
+      if (memcmp(slot, key, map->key_size) == 0) {
+        if (val) memcpy(val, slot + map->key_size, map->val_size);
+        return true;
+      }
+    }
+    i = (i + 1) & mask;
+  }
+}
+
+bool _upb_FlatMap_Resize(upb_Map* map, int size_lg2, upb_Arena* a) {
+  const size_t slot_size = map->key_size + map->val_size;
+  if (size_lg2 < 3) size_lg2 = 3;
+  const size_t new_cap = (size_t)1 << size_lg2;
+  UPB_ASSERT(map->flat_count * 8 <= new_cap * 7);
+  uint8_t* ctrl = upb_Arena_Malloc(a, new_cap);
+  char* slots = upb_Arena_Malloc(a, new_cap * slot_size);
+  if (!ctrl || !slots) return false;
+  memset(ctrl, kUpb_FlatMap_Empty, new_cap);
+
+  const uint8_t* old_ctrl = map->flat_ctrl;
+  const char* old_slots = map->flat_slots;
+  const size_t old_cap = _upb_FlatMap_Capacity(map);
+
+  map->flat_ctrl = ctrl;
+  map->flat_slots = slots;
+  map->flat_size_lg2 = size_lg2;
+  map->flat_used = map->flat_count;  // Tombstones are shed by the rebuild.
+
+  const size_t mask = new_cap - 1;
+  for (size_t i = 0; i < old_cap; i++) {
+    if (old_ctrl[i] != kUpb_FlatMap_Full) continue;
+    const char* src = old_slots + i * slot_size;
+    size_t j = _upb_FlatMap_Bucket(map, src);
+    while (ctrl[j] == kUpb_FlatMap_Full) j = (j + 1) & mask;
+    ctrl[j] = kUpb_FlatMap_Full;
+    memcpy(slots + j * slot_size, src, slot_size);
+  }
+  return true;
+}
+
+upb_MapInsertStatus _upb_FlatMap_Insert(upb_Map* map, const void* key,
+                                        const void* val, upb_Arena* a) {
+  if (!map->flat_ctrl) {
+    if (!_upb_FlatMap_Resize(map, 3, a)) {
+      return kUpb_MapInsertStatus_OutOfMemory;
+    }
+  } else if ((map->flat_used + 1) * 8 > _upb_FlatMap_Capacity(map) * 7) {
+    // Hit the 7/8 load limit (counting tombstones, since they lengthen probe
+    // chains).  Double if the table is genuinely full; rebuild at the same
+    // size to shed tombstones if it is mostly deletions.
+    int size_lg2 = map->flat_size_lg2;
+    if ((map->flat_count + 1) * 8 > _upb_FlatMap_Capacity(map) * 7) {
+      size_lg2++;
+    }
+    if (!_upb_FlatMap_Resize(map, size_lg2, a)) {
+      return kUpb_MapInsertStatus_OutOfMemory;
+    }
+  }
+
+  const size_t mask = _upb_FlatMap_Capacity(map) - 1;
+  const size_t slot_size = map->key_size + map->val_size;
+  size_t i = _upb_FlatMap_Bucket(map, key);
+  size_t insert_at = SIZE_MAX;
+  while (true) {
+    const uint8_t ctrl = map->flat_ctrl[i];
+    if (ctrl == kUpb_FlatMap_Empty) break;
+    if (ctrl == kUpb_FlatMap_Tombstone) {
+      // The key may still occur later in the probe chain; remember the first
+      // reusable slot but keep looking.
+      if (insert_at == SIZE_MAX) insert_at = i;
+    } else {
+      char* slot = map->flat_slots + i * slot_size;
+      if (memcmp(slot, key, map->key_size) == 0) {
+        memcpy(slot + map->key_size, val, map->val_size);
+        return kUpb_MapInsertStatus_Replaced;
+      }
+    }
+    i = (i + 1) & mask;
+  }
+  if (insert_at == SIZE_MAX) {
+    insert_at = i;
+    map->flat_used++;  // Refilling a tombstone does not change the load.
+  }
+  map->flat_ctrl[insert_at] = kUpb_FlatMap_Full;
+  char* slot = map->flat_slots + insert_at * slot_size;
+  memcpy(slot, key, map->key_size);
+  memcpy(slot + map->key_size, val, map->val_size);
+  map->flat_count++;
+  return kUpb_MapInsertStatus_Inserted;
+}
+
+bool _upb_FlatMap_Delete(upb_Map* map, const void* key, upb_value* val) {
+  if (!map->flat_ctrl) return false;
+  const size_t mask = _upb_FlatMap_Capacity(map) - 1;
+  const size_t slot_size = map->key_size + map->val_size;
+  size_t i = _upb_FlatMap_Bucket(map, key);
+  while (true) {
+    const uint8_t ctrl = map->flat_ctrl[i];
+    if (ctrl == kUpb_FlatMap_Empty) return false;
+    if (ctrl == kUpb_FlatMap_Full) {
+      const char* slot = map->flat_slots + i * slot_size;
+      if (memcmp(slot, key, map->key_size) == 0) {
+        if (val) {
+          val->val = 0;
+          memcpy(val, slot + map->key_size, map->val_size);
+        }
+        // Leave a tombstone so probe chains that passed through this slot
+        // stay intact; tombstones are reclaimed by the next rebuild.
+        map->flat_ctrl[i] = kUpb_FlatMap_Tombstone;
+        map->flat_count--;
+        return true;
+      }
+    }
+    i = (i + 1) & mask;
+  }
+}
@@ -43,6 +43,12 @@ extern "C" {
 UPB_API upb_Map* upb_Map_New(upb_Arena* a, upb_CType key_type,
                              upb_CType value_type);
 
+// Ensures that the map has capacity for at least `size` entries, so that
+// inserting up to that many entries will not rehash.  Purely a performance
+// hint for bulk insertion; the map grows as needed regardless.
+// Returns false on allocation failure.
+UPB_API bool upb_Map_Reserve(upb_Map* map, size_t size, upb_Arena* arena);
+
 // Returns the number of entries in the map.
 UPB_API size_t upb_Map_Size(const upb_Map* map);
 
@@ -108,6 +114,24 @@ UPB_API bool upb_Map_Next(const upb_Map* map, upb_MessageValue* key,
 UPB_API void upb_Map_SetEntryValue(upb_Map* map, size_t iter,
                                    upb_MessageValue val);
 
+// Signature of the per-entry callback for upb_Map_VisitRange().
+typedef void upb_Map_VisitCallback(upb_MessageValue key, upb_MessageValue val,
+                                   void* ctx);
+
+// Invokes `callback` for every entry in partition `partition_index` (which
+// must be < `partition_count`) of the map.  The partitions are disjoint
+// slot ranges of the underlying hash table: together they cover every entry
+// exactly once, and an entry's partition is stable as long as the map is not
+// mutated.  Caller threads can therefore each visit one partition of a
+// read-only map concurrently, splitting per-entry work across cores without
+// first copying the entries out (upb_Map_Next() iteration is strictly
+// serial).  Entries are visited in hash-table slot order; partition sizes are
+// even in slots, not in entries.  Any mutation of the map (including through
+// another thread) during the visit is undefined behavior.
+UPB_API void upb_Map_VisitRange(const upb_Map* map, size_t partition_index,
+                                size_t partition_count,
+                                upb_Map_VisitCallback* callback, void* ctx);
+
 // DEPRECATED iterator, slated for removal.
 
 /* Map iteration:
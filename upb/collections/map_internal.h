@@ -44,7 +44,33 @@ struct upb_Map {
   char key_size;
   char val_size;
 
+  // True if the entry storage below is shared with another map (the result of
+  // upb_Message_CloneShared()).  Mutating entry points copy it into our own
+  // storage first via _upb_Map_EnsureOwned().
+  bool is_borrowed;
+
+  // True if this map uses the flat layout: an open-addressed array of
+  // (key, value) slots stored inline, with one control byte per slot.
+  // Selected by _upb_Map_New() when both the key and the value are scalars;
+  // string keys/values need the strtable's variable-length storage, so those
+  // maps use `table` and leave the flat_* fields NULL/0, and vice versa.
+  bool is_flat;
+
   upb_strtable table;
+
+  // Flat layout storage (is_flat only).  Each slot is key_size + val_size
+  // bytes: the key followed by the value, both in their scalar in-memory
+  // representation (message values store the tagged pointer).  Capacity is
+  // 1 << flat_size_lg2 slots, or zero before the first insert.
+  uint8_t* flat_ctrl;
+  char* flat_slots;
+  size_t flat_count;     // Full slots.
+  size_t flat_used;      // Full plus tombstoned slots (probe-chain load).
+  uint8_t flat_size_lg2;
+
+  // Arena that owns this map; needed by _upb_Map_EnsureOwned(), which has to
+  // copy borrowed entry storage without an arena from the caller.
+  upb_Arena* arena;
 };
 
 #ifdef __cplusplus
@@ -97,7 +123,42 @@ UPB_INLINE void _upb_map_fromvalue(upb_value val, void* out, size_t size) {
   }
 }
 
+// Control bytes for the flat layout (one per slot).  Any bit pattern is a
+// valid scalar key, so emptiness lives in this sidecar rather than in the
+// slot itself.  Deletes leave a tombstone to keep probe chains intact;
+// tombstones are reclaimed when the slot array is rebuilt.
+enum {
+  kUpb_FlatMap_Empty = 0,
+  kUpb_FlatMap_Full = 1,
+  kUpb_FlatMap_Tombstone = 2,
+};
+
+UPB_INLINE size_t _upb_FlatMap_Capacity(const upb_Map* map) {
+  return map->flat_ctrl ? (size_t)1 << map->flat_size_lg2 : 0;
+}
+
+// Flat-layout lookup/mutation, defined in map.c.  |key| and |val| are raw
+// scalar bytes of map->key_size / map->val_size.
+bool _upb_FlatMap_Get(const upb_Map* map, const void* key, void* val);
+upb_MapInsertStatus _upb_FlatMap_Insert(upb_Map* map, const void* key,
+                                        const void* val, upb_Arena* a);
+bool _upb_FlatMap_Delete(upb_Map* map, const void* key, upb_value* val);
+bool _upb_FlatMap_Resize(upb_Map* map, int size_lg2, upb_Arena* a);
+
+// Advances |*iter| (start at kUpb_Map_Begin) to the next full slot and
+// returns it: key bytes at the returned pointer, value bytes at
+// key_size past it.  Returns NULL at the end.
+UPB_INLINE char* _upb_FlatMap_Next(const upb_Map* map, size_t* iter) {
+  const size_t cap = _upb_FlatMap_Capacity(map);
+  size_t i = *iter + 1;  // kUpb_Map_Begin wraps to 0.
+  while (i < cap && map->flat_ctrl[i] != kUpb_FlatMap_Full) i++;
+  *iter = i;
+  if (i == cap) return NULL;
+  return map->flat_slots + i * (map->key_size + map->val_size);
+}
+
 UPB_INLINE void* _upb_map_next(const upb_Map* map, size_t* iter) {
+  if (map->is_flat) return _upb_FlatMap_Next(map, iter);
   upb_strtable_iter it;
   it.t = &map->table;
   it.index = *iter;
@@ -107,18 +168,47 @@ UPB_INLINE void* _upb_map_next(const upb_Map* map, size_t* iter) {
   return (void*)str_tabent(&it);
 }
 
+// If the map's entry storage is shared with another map, copies it into the
+// map's own storage (flat slots copy wholesale; strtable entries move by
+// cached hash with key/value payloads staying shared).  Returns false on
+// allocation failure.
+bool _upb_Map_EnsureOwned(upb_Map* map);
+
 UPB_INLINE void _upb_Map_Clear(upb_Map* map) {
+  if (map->is_borrowed) {
+    // Drop the borrowed storage rather than clearing shared memory.  The
+    // zeroed map is valid and grows on the next insert.
+    memset(&map->table, 0, sizeof(map->table));
+    map->flat_ctrl = NULL;
+    map->flat_slots = NULL;
+    map->flat_count = 0;
+    map->flat_used = 0;
+    map->flat_size_lg2 = 0;
+    map->is_borrowed = false;
+    return;
+  }
+  if (map->is_flat) {
+    if (map->flat_ctrl) {
+      memset(map->flat_ctrl, kUpb_FlatMap_Empty, _upb_FlatMap_Capacity(map));
+    }
+    map->flat_count = 0;
+    map->flat_used = 0;
+    return;
+  }
   upb_strtable_clear(&map->table);
 }
 
 UPB_INLINE bool _upb_Map_Delete(upb_Map* map, const void* key, size_t key_size,
                                 upb_value* val) {
+  if (!_upb_Map_EnsureOwned(map)) return false;
+  if (map->is_flat) return _upb_FlatMap_Delete(map, key, val);
   upb_StringView k = _upb_map_tokey(key, key_size);
   return upb_strtable_remove2(&map->table, k.data, k.size, val);
 }
 
 UPB_INLINE bool _upb_Map_Get(const upb_Map* map, const void* key,
                              size_t key_size, void* val, size_t val_size) {
+  if (map->is_flat) return _upb_FlatMap_Get(map, key, val);
   upb_value tabval;
   upb_StringView k = _upb_map_tokey(key, key_size);
   bool ret = upb_strtable_lookup2(&map->table, k.data, k.size, &tabval);
@@ -131,24 +221,32 @@ UPB_INLINE bool _upb_Map_Get(const upb_Map* map, const void* key,
 UPB_INLINE upb_MapInsertStatus _upb_Map_Insert(upb_Map* map, const void* key,
                                                size_t key_size, void* val,
                                                size_t val_size, upb_Arena* a) {
+  if (map->is_flat) {
+    if (!_upb_Map_EnsureOwned(map)) {
+      return kUpb_MapInsertStatus_OutOfMemory;
+    }
+    return _upb_FlatMap_Insert(map, key, val, a);
+  }
   upb_StringView strkey = _upb_map_tokey(key, key_size);
   upb_value tabval = {0};
   if (!_upb_map_tovalue(val, val_size, &tabval, a)) {
     return kUpb_MapInsertStatus_OutOfMemory;
   }
+  if (!_upb_Map_EnsureOwned(map)) {
+    return kUpb_MapInsertStatus_OutOfMemory;
+  }
 
-  // TODO(haberman): add overwrite operation to minimize number of lookups.
-  bool removed =
-      upb_strtable_remove2(&map->table, strkey.data, strkey.size, NULL);
-  if (!upb_strtable_insert(&map->table, strkey.data, strkey.size, tabval, a)) {
+  bool replaced;
+  if (!upb_strtable_upsert(&map->table, strkey.data, strkey.size, tabval,
+                           &replaced, a)) {
     return kUpb_MapInsertStatus_OutOfMemory;
   }
-  return removed ? kUpb_MapInsertStatus_Replaced
-                 : kUpb_MapInsertStatus_Inserted;
+  return replaced ? kUpb_MapInsertStatus_Replaced
+                  : kUpb_MapInsertStatus_Inserted;
 }
 
 UPB_INLINE size_t _upb_Map_Size(const upb_Map* map) {
-  return map->table.t.count;
+  return map->is_flat ? map->flat_count : map->table.t.count;
 }
 
 // Strings/bytes are special-cased in maps.
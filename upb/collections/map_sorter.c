@@ -41,6 +41,13 @@ static void _upb_mapsorter_getkeys(const void* _a, const void* _b, void* a_key,
   _upb_map_fromkey(b_tabkey, b_key, size);
 }
 
+// Flat-layout entries are slot pointers with the key bytes at the front.
+static void _upb_mapsorter_getkeys_flat(const void* _a, const void* _b,
+                                        void* a_key, void* b_key, size_t size) {
+  memcpy(a_key, *(const char* const*)_a, size);
+  memcpy(b_key, *(const char* const*)_b, size);
+}
+
 static int _upb_mapsorter_cmpi64(const void* _a, const void* _b) {
   int64_t a, b;
   _upb_mapsorter_getkeys(_a, _b, &a, &b, 8);
@@ -102,6 +109,58 @@ static int (*const compar[kUpb_FieldType_SizeOf])(const void*, const void*) = {
     [kUpb_FieldType_Bytes] = _upb_mapsorter_cmpstr,
 };
 
+// The flat comparators, same integer orderings over slot pointers.  String
+// keys never use the flat layout, so those entries stay NULL.
+static int _upb_mapsorter_cmpi64_flat(const void* _a, const void* _b) {
+  int64_t a, b;
+  _upb_mapsorter_getkeys_flat(_a, _b, &a, &b, 8);
+  return a < b ? -1 : a > b;
+}
+
+static int _upb_mapsorter_cmpu64_flat(const void* _a, const void* _b) {
+  uint64_t a, b;
+  _upb_mapsorter_getkeys_flat(_a, _b, &a, &b, 8);
+  return a < b ? -1 : a > b;
+}
+
+static int _upb_mapsorter_cmpi32_flat(const void* _a, const void* _b) {
+  int32_t a, b;
+  _upb_mapsorter_getkeys_flat(_a, _b, &a, &b, 4);
+  return a < b ? -1 : a > b;
+}
+
+static int _upb_mapsorter_cmpu32_flat(const void* _a, const void* _b) {
+  uint32_t a, b;
+  _upb_mapsorter_getkeys_flat(_a, _b, &a, &b, 4);
+  return a < b ? -1 : a > b;
+}
+
+static int _upb_mapsorter_cmpbool_flat(const void* _a, const void* _b) {
+  bool a, b;
+  _upb_mapsorter_getkeys_flat(_a, _b, &a, &b, 1);
+  return a < b ? -1 : a > b;
+}
+
+static int (*const compar_flat[kUpb_FieldType_SizeOf])(const void*,
+                                                       const void*) = {
+    [kUpb_FieldType_Int64] = _upb_mapsorter_cmpi64_flat,
+    [kUpb_FieldType_SFixed64] = _upb_mapsorter_cmpi64_flat,
+    [kUpb_FieldType_SInt64] = _upb_mapsorter_cmpi64_flat,
+
+    [kUpb_FieldType_UInt64] = _upb_mapsorter_cmpu64_flat,
+    [kUpb_FieldType_Fixed64] = _upb_mapsorter_cmpu64_flat,
+
+    [kUpb_FieldType_Int32] = _upb_mapsorter_cmpi32_flat,
+    [kUpb_FieldType_SInt32] = _upb_mapsorter_cmpi32_flat,
+    [kUpb_FieldType_SFixed32] = _upb_mapsorter_cmpi32_flat,
+    [kUpb_FieldType_Enum] = _upb_mapsorter_cmpi32_flat,
+
+    [kUpb_FieldType_UInt32] = _upb_mapsorter_cmpu32_flat,
+    [kUpb_FieldType_Fixed32] = _upb_mapsorter_cmpu32_flat,
+
+    [kUpb_FieldType_Bool] = _upb_mapsorter_cmpbool_flat,
+};
+
 static bool _upb_mapsorter_resize(_upb_mapsorter* s, _upb_sortedmap* sorted,
                                   int size) {
   sorted->start = s->size;
@@ -118,27 +177,150 @@ static bool _upb_mapsorter_resize(_upb_mapsorter* s, _upb_sortedmap* sorted,
   return true;
 }
 
+// Maps raw key bytes to a uint64_t whose unsigned order matches the
+// comparator order for |key_type|.  Only valid for integer/bool keys.
+static uint64_t _upb_mapsorter_intrank(const char* key_bytes,
+                                       upb_FieldType key_type) {
+  switch (key_type) {
+    case kUpb_FieldType_Int64:
+    case kUpb_FieldType_SFixed64:
+    case kUpb_FieldType_SInt64: {
+      int64_t k;
+      memcpy(&k, key_bytes, 8);
+      return (uint64_t)k ^ (1ULL << 63);
+    }
+    case kUpb_FieldType_UInt64:
+    case kUpb_FieldType_Fixed64: {
+      uint64_t k;
+      memcpy(&k, key_bytes, 8);
+      return k;
+    }
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_SInt32:
+    case kUpb_FieldType_SFixed32:
+    case kUpb_FieldType_Enum: {
+      int32_t k;
+      memcpy(&k, key_bytes, 4);
+      return (uint32_t)k ^ 0x80000000u;
+    }
+    case kUpb_FieldType_UInt32:
+    case kUpb_FieldType_Fixed32: {
+      uint32_t k;
+      memcpy(&k, key_bytes, 4);
+      return k;
+    }
+    case kUpb_FieldType_Bool: {
+      bool k;
+      memcpy(&k, key_bytes, 1);
+      return k;
+    }
+    default:
+      UPB_UNREACHABLE();
+  }
+}
+
+// Key bytes for an entry as stored in s->entries: a slot pointer for flat
+// maps, a table entry for strtable maps (scalar keys are kept in the key's
+// byte storage there).
+static const char* _upb_mapsorter_keybytes(const void* entry, bool flat) {
+  if (flat) return (const char*)entry;
+  return upb_tabstrview(((const upb_tabent*)entry)->key).data;
+}
+
+typedef struct {
+  uint64_t rank;
+  const void* entry;
+} _upb_mapsorter_radixent;
+
+// LSD radix sort on precomputed integer ranks; O(n) per byte digit instead of
+// qsort's O(n log n) comparisons, which matters for very large integer maps.
+// Returns false if scratch memory could not be allocated (caller falls back
+// to qsort).
+static bool _upb_mapsorter_radixsort(const void** entries, int n,
+                                     upb_FieldType key_type, bool flat) {
+  _upb_mapsorter_radixent* a = malloc(n * sizeof(*a));
+  _upb_mapsorter_radixent* b = malloc(n * sizeof(*b));
+  if (!a || !b) {
+    free(a);
+    free(b);
+    return false;
+  }
+
+  for (int i = 0; i < n; i++) {
+    a[i].rank =
+        _upb_mapsorter_intrank(_upb_mapsorter_keybytes(entries[i], flat),
+                               key_type);
+    a[i].entry = entries[i];
+  }
+
+  for (int shift = 0; shift < 64; shift += 8) {
+    size_t count[256] = {0};
+    for (int i = 0; i < n; i++) {
+      count[(a[i].rank >> shift) & 0xff]++;
+    }
+    // Skip passes where every entry shares the same byte (common in the high
+    // bytes of small keys).
+    if (count[(a[0].rank >> shift) & 0xff] == (size_t)n) continue;
+    size_t pos = 0;
+    for (int digit = 0; digit < 256; digit++) {
+      size_t c = count[digit];
+      count[digit] = pos;
+      pos += c;
+    }
+    for (int i = 0; i < n; i++) {
+      b[count[(a[i].rank >> shift) & 0xff]++] = a[i];
+    }
+    _upb_mapsorter_radixent* tmp = a;
+    a = b;
+    b = tmp;
+  }
+
+  for (int i = 0; i < n; i++) {
+    entries[i] = a[i].entry;
+  }
+  free(a);
+  free(b);
+  return true;
+}
+
 bool _upb_mapsorter_pushmap(_upb_mapsorter* s, upb_FieldType key_type,
                             const upb_Map* map, _upb_sortedmap* sorted) {
   int map_size = _upb_Map_Size(map);
 
   if (!_upb_mapsorter_resize(s, sorted, map_size)) return false;
 
-  // Copy non-empty entries from the table to s->entries.
+  // Copy non-empty entries to s->entries: slot pointers for the flat layout,
+  // table entry pointers for the strtable.
   const void** dst = &s->entries[sorted->start];
-  const upb_tabent* src = map->table.t.entries;
-  const upb_tabent* end = src + upb_table_size(&map->table.t);
-  for (; src < end; src++) {
-    if (!upb_tabent_isempty(src)) {
-      *dst = src;
+  if (map->is_flat) {
+    size_t iter = kUpb_Map_Begin;
+    const char* slot;
+    while ((slot = _upb_FlatMap_Next(map, &iter)) != NULL) {
+      *dst = slot;
       dst++;
     }
+  } else {
+    const upb_tabent* src = map->table.t.entries;
+    const upb_tabent* end = src + upb_table_size(&map->table.t);
+    for (; src < end; src++) {
+      if (!upb_tabent_isempty(src)) {
+        *dst = src;
+        dst++;
+      }
+    }
   }
   UPB_ASSERT(dst == &s->entries[sorted->end]);
 
-  // Sort entries according to the key type.
-  qsort(&s->entries[sorted->start], map_size, sizeof(*s->entries),
-        compar[key_type]);
+  // Sort entries according to the key type.  Integer keys use a radix sort
+  // above a small cutoff where its bookkeeping pays for itself.
+  const bool int_keys =
+      map->is_flat || compar[key_type] != _upb_mapsorter_cmpstr;
+  if (!int_keys || map_size < 64 ||
+      !_upb_mapsorter_radixsort(&s->entries[sorted->start], map_size, key_type,
+                                map->is_flat)) {
+    qsort(&s->entries[sorted->start], map_size, sizeof(*s->entries),
+          map->is_flat ? compar_flat[key_type] : compar[key_type]);
+  }
   return true;
 }
 
@@ -72,6 +72,13 @@ UPB_INLINE void _upb_mapsorter_destroy(_upb_mapsorter* s) {
 UPB_INLINE bool _upb_sortedmap_next(_upb_mapsorter* s, const upb_Map* map,
                                     _upb_sortedmap* sorted, upb_MapEntry* ent) {
   if (sorted->pos == sorted->end) return false;
+  if (map->is_flat) {
+    // Entries are slot pointers: key bytes followed by value bytes.
+    const char* slot = (const char*)s->entries[sorted->pos++];
+    memcpy(&ent->data.k, slot, map->key_size);
+    memcpy(&ent->data.v, slot + map->key_size, map->val_size);
+    return true;
+  }
   const upb_tabent* tabent = (const upb_tabent*)s->entries[sorted->pos++];
   upb_StringView key = upb_tabstrview(tabent->key);
   _upb_map_fromkey(key, &ent->data.k, map->key_size);
@@ -25,11 +25,16 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "upb/base/descriptor_constants.h"
 #include "upb/base/string_view.h"
 #include "upb/collections/array.h"
 #include "upb/collections/map.h"
+#include "upb/collections/map_internal.h"
 #include "upb/upb.hpp"
 
 TEST(CollectionsTest, Arrays) {
@@ -77,3 +82,149 @@ TEST(CollectionsTest, MapDeleteRegression) {
   EXPECT_TRUE(
       upb_StringView_IsEqual(insert_value.str_val, delete_value.str_val));
 }
+
+TEST(CollectionsTest, MapLayoutSplit) {
+  // Scalar-scalar maps use the flat inline-slot layout; any string key or
+  // value keeps the strtable layout.
+  upb::Arena arena;
+  upb_Map* map;
+
+  map = upb_Map_New(arena.ptr(), kUpb_CType_Int32, kUpb_CType_Int64);
+  EXPECT_TRUE(map->is_flat);
+  map = upb_Map_New(arena.ptr(), kUpb_CType_UInt64, kUpb_CType_Bool);
+  EXPECT_TRUE(map->is_flat);
+  map = upb_Map_New(arena.ptr(), kUpb_CType_String, kUpb_CType_Int32);
+  EXPECT_FALSE(map->is_flat);
+  map = upb_Map_New(arena.ptr(), kUpb_CType_Int32, kUpb_CType_String);
+  EXPECT_FALSE(map->is_flat);
+}
+
+TEST(CollectionsTest, FlatMapChurn) {
+  upb::Arena arena;
+  upb_Map* map = upb_Map_New(arena.ptr(), kUpb_CType_Int32, kUpb_CType_Int64);
+  ASSERT_TRUE(map->is_flat);
+  std::map<int32_t, int64_t> model;
+
+  for (int32_t i = 0; i < 1000; i++) {
+    upb_MessageValue key = {.int32_val = i};
+    upb_MessageValue val = {.int64_val = i * 10};
+    EXPECT_EQ(upb_Map_Insert(map, key, val, arena.ptr()),
+              kUpb_MapInsertStatus_Inserted);
+    model[i] = i * 10;
+  }
+  EXPECT_EQ(upb_Map_Size(map), model.size());
+
+  // Overwrites replace in place.
+  for (int32_t i = 0; i < 1000; i += 3) {
+    upb_MessageValue key = {.int32_val = i};
+    upb_MessageValue val = {.int64_val = -i};
+    EXPECT_EQ(upb_Map_Insert(map, key, val, arena.ptr()),
+              kUpb_MapInsertStatus_Replaced);
+    model[i] = -i;
+  }
+  EXPECT_EQ(upb_Map_Size(map), model.size());
+
+  // Delete every other key, then iteration must see exactly the survivors.
+  for (int32_t i = 0; i < 1000; i += 2) {
+    upb_MessageValue key = {.int32_val = i};
+    upb_MessageValue deleted;
+    EXPECT_TRUE(upb_Map_Delete(map, key, &deleted));
+    EXPECT_EQ(deleted.int64_val, model[i]);
+    model.erase(i);
+  }
+  EXPECT_EQ(upb_Map_Size(map), model.size());
+
+  std::map<int32_t, int64_t> seen;
+  size_t iter = kUpb_Map_Begin;
+  upb_MessageValue key, val;
+  while (upb_Map_Next(map, &key, &val, &iter)) {
+    EXPECT_TRUE(seen.emplace(key.int32_val, val.int64_val).second);
+  }
+  EXPECT_TRUE(seen == model);
+
+  // Re-inserting deleted keys refills tombstoned slots.
+  for (int32_t i = 0; i < 1000; i += 2) {
+    upb_MessageValue key = {.int32_val = i};
+    upb_MessageValue val = {.int64_val = i + 7};
+    EXPECT_EQ(upb_Map_Insert(map, key, val, arena.ptr()),
+              kUpb_MapInsertStatus_Inserted);
+    model[i] = i + 7;
+  }
+  EXPECT_EQ(upb_Map_Size(map), model.size());
+  for (const auto& pair : model) {
+    upb_MessageValue k = {.int32_val = pair.first};
+    upb_MessageValue v;
+    ASSERT_TRUE(upb_Map_Get(map, k, &v));
+    EXPECT_EQ(v.int64_val, pair.second);
+  }
+
+  upb_Map_Clear(map);
+  EXPECT_EQ(upb_Map_Size(map), (size_t)0);
+  iter = kUpb_Map_Begin;
+  EXPECT_FALSE(upb_Map_Next(map, &key, &val, &iter));
+}
+
+TEST(CollectionsTest, FlatMapTombstoneRebuild) {
+  // One live entry at a time, but every cycle retires a slot; the load
+  // limit counts tombstones, so this drives the same-size rebuild path.
+  // Shedding tombstones (rather than doubling) keeps the table at its
+  // smallest size throughout.
+  upb::Arena arena;
+  upb_Map* map = upb_Map_New(arena.ptr(), kUpb_CType_Int32, kUpb_CType_Int64);
+  for (int32_t i = 0; i < 1000; i++) {
+    upb_MessageValue key = {.int32_val = i};
+    upb_MessageValue val = {.int64_val = i};
+    EXPECT_EQ(upb_Map_Insert(map, key, val, arena.ptr()),
+              kUpb_MapInsertStatus_Inserted);
+    upb_MessageValue got;
+    ASSERT_TRUE(upb_Map_Get(map, key, &got));
+    EXPECT_EQ(got.int64_val, i);
+    if (i % 2 == 0) {
+      EXPECT_TRUE(upb_Map_Delete(map, key, NULL));
+    }
+  }
+  EXPECT_EQ(upb_Map_Size(map), (size_t)500);
+  // 500 live entries fit in 1024 slots; rebuilds must have shed the 500
+  // tombstones along the way instead of growing past that.
+  EXPECT_LE(map->flat_size_lg2, 10);
+
+  for (int32_t i = 0; i < 1000; i++) {
+    upb_MessageValue key = {.int32_val = i};
+    EXPECT_EQ(upb_Map_Get(map, key, NULL), i % 2 != 0);
+  }
+}
+
+TEST(CollectionsTest, StrtableMapChurn) {
+  // The same insert/delete/iterate cycle through the strtable layout.
+  upb::Arena arena;
+  upb_Map* map = upb_Map_New(arena.ptr(), kUpb_CType_String, kUpb_CType_Int32);
+  ASSERT_FALSE(map->is_flat);
+  std::map<std::string, int32_t> model;
+  std::vector<std::string> keys;
+
+  for (int32_t i = 0; i < 100; i++) {
+    keys.push_back("map_key_" + std::to_string(i));
+    upb_MessageValue key = {
+        .str_val = upb_StringView_FromString(keys[i].c_str())};
+    upb_MessageValue val = {.int32_val = i};
+    EXPECT_EQ(upb_Map_Insert(map, key, val, arena.ptr()),
+              kUpb_MapInsertStatus_Inserted);
+    model[keys[i]] = i;
+  }
+  for (int32_t i = 0; i < 100; i += 2) {
+    upb_MessageValue key = {
+        .str_val = upb_StringView_FromString(keys[i].c_str())};
+    EXPECT_TRUE(upb_Map_Delete(map, key, NULL));
+    model.erase(keys[i]);
+  }
+  EXPECT_EQ(upb_Map_Size(map), model.size());
+
+  std::map<std::string, int32_t> seen;
+  size_t iter = kUpb_Map_Begin;
+  upb_MessageValue key, val;
+  while (upb_Map_Next(map, &key, &val, &iter)) {
+    std::string k(key.str_val.data, key.str_val.size);
+    EXPECT_TRUE(seen.emplace(k, val.int32_val).second);
+  }
+  EXPECT_TRUE(seen == model);
+}
@@ -49,6 +49,7 @@
 #include "upb/wire/decode.h"
 #include "upb/wire/decode_fast.h"
 #include "upb/wire/encode.h"
+#include "upb/wire/encode_fast.h"
 // IWYU pragma: end_exports
 
 #endif  // UPB_GENERATED_CODE_SUPPORT_H_
@@ -130,6 +130,8 @@ static bool init(upb_table* t, uint8_t size_lg2, upb_Arena* a) {
   t->size_lg2 = size_lg2;
   t->mask = upb_table_size(t) ? upb_table_size(t) - 1 : 0;
   t->max_count = upb_table_size(t) * MAX_LOAD;
+  t->metadata = NULL;
+  t->used = 0;
   bytes = upb_table_size(t) * sizeof(upb_tabent);
   if (bytes > 0) {
     t->entries = upb_Arena_Malloc(a, bytes);
@@ -176,19 +178,6 @@ static upb_tabent* findentry_mutable(upb_table* t, lookupkey_t key,
   return (upb_tabent*)findentry(t, key, hash, eql);
 }
 
-static bool lookup(const upb_table* t, lookupkey_t key, upb_value* v,
-                   uint32_t hash, eqlfunc_t* eql) {
-  const upb_tabent* e = findentry(t, key, hash, eql);
-  if (e) {
-    if (v) {
-      _upb_value_setval(v, e->val.val);
-    }
-    return true;
-  } else {
-    return false;
-  }
-}
-
 /* The given key must not already exist in the table. */
 static void insert(upb_table* t, lookupkey_t key, upb_tabkey tabkey,
                    upb_value val, uint32_t hash, hashfunc_t* hashfunc,
@@ -287,8 +276,19 @@ static size_t begin(const upb_table* t) { return next(t, -1); }
 
 /* upb_strtable ***************************************************************/
 
-/* A simple "subclass" of upb_table that only adds a hash function for strings.
- */
+/* Open-addressing hash table probed a group of control bytes at a time, in
+ * the style of SwissTable.  Each slot in t->entries has a control byte in
+ * t->metadata: kEmpty if the slot has never held a key, kDeleted if it holds
+ * a tombstone, otherwise the low 7 bits of the key's hash ("H2").  A lookup
+ * hashes the key, then scans whole groups of 8 control bytes at once (with
+ * SSE2 or 64-bit SWAR arithmetic) for bytes equal to H2; entry memory is only
+ * touched for control-byte matches, and the probe stops at the first group
+ * containing an empty byte.  This replaces the pointer chase per collision of
+ * the chained design with a couple of arithmetic ops per 8 slots.
+ *
+ * Slots keep the upb_tabent layout of the chained tables (with `next` unused
+ * and vacant slots holding key 0), so entry iteration, the map sorter, and
+ * the map gencode helpers work unchanged. */
 
 static upb_tabkey strcopy(lookupkey_t k2, upb_Arena* a) {
   uint32_t len = (uint32_t)k2.str.len;
@@ -443,44 +443,298 @@ static uint32_t _upb_Hash_NoSeed(const char* p, size_t n) {
   return _upb_Hash(p, n, 0);
 }
 
-static uint32_t strhash(upb_tabkey key) {
-  uint32_t len;
-  char* str = upb_tabstr(key, &len);
-  return _upb_Hash_NoSeed(str, len);
-}
-
 static bool streql(upb_tabkey k1, lookupkey_t k2) {
   uint32_t len;
   char* str = upb_tabstr(k1, &len);
   return len == k2.str.len && (len == 0 || memcmp(str, k2.str.str, len) == 0);
 }
 
+/* Control bytes.  Full slots hold H2 (0..127); the vacant markers are the
+ * only values with the high bit set, and kEmpty is additionally the only
+ * control byte with bit 1 clear among the three classes, which the SWAR
+ * matchers below rely on. */
+#define UPB_SWISS_GROUP 8
+#define UPB_SWISS_EMPTY ((uint8_t)0x80)
+#define UPB_SWISS_DELETED ((uint8_t)0xfe)
+
+static int swiss_ctz(uint64_t m) {
+#ifdef __GNUC__
+  return __builtin_ctzll(m);
+#else
+  int i = 0;
+  while ((m & 1) == 0) {
+    m >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+/* One bit per slot.  Iterate with swiss_mask_slot() + `m &= m - 1`. */
+typedef uint32_t upb_swissmask;
+
+static __m128i swiss_load_group(const uint8_t* group) {
+  return _mm_loadl_epi64((const __m128i*)group);
+}
+
+static upb_swissmask swiss_match(const uint8_t* group, uint8_t h2) {
+  __m128i eq = _mm_cmpeq_epi8(swiss_load_group(group), _mm_set1_epi8(h2));
+  return _mm_movemask_epi8(eq) & 0xff;
+}
+
+static upb_swissmask swiss_match_empty(const uint8_t* group) {
+  __m128i eq = _mm_cmpeq_epi8(swiss_load_group(group),
+                              _mm_set1_epi8((char)UPB_SWISS_EMPTY));
+  return _mm_movemask_epi8(eq) & 0xff;
+}
+
+static upb_swissmask swiss_match_vacant(const uint8_t* group) {
+  /* The sign bit distinguishes empty/deleted from full. */
+  return _mm_movemask_epi8(swiss_load_group(group)) & 0xff;
+}
+
+static size_t swiss_mask_slot(upb_swissmask m) { return swiss_ctz(m); }
+
+#else
+
+/* High bit of each byte flags its slot.  Iterate with swiss_mask_slot() +
+ * `m &= m - 1`. */
+typedef uint64_t upb_swissmask;
+
+static uint64_t swiss_load_group(const uint8_t* group) {
+  uint64_t w;
+  memcpy(&w, group, sizeof(w));
+  return w;
+}
+
+static upb_swissmask swiss_match(const uint8_t* group, uint8_t h2) {
+  /* Classic SWAR byte-equality check.  A borrow out of a matching byte can
+   * flag an adjacent slot too; callers confirm candidates with a key
+   * compare, so false positives only cost time. */
+  uint64_t x = swiss_load_group(group) ^ (0x0101010101010101ULL * h2);
+  return (x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL;
+}
+
+static upb_swissmask swiss_match_empty(const uint8_t* group) {
+  uint64_t w = swiss_load_group(group);
+  return w & ~(w << 6) & 0x8080808080808080ULL;
+}
+
+static upb_swissmask swiss_match_vacant(const uint8_t* group) {
+  return swiss_load_group(group) & 0x8080808080808080ULL;
+}
+
+static size_t swiss_mask_slot(upb_swissmask m) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return 7 - swiss_ctz(m) / 8;
+#else
+  return swiss_ctz(m) / 8;
+#endif
+}
+
+#endif /* __SSE2__ */
+
+static size_t swiss_group_count(const upb_table* t) {
+  return upb_table_size(t) / UPB_SWISS_GROUP;
+}
+
+static bool swiss_init(upb_table* t, uint8_t size_lg2, upb_Arena* a) {
+  /* At least one full probe group. */
+  if (size_lg2 < 3) size_lg2 = 3;
+  t->count = 0;
+  t->used = 0;
+  t->size_lg2 = size_lg2;
+  t->mask = upb_table_size(t) - 1;
+  t->max_count = upb_table_size(t) * MAX_LOAD;
+  size_t entry_bytes = upb_table_size(t) * sizeof(upb_tabent);
+  char* mem = upb_Arena_Malloc(a, entry_bytes + upb_table_size(t));
+  if (!mem) return false;
+  t->entries = (upb_tabent*)mem;
+  t->metadata = (uint8_t*)(mem + entry_bytes);
+  memset(t->entries, 0, entry_bytes);
+  memset(t->metadata, UPB_SWISS_EMPTY, upb_table_size(t));
+  return true;
+}
+
+static const upb_tabent* swiss_findentry(const upb_table* t, lookupkey_t key,
+                                         uint32_t hash) {
+  if (!t->entries) return NULL;
+  const uint8_t h2 = hash & 0x7f;
+  const size_t group_mask = swiss_group_count(t) - 1;
+  size_t group = (hash >> 7) & group_mask;
+  while (1) {
+    const uint8_t* meta = &t->metadata[group * UPB_SWISS_GROUP];
+    upb_swissmask m = swiss_match(meta, h2);
+    while (m) {
+      const upb_tabent* e =
+          &t->entries[group * UPB_SWISS_GROUP + swiss_mask_slot(m)];
+      if (streql(e->key, key)) return e;
+      m &= m - 1;
+    }
+    /* The load limit guarantees some empty slots, so this terminates. */
+    if (swiss_match_empty(meta)) return NULL;
+    group = (group + 1) & group_mask;
+  }
+}
+
+/* The chaining pointer is unused under open addressing, so strtable entries
+ * repurpose it to cache the key's full hash.  Rehashes are then move-only:
+ * no key bytes are re-read to place an entry in the resized table. */
+static uint32_t swiss_cached_hash(const upb_tabent* e) {
+  return (uint32_t)(uintptr_t)e->next;
+}
+
+/* The given key must not already exist in the table, and the table must have
+ * a vacant slot. */
+static void swiss_insert(upb_table* t, upb_tabkey tabkey, upb_value val,
+                         uint32_t hash) {
+  const size_t group_mask = swiss_group_count(t) - 1;
+  size_t group = (hash >> 7) & group_mask;
+  while (1) {
+    const uint8_t* meta = &t->metadata[group * UPB_SWISS_GROUP];
+    upb_swissmask m = swiss_match_vacant(meta);
+    if (m) {
+      size_t slot = group * UPB_SWISS_GROUP + swiss_mask_slot(m);
+      upb_tabent* e = &t->entries[slot];
+      /* Refilling a tombstone does not change `used`. */
+      if (t->metadata[slot] == UPB_SWISS_EMPTY) t->used++;
+      t->metadata[slot] = hash & 0x7f;
+      e->key = tabkey;
+      e->val.val = val.val;
+      e->next = (const upb_tabent*)(uintptr_t)hash;
+      t->count++;
+      return;
+    }
+    group = (group + 1) & group_mask;
+  }
+}
+
+static void swiss_removeat(upb_table* t, size_t slot) {
+  upb_tabent* e = &t->entries[slot];
+  /* Leave a tombstone so probe sequences that passed through this slot stay
+   * intact; tombstones are reclaimed by the next rehash.  Clearing the key
+   * keeps upb_tabent_isempty() (and thus entry iteration) accurate. */
+  t->metadata[slot] = UPB_SWISS_DELETED;
+  e->key = 0;
+  e->val.val = 0;
+  e->next = NULL;
+  t->count--;
+}
+
+/* Incremental rehash.  A one-shot rehash of a big table is a long pause
+ * (every entry is re-placed with a cache miss apiece), so tables that opted
+ * in via upb_strtable_setincrementalrehash() grow by keeping the old slot
+ * array alive and migrating a few probe groups of entries per mutating
+ * operation.  While a migration is pending, lookups probe the new table and
+ * then the old one, and inserts always go to the new table.  Migration uses
+ * the cached hashes, so no key bytes are re-read. */
+
+#define UPB_SWISS_MIGRATE_SLOTS (2 * UPB_SWISS_GROUP)
+
+static void strtable_dropold(upb_strtable* t) {
+  /* The old arrays are arena-owned; just unhook them. */
+  memset(&t->old, 0, sizeof(t->old));
+  t->rehash_pos = 0;
+}
+
+/* Migrates old-table slots [rehash_pos, end) into the new table. */
+static void strtable_migrate(upb_strtable* t, size_t end) {
+  for (size_t i = t->rehash_pos; i < end; i++) {
+    upb_tabent* e = &t->old.entries[i];
+    if (upb_tabent_isempty(e)) continue;
+    upb_value val;
+    _upb_value_setval(&val, e->val.val);
+    swiss_insert(&t->t, e->key, val, swiss_cached_hash(e));
+    swiss_removeat(&t->old, i);
+  }
+  t->rehash_pos = end;
+  if (end == upb_table_size(&t->old)) {
+    UPB_ASSERT(t->old.count == 0);
+    strtable_dropold(t);
+  }
+}
+
+static void strtable_finishrehash(upb_strtable* t) {
+  if (t->old.entries) strtable_migrate(t, upb_table_size(&t->old));
+}
+
+static void strtable_rehashstep(upb_strtable* t) {
+  if (!t->old.entries) return;
+  strtable_migrate(
+      t, UPB_MIN(t->rehash_pos + UPB_SWISS_MIGRATE_SLOTS,
+                 upb_table_size(&t->old)));
+}
+
+/* Like swiss_findentry() but also checks the old table while an incremental
+ * rehash is in progress. */
+static const upb_tabent* strtable_findentry(const upb_strtable* t,
+                                            lookupkey_t key, uint32_t hash) {
+  const upb_tabent* e = swiss_findentry(&t->t, key, hash);
+  if (!e && t->old.entries) e = swiss_findentry(&t->old, key, hash);
+  return e;
+}
+
+void upb_strtable_setincrementalrehash(upb_strtable* t, bool enabled) {
+  t->incremental = enabled;
+  if (!enabled) strtable_finishrehash(t);
+}
+
 bool upb_strtable_init(upb_strtable* t, size_t expected_size, upb_Arena* a) {
   // Multiply by approximate reciprocal of MAX_LOAD (0.85), with pow2
   // denominator.
   size_t need_entries = (expected_size + 1) * 1204 / 1024;
   UPB_ASSERT(need_entries >= expected_size * 0.85);
   int size_lg2 = upb_Log2Ceiling(need_entries);
-  return init(&t->t, size_lg2, a);
+  memset(&t->old, 0, sizeof(t->old));
+  t->rehash_pos = 0;
+  t->incremental = false;
+  return swiss_init(&t->t, size_lg2, a);
 }
 
 void upb_strtable_clear(upb_strtable* t) {
-  size_t bytes = upb_table_size(&t->t) * sizeof(upb_tabent);
+  strtable_dropold(t);
   t->t.count = 0;
-  memset((char*)t->t.entries, 0, bytes);
+  t->t.used = 0;
+  if (!t->t.entries) return;  // Zero-initialized table; nothing allocated.
+  memset((char*)t->t.entries, 0, upb_table_size(&t->t) * sizeof(upb_tabent));
+  memset(t->t.metadata, UPB_SWISS_EMPTY, upb_table_size(&t->t));
 }
 
 bool upb_strtable_resize(upb_strtable* t, size_t size_lg2, upb_Arena* a) {
-  upb_strtable new_table;
-  if (!init(&new_table.t, size_lg2, a)) return false;
+  /* At most one migration can be pending at a time. */
+  strtable_finishrehash(t);
+
+  upb_table new_table;
+  /* Never shrink below what the current entries need. */
+  while (((size_t)1 << size_lg2) * MAX_LOAD <= t->t.count) size_lg2++;
+  if (!swiss_init(&new_table, size_lg2, a)) return false;
+
+  if (t->incremental && t->t.count) {
+    /* Start an amortized migration; the slot-array allocation above stays
+     * one-shot, but the cache-miss-heavy entry placement is spread over the
+     * coming mutations (and bounded-rate via strtable_rehashstep()). */
+    t->old = t->t;
+    t->t = new_table;
+    t->rehash_pos = 0;
+    return true;
+  }
 
-  intptr_t iter = UPB_STRTABLE_BEGIN;
-  upb_StringView key;
-  upb_value val;
-  while (upb_strtable_next2(t, &key, &val, &iter)) {
-    upb_strtable_insert(&new_table, key.data, key.size, val, a);
+  /* Move entries over using their cached hashes; no key memory is read or
+   * copied. */
+  const size_t size = upb_table_size(&t->t);
+  for (size_t i = 0; i < size; i++) {
+    const upb_tabent* e = &t->t.entries[i];
+    if (upb_tabent_isempty(e)) continue;
+    upb_value val;
+    _upb_value_setval(&val, e->val.val);
+    swiss_insert(&new_table, e->key, val, swiss_cached_hash(e));
   }
-  *t = new_table;
+  UPB_ASSERT(new_table.count == t->t.count);
+  t->t = new_table;
   return true;
 }
 
@@ -490,9 +744,14 @@ bool upb_strtable_insert(upb_strtable* t, const char* k, size_t len,
   upb_tabkey tabkey;
   uint32_t hash;
 
-  if (isfull(&t->t)) {
-    /* Need to resize.  New table of double the size, add old elements to it. */
-    if (!upb_strtable_resize(t, t->t.size_lg2 + 1, a)) {
+  strtable_rehashstep(t);
+  if (t->t.used >= t->t.max_count) {
+    /* Hit the load limit (counting tombstones).  Double if the table is
+     * genuinely full; rehash at the same size to shed tombstones if it is
+     * mostly dead. */
+    size_t size_lg2 = t->t.size_lg2;
+    if (upb_strtable_count(t) >= upb_table_size(&t->t) / 2) size_lg2++;
+    if (!upb_strtable_resize(t, size_lg2, a)) {
       return false;
     }
   }
@@ -502,21 +761,129 @@ bool upb_strtable_insert(upb_strtable* t, const char* k, size_t len,
   if (tabkey == 0) return false;
 
   hash = _upb_Hash_NoSeed(key.str.str, key.str.len);
-  insert(&t->t, key, tabkey, v, hash, &strhash, &streql);
+  UPB_ASSERT(strtable_findentry(t, key, hash) == NULL);
+  swiss_insert(&t->t, tabkey, v, hash);
+  return true;
+}
+
+bool upb_strtable_upsert(upb_strtable* t, const char* k, size_t len,
+                         upb_value v, bool* replaced, upb_Arena* a) {
+  strtable_rehashstep(t);
+  if (t->t.used >= t->t.max_count) {
+    /* See upb_strtable_insert(). */
+    size_t size_lg2 = t->t.size_lg2;
+    if (upb_strtable_count(t) >= upb_table_size(&t->t) / 2) size_lg2++;
+    if (!upb_strtable_resize(t, size_lg2, a)) return false;
+  }
+
+  /* One probe pass finds the existing entry or the insertion slot. */
+  const uint32_t hash = _upb_Hash_NoSeed(k, len);
+  const lookupkey_t key = strkey2(k, len);
+
+  if (t->old.entries) {
+    /* The key may still live in the unmigrated part of the old table. */
+    const upb_tabent* oe = swiss_findentry(&t->old, key, hash);
+    if (oe) {
+      ((upb_tabent*)oe)->val.val = v.val;
+      *replaced = true;
+      return true;
+    }
+  }
+
+  const uint8_t h2 = hash & 0x7f;
+  const size_t group_mask = swiss_group_count(&t->t) - 1;
+  size_t group = (hash >> 7) & group_mask;
+  size_t vacant_slot = SIZE_MAX;
+  while (1) {
+    const uint8_t* meta = &t->t.metadata[group * UPB_SWISS_GROUP];
+    upb_swissmask m = swiss_match(meta, h2);
+    while (m) {
+      size_t slot = group * UPB_SWISS_GROUP + swiss_mask_slot(m);
+      upb_tabent* e = &t->t.entries[slot];
+      if (streql(e->key, key)) {
+        e->val.val = v.val;
+        *replaced = true;
+        return true;
+      }
+      m &= m - 1;
+    }
+    if (vacant_slot == SIZE_MAX) {
+      upb_swissmask vm = swiss_match_vacant(meta);
+      if (vm) vacant_slot = group * UPB_SWISS_GROUP + swiss_mask_slot(vm);
+    }
+    if (swiss_match_empty(meta)) break;
+    group = (group + 1) & group_mask;
+  }
+
+  upb_tabkey tabkey = strcopy(key, a);
+  if (tabkey == 0) return false;
+  UPB_ASSERT(vacant_slot != SIZE_MAX);
+  upb_tabent* e = &t->t.entries[vacant_slot];
+  if (t->t.metadata[vacant_slot] == UPB_SWISS_EMPTY) t->t.used++;
+  t->t.metadata[vacant_slot] = h2;
+  e->key = tabkey;
+  e->val.val = v.val;
+  e->next = (const upb_tabent*)(uintptr_t)hash;
+  t->t.count++;
+  *replaced = false;
   return true;
 }
 
 bool upb_strtable_lookup2(const upb_strtable* t, const char* key, size_t len,
                           upb_value* v) {
   uint32_t hash = _upb_Hash_NoSeed(key, len);
-  return lookup(&t->t, strkey2(key, len), v, hash, &streql);
+  const upb_tabent* e = strtable_findentry(t, strkey2(key, len), hash);
+  if (!e) return false;
+  if (v) _upb_value_setval(v, e->val.val);
+  return true;
+}
+
+bool upb_strtable_lookup3(const upb_strtable* t, const char* key, size_t len,
+                          upb_value* v, upb_StringView* out_key) {
+  uint32_t hash = _upb_Hash_NoSeed(key, len);
+  const upb_tabent* e = strtable_findentry(t, strkey2(key, len), hash);
+  if (!e) return false;
+  if (v) _upb_value_setval(v, e->val.val);
+  if (out_key) *out_key = upb_tabstrview(e->key);
+  return true;
+}
+
+void upb_strtable_visitpart(const upb_strtable* t, size_t part, size_t parts,
+                            void (*visit)(upb_StringView key, upb_value val,
+                                          void* ctx),
+                            void* ctx) {
+  UPB_ASSERT(parts > 0 && part < parts);
+  const size_t tsize = upb_table_size(&t->t);
+  /* While an incremental rehash is pending, the old table's unmigrated slots
+   * extend the slot array at indices [tsize, tsize + size(old)). */
+  const size_t size = tsize + (t->old.entries ? upb_table_size(&t->old) : 0);
+  const size_t start = size * part / parts;
+  const size_t end = size * (part + 1) / parts;
+  for (size_t i = start; i < end; i++) {
+    const upb_tabent* e =
+        i < tsize ? &t->t.entries[i] : &t->old.entries[i - tsize];
+    if (upb_tabent_isempty(e)) continue;
+    upb_value val;
+    _upb_value_setval(&val, e->val.val);
+    visit(upb_tabstrview(e->key), val, ctx);
+  }
 }
 
 bool upb_strtable_remove2(upb_strtable* t, const char* key, size_t len,
                           upb_value* val) {
+  strtable_rehashstep(t);
   uint32_t hash = _upb_Hash_NoSeed(key, len);
-  upb_tabkey tabkey;
-  return rm(&t->t, strkey2(key, len), val, &tabkey, hash, &streql);
+  const lookupkey_t k = strkey2(key, len);
+  upb_table* tab = &t->t;
+  const upb_tabent* e = swiss_findentry(tab, k, hash);
+  if (!e && t->old.entries) {
+    tab = &t->old;
+    e = swiss_findentry(tab, k, hash);
+  }
+  if (!e) return false;
+  if (val) _upb_value_setval(val, e->val.val);
+  swiss_removeat(tab, e - tab->entries);
+  return true;
 }
 
 /* Iteration */
@@ -633,6 +1000,61 @@ bool upb_inttable_init(upb_inttable* t, upb_Arena* a) {
   return upb_inttable_sizedinit(t, 0, 4, a);
 }
 
+/* Attempts to grow the array part to cover `key`, which must currently fall
+ * in the hash part's range.  Only grows if the resulting array would be at
+ * least MIN_DENSITY full, counting the hash-part keys that would migrate into
+ * it, so sparse key sets never bloat the array.  This gives tables built from
+ * small, mostly-sequential IDs direct indexing without waiting for an
+ * explicit upb_inttable_compact().  Returns true if the array now covers
+ * `key`; the table is unchanged on failure (including OOM). */
+static bool inttable_grow_array(upb_inttable* t, uintptr_t key, upb_Arena* a) {
+  if (key >= (uintptr_t)1 << UPB_MAXARRSIZE) return false;
+  const size_t new_size = (size_t)1 << log2ceil(key + 1);
+  UPB_ASSERT(new_size > t->array_size);
+
+  /* The new element plus everything that would move from the hash part. */
+  size_t would_have = t->array_count + 1;
+  const size_t hash_size = upb_table_size(&t->t);
+  size_t migrants = 0;
+  for (size_t i = 0; i < hash_size; i++) {
+    const upb_tabent* e = &t->t.entries[i];
+    if (!upb_tabent_isempty(e) && e->key < new_size) migrants++;
+  }
+  would_have += migrants;
+  if (would_have < new_size * MIN_DENSITY) return false;
+
+  upb_tabval* new_array =
+      upb_Arena_Realloc(a, mutable_array(t), t->array_size * sizeof(upb_tabval),
+                        new_size * sizeof(upb_tabval));
+  if (!new_array) return false;
+  memset(&new_array[t->array_size], 0xff,
+         (new_size - t->array_size) * sizeof(upb_tabval));
+
+  if (migrants) {
+    /* Rebuild the hash part without the keys the array now covers. */
+    upb_table new_hash;
+    if (!init(&new_hash, t->t.size_lg2, a)) return false;
+    for (size_t i = 0; i < hash_size; i++) {
+      const upb_tabent* e = &t->t.entries[i];
+      if (upb_tabent_isempty(e)) continue;
+      if (e->key < new_size) {
+        new_array[e->key] = e->val;
+      } else {
+        upb_value v;
+        _upb_value_setval(&v, e->val.val);
+        insert(&new_hash, intkey(e->key), e->key, v, upb_inthash(e->key),
+               &inthash, &inteql);
+      }
+    }
+    t->t = new_hash;
+    t->array_count += migrants;
+  }
+
+  t->array = new_array;
+  t->array_size = new_size;
+  return true;
+}
+
 bool upb_inttable_insert(upb_inttable* t, uintptr_t key, upb_value val,
                          upb_Arena* a) {
   upb_tabval tabval;
@@ -640,6 +1062,8 @@ bool upb_inttable_insert(upb_inttable* t, uintptr_t key, upb_value val,
   UPB_ASSERT(
       upb_arrhas(tabval)); /* This will reject (uint64_t)-1.  Fix this. */
 
+  if (key >= t->array_size) inttable_grow_array(t, key, a);
+
   if (key < t->array_size) {
     UPB_ASSERT(!upb_arrhas(t->array[key]));
     t->array_count++;
@@ -830,44 +1254,52 @@ void upb_inttable_removeiter(upb_inttable* t, intptr_t* iter) {
 
 bool upb_strtable_next2(const upb_strtable* t, upb_StringView* key,
                         upb_value* val, intptr_t* iter) {
-  size_t tab_idx = next(&t->t, *iter);
-  if (tab_idx < upb_table_size(&t->t)) {
-    upb_tabent* ent = &t->t.entries[tab_idx];
-    uint32_t len;
-    key->data = upb_tabstr(ent->key, &len);
-    key->size = len;
-    *val = _upb_value_val(ent->val.val);
-    *iter = tab_idx;
-    return true;
+  /* Iterator index space: [0, size(t)) walks the main table; while an
+   * incremental rehash is pending, [size(t), size(t) + size(old)) continues
+   * into the old table's unmigrated slots. */
+  const size_t tsize = upb_table_size(&t->t);
+  const upb_tabent* ent = NULL;
+  size_t tab_idx = 0;
+  if (*iter == UPB_STRTABLE_BEGIN || (size_t)*iter < tsize) {
+    tab_idx = next(&t->t, *iter);
+    if (tab_idx < tsize) {
+      ent = &t->t.entries[tab_idx];
+    } else if (t->old.entries) {
+      tab_idx = begin(&t->old);
+      if (tab_idx < upb_table_size(&t->old)) {
+        ent = &t->old.entries[tab_idx];
+        tab_idx += tsize;
+      }
+    }
+  } else if (t->old.entries) {
+    tab_idx = next(&t->old, (size_t)*iter - tsize);
+    if (tab_idx < upb_table_size(&t->old)) {
+      ent = &t->old.entries[tab_idx];
+      tab_idx += tsize;
+    }
   }
+  if (!ent) return false;
 
-  return false;
+  uint32_t len;
+  key->data = upb_tabstr(ent->key, &len);
+  key->size = len;
+  *val = _upb_value_val(ent->val.val);
+  *iter = tab_idx;
+  return true;
 }
 
 void upb_strtable_removeiter(upb_strtable* t, intptr_t* iter) {
-  intptr_t i = *iter;
-  upb_tabent* ent = &t->t.entries[i];
-  upb_tabent* prev = NULL;
-
-  // Linear search, not great.
-  upb_tabent* end = &t->t.entries[upb_table_size(&t->t)];
-  for (upb_tabent* e = t->t.entries; e != end; e++) {
-    if (e->next == ent) {
-      prev = e;
-      break;
-    }
-  }
-
-  if (prev) {
-    prev->next = ent->next;
+  const size_t tsize = upb_table_size(&t->t);
+  if ((size_t)*iter < tsize) {
+    swiss_removeat(&t->t, *iter);
+  } else {
+    swiss_removeat(&t->old, (size_t)*iter - tsize);
   }
-
-  t->t.count--;
-  ent->key = 0;
-  ent->next = NULL;
 }
 
 void upb_strtable_setentryvalue(upb_strtable* t, intptr_t iter, upb_value v) {
-  upb_tabent* ent = &t->t.entries[iter];
+  const size_t tsize = upb_table_size(&t->t);
+  upb_tabent* ent = (size_t)iter < tsize ? &t->t.entries[iter]
+                                         : &t->old.entries[iter - tsize];
   ent->val.val = v.val;
 }
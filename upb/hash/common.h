@@ -32,9 +32,11 @@
  * This file defines very fast int->upb_value (inttable) and string->upb_value
  * (strtable) hash tables.
  *
- * The table uses chained scatter with Brent's variation (inspired by the Lua
- * implementation of hash tables).  The hash function for strings is Austin
- * Appleby's "MurmurHash."
+ * The inttable uses chained scatter with Brent's variation (inspired by the
+ * Lua implementation of hash tables).  The strtable uses open addressing with
+ * per-entry control bytes probed a group at a time (in the style of
+ * SwissTable); see hash/common.c.  The hash function for strings is a variant
+ * of ABSL's wyhash.
  *
  * The inttable uses uintptr_t as its key, which guarantees it can be used to
  * store pointers or integers of at least 32 bits (upb isn't really useful on
@@ -179,6 +181,13 @@ typedef struct {
   uint32_t max_count; /* Max count before we hit our load limit. */
   uint8_t size_lg2;   /* Size of the hashtable part is 2^size_lg2 entries. */
   upb_tabent* entries;
+
+  /* String tables use open addressing instead of chaining and carry one
+   * control byte per entry plus a count of non-empty (full or tombstoned)
+   * slots; see the strtable section of hash/common.c.  Both are unused
+   * (NULL/0) for int tables. */
+  uint8_t* metadata;
+  uint32_t used;
 } upb_table;
 
 UPB_INLINE size_t upb_table_size(const upb_table* t) {
@@ -35,6 +35,13 @@
 
 typedef struct {
   upb_table t;
+
+  /* Incremental rehash state (see upb_strtable_setincrementalrehash()).
+   * While a rehash is in progress `old.entries` is non-NULL and entries not
+   * yet migrated to `t` still live in `old`; otherwise `old` is all zeros. */
+  upb_table old;
+  uint32_t rehash_pos; /* Next `old` slot to migrate. */
+  bool incremental;
 } upb_strtable;
 
 #ifdef __cplusplus
@@ -47,11 +54,21 @@ bool upb_strtable_init(upb_strtable* table, size_t expected_size, upb_Arena* a);
 
 // Returns the number of values in the table.
 UPB_INLINE size_t upb_strtable_count(const upb_strtable* t) {
-  return t->t.count;
+  return t->t.count + t->old.count;
 }
 
 void upb_strtable_clear(upb_strtable* t);
 
+// Selects incremental (amortized) rehashing for this table.  A one-shot
+// rehash of a large table is a long pause; with this enabled, growth
+// allocates the new slot array up front but migrates entries a few probe
+// groups per mutating operation, so the per-operation cost stays bounded.
+// Lookups and upb_strtable_next2() iteration see all entries while a
+// migration is in progress (lookups probe at most one extra table); the
+// DEPRECATED upb_strtable_iter API does not and must not be used on a table
+// with this enabled.  Disabling completes any migration in progress.
+void upb_strtable_setincrementalrehash(upb_strtable* t, bool enabled);
+
 // Inserts the given key into the hashtable with the given value.
 // The key must not already exist in the hash table. The key is not required
 // to be NULL-terminated, and the table will make an internal copy of the key.
@@ -61,17 +78,44 @@ void upb_strtable_clear(upb_strtable* t);
 bool upb_strtable_insert(upb_strtable* t, const char* key, size_t len,
                          upb_value val, upb_Arena* a);
 
+// Inserts the given key, or overwrites the value if the key is already
+// present, in a single probe pass (the key is hashed once and each slot is
+// visited at most once).  This is the hot path for map entries decoded from
+// the wire, which must keep the last value for a duplicated key.  Sets
+// *replaced according to which case occurred.  Returns false if a needed
+// allocation failed; the table is unchanged in that case.
+bool upb_strtable_upsert(upb_strtable* t, const char* key, size_t len,
+                         upb_value val, bool* replaced, upb_Arena* a);
+
 // Looks up key in this table, returning "true" if the key was found.
 // If v is non-NULL, copies the value for this key into *v.
 bool upb_strtable_lookup2(const upb_strtable* t, const char* key, size_t len,
                           upb_value* v);
 
+// Like upb_strtable_lookup2(), but additionally returns a view of the table's
+// own copy of the key in `out_key` (if non-NULL).  That copy is stable for the
+// life of the table's arena, which makes it usable as a canonical interned
+// instance of the string.
+bool upb_strtable_lookup3(const upb_strtable* t, const char* key, size_t len,
+                          upb_value* v, upb_StringView* out_key);
+
 // For NULL-terminated strings.
 UPB_INLINE bool upb_strtable_lookup(const upb_strtable* t, const char* key,
                                     upb_value* v) {
   return upb_strtable_lookup2(t, key, strlen(key), v);
 }
 
+// Visits every entry whose slot falls in partition `part` (0 <= part <
+// `parts`) of the table's slot array.  The partitions are disjoint and
+// together cover the whole table, and an entry's partition is stable as long
+// as the table is not mutated, so `parts` threads may each walk their own
+// partition concurrently on a read-only table.  Entries are visited in slot
+// order, which is unrelated to key or insertion order.
+void upb_strtable_visitpart(const upb_strtable* t, size_t part, size_t parts,
+                            void (*visit)(upb_StringView key, upb_value val,
+                                          void* ctx),
+                            void* ctx);
+
 // Removes an item from the table. Returns true if the remove was successful,
 // and stores the removed item in *val if non-NULL.
 bool upb_strtable_remove2(upb_strtable* t, const char* key, size_t len,
@@ -256,3 +256,185 @@ TEST(Table, Init) {
     upb_strtable_init(&t, i, arena.ptr());
   }
 }
+
+TEST(Table, StringTableTombstoneReuse) {
+  upb::Arena arena;
+  upb_strtable t;
+  ASSERT_TRUE(upb_strtable_init(&t, 8, arena.ptr()));
+
+  std::vector<std::string> keys;
+  for (int i = 0; i < 8; i++) {
+    keys.push_back("tombstone_key_" + std::to_string(i));
+    ASSERT_TRUE(upb_strtable_insert(&t, keys[i].data(), keys[i].size(),
+                                    upb_value_int32(i), arena.ptr()));
+  }
+  const uint8_t size_lg2 = t.t.size_lg2;
+  const uint32_t used = t.t.used;
+
+  // Removing an entry leaves a tombstone: `count` drops but `used` (which
+  // includes tombstones) does not.
+  ASSERT_TRUE(upb_strtable_remove(&t, keys[3].c_str(), NULL));
+  EXPECT_EQ(upb_strtable_count(&t), keys.size() - 1);
+  EXPECT_EQ(t.t.used, used);
+
+  // Re-inserting the same key probes the same slot sequence, so the
+  // tombstone is the first vacant slot and must be refilled in place.
+  ASSERT_TRUE(upb_strtable_insert(&t, keys[3].data(), keys[3].size(),
+                                  upb_value_int32(33), arena.ptr()));
+  EXPECT_EQ(upb_strtable_count(&t), keys.size());
+  EXPECT_EQ(t.t.used, used);
+  upb_value val;
+  ASSERT_TRUE(upb_strtable_lookup(&t, keys[3].c_str(), &val));
+  EXPECT_EQ(upb_value_getint32(val), 33);
+
+  // Churning one key must not consume fresh slots or ever grow the table.
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(upb_strtable_remove(&t, keys[5].c_str(), NULL));
+    ASSERT_TRUE(upb_strtable_insert(&t, keys[5].data(), keys[5].size(),
+                                    upb_value_int32(i), arena.ptr()));
+  }
+  EXPECT_EQ(t.t.used, used);
+  EXPECT_EQ(t.t.size_lg2, size_lg2);
+  for (size_t i = 0; i < keys.size(); i++) {
+    EXPECT_TRUE(upb_strtable_lookup(&t, keys[i].c_str(), NULL));
+  }
+}
+
+TEST(Table, StringTableSameSizeRehashShedsTombstones) {
+  upb::Arena arena;
+  upb_strtable t;
+  ASSERT_TRUE(upb_strtable_init(&t, 8, arena.ptr()));
+
+  // Fill right up to the load limit (`used` counts tombstones too, so this
+  // is the last state before the next insert must rehash).
+  std::vector<std::string> keys;
+  for (int i = 0; t.t.used < t.t.max_count; i++) {
+    std::string key = "shed_key_" + std::to_string(i);
+    ASSERT_TRUE(upb_strtable_insert(&t, key.data(), key.size(),
+                                    upb_value_int32(i), arena.ptr()));
+    keys.push_back(key);
+  }
+  const uint8_t size_lg2 = t.t.size_lg2;
+
+  // Turn most of the table into tombstones.
+  while (upb_strtable_count(&t) > 2) {
+    ASSERT_TRUE(upb_strtable_remove(&t, keys.back().c_str(), NULL));
+    keys.pop_back();
+  }
+  EXPECT_EQ(t.t.used, t.t.max_count);
+
+  // The next insert hits the load limit, but with count < size/2 it must
+  // rehash at the *same* size to shed tombstones rather than doubling.
+  const std::string extra = "shed_key_extra";
+  ASSERT_TRUE(upb_strtable_insert(&t, extra.data(), extra.size(),
+                                  upb_value_int32(-1), arena.ptr()));
+  keys.push_back(extra);
+  EXPECT_EQ(t.t.size_lg2, size_lg2);
+  EXPECT_EQ(t.t.used, (uint32_t)t.t.count);  // All tombstones reclaimed.
+
+  EXPECT_EQ(upb_strtable_count(&t), keys.size());
+  for (const auto& key : keys) {
+    EXPECT_TRUE(upb_strtable_lookup(&t, key.c_str(), NULL));
+  }
+}
+
+TEST(Table, StringTableIncrementalRehash) {
+  upb::Arena arena;
+  upb_strtable t;
+  ASSERT_TRUE(upb_strtable_init(&t, 4, arena.ptr()));
+  upb_strtable_setincrementalrehash(&t, true);
+
+  std::map<std::string, int32_t> m;
+  bool saw_migration = false;
+  for (int i = 0; i < 1000; i++) {
+    std::string key = "incremental_key_" + std::to_string(i);
+    ASSERT_TRUE(upb_strtable_insert(&t, key.data(), key.size(),
+                                    upb_value_int32(i), arena.ptr()));
+    m[key] = i;
+    ASSERT_EQ(upb_strtable_count(&t), m.size());
+
+    if (t.old.entries == NULL) continue;
+    saw_migration = true;
+
+    // With a migration in flight, lookups and iteration must still see
+    // every entry exactly once, split across the old and new tables.
+    upb_value val;
+    ASSERT_TRUE(upb_strtable_lookup2(&t, key.data(), key.size(), &val));
+    EXPECT_EQ(upb_value_getint32(val), i);
+    if (i % 37 != 0) continue;
+    std::set<std::string> seen;
+    intptr_t iter = UPB_STRTABLE_BEGIN;
+    upb_StringView iter_key;
+    while (upb_strtable_next2(&t, &iter_key, &val, &iter)) {
+      std::string k(iter_key.data, iter_key.size);
+      EXPECT_TRUE(seen.insert(k).second);
+      EXPECT_EQ(upb_value_getint32(val), m[k]);
+    }
+    EXPECT_EQ(seen.size(), m.size());
+  }
+  EXPECT_TRUE(saw_migration);
+
+  // Removal during a pending migration must work on entries in either table.
+  while (t.old.entries != NULL && !m.empty()) {
+    std::string key = m.begin()->first;
+    ASSERT_TRUE(upb_strtable_remove(&t, key.c_str(), NULL));
+    m.erase(m.begin());
+    ASSERT_EQ(upb_strtable_count(&t), m.size());
+  }
+
+  // Disabling incremental mode completes any migration in progress.
+  upb_strtable_setincrementalrehash(&t, false);
+  EXPECT_EQ(t.old.entries, nullptr);
+  EXPECT_EQ(upb_strtable_count(&t), m.size());
+  for (const auto& pair : m) {
+    upb_value val;
+    ASSERT_TRUE(upb_strtable_lookup(&t, pair.first.c_str(), &val));
+    EXPECT_EQ(upb_value_getint32(val), pair.second);
+  }
+}
+
+TEST(Table, StringTableUpsert) {
+  upb::Arena arena;
+  upb_strtable t;
+  ASSERT_TRUE(upb_strtable_init(&t, 8, arena.ptr()));
+
+  bool replaced;
+  std::map<std::string, int32_t> m;
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < 100; i++) {
+      std::string key = "upsert_key_" + std::to_string(i);
+      int32_t v = pass * 1000 + i;
+      ASSERT_TRUE(upb_strtable_upsert(&t, key.data(), key.size(),
+                                      upb_value_int32(v), &replaced,
+                                      arena.ptr()));
+      EXPECT_EQ(replaced, pass == 1);  // Second pass overwrites in place.
+      m[key] = v;
+      ASSERT_EQ(upb_strtable_count(&t), m.size());
+    }
+  }
+  for (const auto& pair : m) {
+    upb_value val;
+    ASSERT_TRUE(upb_strtable_lookup(&t, pair.first.c_str(), &val));
+    EXPECT_EQ(upb_value_getint32(val), pair.second);
+  }
+
+  // Upsert must also find keys that a pending incremental migration has not
+  // yet moved out of the old table.
+  upb_strtable_setincrementalrehash(&t, true);
+  for (int i = 100; t.old.entries == NULL; i++) {
+    std::string key = "upsert_key_" + std::to_string(i);
+    ASSERT_TRUE(upb_strtable_upsert(&t, key.data(), key.size(),
+                                    upb_value_int32(i), &replaced,
+                                    arena.ptr()));
+    EXPECT_FALSE(replaced);
+    m[key] = i;
+  }
+  std::string old_key = "upsert_key_0";
+  ASSERT_TRUE(upb_strtable_upsert(&t, old_key.data(), old_key.size(),
+                                  upb_value_int32(-7), &replaced, arena.ptr()));
+  EXPECT_TRUE(replaced);
+  EXPECT_EQ(upb_strtable_count(&t), m.size());
+  upb_value val;
+  ASSERT_TRUE(upb_strtable_lookup(&t, old_key.c_str(), &val));
+  EXPECT_EQ(upb_value_getint32(val), -7);
+}
@@ -27,6 +27,9 @@
 
 #include "upb/io/chunked_output_stream.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 // Must be last.
 #include "upb/port/def.inc"
 
@@ -92,3 +95,227 @@ upb_ZeroCopyOutputStream* upb_ChunkedOutputStream_New(void* data, size_t size,
 
   return (upb_ZeroCopyOutputStream*)c;
 }
+
+/* Chunk pool *****************************************************************/
+
+#define UPB_CHUNK_POOL_DEFAULT_CHUNK_SIZE (8 << 10)
+#define UPB_CHUNK_POOL_DEFAULT_MAX_CHUNKS 32
+
+typedef struct upb_PoolChunk {
+  struct upb_PoolChunk* next;
+} upb_PoolChunk;
+
+// The chunk's usable bytes follow the header.
+#define upb_PoolChunk_Data(chunk) ((char*)((chunk) + 1))
+
+struct upb_ChunkPool {
+  upb_PoolChunk* free_chunks;
+  size_t chunk_size;  // Usable bytes per chunk, header excluded.
+  size_t free_count;
+  size_t max_free;
+};
+
+upb_ChunkPool* upb_ChunkPool_New(size_t chunk_size, size_t max_chunks) {
+  upb_ChunkPool* pool = malloc(sizeof(*pool));
+  if (!pool) return NULL;
+  pool->free_chunks = NULL;
+  pool->chunk_size =
+      chunk_size ? chunk_size : UPB_CHUNK_POOL_DEFAULT_CHUNK_SIZE;
+  pool->free_count = 0;
+  pool->max_free = max_chunks ? max_chunks : UPB_CHUNK_POOL_DEFAULT_MAX_CHUNKS;
+  return pool;
+}
+
+static void upb_ChunkPool_FreeList(upb_PoolChunk* chunk) {
+  while (chunk) {
+    upb_PoolChunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+}
+
+void upb_ChunkPool_Free(upb_ChunkPool* pool) {
+  upb_ChunkPool_FreeList(pool->free_chunks);
+  free(pool);
+}
+
+static upb_PoolChunk* upb_ChunkPool_Take(upb_ChunkPool* pool) {
+  if (pool->free_chunks) {
+    upb_PoolChunk* chunk = pool->free_chunks;
+    pool->free_chunks = chunk->next;
+    pool->free_count--;
+    return chunk;
+  }
+  return malloc(sizeof(upb_PoolChunk) + pool->chunk_size);
+}
+
+static void upb_ChunkPool_Put(upb_ChunkPool* pool, upb_PoolChunk* chunk) {
+  if (pool->free_count >= pool->max_free) {
+    free(chunk);
+    return;
+  }
+  chunk->next = pool->free_chunks;
+  pool->free_chunks = chunk;
+  pool->free_count++;
+}
+
+#ifdef UPB_THREAD_LOCAL
+
+static UPB_THREAD_LOCAL upb_ChunkPool upb_thread_chunk_pool = {NULL, 0, 0, 0};
+
+static upb_ChunkPool* upb_ChunkPool_ThreadLocal(void) {
+  upb_ChunkPool* pool = &upb_thread_chunk_pool;
+  if (pool->chunk_size == 0) {
+    pool->chunk_size = UPB_CHUNK_POOL_DEFAULT_CHUNK_SIZE;
+    pool->max_free = UPB_CHUNK_POOL_DEFAULT_MAX_CHUNKS;
+  }
+  return pool;
+}
+
+void upb_ChunkPool_FlushThreadLocal(void) {
+  upb_ChunkPool_FreeList(upb_thread_chunk_pool.free_chunks);
+  upb_thread_chunk_pool.free_chunks = NULL;
+  upb_thread_chunk_pool.free_count = 0;
+}
+
+#else /* !UPB_THREAD_LOCAL */
+
+// Without thread-local storage there is no built-in pool; pooled streams
+// created with a NULL pool get a private single-use pool below.
+static upb_ChunkPool* upb_ChunkPool_ThreadLocal(void) { return NULL; }
+
+void upb_ChunkPool_FlushThreadLocal(void) {}
+
+#endif /* UPB_THREAD_LOCAL */
+
+/* Pooled, growable output stream *********************************************/
+
+typedef struct {
+  upb_ZeroCopyOutputStream base;
+
+  upb_ChunkPool* pool;
+  upb_ChunkPool private_pool;  // Used when there is no thread-local pool.
+  upb_PoolChunk* head;         // Chunk chain in write order.
+  upb_PoolChunk* tail;
+  size_t limit;
+  size_t tail_used;   // Bytes written to the tail chunk.
+  size_t full_bytes;  // Bytes in every chunk before the tail.
+  size_t last_returned_size;
+} upb_PooledOutputStream;
+
+static void* upb_PooledOutputStream_Next(upb_ZeroCopyOutputStream* z,
+                                         size_t* count, upb_Status* status) {
+  upb_PooledOutputStream* p = (upb_PooledOutputStream*)z;
+
+  if (!p->tail || p->tail_used == p->pool->chunk_size) {
+    upb_PoolChunk* chunk = upb_ChunkPool_Take(p->pool);
+    if (!chunk) {
+      *count = 0;
+      upb_Status_SetErrorMessage(status, "out of memory");
+      return NULL;
+    }
+    chunk->next = NULL;
+    if (p->tail) {
+      p->tail->next = chunk;
+      p->full_bytes += p->tail_used;
+    } else {
+      p->head = chunk;
+    }
+    p->tail = chunk;
+    p->tail_used = 0;
+  }
+
+  char* out = upb_PoolChunk_Data(p->tail) + p->tail_used;
+  const size_t chunk = UPB_MIN(p->limit, p->pool->chunk_size - p->tail_used);
+  p->tail_used += chunk;
+  p->last_returned_size = chunk;
+  *count = chunk;
+  return out;
+}
+
+static void upb_PooledOutputStream_BackUp(upb_ZeroCopyOutputStream* z,
+                                          size_t count) {
+  upb_PooledOutputStream* p = (upb_PooledOutputStream*)z;
+
+  UPB_ASSERT(p->last_returned_size >= count);
+  p->tail_used -= count;
+  p->last_returned_size -= count;
+}
+
+static size_t upb_PooledOutputStream_ByteCount(
+    const upb_ZeroCopyOutputStream* z) {
+  const upb_PooledOutputStream* p = (const upb_PooledOutputStream*)z;
+
+  return p->full_bytes + p->tail_used;
+}
+
+static const _upb_ZeroCopyOutputStream_VTable upb_PooledOutputStream_vtable = {
+    upb_PooledOutputStream_Next,
+    upb_PooledOutputStream_BackUp,
+    upb_PooledOutputStream_ByteCount,
+};
+
+// Arena cleanup: return the stream's chunks to its pool (and free a private
+// pool's cache, which otherwise has no owner to flush it).
+static void upb_PooledOutputStream_ReturnChunks(void* ud) {
+  upb_PooledOutputStream* p = ud;
+  upb_PoolChunk* chunk = p->head;
+  while (chunk) {
+    upb_PoolChunk* next = chunk->next;
+    upb_ChunkPool_Put(p->pool, chunk);
+    chunk = next;
+  }
+  if (p->pool == &p->private_pool) {
+    upb_ChunkPool_FreeList(p->private_pool.free_chunks);
+  }
+}
+
+upb_ZeroCopyOutputStream* upb_ChunkedOutputStream_NewPooled(upb_ChunkPool* pool,
+                                                            size_t limit,
+                                                            upb_Arena* arena) {
+  upb_PooledOutputStream* p = upb_Arena_Malloc(arena, sizeof(*p));
+  if (!p || !limit) return NULL;
+
+  if (!pool) pool = upb_ChunkPool_ThreadLocal();
+  if (!pool) {
+    p->private_pool.free_chunks = NULL;
+    p->private_pool.chunk_size = UPB_CHUNK_POOL_DEFAULT_CHUNK_SIZE;
+    p->private_pool.free_count = 0;
+    p->private_pool.max_free = UPB_CHUNK_POOL_DEFAULT_MAX_CHUNKS;
+    pool = &p->private_pool;
+  }
+
+  p->base.vtable = &upb_PooledOutputStream_vtable;
+  p->pool = pool;
+  p->head = NULL;
+  p->tail = NULL;
+  p->limit = limit;
+  p->tail_used = 0;
+  p->full_bytes = 0;
+  p->last_returned_size = 0;
+
+  if (!upb_Arena_AddCleanup(arena, p, upb_PooledOutputStream_ReturnChunks)) {
+    return NULL;
+  }
+  return (upb_ZeroCopyOutputStream*)p;
+}
+
+size_t upb_ChunkedOutputStream_Gather(const upb_ZeroCopyOutputStream* z,
+                                      void* buf, size_t capacity) {
+  UPB_ASSERT(z->vtable == &upb_PooledOutputStream_vtable);
+  const upb_PooledOutputStream* p = (const upb_PooledOutputStream*)z;
+
+  char* out = buf;
+  size_t remaining = capacity;
+  for (const upb_PoolChunk* chunk = p->head; chunk; chunk = chunk->next) {
+    const size_t len =
+        chunk == p->tail ? p->tail_used : p->pool->chunk_size;
+    const size_t copy = UPB_MIN(len, remaining);
+    if (copy) {
+      memcpy(out, upb_PoolChunk_Data(chunk), copy);
+      out += copy;
+      remaining -= copy;
+    }
+  }
+  return p->full_bytes + p->tail_used;
+}
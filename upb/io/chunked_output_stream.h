@@ -44,6 +44,44 @@ upb_ZeroCopyOutputStream* upb_ChunkedOutputStream_New(void* data, size_t size,
                                                       size_t limit,
                                                       upb_Arena* arena);
 
+// A pool of fixed-size chunks shared across pooled output streams (below).
+// Freed chunks stay cached (up to a bound) and are handed back out warm, so
+// per-request streams in steady state fault no fresh memory.  A pool is not
+// thread-safe; use one pool per thread, or pass NULL to the constructor to
+// use a built-in thread-local pool.
+typedef struct upb_ChunkPool upb_ChunkPool;
+
+// Creates a pool handing out chunks with `chunk_size` usable bytes, caching
+// at most `max_chunks` free chunks; pass 0 for either to get the defaults
+// (8 KiB chunks, 32 cached).  Returns NULL if memory allocation failed.
+upb_ChunkPool* upb_ChunkPool_New(size_t chunk_size, size_t max_chunks);
+
+// Frees the pool and its cached chunks.  All streams drawing from the pool
+// must have returned their chunks first (i.e. their arenas must be gone).
+void upb_ChunkPool_Free(upb_ChunkPool* pool);
+
+// Releases the chunks cached by the calling thread's built-in pool, e.g.
+// before thread exit.  A no-op when thread-local storage is unavailable.
+void upb_ChunkPool_FlushThreadLocal(void);
+
+// A growable ZeroCopyOutputStream that chains chunks drawn from `pool`
+// (NULL = the calling thread's built-in pool) instead of wrapping a
+// preallocated flat buffer, so one oversized message costs extra chunks
+// rather than a worst-case upfront buffer.  Next() returns at most `limit`
+// bytes per call, clamped to the pool's chunk size.  The chunks are returned
+// to the pool automatically when `arena` is freed; the stream must not be
+// used after that.  Returns NULL if memory allocation failed.
+upb_ZeroCopyOutputStream* upb_ChunkedOutputStream_NewPooled(upb_ChunkPool* pool,
+                                                            size_t limit,
+                                                            upb_Arena* arena);
+
+// Copies the bytes written so far to a stream created with
+// upb_ChunkedOutputStream_NewPooled() into `buf` (at most `capacity` bytes)
+// and returns the total number of bytes written, which may exceed `capacity`;
+// call with capacity 0 to size a buffer first.
+size_t upb_ChunkedOutputStream_Gather(const upb_ZeroCopyOutputStream* z,
+                                      void* buf, size_t capacity);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
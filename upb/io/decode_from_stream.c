@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/io/decode_from_stream.h"
+
+#include "upb/wire/decode_stream.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+upb_DecodeStatus upb_Decode_FromStream(upb_ZeroCopyInputStream* input,
+                                       upb_Message* msg, const upb_MiniTable* l,
+                                       const upb_ExtensionRegistry* extreg,
+                                       int options, upb_Arena* arena,
+                                       upb_Status* status) {
+  upb_DecodeStream* s = upb_DecodeStream_New(msg, l, extreg, options, arena);
+  if (!s) return kUpb_DecodeStatus_OutOfMemory;
+
+  for (;;) {
+    size_t count;
+    upb_Status stream_status;
+    upb_Status_Clear(&stream_status);
+    const void* chunk =
+        upb_ZeroCopyInputStream_Next(input, &count, &stream_status);
+    if (!chunk) {
+      if (!upb_Status_IsOk(&stream_status)) {
+        // Read error; the stream's message explains what went wrong.
+        if (status) {
+          upb_Status_SetErrorMessage(
+              status, upb_Status_ErrorMessage(&stream_status));
+        }
+        return kUpb_DecodeStatus_Malformed;
+      }
+      break;  // EOF.
+    }
+    upb_DecodeStatus result = upb_DecodeStream_PushBuffer(s, chunk, count);
+    if (result != kUpb_DecodeStatus_Ok) return result;
+  }
+
+  return upb_DecodeStream_Finish(s);
+}
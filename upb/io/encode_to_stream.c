@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/io/encode_to_stream.h"
+
+#include <string.h>
+
+// Must be last.
+#include "upb/port/def.inc"
+
+static upb_EncodeStatus upb_Encode_WriteToStream(
+    const char* src, size_t remaining, upb_ZeroCopyOutputStream* output,
+    upb_Status* status) {
+  while (remaining > 0) {
+    size_t count;
+    upb_Status stream_status;
+    upb_Status_Clear(&stream_status);
+    void* dst = upb_ZeroCopyOutputStream_Next(output, &count, &stream_status);
+    if (!dst) {
+      if (status) {
+        if (!upb_Status_IsOk(&stream_status)) {
+          upb_Status_SetErrorMessage(status,
+                                     upb_Status_ErrorMessage(&stream_status));
+        } else {
+          upb_Status_SetErrorMessage(status,
+                                     "output stream ended before the message "
+                                     "was fully written");
+        }
+      }
+      return kUpb_EncodeStatus_StreamError;
+    }
+    const size_t n = UPB_MIN(count, remaining);
+    memcpy(dst, src, n);
+    upb_ZeroCopyOutputStream_BackUp(output, count - n);
+    src += n;
+    remaining -= n;
+  }
+  return kUpb_EncodeStatus_Ok;
+}
+
+upb_EncodeStatus upb_Encode_ToStream(const upb_Message* msg,
+                                     const upb_MiniTable* l, int options,
+                                     upb_ZeroCopyOutputStream* output,
+                                     upb_Status* status) {
+  upb_Arena* arena = upb_Arena_New();
+  if (!arena) return kUpb_EncodeStatus_OutOfMemory;
+
+  char* buf;
+  size_t size;
+  upb_EncodeStatus result = upb_Encode(msg, l, options, arena, &buf, &size);
+  if (result == kUpb_EncodeStatus_Ok) {
+    result = upb_Encode_WriteToStream(buf, size, output, status);
+  }
+
+  upb_Arena_Free(arena);
+  return result;
+}
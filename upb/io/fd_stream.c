@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2009-2022, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/io/fd_stream.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// Must be last.
+#include "upb/port/def.inc"
+
+// Default block size when the caller passes 0.
+#define kUpb_FdStream_DefaultBlockSize (64 * 1024)
+
+// How many blocks the output stream buffers before flushing them with a
+// single writev() call.
+#define kUpb_FdOutputStream_MaxPending 8
+
+#ifndef _WIN32
+
+/* upb_FdInputStream ********************************************************/
+
+typedef struct {
+  upb_ZeroCopyInputStream base;
+
+  int fd;
+  char* block;
+  size_t block_size;
+  size_t filled;    // Bytes of |block| holding data.
+  size_t pos;       // Read position within |block|.
+  size_t position;  // Total bytes consumed, for ByteCount().
+  size_t last_returned_size;
+  uint64_t offset;  // File offset of the end of |block|, for readahead.
+  bool eof;
+} upb_FdInputStream;
+
+static const void* upb_FdInputStream_Next(upb_ZeroCopyInputStream* z,
+                                          size_t* count, upb_Status* status) {
+  upb_FdInputStream* s = (upb_FdInputStream*)z;
+  *count = 0;
+
+  // First hand back anything that was backed up.
+  if (s->pos < s->filled) {
+    const size_t chunk = s->filled - s->pos;
+    const char* out = s->block + s->pos;
+    s->pos = s->filled;
+    s->position += chunk;
+    s->last_returned_size = chunk;
+    *count = chunk;
+    return out;
+  }
+
+  if (s->eof) return NULL;
+
+  ssize_t n;
+  do {
+    n = read(s->fd, s->block, s->block_size);
+  } while (n < 0 && errno == EINTR);
+
+  if (n < 0) {
+    upb_Status_SetErrorFormat(status, "read failed: %s", strerror(errno));
+    return NULL;
+  }
+  if (n == 0) {
+    s->eof = true;
+    return NULL;
+  }
+
+  s->offset += (uint64_t)n;
+#ifdef POSIX_FADV_WILLNEED
+  // Ask the kernel to start reading the next block while the caller works
+  // on this one.  Advisory only; fails harmlessly on pipes and sockets.
+  (void)posix_fadvise(s->fd, (off_t)s->offset, (off_t)s->block_size,
+                      POSIX_FADV_WILLNEED);
+#endif
+
+  s->filled = (size_t)n;
+  s->pos = (size_t)n;
+  s->position += (size_t)n;
+  s->last_returned_size = (size_t)n;
+  *count = (size_t)n;
+  return s->block;
+}
+
+static void upb_FdInputStream_BackUp(upb_ZeroCopyInputStream* z, size_t count) {
+  upb_FdInputStream* s = (upb_FdInputStream*)z;
+
+  UPB_ASSERT(s->last_returned_size >= count);
+  s->pos -= count;
+  s->position -= count;
+  s->last_returned_size -= count;
+}
+
+static bool upb_FdInputStream_Skip(upb_ZeroCopyInputStream* z, size_t count) {
+  upb_FdInputStream* s = (upb_FdInputStream*)z;
+
+  s->last_returned_size = 0;  // Don't let caller back up.
+
+  // Consume buffered data first.
+  const size_t buffered = UPB_MIN(count, s->filled - s->pos);
+  s->pos += buffered;
+  s->position += buffered;
+  count -= buffered;
+
+  // Read and discard the rest.  (lseek() would be faster on regular files
+  // but cannot detect a skip past EOF, which this function must report.)
+  while (count > 0) {
+    if (s->eof) return false;
+    size_t chunk;
+    upb_Status status;
+    upb_Status_Clear(&status);
+    if (!upb_FdInputStream_Next(z, &chunk, &status)) return false;
+    if (chunk > count) {
+      upb_FdInputStream_BackUp(z, chunk - count);
+      return true;
+    }
+    count -= chunk;
+  }
+  return true;
+}
+
+static size_t upb_FdInputStream_ByteCount(const upb_ZeroCopyInputStream* z) {
+  const upb_FdInputStream* s = (const upb_FdInputStream*)z;
+
+  return s->position;
+}
+
+static const _upb_ZeroCopyInputStream_VTable upb_FdInputStream_vtable = {
+    upb_FdInputStream_Next,
+    upb_FdInputStream_BackUp,
+    upb_FdInputStream_Skip,
+    upb_FdInputStream_ByteCount,
+};
+
+upb_ZeroCopyInputStream* upb_FdInputStream_New(int fd, size_t block_size,
+                                               upb_Arena* arena) {
+  if (fd < 0) return NULL;
+  if (!block_size) block_size = kUpb_FdStream_DefaultBlockSize;
+
+  upb_FdInputStream* s = upb_Arena_Malloc(arena, sizeof(*s));
+  if (!s) return NULL;
+  s->block = upb_Arena_Malloc(arena, block_size);
+  if (!s->block) return NULL;
+
+  s->base.vtable = &upb_FdInputStream_vtable;
+  s->fd = fd;
+  s->block_size = block_size;
+  s->filled = 0;
+  s->pos = 0;
+  s->position = 0;
+  s->last_returned_size = 0;
+  s->offset = 0;
+  s->eof = false;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  return (upb_ZeroCopyInputStream*)s;
+}
+
+/* upb_FdOutputStream *******************************************************/
+
+typedef struct {
+  upb_ZeroCopyOutputStream base;
+
+  int fd;
+  size_t block_size;
+  char* blocks[kUpb_FdOutputStream_MaxPending];
+  size_t sizes[kUpb_FdOutputStream_MaxPending];
+  size_t used;           // Number of pending blocks.
+  size_t pending_bytes;  // Total bytes across pending blocks.
+  size_t flushed_bytes;
+  upb_Arena* arena;  // For lazily allocating blocks.
+  int write_errno;   // 0, or the errno of the first failed write.
+} upb_FdOutputStream;
+
+static bool upb_FdOutputStream_FlushInternal(upb_FdOutputStream* s) {
+  if (s->write_errno) return false;
+  if (s->used == 0) return true;
+
+  struct iovec iov[kUpb_FdOutputStream_MaxPending];
+  size_t niov = 0;
+  size_t total = 0;
+  for (size_t i = 0; i < s->used; i++) {
+    if (s->sizes[i] == 0) continue;
+    iov[niov].iov_base = s->blocks[i];
+    iov[niov].iov_len = s->sizes[i];
+    total += s->sizes[i];
+    niov++;
+  }
+
+  size_t written = 0;
+  size_t first = 0;
+  while (written < total) {
+    ssize_t n;
+    do {
+      n = writev(s->fd, iov + first, (int)(niov - first));
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+      s->write_errno = errno;
+      return false;
+    }
+    written += (size_t)n;
+    // Step past fully written iovecs, and trim a partially written one.
+    while (first < niov && (size_t)n >= iov[first].iov_len) {
+      n -= (ssize_t)iov[first].iov_len;
+      first++;
+    }
+    if (n > 0) {
+      iov[first].iov_base = (char*)iov[first].iov_base + n;
+      iov[first].iov_len -= (size_t)n;
+    }
+  }
+
+  s->flushed_bytes += s->pending_bytes;
+  s->pending_bytes = 0;
+  s->used = 0;
+  return true;
+}
+
+static void* upb_FdOutputStream_Next(upb_ZeroCopyOutputStream* z, size_t* count,
+                                     upb_Status* status) {
+  upb_FdOutputStream* s = (upb_FdOutputStream*)z;
+  *count = 0;
+
+  if (s->used == kUpb_FdOutputStream_MaxPending &&
+      !upb_FdOutputStream_FlushInternal(s)) {
+    upb_Status_SetErrorFormat(status, "write failed: %s",
+                              strerror(s->write_errno));
+    return NULL;
+  }
+
+  if (!s->blocks[s->used]) {
+    s->blocks[s->used] = upb_Arena_Malloc(s->arena, s->block_size);
+    if (!s->blocks[s->used]) {
+      upb_Status_SetErrorMessage(status, "out of memory");
+      return NULL;
+    }
+  }
+
+  s->sizes[s->used] = s->block_size;
+  s->pending_bytes += s->block_size;
+  *count = s->block_size;
+  return s->blocks[s->used++];
+}
+
+static void upb_FdOutputStream_BackUp(upb_ZeroCopyOutputStream* z,
+                                      size_t count) {
+  upb_FdOutputStream* s = (upb_FdOutputStream*)z;
+
+  UPB_ASSERT(s->used > 0);
+  UPB_ASSERT(s->sizes[s->used - 1] >= count);
+  s->sizes[s->used - 1] -= count;
+  s->pending_bytes -= count;
+
+  // A BackUp() marks a flush point (see zero_copy_output_stream.h); write
+  // everything accumulated so far in one writev().  Errors are sticky and
+  // are reported by the next Next() or Flush() call.
+  upb_FdOutputStream_FlushInternal(s);
+}
+
+static size_t upb_FdOutputStream_ByteCount(const upb_ZeroCopyOutputStream* z) {
+  const upb_FdOutputStream* s = (const upb_FdOutputStream*)z;
+
+  return s->flushed_bytes + s->pending_bytes;
+}
+
+static const _upb_ZeroCopyOutputStream_VTable upb_FdOutputStream_vtable = {
+    upb_FdOutputStream_Next,
+    upb_FdOutputStream_BackUp,
+    upb_FdOutputStream_ByteCount,
+};
+
+upb_ZeroCopyOutputStream* upb_FdOutputStream_New(int fd, size_t block_size,
+                                                 upb_Arena* arena) {
+  if (fd < 0) return NULL;
+  if (!block_size) block_size = kUpb_FdStream_DefaultBlockSize;
+
+  upb_FdOutputStream* s = upb_Arena_Malloc(arena, sizeof(*s));
+  if (!s) return NULL;
+
+  memset(s, 0, sizeof(*s));
+  s->base.vtable = &upb_FdOutputStream_vtable;
+  s->fd = fd;
+  s->block_size = block_size;
+  s->arena = arena;
+
+  return (upb_ZeroCopyOutputStream*)s;
+}
+
+bool upb_FdOutputStream_Flush(upb_ZeroCopyOutputStream* z, upb_Status* status) {
+  upb_FdOutputStream* s = (upb_FdOutputStream*)z;
+
+  if (!upb_FdOutputStream_FlushInternal(s)) {
+    if (status) {
+      upb_Status_SetErrorFormat(status, "write failed: %s",
+                                strerror(s->write_errno));
+    }
+    return false;
+  }
+  return true;
+}
+
+#else /* _WIN32 */
+
+upb_ZeroCopyInputStream* upb_FdInputStream_New(int fd, size_t block_size,
+                                               upb_Arena* arena) {
+  return NULL;  // Not supported on this platform.
+}
+
+upb_ZeroCopyOutputStream* upb_FdOutputStream_New(int fd, size_t block_size,
+                                                 upb_Arena* arena) {
+  return NULL;  // Not supported on this platform.
+}
+
+bool upb_FdOutputStream_Flush(upb_ZeroCopyOutputStream* z, upb_Status* status) {
+  return false;
+}
+
+#endif /* !_WIN32 */
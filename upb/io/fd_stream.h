@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2009-2022, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// ZeroCopyInputStream/ZeroCopyOutputStream implementations over a POSIX file
+// descriptor, so callers don't each need their own buffering layer between
+// the wire codecs and the OS.
+//
+// The streams do not own the fd: the caller opens and closes it.  On
+// platforms without POSIX I/O (Windows) the constructors return NULL.
+
+#ifndef UPB_IO_FD_STREAM_H_
+#define UPB_IO_FD_STREAM_H_
+
+#include "upb/io/zero_copy_input_stream.h"
+#include "upb/io/zero_copy_output_stream.h"
+#include "upb/mem/arena.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A ZeroCopyInputStream which reads from |fd| in blocks of |block_size|
+// bytes (0 selects a default).  The kernel is advised of the sequential
+// access pattern and asked to read the next block ahead while the caller
+// consumes the current one, so for regular files the data is usually
+// already in the page cache by the time Next() asks for it.
+upb_ZeroCopyInputStream* upb_FdInputStream_New(int fd, size_t block_size,
+                                               upb_Arena* arena);
+
+// A ZeroCopyOutputStream which buffers up to a handful of |block_size|-byte
+// blocks (0 selects a default) and flushes them to |fd| with a single
+// writev() call.  Per the ZeroCopyOutputStream contract, call BackUp()
+// (possibly with a count of 0) after the final Next() to flush; write
+// errors surface on the following Next() or upb_FdOutputStream_Flush().
+upb_ZeroCopyOutputStream* upb_FdOutputStream_New(int fd, size_t block_size,
+                                                 upb_Arena* arena);
+
+// Writes out any buffered data.  Returns false if this or any earlier write
+// failed; |status| (which may be NULL) receives the details.
+bool upb_FdOutputStream_Flush(upb_ZeroCopyOutputStream* z, upb_Status* status);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_IO_FD_STREAM_H_ */
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2009-2022, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/io/limited_input_stream.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+// The limit is kept as an absolute stream position so that nested limits
+// are just a min() at push time and a plain restore at pop time.
+#define kUpb_LimitedInputStream_NoLimit ((size_t)-1)
+
+typedef struct {
+  upb_ZeroCopyInputStream base;
+
+  upb_ZeroCopyInputStream* input;
+  size_t position;  // Bytes consumed through this wrapper.
+  size_t limit;     // Absolute position cap, or kUpb_..._NoLimit.
+  size_t last_returned_size;
+} upb_LimitedInputStream;
+
+static const void* upb_LimitedInputStream_Next(upb_ZeroCopyInputStream* z,
+                                               size_t* count,
+                                               upb_Status* status) {
+  upb_LimitedInputStream* s = (upb_LimitedInputStream*)z;
+  *count = 0;
+  s->last_returned_size = 0;
+
+  if (s->position >= s->limit) return NULL;  // At the limit: report EOF.
+
+  const void* out = upb_ZeroCopyInputStream_Next(s->input, count, status);
+  if (!out) return NULL;
+
+  const size_t available = s->limit - s->position;
+  if (*count > available) {
+    upb_ZeroCopyInputStream_BackUp(s->input, *count - available);
+    *count = available;
+  }
+
+  s->position += *count;
+  s->last_returned_size = *count;
+  return out;
+}
+
+static void upb_LimitedInputStream_BackUp(upb_ZeroCopyInputStream* z,
+                                          size_t count) {
+  upb_LimitedInputStream* s = (upb_LimitedInputStream*)z;
+
+  UPB_ASSERT(s->last_returned_size >= count);
+  upb_ZeroCopyInputStream_BackUp(s->input, count);
+  s->position -= count;
+  s->last_returned_size -= count;
+}
+
+static bool upb_LimitedInputStream_Skip(upb_ZeroCopyInputStream* z,
+                                        size_t count) {
+  upb_LimitedInputStream* s = (upb_LimitedInputStream*)z;
+
+  s->last_returned_size = 0;  // Don't let caller back up.
+
+  const size_t available = s->limit - s->position;
+  if (count > available) {
+    // Stop at the limit, like skipping to EOF.
+    if (available && upb_ZeroCopyInputStream_Skip(s->input, available)) {
+      s->position += available;
+    }
+    return false;
+  }
+
+  if (!upb_ZeroCopyInputStream_Skip(s->input, count)) return false;
+  s->position += count;
+  return true;
+}
+
+static size_t upb_LimitedInputStream_ByteCount(
+    const upb_ZeroCopyInputStream* z) {
+  const upb_LimitedInputStream* s = (const upb_LimitedInputStream*)z;
+
+  return s->position;
+}
+
+static const _upb_ZeroCopyInputStream_VTable upb_LimitedInputStream_vtable = {
+    upb_LimitedInputStream_Next,
+    upb_LimitedInputStream_BackUp,
+    upb_LimitedInputStream_Skip,
+    upb_LimitedInputStream_ByteCount,
+};
+
+upb_ZeroCopyInputStream* upb_LimitedInputStream_New(
+    upb_ZeroCopyInputStream* input, upb_Arena* arena) {
+  upb_LimitedInputStream* s = upb_Arena_Malloc(arena, sizeof(*s));
+  if (!s || !input) return NULL;
+
+  s->base.vtable = &upb_LimitedInputStream_vtable;
+  s->input = input;
+  s->position = 0;
+  s->limit = kUpb_LimitedInputStream_NoLimit;
+  s->last_returned_size = 0;
+
+  return (upb_ZeroCopyInputStream*)s;
+}
+
+size_t upb_LimitedInputStream_PushLimit(upb_ZeroCopyInputStream* z,
+                                        size_t byte_limit) {
+  upb_LimitedInputStream* s = (upb_LimitedInputStream*)z;
+  UPB_ASSERT(s->base.vtable == &upb_LimitedInputStream_vtable);
+
+  const size_t old_limit = s->limit;
+  const size_t new_limit = byte_limit > s->limit - s->position
+                               ? s->limit  // Truncate to the enclosing limit.
+                               : s->position + byte_limit;
+  s->limit = new_limit;
+  return old_limit;
+}
+
+void upb_LimitedInputStream_PopLimit(upb_ZeroCopyInputStream* z, size_t token) {
+  upb_LimitedInputStream* s = (upb_LimitedInputStream*)z;
+  UPB_ASSERT(s->base.vtable == &upb_LimitedInputStream_vtable);
+  UPB_ASSERT(token >= s->limit);
+
+  s->limit = token;
+}
+
+size_t upb_LimitedInputStream_BytesUntilLimit(
+    const upb_ZeroCopyInputStream* z) {
+  const upb_LimitedInputStream* s = (const upb_LimitedInputStream*)z;
+  UPB_ASSERT(s->base.vtable == &upb_LimitedInputStream_vtable);
+
+  if (s->limit == kUpb_LimitedInputStream_NoLimit) return (size_t)-1;
+  return s->limit - s->position;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2009-2022, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UPB_IO_LIMITED_INPUT_STREAM_H_
+#define UPB_IO_LIMITED_INPUT_STREAM_H_
+
+#include "upb/io/zero_copy_input_stream.h"
+#include "upb/mem/arena.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A ZeroCopyInputStream which wraps another stream and enforces pushable
+// byte limits, implementing the bounds check once in the stream layer
+// instead of in every framed-record reader.  While a limit is in effect
+// the wrapper reports EOF at the limit; the consumer (e.g. a stream-fed
+// decoder) needs no extra length checks of its own.  Limits nest: pushing
+// a limit larger than the enclosing one is truncated to it.
+//
+// Typical framing loop:
+//
+//   upb_ZeroCopyInputStream* z = upb_LimitedInputStream_New(input, arena);
+//   for each record {
+//     ... read the length prefix from z ...
+//     size_t token = upb_LimitedInputStream_PushLimit(z, record_len);
+//     ... decode one record from z; it sees EOF after record_len bytes ...
+//     upb_LimitedInputStream_PopLimit(z, token);
+//   }
+upb_ZeroCopyInputStream* upb_LimitedInputStream_New(
+    upb_ZeroCopyInputStream* input, upb_Arena* arena);
+
+// Restricts the stream to |byte_limit| further bytes (or to the enclosing
+// limit, whichever ends first).  Returns a token to pass to PopLimit().
+size_t upb_LimitedInputStream_PushLimit(upb_ZeroCopyInputStream* z,
+                                        size_t byte_limit);
+
+// Removes the most recently pushed limit, restoring the one captured in
+// |token|.  Limits must be popped in LIFO order.
+void upb_LimitedInputStream_PopLimit(upb_ZeroCopyInputStream* z, size_t token);
+
+// Bytes remaining until the current limit, or (size_t)-1 if no limit is in
+// effect.  Returns 0 exactly when the stream is at the limit; a consumer
+// that stopped early can detect a truncated record this way.
+size_t upb_LimitedInputStream_BytesUntilLimit(const upb_ZeroCopyInputStream* z);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_IO_LIMITED_INPUT_STREAM_H_ */
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2009-2022, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/io/mmap_input_stream.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Must be last.
+#include "upb/port/def.inc"
+
+// Default bytes returned per Next() call when the caller passes limit == 0.
+// One huge chunk would also be correct, but bounded chunks let pull-style
+// consumers (e.g. the tokenizer) start working before the whole file has
+// been faulted in.
+#define kUpb_MmapInputStream_DefaultLimit (1024 * 1024)
+
+typedef struct {
+  upb_ZeroCopyInputStream base;
+
+  const char* data;  // The mapping, or NULL for an empty file.
+  size_t size;
+  size_t limit;
+  size_t position;
+  size_t last_returned_size;
+} upb_MmapInputStream;
+
+static const void* upb_MmapInputStream_Next(upb_ZeroCopyInputStream* z,
+                                            size_t* count, upb_Status* status) {
+  upb_MmapInputStream* m = (upb_MmapInputStream*)z;
+  UPB_ASSERT(m->position <= m->size);
+
+  const char* out = m->data + m->position;
+
+  const size_t chunk = UPB_MIN(m->limit, m->size - m->position);
+  m->position += chunk;
+  m->last_returned_size = chunk;
+  *count = chunk;
+
+  return chunk ? out : NULL;
+}
+
+static void upb_MmapInputStream_BackUp(upb_ZeroCopyInputStream* z,
+                                       size_t count) {
+  upb_MmapInputStream* m = (upb_MmapInputStream*)z;
+
+  UPB_ASSERT(m->last_returned_size >= count);
+  m->position -= count;
+  m->last_returned_size -= count;
+}
+
+static bool upb_MmapInputStream_Skip(upb_ZeroCopyInputStream* z, size_t count) {
+  upb_MmapInputStream* m = (upb_MmapInputStream*)z;
+
+  m->last_returned_size = 0;  // Don't let caller back up.
+  if (count > m->size - m->position) {
+    m->position = m->size;
+    return false;
+  }
+
+  m->position += count;
+  return true;
+}
+
+static size_t upb_MmapInputStream_ByteCount(const upb_ZeroCopyInputStream* z) {
+  const upb_MmapInputStream* m = (const upb_MmapInputStream*)z;
+
+  return m->position;
+}
+
+static const _upb_ZeroCopyInputStream_VTable upb_MmapInputStream_vtable = {
+    upb_MmapInputStream_Next,
+    upb_MmapInputStream_BackUp,
+    upb_MmapInputStream_Skip,
+    upb_MmapInputStream_ByteCount,
+};
+
+upb_ZeroCopyInputStream* upb_MmapInputStream_New(const char* filename,
+                                                 size_t limit,
+                                                 upb_Arena* arena) {
+#ifdef _WIN32
+  return NULL;  // Not supported on this platform.
+#else
+  const int fd = open(filename, O_RDONLY);
+  if (fd < 0) return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return NULL;
+  }
+
+  const size_t size = (size_t)st.st_size;
+  const char* data = NULL;
+  if (size != 0) {
+    void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      close(fd);
+      return NULL;
+    }
+    // Advisory only; failure doesn't affect correctness.
+    (void)madvise(map, size, MADV_SEQUENTIAL);
+    data = map;
+  }
+
+  // The fd is not needed once the mapping exists.
+  close(fd);
+
+  upb_MmapInputStream* m = upb_Arena_Malloc(arena, sizeof(*m));
+  if (!m) {
+    if (data) munmap((void*)data, size);
+    return NULL;
+  }
+
+  m->base.vtable = &upb_MmapInputStream_vtable;
+  m->data = data;
+  m->size = size;
+  m->limit = limit ? limit : kUpb_MmapInputStream_DefaultLimit;
+  m->position = 0;
+  m->last_returned_size = 0;
+
+  return (upb_ZeroCopyInputStream*)m;
+#endif
+}
+
+void upb_MmapInputStream_Fini(upb_ZeroCopyInputStream* z) {
+#ifndef _WIN32
+  upb_MmapInputStream* m = (upb_MmapInputStream*)z;
+  if (m->data) {
+    munmap((void*)m->data, m->size);
+    m->data = NULL;
+    m->size = 0;
+  }
+#endif
+}
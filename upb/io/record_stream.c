@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/io/record_stream.h"
+
+#include <string.h>
+
+// Must be last.
+#include "upb/port/def.inc"
+
+// Length prefixes above this are treated as corruption rather than letting a
+// flipped bit ask the reader to buffer gigabytes. 2GB mirrors the serialized
+// message size limit used across protobuf implementations.
+#define kUpb_RecordStream_MaxRecordSize 0x7fffffff
+
+/* upb_RecordReader *********************************************************/
+
+struct upb_RecordReader {
+  upb_ZeroCopyInputStream* input;
+  // Unconsumed portion of the current stream chunk.
+  const char* ptr;
+  const char* end;
+  // Scratch for stitching records that span chunk boundaries.
+  char* scratch;
+  size_t scratch_size;
+  upb_Arena* arena;
+  bool eof;
+};
+
+upb_RecordReader* upb_RecordReader_New(upb_ZeroCopyInputStream* input,
+                                       upb_Arena* arena) {
+  upb_RecordReader* r = upb_Arena_Malloc(arena, sizeof(*r));
+  if (!r) return NULL;
+  r->input = input;
+  r->ptr = NULL;
+  r->end = NULL;
+  r->scratch = NULL;
+  r->scratch_size = 0;
+  r->arena = arena;
+  r->eof = false;
+  return r;
+}
+
+// Pulls the next non-empty chunk from the stream. Returns false at EOF
+// (leaving |status| untouched) or on a stream error (with |status| set by
+// the stream).
+static bool upb_RecordReader_Refill(upb_RecordReader* r, upb_Status* status) {
+  if (r->eof) return false;
+  size_t count;
+  do {
+    const void* data = upb_ZeroCopyInputStream_Next(r->input, &count, status);
+    if (!data) {
+      r->eof = true;
+      return false;
+    }
+    r->ptr = data;
+    r->end = r->ptr + count;
+  } while (count == 0);
+  return true;
+}
+
+static bool upb_RecordReader_Corrupt(upb_Status* status, const char* msg) {
+  if (status) upb_Status_SetErrorMessage(status, msg);
+  return false;
+}
+
+bool upb_RecordReader_Next(upb_RecordReader* r, const char** data,
+                           size_t* size, upb_Status* status) {
+  // Read the length prefix a byte at a time; it may straddle chunks.
+  uint64_t len = 0;
+  int shift = 0;
+  for (;;) {
+    if (r->ptr == r->end) {
+      if (!upb_RecordReader_Refill(r, status)) {
+        if (!r->eof || shift == 0) return false;  // Error or clean EOF.
+        return upb_RecordReader_Corrupt(status,
+                                        "stream ended inside a record length");
+      }
+    }
+    uint8_t byte = (uint8_t)*r->ptr++;
+    len |= (uint64_t)(byte & 0x7f) << shift;
+    shift += 7;
+    if (!(byte & 0x80)) break;
+    if (shift >= 70) {
+      return upb_RecordReader_Corrupt(status, "record length varint too long");
+    }
+  }
+  if (len > kUpb_RecordStream_MaxRecordSize) {
+    return upb_RecordReader_Corrupt(status, "record length too large");
+  }
+
+  // Fast path: the whole payload is in the current chunk; alias it.
+  if ((size_t)(r->end - r->ptr) >= len) {
+    *data = r->ptr;
+    *size = (size_t)len;
+    r->ptr += len;
+    return true;
+  }
+
+  // Slow path: stitch the payload together in scratch space.
+  if (r->scratch_size < len) {
+    char* grown = upb_Arena_Realloc(r->arena, r->scratch, r->scratch_size,
+                                    (size_t)len);
+    if (!grown) {
+      return upb_RecordReader_Corrupt(status, "out of memory");
+    }
+    r->scratch = grown;
+    r->scratch_size = (size_t)len;
+  }
+  size_t filled = 0;
+  while (filled < len) {
+    if (r->ptr == r->end && !upb_RecordReader_Refill(r, status)) {
+      if (!r->eof) return false;  // Stream error.
+      return upb_RecordReader_Corrupt(status, "stream ended inside a record");
+    }
+    size_t have = r->end - r->ptr;
+    size_t copy = UPB_MIN(have, len - filled);
+    memcpy(r->scratch + filled, r->ptr, copy);
+    r->ptr += copy;
+    filled += copy;
+  }
+  *data = r->scratch;
+  *size = (size_t)len;
+  return true;
+}
+
+/* upb_RecordWriter *********************************************************/
+
+struct upb_RecordWriter {
+  upb_ZeroCopyOutputStream* output;
+  // Unfilled portion of the current stream buffer; NULL when we hold none.
+  char* ptr;
+  char* end;
+};
+
+upb_RecordWriter* upb_RecordWriter_New(upb_ZeroCopyOutputStream* output,
+                                       upb_Arena* arena) {
+  upb_RecordWriter* w = upb_Arena_Malloc(arena, sizeof(*w));
+  if (!w) return NULL;
+  w->output = output;
+  w->ptr = NULL;
+  w->end = NULL;
+  return w;
+}
+
+// Copies |size| bytes into the stream, requesting new buffers as the current
+// one fills. This is the only place that touches the stream on the write
+// path, so back-to-back small records share one buffer.
+static bool upb_RecordWriter_PutBytes(upb_RecordWriter* w, const char* data,
+                                      size_t size, upb_Status* status) {
+  while (size > 0) {
+    if (w->ptr == w->end) {
+      size_t count;
+      void* buf = upb_ZeroCopyOutputStream_Next(w->output, &count, status);
+      if (!buf) return false;
+      w->ptr = buf;
+      w->end = w->ptr + count;
+      continue;  // A stream may legally hand back an empty buffer.
+    }
+    size_t copy = UPB_MIN((size_t)(w->end - w->ptr), size);
+    memcpy(w->ptr, data, copy);
+    w->ptr += copy;
+    data += copy;
+    size -= copy;
+  }
+  return true;
+}
+
+bool upb_RecordWriter_Write(upb_RecordWriter* w, const char* data, size_t size,
+                            upb_Status* status) {
+  char prefix[10];
+  size_t prefix_len = 0;
+  uint64_t len = size;
+  do {
+    char byte = len & 0x7f;
+    len >>= 7;
+    if (len) byte |= 0x80;
+    prefix[prefix_len++] = byte;
+  } while (len);
+  return upb_RecordWriter_PutBytes(w, prefix, prefix_len, status) &&
+         upb_RecordWriter_PutBytes(w, data, size, status);
+}
+
+bool upb_RecordWriter_Flush(upb_RecordWriter* w, upb_Status* status) {
+  UPB_UNUSED(status);
+  // BackUp() both returns our unused tail and marks a flush point; streams
+  // are expected to surface flush failures on the next Next() call.
+  upb_ZeroCopyOutputStream_BackUp(w->output, w->end - w->ptr);
+  w->ptr = NULL;
+  w->end = NULL;
+  return true;
+}
+
+#include "upb/port/undef.inc"
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Varint-length-prefixed record streams: the framing everyone otherwise
+// hand-rolls around upb_Decode()/upb_Encode(). Each record is its serialized
+// size as a varint followed by that many payload bytes.
+
+#ifndef UPB_IO_RECORD_STREAM_H_
+#define UPB_IO_RECORD_STREAM_H_
+
+#include "upb/io/zero_copy_input_stream.h"
+#include "upb/io/zero_copy_output_stream.h"
+#include "upb/mem/arena.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct upb_RecordReader upb_RecordReader;
+typedef struct upb_RecordWriter upb_RecordWriter;
+
+// Creates a reader of length-prefixed records from |input|. The reader pulls
+// a stream chunk at a time, so one virtual Next() call on the stream serves
+// every record the chunk contains. Returns NULL on allocation failure.
+UPB_API upb_RecordReader* upb_RecordReader_New(upb_ZeroCopyInputStream* input,
+                                               upb_Arena* arena);
+
+// Reads the next record, pointing *data at its payload of *size bytes. The
+// payload usually aliases the stream's chunk buffer (a record that spans
+// chunks is stitched into an internal scratch buffer), so it is valid only
+// until the next call on the reader; decode it (or copy it) before reading
+// on. Returns false at end of stream, leaving |status| untouched, or on
+// error -- a stream error, an over-long length prefix, or a stream that ends
+// mid-record -- with |status| set if it is non-NULL.
+UPB_API bool upb_RecordReader_Next(upb_RecordReader* r, const char** data,
+                                   size_t* size, upb_Status* status);
+
+// Creates a writer of length-prefixed records to |output|. Returns NULL on
+// allocation failure.
+UPB_API upb_RecordWriter* upb_RecordWriter_New(upb_ZeroCopyOutputStream* output,
+                                               upb_Arena* arena);
+
+// Appends one record (length prefix plus |size| payload bytes). Writes
+// coalesce: records are packed into the current stream buffer and a new one
+// is requested only when it fills, so small records cost a memcpy, not a
+// virtual call. Returns false on a stream write error, with |status| set if
+// it is non-NULL.
+UPB_API bool upb_RecordWriter_Write(upb_RecordWriter* w, const char* data,
+                                    size_t size, upb_Status* status);
+
+// Returns any partially-filled stream buffer and signals a flush point to
+// the stream (see upb_ZeroCopyOutputStream BackUp()). Call after the last
+// record, and anywhere durability is needed; writing more records afterwards
+// is fine. Returns false on a stream write error, with |status| set if it is
+// non-NULL.
+UPB_API bool upb_RecordWriter_Flush(upb_RecordWriter* w, upb_Status* status);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_IO_RECORD_STREAM_H_ */
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/io/text_encode_to_stream.h"
+
+#include <string.h>
+
+#include "upb/mem/alloc.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+struct upb_TextEncoder {
+  char* buf;   // Scratch buffer, retained across messages.
+  size_t cap;  // Allocated size of |buf|.
+};
+
+upb_TextEncoder* upb_TextEncoder_New(void) {
+  upb_TextEncoder* e = upb_gmalloc(sizeof(*e));
+  if (!e) return NULL;
+  e->buf = NULL;
+  e->cap = 0;
+  return e;
+}
+
+void upb_TextEncoder_Free(upb_TextEncoder* e) {
+  if (!e) return;
+  upb_gfree(e->buf);
+  upb_gfree(e);
+}
+
+static bool upb_TextEncoder_Reserve(upb_TextEncoder* e, size_t size,
+                                    upb_Status* status) {
+  size_t cap = e->cap ? e->cap : 1024;
+  while (cap < size) cap *= 2;
+  if (cap != e->cap) {
+    // The old contents are truncated output, so a plain realloc (which may
+    // copy them) is fine; they are about to be overwritten anyway.
+    char* buf = upb_grealloc(e->buf, e->cap, cap);
+    if (!buf) {
+      if (status) upb_Status_SetErrorMessage(status, "out of memory");
+      return false;
+    }
+    e->buf = buf;
+    e->cap = cap;
+  }
+  return true;
+}
+
+static bool upb_TextEncoder_WriteToStream(const char* src, size_t remaining,
+                                          upb_ZeroCopyOutputStream* output,
+                                          upb_Status* status) {
+  while (remaining > 0) {
+    size_t count;
+    upb_Status stream_status;
+    upb_Status_Clear(&stream_status);
+    void* dst = upb_ZeroCopyOutputStream_Next(output, &count, &stream_status);
+    if (!dst) {
+      if (status) {
+        if (!upb_Status_IsOk(&stream_status)) {
+          upb_Status_SetErrorMessage(status,
+                                     upb_Status_ErrorMessage(&stream_status));
+        } else {
+          upb_Status_SetErrorMessage(status,
+                                     "output stream ended before the message "
+                                     "was fully written");
+        }
+      }
+      return false;
+    }
+    const size_t n = UPB_MIN(count, remaining);
+    memcpy(dst, src, n);
+    upb_ZeroCopyOutputStream_BackUp(output, count - n);
+    src += n;
+    remaining -= n;
+  }
+  return true;
+}
+
+bool upb_TextEncoder_EncodeToStream(upb_TextEncoder* e, const upb_Message* msg,
+                                    const upb_MessageDef* m,
+                                    const upb_DefPool* ext_pool, int options,
+                                    upb_ZeroCopyOutputStream* output,
+                                    upb_Status* status) {
+  // The estimate is an upper bound for all but pathological unknown fields,
+  // so the encode below almost always succeeds on the first try.
+  const size_t estimate =
+      upb_TextEncode_EstimateSize(msg, m, ext_pool, options);
+  if (estimate >= e->cap && !upb_TextEncoder_Reserve(e, estimate + 1, status)) {
+    return false;
+  }
+
+  size_t size = upb_TextEncode(msg, m, ext_pool, options, e->buf, e->cap);
+  if (size >= e->cap) {
+    // The estimate fell short; grow to the exact size and encode again.
+    if (!upb_TextEncoder_Reserve(e, size + 1, status)) return false;
+    size = upb_TextEncode(msg, m, ext_pool, options, e->buf, e->cap);
+    UPB_ASSERT(size < e->cap);
+  }
+
+  return upb_TextEncoder_WriteToStream(e->buf, size, output, status);
+}
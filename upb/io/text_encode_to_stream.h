@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UPB_IO_TEXT_ENCODE_TO_STREAM_H_
+#define UPB_IO_TEXT_ENCODE_TO_STREAM_H_
+
+#include "upb/io/zero_copy_output_stream.h"
+#include "upb/text/encode.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A reusable text-format encoder for writing many messages to streams,
+// analogous to upb_JsonEncoder (see json_encode_to_stream.h).  It keeps one
+// scratch buffer across calls, sized up front with
+// upb_TextEncode_EstimateSize() so even the first message is normally
+// encoded exactly once instead of twice; peak memory is one encoded message
+// plus one stream chunk.  The encoder holds no per-message state and may be
+// reused freely, but is not thread-safe.
+typedef struct upb_TextEncoder upb_TextEncoder;
+
+// Returns a new encoder, or NULL on allocation failure.  Free it with
+// upb_TextEncoder_Free() when done.
+upb_TextEncoder* upb_TextEncoder_New(void);
+
+// Encodes |msg| to text format exactly as upb_TextEncode() would and pushes
+// the bytes through |output| one upb_ZeroCopyOutputStream_Next() buffer at a
+// time (the terminating NUL is not written).  Returns false on stream write
+// errors or allocation failure, with |status| set if it is non-NULL.
+bool upb_TextEncoder_EncodeToStream(upb_TextEncoder* e, const upb_Message* msg,
+                                    const upb_MessageDef* m,
+                                    const upb_DefPool* ext_pool, int options,
+                                    upb_ZeroCopyOutputStream* output,
+                                    upb_Status* status);
+
+void upb_TextEncoder_Free(upb_TextEncoder* e);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_IO_TEXT_ENCODE_TO_STREAM_H_ */
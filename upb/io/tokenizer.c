@@ -231,6 +231,14 @@ static void Refresh(upb_Tokenizer* t) {
   t->buffer = NULL;
   t->buffer_pos = 0;
 
+  // The input stream is optional (flat-array-only tokenizers pass NULL).
+  if (t->input == NULL) {
+    t->buffer_size = 0;
+    t->read_error = true;
+    t->current_char = '\0';
+    return;
+  }
+
   upb_Status status;
   const void* data =
       upb_ZeroCopyInputStream_Next(t->input, &t->buffer_size, &status);
@@ -268,6 +276,50 @@ static void NextChar(upb_Tokenizer* t) {
   }
 }
 
+// Returns the offset of the first byte in [pos, size) equal to one of the
+// |n| target bytes, or |size| if there is none.  Each target is found with
+// memchr() over the not-yet-excluded prefix, so the whole scan runs at
+// memchr speed rather than byte-at-a-time.
+static size_t ScanForAny(const char* buffer, size_t size, size_t pos,
+                         const char* targets, size_t n) {
+  size_t limit = size;
+  for (size_t i = 0; i < n && pos < limit; i++) {
+    const char* p = memchr(buffer + pos, targets[i], limit - pos);
+    if (p) limit = (size_t)(p - buffer);
+  }
+  return limit;
+}
+
+// Advances to |new_pos| within the current buffer, updating line/column
+// exactly as repeated NextChar() calls would but without the per-character
+// overhead.  |new_pos| may equal buffer_size, in which case the next buffer
+// is fetched.  Recording is unaffected: it works on buffer spans.
+static void AdvanceSpan(upb_Tokenizer* t, size_t new_pos) {
+  size_t pos = t->buffer_pos;
+  while (pos < new_pos) {
+    // Find the next newline or tab; everything in between is a plain
+    // column-width-one run.
+    const size_t sp = ScanForAny(t->buffer, new_pos, pos, "\n\t", 2);
+    t->column += (int)(sp - pos);
+    if (sp == new_pos) break;
+    if (t->buffer[sp] == '\n') {
+      t->line++;
+      t->column = 0;
+    } else {
+      t->column +=
+          kUpb_Tokenizer_TabWidth - t->column % kUpb_Tokenizer_TabWidth;
+    }
+    pos = sp + 1;
+  }
+
+  t->buffer_pos = new_pos;
+  if (t->buffer_pos < t->buffer_size) {
+    t->current_char = t->buffer[t->buffer_pos];
+  } else {
+    Refresh(t);
+  }
+}
+
 static void RecordTo(upb_Tokenizer* t, upb_String* target) {
   t->record_target = target;
   t->record_start = t->buffer_pos;
@@ -353,6 +405,42 @@ static void ConsumeOneOrMore(upb_Tokenizer* t, bool (*f)(char),
   } while (f(t->current_char));
 }
 
+// Consumes a run of ordinary string-literal characters (anything other
+// than |delimiter|, backslash, newline, tab, or NUL) with a single column
+// update.  Kept out of line so the hot switch in ConsumeString() stays
+// small; most iterations there handle escapes or the closing delimiter.
+UPB_NOINLINE
+static void SkipStringRun(upb_Tokenizer* t, char delimiter) {
+  const char* buffer = t->buffer;
+  const size_t size = t->buffer_size;
+  size_t pos = t->buffer_pos + 1;
+
+  // Short runs (e.g. a character or two between escapes) are common, so
+  // scan the first few bytes directly; memchr() only pays off on longer
+  // runs.  A '\t' or '\0' target stops the scan so the callers of this
+  // function still see those characters and handle them.
+  const size_t direct_limit = UPB_MIN(size, pos + 16);
+  while (pos < direct_limit) {
+    const char c = buffer[pos];
+    if (c == delimiter || c == '\\' || c == '\n' || c == '\t' || c == '\0') {
+      break;
+    }
+    pos++;
+  }
+  if (pos == direct_limit && pos < size) {
+    const char targets[5] = {delimiter, '\\', '\n', '\t', '\0'};
+    pos = ScanForAny(buffer, size, pos, targets, 5);
+  }
+
+  t->column += (int)(pos - t->buffer_pos);
+  t->buffer_pos = pos;
+  if (pos < size) {
+    t->current_char = buffer[pos];
+  } else {
+    Refresh(t);
+  }
+}
+
 // -----------------------------------------------------------------
 // The following four methods are used to consume tokens of specific
 // types.  They are actually used to consume all characters *after*
@@ -415,7 +503,11 @@ static void ConsumeString(upb_Tokenizer* t, char delimiter) {
           NextChar(t);
           return;
         }
-        NextChar(t);
+        if (t->current_char == '\t') {
+          NextChar(t);  // Needs the tab-stop column bookkeeping.
+        } else {
+          SkipStringRun(t, delimiter);
+        }
         break;
       }
     }
@@ -489,7 +581,8 @@ static void ConsumeLineComment(upb_Tokenizer* t, upb_String* content) {
   if (content != NULL) RecordTo(t, content);
 
   while (t->current_char != '\0' && t->current_char != '\n') {
-    NextChar(t);
+    AdvanceSpan(t, ScanForAny(t->buffer, t->buffer_size, t->buffer_pos,
+                              "\n\0", 2));
   }
   TryConsume(t, '\n');
 
@@ -505,7 +598,9 @@ static void ConsumeBlockComment(upb_Tokenizer* t, upb_String* content) {
   while (true) {
     while (t->current_char != '\0' && t->current_char != '*' &&
            t->current_char != '/' && t->current_char != '\n') {
-      NextChar(t);
+      AdvanceSpan(t,
+                  ScanForAny(t->buffer, t->buffer_size, t->buffer_pos,
+                             "*/\n\0", 4));
     }
 
     if (TryConsume(t, '\n')) {
@@ -714,6 +809,105 @@ bool upb_Tokenizer_Next(upb_Tokenizer* t, upb_Status* status) {
   return false;
 }
 
+// -------------------------------------------------------------------
+// Checkpoints.  A checkpoint copies every field of the tokenizer that
+// upb_Tokenizer_Next() reads or writes, except the input stream itself:
+// restoring rewinds within the buffer the tokenizer currently holds, so a
+// checkpoint dies as soon as Refresh() fetches a new buffer (the old bytes
+// belong to the stream and may be gone).  The buffer pointer and size are
+// kept solely to detect that.
+
+struct upb_TokenizerCheckpoint {
+  upb_TokenType token_type;
+  upb_String token_text;
+  int token_line;
+  int token_column;
+  int token_end_column;
+
+  upb_TokenType previous_type;
+  int previous_line;
+  int previous_column;
+  int previous_end_column;
+
+  const char* buffer;
+  size_t buffer_size;
+  size_t buffer_pos;
+  char current_char;
+  bool read_error;
+
+  int line;
+  int column;
+};
+
+upb_TokenizerCheckpoint* upb_TokenizerCheckpoint_New(upb_Arena* arena) {
+  upb_TokenizerCheckpoint* c =
+      upb_Arena_Malloc(arena, sizeof(upb_TokenizerCheckpoint));
+  if (!c) return NULL;
+  memset(c, 0, sizeof(*c));
+  upb_String_Init(&c->token_text, arena);
+  return c;
+}
+
+void upb_Tokenizer_Save(const upb_Tokenizer* t, upb_TokenizerCheckpoint* c) {
+  // Checkpoints may only be taken between Next() calls, never from inside
+  // a consume callback while a record is in progress.
+  UPB_ASSERT(t->record_target == NULL);
+
+  c->token_type = t->token_type;
+  upb_String_Copy(&c->token_text, &t->token_text);
+  c->token_line = t->token_line;
+  c->token_column = t->token_column;
+  c->token_end_column = t->token_end_column;
+
+  c->previous_type = t->previous_type;
+  c->previous_line = t->previous_line;
+  c->previous_column = t->previous_column;
+  c->previous_end_column = t->previous_end_column;
+
+  c->buffer = t->buffer;
+  c->buffer_size = t->buffer_size;
+  c->buffer_pos = t->buffer_pos;
+  c->current_char = t->current_char;
+  c->read_error = t->read_error;
+
+  c->line = t->line;
+  c->column = t->column;
+}
+
+bool upb_Tokenizer_Restore(upb_Tokenizer* t, const upb_TokenizerCheckpoint* c) {
+  UPB_ASSERT(t->record_target == NULL);
+
+  // A stream checkpoint is only valid while the tokenizer still holds the
+  // buffer it was taken in.  A flat-array tokenizer's buffer is the
+  // caller's array, which stays valid even after the tokenizer drops it at
+  // EOF, so restoring (and re-attaching the buffer) is always possible.
+  if (t->input != NULL &&
+      (t->buffer != c->buffer || t->buffer_size != c->buffer_size)) {
+    return false;
+  }
+
+  t->token_type = c->token_type;
+  upb_String_Copy(&t->token_text, &c->token_text);
+  t->token_line = c->token_line;
+  t->token_column = c->token_column;
+  t->token_end_column = c->token_end_column;
+
+  t->previous_type = c->previous_type;
+  t->previous_line = c->previous_line;
+  t->previous_column = c->previous_column;
+  t->previous_end_column = c->previous_end_column;
+
+  t->buffer = c->buffer;
+  t->buffer_size = c->buffer_size;
+  t->buffer_pos = c->buffer_pos;
+  t->current_char = c->current_char;
+  t->read_error = c->read_error;
+
+  t->line = c->line;
+  t->column = c->column;
+  return true;
+}
+
 // -------------------------------------------------------------------
 // Token-parsing helpers.  Remember that these don't need to report
 // errors since any errors should already have been reported while
@@ -1014,7 +1208,7 @@ upb_Tokenizer* upb_Tokenizer_New(const void* data, size_t size,
 void upb_Tokenizer_Fini(upb_Tokenizer* t) {
   // If we had any buffer left unread, return it to the underlying stream
   // so that someone else can read it.
-  if (t->buffer_size > t->buffer_pos) {
+  if (t->input != NULL && t->buffer_size > t->buffer_pos) {
     upb_ZeroCopyInputStream_BackUp(t->input, t->buffer_size - t->buffer_pos);
   }
 }
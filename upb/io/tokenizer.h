@@ -114,6 +114,28 @@ void upb_Tokenizer_Fini(upb_Tokenizer* t);
 // Returns False and (clears *status on EOF, sets *status on error).
 bool upb_Tokenizer_Next(upb_Tokenizer* t, upb_Status* status);
 
+// Checkpoints, for speculative parsing.  A checkpoint snapshots the
+// tokenizer's position and token state so a backtracking parser can try one
+// interpretation and rewind on failure instead of re-tokenizing from the
+// start.  Save and restore copy a fixed-size struct plus the current token
+// text, so speculation costs O(tokens speculated), not O(input).
+//
+// A checkpoint stays valid as long as the tokenizer has not advanced past
+// the input chunk it was taken in: always, for a tokenizer reading only
+// from a flat array; until the next buffer is fetched from the stream, for
+// a tokenizer reading from a ZeroCopyInputStream.  upb_Tokenizer_Restore() returns false (and
+// restores nothing) for a checkpoint that is no longer valid, which callers
+// can treat as "commit": bound speculation to one chunk, or use a flat
+// array when unbounded lookahead is needed.  Checkpoints may be saved to
+// repeatedly and may be restored any number of times, but not while a
+// Next() call is in progress.
+typedef struct upb_TokenizerCheckpoint upb_TokenizerCheckpoint;
+
+upb_TokenizerCheckpoint* upb_TokenizerCheckpoint_New(upb_Arena* arena);
+
+void upb_Tokenizer_Save(const upb_Tokenizer* t, upb_TokenizerCheckpoint* c);
+bool upb_Tokenizer_Restore(upb_Tokenizer* t, const upb_TokenizerCheckpoint* c);
+
 // Accessors for inspecting current/previous parse tokens,
 // which are opaque to the tokenizer (to reduce copying).
 
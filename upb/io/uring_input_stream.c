@@ -0,0 +1,417 @@
+/*
+ * Copyright (c) 2009-2022, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/io/uring_input_stream.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+#define UPB_HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#endif
+
+// Must be last.
+#include "upb/port/def.inc"
+
+// Default bytes per read when the caller passes block_size == 0.
+#define kUpb_UringInputStream_DefaultBlockSize (128 * 1024)
+
+// Default reads in flight when the caller passes depth == 0.
+#define kUpb_UringInputStream_DefaultDepth 4
+
+#ifdef UPB_HAVE_IO_URING
+
+// Per-slot read state; non-negative values are completed read results.
+#define kUpb_UringSlot_Idle INT64_MIN
+#define kUpb_UringSlot_Pending (INT64_MIN + 1)
+
+typedef struct {
+  upb_ZeroCopyInputStream base;
+
+  int fd;
+  int ring_fd;
+  size_t block_size;
+  uint32_t depth;  // Power of two; slot for block b is b % depth.
+
+  char** buffers;    // depth buffers of block_size bytes each.
+  int64_t* results;  // Per-slot state (see kUpb_UringSlot_*).
+
+  uint64_t submit_block;   // Next block index to submit a read for.
+  uint64_t consume_block;  // Next block index to hand to the caller.
+  int resubmit_slot;       // Slot to resubmit once its buffer is free, or -1.
+  bool eof_seen;           // A short or empty read was observed; stop
+                           // submitting further blocks.
+  bool at_eof;             // The caller has consumed everything.
+  int ring_errno;          // Sticky submission error, or 0.
+
+  // Remainder of the last returned block (for BackUp).
+  const char* cur;
+  size_t cur_size;
+  size_t cur_pos;
+
+  size_t position;  // Total bytes consumed, for ByteCount().
+  size_t last_returned_size;
+
+  // The mapped rings.
+  void* sq_ring;
+  size_t sq_ring_sz;
+  void* cq_ring;  // Equal to sq_ring with IORING_FEAT_SINGLE_MMAP.
+  size_t cq_ring_sz;
+  struct io_uring_sqe* sqes;
+  size_t sqes_sz;
+  unsigned* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned* cq_mask;
+  struct io_uring_cqe* cqes;
+} upb_UringInputStream;
+
+static int upb_Uring_Setup(unsigned entries, struct io_uring_params* p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int upb_Uring_Enter(int ring_fd, unsigned to_submit,
+                           unsigned min_complete, unsigned flags) {
+  int ret;
+  do {
+    ret = (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                       flags, NULL, 0);
+  } while (ret < 0 && errno == EINTR);
+  return ret;
+}
+
+// Queues a positional read of |block| into |slot|'s buffer.  The SQ ring can
+// never fill up since at most |depth| <= sq_entries reads are in flight.
+static void upb_UringInputStream_SubmitRead(upb_UringInputStream* s,
+                                            unsigned slot, uint64_t block) {
+  const unsigned tail = *s->sq_tail;
+  const unsigned idx = tail & *s->sq_mask;
+  struct io_uring_sqe* sqe = &s->sqes[idx];
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = s->fd;
+  sqe->addr = (uint64_t)(uintptr_t)s->buffers[slot];
+  sqe->len = (uint32_t)s->block_size;
+  sqe->off = block * (uint64_t)s->block_size;
+  sqe->user_data = slot;
+
+  s->sq_array[idx] = idx;
+  __atomic_store_n(s->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  s->results[slot] = kUpb_UringSlot_Pending;
+
+  if (upb_Uring_Enter(s->ring_fd, 1, 0, 0) < 0 && !s->ring_errno) {
+    s->ring_errno = errno;
+  }
+}
+
+// Moves any posted completions from the CQ ring into results[].
+static void upb_UringInputStream_Reap(upb_UringInputStream* s) {
+  unsigned head = *s->cq_head;
+  const unsigned tail = __atomic_load_n(s->cq_tail, __ATOMIC_ACQUIRE);
+  if (head == tail) return;
+
+  while (head != tail) {
+    const struct io_uring_cqe* cqe = &s->cqes[head & *s->cq_mask];
+    UPB_ASSERT(cqe->user_data < s->depth);
+    s->results[cqe->user_data] = cqe->res;
+    head++;
+  }
+  __atomic_store_n(s->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static const void* upb_UringInputStream_NextInternal(upb_ZeroCopyInputStream* z,
+                                                     size_t* count,
+                                                     bool blocking,
+                                                     bool* would_block,
+                                                     upb_Status* status) {
+  upb_UringInputStream* s = (upb_UringInputStream*)z;
+  *count = 0;
+  *would_block = false;
+
+  // First hand back anything that was backed up.
+  if (s->cur_pos < s->cur_size) {
+    const size_t chunk = s->cur_size - s->cur_pos;
+    const char* out = s->cur + s->cur_pos;
+    s->cur_pos = s->cur_size;
+    s->position += chunk;
+    s->last_returned_size = chunk;
+    *count = chunk;
+    return out;
+  }
+
+  if (s->at_eof) return NULL;
+  if (s->ring_errno) {
+    upb_Status_SetErrorFormat(status, "io_uring_enter failed: %s",
+                              strerror(s->ring_errno));
+    return NULL;
+  }
+
+  // The buffer returned last time is free again; queue its next read.
+  if (s->resubmit_slot >= 0) {
+    if (!s->eof_seen) {
+      upb_UringInputStream_SubmitRead(s, (unsigned)s->resubmit_slot,
+                                      s->submit_block++);
+    }
+    s->resubmit_slot = -1;
+  }
+
+  const unsigned slot = (unsigned)(s->consume_block % s->depth);
+  upb_UringInputStream_Reap(s);
+  while (s->results[slot] == kUpb_UringSlot_Pending) {
+    if (!blocking) {
+      *would_block = true;
+      return NULL;
+    }
+    if (upb_Uring_Enter(s->ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0) {
+      upb_Status_SetErrorFormat(status, "io_uring_enter failed: %s",
+                                strerror(errno));
+      return NULL;
+    }
+    upb_UringInputStream_Reap(s);
+  }
+
+  const int64_t res = s->results[slot];
+  s->results[slot] = kUpb_UringSlot_Idle;
+
+  if (res < 0) {
+    upb_Status_SetErrorFormat(status, "read failed: %s", strerror((int)-res));
+    return NULL;
+  }
+  if (res == 0) {
+    s->at_eof = true;
+    return NULL;
+  }
+
+  // A short read means EOF on the fd types this stream supports.
+  if ((size_t)res < s->block_size) s->eof_seen = true;
+
+  s->consume_block++;
+  s->resubmit_slot = (int)slot;
+  s->cur = s->buffers[slot];
+  s->cur_size = (size_t)res;
+  s->cur_pos = s->cur_size;
+  s->position += s->cur_size;
+  s->last_returned_size = s->cur_size;
+  *count = s->cur_size;
+  return s->cur;
+}
+
+static const void* upb_UringInputStream_Next(upb_ZeroCopyInputStream* z,
+                                             size_t* count,
+                                             upb_Status* status) {
+  bool would_block;
+  return upb_UringInputStream_NextInternal(z, count, true, &would_block,
+                                           status);
+}
+
+static void upb_UringInputStream_BackUp(upb_ZeroCopyInputStream* z,
+                                        size_t count) {
+  upb_UringInputStream* s = (upb_UringInputStream*)z;
+
+  UPB_ASSERT(s->last_returned_size >= count);
+  s->cur_pos -= count;
+  s->position -= count;
+  s->last_returned_size -= count;
+}
+
+static bool upb_UringInputStream_Skip(upb_ZeroCopyInputStream* z,
+                                      size_t count) {
+  upb_UringInputStream* s = (upb_UringInputStream*)z;
+
+  s->last_returned_size = 0;  // Don't let caller back up.
+
+  // Consume buffered data first.
+  const size_t buffered = UPB_MIN(count, s->cur_size - s->cur_pos);
+  s->cur_pos += buffered;
+  s->position += buffered;
+  count -= buffered;
+
+  while (count > 0) {
+    size_t chunk;
+    upb_Status status;
+    upb_Status_Clear(&status);
+    if (!upb_UringInputStream_Next(z, &chunk, &status)) return false;
+    if (chunk > count) {
+      upb_UringInputStream_BackUp(z, chunk - count);
+      return true;
+    }
+    count -= chunk;
+  }
+  return true;
+}
+
+static size_t upb_UringInputStream_ByteCount(const upb_ZeroCopyInputStream* z) {
+  const upb_UringInputStream* s = (const upb_UringInputStream*)z;
+
+  return s->position;
+}
+
+static const _upb_ZeroCopyInputStream_VTable upb_UringInputStream_vtable = {
+    upb_UringInputStream_Next,
+    upb_UringInputStream_BackUp,
+    upb_UringInputStream_Skip,
+    upb_UringInputStream_ByteCount,
+};
+
+upb_ZeroCopyInputStream* upb_UringInputStream_New(int fd, size_t block_size,
+                                                  uint32_t depth,
+                                                  upb_Arena* arena) {
+  if (fd < 0) return NULL;
+  if (!block_size) block_size = kUpb_UringInputStream_DefaultBlockSize;
+  if (!depth) depth = kUpb_UringInputStream_DefaultDepth;
+  while (depth & (depth - 1)) depth++;  // Round up to a power of two.
+
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  const int ring_fd = upb_Uring_Setup(depth, &p);
+  if (ring_fd < 0) return NULL;
+
+  upb_UringInputStream* s = upb_Arena_Malloc(arena, sizeof(*s));
+  if (!s) goto err_close;
+  memset(s, 0, sizeof(*s));
+
+  s->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  s->cq_ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    s->sq_ring_sz = UPB_MAX(s->sq_ring_sz, s->cq_ring_sz);
+    s->cq_ring_sz = 0;
+  }
+
+  s->sq_ring = mmap(NULL, s->sq_ring_sz, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  if (s->sq_ring == MAP_FAILED) goto err_close;
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    s->cq_ring = s->sq_ring;
+  } else {
+    s->cq_ring = mmap(NULL, s->cq_ring_sz, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    if (s->cq_ring == MAP_FAILED) goto err_unmap_sq;
+  }
+
+  s->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+  s->sqes = mmap(NULL, s->sqes_sz, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+  if (s->sqes == MAP_FAILED) goto err_unmap_cq;
+
+  s->sq_tail = (unsigned*)((char*)s->sq_ring + p.sq_off.tail);
+  s->sq_mask = (unsigned*)((char*)s->sq_ring + p.sq_off.ring_mask);
+  s->sq_array = (unsigned*)((char*)s->sq_ring + p.sq_off.array);
+  s->cq_head = (unsigned*)((char*)s->cq_ring + p.cq_off.head);
+  s->cq_tail = (unsigned*)((char*)s->cq_ring + p.cq_off.tail);
+  s->cq_mask = (unsigned*)((char*)s->cq_ring + p.cq_off.ring_mask);
+  s->cqes = (struct io_uring_cqe*)((char*)s->cq_ring + p.cq_off.cqes);
+
+  s->buffers = upb_Arena_Malloc(arena, depth * sizeof(char*));
+  s->results = upb_Arena_Malloc(arena, depth * sizeof(int64_t));
+  if (!s->buffers || !s->results) goto err_unmap_all;
+  for (uint32_t i = 0; i < depth; i++) {
+    s->buffers[i] = upb_Arena_Malloc(arena, block_size);
+    if (!s->buffers[i]) goto err_unmap_all;
+    s->results[i] = kUpb_UringSlot_Idle;
+  }
+
+  s->base.vtable = &upb_UringInputStream_vtable;
+  s->fd = fd;
+  s->ring_fd = ring_fd;
+  s->block_size = block_size;
+  s->depth = depth;
+  s->resubmit_slot = -1;
+
+  // Fill the pipeline.
+  for (uint32_t i = 0; i < depth; i++) {
+    upb_UringInputStream_SubmitRead(s, i, s->submit_block++);
+  }
+
+  return (upb_ZeroCopyInputStream*)s;
+
+err_unmap_all:
+  munmap(s->sqes, s->sqes_sz);
+err_unmap_cq:
+  if (s->cq_ring != s->sq_ring) munmap(s->cq_ring, s->cq_ring_sz);
+err_unmap_sq:
+  munmap(s->sq_ring, s->sq_ring_sz);
+err_close:
+  close(ring_fd);
+  return NULL;
+}
+
+const void* upb_UringInputStream_TryNext(upb_ZeroCopyInputStream* z,
+                                         size_t* count, bool* would_block,
+                                         upb_Status* status) {
+  return upb_UringInputStream_NextInternal(z, count, false, would_block,
+                                           status);
+}
+
+int upb_UringInputStream_PollFd(const upb_ZeroCopyInputStream* z) {
+  const upb_UringInputStream* s = (const upb_UringInputStream*)z;
+
+  return s->ring_fd;
+}
+
+void upb_UringInputStream_Fini(upb_ZeroCopyInputStream* z) {
+  upb_UringInputStream* s = (upb_UringInputStream*)z;
+  if (s->ring_fd < 0) return;
+
+  munmap(s->sqes, s->sqes_sz);
+  if (s->cq_ring != s->sq_ring) munmap(s->cq_ring, s->cq_ring_sz);
+  munmap(s->sq_ring, s->sq_ring_sz);
+  close(s->ring_fd);
+  s->ring_fd = -1;
+}
+
+#else /* !UPB_HAVE_IO_URING */
+
+upb_ZeroCopyInputStream* upb_UringInputStream_New(int fd, size_t block_size,
+                                                  uint32_t depth,
+                                                  upb_Arena* arena) {
+  return NULL;  // io_uring is not available on this platform.
+}
+
+const void* upb_UringInputStream_TryNext(upb_ZeroCopyInputStream* z,
+                                         size_t* count, bool* would_block,
+                                         upb_Status* status) {
+  *count = 0;
+  *would_block = false;
+  return NULL;
+}
+
+int upb_UringInputStream_PollFd(const upb_ZeroCopyInputStream* z) { return -1; }
+
+void upb_UringInputStream_Fini(upb_ZeroCopyInputStream* z) {}
+
+#endif /* UPB_HAVE_IO_URING */
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2009-2022, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// An asynchronous ZeroCopyInputStream over io_uring (Linux only).
+//
+// The stream keeps several block reads in flight at once, so Next()
+// usually returns a buffer that the kernel already filled while the caller
+// was parsing the previous one: disk latency is pipelined behind parse CPU.
+// The implementation issues raw io_uring syscalls and has no library
+// dependencies.
+//
+// The fd must support positional reads (regular files or block devices);
+// completions may arrive out of order, and the stream reorders them by
+// file offset.  The caller retains ownership of the fd.
+
+#ifndef UPB_IO_URING_INPUT_STREAM_H_
+#define UPB_IO_URING_INPUT_STREAM_H_
+
+#include "upb/io/zero_copy_input_stream.h"
+#include "upb/mem/arena.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Creates a stream reading from |fd| in |block_size|-byte blocks (0 selects
+// a default) with |depth| reads in flight (0 selects a default, values are
+// rounded up to a power of two).  Returns NULL if io_uring is unavailable
+// (non-Linux platforms, old kernels, or seccomp policies that forbid it);
+// callers can fall back to upb_FdInputStream.
+upb_ZeroCopyInputStream* upb_UringInputStream_New(int fd, size_t block_size,
+                                                  uint32_t depth,
+                                                  upb_Arena* arena);
+
+// Like Next(), but never blocks: if the next block's read has not completed
+// yet, returns NULL, sets *count to zero and *would_block to true.  EOF and
+// errors are reported as Next() does, with *would_block false.  Intended
+// for event loops; wait for readability of upb_UringInputStream_PollFd()
+// before retrying.
+const void* upb_UringInputStream_TryNext(upb_ZeroCopyInputStream* z,
+                                         size_t* count, bool* would_block,
+                                         upb_Status* status);
+
+// An fd that becomes readable when an in-flight read completes; suitable
+// for registration with epoll/poll.  (This is the io_uring fd itself.)
+int upb_UringInputStream_PollFd(const upb_ZeroCopyInputStream* z);
+
+// Releases the io_uring and its buffers.  Must be called exactly once,
+// before the arena holding the stream is freed.
+void upb_UringInputStream_Fini(upb_ZeroCopyInputStream* z);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_IO_URING_INPUT_STREAM_H_ */
@@ -37,10 +37,21 @@
 
 #include "upb/collections/map.h"
 #include "upb/lex/atoi.h"
+#include "upb/lex/strtod.h"
 #include "upb/lex/unicode.h"
+#include "upb/mem/alloc.h"
+#ifdef UPB_PROFILE
+#include "upb/profile/profile.h"
+#endif
 #include "upb/reflection/message.h"
 #include "upb/wire/encode.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 // Must be last.
 #include "upb/port/def.inc"
 
@@ -266,40 +277,88 @@ static void jsondec_skipdigits(jsondec* d) {
   }
 }
 
+/* Accumulates the digits in [ptr, end) into *mantissa.  Returns false if the
+ * count would exceed the 19 digits that always fit in a uint64_t, in which
+ * case the caller must take the slow path. */
+static bool jsondec_accumdigits(const char* ptr, const char* end,
+                                uint64_t* mantissa, int* ndigits) {
+  const int len = (int)(end - ptr);
+  if (*ndigits + len > 19) return false;
+  uint64_t m = *mantissa;
+  while (ptr < end) {
+    m = m * 10 + (uint64_t)(*ptr++ - '0');
+  }
+  *mantissa = m;
+  *ndigits += len;
+  return true;
+}
+
 static double jsondec_number(jsondec* d) {
   const char* start = d->ptr;
+  uint64_t mantissa = 0;
+  int ndigits = 0;
+  int frac_digits = 0;
+  int exp_val = 0;
+  bool neg = false;
+  bool fast = true;
 
   assert(jsondec_rawpeek(d) == JD_NUMBER);
 
-  /* Skip over the syntax of a number, as specified by JSON. */
-  if (*d->ptr == '-') d->ptr++;
+  /* Skip over the syntax of a number, as specified by JSON, collecting the
+   * mantissa and exponent for the fast conversion path as we go. */
+  if (*d->ptr == '-') {
+    neg = true;
+    d->ptr++;
+  }
 
   if (jsondec_tryparsech(d, '0')) {
     if (jsondec_tryskipdigits(d)) {
       jsondec_err(d, "number cannot have leading zero");
     }
   } else {
+    const char* p = d->ptr;
     jsondec_skipdigits(d);
+    fast = jsondec_accumdigits(p, d->ptr, &mantissa, &ndigits) && fast;
   }
 
   if (d->ptr == d->end) goto parse;
   if (jsondec_tryparsech(d, '.')) {
+    const char* p = d->ptr;
     jsondec_skipdigits(d);
+    frac_digits = (int)(d->ptr - p);
+    fast = jsondec_accumdigits(p, d->ptr, &mantissa, &ndigits) && fast;
   }
   if (d->ptr == d->end) goto parse;
 
   if (*d->ptr == 'e' || *d->ptr == 'E') {
+    bool exp_neg = false;
+    const char* p;
     d->ptr++;
     if (d->ptr == d->end) {
       jsondec_err(d, "Unexpected EOF in number");
     }
     if (*d->ptr == '+' || *d->ptr == '-') {
+      exp_neg = *d->ptr == '-';
       d->ptr++;
     }
+    p = d->ptr;
     jsondec_skipdigits(d);
+    if (d->ptr - p > 3) {
+      fast = false; /* Huge exponent; certainly outside the fast range. */
+    } else {
+      while (p < d->ptr) exp_val = exp_val * 10 + (*p++ - '0');
+      if (exp_neg) exp_val = -exp_val;
+    }
   }
 
 parse:
+  if (fast) {
+    double val;
+    if (_upb_Strtod_FastPath(mantissa, exp_val - frac_digits, neg, &val)) {
+      return val;
+    }
+  }
+
   /* Having verified the syntax of a JSON number, use strtod() to parse
    * (strtod() accepts a superset of JSON syntax). */
   errno = 0;
@@ -407,6 +466,58 @@ static void jsondec_resize(jsondec* d, char** buf, char** end, char** buf_end) {
   *buf_end = *buf + size;
 }
 
+/* Returns a pointer to the first byte in [ptr, end) that needs special
+ * handling in a JSON string (closing quote, backslash escape, or a control
+ * byte, which is an error), or |end| if there is none.  Scans with 16-byte
+ * compares where available so that clean spans can be bulk-copied. */
+static const char* jsondec_scanstring(const char* ptr, const char* end) {
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+  while (end - ptr >= 16) {
+    const __m128i data = _mm_loadu_si128((const __m128i*)ptr);
+    const __m128i quote = _mm_cmpeq_epi8(data, _mm_set1_epi8('"'));
+    const __m128i bslash = _mm_cmpeq_epi8(data, _mm_set1_epi8('\\'));
+    const __m128i ctrl =
+        _mm_cmpeq_epi8(_mm_min_epu8(data, _mm_set1_epi8(0x1f)), data);
+    const int mask =
+        _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(quote, bslash), ctrl));
+    if (mask != 0) return ptr + __builtin_ctz(mask);
+    ptr += 16;
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  while (end - ptr >= 16) {
+    const uint8x16_t data = vld1q_u8((const uint8_t*)ptr);
+    const uint8x16_t special =
+        vorrq_u8(vorrq_u8(vceqq_u8(data, vdupq_n_u8('"')),
+                          vceqq_u8(data, vdupq_n_u8('\\'))),
+                 vcltq_u8(data, vdupq_n_u8(0x20)));
+    if (vmaxvq_u8(special) != 0) break; /* Locate it in the tail loop. */
+    ptr += 16;
+  }
+#endif
+
+  /* Check 8 bytes at a time; the classic SWAR "zero byte" and "byte < N"
+   * tests light up the high bit of each matching lane. */
+  while (end - ptr >= 8) {
+    uint64_t word;
+    memcpy(&word, ptr, 8);
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    const uint64_t q = word ^ (ones * '"');
+    const uint64_t b = word ^ (ones * '\\');
+    const uint64_t special =
+        ((q - ones) & ~q) | ((b - ones) & ~b) | ((word - ones * 0x20) & ~word);
+    if (special & highs) break;
+    ptr += 8;
+  }
+
+  while (ptr < end) {
+    const unsigned char ch = (unsigned char)*ptr;
+    if (ch == '"' || ch == '\\' || ch < 0x20) break;
+    ptr++;
+  }
+  return ptr;
+}
+
 static upb_StringView jsondec_string(jsondec* d) {
   char* buf = NULL;
   char* end = NULL;
@@ -419,6 +530,20 @@ static upb_StringView jsondec_string(jsondec* d) {
   }
 
   while (d->ptr < d->end) {
+    /* Bulk-copy the clean span up to the next quote, escape or control byte.
+     * Reserve one extra byte so the NUL store below always has room. */
+    const char* special = jsondec_scanstring(d->ptr, d->end);
+    const size_t span = special - d->ptr;
+    if (span) {
+      while ((size_t)(buf_end - end) < span + 1) {
+        jsondec_resize(d, &buf, &end, &buf_end);
+      }
+      memcpy(end, d->ptr, span);
+      end += span;
+      d->ptr = special;
+      if (d->ptr == d->end) break;
+    }
+
     char ch = *d->ptr++;
 
     if (end == buf_end) {
@@ -447,10 +572,9 @@ static upb_StringView jsondec_string(jsondec* d) {
         }
         break;
       default:
-        if ((unsigned char)*d->ptr < 0x20) {
-          jsondec_err(d, "Invalid char in JSON string");
-        }
-        *end++ = ch;
+        /* jsondec_scanstring() only stops on quotes, escapes and control
+         * bytes, and the first two have cases above. */
+        jsondec_err(d, "Invalid char in JSON string");
         break;
     }
   }
@@ -459,12 +583,37 @@ eof:
   jsondec_err(d, "EOF inside string");
 }
 
+/* Object keys almost never contain escapes, so try to return a view that
+ * aliases the input instead of copying byte-by-byte through an arena buffer.
+ * Falls back to jsondec_string() when the key does contain an escape.  The
+ * returned data is not NUL-terminated, which is fine for name lookups (unlike
+ * jsondec_string(), whose result may feed strtod()). */
+static upb_StringView jsondec_name(jsondec* d) {
+  jsondec_skipws(d);
+
+  if (d->ptr == d->end || *d->ptr != '"') jsondec_err(d, "Expected string");
+
+  const char* start = d->ptr + 1;
+  const char* special = jsondec_scanstring(start, d->end);
+  if (special < d->end && *special == '"') {
+    d->ptr = special + 1;
+    upb_StringView ret;
+    ret.data = start;
+    ret.size = special - start;
+    return ret;
+  }
+
+  /* Escape, control byte or EOF: take the copying path (which reports the
+   * precise error for the latter two). */
+  return jsondec_string(d);
+}
+
 static void jsondec_skipval(jsondec* d) {
   switch (jsondec_peek(d)) {
     case JD_OBJECT:
       jsondec_objstart(d);
       while (jsondec_objnext(d)) {
-        jsondec_string(d);
+        jsondec_name(d);
         jsondec_entrysep(d);
         jsondec_skipval(d);
       }
@@ -887,7 +1036,7 @@ static void jsondec_field(jsondec* d, upb_Message* msg,
   const upb_FieldDef* f;
   const upb_FieldDef* preserved;
 
-  name = jsondec_string(d);
+  name = jsondec_name(d);
   jsondec_entrysep(d);
 
   if (name.size >= 2 && name.data[0] == '[' &&
@@ -922,7 +1071,11 @@ static void jsondec_field(jsondec* d, upb_Message* msg,
 
   if (upb_FieldDef_RealContainingOneof(f) &&
       upb_Message_WhichOneof(msg, upb_FieldDef_ContainingOneof(f))) {
-    jsondec_err(d, "More than one field for this oneof.");
+    // When merging into existing state a oneof may legitimately already have
+    // a member set; the new value replaces it, as in binary decoding.
+    if (!(d->options & upb_JsonDecode_Merge)) {
+      jsondec_err(d, "More than one field for this oneof.");
+    }
   }
 
   preserved = d->debug_field;
@@ -1473,5 +1626,264 @@ bool upb_JsonDecode(const char* buf, size_t size, upb_Message* msg,
   d.debug_field = NULL;
   d.is_first = false;
 
-  return upb_JsonDecoder_Decode(&d, msg, m);
+  UPB_PROFILE_BEGIN(profile_start);
+  bool ok = upb_JsonDecoder_Decode(&d, msg, m);
+  UPB_PROFILE_END(profile_start, kUpb_ProfileSubsystem_JsonDecode);
+  return ok;
+}
+
+/* Streaming (push) decode ***************************************************/
+
+typedef enum {
+  kUpb_JsonScan_Value,   /* Outside any string literal. */
+  kUpb_JsonScan_String,  /* Inside a string literal. */
+  kUpb_JsonScan_Escape,  /* Inside a string literal, after a backslash. */
+} upb_JsonScanState;
+
+struct upb_JsonDecoder {
+  const upb_MessageDef* m;
+  const upb_DefPool* symtab;
+  int options;
+  upb_JsonDecodeHandler* handler;
+  void* closure;
+
+  /* Resumable scanner state, carried across chunk boundaries. */
+  upb_JsonScanState scan;
+  int depth;        /* Brace/bracket nesting within the current value. */
+  bool in_value;    /* Inside a top-level value. */
+  bool in_scalar;   /* The current value is unquoted (number/true/false/null),
+                       terminated only by a delimiter or EOF. */
+  bool array_mode;  /* The stream is one top-level array of values. */
+  bool saw_first;   /* Consumed the first non-whitespace byte. */
+  bool done;        /* Saw the top-level array's closing bracket. */
+  bool failed;
+
+  /* Bytes of the (single) value currently spanning chunk boundaries. */
+  char* buf;
+  size_t size;
+  size_t cap;
+};
+
+upb_JsonDecoder* upb_JsonDecoder_New(const upb_MessageDef* m,
+                                     const upb_DefPool* symtab, int options,
+                                     upb_JsonDecodeHandler* handler,
+                                     void* closure) {
+  upb_JsonDecoder* d = upb_gmalloc(sizeof(*d));
+  if (!d) return NULL;
+  memset(d, 0, sizeof(*d));
+  d->m = m;
+  d->symtab = symtab;
+  d->options = options;
+  d->handler = handler;
+  d->closure = closure;
+  return d;
+}
+
+void upb_JsonDecoder_Free(upb_JsonDecoder* d) {
+  if (!d) return;
+  upb_gfree(d->buf);
+  upb_gfree(d);
+}
+
+static bool upb_JsonDecoder_Fail(upb_JsonDecoder* d, upb_Status* status,
+                                 const char* msg) {
+  d->failed = true;
+  upb_Status_SetErrorMessage(status, msg);
+  return false;
+}
+
+static bool upb_JsonDecoder_Append(upb_JsonDecoder* d, const char* data,
+                                   size_t size, upb_Status* status) {
+  if (size == 0) return true;
+  if (d->cap - d->size < size) {
+    size_t cap = UPB_MAX(d->cap, 128);
+    while (cap - d->size < size) cap *= 2;
+    char* buf = upb_grealloc(d->buf, d->cap, cap);
+    if (!buf) return upb_JsonDecoder_Fail(d, status, "Out of memory");
+    d->buf = buf;
+    d->cap = cap;
+  }
+  memcpy(d->buf + d->size, data, size);
+  d->size += size;
+  return true;
+}
+
+/* Decodes one complete value and hands the message to the handler.  The
+ * message lives on a per-value arena so that memory use stays bounded by a
+ * single record. */
+static bool upb_JsonDecoder_EmitValue(upb_JsonDecoder* d, const char* data,
+                                      size_t size, upb_Status* status) {
+  upb_Arena* arena = upb_Arena_New();
+  if (!arena) return upb_JsonDecoder_Fail(d, status, "Out of memory");
+
+  upb_Message* msg = upb_Message_New(upb_MessageDef_MiniTable(d->m), arena);
+  bool ok =
+      msg && upb_JsonDecode(data, size, msg, d->m, d->symtab, d->options,
+                            arena, status);
+  if (!ok) {
+    d->failed = true;
+  } else if (!d->handler(d->closure, msg, arena)) {
+    ok = upb_JsonDecoder_Fail(d, status, "Decoding aborted by handler");
+  }
+  upb_Arena_Free(arena);
+  return ok;
+}
+
+/* Finishes the value spanning [value_start, value_end) of the current chunk,
+ * prepending any bytes buffered from earlier chunks. */
+static bool upb_JsonDecoder_FinishValue(upb_JsonDecoder* d,
+                                        const char* value_start,
+                                        const char* value_end,
+                                        upb_Status* status) {
+  d->in_value = false;
+  if (d->size) {
+    if (!upb_JsonDecoder_Append(d, value_start, value_end - value_start,
+                                status)) {
+      return false;
+    }
+    const bool ok = upb_JsonDecoder_EmitValue(d, d->buf, d->size, status);
+    d->size = 0;
+    return ok;
+  }
+  return upb_JsonDecoder_EmitValue(d, value_start, value_end - value_start,
+                                   status);
+}
+
+bool upb_JsonDecoder_Push(upb_JsonDecoder* d, const char* buf, size_t size,
+                          upb_Status* status) {
+  if (d->failed) return false;
+
+  const char* ptr = buf;
+  const char* end = buf + size;
+  /* If a value began in an earlier chunk, this chunk continues it. */
+  const char* value_start = d->in_value ? ptr : NULL;
+
+  while (ptr < end) {
+    const char ch = *ptr;
+
+    if (!d->in_value) {
+      /* Between values: skip whitespace and stream structure. */
+      if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n') {
+        ptr++;
+        continue;
+      }
+      if (d->done) {
+        return upb_JsonDecoder_Fail(d, status,
+                                    "Trailing data after top-level array");
+      }
+      if (!d->saw_first) {
+        d->saw_first = true;
+        if (ch == '[') {
+          d->array_mode = true;
+          ptr++;
+          continue;
+        }
+      }
+      if (d->array_mode && ch == ',') {
+        ptr++;
+        continue;
+      }
+      if (d->array_mode && ch == ']') {
+        d->done = true;
+        ptr++;
+        continue;
+      }
+      d->in_value = true;
+      d->scan = kUpb_JsonScan_Value;
+      d->depth = 0;
+      d->in_scalar = false;
+      value_start = ptr;
+      /* Fall through to scan this byte as part of the value. */
+    }
+
+    switch (d->scan) {
+      case kUpb_JsonScan_String:
+        if (ch == '\\') {
+          d->scan = kUpb_JsonScan_Escape;
+        } else if (ch == '"') {
+          d->scan = kUpb_JsonScan_Value;
+          if (d->depth == 0) {
+            /* A bare string value ends at its closing quote. */
+            if (!upb_JsonDecoder_FinishValue(d, value_start, ptr + 1, status)) {
+              return false;
+            }
+          }
+        }
+        ptr++;
+        break;
+      case kUpb_JsonScan_Escape:
+        d->scan = kUpb_JsonScan_String;
+        ptr++;
+        break;
+      case kUpb_JsonScan_Value:
+        if (d->in_scalar) {
+          if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' ||
+              ch == ',' || ch == ']' || ch == '}') {
+            /* The delimiter is not part of the value; leave it unconsumed. */
+            if (!upb_JsonDecoder_FinishValue(d, value_start, ptr, status)) {
+              return false;
+            }
+          } else {
+            ptr++;
+          }
+          break;
+        }
+        switch (ch) {
+          case '{':
+          case '[':
+            d->depth++;
+            ptr++;
+            break;
+          case '}':
+          case ']':
+            if (--d->depth < 0) {
+              return upb_JsonDecoder_Fail(d, status, "Unbalanced JSON value");
+            }
+            ptr++;
+            if (d->depth == 0 &&
+                !upb_JsonDecoder_FinishValue(d, value_start, ptr, status)) {
+              return false;
+            }
+            break;
+          case '"':
+            d->scan = kUpb_JsonScan_String;
+            ptr++;
+            break;
+          default:
+            if (d->depth == 0) d->in_scalar = true;
+            ptr++;
+            break;
+        }
+        break;
+    }
+  }
+
+  /* Buffer the partial value, if any, until the next chunk. */
+  if (d->in_value) {
+    return upb_JsonDecoder_Append(d, value_start, end - value_start, status);
+  }
+  return true;
+}
+
+bool upb_JsonDecoder_Finish(upb_JsonDecoder* d, upb_Status* status) {
+  if (d->failed) return false;
+
+  if (d->in_value) {
+    if (d->in_scalar && d->scan == kUpb_JsonScan_Value && d->depth == 0) {
+      /* EOF terminates a top-level scalar. */
+      const bool ok = upb_JsonDecoder_EmitValue(d, d->buf, d->size, status);
+      d->in_value = false;
+      d->size = 0;
+      if (!ok) return false;
+    } else {
+      return upb_JsonDecoder_Fail(d, status, "Unexpected end of JSON input");
+    }
+  }
+  if (d->array_mode && !d->done) {
+    return upb_JsonDecoder_Fail(d, status, "Unexpected end of JSON input");
+  }
+  if (!d->saw_first) {
+    return upb_JsonDecoder_Fail(d, status, "Empty JSON input");
+  }
+  return true;
 }
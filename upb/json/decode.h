@@ -37,12 +37,58 @@
 extern "C" {
 #endif
 
-enum { upb_JsonDecode_IgnoreUnknown = 1 };
+enum {
+  upb_JsonDecode_IgnoreUnknown = 1,
+
+  // Decode into |msg|'s existing state with the same field-level semantics
+  // as upb_Decode(): scalars overwrite, sub-messages merge recursively,
+  // repeated fields append, map entries insert-or-replace by key, and
+  // setting any member of a oneof replaces whichever member was set before
+  // (without this flag a oneof that already has a member set is a decode
+  // error, which makes patching stateful messages impossible).  Existing
+  // array and map storage is reused, so a patch loop that wants replace
+  // rather than merge semantics can call upb_Message_ClearAndRecycle()
+  // between patches and keep its container capacity across iterations.
+  upb_JsonDecode_Merge = 2,
+};
 
 bool upb_JsonDecode(const char* buf, size_t size, upb_Message* msg,
                     const upb_MessageDef* m, const upb_DefPool* symtab,
                     int options, upb_Arena* arena, upb_Status* status);
 
+// Streaming decode, for JSON that arrives in chunks.  The decoder splits the
+// input into complete top-level values with a small resumable scanner (only
+// string/escape/nesting state is carried across chunk boundaries) and decodes
+// each complete value with upb_JsonDecode(), so memory use is bounded by the
+// largest single value rather than the whole stream.  The input may be one
+// JSON object, a whitespace-delimited sequence of objects (e.g. JSON Lines),
+// or one top-level array whose elements are the objects to decode.
+
+typedef struct upb_JsonDecoder upb_JsonDecoder;
+
+// Called once per decoded message.  |msg| and everything it references live
+// on |arena|, which is freed when the handler returns; copy out anything that
+// must outlive the call.  Return false to abort decoding.
+typedef bool upb_JsonDecodeHandler(void* closure, upb_Message* msg,
+                                   upb_Arena* arena);
+
+upb_JsonDecoder* upb_JsonDecoder_New(const upb_MessageDef* m,
+                                     const upb_DefPool* symtab, int options,
+                                     upb_JsonDecodeHandler* handler,
+                                     void* closure);
+
+// Feeds the next chunk of input; |handler| is invoked for each value that
+// completes.  Returns false (with |status| set) on parse errors, decode
+// errors, or after the handler aborts; the decoder accepts no further input
+// once it has failed.
+bool upb_JsonDecoder_Push(upb_JsonDecoder* d, const char* buf, size_t size,
+                          upb_Status* status);
+
+// Signals end of input, flushing any value that only EOF could terminate.
+bool upb_JsonDecoder_Finish(upb_JsonDecoder* d, upb_Status* status);
+
+void upb_JsonDecoder_Free(upb_JsonDecoder* d);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -36,10 +36,23 @@
 
 #include "upb/collections/map.h"
 #include "upb/lex/round_trip.h"
+#include "upb/port/cpu_dispatch.h"
 #include "upb/port/vsnprintf_compat.h"
 #include "upb/reflection/message.h"
 #include "upb/wire/decode.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && \
+    !defined(UPB_FORCE_BASELINE)
+#include <immintrin.h>
+#define UPB_JSONENC_AVX2 1
+#endif
+
 // Must be last.
 #include "upb/port/def.inc"
 
@@ -271,11 +284,113 @@ static void jsonenc_bytes(jsonenc* e, upb_StringView str) {
   jsonenc_putstr(e, "\"");
 }
 
+/* Returns a pointer to the first byte in [ptr, end) that needs escaping in a
+ * JSON string (quote, backslash, or a control byte), or |end| if there is
+ * none.  The mirror image of jsondec_scanstring() in decode.c: scans with
+ * 16-byte compares where available so that clean spans can be bulk-copied. */
+static const char* jsonenc_scanstring(const char* ptr, const char* end) {
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+  while (end - ptr >= 16) {
+    const __m128i data = _mm_loadu_si128((const __m128i*)ptr);
+    const __m128i quote = _mm_cmpeq_epi8(data, _mm_set1_epi8('"'));
+    const __m128i bslash = _mm_cmpeq_epi8(data, _mm_set1_epi8('\\'));
+    const __m128i ctrl =
+        _mm_cmpeq_epi8(_mm_min_epu8(data, _mm_set1_epi8(0x1f)), data);
+    const int mask =
+        _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(quote, bslash), ctrl));
+    if (mask != 0) return ptr + __builtin_ctz(mask);
+    ptr += 16;
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  while (end - ptr >= 16) {
+    const uint8x16_t data = vld1q_u8((const uint8_t*)ptr);
+    const uint8x16_t special =
+        vorrq_u8(vorrq_u8(vceqq_u8(data, vdupq_n_u8('"')),
+                          vceqq_u8(data, vdupq_n_u8('\\'))),
+                 vcltq_u8(data, vdupq_n_u8(0x20)));
+    if (vmaxvq_u8(special) != 0) break; /* Locate it in the tail loop. */
+    ptr += 16;
+  }
+#endif
+
+  /* Check 8 bytes at a time; the classic SWAR "zero byte" and "byte < N"
+   * tests light up the high bit of each matching lane. */
+  while (end - ptr >= 8) {
+    uint64_t word;
+    memcpy(&word, ptr, 8);
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    const uint64_t q = word ^ (ones * '"');
+    const uint64_t b = word ^ (ones * '\\');
+    const uint64_t special =
+        ((q - ones) & ~q) | ((b - ones) & ~b) | ((word - ones * 0x20) & ~word);
+    if (special & highs) break;
+    ptr += 8;
+  }
+
+  while (ptr < end) {
+    const uint8_t ch = (uint8_t)*ptr;
+    if (ch == '"' || ch == '\\' || ch < 0x20) break;
+    ptr++;
+  }
+  return ptr;
+}
+
+#ifdef UPB_JSONENC_AVX2
+
+/* 32-bytes-at-a-time variant of jsonenc_scanstring(), compiled for AVX2 and
+ * selected at run time (see cpu_dispatch.h); the baseline binary still runs
+ * on any x86-64. */
+__attribute__((target("avx2"))) static const char* jsonenc_scanstring_avx2(
+    const char* ptr, const char* end) {
+  while (end - ptr >= 32) {
+    const __m256i data = _mm256_loadu_si256((const __m256i*)ptr);
+    const __m256i quote = _mm256_cmpeq_epi8(data, _mm256_set1_epi8('"'));
+    const __m256i bslash = _mm256_cmpeq_epi8(data, _mm256_set1_epi8('\\'));
+    const __m256i ctrl =
+        _mm256_cmpeq_epi8(_mm256_min_epu8(data, _mm256_set1_epi8(0x1f)), data);
+    const unsigned mask = _mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_or_si256(quote, bslash), ctrl));
+    if (mask != 0) return ptr + __builtin_ctz(mask);
+    ptr += 32;
+  }
+  return jsonenc_scanstring(ptr, end);
+}
+
+typedef const char* jsonenc_scanstring_fn(const char* ptr, const char* end);
+
+static jsonenc_scanstring_fn* jsonenc_scanstring_impl;  // NULL = unresolved.
+
+static const char* jsonenc_scanstring_dispatch(const char* ptr,
+                                               const char* end) {
+  jsonenc_scanstring_fn* fn = jsonenc_scanstring_impl;
+  if (UPB_UNLIKELY(fn == NULL)) {
+    fn = upb_CpuDispatch_Has(kUpb_CpuFeature_X86_Avx2) ? &jsonenc_scanstring_avx2
+                                                       : &jsonenc_scanstring;
+    jsonenc_scanstring_impl = fn;  // Idempotent; benign race.
+  }
+  return fn(ptr, end);
+}
+
+#else
+
+#define jsonenc_scanstring_dispatch jsonenc_scanstring
+
+#endif /* UPB_JSONENC_AVX2 */
+
 static void jsonenc_stringbody(jsonenc* e, upb_StringView str) {
   const char* ptr = str.data;
   const char* end = UPB_PTRADD(ptr, str.size);
 
   while (ptr < end) {
+    /* Bulk-copy the run of bytes that need no escaping.  Non-ASCII bytes
+     * pass through unchanged; we rely on the string being valid UTF-8. */
+    const char* clean_end = jsonenc_scanstring_dispatch(ptr, end);
+    if (clean_end != ptr) {
+      jsonenc_putbytes(e, ptr, clean_end - ptr);
+      ptr = clean_end;
+      if (ptr == end) break;
+    }
     switch (*ptr) {
       case '\n':
         jsonenc_putstr(e, "\\n");
@@ -299,13 +414,10 @@ static void jsonenc_stringbody(jsonenc* e, upb_StringView str) {
         jsonenc_putstr(e, "\\\\");
         break;
       default:
-        if ((uint8_t)*ptr < 0x20) {
-          jsonenc_printf(e, "\\u%04x", (int)(uint8_t)*ptr);
-        } else {
-          /* This could be a non-ASCII byte.  We rely on the string being valid
-           * UTF-8. */
-          jsonenc_putbytes(e, ptr, 1);
-        }
+        /* jsonenc_scanstring() only stops on quote, backslash, or control
+         * bytes, and the quote and backslash have their own cases above. */
+        UPB_ASSERT((uint8_t)*ptr < 0x20);
+        jsonenc_printf(e, "\\u%04x", (int)(uint8_t)*ptr);
         break;
     }
     ptr++;
@@ -0,0 +1,2906 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Streaming wire-format -> JSON transcoder.  The emitter half mirrors
+ * encode.c; the value half reads the wire bytes directly instead of a
+ * upb_Message.  JSON needs each field emitted exactly once (one array per
+ * repeated field, one object per map, last-wins for scalars and oneofs),
+ * while the wire format permits interleaved and duplicated fields, so the
+ * transcoder re-scans the bytes of the current (sub)message where needed:
+ * a scalar occurrence is emitted only if no later occurrence supersedes it,
+ * and a repeated/map field is gathered into one array/object at its first
+ * occurrence.  Serializers emit each field contiguously and exactly once,
+ * so in practice every byte is visited O(1) times.
+ *
+ * The readers below are bounds-checked against the region being walked
+ * rather than built on upb_WireReader's slop-byte contract, because the
+ * re-scans above revisit arbitrary subranges of the input. */
+
+#include "upb/json/transcode.h"
+
+#include <errno.h>
+#include <float.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "upb/lex/atoi.h"
+#include "upb/lex/round_trip.h"
+#include "upb/lex/strtod.h"
+#include "upb/lex/unicode.h"
+#include "upb/mem/alloc.h"
+#include "upb/port/vsnprintf_compat.h"
+#include "upb/wire/common.h"
+#include "upb/wire/swap_internal.h"
+#include "upb/wire/types.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+typedef struct {
+  char *buf, *ptr, *end;
+  size_t overflow;
+  int options;
+  const upb_DefPool* ext_pool;
+  int depth;  // Remaining recursion budget for nested messages.
+  jmp_buf err;
+  upb_Status* status;
+} jsontx;
+
+static void jsontx_msgfields(jsontx* t, const char* ptr, const char* end,
+                             const upb_MessageDef* m, bool first);
+static void jsontx_msgvalue(jsontx* t, const char* ptr, const char* end,
+                            const upb_MessageDef* m);
+static void jsontx_scalarval(jsontx* t, upb_MessageValue val,
+                             const upb_FieldDef* f);
+
+UPB_NORETURN static void jsontx_err(jsontx* t, const char* msg) {
+  upb_Status_SetErrorMessage(t->status, msg);
+  longjmp(t->err, 1);
+}
+
+UPB_PRINTF(2, 3)
+UPB_NORETURN static void jsontx_errf(jsontx* t, const char* fmt, ...) {
+  va_list argp;
+  va_start(argp, fmt);
+  upb_Status_VSetErrorFormat(t->status, fmt, argp);
+  va_end(argp);
+  longjmp(t->err, 1);
+}
+
+/* Output emission, as in encode.c. ************************************/
+
+static void jsontx_putbytes(jsontx* t, const void* data, size_t len) {
+  size_t have = t->end - t->ptr;
+  if (UPB_LIKELY(have >= len)) {
+    memcpy(t->ptr, data, len);
+    t->ptr += len;
+  } else {
+    if (have) {
+      memcpy(t->ptr, data, have);
+      t->ptr += have;
+    }
+    t->overflow += (len - have);
+  }
+}
+
+static void jsontx_putstr(jsontx* t, const char* str) {
+  jsontx_putbytes(t, str, strlen(str));
+}
+
+UPB_PRINTF(2, 3)
+static void jsontx_printf(jsontx* t, const char* fmt, ...) {
+  size_t n;
+  size_t have = t->end - t->ptr;
+  va_list args;
+
+  va_start(args, fmt);
+  n = _upb_vsnprintf(t->ptr, have, fmt, args);
+  va_end(args);
+
+  if (UPB_LIKELY(have > n)) {
+    t->ptr += n;
+  } else {
+    t->ptr = UPB_PTRADD(t->ptr, have);
+    t->overflow += (n - have);
+  }
+}
+
+static void jsontx_putsep(jsontx* t, const char* str, bool* first) {
+  if (*first) {
+    *first = false;
+  } else {
+    jsontx_putstr(t, str);
+  }
+}
+
+/* Wire readers, bounds-checked against [ptr, end). *********************/
+
+static const char* jsontx_varint(jsontx* t, const char* ptr, const char* end,
+                                 uint64_t* val) {
+  uint64_t result = 0;
+  int shift = 0;
+  for (;;) {
+    if (ptr == end || shift >= 70) jsontx_err(t, "malformed varint");
+    const uint8_t byte = (uint8_t)*ptr++;
+    result |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      *val = result;
+      return ptr;
+    }
+    shift += 7;
+  }
+}
+
+static const char* jsontx_tag(jsontx* t, const char* ptr, const char* end,
+                              uint32_t* tag) {
+  uint64_t val;
+  ptr = jsontx_varint(t, ptr, end, &val);
+  if (val > UINT32_MAX || (val >> 3) == 0) jsontx_err(t, "malformed tag");
+  *tag = (uint32_t)val;
+  return ptr;
+}
+
+UPB_INLINE uint32_t jsontx_fieldnum(uint32_t tag) { return tag >> 3; }
+UPB_INLINE uint32_t jsontx_wtype(uint32_t tag) { return tag & 7; }
+
+static const char* jsontx_delimited(jsontx* t, const char* ptr,
+                                    const char* end, int* size) {
+  uint64_t val;
+  ptr = jsontx_varint(t, ptr, end, &val);
+  if (val >= INT32_MAX || (uint64_t)(end - ptr) < val) {
+    jsontx_err(t, "truncated delimited field");
+  }
+  *size = (int)val;
+  return ptr;
+}
+
+static const char* jsontx_fixed32(jsontx* t, const char* ptr, const char* end,
+                                  uint32_t* val) {
+  if (end - ptr < 4) jsontx_err(t, "truncated fixed32 field");
+  memcpy(val, ptr, 4);
+  *val = _upb_BigEndian_Swap32(*val);
+  return ptr + 4;
+}
+
+static const char* jsontx_fixed64(jsontx* t, const char* ptr, const char* end,
+                                  uint64_t* val) {
+  if (end - ptr < 8) jsontx_err(t, "truncated fixed64 field");
+  memcpy(val, ptr, 8);
+  *val = _upb_BigEndian_Swap64(*val);
+  return ptr + 8;
+}
+
+static const char* jsontx_skipval(jsontx* t, const char* ptr, const char* end,
+                                  uint32_t tag, int depth) {
+  switch (jsontx_wtype(tag)) {
+    case kUpb_WireType_Varint: {
+      uint64_t val;
+      return jsontx_varint(t, ptr, end, &val);
+    }
+    case kUpb_WireType_32Bit: {
+      uint32_t val;
+      return jsontx_fixed32(t, ptr, end, &val);
+    }
+    case kUpb_WireType_64Bit: {
+      uint64_t val;
+      return jsontx_fixed64(t, ptr, end, &val);
+    }
+    case kUpb_WireType_Delimited: {
+      int size;
+      ptr = jsontx_delimited(t, ptr, end, &size);
+      return ptr + size;
+    }
+    case kUpb_WireType_StartGroup: {
+      if (depth == 0) jsontx_err(t, "max depth exceeded");
+      for (;;) {
+        uint32_t inner;
+        if (ptr == end) jsontx_err(t, "unterminated group");
+        ptr = jsontx_tag(t, ptr, end, &inner);
+        if (jsontx_wtype(inner) == kUpb_WireType_EndGroup) {
+          if (jsontx_fieldnum(inner) != jsontx_fieldnum(tag)) {
+            jsontx_err(t, "mismatched end-group tag");
+          }
+          return ptr;
+        }
+        ptr = jsontx_skipval(t, ptr, end, inner, depth - 1);
+      }
+    }
+    default:
+      jsontx_err(t, "invalid wire type");
+  }
+}
+
+// Returns a pointer past the matching end-group tag for a group whose
+// start tag was |tag|; *interior_end is set to the start of that end tag
+// (i.e. one past the group's last interior byte).
+static const char* jsontx_groupend(jsontx* t, const char* ptr, const char* end,
+                                   uint32_t tag, const char** interior_end) {
+  for (;;) {
+    uint32_t inner;
+    if (ptr == end) jsontx_err(t, "unterminated group");
+    const char* tag_start = ptr;
+    ptr = jsontx_tag(t, ptr, end, &inner);
+    if (jsontx_wtype(inner) == kUpb_WireType_EndGroup) {
+      if (jsontx_fieldnum(inner) != jsontx_fieldnum(tag)) {
+        jsontx_err(t, "mismatched end-group tag");
+      }
+      *interior_end = tag_start;
+      return ptr;
+    }
+    ptr = jsontx_skipval(t, ptr, end, inner,
+                         kUpb_WireFormat_DefaultDepthLimit);
+  }
+}
+
+/* Field/wire-type correspondence. **************************************/
+
+static uint32_t jsontx_wiretype(const upb_FieldDef* f) {
+  switch (upb_FieldDef_Type(f)) {
+    case kUpb_FieldType_Int64:
+    case kUpb_FieldType_UInt64:
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_UInt32:
+    case kUpb_FieldType_SInt32:
+    case kUpb_FieldType_SInt64:
+    case kUpb_FieldType_Bool:
+    case kUpb_FieldType_Enum:
+      return kUpb_WireType_Varint;
+    case kUpb_FieldType_Fixed32:
+    case kUpb_FieldType_SFixed32:
+    case kUpb_FieldType_Float:
+      return kUpb_WireType_32Bit;
+    case kUpb_FieldType_Fixed64:
+    case kUpb_FieldType_SFixed64:
+    case kUpb_FieldType_Double:
+      return kUpb_WireType_64Bit;
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes:
+    case kUpb_FieldType_Message:
+      return kUpb_WireType_Delimited;
+    case kUpb_FieldType_Group:
+      return kUpb_WireType_StartGroup;
+  }
+  UPB_UNREACHABLE();
+}
+
+static bool jsontx_ispackable(const upb_FieldDef* f) {
+  return !upb_FieldDef_IsString(f) && !upb_FieldDef_IsSubMessage(f);
+}
+
+// Whether a wire occurrence with type |wt| carries data for |f| (the same
+// test the decoder applies; anything else is unknown-field data and is
+// skipped, exactly as upb_JsonEncode() omits unknown fields).
+static bool jsontx_accepts(const upb_FieldDef* f, uint32_t wt) {
+  if (wt == jsontx_wiretype(f)) return true;
+  return upb_FieldDef_IsRepeated(f) && wt == kUpb_WireType_Delimited &&
+         jsontx_ispackable(f);
+}
+
+/* Leaf value decoding and emission. ************************************/
+
+static const char* jsontx_readscalar(jsontx* t, const char* ptr,
+                                     const char* end, const upb_FieldDef* f,
+                                     upb_MessageValue* val) {
+  uint64_t v;
+  uint32_t v32;
+  switch (upb_FieldDef_Type(f)) {
+    case kUpb_FieldType_Bool:
+      ptr = jsontx_varint(t, ptr, end, &v);
+      val->bool_val = (v != 0);
+      return ptr;
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_Enum:
+      ptr = jsontx_varint(t, ptr, end, &v);
+      val->int32_val = (int32_t)v;
+      return ptr;
+    case kUpb_FieldType_UInt32:
+      ptr = jsontx_varint(t, ptr, end, &v);
+      val->uint32_val = (uint32_t)v;
+      return ptr;
+    case kUpb_FieldType_Int64:
+      ptr = jsontx_varint(t, ptr, end, &v);
+      val->int64_val = (int64_t)v;
+      return ptr;
+    case kUpb_FieldType_UInt64:
+      ptr = jsontx_varint(t, ptr, end, &v);
+      val->uint64_val = v;
+      return ptr;
+    case kUpb_FieldType_SInt32:
+      ptr = jsontx_varint(t, ptr, end, &v);
+      val->int32_val = (int32_t)((uint32_t)v >> 1) ^ -(int32_t)(v & 1);
+      return ptr;
+    case kUpb_FieldType_SInt64:
+      ptr = jsontx_varint(t, ptr, end, &v);
+      val->int64_val = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+      return ptr;
+    case kUpb_FieldType_Fixed32:
+      ptr = jsontx_fixed32(t, ptr, end, &v32);
+      val->uint32_val = v32;
+      return ptr;
+    case kUpb_FieldType_SFixed32:
+      ptr = jsontx_fixed32(t, ptr, end, &v32);
+      memcpy(&val->int32_val, &v32, 4);
+      return ptr;
+    case kUpb_FieldType_Float:
+      ptr = jsontx_fixed32(t, ptr, end, &v32);
+      memcpy(&val->float_val, &v32, 4);
+      return ptr;
+    case kUpb_FieldType_Fixed64:
+      ptr = jsontx_fixed64(t, ptr, end, &v);
+      val->uint64_val = v;
+      return ptr;
+    case kUpb_FieldType_SFixed64:
+      ptr = jsontx_fixed64(t, ptr, end, &v);
+      memcpy(&val->int64_val, &v, 8);
+      return ptr;
+    case kUpb_FieldType_Double:
+      ptr = jsontx_fixed64(t, ptr, end, &v);
+      memcpy(&val->double_val, &v, 8);
+      return ptr;
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes: {
+      int size;
+      ptr = jsontx_delimited(t, ptr, end, &size);
+      val->str_val.data = ptr;
+      val->str_val.size = size;
+      return ptr + size;
+    }
+    case kUpb_FieldType_Message:
+    case kUpb_FieldType_Group:
+      break;
+  }
+  UPB_UNREACHABLE();
+}
+
+static void jsontx_stringbody(jsontx* t, upb_StringView str) {
+  const char* ptr = str.data;
+  const char* end = UPB_PTRADD(ptr, str.size);
+
+  while (ptr < end) {
+    switch (*ptr) {
+      case '\n':
+        jsontx_putstr(t, "\\n");
+        break;
+      case '\r':
+        jsontx_putstr(t, "\\r");
+        break;
+      case '\t':
+        jsontx_putstr(t, "\\t");
+        break;
+      case '\"':
+        jsontx_putstr(t, "\\\"");
+        break;
+      case '\f':
+        jsontx_putstr(t, "\\f");
+        break;
+      case '\b':
+        jsontx_putstr(t, "\\b");
+        break;
+      case '\\':
+        jsontx_putstr(t, "\\\\");
+        break;
+      default:
+        if ((uint8_t)*ptr < 0x20) {
+          jsontx_printf(t, "\\u%04x", (int)(uint8_t)*ptr);
+        } else {
+          /* This could be a non-ASCII byte.  We rely on the string being
+           * valid UTF-8. */
+          jsontx_putbytes(t, ptr, 1);
+        }
+        break;
+    }
+    ptr++;
+  }
+}
+
+static void jsontx_string(jsontx* t, upb_StringView str) {
+  jsontx_putstr(t, "\"");
+  jsontx_stringbody(t, str);
+  jsontx_putstr(t, "\"");
+}
+
+static void jsontx_bytes(jsontx* t, upb_StringView str) {
+  /* This is the regular base64, not the "web-safe" version. */
+  static const char base64[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  const unsigned char* ptr = (unsigned char*)str.data;
+  const unsigned char* end = UPB_PTRADD(ptr, str.size);
+  char buf[4];
+
+  jsontx_putstr(t, "\"");
+
+  while (end - ptr >= 3) {
+    buf[0] = base64[ptr[0] >> 2];
+    buf[1] = base64[((ptr[0] & 0x3) << 4) | (ptr[1] >> 4)];
+    buf[2] = base64[((ptr[1] & 0xf) << 2) | (ptr[2] >> 6)];
+    buf[3] = base64[ptr[2] & 0x3f];
+    jsontx_putbytes(t, buf, 4);
+    ptr += 3;
+  }
+
+  switch (end - ptr) {
+    case 2:
+      buf[0] = base64[ptr[0] >> 2];
+      buf[1] = base64[((ptr[0] & 0x3) << 4) | (ptr[1] >> 4)];
+      buf[2] = base64[(ptr[1] & 0xf) << 2];
+      buf[3] = '=';
+      jsontx_putbytes(t, buf, 4);
+      break;
+    case 1:
+      buf[0] = base64[ptr[0] >> 2];
+      buf[1] = base64[((ptr[0] & 0x3) << 4)];
+      buf[2] = '=';
+      buf[3] = '=';
+      jsontx_putbytes(t, buf, 4);
+      break;
+  }
+
+  jsontx_putstr(t, "\"");
+}
+
+static bool jsontx_specialdouble(jsontx* t, double val) {
+  if (val == INFINITY) {
+    jsontx_putstr(t, "\"Infinity\"");
+  } else if (val == -INFINITY) {
+    jsontx_putstr(t, "\"-Infinity\"");
+  } else if (val != val) {
+    jsontx_putstr(t, "\"NaN\"");
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static void jsontx_double(jsontx* t, double val) {
+  if (jsontx_specialdouble(t, val)) return;
+  char buf[32];
+  _upb_EncodeRoundTripDouble(val, buf, sizeof(buf));
+  jsontx_putstr(t, buf);
+}
+
+static void jsontx_float(jsontx* t, float val) {
+  if (jsontx_specialdouble(t, val)) return;
+  char buf[32];
+  _upb_EncodeRoundTripFloat(val, buf, sizeof(buf));
+  jsontx_putstr(t, buf);
+}
+
+static void jsontx_enum(jsontx* t, int32_t val, const upb_FieldDef* f) {
+  const upb_EnumDef* e_def = upb_FieldDef_EnumSubDef(f);
+
+  if (strcmp(upb_EnumDef_FullName(e_def), "google.protobuf.NullValue") == 0) {
+    jsontx_putstr(t, "null");
+  } else {
+    const upb_EnumValueDef* ev =
+        (t->options & upb_JsonEncode_FormatEnumsAsIntegers)
+            ? NULL
+            : upb_EnumDef_FindValueByNumber(e_def, val);
+
+    if (ev) {
+      jsontx_printf(t, "\"%s\"", upb_EnumValueDef_Name(ev));
+    } else {
+      jsontx_printf(t, "%" PRId32, val);
+    }
+  }
+}
+
+static void jsontx_scalarval(jsontx* t, upb_MessageValue val,
+                             const upb_FieldDef* f) {
+  switch (upb_FieldDef_CType(f)) {
+    case kUpb_CType_Bool:
+      jsontx_putstr(t, val.bool_val ? "true" : "false");
+      break;
+    case kUpb_CType_Float:
+      jsontx_float(t, val.float_val);
+      break;
+    case kUpb_CType_Double:
+      jsontx_double(t, val.double_val);
+      break;
+    case kUpb_CType_Int32:
+      jsontx_printf(t, "%" PRId32, val.int32_val);
+      break;
+    case kUpb_CType_UInt32:
+      jsontx_printf(t, "%" PRIu32, val.uint32_val);
+      break;
+    case kUpb_CType_Int64:
+      jsontx_printf(t, "\"%" PRId64 "\"", val.int64_val);
+      break;
+    case kUpb_CType_UInt64:
+      jsontx_printf(t, "\"%" PRIu64 "\"", val.uint64_val);
+      break;
+    case kUpb_CType_String:
+      jsontx_string(t, val.str_val);
+      break;
+    case kUpb_CType_Bytes:
+      jsontx_bytes(t, val.str_val);
+      break;
+    case kUpb_CType_Enum:
+      jsontx_enum(t, val.int32_val, f);
+      break;
+    case kUpb_CType_Message:
+      UPB_UNREACHABLE();
+  }
+}
+
+// Emits one element of |f| (including sub-messages and groups) whose value
+// starts at |ptr|; returns a pointer past the value.
+static const char* jsontx_fieldelem(jsontx* t, const char* ptr,
+                                    const char* end, uint32_t wt,
+                                    const upb_FieldDef* f) {
+  if (upb_FieldDef_IsSubMessage(f)) {
+    const upb_MessageDef* sub_m = upb_FieldDef_MessageSubDef(f);
+    if (wt == kUpb_WireType_Delimited) {
+      int size;
+      ptr = jsontx_delimited(t, ptr, end, &size);
+      jsontx_msgvalue(t, ptr, ptr + size, sub_m);
+      return ptr + size;
+    }
+    const uint32_t tag =
+        (upb_FieldDef_Number(f) << 3) | kUpb_WireType_StartGroup;
+    const char* interior_end;
+    const char* after = jsontx_groupend(t, ptr, end, tag, &interior_end);
+    jsontx_msgvalue(t, ptr, interior_end, sub_m);
+    return after;
+  }
+  upb_MessageValue val;
+  ptr = jsontx_readscalar(t, ptr, end, f, &val);
+  jsontx_scalarval(t, val, f);
+  return ptr;
+}
+
+// Whether the occurrence whose value starts at |ptr| would actually be
+// stored by the decoder: an invalid value of a closed enum goes to the
+// unknown-field set instead, so the transcoder must ignore it too.
+static bool jsontx_enumok(jsontx* t, const char* ptr, const char* end,
+                          const upb_FieldDef* f) {
+  if (upb_FieldDef_Type(f) != kUpb_FieldType_Enum) return true;
+  const upb_EnumDef* e = upb_FieldDef_EnumSubDef(f);
+  if (!upb_EnumDef_IsClosed(e)) return true;
+  uint64_t val;
+  jsontx_varint(t, ptr, end, &val);
+  return upb_EnumDef_CheckNumber(e, (int32_t)val);
+}
+
+/* Re-scans for last-wins / gather-once semantics. **********************/
+
+// Returns a pointer to the value of the last occurrence of |field_number|
+// with wire type |wt| in [ptr, end), or NULL if there is none.
+static const char* jsontx_findlast(jsontx* t, const char* ptr, const char* end,
+                                   uint32_t field_number, uint32_t wt) {
+  const char* found = NULL;
+  while (ptr < end) {
+    uint32_t tag;
+    ptr = jsontx_tag(t, ptr, end, &tag);
+    if (jsontx_fieldnum(tag) == field_number && jsontx_wtype(tag) == wt) {
+      found = ptr;
+    }
+    ptr = jsontx_skipval(t, ptr, end, tag, kUpb_WireFormat_DefaultDepthLimit);
+  }
+  return found;
+}
+
+// Whether [ptr, cur) already contains an occurrence of |f|; used so that a
+// repeated field's array is emitted exactly once, at its first occurrence.
+static bool jsontx_seenbefore(jsontx* t, const char* ptr, const char* cur,
+                              const upb_FieldDef* f) {
+  const uint32_t num = upb_FieldDef_Number(f);
+  while (ptr < cur) {
+    uint32_t tag;
+    ptr = jsontx_tag(t, ptr, cur, &tag);
+    if (jsontx_fieldnum(tag) == num && jsontx_accepts(f, jsontx_wtype(tag))) {
+      return true;
+    }
+    ptr = jsontx_skipval(t, ptr, cur, tag, kUpb_WireFormat_DefaultDepthLimit);
+  }
+  return false;
+}
+
+// Whether [ptr, end) contains a later occurrence that supersedes the
+// current one: another occurrence of |f|, or (for a oneof member) of any
+// member of the same oneof -- the decoder keeps only the last one.
+static bool jsontx_haslater(jsontx* t, const char* ptr, const char* end,
+                            const upb_FieldDef* f, const upb_MessageDef* m) {
+  const upb_OneofDef* o = upb_FieldDef_RealContainingOneof(f);
+  const uint32_t num = upb_FieldDef_Number(f);
+  while (ptr < end) {
+    uint32_t tag;
+    ptr = jsontx_tag(t, ptr, end, &tag);
+    if (o) {
+      const upb_FieldDef* g =
+          upb_MessageDef_FindFieldByNumber(m, jsontx_fieldnum(tag));
+      if (g && upb_FieldDef_RealContainingOneof(g) == o &&
+          jsontx_wtype(tag) == jsontx_wiretype(g) &&
+          jsontx_enumok(t, ptr, end, g)) {
+        return true;
+      }
+    } else if (jsontx_fieldnum(tag) == num &&
+               jsontx_wtype(tag) == jsontx_wiretype(f) &&
+               jsontx_enumok(t, ptr, end, f)) {
+      return true;
+    }
+    ptr = jsontx_skipval(t, ptr, end, tag, kUpb_WireFormat_DefaultDepthLimit);
+  }
+  return false;
+}
+
+/* Repeated fields and maps. ********************************************/
+
+// Emits every occurrence of |f| in [ptr, end) as one JSON array, expanding
+// packed runs into individual elements.
+static void jsontx_array(jsontx* t, const char* ptr, const char* end,
+                         const upb_FieldDef* f) {
+  const uint32_t num = upb_FieldDef_Number(f);
+  const uint32_t natural = jsontx_wiretype(f);
+  bool first = true;
+
+  jsontx_putstr(t, "[");
+  while (ptr < end) {
+    uint32_t tag;
+    const char* val = jsontx_tag(t, ptr, end, &tag);
+    const uint32_t wt = jsontx_wtype(tag);
+    if (jsontx_fieldnum(tag) != num || !jsontx_accepts(f, wt)) {
+      ptr = jsontx_skipval(t, val, end, tag,
+                           kUpb_WireFormat_DefaultDepthLimit);
+      continue;
+    }
+    if (wt == kUpb_WireType_Delimited && natural != kUpb_WireType_Delimited) {
+      // A packed run: one element per encoded value.
+      int size;
+      val = jsontx_delimited(t, val, end, &size);
+      const char* packed_end = val + size;
+      while (val < packed_end) {
+        const bool ok = jsontx_enumok(t, val, packed_end, f);
+        upb_MessageValue elem;
+        val = jsontx_readscalar(t, val, packed_end, f, &elem);
+        if (!ok) continue;
+        jsontx_putsep(t, ",", &first);
+        jsontx_scalarval(t, elem, f);
+      }
+      ptr = packed_end;
+    } else if (jsontx_enumok(t, val, end, f)) {
+      jsontx_putsep(t, ",", &first);
+      ptr = jsontx_fieldelem(t, val, end, wt, f);
+    } else {
+      ptr = jsontx_skipval(t, val, end, tag,
+                           kUpb_WireFormat_DefaultDepthLimit);
+    }
+  }
+  jsontx_putstr(t, "]");
+}
+
+typedef struct {
+  upb_MessageValue val;
+  uint64_t num;  // Canonical numeric form, for equality (0 if absent).
+  bool is_str;
+} jsontx_MapKey;
+
+static void jsontx_readmapkey(jsontx* t, const char* ptr, const char* end,
+                              const upb_FieldDef* key_f, jsontx_MapKey* key) {
+  memset(key, 0, sizeof(*key));
+  key->is_str = upb_FieldDef_CType(key_f) == kUpb_CType_String;
+
+  const char* last = jsontx_findlast(t, ptr, end, 1, jsontx_wiretype(key_f));
+  if (last) jsontx_readscalar(t, last, end, key_f, &key->val);
+
+  switch (upb_FieldDef_CType(key_f)) {
+    case kUpb_CType_Bool:
+      key->num = key->val.bool_val;
+      break;
+    case kUpb_CType_Int32:
+      key->num = (uint64_t)(int64_t)key->val.int32_val;
+      break;
+    case kUpb_CType_UInt32:
+      key->num = key->val.uint32_val;
+      break;
+    case kUpb_CType_Int64:
+      key->num = (uint64_t)key->val.int64_val;
+      break;
+    case kUpb_CType_UInt64:
+      key->num = key->val.uint64_val;
+      break;
+    case kUpb_CType_String:
+      break;
+    default:
+      UPB_UNREACHABLE();
+  }
+}
+
+static bool jsontx_keyeq(const jsontx_MapKey* a, const jsontx_MapKey* b) {
+  if (a->is_str) return upb_StringView_IsEqual(a->val.str_val, b->val.str_val);
+  return a->num == b->num;
+}
+
+static void jsontx_mapkey(jsontx* t, const jsontx_MapKey* key,
+                          const upb_FieldDef* key_f) {
+  jsontx_putstr(t, "\"");
+  switch (upb_FieldDef_CType(key_f)) {
+    case kUpb_CType_Bool:
+      jsontx_putstr(t, key->val.bool_val ? "true" : "false");
+      break;
+    case kUpb_CType_Int32:
+      jsontx_printf(t, "%" PRId32, key->val.int32_val);
+      break;
+    case kUpb_CType_UInt32:
+      jsontx_printf(t, "%" PRIu32, key->val.uint32_val);
+      break;
+    case kUpb_CType_Int64:
+      jsontx_printf(t, "%" PRId64, key->val.int64_val);
+      break;
+    case kUpb_CType_UInt64:
+      jsontx_printf(t, "%" PRIu64, key->val.uint64_val);
+      break;
+    case kUpb_CType_String:
+      jsontx_stringbody(t, key->val.str_val);
+      break;
+    default:
+      UPB_UNREACHABLE();
+  }
+  jsontx_putstr(t, "\":");
+}
+
+// Finds the last entry of map field |num| in [ptr, end) whose key equals
+// |key|; returns false if there is none, else sets [*entry, *entry_end) to
+// the contents of the winning entry.
+static bool jsontx_mapfindlast(jsontx* t, const char* ptr, const char* end,
+                               uint32_t num, const upb_FieldDef* key_f,
+                               const jsontx_MapKey* key,
+                               const char** entry_out,
+                               const char** entry_end_out) {
+  bool found = false;
+  while (ptr < end) {
+    uint32_t tag;
+    ptr = jsontx_tag(t, ptr, end, &tag);
+    if (jsontx_fieldnum(tag) == num &&
+        jsontx_wtype(tag) == kUpb_WireType_Delimited) {
+      int size;
+      const char* entry = jsontx_delimited(t, ptr, end, &size);
+      jsontx_MapKey cand;
+      jsontx_readmapkey(t, entry, entry + size, key_f, &cand);
+      if (jsontx_keyeq(key, &cand)) {
+        *entry_out = entry;
+        *entry_end_out = entry + size;
+        found = true;
+      }
+      ptr = entry + size;
+    } else {
+      ptr = jsontx_skipval(t, ptr, end, tag,
+                           kUpb_WireFormat_DefaultDepthLimit);
+    }
+  }
+  return found;
+}
+
+static void jsontx_mapentryval(jsontx* t, const char* entry, const char* end,
+                               const upb_FieldDef* val_f) {
+  const uint32_t wt = jsontx_wiretype(val_f);
+  const char* last = NULL;
+  const char* p = entry;
+  while (p < end) {
+    uint32_t tag;
+    p = jsontx_tag(t, p, end, &tag);
+    if (jsontx_fieldnum(tag) == 2 && jsontx_wtype(tag) == wt &&
+        jsontx_enumok(t, p, end, val_f)) {
+      last = p;
+    }
+    p = jsontx_skipval(t, p, end, tag, kUpb_WireFormat_DefaultDepthLimit);
+  }
+  if (last) {
+    jsontx_fieldelem(t, last, end, wt, val_f);
+  } else if (upb_FieldDef_IsSubMessage(val_f)) {
+    jsontx_msgvalue(t, end, end, upb_FieldDef_MessageSubDef(val_f));
+  } else {
+    upb_MessageValue zero;
+    memset(&zero, 0, sizeof(zero));
+    jsontx_scalarval(t, zero, val_f);
+  }
+}
+
+// Emits every entry of map field |f| in [ptr, end) as one JSON object.
+static void jsontx_map(jsontx* t, const char* ptr, const char* end,
+                       const upb_FieldDef* f) {
+  const upb_MessageDef* entry_m = upb_FieldDef_MessageSubDef(f);
+  const upb_FieldDef* key_f = upb_MessageDef_FindFieldByNumber(entry_m, 1);
+  const upb_FieldDef* val_f = upb_MessageDef_FindFieldByNumber(entry_m, 2);
+  const uint32_t num = upb_FieldDef_Number(f);
+  bool first = true;
+
+  jsontx_putstr(t, "{");
+  const char* start = ptr;
+  while (ptr < end) {
+    const char* tag_start = ptr;
+    uint32_t tag;
+    const char* val = jsontx_tag(t, ptr, end, &tag);
+    if (jsontx_fieldnum(tag) != num ||
+        jsontx_wtype(tag) != kUpb_WireType_Delimited) {
+      ptr = jsontx_skipval(t, val, end, tag,
+                           kUpb_WireFormat_DefaultDepthLimit);
+      continue;
+    }
+    int size;
+    const char* entry = jsontx_delimited(t, val, end, &size);
+    const char* entry_end = entry + size;
+
+    // Each distinct key is emitted at its first occurrence (where the
+    // decoder would insert it), with the value of its last occurrence
+    // (last value wins, as in upb_Decode()).
+    jsontx_MapKey key;
+    jsontx_readmapkey(t, entry, entry_end, key_f, &key);
+    const char* seen;
+    const char* seen_end;
+    if (!jsontx_mapfindlast(t, start, tag_start, num, key_f, &key, &seen,
+                            &seen_end)) {
+      const char* winner = entry;
+      const char* winner_end = entry_end;
+      jsontx_mapfindlast(t, entry_end, end, num, key_f, &key, &winner,
+                         &winner_end);
+      jsontx_putsep(t, ",", &first);
+      jsontx_mapkey(t, &key, key_f);
+      jsontx_mapentryval(t, winner, winner_end, val_f);
+    }
+    ptr = entry_end;
+  }
+  jsontx_putstr(t, "}");
+}
+
+/* Well-known types. ****************************************************/
+
+static void jsontx_nanos(jsontx* t, int32_t nanos) {
+  int digits = 9;
+
+  if (nanos == 0) return;
+  if (nanos < 0 || nanos >= 1000000000) {
+    jsontx_err(t, "error formatting timestamp as JSON: invalid nanos");
+  }
+
+  while (nanos % 1000 == 0) {
+    nanos /= 1000;
+    digits -= 3;
+  }
+
+  jsontx_printf(t, ".%.*" PRId32, digits, nanos);
+}
+
+static int64_t jsontx_wktint(jsontx* t, const char* ptr, const char* end,
+                             uint32_t field_number) {
+  const char* last =
+      jsontx_findlast(t, ptr, end, field_number, kUpb_WireType_Varint);
+  if (!last) return 0;
+  uint64_t val;
+  jsontx_varint(t, last, end, &val);
+  return (int64_t)val;
+}
+
+static void jsontx_timestamp(jsontx* t, const char* ptr, const char* end) {
+  int64_t seconds = jsontx_wktint(t, ptr, end, 1);
+  int32_t nanos = (int32_t)jsontx_wktint(t, ptr, end, 2);
+  int L, N, I, J, K, hour, min, sec;
+
+  if (seconds < -62135596800) {
+    jsontx_err(t,
+               "error formatting timestamp as JSON: minimum acceptable value "
+               "is 0001-01-01T00:00:00Z");
+  } else if (seconds > 253402300799) {
+    jsontx_err(t,
+               "error formatting timestamp as JSON: maximum acceptable value "
+               "is 9999-12-31T23:59:59Z");
+  }
+
+  /* Julian Day -> Y/M/D, Algorithm from:
+   * Fliegel, H. F., and Van Flandern, T. C., "A Machine Algorithm for
+   *   Processing Calendar Dates," Communications of the Association of
+   *   Computing Machines, vol. 11 (1968), p. 657.  */
+  seconds += 62135596800;  // Ensure seconds is positive.
+  L = (int)(seconds / 86400) - 719162 + 68569 + 2440588;
+  N = 4 * L / 146097;
+  L = L - (146097 * N + 3) / 4;
+  I = 4000 * (L + 1) / 1461001;
+  L = L - 1461 * I / 4 + 31;
+  J = 80 * L / 2447;
+  K = L - 2447 * J / 80;
+  L = J / 11;
+  J = J + 2 - 12 * L;
+  I = 100 * (N - 49) + I + L;
+
+  sec = seconds % 60;
+  min = (seconds / 60) % 60;
+  hour = (seconds / 3600) % 24;
+
+  jsontx_printf(t, "\"%04d-%02d-%02dT%02d:%02d:%02d", I, J, K, hour, min, sec);
+  jsontx_nanos(t, nanos);
+  jsontx_putstr(t, "Z\"");
+}
+
+static void jsontx_wktduration(jsontx* t, const char* ptr, const char* end) {
+  int64_t seconds = jsontx_wktint(t, ptr, end, 1);
+  int32_t nanos = (int32_t)jsontx_wktint(t, ptr, end, 2);
+  bool negative = false;
+
+  if (seconds > 315576000000 || seconds < -315576000000 ||
+      (seconds != 0 && nanos != 0 && (seconds < 0) != (nanos < 0))) {
+    jsontx_err(t, "bad duration");
+  }
+
+  if (seconds < 0) {
+    negative = true;
+    seconds = -seconds;
+  }
+  if (nanos < 0) {
+    negative = true;
+    nanos = -nanos;
+  }
+
+  jsontx_putstr(t, "\"");
+  if (negative) {
+    jsontx_putstr(t, "-");
+  }
+  jsontx_printf(t, "%" PRId64, seconds);
+  jsontx_nanos(t, nanos);
+  jsontx_putstr(t, "s\"");
+}
+
+static void jsontx_wrapper(jsontx* t, const char* ptr, const char* end,
+                           const upb_MessageDef* m) {
+  const upb_FieldDef* val_f = upb_MessageDef_FindFieldByNumber(m, 1);
+  const char* last = jsontx_findlast(t, ptr, end, 1, jsontx_wiretype(val_f));
+  upb_MessageValue val;
+  memset(&val, 0, sizeof(val));
+  if (last) {
+    jsontx_readscalar(t, last, end, val_f, &val);
+  }
+  jsontx_scalarval(t, val, val_f);
+}
+
+static void jsontx_fieldpath(jsontx* t, upb_StringView path) {
+  const char* ptr = path.data;
+  const char* end = ptr + path.size;
+
+  while (ptr < end) {
+    char ch = *ptr;
+
+    if (ch >= 'A' && ch <= 'Z') {
+      jsontx_err(t, "Field mask element may not have upper-case letter.");
+    } else if (ch == '_') {
+      if (ptr == end - 1 || *(ptr + 1) < 'a' || *(ptr + 1) > 'z') {
+        jsontx_err(t, "Underscore must be followed by a lowercase letter.");
+      }
+      ch = *++ptr - 32;
+    }
+
+    jsontx_putbytes(t, &ch, 1);
+    ptr++;
+  }
+}
+
+static void jsontx_fieldmask(jsontx* t, const char* ptr, const char* end) {
+  bool first = true;
+
+  jsontx_putstr(t, "\"");
+  while (ptr < end) {
+    uint32_t tag;
+    ptr = jsontx_tag(t, ptr, end, &tag);
+    if (jsontx_fieldnum(tag) == 1 &&
+        jsontx_wtype(tag) == kUpb_WireType_Delimited) {
+      int size;
+      ptr = jsontx_delimited(t, ptr, end, &size);
+      jsontx_putsep(t, ",", &first);
+      jsontx_fieldpath(t, upb_StringView_FromDataAndSize(ptr, size));
+      ptr += size;
+    } else {
+      ptr = jsontx_skipval(t, ptr, end, tag,
+                           kUpb_WireFormat_DefaultDepthLimit);
+    }
+  }
+  jsontx_putstr(t, "\"");
+}
+
+static void jsontx_struct(jsontx* t, const char* ptr, const char* end,
+                          const upb_MessageDef* m) {
+  jsontx_map(t, ptr, end, upb_MessageDef_FindFieldByNumber(m, 1));
+}
+
+static void jsontx_listvalue(jsontx* t, const char* ptr, const char* end,
+                             const upb_MessageDef* m) {
+  jsontx_array(t, ptr, end, upb_MessageDef_FindFieldByNumber(m, 1));
+}
+
+static void jsontx_value(jsontx* t, const char* ptr, const char* end,
+                         const upb_MessageDef* m) {
+  // The kind fields form a oneof, so the last valid occurrence wins.
+  const char* found = NULL;
+  const upb_FieldDef* found_f = NULL;
+  const char* p = ptr;
+  while (p < end) {
+    uint32_t tag;
+    p = jsontx_tag(t, p, end, &tag);
+    const upb_FieldDef* f =
+        upb_MessageDef_FindFieldByNumber(m, jsontx_fieldnum(tag));
+    if (f && jsontx_wtype(tag) == jsontx_wiretype(f)) {
+      found = p;
+      found_f = f;
+    }
+    p = jsontx_skipval(t, p, end, tag, kUpb_WireFormat_DefaultDepthLimit);
+  }
+  if (!found) jsontx_err(t, "No value set in Value proto");
+
+  upb_MessageValue val;
+  switch (upb_FieldDef_Number(found_f)) {
+    case 1:
+      jsontx_putstr(t, "null");
+      break;
+    case 2:
+      jsontx_readscalar(t, found, end, found_f, &val);
+      if (jsontx_specialdouble(t, val.double_val)) {
+        jsontx_err(t,
+                   "google.protobuf.Value cannot encode double values for "
+                   "infinity or nan, because they would be parsed as a string");
+      }
+      jsontx_double(t, val.double_val);
+      break;
+    case 3:
+      jsontx_readscalar(t, found, end, found_f, &val);
+      jsontx_string(t, val.str_val);
+      break;
+    case 4:
+      jsontx_readscalar(t, found, end, found_f, &val);
+      jsontx_putstr(t, val.bool_val ? "true" : "false");
+      break;
+    case 5:
+    case 6: {
+      int size;
+      const char* sub = jsontx_delimited(t, found, end, &size);
+      const upb_MessageDef* sub_m = upb_FieldDef_MessageSubDef(found_f);
+      if (upb_FieldDef_Number(found_f) == 5) {
+        jsontx_struct(t, sub, sub + size, sub_m);
+      } else {
+        jsontx_listvalue(t, sub, sub + size, sub_m);
+      }
+      break;
+    }
+  }
+}
+
+static const upb_MessageDef* jsontx_getanymsg(jsontx* t,
+                                              upb_StringView type_url) {
+  /* Find last '/', if any. */
+  const char* end = type_url.data + type_url.size;
+  const char* ptr = end;
+  const upb_MessageDef* ret;
+
+  if (!t->ext_pool) {
+    jsontx_err(t, "Tried to transcode Any, but no symtab was provided");
+  }
+
+  if (type_url.size == 0) goto badurl;
+
+  while (true) {
+    if (--ptr == type_url.data) {
+      /* Type URL must contain at least one '/', with host before. */
+      goto badurl;
+    }
+    if (*ptr == '/') {
+      ptr++;
+      break;
+    }
+  }
+
+  ret = upb_DefPool_FindMessageByNameWithSize(t->ext_pool, ptr, end - ptr);
+
+  if (!ret) {
+    jsontx_errf(t, "Couldn't find Any type: %.*s", (int)(end - ptr), ptr);
+  }
+
+  return ret;
+
+badurl:
+  jsontx_errf(t, "Bad type URL: " UPB_STRINGVIEW_FORMAT,
+              UPB_STRINGVIEW_ARGS(type_url));
+}
+
+static upb_StringView jsontx_wktstring(jsontx* t, const char* ptr,
+                                       const char* end,
+                                       uint32_t field_number) {
+  upb_StringView ret = {NULL, 0};
+  const char* last =
+      jsontx_findlast(t, ptr, end, field_number, kUpb_WireType_Delimited);
+  if (last) {
+    int size;
+    last = jsontx_delimited(t, last, end, &size);
+    ret.data = last;
+    ret.size = size;
+  }
+  return ret;
+}
+
+static void jsontx_any(jsontx* t, const char* ptr, const char* end) {
+  upb_StringView type_url = jsontx_wktstring(t, ptr, end, 1);
+  upb_StringView value = jsontx_wktstring(t, ptr, end, 2);
+  const upb_MessageDef* any_m = jsontx_getanymsg(t, type_url);
+
+  jsontx_putstr(t, "{\"@type\":");
+  jsontx_string(t, type_url);
+
+  if (upb_MessageDef_WellKnownType(any_m) == kUpb_WellKnown_Unspecified) {
+    /* Regular messages: {"@type": "...","foo": 1, "bar": 2} */
+    jsontx_msgfields(t, value.data, value.data + value.size, any_m, false);
+  } else {
+    /* Well-known type: {"@type": "...","value": <well-known encoding>} */
+    jsontx_putstr(t, ",\"value\":");
+    jsontx_msgvalue(t, value.data, value.data + value.size, any_m);
+  }
+
+  jsontx_putstr(t, "}");
+}
+
+/* Message traversal. ***************************************************/
+
+static void jsontx_fieldname(jsontx* t, const upb_FieldDef* f, bool* first) {
+  jsontx_putsep(t, ",", first);
+
+  if (upb_FieldDef_IsExtension(f)) {
+    jsontx_printf(t, "\"[%s]\":", upb_FieldDef_FullName(f));
+  } else if (t->options & upb_JsonEncode_UseProtoNames) {
+    jsontx_printf(t, "\"%s\":", upb_FieldDef_Name(f));
+  } else {
+    jsontx_printf(t, "\"%s\":", upb_FieldDef_JsonName(f));
+  }
+}
+
+static void jsontx_msgfields(jsontx* t, const char* ptr, const char* end,
+                             const upb_MessageDef* m, bool first) {
+  const char* start = ptr;
+
+  while (ptr < end) {
+    uint32_t tag;
+    const char* val = jsontx_tag(t, ptr, end, &tag);
+    const uint32_t wt = jsontx_wtype(tag);
+    if (wt == kUpb_WireType_EndGroup) jsontx_err(t, "unbalanced end-group");
+
+    const upb_FieldDef* f =
+        upb_MessageDef_FindFieldByNumber(m, jsontx_fieldnum(tag));
+    if (!f && t->ext_pool) {
+      f = upb_DefPool_FindExtensionByNumber(t->ext_pool, m,
+                                            jsontx_fieldnum(tag));
+    }
+    if (!f || !jsontx_accepts(f, wt)) {
+      // Unknown field (or wire-type mismatch): skipped, as upb_JsonEncode()
+      // omits unknown fields.
+      ptr = jsontx_skipval(t, val, end, tag,
+                           kUpb_WireFormat_DefaultDepthLimit);
+      continue;
+    }
+
+    if (upb_FieldDef_IsMap(f)) {
+      if (!jsontx_seenbefore(t, start, ptr, f)) {
+        jsontx_fieldname(t, f, &first);
+        jsontx_map(t, ptr, end, f);
+      }
+    } else if (upb_FieldDef_IsRepeated(f)) {
+      if (!jsontx_seenbefore(t, start, ptr, f)) {
+        jsontx_fieldname(t, f, &first);
+        jsontx_array(t, ptr, end, f);
+      }
+    } else {
+      const char* after = jsontx_skipval(t, val, end, tag,
+                                         kUpb_WireFormat_DefaultDepthLimit);
+      if (jsontx_enumok(t, val, end, f) &&
+          !jsontx_haslater(t, after, end, f, m)) {
+        jsontx_fieldname(t, f, &first);
+        jsontx_fieldelem(t, val, end, wt, f);
+      }
+      ptr = after;
+      continue;
+    }
+    ptr = jsontx_skipval(t, val, end, tag, kUpb_WireFormat_DefaultDepthLimit);
+  }
+}
+
+static void jsontx_msg(jsontx* t, const char* ptr, const char* end,
+                       const upb_MessageDef* m) {
+  jsontx_putstr(t, "{");
+  jsontx_msgfields(t, ptr, end, m, true);
+  jsontx_putstr(t, "}");
+}
+
+static void jsontx_msgvalue(jsontx* t, const char* ptr, const char* end,
+                            const upb_MessageDef* m) {
+  if (t->depth == 0) jsontx_err(t, "max depth exceeded");
+  t->depth--;
+
+  switch (upb_MessageDef_WellKnownType(m)) {
+    case kUpb_WellKnown_Unspecified:
+      jsontx_msg(t, ptr, end, m);
+      break;
+    case kUpb_WellKnown_Any:
+      jsontx_any(t, ptr, end);
+      break;
+    case kUpb_WellKnown_FieldMask:
+      jsontx_fieldmask(t, ptr, end);
+      break;
+    case kUpb_WellKnown_Duration:
+      jsontx_wktduration(t, ptr, end);
+      break;
+    case kUpb_WellKnown_Timestamp:
+      jsontx_timestamp(t, ptr, end);
+      break;
+    case kUpb_WellKnown_DoubleValue:
+    case kUpb_WellKnown_FloatValue:
+    case kUpb_WellKnown_Int64Value:
+    case kUpb_WellKnown_UInt64Value:
+    case kUpb_WellKnown_Int32Value:
+    case kUpb_WellKnown_UInt32Value:
+    case kUpb_WellKnown_StringValue:
+    case kUpb_WellKnown_BytesValue:
+    case kUpb_WellKnown_BoolValue:
+      jsontx_wrapper(t, ptr, end, m);
+      break;
+    case kUpb_WellKnown_Value:
+      jsontx_value(t, ptr, end, m);
+      break;
+    case kUpb_WellKnown_ListValue:
+      jsontx_listvalue(t, ptr, end, m);
+      break;
+    case kUpb_WellKnown_Struct:
+      jsontx_struct(t, ptr, end, m);
+      break;
+  }
+
+  t->depth++;
+}
+
+static size_t jsontx_nullz(jsontx* t, size_t size) {
+  size_t ret = t->ptr - t->buf + t->overflow;
+
+  if (size > 0) {
+    if (t->ptr == t->end) t->ptr--;
+    *t->ptr = '\0';
+  }
+
+  return ret;
+}
+
+size_t upb_JsonTranscode(const char* wire, size_t wire_size,
+                         const upb_MessageDef* m, const upb_DefPool* ext_pool,
+                         int options, char* buf, size_t size,
+                         upb_Status* status) {
+  jsontx t;
+
+  t.buf = buf;
+  t.ptr = buf;
+  t.end = UPB_PTRADD(buf, size);
+  t.overflow = 0;
+  t.options = options;
+  t.ext_pool = ext_pool;
+  t.depth = kUpb_WireFormat_DefaultDepthLimit;
+  t.status = status;
+
+  if (UPB_SETJMP(t.err) != 0) return -1;
+
+  jsontx_msgvalue(&t, wire, UPB_PTRADD(wire, wire_size), m);
+  return jsontx_nullz(&t, size);
+}
+
+/* JSON -> wire transcoding. ********************************************
+ *
+ * The parser half mirrors decode.c; the emission half writes wire bytes
+ * forward into the output buffer.  A nested message's length prefix is
+ * inserted when the message closes, shifting the bytes emitted for its
+ * body; everything else streams straight through.  The |pos| cursor is
+ * virtual: once it passes |cap| bytes are only counted, so the exact
+ * required size is still returned for an undersized buffer.  The one
+ * allocation is a reusable scratch buffer that holds the most recently
+ * unescaped JSON string (field names alias the input when escape-free). */
+
+typedef struct {
+  const char *ptr, *end;  // JSON input.
+  char* out;              // Wire output (may be smaller than the encoding).
+  size_t pos, cap;        // Virtual write position / real buffer size.
+  const upb_DefPool* symtab;
+  int depth;
+  int options;
+  int line;
+  const char* line_begin;
+  bool is_first;
+  char* scratch;  // Holds the last unescaped string; reused per string.
+  size_t scratch_cap;
+  jmp_buf err;
+  upb_Status* status;
+} jsontw;
+
+enum { JW_OBJECT, JW_ARRAY, JW_STRING, JW_NUMBER, JW_TRUE, JW_FALSE, JW_NULL };
+
+/* Forward declarations of mutually-recursive functions. */
+static void jsontw_wellknown(jsontw* t, const upb_MessageDef* m);
+static void jsontw_wellknownvalue(jsontw* t, const upb_MessageDef* m);
+static void jsontw_object(jsontw* t, const upb_MessageDef* m);
+static void jsontw_tomsg(jsontw* t, const upb_MessageDef* m);
+
+static bool jsontw_streql(upb_StringView str, const char* lit) {
+  return str.size == strlen(lit) && memcmp(str.data, lit, str.size) == 0;
+}
+
+static bool jsontw_isnullvalue(const upb_FieldDef* f) {
+  return upb_FieldDef_CType(f) == kUpb_CType_Enum &&
+         strcmp(upb_EnumDef_FullName(upb_FieldDef_EnumSubDef(f)),
+                "google.protobuf.NullValue") == 0;
+}
+
+static bool jsontw_isvalue(const upb_FieldDef* f) {
+  return (upb_FieldDef_CType(f) == kUpb_CType_Message &&
+          upb_MessageDef_WellKnownType(upb_FieldDef_MessageSubDef(f)) ==
+              kUpb_WellKnown_Value) ||
+         jsontw_isnullvalue(f);
+}
+
+UPB_NORETURN static void jsontw_err(jsontw* t, const char* msg) {
+  upb_Status_SetErrorFormat(t->status, "Error parsing JSON @%d:%d: %s",
+                            t->line, (int)(t->ptr - t->line_begin), msg);
+  UPB_LONGJMP(t->err, 1);
+}
+
+UPB_PRINTF(2, 3)
+UPB_NORETURN static void jsontw_errf(jsontw* t, const char* fmt, ...) {
+  va_list argp;
+  upb_Status_SetErrorFormat(t->status, "Error parsing JSON @%d:%d: ", t->line,
+                            (int)(t->ptr - t->line_begin));
+  va_start(argp, fmt);
+  upb_Status_VAppendErrorFormat(t->status, fmt, argp);
+  va_end(argp);
+  UPB_LONGJMP(t->err, 1);
+}
+
+/* Wire output. *********************************************************/
+
+static void jsontw_outbyte(jsontw* t, char ch) {
+  if (t->pos < t->cap) t->out[t->pos] = ch;
+  t->pos++;
+}
+
+static void jsontw_outbytes(jsontw* t, const void* data, size_t len) {
+  if (t->pos < t->cap) {
+    memcpy(t->out + t->pos, data, UPB_MIN(len, t->cap - t->pos));
+  }
+  t->pos += len;
+}
+
+static void jsontw_outvarint(jsontw* t, uint64_t val) {
+  do {
+    char byte = val & 0x7f;
+    val >>= 7;
+    if (val) byte |= 0x80;
+    jsontw_outbyte(t, byte);
+  } while (val);
+}
+
+static void jsontw_outtag(jsontw* t, const upb_FieldDef* f, uint32_t wt) {
+  jsontw_outvarint(t, ((uint64_t)upb_FieldDef_Number(f) << 3) | wt);
+}
+
+static void jsontw_outfixed32(jsontw* t, uint32_t val) {
+  val = _upb_BigEndian_Swap32(val);
+  jsontw_outbytes(t, &val, 4);
+}
+
+static void jsontw_outfixed64(jsontw* t, uint64_t val) {
+  val = _upb_BigEndian_Swap64(val);
+  jsontw_outbytes(t, &val, 8);
+}
+
+// Inserts the varint length of everything emitted since |at| (the write
+// position just after a delimited field's tag), shifting those bytes to
+// make room for the prefix.
+static void jsontw_patchlen(jsontw* t, size_t at) {
+  const uint64_t len = t->pos - at;
+  char prefix[10];
+  size_t k = 0;
+  uint64_t v = len;
+  do {
+    prefix[k] = v & 0x7f;
+    v >>= 7;
+    if (v) prefix[k] |= 0x80;
+    k++;
+  } while (v);
+
+  if (at < t->cap) {
+    const size_t have = UPB_MIN(t->pos, t->cap) - at;  // Body bytes present.
+    const size_t room = t->cap - at;
+    if (room > k && have > 0) {
+      memmove(t->out + at + k, t->out + at, UPB_MIN(have, room - k));
+    }
+    memcpy(t->out + at, prefix, UPB_MIN(k, room));
+  }
+  t->pos += k;
+}
+
+/* JSON lexing, as in decode.c. *****************************************/
+
+static void jsontw_skipws(jsontw* t) {
+  while (t->ptr != t->end) {
+    switch (*t->ptr) {
+      case '\n':
+        t->line++;
+        t->line_begin = t->ptr;
+        /* Fallthrough. */
+      case '\r':
+      case '\t':
+      case ' ':
+        t->ptr++;
+        break;
+      default:
+        return;
+    }
+  }
+  jsontw_err(t, "Unexpected EOF");
+}
+
+static bool jsontw_tryparsech(jsontw* t, char ch) {
+  if (t->ptr == t->end || *t->ptr != ch) return false;
+  t->ptr++;
+  return true;
+}
+
+static void jsontw_parselit(jsontw* t, const char* lit) {
+  size_t avail = t->end - t->ptr;
+  size_t len = strlen(lit);
+  if (avail < len || memcmp(t->ptr, lit, len) != 0) {
+    jsontw_errf(t, "Expected: '%s'", lit);
+  }
+  t->ptr += len;
+}
+
+static void jsontw_wsch(jsontw* t, char ch) {
+  jsontw_skipws(t);
+  if (!jsontw_tryparsech(t, ch)) {
+    jsontw_errf(t, "Expected: '%c'", ch);
+  }
+}
+
+static void jsontw_true(jsontw* t) { jsontw_parselit(t, "true"); }
+static void jsontw_false(jsontw* t) { jsontw_parselit(t, "false"); }
+static void jsontw_null(jsontw* t) { jsontw_parselit(t, "null"); }
+
+static void jsontw_entrysep(jsontw* t) {
+  jsontw_skipws(t);
+  jsontw_parselit(t, ":");
+}
+
+static int jsontw_rawpeek(jsontw* t) {
+  switch (*t->ptr) {
+    case '{':
+      return JW_OBJECT;
+    case '[':
+      return JW_ARRAY;
+    case '"':
+      return JW_STRING;
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+      return JW_NUMBER;
+    case 't':
+      return JW_TRUE;
+    case 'f':
+      return JW_FALSE;
+    case 'n':
+      return JW_NULL;
+    default:
+      jsontw_errf(t, "Unexpected character: '%c'", *t->ptr);
+  }
+}
+
+static int jsontw_peek(jsontw* t) {
+  jsontw_skipws(t);
+  return jsontw_rawpeek(t);
+}
+
+static void jsontw_push(jsontw* t) {
+  if (--t->depth < 0) {
+    jsontw_err(t, "Recursion limit exceeded");
+  }
+  t->is_first = true;
+}
+
+static bool jsontw_seqnext(jsontw* t, char end_ch) {
+  bool is_first = t->is_first;
+  t->is_first = false;
+  jsontw_skipws(t);
+  if (*t->ptr == end_ch) return false;
+  if (!is_first) jsontw_parselit(t, ",");
+  return true;
+}
+
+static void jsontw_arrstart(jsontw* t) {
+  jsontw_push(t);
+  jsontw_wsch(t, '[');
+}
+
+static void jsontw_arrend(jsontw* t) {
+  t->depth++;
+  jsontw_wsch(t, ']');
+}
+
+static bool jsontw_arrnext(jsontw* t) { return jsontw_seqnext(t, ']'); }
+
+static void jsontw_objstart(jsontw* t) {
+  jsontw_push(t);
+  jsontw_wsch(t, '{');
+}
+
+static void jsontw_objend(jsontw* t) {
+  t->depth++;
+  jsontw_wsch(t, '}');
+}
+
+static bool jsontw_objnext(jsontw* t) {
+  if (!jsontw_seqnext(t, '}')) return false;
+  if (jsontw_peek(t) != JW_STRING) {
+    jsontw_err(t, "Object must start with string");
+  }
+  return true;
+}
+
+/* JSON number. *********************************************************/
+
+static bool jsontw_tryskipdigits(jsontw* t) {
+  const char* start = t->ptr;
+  while (t->ptr < t->end) {
+    if (*t->ptr < '0' || *t->ptr > '9') break;
+    t->ptr++;
+  }
+  return t->ptr != start;
+}
+
+static void jsontw_skipdigits(jsontw* t) {
+  if (!jsontw_tryskipdigits(t)) {
+    jsontw_err(t, "Expected one or more digits");
+  }
+}
+
+/* Accumulates the digits in [ptr, end) into *mantissa.  Returns false if the
+ * count would exceed the 19 digits that always fit in a uint64_t, in which
+ * case the caller must take the slow path. */
+static bool jsontw_accumdigits(const char* ptr, const char* end,
+                               uint64_t* mantissa, int* ndigits) {
+  const int len = (int)(end - ptr);
+  if (*ndigits + len > 19) return false;
+  uint64_t m = *mantissa;
+  while (ptr < end) {
+    m = m * 10 + (uint64_t)(*ptr++ - '0');
+  }
+  *mantissa = m;
+  *ndigits += len;
+  return true;
+}
+
+static double jsontw_number(jsontw* t) {
+  const char* start = t->ptr;
+  uint64_t mantissa = 0;
+  int ndigits = 0;
+  int frac_digits = 0;
+  int exp_val = 0;
+  bool neg = false;
+  bool fast = true;
+
+  assert(jsontw_rawpeek(t) == JW_NUMBER);
+
+  /* Skip over the syntax of a number, as specified by JSON, collecting the
+   * mantissa and exponent for the fast conversion path as we go. */
+  if (*t->ptr == '-') {
+    neg = true;
+    t->ptr++;
+  }
+
+  if (jsontw_tryparsech(t, '0')) {
+    if (jsontw_tryskipdigits(t)) {
+      jsontw_err(t, "number cannot have leading zero");
+    }
+  } else {
+    const char* p = t->ptr;
+    jsontw_skipdigits(t);
+    fast = jsontw_accumdigits(p, t->ptr, &mantissa, &ndigits) && fast;
+  }
+
+  if (t->ptr == t->end) goto parse;
+  if (jsontw_tryparsech(t, '.')) {
+    const char* p = t->ptr;
+    jsontw_skipdigits(t);
+    frac_digits = (int)(t->ptr - p);
+    fast = jsontw_accumdigits(p, t->ptr, &mantissa, &ndigits) && fast;
+  }
+  if (t->ptr == t->end) goto parse;
+
+  if (*t->ptr == 'e' || *t->ptr == 'E') {
+    bool exp_neg = false;
+    const char* p;
+    t->ptr++;
+    if (t->ptr == t->end) {
+      jsontw_err(t, "Unexpected EOF in number");
+    }
+    if (*t->ptr == '+' || *t->ptr == '-') {
+      exp_neg = *t->ptr == '-';
+      t->ptr++;
+    }
+    p = t->ptr;
+    jsontw_skipdigits(t);
+    if (t->ptr - p > 3) {
+      fast = false; /* Huge exponent; certainly outside the fast range. */
+    } else {
+      while (p < t->ptr) exp_val = exp_val * 10 + (*p++ - '0');
+      if (exp_neg) exp_val = -exp_val;
+    }
+  }
+
+parse:
+  if (fast) {
+    double val;
+    if (_upb_Strtod_FastPath(mantissa, exp_val - frac_digits, neg, &val)) {
+      return val;
+    }
+  }
+
+  /* Having verified the syntax of a JSON number, use strtod() to parse
+   * (strtod() accepts a superset of JSON syntax). */
+  errno = 0;
+  {
+    char* end;
+    double val = strtod(start, &end);
+    assert(end == t->ptr);
+    (void)end;
+
+    if (val > DBL_MAX || val < -DBL_MAX) {
+      jsontw_err(t, "Number out of range");
+    }
+
+    return val;
+  }
+}
+
+/* JSON string. *********************************************************/
+
+static char jsontw_escape(jsontw* t) {
+  switch (*t->ptr++) {
+    case '"':
+      return '\"';
+    case '\\':
+      return '\\';
+    case '/':
+      return '/';
+    case 'b':
+      return '\b';
+    case 'f':
+      return '\f';
+    case 'n':
+      return '\n';
+    case 'r':
+      return '\r';
+    case 't':
+      return '\t';
+    default:
+      jsontw_err(t, "Invalid escape char");
+  }
+}
+
+static uint32_t jsontw_codepoint(jsontw* t) {
+  uint32_t cp = 0;
+  const char* end;
+
+  if (t->end - t->ptr < 4) {
+    jsontw_err(t, "EOF inside string");
+  }
+
+  end = t->ptr + 4;
+  while (t->ptr < end) {
+    char ch = *t->ptr++;
+    if (ch >= '0' && ch <= '9') {
+      ch -= '0';
+    } else if (ch >= 'a' && ch <= 'f') {
+      ch = ch - 'a' + 10;
+    } else if (ch >= 'A' && ch <= 'F') {
+      ch = ch - 'A' + 10;
+    } else {
+      jsontw_err(t, "Invalid hex digit");
+    }
+    cp = (cp << 4) | ch;
+  }
+
+  return cp;
+}
+
+/* Parses a \uXXXX unicode escape (possibly a surrogate pair). */
+static size_t jsontw_unicode(jsontw* t, char* out) {
+  uint32_t cp = jsontw_codepoint(t);
+  if (upb_Unicode_IsHigh(cp)) {
+    /* Surrogate pair: two 16-bit codepoints become a 32-bit codepoint. */
+    jsontw_parselit(t, "\\u");
+    uint32_t low = jsontw_codepoint(t);
+    if (!upb_Unicode_IsLow(low)) jsontw_err(t, "Invalid low surrogate");
+    cp = upb_Unicode_FromPair(cp, low);
+  } else if (upb_Unicode_IsLow(cp)) {
+    jsontw_err(t, "Unpaired low surrogate");
+  }
+
+  /* Write to UTF-8 */
+  int bytes = upb_Unicode_ToUTF8(cp, out);
+  if (bytes == 0) jsontw_err(t, "Invalid codepoint");
+  return bytes;
+}
+
+static void jsontw_reserve(jsontw* t, size_t need) {
+  if (t->scratch_cap < need) {
+    size_t cap = UPB_MAX(t->scratch_cap, 64);
+    while (cap < need) cap *= 2;
+    char* buf = upb_grealloc(t->scratch, t->scratch_cap, cap);
+    if (!buf) jsontw_err(t, "Out of memory");
+    t->scratch = buf;
+    t->scratch_cap = cap;
+  }
+}
+
+// Parses a JSON string into the scratch buffer.  The returned view is
+// NUL-terminated (for strtod() et al.) and valid until the next string is
+// parsed; callers that emit string data do so before parsing further.
+static upb_StringView jsontw_string(jsontw* t) {
+  size_t len = 0;
+
+  jsontw_skipws(t);
+
+  if (*t->ptr++ != '"') {
+    jsontw_err(t, "Expected string");
+  }
+
+  while (t->ptr < t->end) {
+    char ch = *t->ptr++;
+    jsontw_reserve(t, len + 5);  // Room for a codepoint and the NUL.
+
+    switch (ch) {
+      case '"': {
+        upb_StringView ret;
+        ret.data = t->scratch;
+        ret.size = len;
+        t->scratch[len] = '\0';
+        return ret;
+      }
+      case '\\':
+        if (t->ptr == t->end) goto eof;
+        if (*t->ptr == 'u') {
+          t->ptr++;
+          len += jsontw_unicode(t, t->scratch + len);
+        } else {
+          t->scratch[len++] = jsontw_escape(t);
+        }
+        break;
+      default:
+        if ((unsigned char)ch < 0x20) {
+          jsontw_err(t, "Invalid char in JSON string");
+        }
+        t->scratch[len++] = ch;
+        break;
+    }
+  }
+
+eof:
+  jsontw_err(t, "EOF inside string");
+}
+
+/* Object keys almost never contain escapes, so return a view aliasing the
+ * input when possible, as decode.c does; the scratch buffer then still
+ * holds whatever string was parsed before the key. */
+static upb_StringView jsontw_name(jsontw* t) {
+  jsontw_skipws(t);
+
+  if (t->ptr == t->end || *t->ptr != '"') jsontw_err(t, "Expected string");
+
+  const char* start = t->ptr + 1;
+  const char* p = start;
+  while (p < t->end) {
+    const unsigned char ch = (unsigned char)*p;
+    if (ch == '"' || ch == '\\' || ch < 0x20) break;
+    p++;
+  }
+  if (p < t->end && *p == '"') {
+    t->ptr = p + 1;
+    upb_StringView ret;
+    ret.data = start;
+    ret.size = p - start;
+    return ret;
+  }
+
+  return jsontw_string(t);
+}
+
+static void jsontw_skipval(jsontw* t) {
+  switch (jsontw_peek(t)) {
+    case JW_OBJECT:
+      jsontw_objstart(t);
+      while (jsontw_objnext(t)) {
+        jsontw_name(t);
+        jsontw_entrysep(t);
+        jsontw_skipval(t);
+      }
+      jsontw_objend(t);
+      break;
+    case JW_ARRAY:
+      jsontw_arrstart(t);
+      while (jsontw_arrnext(t)) {
+        jsontw_skipval(t);
+      }
+      jsontw_arrend(t);
+      break;
+    case JW_TRUE:
+      jsontw_true(t);
+      break;
+    case JW_FALSE:
+      jsontw_false(t);
+      break;
+    case JW_NULL:
+      jsontw_null(t);
+      break;
+    case JW_STRING:
+      jsontw_string(t);
+      break;
+    case JW_NUMBER:
+      jsontw_number(t);
+      break;
+  }
+}
+
+/* Base64 decoding for bytes fields, as in decode.c. ********************/
+
+static unsigned int jsontw_base64_tablelookup(const char ch) {
+  /* Table includes the normal base64 chars plus the URL-safe variant. */
+  static const signed char table[256] = {
+      ['+'] = 62, ['-'] = 62, ['/'] = 63, ['_'] = 63,
+      ['0'] = 52, ['1'] = 53, ['2'] = 54, ['3'] = 55, ['4'] = 56,
+      ['5'] = 57, ['6'] = 58, ['7'] = 59, ['8'] = 60, ['9'] = 61,
+      ['A'] = 0,  ['B'] = 1,  ['C'] = 2,  ['D'] = 3,  ['E'] = 4,
+      ['F'] = 5,  ['G'] = 6,  ['H'] = 7,  ['I'] = 8,  ['J'] = 9,
+      ['K'] = 10, ['L'] = 11, ['M'] = 12, ['N'] = 13, ['O'] = 14,
+      ['P'] = 15, ['Q'] = 16, ['R'] = 17, ['S'] = 18, ['T'] = 19,
+      ['U'] = 20, ['V'] = 21, ['W'] = 22, ['X'] = 23, ['Y'] = 24,
+      ['Z'] = 25, ['a'] = 26, ['b'] = 27, ['c'] = 28, ['d'] = 29,
+      ['e'] = 30, ['f'] = 31, ['g'] = 32, ['h'] = 33, ['i'] = 34,
+      ['j'] = 35, ['k'] = 36, ['l'] = 37, ['m'] = 38, ['n'] = 39,
+      ['o'] = 40, ['p'] = 41, ['q'] = 42, ['r'] = 43, ['s'] = 44,
+      ['t'] = 45, ['u'] = 46, ['v'] = 47, ['w'] = 48, ['x'] = 49,
+      ['y'] = 50, ['z'] = 51};
+  static const char zero = 'A';
+  /* Only 'A' legitimately maps to 0; everything else at 0 is invalid. */
+  if (ch != zero && table[(unsigned char)ch] == 0) return (unsigned int)-1;
+  return table[(unsigned char)ch];
+}
+
+static char* jsontw_partialbase64(jsontw* t, const char* ptr, const char* end,
+                                  char* out) {
+  int32_t val = -1;
+
+  switch (end - ptr) {
+    case 2:
+      val = jsontw_base64_tablelookup(ptr[0]) << 18 |
+            jsontw_base64_tablelookup(ptr[1]) << 12;
+      out[0] = val >> 16;
+      out += 1;
+      break;
+    case 3:
+      val = jsontw_base64_tablelookup(ptr[0]) << 18 |
+            jsontw_base64_tablelookup(ptr[1]) << 12 |
+            jsontw_base64_tablelookup(ptr[2]) << 6;
+      out[0] = val >> 16;
+      out[1] = (val >> 8) & 0xff;
+      out += 2;
+      break;
+  }
+
+  if (val < 0) {
+    jsontw_err(t, "Corrupt base64");
+  }
+
+  return out;
+}
+
+static size_t jsontw_base64(jsontw* t, upb_StringView str) {
+  /* Decodes in place; safe because the string is in the scratch buffer and
+   * base64 decoding shrinks 4 bytes into 3. */
+  char* out = (char*)str.data;
+  const char* ptr = str.data;
+  const char* end = ptr + str.size;
+  const char* end4 = ptr + (str.size & -4); /* Round down to multiple of 4. */
+
+  for (; ptr < end4; ptr += 4, out += 3) {
+    int val = jsontw_base64_tablelookup(ptr[0]) << 18 |
+              jsontw_base64_tablelookup(ptr[1]) << 12 |
+              jsontw_base64_tablelookup(ptr[2]) << 6 |
+              jsontw_base64_tablelookup(ptr[3]) << 0;
+
+    if (val < 0) {
+      /* Junk chars or padding. Remove trailing padding, if any. */
+      if (end - ptr == 4 && ptr[3] == '=') {
+        if (ptr[2] == '=') {
+          end -= 2;
+        } else {
+          end -= 1;
+        }
+      }
+      break;
+    }
+
+    out[0] = val >> 16;
+    out[1] = (val >> 8) & 0xff;
+    out[2] = val & 0xff;
+  }
+
+  if (ptr < end) {
+    /* Process remaining chars. We do not require padding. */
+    out = jsontw_partialbase64(t, ptr, end, out);
+  }
+
+  return out - str.data;
+}
+
+/* Low-level integer parsing. *******************************************/
+
+static const char* jsontw_buftouint64(jsontw* t, const char* ptr,
+                                      const char* end, uint64_t* val) {
+  const char* out = upb_BufToUint64(ptr, end, val);
+  if (!out) jsontw_err(t, "Integer overflow");
+  return out;
+}
+
+static const char* jsontw_buftoint64(jsontw* t, const char* ptr,
+                                     const char* end, int64_t* val,
+                                     bool* is_neg) {
+  const char* out = upb_BufToInt64(ptr, end, val, is_neg);
+  if (!out) jsontw_err(t, "Integer overflow");
+  return out;
+}
+
+static uint64_t jsontw_strtouint64(jsontw* t, upb_StringView str) {
+  const char* end = str.data + str.size;
+  uint64_t ret;
+  if (jsontw_buftouint64(t, str.data, end, &ret) != end) {
+    jsontw_err(t, "Non-number characters in quoted integer");
+  }
+  return ret;
+}
+
+static int64_t jsontw_strtoint64(jsontw* t, upb_StringView str) {
+  const char* end = str.data + str.size;
+  int64_t ret;
+  if (jsontw_buftoint64(t, str.data, end, &ret, NULL) != end) {
+    jsontw_err(t, "Non-number characters in quoted integer");
+  }
+  return ret;
+}
+
+/* Primitive value types, as in decode.c. *******************************/
+
+/* Parse INT32 or INT64 value. */
+static upb_MessageValue jsontw_int(jsontw* t, const upb_FieldDef* f) {
+  upb_MessageValue val;
+
+  switch (jsontw_peek(t)) {
+    case JW_NUMBER: {
+      double dbl = jsontw_number(t);
+      if (dbl > 9223372036854774784.0 || dbl < -9223372036854775808.0) {
+        jsontw_err(t, "JSON number is out of range.");
+      }
+      val.int64_val = dbl; /* must be guarded, overflow here is UB */
+      if (val.int64_val != dbl) {
+        jsontw_errf(t, "JSON number was not integral (%f != %" PRId64 ")", dbl,
+                    val.int64_val);
+      }
+      break;
+    }
+    case JW_STRING: {
+      upb_StringView str = jsontw_string(t);
+      val.int64_val = jsontw_strtoint64(t, str);
+      break;
+    }
+    default:
+      jsontw_err(t, "Expected number or string");
+  }
+
+  if (upb_FieldDef_CType(f) == kUpb_CType_Int32 ||
+      upb_FieldDef_CType(f) == kUpb_CType_Enum) {
+    if (val.int64_val > INT32_MAX || val.int64_val < INT32_MIN) {
+      jsontw_err(t, "Integer out of range.");
+    }
+    val.int32_val = (int32_t)val.int64_val;
+  }
+
+  return val;
+}
+
+/* Parse UINT32 or UINT64 value. */
+static upb_MessageValue jsontw_uint(jsontw* t, const upb_FieldDef* f) {
+  upb_MessageValue val = {0};
+
+  switch (jsontw_peek(t)) {
+    case JW_NUMBER: {
+      double dbl = jsontw_number(t);
+      if (dbl > 18446744073709549568.0 || dbl < 0) {
+        jsontw_err(t, "JSON number is out of range.");
+      }
+      val.uint64_val = dbl; /* must be guarded, overflow here is UB */
+      if (val.uint64_val != dbl) {
+        jsontw_errf(t, "JSON number was not integral (%f != %" PRIu64 ")", dbl,
+                    val.uint64_val);
+      }
+      break;
+    }
+    case JW_STRING: {
+      upb_StringView str = jsontw_string(t);
+      val.uint64_val = jsontw_strtouint64(t, str);
+      break;
+    }
+    default:
+      jsontw_err(t, "Expected number or string");
+  }
+
+  if (upb_FieldDef_CType(f) == kUpb_CType_UInt32) {
+    if (val.uint64_val > UINT32_MAX) {
+      jsontw_err(t, "Integer out of range.");
+    }
+    val.uint32_val = (uint32_t)val.uint64_val;
+  }
+
+  return val;
+}
+
+/* Parse DOUBLE or FLOAT value. */
+static upb_MessageValue jsontw_double(jsontw* t, const upb_FieldDef* f) {
+  upb_StringView str;
+  upb_MessageValue val = {0};
+
+  switch (jsontw_peek(t)) {
+    case JW_NUMBER:
+      val.double_val = jsontw_number(t);
+      break;
+    case JW_STRING:
+      str = jsontw_string(t);
+      if (jsontw_streql(str, "NaN")) {
+        val.double_val = NAN;
+      } else if (jsontw_streql(str, "Infinity")) {
+        val.double_val = INFINITY;
+      } else if (jsontw_streql(str, "-Infinity")) {
+        val.double_val = -INFINITY;
+      } else {
+        val.double_val = strtod(str.data, NULL);
+      }
+      break;
+    default:
+      jsontw_err(t, "Expected number or string");
+  }
+
+  if (upb_FieldDef_CType(f) == kUpb_CType_Float) {
+    float fl = val.double_val;
+    if (val.double_val != INFINITY && val.double_val != -INFINITY) {
+      if (fl == INFINITY || fl == -INFINITY) {
+        jsontw_err(t, "Float out of range");
+      }
+    }
+    val.float_val = fl;
+  }
+
+  return val;
+}
+
+/* Parse STRING or BYTES value (into the scratch buffer). */
+static upb_MessageValue jsontw_strfield(jsontw* t, const upb_FieldDef* f) {
+  upb_MessageValue val;
+  val.str_val = jsontw_string(t);
+  if (upb_FieldDef_CType(f) == kUpb_CType_Bytes) {
+    val.str_val.size = jsontw_base64(t, val.str_val);
+  }
+  return val;
+}
+
+static upb_MessageValue jsontw_enum(jsontw* t, const upb_FieldDef* f) {
+  switch (jsontw_peek(t)) {
+    case JW_STRING: {
+      upb_StringView str = jsontw_string(t);
+      const upb_EnumDef* e = upb_FieldDef_EnumSubDef(f);
+      const upb_EnumValueDef* ev =
+          upb_EnumDef_FindValueByNameWithSize(e, str.data, str.size);
+      upb_MessageValue val;
+      if (ev) {
+        val.int32_val = upb_EnumValueDef_Number(ev);
+      } else {
+        if (t->options & upb_JsonDecode_IgnoreUnknown) {
+          val.int32_val = 0;
+        } else {
+          jsontw_errf(t, "Unknown enumerator: '" UPB_STRINGVIEW_FORMAT "'",
+                      UPB_STRINGVIEW_ARGS(str));
+        }
+      }
+      return val;
+    }
+    case JW_NULL: {
+      if (jsontw_isnullvalue(f)) {
+        upb_MessageValue val;
+        jsontw_null(t);
+        val.int32_val = 0;
+        return val;
+      }
+    }
+      /* Fallthrough. */
+    default:
+      return jsontw_int(t, f);
+  }
+}
+
+static upb_MessageValue jsontw_bool(jsontw* t, const upb_FieldDef* f) {
+  bool is_map_key = upb_FieldDef_Number(f) == 1 &&
+                    upb_MessageDef_IsMapEntry(upb_FieldDef_ContainingType(f));
+  upb_MessageValue val;
+
+  if (is_map_key) {
+    upb_StringView str = jsontw_string(t);
+    if (jsontw_streql(str, "true")) {
+      val.bool_val = true;
+    } else if (jsontw_streql(str, "false")) {
+      val.bool_val = false;
+    } else {
+      jsontw_err(t, "Invalid boolean map key");
+    }
+  } else {
+    switch (jsontw_peek(t)) {
+      case JW_TRUE:
+        val.bool_val = true;
+        jsontw_true(t);
+        break;
+      case JW_FALSE:
+        val.bool_val = false;
+        jsontw_false(t);
+        break;
+      default:
+        jsontw_err(t, "Expected true or false");
+    }
+  }
+
+  return val;
+}
+
+static upb_MessageValue jsontw_value(jsontw* t, const upb_FieldDef* f) {
+  switch (upb_FieldDef_CType(f)) {
+    case kUpb_CType_Bool:
+      return jsontw_bool(t, f);
+    case kUpb_CType_Float:
+    case kUpb_CType_Double:
+      return jsontw_double(t, f);
+    case kUpb_CType_UInt32:
+    case kUpb_CType_UInt64:
+      return jsontw_uint(t, f);
+    case kUpb_CType_Int32:
+    case kUpb_CType_Int64:
+      return jsontw_int(t, f);
+    case kUpb_CType_String:
+    case kUpb_CType_Bytes:
+      return jsontw_strfield(t, f);
+    case kUpb_CType_Enum:
+      return jsontw_enum(t, f);
+    default:
+      UPB_UNREACHABLE();
+  }
+}
+
+/* Value emission. ******************************************************/
+
+// Emits just the encoded value of |val| (no tag), as wire type
+// jsontx_wiretype(f).
+static void jsontw_putraw(jsontw* t, const upb_FieldDef* f,
+                          upb_MessageValue val) {
+  switch (upb_FieldDef_Type(f)) {
+    case kUpb_FieldType_Bool:
+      jsontw_outvarint(t, val.bool_val);
+      break;
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_Enum:
+      jsontw_outvarint(t, (uint64_t)(int64_t)val.int32_val);
+      break;
+    case kUpb_FieldType_Int64:
+      jsontw_outvarint(t, (uint64_t)val.int64_val);
+      break;
+    case kUpb_FieldType_UInt32:
+      jsontw_outvarint(t, val.uint32_val);
+      break;
+    case kUpb_FieldType_UInt64:
+      jsontw_outvarint(t, val.uint64_val);
+      break;
+    case kUpb_FieldType_SInt32:
+      jsontw_outvarint(t, ((uint32_t)val.int32_val << 1) ^
+                              (uint32_t)(val.int32_val >> 31));
+      break;
+    case kUpb_FieldType_SInt64:
+      jsontw_outvarint(t, ((uint64_t)val.int64_val << 1) ^
+                              (uint64_t)(val.int64_val >> 63));
+      break;
+    case kUpb_FieldType_Fixed32:
+      jsontw_outfixed32(t, val.uint32_val);
+      break;
+    case kUpb_FieldType_SFixed32:
+      jsontw_outfixed32(t, (uint32_t)val.int32_val);
+      break;
+    case kUpb_FieldType_Float: {
+      uint32_t bits;
+      memcpy(&bits, &val.float_val, 4);
+      jsontw_outfixed32(t, bits);
+      break;
+    }
+    case kUpb_FieldType_Fixed64:
+      jsontw_outfixed64(t, val.uint64_val);
+      break;
+    case kUpb_FieldType_SFixed64:
+      jsontw_outfixed64(t, (uint64_t)val.int64_val);
+      break;
+    case kUpb_FieldType_Double: {
+      uint64_t bits;
+      memcpy(&bits, &val.double_val, 8);
+      jsontw_outfixed64(t, bits);
+      break;
+    }
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes:
+      jsontw_outvarint(t, val.str_val.size);
+      jsontw_outbytes(t, val.str_val.data, val.str_val.size);
+      break;
+    case kUpb_FieldType_Message:
+    case kUpb_FieldType_Group:
+      UPB_UNREACHABLE();
+  }
+}
+
+static void jsontw_putfield(jsontw* t, const upb_FieldDef* f,
+                            upb_MessageValue val) {
+  jsontw_outtag(t, f, jsontx_wiretype(f));
+  jsontw_putraw(t, f, val);
+}
+
+static bool jsontw_isdefault(const upb_FieldDef* f, upb_MessageValue val) {
+  switch (upb_FieldDef_CType(f)) {
+    case kUpb_CType_Bool:
+      return !val.bool_val;
+    case kUpb_CType_Float:
+      return val.float_val == 0;
+    case kUpb_CType_Double:
+      return val.double_val == 0;
+    case kUpb_CType_Int32:
+    case kUpb_CType_Enum:
+      return val.int32_val == 0;
+    case kUpb_CType_UInt32:
+      return val.uint32_val == 0;
+    case kUpb_CType_Int64:
+      return val.int64_val == 0;
+    case kUpb_CType_UInt64:
+      return val.uint64_val == 0;
+    case kUpb_CType_String:
+    case kUpb_CType_Bytes:
+      return val.str_val.size == 0;
+    default:
+      UPB_UNREACHABLE();
+  }
+}
+
+/* Composite types (array/message/map). *********************************/
+
+static void jsontw_submsgfield(jsontw* t, const upb_FieldDef* f) {
+  const upb_MessageDef* sub_m = upb_FieldDef_MessageSubDef(f);
+  if (upb_FieldDef_Type(f) == kUpb_FieldType_Group) {
+    jsontw_outtag(t, f, kUpb_WireType_StartGroup);
+    jsontw_tomsg(t, sub_m);
+    jsontw_outtag(t, f, kUpb_WireType_EndGroup);
+  } else {
+    jsontw_outtag(t, f, kUpb_WireType_Delimited);
+    size_t at = t->pos;
+    jsontw_tomsg(t, sub_m);
+    jsontw_patchlen(t, at);
+  }
+}
+
+static void jsontw_array(jsontw* t, const upb_FieldDef* f) {
+  jsontw_arrstart(t);
+  if (upb_FieldDef_IsSubMessage(f)) {
+    while (jsontw_arrnext(t)) {
+      jsontw_submsgfield(t, f);
+    }
+  } else if (upb_FieldDef_IsPacked(f) && jsontx_ispackable(f)) {
+    // The tag and length prefix are withheld until the first element so
+    // that an empty array encodes to nothing, as an empty upb_Array does.
+    bool first = true;
+    size_t at = 0;
+    while (jsontw_arrnext(t)) {
+      if (first) {
+        jsontw_outtag(t, f, kUpb_WireType_Delimited);
+        at = t->pos;
+        first = false;
+      }
+      jsontw_putraw(t, f, jsontw_value(t, f));
+    }
+    if (!first) jsontw_patchlen(t, at);
+  } else {
+    while (jsontw_arrnext(t)) {
+      jsontw_putfield(t, f, jsontw_value(t, f));
+    }
+  }
+  jsontw_arrend(t);
+}
+
+static void jsontw_map(jsontw* t, const upb_FieldDef* f) {
+  const upb_MessageDef* entry_m = upb_FieldDef_MessageSubDef(f);
+  const upb_FieldDef* key_f = upb_MessageDef_FindFieldByNumber(entry_m, 1);
+  const upb_FieldDef* val_f = upb_MessageDef_FindFieldByNumber(entry_m, 2);
+
+  jsontw_objstart(t);
+  while (jsontw_objnext(t)) {
+    jsontw_outtag(t, f, kUpb_WireType_Delimited);
+    size_t at = t->pos;
+    // Map entries always carry both key and value, as upb_Encode() emits
+    // them.  A duplicated JSON key yields two entries; the parser keeps
+    // the last, as upb_Map_Set() does.
+    jsontw_putfield(t, key_f, jsontw_value(t, key_f));
+    jsontw_entrysep(t);
+    if (upb_FieldDef_IsSubMessage(val_f)) {
+      jsontw_submsgfield(t, val_f);
+    } else {
+      jsontw_putfield(t, val_f, jsontw_value(t, val_f));
+    }
+    jsontw_patchlen(t, at);
+  }
+  jsontw_objend(t);
+}
+
+// Everything after the field's name and ':' separator.
+static void jsontw_fieldvalue(jsontw* t, const upb_FieldDef* f) {
+  if (jsontw_peek(t) == JW_NULL && !jsontw_isvalue(f)) {
+    /* JSON "null" indicates a default value, so nothing is emitted. */
+    jsontw_null(t);
+    return;
+  }
+
+  if (upb_FieldDef_IsMap(f)) {
+    jsontw_map(t, f);
+  } else if (upb_FieldDef_IsRepeated(f)) {
+    jsontw_array(t, f);
+  } else if (upb_FieldDef_IsSubMessage(f)) {
+    jsontw_submsgfield(t, f);
+  } else {
+    jsontw_putfield(t, f, jsontw_value(t, f));
+  }
+}
+
+static const upb_FieldDef* jsontw_lookupname(jsontw* t, upb_StringView name,
+                                             const upb_MessageDef* m) {
+  const upb_FieldDef* f;
+  if (name.size >= 2 && name.data[0] == '[' &&
+      name.data[name.size - 1] == ']') {
+    f = upb_DefPool_FindExtensionByNameWithSize(t->symtab, name.data + 1,
+                                                name.size - 2);
+    if (f && upb_FieldDef_ContainingType(f) != m) {
+      jsontw_errf(
+          t, "Extension %s extends message %s, but was seen in message %s",
+          upb_FieldDef_FullName(f),
+          upb_MessageDef_FullName(upb_FieldDef_ContainingType(f)),
+          upb_MessageDef_FullName(m));
+    }
+  } else {
+    f = upb_MessageDef_FindByJsonNameWithSize(m, name.data, name.size);
+  }
+
+  if (!f) {
+    if ((t->options & upb_JsonDecode_IgnoreUnknown) == 0) {
+      jsontw_errf(t, "No such field: " UPB_STRINGVIEW_FORMAT,
+                  UPB_STRINGVIEW_ARGS(name));
+    }
+    jsontw_skipval(t);
+  }
+  return f;
+}
+
+static void jsontw_field(jsontw* t, const upb_MessageDef* m) {
+  upb_StringView name = jsontw_name(t);
+  jsontw_entrysep(t);
+  const upb_FieldDef* f = jsontw_lookupname(t, name, m);
+  if (f) jsontw_fieldvalue(t, f);
+}
+
+static void jsontw_object(jsontw* t, const upb_MessageDef* m) {
+  jsontw_objstart(t);
+  while (jsontw_objnext(t)) {
+    jsontw_field(t, m);
+  }
+  jsontw_objend(t);
+}
+
+/* Well-known types. ****************************************************/
+
+// The fields of the well-known types have no presence, so default values
+// are skipped, exactly as upb_Encode() would skip them.
+static void jsontw_putnondefault(jsontw* t, const upb_FieldDef* f,
+                                 upb_MessageValue val) {
+  if (!jsontw_isdefault(f, val)) jsontw_putfield(t, f, val);
+}
+
+static void jsontw_towkt2(jsontw* t, const upb_MessageDef* m, int64_t seconds,
+                          int32_t nanos) {
+  const upb_FieldDef* seconds_f = upb_MessageDef_FindFieldByNumber(m, 1);
+  const upb_FieldDef* nanos_f = upb_MessageDef_FindFieldByNumber(m, 2);
+  upb_MessageValue val;
+  val.int64_val = seconds;
+  jsontw_putnondefault(t, seconds_f, val);
+  val.int32_val = nanos;
+  jsontw_putnondefault(t, nanos_f, val);
+}
+
+static int jsontw_tsdigits(jsontw* t, const char** ptr, size_t digits,
+                           const char* after) {
+  uint64_t val;
+  const char* p = *ptr;
+  const char* end = p + digits;
+  size_t after_len = after ? strlen(after) : 0;
+
+  UPB_ASSERT(digits <= 9); /* int can't overflow. */
+
+  if (jsontw_buftouint64(t, p, end, &val) != end ||
+      (after_len && memcmp(end, after, after_len) != 0)) {
+    jsontw_err(t, "Malformed timestamp");
+  }
+
+  UPB_ASSERT(val < INT_MAX);
+
+  *ptr = end + after_len;
+  return (int)val;
+}
+
+static int jsontw_nanosstr(jsontw* t, const char** ptr, const char* end) {
+  uint64_t nanos = 0;
+  const char* p = *ptr;
+
+  if (p != end && *p == '.') {
+    const char* nano_end = jsontw_buftouint64(t, p + 1, end, &nanos);
+    int digits = (int)(nano_end - p - 1);
+    int exp_lg10 = 9 - digits;
+    if (digits > 9) {
+      jsontw_err(t, "Too many digits for partial seconds");
+    }
+    while (exp_lg10--) nanos *= 10;
+    *ptr = nano_end;
+  }
+
+  UPB_ASSERT(nanos < INT_MAX);
+
+  return (int)nanos;
+}
+
+/* jsontw_epochdays(1970, 1, 1) == 1970-01-01 == 0. */
+static int jsontw_epochdays(int y, int m, int d) {
+  const uint32_t year_base = 4800; /* Before min year, multiple of 400. */
+  const uint32_t m_adj = m - 3;    /* March-based month. */
+  const uint32_t carry = m_adj > (uint32_t)m ? 1 : 0;
+  const uint32_t adjust = carry ? 12 : 0;
+  const uint32_t y_adj = y + year_base - carry;
+  const uint32_t month_days = ((m_adj + adjust) * 62719 + 769) / 2048;
+  const uint32_t leap_days = y_adj / 4 - y_adj / 100 + y_adj / 400;
+  return y_adj * 365 + leap_days + month_days + (d - 1) - 2472632;
+}
+
+static void jsontw_timestamp(jsontw* t, const upb_MessageDef* m) {
+  int64_t seconds;
+  int32_t nanos;
+  upb_StringView str = jsontw_string(t);
+  const char* ptr = str.data;
+  const char* end = ptr + str.size;
+
+  if (str.size < 20) goto malformed;
+
+  {
+    /* 1972-01-01T01:00:00 */
+    int year = jsontw_tsdigits(t, &ptr, 4, "-");
+    int mon = jsontw_tsdigits(t, &ptr, 2, "-");
+    int day = jsontw_tsdigits(t, &ptr, 2, "T");
+    int hour = jsontw_tsdigits(t, &ptr, 2, ":");
+    int min = jsontw_tsdigits(t, &ptr, 2, ":");
+    int sec = jsontw_tsdigits(t, &ptr, 2, NULL);
+
+    seconds = (int64_t)jsontw_epochdays(year, mon, day) * 86400 +
+              hour * 3600 + min * 60 + sec;
+  }
+
+  nanos = jsontw_nanosstr(t, &ptr, end);
+
+  {
+    /* [+-]08:00 or Z */
+    int ofs_hour = 0;
+    int ofs_min = 0;
+    bool neg = false;
+
+    if (ptr == end) goto malformed;
+
+    switch (*ptr++) {
+      case '-':
+        neg = true;
+        /* fallthrough */
+      case '+':
+        if ((end - ptr) != 5) goto malformed;
+        ofs_hour = jsontw_tsdigits(t, &ptr, 2, ":");
+        ofs_min = jsontw_tsdigits(t, &ptr, 2, NULL);
+        ofs_min = ((ofs_hour * 60) + ofs_min) * 60;
+        seconds += (neg ? ofs_min : -ofs_min);
+        break;
+      case 'Z':
+        if (ptr != end) goto malformed;
+        break;
+      default:
+        goto malformed;
+    }
+  }
+
+  if (seconds < -62135596800) {
+    jsontw_err(t, "Timestamp out of range");
+  }
+
+  jsontw_towkt2(t, m, seconds, nanos);
+  return;
+
+malformed:
+  jsontw_err(t, "Malformed timestamp");
+}
+
+static void jsontw_duration(jsontw* t, const upb_MessageDef* m) {
+  int64_t seconds;
+  int32_t nanos;
+  upb_StringView str = jsontw_string(t);
+  const char* ptr = str.data;
+  const char* end = ptr + str.size;
+  const int64_t max = (uint64_t)3652500 * 86400;
+  bool neg = false;
+
+  /* "3.000000001s", "3s", etc. */
+  ptr = jsontw_buftoint64(t, ptr, end, &seconds, &neg);
+  nanos = jsontw_nanosstr(t, &ptr, end);
+
+  if (end - ptr != 1 || *ptr != 's') {
+    jsontw_err(t, "Malformed duration");
+  }
+
+  if (seconds < -max || seconds > max) {
+    jsontw_err(t, "Duration out of range");
+  }
+
+  if (neg) {
+    nanos = -nanos;
+  }
+
+  jsontw_towkt2(t, m, seconds, nanos);
+}
+
+static void jsontw_listvalue(jsontw* t, const upb_MessageDef* m) {
+  const upb_FieldDef* values_f = upb_MessageDef_FindFieldByNumber(m, 1);
+  const upb_MessageDef* value_m = upb_FieldDef_MessageSubDef(values_f);
+
+  jsontw_arrstart(t);
+  while (jsontw_arrnext(t)) {
+    jsontw_outtag(t, values_f, kUpb_WireType_Delimited);
+    size_t at = t->pos;
+    jsontw_wellknownvalue(t, value_m);
+    jsontw_patchlen(t, at);
+  }
+  jsontw_arrend(t);
+}
+
+static void jsontw_struct(jsontw* t, const upb_MessageDef* m) {
+  const upb_FieldDef* fields_f = upb_MessageDef_FindFieldByNumber(m, 1);
+  const upb_MessageDef* entry_m = upb_FieldDef_MessageSubDef(fields_f);
+  const upb_FieldDef* key_f = upb_MessageDef_FindFieldByNumber(entry_m, 1);
+  const upb_FieldDef* value_f = upb_MessageDef_FindFieldByNumber(entry_m, 2);
+  const upb_MessageDef* value_m = upb_FieldDef_MessageSubDef(value_f);
+
+  jsontw_objstart(t);
+  while (jsontw_objnext(t)) {
+    jsontw_outtag(t, fields_f, kUpb_WireType_Delimited);
+    size_t at = t->pos;
+    upb_MessageValue key;
+    key.str_val = jsontw_string(t);
+    jsontw_putfield(t, key_f, key);  // Emitted before scratch is reused.
+    jsontw_entrysep(t);
+    jsontw_outtag(t, value_f, kUpb_WireType_Delimited);
+    size_t vat = t->pos;
+    jsontw_wellknownvalue(t, value_m);
+    jsontw_patchlen(t, vat);
+    jsontw_patchlen(t, at);
+  }
+  jsontw_objend(t);
+}
+
+static void jsontw_wellknownvalue(jsontw* t, const upb_MessageDef* m) {
+  upb_MessageValue val;
+  const upb_FieldDef* f;
+
+  switch (jsontw_peek(t)) {
+    case JW_NUMBER:
+      /* double number_value = 2; */
+      f = upb_MessageDef_FindFieldByNumber(m, 2);
+      val.double_val = jsontw_number(t);
+      break;
+    case JW_STRING:
+      /* string string_value = 3; */
+      f = upb_MessageDef_FindFieldByNumber(m, 3);
+      val.str_val = jsontw_string(t);
+      break;
+    case JW_FALSE:
+      /* bool bool_value = 4; */
+      f = upb_MessageDef_FindFieldByNumber(m, 4);
+      val.bool_val = false;
+      jsontw_false(t);
+      break;
+    case JW_TRUE:
+      /* bool bool_value = 4; */
+      f = upb_MessageDef_FindFieldByNumber(m, 4);
+      val.bool_val = true;
+      jsontw_true(t);
+      break;
+    case JW_NULL:
+      /* NullValue null_value = 1; */
+      f = upb_MessageDef_FindFieldByNumber(m, 1);
+      val.int32_val = 0;
+      jsontw_null(t);
+      break;
+    case JW_OBJECT: {
+      /* Struct struct_value = 5; */
+      f = upb_MessageDef_FindFieldByNumber(m, 5);
+      jsontw_outtag(t, f, kUpb_WireType_Delimited);
+      size_t at = t->pos;
+      jsontw_struct(t, upb_FieldDef_MessageSubDef(f));
+      jsontw_patchlen(t, at);
+      return;
+    }
+    case JW_ARRAY: {
+      /* ListValue list_value = 6; */
+      f = upb_MessageDef_FindFieldByNumber(m, 6);
+      jsontw_outtag(t, f, kUpb_WireType_Delimited);
+      size_t at = t->pos;
+      jsontw_listvalue(t, upb_FieldDef_MessageSubDef(f));
+      jsontw_patchlen(t, at);
+      return;
+    }
+    default:
+      UPB_UNREACHABLE();
+  }
+
+  /* The kind fields form a oneof, so even default values are emitted. */
+  jsontw_putfield(t, f, val);
+}
+
+static void jsontw_fieldmask(jsontw* t, const upb_MessageDef* m) {
+  /* repeated string paths = 1; */
+  const upb_FieldDef* paths_f = upb_MessageDef_FindFieldByNumber(m, 1);
+  upb_StringView str = jsontw_string(t);
+  const char* ptr = str.data;
+  const char* end = ptr + str.size;
+
+  while (ptr < end) {
+    /* Expanding lowerCamelCase to snake_case streams straight into the
+     * output; the length prefix is patched in afterward. */
+    jsontw_outtag(t, paths_f, kUpb_WireType_Delimited);
+    size_t at = t->pos;
+    while (ptr < end && *ptr != ',') {
+      char ch = *ptr++;
+      if (ch >= 'A' && ch <= 'Z') {
+        jsontw_outbyte(t, '_');
+        jsontw_outbyte(t, ch + 32);
+      } else if (ch == '_') {
+        jsontw_err(t, "field mask may not contain '_'");
+      } else {
+        jsontw_outbyte(t, ch);
+      }
+    }
+    jsontw_patchlen(t, at);
+    if (ptr < end) ptr++; /* Skip ','. */
+  }
+}
+
+static const upb_MessageDef* jsontw_typeurl(jsontw* t,
+                                            const upb_MessageDef* m) {
+  const upb_FieldDef* type_url_f = upb_MessageDef_FindFieldByNumber(m, 1);
+  const upb_MessageDef* type_m;
+  upb_StringView type_url = jsontw_string(t);
+  const char* end = type_url.data + type_url.size;
+  const char* ptr = end;
+  upb_MessageValue val;
+
+  val.str_val = type_url;
+  jsontw_putfield(t, type_url_f, val);
+
+  /* Find message name after the last '/' */
+  while (ptr > type_url.data && *--ptr != '/') {
+  }
+
+  if (ptr == type_url.data || ptr == end) {
+    jsontw_err(t, "Type url must have at least one '/' and non-empty host");
+  }
+
+  ptr++;
+  type_m = upb_DefPool_FindMessageByNameWithSize(t->symtab, ptr, end - ptr);
+
+  if (!type_m) {
+    jsontw_err(t, "Type was not found");
+  }
+
+  return type_m;
+}
+
+static void jsontw_any(jsontw* t, const upb_MessageDef* m) {
+  /* string type_url = 1;
+   * bytes value = 2; */
+  const upb_FieldDef* value_f = upb_MessageDef_FindFieldByNumber(m, 2);
+  const upb_MessageDef* any_m = NULL;
+
+  jsontw_objstart(t);
+  const char* obj_start = t->ptr;
+
+  /* First pass: find "@type", which is not necessarily first; it must be
+   * known before any other member can be encoded.  Emits field 1. */
+  while (!any_m && jsontw_objnext(t)) {
+    upb_StringView name = jsontw_name(t);
+    jsontw_entrysep(t);
+    if (jsontw_streql(name, "@type")) {
+      any_m = jsontw_typeurl(t, m);
+    } else {
+      jsontw_skipval(t);
+    }
+  }
+
+  if (!any_m) {
+    jsontw_err(t, "Any object didn't contain a '@type' field");
+  }
+
+  /* Second pass: rewind and encode every member except "@type" into the
+   * value submessage.  (The input is all in memory, so rewinding replaces
+   * decode.c's copy of the pre-"@type" span.) */
+  t->ptr = obj_start;
+  t->is_first = true;
+
+  jsontw_outtag(t, value_f, kUpb_WireType_Delimited);
+  size_t at = t->pos;
+  while (jsontw_objnext(t)) {
+    upb_StringView name = jsontw_name(t);
+    jsontw_entrysep(t);
+    if (jsontw_streql(name, "@type")) {
+      jsontw_skipval(t);
+    } else if (upb_MessageDef_WellKnownType(any_m) ==
+               kUpb_WellKnown_Unspecified) {
+      /* For regular types: {"@type": "[user type]", "f1": <V1>, ...} */
+      const upb_FieldDef* f = jsontw_lookupname(t, name, any_m);
+      if (f) jsontw_fieldvalue(t, f);
+    } else {
+      /* For well-known types: {"@type": "[well-known type]", "value": <X>}
+       * where <X> is whatever encoding the WKT normally uses. */
+      if (!jsontw_streql(name, "value")) {
+        jsontw_err(t, "Key for well-known type must be 'value'");
+      }
+      jsontw_wellknown(t, any_m);
+    }
+  }
+  jsontw_patchlen(t, at);
+
+  jsontw_objend(t);
+}
+
+static void jsontw_wrapper(jsontw* t, const upb_MessageDef* m) {
+  const upb_FieldDef* value_f = upb_MessageDef_FindFieldByNumber(m, 1);
+  jsontw_putnondefault(t, value_f, jsontw_value(t, value_f));
+}
+
+static void jsontw_wellknown(jsontw* t, const upb_MessageDef* m) {
+  switch (upb_MessageDef_WellKnownType(m)) {
+    case kUpb_WellKnown_Any:
+      jsontw_any(t, m);
+      break;
+    case kUpb_WellKnown_FieldMask:
+      jsontw_fieldmask(t, m);
+      break;
+    case kUpb_WellKnown_Duration:
+      jsontw_duration(t, m);
+      break;
+    case kUpb_WellKnown_Timestamp:
+      jsontw_timestamp(t, m);
+      break;
+    case kUpb_WellKnown_Value:
+      jsontw_wellknownvalue(t, m);
+      break;
+    case kUpb_WellKnown_ListValue:
+      jsontw_listvalue(t, m);
+      break;
+    case kUpb_WellKnown_Struct:
+      jsontw_struct(t, m);
+      break;
+    case kUpb_WellKnown_DoubleValue:
+    case kUpb_WellKnown_FloatValue:
+    case kUpb_WellKnown_Int64Value:
+    case kUpb_WellKnown_UInt64Value:
+    case kUpb_WellKnown_Int32Value:
+    case kUpb_WellKnown_UInt32Value:
+    case kUpb_WellKnown_StringValue:
+    case kUpb_WellKnown_BytesValue:
+    case kUpb_WellKnown_BoolValue:
+      jsontw_wrapper(t, m);
+      break;
+    default:
+      UPB_UNREACHABLE();
+  }
+}
+
+static void jsontw_tomsg(jsontw* t, const upb_MessageDef* m) {
+  if (upb_MessageDef_WellKnownType(m) == kUpb_WellKnown_Unspecified) {
+    jsontw_object(t, m);
+  } else {
+    jsontw_wellknown(t, m);
+  }
+}
+
+size_t upb_JsonTranscodeToWire(const char* json, size_t json_size,
+                               const upb_MessageDef* m,
+                               const upb_DefPool* symtab, int options,
+                               char* buf, size_t size, upb_Status* status) {
+  jsontw t;
+  size_t ret;
+
+  if (json_size == 0) return 0;
+
+  t.ptr = json;
+  t.end = json + json_size;
+  t.out = buf;
+  t.pos = 0;
+  t.cap = size;
+  t.symtab = symtab;
+  t.depth = 64;
+  t.options = options;
+  t.line = 1;
+  t.line_begin = t.ptr;
+  t.is_first = false;
+  t.scratch = NULL;
+  t.scratch_cap = 0;
+  t.status = status;
+
+  if (UPB_SETJMP(t.err)) {
+    ret = (size_t)-1;
+  } else {
+    jsontw_tomsg(&t, m);
+    ret = t.pos;
+  }
+
+  upb_gfree(t.scratch);
+  return ret;
+}
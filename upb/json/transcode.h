@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UPB_JSON_TRANSCODE_H_
+#define UPB_JSON_TRANSCODE_H_
+
+#include "upb/json/decode.h"  // For the upb_JsonDecode_* option flags.
+#include "upb/json/encode.h"  // For the upb_JsonEncode_* option flags.
+#include "upb/reflection/def.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Transcodes the binary wire-format message in [wire, wire+wire_size) of type
+ * |m| directly to JSON, without materializing a upb_Message: field names are
+ * resolved through the reflection in |m| and values are emitted as the wire
+ * bytes are walked, so the only memory used beyond the output buffer is the
+ * traversal stack.  The output is identical to upb_Decode() into a fresh
+ * message followed by upb_JsonEncode(), including the well-known-type JSON
+ * forms, with two documented exceptions: repeated occurrences of a
+ * non-repeated message-typed field are not merged field-by-field (the last
+ * occurrence wins wholesale), and object members follow wire order -- the
+ * same order upb_JsonEncode() uses for conventionally serialized messages,
+ * except that map entries follow first-occurrence order on the wire where
+ * upb_JsonEncode() uses the unspecified upb_Map iteration order.
+ *
+ * |ext_pool| is used to find extensions and to resolve google.protobuf.Any
+ * type URLs; if NULL, extensions are skipped and Any fields fail.  |options|
+ * accepts upb_JsonEncode_UseProtoNames and
+ * upb_JsonEncode_FormatEnumsAsIntegers; upb_JsonEncode_EmitDefaults is not
+ * supported (fields absent from the wire are simply absent).
+ *
+ * Output is placed in the given buffer, and always NULL-terminated.  The
+ * output size (excluding NULL) is returned, with the same snprintf()-style
+ * truncation semantics as upb_JsonEncode(); (size_t)-1 is returned on
+ * malformed input or other errors, with |status| set. */
+size_t upb_JsonTranscode(const char* wire, size_t wire_size,
+                         const upb_MessageDef* m, const upb_DefPool* ext_pool,
+                         int options, char* buf, size_t size,
+                         upb_Status* status);
+
+/* The reverse direction: transcodes the JSON message in [json, json+json_size)
+ * to binary wire format without materializing a upb_Message.  Encoded fields
+ * are emitted as JSON tokens are consumed; since a nested message's length
+ * prefix is not known until its closing brace, the bytes already emitted for
+ * it are shifted to make room for the prefix when it closes (serialized JSON
+ * rarely nests deeply, so in practice each byte moves a handful of times).
+ * The only allocation is one reusable buffer for unescaping JSON strings.
+ *
+ * Accepts the same JSON dialect as upb_JsonDecode(), including the
+ * well-known-type forms, extensions as "[full.name]" keys, and the
+ * upb_JsonDecode_IgnoreUnknown option; |symtab| resolves extensions and
+ * google.protobuf.Any type URLs.  Fields are encoded in the order the JSON
+ * presents them, which for conventionally ordered JSON matches
+ * upb_JsonDecode() + upb_Encode().  A repeated member of a oneof is not
+ * rejected as it is by upb_JsonDecode(); the later member simply overwrites
+ * the earlier one when the output is parsed, as in binary decoding.
+ *
+ * Returns the full encoded size; if it exceeds |size| the buffer contents
+ * are unspecified (unlike JSON output, truncated wire bytes are never
+ * usable, so only the returned size is meaningful).  No NUL terminator is
+ * written.  On malformed input (size_t)-1 is returned, with |status| set. */
+size_t upb_JsonTranscodeToWire(const char* json, size_t json_size,
+                               const upb_MessageDef* m,
+                               const upb_DefPool* symtab, int options,
+                               char* buf, size_t size, upb_Status* status);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_JSON_TRANSCODE_H_ */
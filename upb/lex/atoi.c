@@ -27,11 +27,54 @@
 
 #include "upb/lex/atoi.h"
 
+#include <string.h>
+
 // Must be last.
 #include "upb/port/def.inc"
 
+UPB_INLINE bool upb_Atoi_IsLittleEndian(void) {
+  int x = 1;
+  return *(char*)&x == 1;
+}
+
+// Returns true if all eight bytes of |chunk| are ASCII digits: every high
+// nibble must be 3 and no low nibble may carry when 6 is added (low <= 9).
+UPB_INLINE bool upb_Atoi_IsEightDigits(uint64_t chunk) {
+  const uint64_t high = chunk & 0xf0f0f0f0f0f0f0f0ULL;
+  const uint64_t carries =
+      ((chunk + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL) >> 4;
+  return (high | carries) == 0x3333333333333333ULL;
+}
+
+// Converts eight ASCII digits (little-endian in |chunk|, first digit in the
+// low byte) to their numeric value, combining neighbors in log2(8) steps.
+UPB_INLINE uint32_t upb_Atoi_ParseEightDigits(uint64_t chunk) {
+  uint64_t val = chunk & 0x0f0f0f0f0f0f0f0fULL;
+  val = (val * 10 + (val >> 8)) & 0x00ff00ff00ff00ffULL;
+  val = (val * 100 + (val >> 16)) & 0x0000ffff0000ffffULL;
+  return (uint32_t)(val * 10000 + (val >> 32));
+}
+
 const char* upb_BufToUint64(const char* ptr, const char* end, uint64_t* val) {
   uint64_t u64 = 0;
+
+  // Bulk path: consume eight digits per step.  Byte order within the chunk
+  // only matters for the value computation, so big-endian falls back to the
+  // scalar loop below.
+  if (upb_Atoi_IsLittleEndian()) {
+    while (end - ptr >= 8) {
+      uint64_t chunk;
+      memcpy(&chunk, ptr, 8);
+      if (!upb_Atoi_IsEightDigits(chunk)) break;
+      const uint32_t eight = upb_Atoi_ParseEightDigits(chunk);
+      if (u64 > (UINT64_MAX - eight) / 100000000) {
+        return NULL;  // integer overflow
+      }
+      u64 = u64 * 100000000 + eight;
+      ptr += 8;
+    }
+  }
+
   while (ptr < end) {
     unsigned ch = *ptr - '0';
     if (ch >= 10) break;
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/lex/itoa.h"
+
+#include <string.h>
+
+// Must be last.
+#include "upb/port/def.inc"
+
+size_t upb_UInt64ToString(uint64_t val, char* buf) {
+  char tmp[20];
+  char* end = tmp + sizeof(tmp);
+  char* ptr = end;
+  do {
+    *--ptr = (char)('0' + val % 10);
+    val /= 10;
+  } while (val);
+  const size_t len = end - ptr;
+  memcpy(buf, ptr, len);
+  buf[len] = '\0';
+  return len;
+}
+
+size_t upb_Int64ToString(int64_t val, char* buf) {
+  if (val >= 0) return upb_UInt64ToString((uint64_t)val, buf);
+  *buf = '-';
+  // Negating in unsigned space also handles INT64_MIN.
+  return 1 + upb_UInt64ToString(0u - (uint64_t)val, buf + 1);
+}
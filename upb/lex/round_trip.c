@@ -28,40 +28,425 @@
 #include "upb/lex/round_trip.h"
 
 #include <float.h>
-#include <stdlib.h>
+#include <string.h>
 
 // Must be last.
 #include "upb/port/def.inc"
 
-/* Miscellaneous utilities ****************************************************/
+/* Shortest round-trip binary-to-decimal conversion.
+ *
+ * This is the classic exact big-integer algorithm (Steele & White, as
+ * refined by Burger & Dybvig): the scaled fraction R/S tracks the value
+ * while the margins m-/m+ track the distance to the neighboring
+ * representable values, so digit generation can stop at the first prefix
+ * that identifies the value uniquely.  It needs no precomputed power
+ * tables and no libc formatting calls, which makes it locale-independent
+ * and much cheaper than the old approach of up to three
+ * snprintf("%.*g")/strtod round trips per number.  Margins are inclusive
+ * when the mantissa is even, because a parse that rounds ties to even
+ * maps the boundary itself back to the value. */
+
+/* Big enough for the largest intermediates: S scales up to ~2^1080 and
+ * R and the margins stay below 10*S. */
+#define kUpb_ToDecimal_Limbs 44
+
+typedef struct {
+  uint32_t limbs[kUpb_ToDecimal_Limbs]; /* Little-endian, base 2^32. */
+  int size;                             /* Number of significant limbs. */
+} upb_ToDecimal_Int;
+
+static void upb_ToDecimal_SetU64(upb_ToDecimal_Int* x, uint64_t v) {
+  x->limbs[0] = (uint32_t)v;
+  x->limbs[1] = (uint32_t)(v >> 32);
+  x->size = x->limbs[1] ? 2 : (x->limbs[0] ? 1 : 0);
+}
+
+static void upb_ToDecimal_MulSmall(upb_ToDecimal_Int* x, uint32_t m) {
+  uint64_t carry = 0;
+  for (int i = 0; i < x->size; i++) {
+    carry += (uint64_t)x->limbs[i] * m;
+    x->limbs[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+  if (carry) {
+    UPB_ASSERT(x->size < kUpb_ToDecimal_Limbs);
+    x->limbs[x->size++] = (uint32_t)carry;
+  }
+}
+
+static void upb_ToDecimal_Shl(upb_ToDecimal_Int* x, int bits) {
+  const int limb_shift = bits >> 5;
+  const int bit_shift = bits & 31;
+  if (x->size == 0) return;
+  int new_size = x->size + limb_shift + (bit_shift != 0);
+  UPB_ASSERT(new_size <= kUpb_ToDecimal_Limbs);
+  for (int i = new_size - 1; i >= 0; i--) {
+    const int src = i - limb_shift;
+    const uint32_t hi = (src >= 0 && src < x->size) ? x->limbs[src] : 0;
+    const uint32_t lo =
+        (src - 1 >= 0 && src - 1 < x->size) ? x->limbs[src - 1] : 0;
+    x->limbs[i] = bit_shift ? (hi << bit_shift) | (lo >> (32 - bit_shift)) : hi;
+  }
+  while (new_size > 0 && x->limbs[new_size - 1] == 0) new_size--;
+  x->size = new_size;
+}
+
+static void upb_ToDecimal_MulPow10(upb_ToDecimal_Int* x, int k) {
+  static const uint32_t pow10[9] = {1,      10,      100,      1000,    10000,
+                                    100000, 1000000, 10000000, 100000000};
+  while (k >= 9) {
+    upb_ToDecimal_MulSmall(x, 1000000000u);
+    k -= 9;
+  }
+  if (k > 0) upb_ToDecimal_MulSmall(x, pow10[k]);
+}
+
+static int upb_ToDecimal_Cmp(const upb_ToDecimal_Int* a,
+                             const upb_ToDecimal_Int* b) {
+  if (a->size != b->size) return a->size < b->size ? -1 : 1;
+  for (int i = a->size - 1; i >= 0; i--) {
+    if (a->limbs[i] != b->limbs[i]) return a->limbs[i] < b->limbs[i] ? -1 : 1;
+  }
+  return 0;
+}
+
+/* a -= b; requires a >= b. */
+static void upb_ToDecimal_Sub(upb_ToDecimal_Int* a, const upb_ToDecimal_Int* b) {
+  int64_t borrow = 0;
+  for (int i = 0; i < a->size; i++) {
+    const int64_t diff =
+        (int64_t)a->limbs[i] - (i < b->size ? b->limbs[i] : 0) - borrow;
+    borrow = diff < 0;
+    a->limbs[i] = (uint32_t)diff;
+  }
+  UPB_ASSERT(borrow == 0);
+  while (a->size > 0 && a->limbs[a->size - 1] == 0) a->size--;
+}
+
+/* Compares am*a + bm*b against c (am, bm are small scale factors). */
+static int upb_ToDecimal_CmpLinear(const upb_ToDecimal_Int* a, uint32_t am,
+                                   const upb_ToDecimal_Int* b, uint32_t bm,
+                                   const upb_ToDecimal_Int* c) {
+  upb_ToDecimal_Int sum;
+  uint64_t carry = 0;
+  int size = UPB_MAX(a->size, b->size);
+  UPB_ASSERT(size < kUpb_ToDecimal_Limbs);
+  for (int i = 0; i < size; i++) {
+    carry += (uint64_t)(i < a->size ? a->limbs[i] : 0) * am +
+             (uint64_t)(i < b->size ? b->limbs[i] : 0) * bm;
+    sum.limbs[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+  while (carry) {
+    UPB_ASSERT(size < kUpb_ToDecimal_Limbs);
+    sum.limbs[size++] = (uint32_t)carry;
+    carry >>= 32;
+  }
+  while (size > 0 && sum.limbs[size - 1] == 0) size--;
+  sum.size = size;
+  return upb_ToDecimal_Cmp(&sum, c);
+}
+
+/* Extracts one quotient digit: returns d = floor(R/S) (must be <= 9) and
+ * leaves R = R mod S.  The digit is estimated from the top limbs, which
+ * can only guess low, and corrected with at most a couple of subtractions. */
+static int upb_ToDecimal_DivStep(upb_ToDecimal_Int* R,
+                                 const upb_ToDecimal_Int* S) {
+  int d = 0;
+  const int j = S->size - 1;
+  if (R->size > j) {
+    uint64_t r_top = (uint64_t)R->limbs[j];
+    if (R->size > j + 1) r_top |= (uint64_t)R->limbs[j + 1] << 32;
+    d = (int)(r_top / ((uint64_t)S->limbs[j] + 1));
+    UPB_ASSERT(d <= 9);
+    if (d) {
+      /* R -= d*S, fused. */
+      uint64_t borrow = 0;
+      for (int i = 0; i < R->size; i++) {
+        borrow += (uint64_t)(i < S->size ? S->limbs[i] : 0) * (uint32_t)d;
+        const uint32_t sub = (uint32_t)borrow;
+        borrow >>= 32;
+        if (R->limbs[i] < sub) borrow++;
+        R->limbs[i] -= sub;
+      }
+      UPB_ASSERT(borrow == 0);
+      while (R->size > 0 && R->limbs[R->size - 1] == 0) R->size--;
+    }
+  }
+  while (upb_ToDecimal_Cmp(R, S) >= 0) {
+    upb_ToDecimal_Sub(R, S);
+    d++;
+  }
+  UPB_ASSERT(d <= 9);
+  return d;
+}
+
+/* Generates the shortest round-trip digits for v = f * 2^e (f > 0), where
+ * the distance to the next smaller representable value is 2^(e-1) and to
+ * the next larger is mplus_scale * 2^(e-1).  Returns the number of digits
+ * written to |digits| and sets |*dec_exp| so that v = 0.{digits} *
+ * 10^dec_exp. */
+static int upb_ToDecimal_Digits(uint64_t f, int e, uint32_t mplus_scale,
+                                char* digits, int* dec_exp) {
+  upb_ToDecimal_Int R, S, mminus;
+  const bool even = (f & 1) == 0;
+  /* Margins stay proportional throughout, so only m- is materialized; the
+   * upper margin is always mplus_scale * m-. */
+  const uint32_t ms = mplus_scale;
+
+  /* R/S = v; margins are scaled by the same factor as R.  Multiplying R
+   * and S by an extra 2 makes the half-gap margins integral. */
+  upb_ToDecimal_SetU64(&R, f);
+  upb_ToDecimal_SetU64(&S, 1);
+  upb_ToDecimal_SetU64(&mminus, 1);
+  if (e >= 0) {
+    upb_ToDecimal_Shl(&R, e + 1);
+    upb_ToDecimal_Shl(&mminus, e);
+    upb_ToDecimal_Shl(&S, 1);
+  } else {
+    upb_ToDecimal_Shl(&R, 1);
+    upb_ToDecimal_Shl(&S, 1 - e);
+  }
+
+  /* Estimate the decimal exponent and scale so that R/S lands in
+   * (1/10, 1]; the fixup loops below absorb any estimate error. */
+  int e2 = e + 64;
+  for (uint64_t t = f; !(t >> 63); t <<= 1) e2--; /* v = frac * 2^e2. */
+  int k = (int)(e2 * 0.30102999566398119521); /* ~log10(2), floor toward 0. */
+  if (k >= 0) {
+    upb_ToDecimal_MulPow10(&S, k);
+  } else {
+    upb_ToDecimal_MulPow10(&R, -k);
+    upb_ToDecimal_MulPow10(&mminus, -k);
+  }
+  const int high_cmp = even ? -1 : 0; /* "R + m+ > S", inclusive if even. */
+  while (upb_ToDecimal_CmpLinear(&R, 1, &mminus, ms, &S) > high_cmp) {
+    upb_ToDecimal_MulSmall(&S, 10);
+    k++;
+  }
+  while (upb_ToDecimal_CmpLinear(&R, 10, &mminus, 10 * ms, &S) <= high_cmp) {
+    upb_ToDecimal_MulSmall(&R, 10);
+    upb_ToDecimal_MulSmall(&mminus, 10);
+    k--;
+  }
+
+  int n = 0;
+  for (;;) {
+    upb_ToDecimal_MulSmall(&R, 10);
+    upb_ToDecimal_MulSmall(&mminus, 10);
+
+    int d = upb_ToDecimal_DivStep(&R, &S);
+
+    const bool low = upb_ToDecimal_Cmp(&R, &mminus) < (even ? 1 : 0);
+    const bool high = upb_ToDecimal_CmpLinear(&R, 1, &mminus, ms, &S) > high_cmp;
+    if (!low && !high) {
+      digits[n++] = (char)('0' + d);
+      UPB_ASSERT(n < 18);
+      continue;
+    }
+    if (low && high) {
+      /* Both directions round trip; pick the nearer one (2R vs S). */
+      upb_ToDecimal_Int r2 = R;
+      upb_ToDecimal_Shl(&r2, 1);
+      if (upb_ToDecimal_Cmp(&r2, &S) >= 0) d++;
+    } else if (high) {
+      d++;
+    }
+    if (d == 10) {
+      /* Rounding up overflowed the digit; carry into the prefix. */
+      digits[n++] = '0';
+      int i = n - 2;
+      while (i >= 0 && digits[i] == '9') digits[i--] = '0';
+      if (i >= 0) {
+        digits[i]++;
+      } else {
+        memmove(digits + 1, digits, n);
+        digits[0] = '1';
+        n++;
+        k++;
+      }
+    } else {
+      digits[n++] = (char)('0' + d);
+    }
+    break;
+  }
+
+  /* A carry can leave trailing zeros behind. */
+  while (n > 1 && digits[n - 1] == '0') n--;
+  *dec_exp = k;
+  return n;
+}
+
+/* Digits for a value that is exactly a (nonzero) integer below 2^53: the
+ * rounding interval spans less than +/-0.5, so the shortest representation
+ * is just the integer's own digits with trailing zeros stripped. */
+static int upb_ToDecimal_FromInteger(uint64_t u, char* digits, int* dec_exp) {
+  char rev[20] = {0};  // u != 0 guarantees a digit; the zero quiets GCC.
+  int len = 0;
+  while (u) {
+    rev[len++] = (char)('0' + (u % 10));
+    u /= 10;
+  }
+  int zeros = 0;
+  while (rev[zeros] == '0') zeros++;
+  for (int i = 0; i < len - zeros; i++) digits[i] = rev[len - 1 - i];
+  *dec_exp = len;
+  return len - zeros;
+}
 
-static void upb_FixLocale(char* p) {
-  /* printf() is dependent on locales; sadly there is no easy and portable way
-   * to avoid this. This little post-processing step will translate 1,2 -> 1.2
-   * since JSON needs the latter. Arguably a hack, but it is simple and the
-   * alternatives are far more complicated, platform-dependent, and/or larger
-   * in code size. */
-  for (; *p; p++) {
-    if (*p == ',') *p = '.';
+/* Formats digits/dec_exp the way printf("%g") would, choosing plain vs.
+ * exponential notation with the precision the old snprintf-based code
+ * would have used (DBL_DIG/FLT_DIG when that many digits suffice, the
+ * round-trip maximum otherwise), so output notation stays unchanged. */
+static void upb_ToDecimal_Format(bool neg, const char* digits, int n,
+                                 int dec_exp, int low_prec, int high_prec,
+                                 char* buf) {
+  char* p = buf;
+  if (neg) *p++ = '-';
+
+  const int x = dec_exp - 1; /* Exponent of the leading digit. */
+  const int prec = n <= low_prec ? low_prec : high_prec;
+  if (x < -4 || x >= prec) {
+    *p++ = digits[0];
+    if (n > 1) {
+      *p++ = '.';
+      memcpy(p, digits + 1, n - 1);
+      p += n - 1;
+    }
+    *p++ = 'e';
+    *p++ = x < 0 ? '-' : '+';
+    int ex = x < 0 ? -x : x;
+    if (ex >= 100) {
+      *p++ = (char)('0' + ex / 100);
+      ex %= 100;
+    }
+    *p++ = (char)('0' + ex / 10);
+    *p++ = (char)('0' + ex % 10);
+  } else if (dec_exp <= 0) {
+    *p++ = '0';
+    *p++ = '.';
+    for (int i = 0; i < -dec_exp; i++) *p++ = '0';
+    memcpy(p, digits, n);
+    p += n;
+  } else if (dec_exp >= n) {
+    memcpy(p, digits, n);
+    p += n;
+    for (int i = 0; i < dec_exp - n; i++) *p++ = '0';
+  } else {
+    memcpy(p, digits, dec_exp);
+    p += dec_exp;
+    *p++ = '.';
+    memcpy(p, digits + dec_exp, n - dec_exp);
+    p += n - dec_exp;
   }
+  *p = '\0';
 }
 
 void _upb_EncodeRoundTripDouble(double val, char* buf, size_t size) {
-  assert(size >= kUpb_RoundTripBufferSize);
-  snprintf(buf, size, "%.*g", DBL_DIG, val);
-  if (strtod(buf, NULL) != val) {
-    snprintf(buf, size, "%.*g", DBL_DIG + 2, val);
-    assert(strtod(buf, NULL) == val);
+  UPB_ASSERT(size >= kUpb_RoundTripBufferSize);
+  UPB_UNUSED(size);
+
+  uint64_t bits;
+  memcpy(&bits, &val, sizeof(bits));
+  const bool neg = bits >> 63;
+  const int biased = (int)((bits >> 52) & 0x7ff);
+  const uint64_t frac = bits & 0xfffffffffffffULL;
+
+  if (biased == 0x7ff) {
+    /* Matches what "%g" produced for these values. */
+    const char* special = frac ? "nan" : (neg ? "-inf" : "inf");
+    memcpy(buf, special, strlen(special) + 1);
+    return;
+  }
+  if ((bits << 1) == 0) {
+    memcpy(buf, neg ? "-0" : "0", neg ? 3 : 2);
+    return;
+  }
+
+  char digits[20];
+  int dec_exp;
+  int n;
+  const double av = neg ? -val : val;
+  if (av < 9007199254740992.0) { /* 2^53 */
+    const uint64_t u = (uint64_t)av;
+    if ((double)u == av) {
+      n = upb_ToDecimal_FromInteger(u, digits, &dec_exp);
+      upb_ToDecimal_Format(neg, digits, n, dec_exp, DBL_DIG, DBL_DIG + 2, buf);
+      return;
+    }
   }
-  upb_FixLocale(buf);
+
+  uint64_t mantissa;
+  int exponent;
+  bool power_of_two;
+  if (biased == 0) { /* Subnormal: gaps are equal on both sides. */
+    mantissa = frac;
+    exponent = -1074;
+    power_of_two = false;
+  } else {
+    mantissa = frac | (1ULL << 52);
+    exponent = biased - 1075;
+    /* At a power of two (other than the smallest normal) the gap below is
+     * half the gap above. */
+    power_of_two = frac == 0 && biased > 1;
+  }
+  if (power_of_two) {
+    n = upb_ToDecimal_Digits(mantissa * 2, exponent - 1, 2, digits, &dec_exp);
+  } else {
+    n = upb_ToDecimal_Digits(mantissa, exponent, 1, digits, &dec_exp);
+  }
+  upb_ToDecimal_Format(neg, digits, n, dec_exp, DBL_DIG, DBL_DIG + 2, buf);
 }
 
 void _upb_EncodeRoundTripFloat(float val, char* buf, size_t size) {
-  assert(size >= kUpb_RoundTripBufferSize);
-  snprintf(buf, size, "%.*g", FLT_DIG, val);
-  if (strtof(buf, NULL) != val) {
-    snprintf(buf, size, "%.*g", FLT_DIG + 3, val);
-    assert(strtof(buf, NULL) == val);
+  UPB_ASSERT(size >= kUpb_RoundTripBufferSize);
+  UPB_UNUSED(size);
+
+  uint32_t bits;
+  memcpy(&bits, &val, sizeof(bits));
+  const bool neg = bits >> 31;
+  const int biased = (int)((bits >> 23) & 0xff);
+  const uint32_t frac = bits & 0x7fffff;
+
+  if (biased == 0xff) {
+    const char* special = frac ? "nan" : (neg ? "-inf" : "inf");
+    memcpy(buf, special, strlen(special) + 1);
+    return;
+  }
+  if ((bits << 1) == 0) {
+    memcpy(buf, neg ? "-0" : "0", neg ? 3 : 2);
+    return;
+  }
+
+  char digits[20];
+  int dec_exp;
+  int n;
+  const double av = neg ? -(double)val : (double)val;
+  if (av < 16777216.0) { /* 2^24: above this the gap between floats exceeds 1. */
+    const uint64_t u = (uint64_t)av;
+    if ((double)u == av) {
+      n = upb_ToDecimal_FromInteger(u, digits, &dec_exp);
+      upb_ToDecimal_Format(neg, digits, n, dec_exp, FLT_DIG, FLT_DIG + 3, buf);
+      return;
+    }
+  }
+
+  uint64_t mantissa;
+  int exponent;
+  bool power_of_two;
+  if (biased == 0) { /* Subnormal. */
+    mantissa = frac;
+    exponent = -149;
+    power_of_two = false;
+  } else {
+    mantissa = frac | (1u << 23);
+    exponent = biased - 150;
+    power_of_two = frac == 0 && biased > 1;
+  }
+  if (power_of_two) {
+    n = upb_ToDecimal_Digits(mantissa * 2, exponent - 1, 2, digits, &dec_exp);
+  } else {
+    n = upb_ToDecimal_Digits(mantissa, exponent, 1, digits, &dec_exp);
   }
-  upb_FixLocale(buf);
+  upb_ToDecimal_Format(neg, digits, n, dec_exp, FLT_DIG, FLT_DIG + 3, buf);
 }
@@ -31,10 +31,10 @@
 // Must be last.
 #include "upb/port/def.inc"
 
-// Encodes a float or double that is round-trippable, but as short as possible.
-// These routines are not fully optimal (not guaranteed to be shortest), but are
-// short-ish and match the implementation that has been used in protobuf since
-// the beginning.
+// Encodes a float or double as the shortest decimal string that parses back
+// to the exact same value.  Output notation matches what the historical
+// snprintf("%g")-based implementation produced, but the conversion itself is
+// exact, locale-independent, and makes no libc formatting calls.
 
 // The given buffer size must be at least kUpb_RoundTripBufferSize.
 enum { kUpb_RoundTripBufferSize = 32 };
@@ -27,6 +27,7 @@
 
 #include "upb/lex/strtod.h"
 
+#include <float.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -95,3 +96,34 @@ double _upb_NoLocaleStrtod(const char *str, char **endptr) {
 
   return result;
 }
+
+bool _upb_Strtod_FastPath(uint64_t mantissa, int exp10, bool neg,
+                          double *val) {
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD != 0 && FLT_EVAL_METHOD != 1
+  // Excess-precision arithmetic (e.g. x87) could double-round.
+  return false;
+#else
+  // Powers of ten that are exactly representable as doubles.
+  static const double pow10[23] = {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+  if (mantissa >> 53) return false;  // Not exactly representable.
+  double d = (double)mantissa;
+  if (exp10 >= 0) {
+    if (exp10 > 22) {
+      // 10^(exp10-22) may fold into the mantissa if the product stays exact.
+      if (exp10 > 22 + 15) return false;
+      d *= pow10[exp10 - 22];
+      if (d > 9007199254740991.0) return false;  // 2^53 - 1
+      exp10 = 22;
+    }
+    d *= pow10[exp10];
+  } else {
+    if (exp10 < -22) return false;
+    d /= pow10[-exp10];
+  }
+  *val = neg ? -d : d;
+  return true;
+#endif
+}
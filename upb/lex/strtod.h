@@ -37,6 +37,14 @@ extern "C" {
 
 double _upb_NoLocaleStrtod(const char *str, char **endptr);
 
+// Fast path for converting a pre-parsed decimal (mantissa * 10^exp10, negated
+// if neg) to the correctly-rounded double, for inputs where both factors are
+// exactly representable so a single multiply or divide gives the right
+// answer.  Returns false when the inputs fall outside that range (or when the
+// platform evaluates arithmetic with excess precision); callers must then
+// fall back to a full-precision conversion such as strtod().
+bool _upb_Strtod_FastPath(uint64_t mantissa, int exp10, bool neg, double *val);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
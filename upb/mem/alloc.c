@@ -44,4 +44,32 @@ static void* upb_global_allocfunc(upb_alloc* alloc, void* ptr, size_t oldsize,
   }
 }
 
-upb_alloc upb_alloc_global = {&upb_global_allocfunc};
+// calloc() gets fresh (already-zero) pages from the OS for large requests
+// and skips the memset, which is exactly what zeroed arena blocks want.
+static void* upb_global_zeroedfunc(upb_alloc* alloc, size_t size) {
+  UPB_UNUSED(alloc);
+  return calloc(1, size);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+static void* upb_global_alignedfunc(upb_alloc* alloc, size_t size,
+                                    size_t alignment, int numa_node) {
+  UPB_UNUSED(alloc);
+  UPB_UNUSED(numa_node);  // Plain malloc() has no NUMA control.
+  void* ptr;
+  // posix_memalign() memory is freeable with free(), which keeps the
+  // contract that aligned allocations go through the regular free path.
+  if (posix_memalign(&ptr, alignment, size) != 0) return NULL;
+  return ptr;
+}
+
+upb_alloc upb_alloc_global = {&upb_global_allocfunc, &upb_global_alignedfunc,
+                              &upb_global_zeroedfunc};
+
+#else
+
+upb_alloc upb_alloc_global = {&upb_global_allocfunc, NULL,
+                              &upb_global_zeroedfunc};
+
+#endif
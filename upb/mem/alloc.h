@@ -44,6 +44,23 @@ typedef struct upb_alloc upb_alloc;
 typedef void* upb_alloc_func(upb_alloc* alloc, void* ptr, size_t oldsize,
                              size_t size);
 
+/* An optional aligned/hinted allocation entry point.  Returns `size` bytes
+ * aligned to `alignment` (a power of two), preferably resident on NUMA node
+ * `numa_node` (-1 = no preference; implementations without NUMA control
+ * ignore it).  Memory returned here MUST be freeable through the regular
+ * `func` free path (ptr, 0, 0), since callers do not track which entry point
+ * produced an allocation. */
+typedef void* upb_alloc_aligned_func(upb_alloc* alloc, size_t size,
+                                     size_t alignment, int numa_node);
+
+/* An optional zero-initialized allocation entry point (like `calloc()`).
+ * Implementations should prefer sources that are zero for free (fresh pages
+ * from the OS are) over memset-ing, since callers use this to elide their
+ * own clearing (see upb_ArenaPolicy::zeroed_blocks in upb/mem/arena.h).
+ * Memory returned here MUST be freeable through the regular `func` free
+ * path (ptr, 0, 0). */
+typedef void* upb_alloc_zeroed_func(upb_alloc* alloc, size_t size);
+
 /* A upb_alloc is a possibly-stateful allocator object.
  *
  * It could either be an arena allocator (which doesn't require individual
@@ -52,6 +69,14 @@ typedef void* upb_alloc_func(upb_alloc* alloc, void* ptr, size_t oldsize,
  * allocator. */
 struct upb_alloc {
   upb_alloc_func* func;
+
+  /* May be NULL if the allocator has no aligned entry point.  Used by the
+   * arena to request huge-page-aligned blocks (see upb/mem/arena.h). */
+  upb_alloc_aligned_func* aligned_func;
+
+  /* May be NULL if the allocator has no zeroed entry point.  Used by the
+   * arena to obtain guaranteed-zero blocks (see upb/mem/arena.h). */
+  upb_alloc_zeroed_func* zeroed_func;
 };
 
 UPB_INLINE void* upb_malloc(upb_alloc* alloc, size_t size) {
@@ -25,8 +25,13 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "upb/base/log2.h"
 #include "upb/mem/arena_internal.h"
+#include "upb/mem/shared_buffer.h"
 #include "upb/port/atomic.h"
+#ifdef UPB_PROFILE
+#include "upb/profile/profile.h"
+#endif
 
 // Must be last.
 #include "upb/port/def.inc"
@@ -35,6 +40,10 @@ struct _upb_MemBlock {
   // Atomic only for the benefit of SpaceAllocated().
   UPB_ATOMIC(_upb_MemBlock*) next;
   uint32_t size;
+  // Bytes left unused when the block was abandoned for a bigger one; set by
+  // upb_Arena_AllocBlock() and only read by upb_Arena_GetStats().  Lives in
+  // what would otherwise be struct padding.
+  uint32_t wasted;
   // Data follows.
 };
 
@@ -100,6 +109,34 @@ size_t upb_Arena_SpaceAllocated(upb_Arena* arena) {
   return memsize;
 }
 
+void upb_Arena_GetStats(upb_Arena* a, upb_ArenaStats* stats) {
+  memset(stats, 0, sizeof(*stats));
+  upb_Arena* arena = _upb_Arena_FindRoot(a).root;
+
+  while (arena != NULL) {
+    _upb_MemBlock* block = upb_Atomic_Load(&arena->blocks, memory_order_relaxed);
+    bool is_head = true;
+    while (block != NULL) {
+      size_t size = block->size;
+      stats->space_allocated += size;
+      stats->block_count++;
+      int lg2 = upb_Log2Ceiling((int)size);
+      if (lg2 > 31) lg2 = 31;
+      stats->blocks_by_size_log2[lg2]++;
+      // The arena's head still bump-allocates from the newest block; its
+      // remaining bytes are not yet wasted, just unused.
+      size_t waste = is_head ? (size_t)(arena->head.end - arena->head.ptr)
+                             : block->wasted;
+      stats->space_used += size - memblock_reserve - waste;
+      if (!is_head) stats->wasted_tail_bytes += waste;
+      is_head = false;
+      block = upb_Atomic_Load(&block->next, memory_order_relaxed);
+    }
+    arena = upb_Atomic_Load(&arena->next, memory_order_relaxed);
+    if (arena != NULL) stats->fused_arena_count++;
+  }
+}
+
 uint32_t upb_Arena_DebugRefCount(upb_Arena* a) {
   // These loads could probably be relaxed, but given that this is debug-only,
   // it's not worth introducing a new variant for it.
@@ -116,24 +153,176 @@ static void upb_Arena_AddBlock(upb_Arena* a, void* ptr, size_t size) {
 
   // Insert into linked list.
   block->size = (uint32_t)size;
+  block->wasted = 0;
   upb_Atomic_Init(&block->next, a->blocks);
   upb_Atomic_Store(&a->blocks, block, memory_order_release);
 
   a->head.ptr = UPB_PTR_AT(block, memblock_reserve, char);
   a->head.end = UPB_PTR_AT(block, size, char);
+  a->head.zero_end = a->head.ptr;  // Callers that know better raise this.
 
   UPB_POISON_MEMORY_REGION(a->head.ptr, a->head.end - a->head.ptr);
 }
 
+/* Thread-local block cache **************************************************/
+
+/* Servers commonly cycle through upb_Arena_New()/upb_Arena_Free() once per
+ * request, which makes the malloc()/free() pair for the arena's first block
+ * the hottest allocator call site in the process and a contention point in
+ * the global allocator.  We keep a small, bounded per-thread cache of
+ * recently freed blocks so that arena create/destroy in steady state touches
+ * no global allocator at all.  Only blocks from upb_alloc_global are cached;
+ * a custom upb_alloc may carry per-instance state that a thread-level cache
+ * cannot key on.  upb_Arena_FlushBlockCache() returns the cached memory. */
+
+#ifdef UPB_THREAD_LOCAL
+
+#ifndef UPB_ARENA_BLOCK_CACHE_MAX_BLOCKS
+#define UPB_ARENA_BLOCK_CACHE_MAX_BLOCKS 8
+#endif
+
+#ifndef UPB_ARENA_BLOCK_CACHE_MAX_BYTES
+#define UPB_ARENA_BLOCK_CACHE_MAX_BYTES (256 << 10)
+#endif
+
+typedef struct upb_CachedBlock {
+  struct upb_CachedBlock* next;
+  size_t size;
+} upb_CachedBlock;
+
+static UPB_THREAD_LOCAL upb_CachedBlock* upb_thread_block_cache = NULL;
+static UPB_THREAD_LOCAL size_t upb_thread_block_cache_count = 0;
+static UPB_THREAD_LOCAL size_t upb_thread_block_cache_bytes = 0;
+
+/* Takes ownership of (ptr, size) and returns true if it was cached. */
+static bool upb_Arena_CachePutBlock(upb_alloc* alloc, void* ptr, size_t size) {
+  if (alloc != &upb_alloc_global) return false;
+  if (size < sizeof(upb_CachedBlock)) return false;
+  if (upb_thread_block_cache_count >= UPB_ARENA_BLOCK_CACHE_MAX_BLOCKS ||
+      upb_thread_block_cache_bytes + size > UPB_ARENA_BLOCK_CACHE_MAX_BYTES) {
+    return false;
+  }
+  UPB_UNPOISON_MEMORY_REGION(ptr, size);
+  upb_CachedBlock* block = ptr;
+  block->next = upb_thread_block_cache;
+  block->size = size;
+  upb_thread_block_cache = block;
+  upb_thread_block_cache_count++;
+  upb_thread_block_cache_bytes += size;
+  return true;
+}
+
+/* Returns a cached block of at least |size| bytes (storing the actual size in
+ * |*actual|), or NULL if the cache has none. */
+static void* upb_Arena_CacheTakeBlock(upb_alloc* alloc, size_t size,
+                                      size_t* actual) {
+  if (alloc != &upb_alloc_global) return NULL;
+  for (upb_CachedBlock** p = &upb_thread_block_cache; *p; p = &(*p)->next) {
+    upb_CachedBlock* block = *p;
+    if (block->size >= size) {
+      *p = block->next;
+      upb_thread_block_cache_count--;
+      upb_thread_block_cache_bytes -= block->size;
+      *actual = block->size;
+      return block;
+    }
+  }
+  return NULL;
+}
+
+void upb_Arena_FlushBlockCache(void) {
+  upb_CachedBlock* block = upb_thread_block_cache;
+  while (block) {
+    upb_CachedBlock* next = block->next;
+    upb_free(&upb_alloc_global, block);
+    block = next;
+  }
+  upb_thread_block_cache = NULL;
+  upb_thread_block_cache_count = 0;
+  upb_thread_block_cache_bytes = 0;
+}
+
+#else /* !UPB_THREAD_LOCAL */
+
+static bool upb_Arena_CachePutBlock(upb_alloc* alloc, void* ptr, size_t size) {
+  return false;
+}
+
+static void* upb_Arena_CacheTakeBlock(upb_alloc* alloc, size_t size,
+                                      size_t* actual) {
+  return NULL;
+}
+
+void upb_Arena_FlushBlockCache(void) {}
+
+#endif /* UPB_THREAD_LOCAL */
+
+static upb_Arena_BlockAllocHook* upb_block_alloc_hook = NULL;
+
+upb_Arena_BlockAllocHook* upb_Arena_SetBlockAllocHook(
+    upb_Arena_BlockAllocHook* hook) {
+  upb_Arena_BlockAllocHook* old = upb_block_alloc_hook;
+  upb_block_alloc_hook = hook;
+  return old;
+}
+
+/* Blocks at least this large are requested huge-page aligned when the block
+ * allocator has an aligned entry point, so the kernel (or an explicit
+ * hugetlb-backed allocator) can back them with 2MB pages and cut TLB misses
+ * on large arena-resident message graphs. */
+#ifndef UPB_ARENA_HUGE_BLOCK_THRESHOLD
+#define UPB_ARENA_HUGE_BLOCK_THRESHOLD (2u << 20)
+#endif
+
+#define UPB_ARENA_HUGE_PAGE_SIZE (2u << 20)
+
+void upb_Arena_SetNumaNode(upb_Arena* a, int numa_node) {
+  a->numa_node = numa_node;
+}
+
 static bool upb_Arena_AllocBlock(upb_Arena* a, size_t size) {
+  UPB_PROFILE_BEGIN(profile_start);
   if (!a->block_alloc) return false;
+  upb_alloc* balloc = upb_Arena_BlockAlloc(a);
+  // upb_Arena_Init() with a NULL alloc gives a fixed-size arena: allocation
+  // fails rather than spilling outside the caller's block.
+  if (!balloc) return false;
   _upb_MemBlock* last_block = upb_Atomic_Load(&a->blocks, memory_order_acquire);
   size_t last_size = last_block != NULL ? last_block->size : 128;
-  size_t block_size = UPB_MAX(size, last_size * 2) + memblock_reserve;
-  _upb_MemBlock* block = upb_malloc(upb_Arena_BlockAlloc(a), block_size);
+  size_t target = last_size * a->growth_factor;
+  if (a->max_block_size && target > a->max_block_size) {
+    target = a->max_block_size;
+  }
+  size_t block_size = UPB_MAX(size, target) + memblock_reserve;
+  if (last_block) last_block->wasted = (uint32_t)_upb_ArenaHas(a);
+  _upb_MemBlock* block =
+      upb_Arena_CacheTakeBlock(balloc, block_size, &block_size);
+  if (!block && balloc->aligned_func &&
+      block_size >= UPB_ARENA_HUGE_BLOCK_THRESHOLD) {
+    block_size = UPB_ALIGN_UP(block_size, UPB_ARENA_HUGE_PAGE_SIZE);
+    block = balloc->aligned_func(balloc, block_size, UPB_ARENA_HUGE_PAGE_SIZE,
+                                 a->numa_node);
+  }
+  bool known_zero = false;
+  if (!block && a->zeroed_blocks && balloc->zeroed_func) {
+    // Fresh pages from the OS are already zero, so for large blocks the
+    // zeroed entry point (calloc() in the global allocator) costs nothing.
+    block = balloc->zeroed_func(balloc, block_size);
+    known_zero = block != NULL;
+  }
+  if (!block) block = upb_malloc(balloc, block_size);
 
   if (!block) return false;
+  if (a->zeroed_blocks && !known_zero) {
+    // Recycled or plain-malloc'd memory; one bulk clear here is still far
+    // cheaper than a memset per message carved from the block.
+    memset(UPB_PTR_AT(block, memblock_reserve, char), 0,
+           block_size - memblock_reserve);
+  }
   upb_Arena_AddBlock(a, block, block_size);
+  if (a->zeroed_blocks) a->head.zero_end = a->head.end;
+  if (upb_block_alloc_hook) upb_block_alloc_hook(a, block_size, size);
+  UPB_PROFILE_END(profile_start, kUpb_ProfileSubsystem_ArenaAlloc);
   return true;
 }
 
@@ -143,33 +332,80 @@ void* _upb_Arena_SlowMalloc(upb_Arena* a, size_t size) {
   return upb_Arena_Malloc(a, size);
 }
 
+bool _upb_Arena_ReserveSlow(upb_Arena* a, size_t size) {
+  if (!upb_Arena_AllocBlock(a, size)) return false; /* Out of memory. */
+  UPB_ASSERT(_upb_ArenaHas(a) >= size);
+  return true;
+}
+
 /* Public Arena API ***********************************************************/
 
-static upb_Arena* upb_Arena_InitSlow(upb_alloc* alloc) {
+static upb_Arena* upb_Arena_InitSlowSized(upb_alloc* alloc,
+                                          size_t first_block_size) {
   const size_t first_block_overhead = sizeof(upb_Arena) + memblock_reserve;
   upb_Arena* a;
 
   /* We need to malloc the initial block. */
   char* mem;
-  size_t n = first_block_overhead + 256;
-  if (!alloc || !(mem = upb_malloc(alloc, n))) {
+  size_t n = first_block_overhead + first_block_size;
+  if (!alloc) return NULL;
+  mem = upb_Arena_CacheTakeBlock(alloc, n, &n);
+  if (!mem && !(mem = upb_malloc(alloc, n))) {
     return NULL;
   }
 
+  /* A recycled block (or a caller-chosen first_block_size) may have any size;
+   * round down so the arena struct we place at the end is aligned. */
+  n = UPB_ALIGN_DOWN(n, UPB_ALIGN_OF(upb_Arena));
+
   a = UPB_PTR_AT(mem, n - sizeof(*a), upb_Arena);
   n -= sizeof(*a);
 
   a->block_alloc = upb_Arena_MakeBlockAlloc(alloc, 0);
+  a->growth_factor = 2;
+  a->max_block_size = 0;
+  a->numa_node = -1;
+  a->zeroed_blocks = false;
   upb_Atomic_Init(&a->parent_or_count, _upb_Arena_TaggedFromRefcount(1));
   upb_Atomic_Init(&a->next, NULL);
   upb_Atomic_Init(&a->tail, a);
   upb_Atomic_Init(&a->blocks, NULL);
+  upb_Atomic_Init(&a->cleanups, NULL);
+  a->intern_pool = NULL;
 
   upb_Arena_AddBlock(a, mem, n);
+  if (upb_block_alloc_hook) upb_block_alloc_hook(a, n, 0);
 
   return a;
 }
 
+static upb_Arena* upb_Arena_InitSlow(upb_alloc* alloc) {
+  return upb_Arena_InitSlowSized(alloc, 256);
+}
+
+upb_Arena* upb_Arena_NewWithPolicy(const upb_ArenaPolicy* policy,
+                                   upb_alloc* alloc) {
+  if (!alloc) alloc = &upb_alloc_global;
+  size_t initial = policy->initial_block_size ? policy->initial_block_size : 256;
+  if (policy->max_block_size && initial > policy->max_block_size) {
+    initial = policy->max_block_size;
+  }
+  upb_Arena* a = upb_Arena_InitSlowSized(alloc, initial);
+  if (!a) return NULL;
+  if (policy->growth_factor) a->growth_factor = policy->growth_factor;
+  a->max_block_size = (uint32_t)UPB_MIN(policy->max_block_size, UINT32_MAX);
+  if (policy->zeroed_blocks) {
+    // The initial block was allocated dirty above; clear its free space once
+    // so the zeroed-blocks guarantee holds from the first allocation.
+    a->zeroed_blocks = true;
+    UPB_UNPOISON_MEMORY_REGION(a->head.ptr, _upb_ArenaHas(a));
+    memset(a->head.ptr, 0, _upb_ArenaHas(a));
+    UPB_POISON_MEMORY_REGION(a->head.ptr, _upb_ArenaHas(a));
+    a->head.zero_end = a->head.end;
+  }
+  return a;
+}
+
 upb_Arena* upb_Arena_Init(void* mem, size_t n, upb_alloc* alloc) {
   upb_Arena* a;
 
@@ -195,13 +431,194 @@ upb_Arena* upb_Arena_Init(void* mem, size_t n, upb_alloc* alloc) {
   upb_Atomic_Init(&a->next, NULL);
   upb_Atomic_Init(&a->tail, a);
   upb_Atomic_Init(&a->blocks, NULL);
+  upb_Atomic_Init(&a->cleanups, NULL);
+  a->intern_pool = NULL;
   a->block_alloc = upb_Arena_MakeBlockAlloc(alloc, 1);
+  a->growth_factor = 2;
+  a->max_block_size = 0;
+  a->numa_node = -1;
+  a->zeroed_blocks = false;
   a->head.ptr = mem;
   a->head.end = UPB_PTR_AT(mem, n - sizeof(*a), char);
+  a->head.zero_end = a->head.ptr;
 
   return a;
 }
 
+typedef struct {
+  upb_CleanupFunc* func;
+  void* ud;
+} _upb_ArenaCleanupEntry;
+
+struct _upb_ArenaCleanupChunk {
+  _upb_ArenaCleanupChunk* next;  // Next-older chunk.
+  uint32_t capacity;
+  // Entries [0, count) are registered; released so the count is visible to a
+  // thread freeing the fused group.
+  UPB_ATOMIC(uint32_t) count;
+  /* _upb_ArenaCleanupEntry entries[capacity] follows. */
+};
+
+UPB_INLINE _upb_ArenaCleanupEntry* upb_Arena_CleanupEntries(
+    _upb_ArenaCleanupChunk* chunk) {
+  return (_upb_ArenaCleanupEntry*)(chunk + 1);
+}
+
+static _upb_ArenaCleanupChunk* upb_Arena_NewCleanupChunk(upb_Arena* a,
+                                                         size_t min_entries) {
+  _upb_ArenaCleanupChunk* head =
+      upb_Atomic_Load(&a->cleanups, memory_order_relaxed);
+  size_t capacity = head ? head->capacity * 2 : 8;
+  if (capacity > 128) capacity = 128;
+  if (capacity < min_entries) capacity = min_entries;
+  _upb_ArenaCleanupChunk* chunk = upb_Arena_Malloc(
+      a, sizeof(*chunk) + capacity * sizeof(_upb_ArenaCleanupEntry));
+  if (!chunk) return NULL;
+  chunk->next = head;
+  chunk->capacity = capacity;
+  upb_Atomic_Init(&chunk->count, 0);
+  upb_Atomic_Store(&a->cleanups, chunk, memory_order_release);
+  return chunk;
+}
+
+bool upb_Arena_AddCleanup(upb_Arena* a, void* ud, upb_CleanupFunc* func) {
+  _upb_ArenaCleanupChunk* head =
+      upb_Atomic_Load(&a->cleanups, memory_order_relaxed);
+  uint32_t count = head ? upb_Atomic_Load(&head->count, memory_order_relaxed)
+                        : 0;
+  if (!head || count == head->capacity) {
+    head = upb_Arena_NewCleanupChunk(a, 1);
+    if (!head) return false;
+    count = 0;
+  }
+  _upb_ArenaCleanupEntry* entry = &upb_Arena_CleanupEntries(head)[count];
+  entry->func = func;
+  entry->ud = ud;
+  upb_Atomic_Store(&head->count, count + 1, memory_order_release);
+  return true;
+}
+
+bool upb_Arena_AddCleanupBatch(upb_Arena* a, void* const* uds, size_t count,
+                               upb_CleanupFunc* func) {
+  _upb_ArenaCleanupChunk* head =
+      upb_Atomic_Load(&a->cleanups, memory_order_relaxed);
+  size_t i = 0;
+  while (i < count) {
+    uint32_t used =
+        head ? upb_Atomic_Load(&head->count, memory_order_relaxed) : 0;
+    if (!head || used == head->capacity) {
+      // One chunk sized for the whole remainder of the batch.
+      head = upb_Arena_NewCleanupChunk(a, count - i);
+      if (!head) return false;
+      used = 0;
+    }
+    _upb_ArenaCleanupEntry* entries = upb_Arena_CleanupEntries(head);
+    const size_t n = UPB_MIN(head->capacity - used, count - i);
+    for (size_t j = 0; j < n; j++) {
+      entries[used + j].func = func;
+      entries[used + j].ud = uds[i + j];
+    }
+    upb_Atomic_Store(&head->count, used + (uint32_t)n, memory_order_release);
+    i += n;
+  }
+  return true;
+}
+
+// Runs this arena's cleanup handlers in registration order.  Must run before
+// the arena's blocks are freed (or its bump pointer rewound), since the
+// chunks are allocated from the arena itself.
+static void upb_Arena_RunCleanups(upb_Arena* a) {
+  _upb_ArenaCleanupChunk* chunk =
+      upb_Atomic_Load(&a->cleanups, memory_order_acquire);
+  // The list is newest-first; reverse it (the arena is dying, so clobbering
+  // the links is fine) and walk each chunk's entry array forward, which is
+  // both registration order and allocation order.
+  _upb_ArenaCleanupChunk* prev = NULL;
+  while (chunk) {
+    _upb_ArenaCleanupChunk* next = chunk->next;
+    chunk->next = prev;
+    prev = chunk;
+    chunk = next;
+  }
+  for (chunk = prev; chunk; chunk = chunk->next) {
+    const uint32_t n = upb_Atomic_Load(&chunk->count, memory_order_acquire);
+    _upb_ArenaCleanupEntry* entries = upb_Arena_CleanupEntries(chunk);
+    for (uint32_t i = 0; i < n; i++) {
+      entries[i].func(entries[i].ud);
+    }
+  }
+}
+
+static void upb_Arena_UnrefSharedBufferCleanup(void* ud) {
+  upb_SharedBuffer_Unref(ud);
+}
+
+bool upb_Arena_AttachSharedBuffer(upb_Arena* a, upb_SharedBuffer* buf) {
+  // Decoding many messages from the same buffer into one arena is the common
+  // case; checking the newest registration makes those re-attachments free.
+  _upb_ArenaCleanupChunk* head =
+      upb_Atomic_Load(&a->cleanups, memory_order_relaxed);
+  if (head) {
+    uint32_t count = upb_Atomic_Load(&head->count, memory_order_relaxed);
+    if (count) {
+      _upb_ArenaCleanupEntry* last = &upb_Arena_CleanupEntries(head)[count - 1];
+      if (last->func == &upb_Arena_UnrefSharedBufferCleanup &&
+          last->ud == buf) {
+        return true;
+      }
+    }
+  }
+  if (!upb_Arena_AddCleanup(a, buf, &upb_Arena_UnrefSharedBufferCleanup)) {
+    return false;
+  }
+  upb_SharedBuffer_Ref(buf);
+  return true;
+}
+
+bool upb_Arena_Reset(upb_Arena* a) {
+  // A fused arena cannot be reset: other arenas (and other threads) may hold
+  // references to its memory.
+  uintptr_t poc = upb_Atomic_Load(&a->parent_or_count, memory_order_acquire);
+  if (!_upb_Arena_IsTaggedRefcount(poc) ||
+      _upb_Arena_RefCountFromTagged(poc) != 1 ||
+      upb_Atomic_Load(&a->next, memory_order_acquire) != NULL) {
+    return false;
+  }
+
+  _upb_MemBlock* block = upb_Atomic_Load(&a->blocks, memory_order_acquire);
+  if (!block) {
+    // Fixed-size arena that never grew; we did not record the start of the
+    // caller's initial block, so there is nothing to rewind to.
+    return false;
+  }
+
+  // Cleanup chunks (shared-buffer refs etc.) live in the blocks about to be
+  // reused; run the handlers and drop the list before rewinding over them.
+  upb_Arena_RunCleanups(a);
+  upb_Atomic_Store(&a->cleanups, NULL, memory_order_relaxed);
+
+  // The decoder's intern table (if any) also lives in those blocks.
+  a->intern_pool = NULL;
+
+  // Rewind the bump pointer to the start of the newest block.  Older blocks
+  // stay on the list (they are freed with the arena as usual) but are not
+  // re-used for allocation; since block sizes double, the newest block holds
+  // at least half of the allocator-owned memory.
+  a->head.ptr = UPB_PTR_AT(block, memblock_reserve, char);
+  a->head.end = UPB_PTR_AT(block, block->size, char);
+  if (a->zeroed_blocks) {
+    // Re-establish the zeroed-blocks guarantee for the reused block with one
+    // bulk clear, so post-reset allocations keep skipping their memsets.
+    UPB_UNPOISON_MEMORY_REGION(a->head.ptr, a->head.end - a->head.ptr);
+    memset(a->head.ptr, 0, a->head.end - a->head.ptr);
+    a->head.zero_end = a->head.end;
+  } else {
+    a->head.zero_end = a->head.ptr;
+  }
+  UPB_POISON_MEMORY_REGION(a->head.ptr, a->head.end - a->head.ptr);
+  return true;
+}
+
 static void arena_dofree(upb_Arena* a) {
   UPB_ASSERT(_upb_Arena_RefCountFromTagged(a->parent_or_count) == 1);
 
@@ -209,13 +626,16 @@ static void arena_dofree(upb_Arena* a) {
     // Load first since arena itself is likely from one of its blocks.
     upb_Arena* next_arena =
         (upb_Arena*)upb_Atomic_Load(&a->next, memory_order_acquire);
+    upb_Arena_RunCleanups(a);
     upb_alloc* block_alloc = upb_Arena_BlockAlloc(a);
     _upb_MemBlock* block = upb_Atomic_Load(&a->blocks, memory_order_acquire);
     while (block != NULL) {
       // Load first since we are deleting block.
       _upb_MemBlock* next_block =
           upb_Atomic_Load(&block->next, memory_order_acquire);
-      upb_free(block_alloc, block);
+      if (!upb_Arena_CachePutBlock(block_alloc, block, block->size)) {
+        upb_free(block_alloc, block);
+      }
       block = next_block;
     }
     a = next_arena;
@@ -365,3 +785,92 @@ bool upb_Arena_Fuse(upb_Arena* a1, upb_Arena* a2) {
     }
   }
 }
+
+// Fuses a2 into a1 the pairwise way, optionally carrying refs that were
+// already (and now excessively) added to the group's root by a failed batch
+// attempt in upb_Arena_FuseAll().
+static void upb_Arena_FuseWithDelta(upb_Arena* a1, upb_Arena* a2,
+                                    uintptr_t ref_delta) {
+  while (true) {
+    upb_Arena* new_root = _upb_Arena_DoFuse(a1, a2, &ref_delta);
+    if (new_root != NULL && _upb_Arena_FixupRefs(new_root, ref_delta)) {
+      return;
+    }
+  }
+}
+
+// How many distinct roots a single batch of upb_Arena_FuseAll() adopts with
+// one refcount update on the winning root.
+#define UPB_ARENA_FUSEALL_BATCH 64
+
+bool upb_Arena_FuseAll(upb_Arena** arenas, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (upb_Arena_HasInitialBlock(arenas[i])) return false;
+  }
+  if (count < 2) return true;
+
+  upb_Arena* target = arenas[0];
+  size_t i = 1;
+  while (i < count) {
+    // Collect a batch of distinct roots that are not yet part of the group.
+    _upb_ArenaRoot roots[UPB_ARENA_FUSEALL_BATCH];
+    size_t batch_start = i;
+    size_t n = 0;
+    roots[n++] = _upb_Arena_FindRoot(target);
+    while (i < count && n < UPB_ARENA_FUSEALL_BATCH) {
+      _upb_ArenaRoot r = _upb_Arena_FindRoot(arenas[i++]);
+      bool dup = false;
+      for (size_t k = 0; k < n; k++) {
+        if (roots[k].root == r.root) {
+          dup = true;
+          break;
+        }
+      }
+      if (!dup) roots[n++] = r;
+    }
+    if (n < 2) continue;
+
+    // As in _upb_Arena_DoFuse(), the root with the lowest address wins so
+    // that concurrent fuses cannot create parent cycles.
+    size_t w = 0;
+    for (size_t k = 1; k < n; k++) {
+      if ((uintptr_t)roots[k].root < (uintptr_t)roots[w].root) w = k;
+    }
+
+    // Add every loser's refs to the winner in one RMW, so that the winner
+    // can withstand any unrefs that arrive once the losers are reparented.
+    uintptr_t delta = 0;
+    for (size_t k = 0; k < n; k++) {
+      if (k != w) delta += roots[k].tagged_count & ~(uintptr_t)1;
+    }
+    uintptr_t with_refs = roots[w].tagged_count + delta;
+    if (!upb_Atomic_CompareExchangeStrong(
+            &roots[w].root->parent_or_count, &roots[w].tagged_count, with_refs,
+            memory_order_release, memory_order_acquire)) {
+      // Contended (a concurrent fuse or free touched the winner); fall back
+      // to pairwise fusing for this batch.
+      for (size_t j = batch_start; j < i; j++) {
+        upb_Arena_FuseWithDelta(target, arenas[j], 0);
+      }
+      continue;
+    }
+
+    // Reparent each loser.  A loser whose refcount changed since we read it
+    // keeps its pre-added refs as the excess delta of a pairwise retry.
+    for (size_t k = 0; k < n; k++) {
+      if (k == w) continue;
+      // On CAS failure the expected value is overwritten with the current
+      // one, so remember how many refs we pre-added for this loser.
+      uintptr_t pre_added = roots[k].tagged_count & ~(uintptr_t)1;
+      if (upb_Atomic_CompareExchangeStrong(
+              &roots[k].root->parent_or_count, &roots[k].tagged_count,
+              _upb_Arena_TaggedFromPointer(roots[w].root),
+              memory_order_release, memory_order_acquire)) {
+        _upb_Arena_DoFuseArenaLists(roots[w].root, roots[k].root);
+      } else {
+        upb_Arena_FuseWithDelta(roots[w].root, roots[k].root, pre_added);
+      }
+    }
+  }
+  return true;
+}
@@ -53,6 +53,11 @@ typedef struct upb_Arena upb_Arena;
 
 typedef struct {
   char *ptr, *end;
+  // End of the known-zero span of the current block: the unallocated bytes
+  // in [ptr, zero_end) are guaranteed to be zero, so allocations carved from
+  // them need no memset (see upb_ArenaPolicy::zeroed_blocks).  Equal to ptr
+  // when nothing is known to be zero; never exceeds end.
+  char* zero_end;
 } _upb_ArenaHead;
 
 // LINT.ThenChange(//depot/google3/third_party/upb/js/impl/upb_bits/arena.ts:arena_head)
@@ -66,13 +71,130 @@ extern "C" {
 // is a fixed-size arena and cannot grow.
 UPB_API upb_Arena* upb_Arena_Init(void* mem, size_t n, upb_alloc* alloc);
 
+// Controls how an arena created with upb_Arena_NewWithPolicy() obtains
+// blocks.  Zero-valued members select the defaults used by upb_Arena_New().
+typedef struct {
+  // Size of the first block (not counting per-block overhead); 0 selects the
+  // small default.  Long-lived bulk arenas should start near their expected
+  // footprint.
+  size_t initial_block_size;
+
+  // Multiplier applied to the previous block size when the arena grows;
+  // 0 selects the default of 2, and 1 keeps all blocks the same size.
+  uint32_t growth_factor;
+
+  // Upper bound on the size of any block, so that the tail of the last
+  // (largest) block bounds the worst-case waste; 0 means unlimited.  An
+  // allocation larger than this still gets a block big enough to hold it.
+  size_t max_block_size;
+
+  // If true, every block is zero-initialized when it enters the arena, so
+  // upb_Arena_MallocZeroed() (and message creation, which is built on it)
+  // can skip its memset for memory carved from a block's untouched tail.
+  // Blocks are obtained through the allocator's zeroed_func entry point when
+  // it has one; the global allocator uses calloc(), whose large blocks are
+  // fresh (already-zero) pages from the OS that cost no clearing at all.
+  // Worthwhile for arenas that allocate many large messages; for small
+  // messages the per-message memset is cheap and this only adds block-level
+  // clearing on the fallback paths.
+  bool zeroed_blocks;
+} upb_ArenaPolicy;
+
+UPB_API upb_Arena* upb_Arena_NewWithPolicy(const upb_ArenaPolicy* policy,
+                                           upb_alloc* alloc);
+
+// Sets the preferred NUMA node for this arena's future block allocations
+// (-1 = no preference, the default).  The node is passed through to the
+// allocator's aligned_func entry point; the default global allocator ignores
+// it, so this only has an effect with a NUMA-aware upb_alloc.
+UPB_API void upb_Arena_SetNumaNode(upb_Arena* a, int numa_node);
+
 UPB_API void upb_Arena_Free(upb_Arena* a);
 UPB_API bool upb_Arena_Fuse(upb_Arena* a, upb_Arena* b);
 
+// Fuses all |count| arenas in |arenas| into one lifetime group, like calling
+// upb_Arena_Fuse(arenas[0], arenas[i]) for each element but optimized for
+// mass fan-in: uncontended, a batch of arenas is adopted with a single
+// refcount update on the surviving root instead of one atomic RMW per arena,
+// so wide fan-in (e.g. hundreds of worker arenas fusing into an aggregation
+// arena) scales near-linearly.  Under concurrent fuses or frees it falls
+// back to pairwise fusing for the contended elements.  Returns false (fusing
+// nothing) if any arena has an initial block.
+UPB_API bool upb_Arena_FuseAll(upb_Arena** arenas, size_t count);
+
+// Discards everything allocated from |a| while keeping its blocks, so the
+// next allocations reuse warm, already-faulted pages instead of going back
+// to the allocator.  All pointers previously returned by upb_Arena_Malloc()
+// become invalid.  Returns false (and resets nothing) if the arena has been
+// fused, or if it has no allocator-owned blocks to rewind to (a fixed-size
+// arena created with upb_Arena_Init() that never grew); in that case fall
+// back to upb_Arena_Free() + creating a new arena.  Note that the arena
+// retains all of its blocks but only bump-allocates from the newest (and
+// largest) one, so up to half of the retained memory may go unused until
+// the arena grows again.
+UPB_API bool upb_Arena_Reset(upb_Arena* a);
+
+typedef void upb_CleanupFunc(void* ud);
+
+// Registers |func| to be called with |ud| when the arena (or the fused group
+// it belongs to) is freed, or when the arena is reset.  Entries are stored
+// in dedicated chunked arrays allocated from the arena, so registering many
+// cleanups costs one bump allocation per chunk instead of fragmenting block
+// tails, and handlers run in registration (i.e. forward allocation) order,
+// which walks the chunks linearly.  Not thread-safe, like upb_Arena_Malloc().
+// Returns false on allocation failure.
+UPB_API bool upb_Arena_AddCleanup(upb_Arena* a, void* ud,
+                                  upb_CleanupFunc* func);
+
+// Registers |func| for each of the |count| pointers in |uds|, equivalent to
+// but cheaper than |count| upb_Arena_AddCleanup() calls: space for the whole
+// batch is reserved up front, at most one new chunk is allocated.  On
+// allocation failure returns false; a prefix of the batch may have been
+// registered and will still run.
+UPB_API bool upb_Arena_AddCleanupBatch(upb_Arena* a, void* const* uds,
+                                       size_t count, upb_CleanupFunc* func);
+
 void* _upb_Arena_SlowMalloc(upb_Arena* a, size_t size);
+bool _upb_Arena_ReserveSlow(upb_Arena* a, size_t size);
 size_t upb_Arena_SpaceAllocated(upb_Arena* arena);
 uint32_t upb_Arena_DebugRefCount(upb_Arena* arena);
 
+// Allocation statistics for an arena (including everything fused to it),
+// computed on demand by upb_Arena_GetStats().  Since arenas never free
+// individual allocations, |space_used| is also the high-water mark of live
+// bytes.  Useful for deriving right-sized initial blocks for
+// upb_Arena_Init() from production data.
+typedef struct {
+  size_t space_allocated;  // Total bytes obtained from the block allocator.
+  size_t space_used;       // Bytes handed out by upb_Arena_Malloc().
+  size_t wasted_tail_bytes;  // Bytes stranded in abandoned block tails.
+  uint32_t block_count;
+  // Histogram of block sizes: blocks_by_size_log2[n] counts blocks whose
+  // size rounds up to 2^n bytes.
+  uint32_t blocks_by_size_log2[32];
+  uint32_t fused_arena_count;  // Number of other arenas fused with this one.
+} upb_ArenaStats;
+
+UPB_API void upb_Arena_GetStats(upb_Arena* a, upb_ArenaStats* stats);
+
+// Called after every block allocation with the arena, the size of the new
+// block, and the allocation request that triggered it (0 for an arena's
+// first block).  The hook is global and is meant for process-wide profiling;
+// install it during startup, before arenas are active on other threads.
+typedef void upb_Arena_BlockAllocHook(const upb_Arena* a, size_t block_size,
+                                      size_t requested_size);
+
+// Installs |hook| (NULL to remove) and returns the previous hook.
+UPB_API upb_Arena_BlockAllocHook* upb_Arena_SetBlockAllocHook(
+    upb_Arena_BlockAllocHook* hook);
+
+// Returns all blocks held in the calling thread's block cache to the global
+// allocator.  Arenas created with upb_alloc_global keep a small per-thread
+// cache of recently freed blocks so that steady-state arena create/destroy
+// does not touch the global allocator; call this before thread exit (or when
+// a thread goes idle) to release that memory.
+UPB_API void upb_Arena_FlushBlockCache(void);
+
 UPB_INLINE size_t _upb_ArenaHas(upb_Arena* a) {
   _upb_ArenaHead* h = (_upb_ArenaHead*)a;
   return (size_t)(h->end - h->ptr);
@@ -107,6 +229,47 @@ UPB_API_INLINE void* upb_Arena_Malloc(upb_Arena* a, size_t size) {
   return ret;
 }
 
+// Guarantees that the next |size| bytes handed out by upb_Arena_Malloc()
+// come contiguously from a single block, so none of those allocations branch
+// into _upb_Arena_SlowMalloc().  Callers that know a message's decoded
+// footprint (e.g. from logged arena high-water marks) can reserve it up
+// front and get a whole message graph laid out back-to-back in one
+// cache/TLB-local region.  Returns false if the block cannot be allocated.
+// (Under ASAN each allocation carries guard bytes that count against the
+// reservation.)
+UPB_API_INLINE bool upb_Arena_Reserve(upb_Arena* a, size_t size) {
+  size = UPB_ALIGN_MALLOC(size);
+  if (UPB_LIKELY(_upb_ArenaHas(a) >= size)) return true;
+  return _upb_Arena_ReserveSlow(a, size);
+}
+
+// Allocates |size| bytes aligned to |align| bytes, where |align| is a power
+// of two.  Alignments above UPB_MALLOC_ALIGN cost up to align -
+// UPB_MALLOC_ALIGN bytes of padding per call, so reserve this for storage
+// that benefits from cache-line or vector alignment.  The returned pointer
+// must not be passed to upb_Arena_Realloc() or upb_Arena_ShrinkLast().
+UPB_API_INLINE void* upb_Arena_MallocAligned(upb_Arena* a, size_t size,
+                                             size_t align) {
+  UPB_ASSERT((align & (align - 1)) == 0);
+  if (align <= UPB_MALLOC_ALIGN) return upb_Arena_Malloc(a, size);
+  void* ptr = upb_Arena_Malloc(a, size + align - UPB_MALLOC_ALIGN);
+  if (!ptr) return NULL;
+  return (void*)UPB_ALIGN_UP((uintptr_t)ptr, align);
+}
+
+// Like upb_Arena_Malloc() but the returned memory is zero-initialized.  In
+// an arena created with upb_ArenaPolicy::zeroed_blocks the memset is elided
+// whenever the bytes come from a block's still-untouched (provably zero)
+// tail, which is every allocation except those that follow a shrink or an
+// arena reset.
+UPB_API_INLINE void* upb_Arena_MallocZeroed(upb_Arena* a, size_t size) {
+  void* ret = upb_Arena_Malloc(a, size);
+  if (UPB_UNLIKELY(!ret)) return NULL;
+  _upb_ArenaHead* h = (_upb_ArenaHead*)a;
+  if (UPB_PTR_AT(ret, size, char) > h->zero_end) memset(ret, 0, size);
+  return ret;
+}
+
 // Shrinks the last alloc from arena.
 // REQUIRES: (ptr, oldsize) was the last malloc/realloc from this arena.
 // We could also add a upb_Arena_TryShrinkLast() which is simply a no-op if
@@ -119,6 +282,11 @@ UPB_API_INLINE void upb_Arena_ShrinkLast(upb_Arena* a, void* ptr,
   UPB_ASSERT((char*)ptr + oldsize == h->ptr);  // Must be the last alloc.
   UPB_ASSERT(size <= oldsize);
   h->ptr = (char*)ptr + size;
+  if (UPB_UNLIKELY(h->zero_end > h->ptr)) {
+    // The bytes being given back may have been written; re-zero them so the
+    // known-zero span stays honest (see upb_ArenaPolicy::zeroed_blocks).
+    memset(h->ptr, 0, UPB_MIN(h->zero_end, (char*)ptr + oldsize) - h->ptr);
+  }
 }
 
 UPB_API_INLINE void* upb_Arena_Realloc(upb_Arena* a, void* ptr, size_t oldsize,
@@ -132,6 +300,11 @@ UPB_API_INLINE void* upb_Arena_Realloc(upb_Arena* a, void* ptr, size_t oldsize,
     ptrdiff_t diff = size - oldsize;
     if ((ptrdiff_t)_upb_ArenaHas(a) >= diff) {
       h->ptr += diff;
+      if (UPB_UNLIKELY(diff < 0 && h->zero_end > h->ptr)) {
+        // Re-zero the bytes given back by an in-place shrink, as in
+        // upb_Arena_ShrinkLast().
+        memset(h->ptr, 0, UPB_MIN(h->zero_end, h->ptr - diff) - h->ptr);
+      }
       return ptr;
     }
   } else if (size <= oldsize) {
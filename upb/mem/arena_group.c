@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/mem/arena_group.h"
+
+#include "upb/mem/alloc.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+struct upb_ArenaGroup {
+  size_t count;
+  upb_Arena* arenas[];
+};
+
+upb_ArenaGroup* upb_ArenaGroup_New(size_t count, size_t block_size) {
+  if (count == 0) return NULL;
+  upb_ArenaGroup* g =
+      upb_gmalloc(sizeof(*g) + count * sizeof(g->arenas[0]));
+  if (!g) return NULL;
+  g->count = 0;
+
+  // Creating the members here, before the workers exist, does all the block
+  // allocation in one pass on one thread; with a caller-chosen block size
+  // each worker then decodes out of its own pre-faulted block and the block
+  // allocator sees no contention from the parallel phase.
+  upb_ArenaPolicy policy = {0};
+  policy.initial_block_size = block_size;
+  for (size_t i = 0; i < count; i++) {
+    upb_Arena* a = block_size ? upb_Arena_NewWithPolicy(&policy, NULL)
+                              : upb_Arena_New();
+    if (!a) {
+      upb_ArenaGroup_Free(g);
+      return NULL;
+    }
+    g->arenas[i] = a;
+    g->count = i + 1;
+  }
+
+  // Fusing up front is what makes the group one lifetime; the batch fuse is
+  // a single refcount update on the survivor, so group creation stays
+  // O(count).  It cannot fail here: no member has a caller-provided block.
+  if (!upb_Arena_FuseAll(g->arenas, g->count)) {
+    upb_ArenaGroup_Free(g);
+    return NULL;
+  }
+  return g;
+}
+
+size_t upb_ArenaGroup_Count(const upb_ArenaGroup* g) { return g->count; }
+
+upb_Arena* upb_ArenaGroup_Member(const upb_ArenaGroup* g, size_t i) {
+  UPB_ASSERT(i < g->count);
+  return g->arenas[i];
+}
+
+bool upb_ArenaGroup_Fuse(upb_ArenaGroup* g, upb_Arena* arena) {
+  return upb_Arena_Fuse(g->arenas[0], arena);
+}
+
+void upb_ArenaGroup_Free(upb_ArenaGroup* g) {
+  for (size_t i = 0; i < g->count; i++) {
+    upb_Arena_Free(g->arenas[i]);
+  }
+  upb_gfree(g);
+}
+
+#include "upb/port/undef.inc"
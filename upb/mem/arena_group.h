@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* upb_ArenaGroup makes the decode-in-parallel, share-one-lifetime pattern
+ * first-class.  A upb_Arena is single-threaded for allocation, so fan-out
+ * parsing needs one arena per worker; a group creates those arenas pre-fused
+ * into a single lifetime, each seeded with its own initial block so the
+ * parallel phase allocates without touching the block allocator:
+ *
+ *   upb_ArenaGroup* g = upb_ArenaGroup_New(num_workers, block_size);
+ *   // Worker i decodes its buffers on upb_ArenaGroup_Member(g, i)...
+ *   // ...join workers, then either keep `g` as the lifetime token, or:
+ *   upb_ArenaGroup_Fuse(g, long_lived_arena);
+ *   upb_ArenaGroup_Free(g);  // Messages live until long_lived_arena dies.
+ */
+
+#ifndef UPB_MEM_ARENA_GROUP_H_
+#define UPB_MEM_ARENA_GROUP_H_
+
+#include "upb/mem/arena.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+typedef struct upb_ArenaGroup upb_ArenaGroup;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Creates a group of |count| arenas fused into one lifetime, in O(count).
+// Each member gets an initial block of |block_size| bytes, allocated up
+// front on the calling thread (0 selects the small default, which makes the
+// member's first allocation fetch a block lazily instead).  Returns NULL if
+// |count| is 0 or allocation failed.
+UPB_API upb_ArenaGroup* upb_ArenaGroup_New(size_t count, size_t block_size);
+
+UPB_API size_t upb_ArenaGroup_Count(const upb_ArenaGroup* g);
+
+// Returns member arena |i| (i < count).  Each member carries the usual
+// upb_Arena contract -- one thread at a time -- but distinct members may be
+// used concurrently, and everything allocated from any member shares the
+// group's lifetime.
+UPB_API upb_Arena* upb_ArenaGroup_Member(const upb_ArenaGroup* g, size_t i);
+
+// Fuses |arena| with the group, extending the group's allocations to live
+// as long as |arena| does (and vice versa).  Call after the parallel phase,
+// from one thread.  Returns false if the arenas cannot be fused (e.g.
+// |arena| was created over a caller-provided block by upb_Arena_Init()).
+UPB_API bool upb_ArenaGroup_Fuse(upb_ArenaGroup* g, upb_Arena* arena);
+
+// Releases the group and its member handles.  Allocations are freed with the
+// last reference: immediately, unless the group was fused to an arena that
+// is still alive.
+UPB_API void upb_ArenaGroup_Free(upb_ArenaGroup* g);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_MEM_ARENA_GROUP_H_ */
@@ -34,6 +34,7 @@
 #include "upb/port/def.inc"
 
 typedef struct _upb_MemBlock _upb_MemBlock;
+typedef struct _upb_ArenaCleanupChunk _upb_ArenaCleanupChunk;
 
 struct upb_Arena {
   _upb_ArenaHead head;
@@ -62,6 +63,35 @@ struct upb_Arena {
   // Linked list of blocks to free/cleanup.  Atomic only for the benefit of
   // upb_Arena_SpaceAllocated().
   UPB_ATOMIC(_upb_MemBlock*) blocks;
+
+  // Cleanup registrations (see upb_Arena_AddCleanup()), stored as a linked
+  // list of dedicated entry-array chunks, newest chunk first; entries run in
+  // registration order when the arena's fused group dies or the arena is
+  // reset.  Chunks are allocated from the arena itself.  Atomic because the
+  // group may be freed from another thread.
+  UPB_ATOMIC(_upb_ArenaCleanupChunk*) cleanups;
+
+  // Opaque string intern table owned by the wire decoder (see
+  // kUpb_DecodeOption_InternStrings in wire/decode.h).  Stored here so that
+  // interned strings dedupe across every parse into this arena.  The table and
+  // its entries are allocated from the arena itself, so it needs no cleanup,
+  // but it must be dropped when the arena is reset.
+  void* intern_pool;
+
+  // Block growth policy (see upb_ArenaPolicy).  Each new block is
+  // growth_factor times the previous one, clamped to max_block_size
+  // (0 = unlimited).
+  uint32_t growth_factor;
+  uint32_t max_block_size;
+
+  // Preferred NUMA node for block allocations made through an allocator with
+  // an aligned_func entry point; -1 = no preference.
+  int numa_node;
+
+  // If true, every block is zero-initialized when it enters the arena and
+  // head.zero_end tracks the known-zero frontier (see
+  // upb_ArenaPolicy::zeroed_blocks).
+  bool zeroed_blocks;
 };
 
 UPB_INLINE bool _upb_Arena_IsTaggedRefcount(uintptr_t parent_or_count) {
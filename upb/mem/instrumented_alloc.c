@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/mem/instrumented_alloc.h"
+
+#include <string.h>
+
+#include "upb/base/log2.h"
+#include "upb/port/atomic.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+static int upb_instrumented_sizeclass(size_t size) {
+  int lg2 = upb_Log2Ceiling(size > INT32_MAX ? INT32_MAX : (int)size);
+  return lg2 > 31 ? 31 : lg2;
+}
+
+static void* upb_instrumented_allocfunc(upb_alloc* alloc, void* ptr,
+                                        size_t oldsize, size_t size) {
+  upb_InstrumentedAlloc* a = (upb_InstrumentedAlloc*)alloc;
+  if (size == 0) {
+    upb_Atomic_Add(&a->free_count, 1, memory_order_relaxed);
+  } else {
+    upb_Atomic_Add(ptr ? &a->realloc_count : &a->alloc_count, 1,
+                   memory_order_relaxed);
+    upb_Atomic_Add(&a->bytes_requested, size, memory_order_relaxed);
+    upb_Atomic_Add(&a->allocs_by_size_log2[upb_instrumented_sizeclass(size)],
+                   1, memory_order_relaxed);
+    if (a->hook) a->hook(a->hook_data, size);
+  }
+  return a->delegate->func(a->delegate, ptr, oldsize, size);
+}
+
+static void* upb_instrumented_alignedfunc(upb_alloc* alloc, size_t size,
+                                          size_t alignment, int numa_node) {
+  upb_InstrumentedAlloc* a = (upb_InstrumentedAlloc*)alloc;
+  if (!a->delegate->aligned_func) return NULL;
+  upb_Atomic_Add(&a->alloc_count, 1, memory_order_relaxed);
+  upb_Atomic_Add(&a->bytes_requested, size, memory_order_relaxed);
+  upb_Atomic_Add(&a->allocs_by_size_log2[upb_instrumented_sizeclass(size)], 1,
+                 memory_order_relaxed);
+  if (a->hook) a->hook(a->hook_data, size);
+  return a->delegate->aligned_func(a->delegate, size, alignment, numa_node);
+}
+
+static void* upb_instrumented_zeroedfunc(upb_alloc* alloc, size_t size) {
+  upb_InstrumentedAlloc* a = (upb_InstrumentedAlloc*)alloc;
+  if (!a->delegate->zeroed_func) return NULL;
+  upb_Atomic_Add(&a->alloc_count, 1, memory_order_relaxed);
+  upb_Atomic_Add(&a->bytes_requested, size, memory_order_relaxed);
+  upb_Atomic_Add(&a->allocs_by_size_log2[upb_instrumented_sizeclass(size)], 1,
+                 memory_order_relaxed);
+  if (a->hook) a->hook(a->hook_data, size);
+  return a->delegate->zeroed_func(a->delegate, size);
+}
+
+void upb_InstrumentedAlloc_Init(upb_InstrumentedAlloc* a, upb_alloc* delegate) {
+  memset(a, 0, sizeof(*a));
+  a->alloc.func = &upb_instrumented_allocfunc;
+  a->alloc.aligned_func = &upb_instrumented_alignedfunc;
+  a->alloc.zeroed_func = &upb_instrumented_zeroedfunc;
+  a->delegate = delegate;
+}
+
+void upb_InstrumentedAlloc_SetHook(upb_InstrumentedAlloc* a,
+                                   upb_InstrumentedAlloc_Hook* hook,
+                                   void* hook_data) {
+  a->hook = hook;
+  a->hook_data = hook_data;
+}
+
+void upb_InstrumentedAlloc_Snapshot(const upb_InstrumentedAlloc* a,
+                                    upb_AllocStats* stats) {
+  upb_InstrumentedAlloc* ma = (upb_InstrumentedAlloc*)a;
+  stats->alloc_count = upb_Atomic_Load(&ma->alloc_count, memory_order_relaxed);
+  stats->realloc_count =
+      upb_Atomic_Load(&ma->realloc_count, memory_order_relaxed);
+  stats->free_count = upb_Atomic_Load(&ma->free_count, memory_order_relaxed);
+  stats->bytes_requested =
+      upb_Atomic_Load(&ma->bytes_requested, memory_order_relaxed);
+  for (int i = 0; i < 32; i++) {
+    stats->allocs_by_size_log2[i] =
+        upb_Atomic_Load(&ma->allocs_by_size_log2[i], memory_order_relaxed);
+  }
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// An instrumented upb_alloc that wraps another allocator and counts what
+// flows through it, so allocation behavior of a DefPool or Arena can be
+// observed in production without external profiling tools.  Counter updates
+// are relaxed atomic adds, so the wrapper is cheap and safe to share between
+// threads; snapshots are correspondingly only loosely consistent with each
+// other.
+
+#ifndef UPB_MEM_INSTRUMENTED_ALLOC_H_
+#define UPB_MEM_INSTRUMENTED_ALLOC_H_
+
+#include "upb/mem/alloc.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A point-in-time copy of an instrumented allocator's counters, filled in by
+// upb_InstrumentedAlloc_Snapshot().
+typedef struct {
+  uint64_t alloc_count;    // malloc-style calls (size != 0, ptr == NULL).
+  uint64_t realloc_count;  // realloc-style calls (size != 0, ptr != NULL).
+  uint64_t free_count;     // free-style calls (size == 0).
+  uint64_t bytes_requested;  // Sum of requested sizes.
+  // Histogram of requested sizes: allocs_by_size_log2[n] counts requests
+  // whose size rounds up to 2^n bytes.
+  uint64_t allocs_by_size_log2[32];
+} upb_AllocStats;
+
+// Invoked (if non-NULL) on every allocation event with the user-provided
+// |hook_data| and the requested size, e.g. to capture a backtrace for a
+// sampled fraction of allocations.  Runs inline on the allocating thread.
+typedef void upb_InstrumentedAlloc_Hook(void* hook_data, size_t size);
+
+typedef struct {
+  // Must be first so that a upb_InstrumentedAlloc* can be passed wherever a
+  // upb_alloc* is accepted (e.g. upb_Arena_Init(), upb_DefPool_SetAlloc()).
+  upb_alloc alloc;
+
+  upb_alloc* delegate;
+  upb_InstrumentedAlloc_Hook* hook;  // May be NULL.
+  void* hook_data;
+
+  // Counters; read via upb_InstrumentedAlloc_Snapshot().
+  UPB_ATOMIC(uint64_t) alloc_count;
+  UPB_ATOMIC(uint64_t) realloc_count;
+  UPB_ATOMIC(uint64_t) free_count;
+  UPB_ATOMIC(uint64_t) bytes_requested;
+  UPB_ATOMIC(uint64_t) allocs_by_size_log2[32];
+} upb_InstrumentedAlloc;
+
+// Initializes |a| to delegate to |delegate| with all counters zero and no
+// hook installed.  The wrapper holds no memory of its own and needs no
+// teardown; it must outlive anything allocating through it.
+UPB_API void upb_InstrumentedAlloc_Init(upb_InstrumentedAlloc* a,
+                                        upb_alloc* delegate);
+
+// Installs |hook| (NULL to remove); see upb_InstrumentedAlloc_Hook.
+UPB_API void upb_InstrumentedAlloc_SetHook(upb_InstrumentedAlloc* a,
+                                           upb_InstrumentedAlloc_Hook* hook,
+                                           void* hook_data);
+
+// Copies the current counter values into |stats|.
+UPB_API void upb_InstrumentedAlloc_Snapshot(const upb_InstrumentedAlloc* a,
+                                            upb_AllocStats* stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_MEM_INSTRUMENTED_ALLOC_H_ */
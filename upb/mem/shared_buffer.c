@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/mem/shared_buffer.h"
+
+#include "upb/mem/alloc.h"
+#include "upb/port/atomic.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+struct upb_SharedBuffer {
+  const char* data;
+  size_t size;
+  UPB_ATOMIC(uintptr_t) refcount;
+  upb_SharedBuffer_FreeFunc* free_func;
+  void* user;
+};
+
+upb_SharedBuffer* upb_SharedBuffer_New(const char* data, size_t size,
+                                       upb_SharedBuffer_FreeFunc* free_func,
+                                       void* user) {
+  upb_SharedBuffer* buf = upb_gmalloc(sizeof(*buf));
+  if (!buf) return NULL;
+  buf->data = data;
+  buf->size = size;
+  buf->free_func = free_func;
+  buf->user = user;
+  upb_Atomic_Init(&buf->refcount, 1);
+  return buf;
+}
+
+void upb_SharedBuffer_Ref(upb_SharedBuffer* buf) {
+  upb_Atomic_Add(&buf->refcount, 1, memory_order_relaxed);
+}
+
+void upb_SharedBuffer_Unref(upb_SharedBuffer* buf) {
+  uintptr_t count = upb_Atomic_Load(&buf->refcount, memory_order_acquire);
+  uintptr_t new_count;
+  do {
+    UPB_ASSERT(count > 0);
+    new_count = count - 1;
+  } while (!upb_Atomic_CompareExchangeWeak(&buf->refcount, &count, new_count,
+                                           memory_order_acq_rel,
+                                           memory_order_acquire));
+  if (new_count == 0) {
+    if (buf->free_func) buf->free_func(buf->data, buf->size, buf->user);
+    upb_gfree(buf);
+  }
+}
+
+const char* upb_SharedBuffer_Data(const upb_SharedBuffer* buf) {
+  return buf->data;
+}
+
+size_t upb_SharedBuffer_Size(const upb_SharedBuffer* buf) { return buf->size; }
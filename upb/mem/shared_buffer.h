@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* upb_SharedBuffer is a refcounted wrapper around an input buffer whose
+ * lifetime can be tied to one or more arenas.  Decoding with
+ * kUpb_DecodeOption_AliasString leaves upb_StringViews pointing into the
+ * input buffer; attaching the buffer to the arena guarantees those views
+ * stay valid until the arena (or its fused group) dies. */
+
+#ifndef UPB_MEM_SHARED_BUFFER_H_
+#define UPB_MEM_SHARED_BUFFER_H_
+
+#include "upb/mem/arena.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct upb_SharedBuffer upb_SharedBuffer;
+
+/* Called with the wrapped data when the last reference is dropped. */
+typedef void upb_SharedBuffer_FreeFunc(const char* data, size_t size,
+                                       void* user);
+
+/* Wraps [data, data+size) with an initial refcount of one.  |free_func| (may
+ * be NULL for buffers the caller owns forever) runs when the count reaches
+ * zero; |user| is passed through to it.  Returns NULL on allocation
+ * failure. */
+UPB_API upb_SharedBuffer* upb_SharedBuffer_New(
+    const char* data, size_t size, upb_SharedBuffer_FreeFunc* free_func,
+    void* user);
+
+UPB_API void upb_SharedBuffer_Ref(upb_SharedBuffer* buf);
+UPB_API void upb_SharedBuffer_Unref(upb_SharedBuffer* buf);
+
+UPB_API const char* upb_SharedBuffer_Data(const upb_SharedBuffer* buf);
+UPB_API size_t upb_SharedBuffer_Size(const upb_SharedBuffer* buf);
+
+/* Holds a reference to |buf| until |a| (or the fused group it belongs to) is
+ * freed.  Attaching the same buffer again is a cheap no-op when it is already
+ * the most recently attached one.  Returns false on allocation failure. */
+UPB_API bool upb_Arena_AttachSharedBuffer(upb_Arena* a, upb_SharedBuffer* buf);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_MEM_SHARED_BUFFER_H_ */
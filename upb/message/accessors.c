@@ -90,3 +90,214 @@ bool upb_Message_IsExactlyEqual(const upb_Message* m1, const upb_Message* m2,
   upb_Arena_Free(a);
   return ret;
 }
+
+const upb_MiniTableField* upb_Message_NextSetField(
+    const upb_Message* msg, const upb_MiniTable* mini_table, size_t* iter) {
+  const upb_MiniTableField* fields = mini_table->fields;
+  const size_t count = mini_table->field_count;
+  size_t i = *iter + 1;
+  while (i < count) {
+    const upb_MiniTableField* f = &fields[i];
+    if (f->presence > 0) {
+      const size_t idx = (size_t)f->presence;
+      const char byte = *UPB_PTR_AT(msg, _upb_hasbit_ofs(idx), const char);
+      if (byte & _upb_hasbit_mask(idx)) goto found;
+      if (byte == 0) {
+        // The whole hasbit byte is clear, so every later field whose hasbit
+        // falls in the same byte is unset too; skip them without touching
+        // the message again.  Hasbits are assigned in field order (required
+        // fields aside), so this typically skips eight fields per load.
+        const size_t byte_ofs = _upb_hasbit_ofs(idx);
+        do {
+          i++;
+        } while (i < count && fields[i].presence > 0 &&
+                 _upb_hasbit_ofs((size_t)fields[i].presence) == byte_ofs);
+        continue;
+      }
+    } else if (_upb_MiniTableField_InOneOf(f)) {
+      if (_upb_getoneofcase_field(msg, f) == f->number) goto found;
+    } else {
+      switch (upb_FieldMode_Get(f)) {
+        case kUpb_FieldMode_Map: {
+          const upb_Map* map = *UPB_PTR_AT(msg, f->offset, const upb_Map*);
+          if (map && upb_Map_Size(map) != 0) goto found;
+          break;
+        }
+        case kUpb_FieldMode_Array: {
+          const upb_Array* arr = *UPB_PTR_AT(msg, f->offset, const upb_Array*);
+          if (arr && upb_Array_Size(arr) != 0) goto found;
+          break;
+        }
+        case kUpb_FieldMode_Scalar:
+          if (_upb_MiniTable_ValueIsNonZero(
+                  _upb_MiniTableField_GetConstPtr(msg, f), f)) {
+            goto found;
+          }
+          break;
+      }
+    }
+    i++;
+    continue;
+  found:
+    *iter = i;
+    return f;
+  }
+  *iter = i;
+  return NULL;
+}
+
+void upb_Message_ClearAndRecycle(upb_Message* msg, const upb_MiniTable* l) {
+  UPB_ASSERT(!_upb_Message_IsFrozen(msg));
+  static const char zeros[16] = {0};
+  const size_t count = l->field_count;
+  _upb_Message_ClearHasbits(msg, l);
+  for (size_t i = 0; i < count; i++) {
+    const upb_MiniTableField* f = &l->fields[i];
+    if (upb_IsRepeatedOrMap(f)) {
+      if (upb_FieldMode_Get(f) == kUpb_FieldMode_Array) {
+        upb_Array* arr = *UPB_PTR_AT(msg, f->offset, upb_Array*);
+        if (arr) upb_Array_Resize(arr, 0, NULL);
+      } else {
+        upb_Map* map = *UPB_PTR_AT(msg, f->offset, upb_Map*);
+        if (map) upb_Map_Clear(map);
+      }
+      continue;
+    }
+    if (_upb_MiniTableField_InOneOf(f)) {
+      *_upb_oneofcase_field(msg, f) = 0;
+    }
+    _upb_MiniTable_CopyFieldData(UPB_PTR_AT(msg, f->offset, char), zeros, f);
+  }
+
+  // Keep the unknown-field/extension buffer, but mark it empty.
+  upb_Message_Internal* in = upb_Message_Getinternal(msg);
+  if (in->internal) {
+    in->internal->unknown_end = sizeof(upb_Message_InternalData);
+    in->internal->ext_begin = in->internal->size;
+    in->internal->wire_size = 0;
+    in->internal->wire_data = NULL;
+  }
+}
+
+static bool _upb_Message_FreezeRecursive(upb_Message* msg,
+                                         const upb_MiniTable* l,
+                                         upb_Arena* arena) {
+  if (_upb_Message_IsFrozen(msg)) return true;
+  if (!_upb_Message_SetFrozen(msg, arena)) return false;
+
+  size_t iter = kUpb_Message_Begin;
+  const upb_MiniTableField* f;
+  while ((f = upb_Message_NextSetField(msg, l, &iter)) != NULL) {
+    switch (upb_FieldMode_Get(f)) {
+      case kUpb_FieldMode_Scalar: {
+        if (upb_MiniTableField_CType(f) != kUpb_CType_Message) break;
+        const upb_TaggedMessagePtr tagged =
+            *UPB_PTR_AT(msg, f->offset, upb_TaggedMessagePtr);
+        if (upb_TaggedMessagePtr_IsEmpty(tagged)) {
+          // Unlinked sub-message: its data is all unknown bytes, so there is
+          // nothing to recurse into; just mark it.
+          if (!_upb_Message_SetFrozen(_upb_TaggedMessagePtr_GetEmptyMessage(tagged),
+                                      arena)) {
+            return false;
+          }
+        } else if (!_upb_Message_FreezeRecursive(
+                       upb_TaggedMessagePtr_GetNonEmptyMessage(tagged),
+                       upb_MiniTable_GetSubMessageTable(l, f), arena)) {
+          return false;
+        }
+        break;
+      }
+      case kUpb_FieldMode_Array: {
+        if (upb_MiniTableField_CType(f) != kUpb_CType_Message) break;
+        const upb_MiniTable* sub = upb_MiniTable_GetSubMessageTable(l, f);
+        const upb_Array* arr = *UPB_PTR_AT(msg, f->offset, const upb_Array*);
+        const size_t size = upb_Array_Size(arr);
+        for (size_t i = 0; i < size; i++) {
+          const upb_TaggedMessagePtr tagged =
+              upb_Array_Get(arr, i).tagged_msg_val;
+          if (upb_TaggedMessagePtr_IsEmpty(tagged)) {
+            if (!_upb_Message_SetFrozen(
+                    _upb_TaggedMessagePtr_GetEmptyMessage(tagged), arena)) {
+              return false;
+            }
+          } else if (!_upb_Message_FreezeRecursive(
+                         upb_TaggedMessagePtr_GetNonEmptyMessage(tagged), sub,
+                         arena)) {
+            return false;
+          }
+        }
+        break;
+      }
+      case kUpb_FieldMode_Map: {
+        const upb_MiniTable* entry =
+            l->subs[f->UPB_PRIVATE(submsg_index)].submsg;
+        const upb_MiniTableField* value_field = &entry->fields[1];
+        if (upb_MiniTableField_CType(value_field) != kUpb_CType_Message) break;
+        const upb_MiniTable* sub =
+            upb_MiniTable_GetSubMessageTable(entry, value_field);
+        const upb_Map* map = *UPB_PTR_AT(msg, f->offset, const upb_Map*);
+        size_t map_iter = kUpb_Map_Begin;
+        upb_MessageValue key, val;
+        while (upb_Map_Next(map, &key, &val, &map_iter)) {
+          if (upb_TaggedMessagePtr_IsEmpty(val.tagged_msg_val)) {
+            if (!_upb_Message_SetFrozen(
+                    _upb_TaggedMessagePtr_GetEmptyMessage(val.tagged_msg_val),
+                    arena)) {
+              return false;
+            }
+          } else if (!_upb_Message_FreezeRecursive(
+                         upb_TaggedMessagePtr_GetNonEmptyMessage(
+                             val.tagged_msg_val),
+                         sub, arena)) {
+            return false;
+          }
+        }
+        break;
+      }
+    }
+  }
+
+  // Message-valued extensions are part of the tree too.
+  size_t ext_count;
+  const upb_Message_Extension* ext = _upb_Message_Getexts(msg, &ext_count);
+  for (size_t i = 0; i < ext_count; i++) {
+    if (upb_MiniTableField_CType(&ext[i].ext->field) != kUpb_CType_Message) {
+      continue;
+    }
+    const upb_MiniTable* sub = ext[i].ext->sub.submsg;
+    if (upb_IsRepeatedOrMap(&ext[i].ext->field)) {
+      const upb_Array* arr = ext[i].data.ptr;
+      const size_t size = arr ? upb_Array_Size(arr) : 0;
+      for (size_t j = 0; j < size; j++) {
+        const upb_TaggedMessagePtr tagged =
+            upb_Array_Get(arr, j).tagged_msg_val;
+        if (!_upb_Message_FreezeRecursive(
+                upb_TaggedMessagePtr_GetNonEmptyMessage(tagged), sub, arena)) {
+          return false;
+        }
+      }
+    } else {
+      upb_Message* sub_msg;
+      memcpy(&sub_msg, &ext[i].data, sizeof(sub_msg));
+      if (sub_msg && !_upb_Message_FreezeRecursive(sub_msg, sub, arena)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool upb_Message_Freeze(upb_Message* msg, const upb_MiniTable* mini_table,
+                        upb_Arena* arena) {
+  // Cache the serialized form before the frozen flag forbids writes: the
+  // wire span slot doubles as the cache, and the encoder already emits a
+  // valid span verbatim.
+  char* buf;
+  size_t size;
+  if (upb_Encode(msg, mini_table, 0, arena, &buf, &size) !=
+      kUpb_EncodeStatus_Ok) {
+    return false;
+  }
+  if (!_upb_Message_SetWireSpan(msg, buf, size, 0, arena)) return false;
+  return _upb_Message_FreezeRecursive(msg, mini_table, arena);
+}
@@ -37,6 +37,7 @@
 #include "upb/message/internal.h"
 #include "upb/mini_table/enum.h"
 #include "upb/mini_table/field.h"
+#include "upb/mini_table/message.h"
 
 // Must be last.
 #include "upb/port/def.inc"
@@ -57,11 +58,49 @@ UPB_API_INLINE void upb_Message_ClearField(upb_Message* msg,
 
 UPB_API_INLINE void upb_Message_Clear(upb_Message* msg,
                                       const upb_MiniTable* l) {
+  UPB_ASSERT(!_upb_Message_IsFrozen(msg));
   // Note: Can't use UPB_PTR_AT() here because we are doing pointer subtraction.
   char* mem = (char*)msg - sizeof(upb_Message_Internal);
   memset(mem, 0, upb_msg_sizeof(l));
 }
 
+// Freezes a message tree: `msg` and every reachable sub-message are marked
+// immutable, and the serialized bytes of `msg` are computed once and cached
+// so later upb_Encode() calls emit them directly (use
+// upb_Message_GetCachedEncoding() to read them without encoding at all).
+//
+// Freezing itself is not thread-safe, but once upb_Message_Freeze() returns
+// the tree is safe to share with any number of concurrent readers with no
+// further synchronization; there is no need to defensively deep-clone it.
+// Mutating a frozen message is undefined behavior; in debug builds the
+// mutating accessors UPB_ASSERT() against it.  `arena` must be the
+// message's arena or one that outlives it.  Returns false on allocation or
+// encoding failure, in which case the message remains mutable.
+UPB_API bool upb_Message_Freeze(upb_Message* msg,
+                                const upb_MiniTable* mini_table,
+                                upb_Arena* arena);
+
+// Returns true if this message was frozen with upb_Message_Freeze().
+UPB_API_INLINE bool upb_Message_IsFrozen(const upb_Message* msg) {
+  return _upb_Message_IsFrozen(msg);
+}
+
+// Returns the serialized bytes cached by upb_Message_Freeze(), writing their
+// size to `*size`, or NULL if this message has no cached encoding.
+UPB_API_INLINE const char* upb_Message_GetCachedEncoding(
+    const upb_Message* msg, size_t* size) {
+  return _upb_Message_GetWireSpan(msg, size);
+}
+
+// Clears every field like upb_Message_Clear(), but retains allocated field
+// storage so a message object reused across requests reaches an
+// allocation-free steady state: arrays are emptied in place keeping their
+// capacity, maps keep their hash tables, and the unknown-field/extension
+// buffer is kept (empty).  Dropped sub-messages and string payloads still
+// live until the arena dies, as with any clear.
+UPB_API void upb_Message_ClearAndRecycle(upb_Message* msg,
+                                         const upb_MiniTable* l);
+
 UPB_API_INLINE bool upb_Message_HasField(const upb_Message* msg,
                                          const upb_MiniTableField* field) {
   if (upb_MiniTableField_IsExtension(field)) {
@@ -78,6 +117,106 @@ UPB_API_INLINE uint32_t upb_Message_WhichOneofFieldNumber(
   return _upb_getoneofcase_field(message, oneof_field);
 }
 
+// A dense field-number -> field index covering a message's contiguous
+// low-number range: entries[n - 1] describes field number n, and entries
+// with a zero field number are gaps.  Generated code emits one per message
+// as Foo_field_index, so dynamic field access by number is one array load
+// instead of a upb_MiniTable_FindFieldByNumber() search or a reflection
+// lookup.
+typedef struct {
+  const upb_MiniTableField* entries;
+  uint32_t count;  // Highest field number covered.
+} upb_FieldIndex;
+
+// Returns the field with the given number, or NULL if the index does not
+// cover it (number out of range or a gap).  Numbers beyond the covered
+// range may still exist in the message; fall back to
+// upb_MiniTable_FindFieldByNumber() for those.
+UPB_API_INLINE const upb_MiniTableField* upb_FieldIndex_Find(
+    const upb_FieldIndex* index, uint32_t field_number) {
+  if (field_number == 0 || field_number > index->count) return NULL;
+  const upb_MiniTableField* f = &index->entries[field_number - 1];
+  return f->number ? f : NULL;
+}
+
+// Reads the value of field |field_number| into |val| via a generated dense
+// field index.  Unset fields read as zero (empty string, NULL sub-message
+// or array/map); mini tables carry no explicit defaults, so callers that
+// need them should check upb_Message_HasField() first.  Returns false if
+// the index does not cover |field_number|.
+UPB_API_INLINE bool upb_Message_GetByNumberFast(const upb_Message* msg,
+                                                const upb_FieldIndex* index,
+                                                uint32_t field_number,
+                                                upb_MessageValue* val) {
+  const upb_MiniTableField* f = upb_FieldIndex_Find(index, field_number);
+  if (!f) return false;
+  upb_MessageValue zero;
+  memset(&zero, 0, sizeof(zero));
+  *val = zero;
+  _upb_Message_GetField(msg, f, &zero, val);
+  return true;
+}
+
+// Reads a oneof's case and active value together: one load for the case, one
+// index load for the active member's layout, and a value copy.  |oneof_field|
+// may be any member of the oneof.  Returns the active member's field number
+// (0 if the oneof is unset) and, when nonzero, fills |val| with its value, so
+// a dispatch loop can switch on the returned case with the value already in
+// hand instead of calling a case-checked accessor in every arm.  |index| is
+// the message's generated dense field index (Foo_field_index) and may be
+// NULL; members it does not cover fall back to a
+// upb_MiniTable_FindFieldByNumber() search.  Generated Foo_<oneof>_value()
+// helpers supply all of the arguments.
+UPB_API_INLINE uint32_t upb_Message_OneofValue(
+    const upb_Message* msg, const upb_MiniTable* m, const upb_FieldIndex* index,
+    const upb_MiniTableField* oneof_field, upb_MessageValue* val) {
+  UPB_ASSUME(_upb_MiniTableField_InOneOf(oneof_field));
+  const uint32_t oneof_case = _upb_getoneofcase_field(msg, oneof_field);
+  if (oneof_case == 0) return 0;
+  const upb_MiniTableField* f =
+      index ? upb_FieldIndex_Find(index, oneof_case) : NULL;
+  if (!f) f = upb_MiniTable_FindFieldByNumber(m, oneof_case);
+  UPB_ASSERT(f && _upb_MiniTableField_InOneOf(f));
+  _upb_MiniTable_CopyFieldData(val, _upb_MiniTableField_GetConstPtr(msg, f), f);
+  return oneof_case;
+}
+
+// Reads |count| fields into |values| in one pass; values[i] receives the
+// value of fields[i], or zero (empty string, NULL sub-message/array/map) if
+// the field is unset.  Sort |fields| by offset so that extracting many
+// fields from many messages sweeps each message forward once instead of
+// hopping per accessor call; generated Foo_extract() functions do this for
+// you.  Mini tables carry no explicit defaults, so callers that need them
+// should check upb_Message_HasField() per field.
+UPB_API_INLINE void upb_Message_ExtractFields(
+    const upb_Message* msg, const upb_MiniTableField* const* fields,
+    size_t count, upb_MessageValue* values) {
+  upb_MessageValue zero;
+  memset(&zero, 0, sizeof(zero));
+  for (size_t i = 0; i < count; i++) {
+    values[i] = zero;
+    _upb_Message_GetField(msg, fields[i], &zero, &values[i]);
+  }
+}
+
+#define kUpb_Message_Begin -1
+
+// Iterates over the message's set fields in field-definition order, without
+// testing each field's presence individually: runs of unset hasbit fields
+// are skipped with one load per hasbit byte.  A field counts as set under
+// the same rules the encoder uses: hasbit set, oneof case matching, a
+// non-empty array or map, or a nonzero value for fields with implicit
+// presence.  Extensions are not visited.  Returns NULL when no set fields
+// remain.
+//
+//   size_t iter = kUpb_Message_Begin;
+//   const upb_MiniTableField* f;
+//   while ((f = upb_Message_NextSetField(msg, mt, &iter)) != NULL) {
+//     ...
+//   }
+UPB_API const upb_MiniTableField* upb_Message_NextSetField(
+    const upb_Message* msg, const upb_MiniTable* mini_table, size_t* iter);
+
 UPB_API_INLINE bool upb_Message_GetBool(const upb_Message* msg,
                                         const upb_MiniTableField* field,
                                         bool default_val) {
@@ -238,6 +377,14 @@ upb_Message_GetString(const upb_Message* msg, const upb_MiniTableField* field,
              upb_MiniTableField_CType(field) == kUpb_CType_Bytes);
   UPB_ASSUME(_upb_MiniTableField_GetRep(field) == kUpb_FieldRep_StringView);
   UPB_ASSUME(!upb_IsRepeatedOrMap(field));
+  if (UPB_UNLIKELY(_upb_MiniTableField_IsInlineString(field))) {
+    // The slot may hold the bytes themselves rather than a view; return a
+    // view of the slot in that case (valid until the field is modified).
+    const void* slot = _upb_MiniTableField_GetConstPtr(msg, field);
+    if (_upb_InlineString_IsInline(slot)) {
+      return _upb_InlineString_Decode(slot);
+    }
+  }
   upb_StringView ret;
   _upb_Message_GetField(msg, field, &def_val, &ret);
   return ret;
@@ -250,6 +397,12 @@ UPB_API_INLINE bool upb_Message_SetString(upb_Message* msg,
              upb_MiniTableField_CType(field) == kUpb_CType_Bytes);
   UPB_ASSUME(_upb_MiniTableField_GetRep(field) == kUpb_FieldRep_StringView);
   UPB_ASSUME(!upb_IsRepeatedOrMap(field));
+  if (UPB_UNLIKELY(_upb_MiniTableField_IsInlineString(field)) &&
+      _upb_InlineString_CanStore(value.size)) {
+    char inline_val[sizeof(upb_StringView)];
+    _upb_InlineString_Encode(inline_val, value.data, value.size);
+    return _upb_Message_SetField(msg, field, inline_val, a);
+  }
   return _upb_Message_SetField(msg, field, &value, a);
 }
 
@@ -324,6 +477,10 @@ UPB_API_INLINE const upb_Array* upb_Message_GetArray(
 UPB_API_INLINE upb_Array* upb_Message_GetMutableArray(
     upb_Message* msg, const upb_MiniTableField* field) {
   _upb_MiniTableField_CheckIsArray(field);
+  // The returned handle can mutate the array without going back through the
+  // message, so conservatively treat this message as dirty (see
+  // kUpb_DecodeOption_RetainWireBytes).
+  _upb_Message_InvalidateWireSpan(msg);
   return (upb_Array*)upb_Message_GetArray(msg, field);
 }
 
@@ -333,7 +490,8 @@ UPB_API_INLINE upb_Array* upb_Message_GetOrCreateMutableArray(
   _upb_MiniTableField_CheckIsArray(field);
   upb_Array* array = upb_Message_GetMutableArray(msg, field);
   if (!array) {
-    array = _upb_Array_New(arena, 4, _upb_MiniTable_ElementSizeLg2(field));
+    const size_t lg2 = _upb_MiniTable_ElementSizeLg2(field);
+    array = _upb_Array_New(arena, _upb_Array_InitialCapacity(lg2), lg2);
     // Check again due to: https://godbolt.org/z/7WfaoKG1r
     _upb_MiniTableField_CheckIsArray(field);
     _upb_Message_SetField(msg, field, &array, arena);
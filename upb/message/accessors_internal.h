@@ -32,6 +32,7 @@
 #include "upb/message/extension_internal.h"
 #include "upb/message/internal.h"
 #include "upb/mini_table/internal/field.h"
+#include "upb/mini_table/message.h"
 
 // Must be last.
 #include "upb/port/def.inc"
@@ -94,6 +95,46 @@ UPB_INLINE void _upb_sethas_field(const upb_Message* msg,
   _upb_sethas(msg, _upb_Message_Hasidx(f));
 }
 
+// Bulk hasbit access //////////////////////////////////////////////////////////
+
+// The hasbit region occupies the lowest upb_MiniTable_HasbitBytes() bytes of
+// the message.  Clear/merge paths use these word-granularity primitives so
+// presence metadata for wide messages moves a word at a time instead of one
+// read-modify-write per field.
+
+UPB_INLINE void _upb_Message_ClearHasbits(upb_Message* msg,
+                                          const upb_MiniTable* m) {
+  memset(msg, 0, upb_MiniTable_HasbitBytes(m));
+}
+
+UPB_INLINE void _upb_Message_CopyHasbits(upb_Message* dst,
+                                         const upb_Message* src,
+                                         const upb_MiniTable* m) {
+  memcpy(dst, src, upb_MiniTable_HasbitBytes(m));
+}
+
+// Ors the source hasbits into the destination; equivalent to calling
+// _upb_sethas_field() on the destination for every field whose hasbit is set
+// in the source.  Destination presence is never cleared.
+UPB_INLINE void _upb_Message_MergeHasbits(upb_Message* dst,
+                                          const upb_Message* src,
+                                          const upb_MiniTable* m) {
+  size_t n = upb_MiniTable_HasbitBytes(m);
+  char* d = (char*)dst;
+  const char* s = (const char*)src;
+  while (n >= sizeof(uint64_t)) {
+    uint64_t dw, sw;
+    memcpy(&dw, d, sizeof(dw));
+    memcpy(&sw, s, sizeof(sw));
+    dw |= sw;
+    memcpy(d, &dw, sizeof(dw));
+    d += sizeof(dw);
+    s += sizeof(sw);
+    n -= sizeof(dw);
+  }
+  while (n--) *d++ |= *s++;
+}
+
 // Oneof case access ///////////////////////////////////////////////////////////
 
 UPB_INLINE size_t _upb_oneofcase_ofs(const upb_MiniTableField* f) {
@@ -179,6 +220,72 @@ UPB_INLINE void _upb_MiniTable_CopyFieldData(void* to, const void* from,
 
 // LINT.ThenChange(//depot/google3/third_party/upb/js/impl/upb_bits/message.ts:message_raw_fields)
 
+/* Inline small strings *******************************************************
+ *
+ * A scalar string/bytes field flagged with kUpb_LabelFlags_IsInlineString may
+ * store short values directly in its upb_StringView slot, saving the arena
+ * copy and a cache miss on read.  The encoding reuses the slot's own bytes:
+ *
+ *   bytes [0, N-2]  the string data (zero padded)
+ *   byte  N-1       (size << 1) | 1
+ *
+ * where N == sizeof(upb_StringView).  On little-endian machines the tag byte
+ * overlays the most significant byte of upb_StringView.size, which is zero
+ * for any out-of-line string (sizes >= 2^56 are unrepresentable in practice),
+ * so a clear low bit in byte N-1 means the slot holds an ordinary view.  An
+ * all-zero slot reads as an ordinary empty view, so cleared fields and
+ * freshly-allocated messages need no special handling.
+ *
+ * Inlining is strictly opportunistic: an ordinary view is always a valid
+ * representation for a flagged field, which is how long values, big-endian
+ * machines (where the tag would overlay the *low* byte of the size), and
+ * writers that bypass these helpers (fasttable, reflection set paths) stay
+ * correct.  Readers of flagged fields must decode through
+ * _upb_InlineString_IsInline() and never hand the raw slot bytes out as a
+ * pointer. */
+
+UPB_INLINE bool _upb_InlineString_Supported(void) {
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return true;
+#else
+  return false;
+#endif
+}
+
+// True if a value of this size can be stored inline (15 bytes on 64-bit
+// platforms, 7 on 32-bit).
+UPB_INLINE bool _upb_InlineString_CanStore(size_t size) {
+  return _upb_InlineString_Supported() && size < sizeof(upb_StringView);
+}
+
+UPB_INLINE bool _upb_InlineString_IsInline(const void* slot) {
+  return _upb_InlineString_Supported() &&
+         (((const char*)slot)[sizeof(upb_StringView) - 1] & 1) != 0;
+}
+
+// Encodes `[data, size)` into the sizeof(upb_StringView) bytes at `slot`.
+// Requires _upb_InlineString_CanStore(size).
+UPB_INLINE void _upb_InlineString_Encode(void* slot, const char* data,
+                                         size_t size) {
+  char* bytes = (char*)slot;
+  UPB_ASSERT(_upb_InlineString_CanStore(size));
+  if (size) memcpy(bytes, data, size);
+  memset(bytes + size, 0, sizeof(upb_StringView) - 1 - size);
+  bytes[sizeof(upb_StringView) - 1] = (char)((size << 1) | 1);
+}
+
+// Decodes an inline slot into a view of the slot's own bytes; the view is
+// valid as long as the field (and message) are not modified.  Requires
+// _upb_InlineString_IsInline(slot).
+UPB_INLINE upb_StringView _upb_InlineString_Decode(const void* slot) {
+  upb_StringView ret;
+  UPB_ASSERT(_upb_InlineString_IsInline(slot));
+  ret.data = (const char*)slot;
+  ret.size = ((const uint8_t*)slot)[sizeof(upb_StringView) - 1] >> 1;
+  return ret;
+}
+
 UPB_INLINE size_t
 _upb_MiniTable_ElementSizeLg2(const upb_MiniTableField* field) {
   const unsigned char table[] = {
@@ -294,6 +401,7 @@ UPB_INLINE void _upb_Message_GetField(const upb_Message* msg,
 UPB_INLINE void _upb_Message_SetNonExtensionField(
     upb_Message* msg, const upb_MiniTableField* field, const void* val) {
   UPB_ASSUME(!upb_MiniTableField_IsExtension(field));
+  _upb_Message_InvalidateWireSpan(msg);
   _upb_Message_SetPresence(msg, field);
   _upb_MiniTable_CopyFieldData(_upb_MiniTableField_GetPtr(msg, field), val,
                                field);
@@ -331,8 +439,11 @@ UPB_INLINE void _upb_Message_ClearExtensionField(
   upb_Message_Extension* ext =
       (upb_Message_Extension*)_upb_Message_Getext(msg, ext_l);
   if (ext) {
-    *ext = *base;
+    // Slide the lower-keyed entries up one slot so the array stays sorted
+    // (see _upb_Message_ExtKeyLess()).
+    memmove((void*)(base + 1), base, (char*)ext - (char*)base);
     in->internal->ext_begin += sizeof(upb_Message_Extension);
+    in->internal->wire_data = NULL;
   }
 }
 
@@ -345,6 +456,7 @@ UPB_INLINE void _upb_Message_ClearNonExtensionField(
     if (*oneof_case != field->number) return;
     *oneof_case = 0;
   }
+  _upb_Message_InvalidateWireSpan(msg);
   const char zeros[16] = {0};
   _upb_MiniTable_CopyFieldData(_upb_MiniTableField_GetPtr(msg, field), zeros,
                                field);
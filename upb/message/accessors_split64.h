@@ -38,6 +38,14 @@ extern "C" {
 #endif
 
 // JavaScript doesn't directly support 64-bit ints so we must split them.
+//
+// Bindings for hosts that do support 64-bit ints should test UPB_NATIVE_INT64
+// (see port/def.inc; set on 64-bit targets and on WebAssembly, where wasm32
+// still has native i64) and call the whole-value accessors instead:
+// upb_Message_GetInt64()/SetInt64()/GetUInt64()/SetUInt64() in accessors.h
+// for message fields, and the upb_Array_*Int64() variants in
+// collections/array_split64.h for repeated fields.  The split accessors below
+// cost two calls and a shift/merge per value.
 
 UPB_API_INLINE uint32_t upb_Message_GetInt64Hi(const upb_Message* msg,
                                                const upb_MiniTableField* field,
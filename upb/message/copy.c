@@ -30,6 +30,7 @@
 #include "upb/mem/arena.h"
 #include "upb/message/accessors.h"
 #include "upb/message/message.h"
+#include "upb/port/atomic.h"
 
 // Must be last.
 #include "upb/port/def.inc"
@@ -189,9 +190,14 @@ static bool upb_Clone_ExtensionValue(
       mini_table_ext->sub.submsg, arena);
 }
 
-upb_Message* _upb_Message_Copy(upb_Message* dst, const upb_Message* src,
-                               const upb_MiniTable* mini_table,
-                               upb_Arena* arena) {
+// Like _upb_Message_Copy() but leaves the fields in `skip_arrays` alone (the
+// destination keeps the memcpy'd source array pointer, which the caller must
+// overwrite).  Used by the parallel clone below to carve the big repeated
+// sub-message fields out of the serial pass.
+static upb_Message* _upb_Message_CopyPartial(
+    upb_Message* dst, const upb_Message* src, const upb_MiniTable* mini_table,
+    upb_Arena* arena, const upb_MiniTableField* const* skip_arrays,
+    size_t skip_count) {
   upb_StringView empty_string = upb_StringView_FromDataAndSize(NULL, 0);
   // Only copy message area skipping upb_Message_Internal.
   memcpy(dst, src, mini_table->size);
@@ -245,6 +251,14 @@ upb_Message* _upb_Message_Copy(upb_Message* dst, const upb_Message* src,
           }
         }
       } else {
+        bool skip = false;
+        for (size_t j = 0; j < skip_count; j++) {
+          if (skip_arrays[j] == field) {
+            skip = true;
+            break;
+          }
+        }
+        if (skip) continue;
         const upb_Array* array = upb_Message_GetArray(src, field);
         if (array != NULL) {
           if (!upb_Message_Array_DeepClone(array, mini_table, field, dst,
@@ -297,6 +311,201 @@ upb_Message* _upb_Message_Copy(upb_Message* dst, const upb_Message* src,
   return dst;
 }
 
+upb_Message* _upb_Message_Copy(upb_Message* dst, const upb_Message* src,
+                               const upb_MiniTable* mini_table,
+                               upb_Arena* arena) {
+  return _upb_Message_CopyPartial(dst, src, mini_table, arena, NULL, 0);
+}
+
+/* Shared (copy-on-write) cloning ********************************************/
+
+static bool upb_CloneShared_MessageValue(void* value, upb_CType value_type,
+                                         const upb_MiniTable* sub,
+                                         upb_Arena* arena) {
+  // Scalars were copied wholesale and strings are shared; only sub-messages
+  // need their own (recursively shared) headers so the trees can diverge.
+  if (value_type != kUpb_CType_Message) return true;
+  const upb_TaggedMessagePtr source = *(upb_TaggedMessagePtr*)value;
+  bool is_empty = upb_TaggedMessagePtr_IsEmpty(source);
+  if (is_empty) sub = &_kUpb_MiniTable_Empty;
+  UPB_ASSERT(source);
+  upb_Message* clone = upb_Message_CloneShared(
+      _upb_TaggedMessagePtr_GetMessage(source), sub, arena);
+  *(upb_TaggedMessagePtr*)value = _upb_TaggedMessagePtr_Pack(clone, is_empty);
+  return clone != NULL;
+}
+
+upb_Array* upb_Array_CloneShared(const upb_Array* array, upb_CType value_type,
+                                 const upb_MiniTable* sub, upb_Arena* arena) {
+  const int lg2 = _upb_Array_CTypeSizeLg2(value_type);
+  const size_t size = array->size;
+  if (value_type == kUpb_CType_Message) {
+    // Message elements need distinct pointers per tree, so the element
+    // storage cannot be shared; each element becomes a shared clone.
+    upb_Array* cloned = _upb_Array_New(arena, size, lg2);
+    if (!cloned) return NULL;
+    if (!_upb_Array_ResizeUninitialized(cloned, size, arena)) return NULL;
+    for (size_t i = 0; i < size; ++i) {
+      upb_MessageValue val = upb_Array_Get(array, i);
+      if (!upb_CloneShared_MessageValue(&val, value_type, sub, arena)) {
+        return NULL;
+      }
+      upb_Array_Set(cloned, i, val);
+    }
+    return cloned;
+  }
+  if (size == 0) {
+    // Nothing to borrow; an independent empty array avoids aliasing the
+    // source's spare capacity.
+    return _upb_Array_New(arena, _upb_Array_InitialCapacity(lg2), lg2);
+  }
+  // Scalar/string elements: a new header borrowing the source's storage.
+  // The sub-size capacity marks the storage as borrowed so that
+  // _upb_array_realloc() copies it on the first growth.
+  upb_Array* cloned = upb_Arena_Malloc(arena, sizeof(upb_Array));
+  if (!cloned) return NULL;
+  cloned->data = array->data;
+  cloned->size = size;
+  cloned->capacity = 0;
+  return cloned;
+}
+
+upb_Map* upb_Map_CloneShared(const upb_Map* map, upb_CType key_type,
+                             upb_CType value_type,
+                             const upb_MiniTable* map_entry_table,
+                             upb_Arena* arena) {
+  if (value_type == kUpb_CType_Message) {
+    // Message values need distinct headers per tree, so the table cannot be
+    // shared; clone entry-wise with recursively shared values.
+    upb_Map* cloned_map = _upb_Map_New(arena, map->key_size, map->val_size);
+    if (cloned_map == NULL) return NULL;
+    const upb_MiniTableField* value_field = &map_entry_table->fields[1];
+    const upb_MiniTable* value_sub =
+        upb_MiniTable_GetSubMessageTable(map_entry_table, value_field);
+    upb_MessageValue key, val;
+    size_t iter = kUpb_Map_Begin;
+    while (upb_Map_Next(map, &key, &val, &iter)) {
+      if (!upb_CloneShared_MessageValue(&val, value_type, value_sub, arena)) {
+        return NULL;
+      }
+      if (upb_Map_Insert(cloned_map, key, val, arena) ==
+          kUpb_MapInsertStatus_OutOfMemory) {
+        return NULL;
+      }
+    }
+    return cloned_map;
+  }
+  // Scalar/string values: a new map header borrowing the source's entry
+  // storage.  Mutating entry points copy it first via _upb_Map_EnsureOwned().
+  upb_Map* cloned_map = upb_Arena_Malloc(arena, sizeof(upb_Map));
+  if (!cloned_map) return NULL;
+  cloned_map->key_size = map->key_size;
+  cloned_map->val_size = map->val_size;
+  cloned_map->is_borrowed = true;
+  cloned_map->is_flat = map->is_flat;
+  cloned_map->table = map->table;
+  cloned_map->flat_ctrl = map->flat_ctrl;
+  cloned_map->flat_slots = map->flat_slots;
+  cloned_map->flat_count = map->flat_count;
+  cloned_map->flat_used = map->flat_used;
+  cloned_map->flat_size_lg2 = map->flat_size_lg2;
+  cloned_map->arena = arena;
+  return cloned_map;
+}
+
+static upb_Message* _upb_Message_CloneSharedInto(
+    upb_Message* dst, const upb_Message* src, const upb_MiniTable* mini_table,
+    upb_Arena* arena) {
+  // Scalars are copied and string views shared by the wholesale copy; the
+  // loop below replaces the container and sub-message pointers.
+  memcpy(dst, src, mini_table->size);
+  for (size_t i = 0; i < mini_table->field_count; ++i) {
+    const upb_MiniTableField* field = &mini_table->fields[i];
+    if (!upb_IsRepeatedOrMap(field)) {
+      if (upb_MiniTableField_CType(field) != kUpb_CType_Message) continue;
+      upb_TaggedMessagePtr tagged =
+          upb_Message_GetTaggedMessagePtr(src, field, NULL);
+      if (_upb_TaggedMessagePtr_GetMessage(tagged) == NULL) continue;
+      if (!upb_CloneShared_MessageValue(
+              &tagged, kUpb_CType_Message,
+              upb_TaggedMessagePtr_IsEmpty(tagged)
+                  ? NULL
+                  : upb_MiniTable_GetSubMessageTable(mini_table, field),
+              arena)) {
+        return NULL;
+      }
+      _upb_Message_SetTaggedMessagePtr(dst, mini_table, field, tagged);
+    } else if (upb_MessageField_IsMap(field)) {
+      const upb_Map* map = upb_Message_GetMap(src, field);
+      if (map == NULL) continue;
+      const upb_MiniTable* map_entry_table =
+          mini_table->subs[field->UPB_PRIVATE(submsg_index)].submsg;
+      upb_Map* cloned_map = upb_Map_CloneShared(
+          map, upb_MiniTableField_CType(&map_entry_table->fields[0]),
+          upb_MiniTableField_CType(&map_entry_table->fields[1]),
+          map_entry_table, arena);
+      if (!cloned_map) return NULL;
+      _upb_Message_SetNonExtensionField(dst, field, &cloned_map);
+    } else {
+      const upb_Array* array = upb_Message_GetArray(src, field);
+      if (array == NULL) continue;
+      upb_Array* cloned_array = upb_Array_CloneShared(
+          array, upb_MiniTableField_CType(field),
+          upb_MiniTableField_CType(field) == kUpb_CType_Message &&
+                  field->UPB_PRIVATE(submsg_index) != kUpb_NoSub
+              ? upb_MiniTable_GetSubMessageTable(mini_table, field)
+              : NULL,
+          arena);
+      if (!cloned_array) return NULL;
+      _upb_Message_SetNonExtensionField(dst, field, &cloned_array);
+    }
+  }
+  // Extensions: scalar/string payloads are shared, sub-messages and arrays
+  // get shared clones.
+  size_t ext_count;
+  const upb_Message_Extension* ext = _upb_Message_Getexts(src, &ext_count);
+  for (size_t i = 0; i < ext_count; ++i) {
+    const upb_Message_Extension* msg_ext = &ext[i];
+    const upb_MiniTableField* field = &msg_ext->ext->field;
+    upb_Message_Extension* dst_ext =
+        _upb_Message_GetOrCreateExtension(dst, msg_ext->ext, arena);
+    if (!dst_ext) return NULL;
+    if (!upb_IsRepeatedOrMap(field)) {
+      dst_ext->data = msg_ext->data;
+      if (!upb_CloneShared_MessageValue(&dst_ext->data,
+                                        upb_MiniTableField_CType(field),
+                                        msg_ext->ext->sub.submsg, arena)) {
+        return NULL;
+      }
+    } else {
+      upb_Array* msg_array = (upb_Array*)msg_ext->data.ptr;
+      UPB_ASSERT(msg_array);
+      upb_Array* cloned_array =
+          upb_Array_CloneShared(msg_array, upb_MiniTableField_CType(field),
+                                msg_ext->ext->sub.submsg, arena);
+      if (!cloned_array) return NULL;
+      dst_ext->data.ptr = (void*)cloned_array;
+    }
+  }
+  // Unknown fields are copied eagerly; they are usually small next to the
+  // payloads shared above, and sharing them would complicate appends.
+  size_t unknown_size = 0;
+  const char* ptr = upb_Message_GetUnknown(src, &unknown_size);
+  if (unknown_size != 0) {
+    UPB_ASSERT(ptr);
+    if (!_upb_Message_AddUnknown(dst, ptr, unknown_size, arena)) return NULL;
+  }
+  return dst;
+}
+
+upb_Message* upb_Message_CloneShared(const upb_Message* message,
+                                     const upb_MiniTable* mini_table,
+                                     upb_Arena* arena) {
+  upb_Message* clone = upb_Message_New(mini_table, arena);
+  if (!clone) return NULL;
+  return _upb_Message_CloneSharedInto(clone, message, mini_table, arena);
+}
+
 void upb_Message_DeepCopy(upb_Message* dst, const upb_Message* src,
                           const upb_MiniTable* mini_table, upb_Arena* arena) {
   upb_Message_Clear(dst, mini_table);
@@ -312,3 +521,417 @@ upb_Message* upb_Message_DeepClone(const upb_Message* message,
   upb_Message* clone = upb_Message_New(mini_table, arena);
   return _upb_Message_Copy(clone, message, mini_table, arena);
 }
+
+// Deep-copies the live graph reachable from |message| into a fresh arena
+// whose first block is sized from a measurement pass, and returns the copy
+// with the new arena in *out_arena.
+//
+// Returns NULL on allocation failure (nothing is leaked and *out_arena is
+// not written).
+upb_Message* upb_Message_Compact(const upb_Message* message,
+                                 const upb_MiniTable* mini_table,
+                                 upb_Arena** out_arena) {
+  // Measurement pass: clone onto a scratch arena and read back exactly how
+  // many bytes the live graph occupies, free of the dead array generations
+  // and discarded sub-messages the source arena accumulated.
+  upb_Arena* scratch = upb_Arena_New();
+  if (!scratch) return NULL;
+  upb_Message* measured = upb_Message_DeepClone(message, mini_table, scratch);
+  if (!measured) {
+    upb_Arena_Free(scratch);
+    return NULL;
+  }
+  upb_ArenaStats stats;
+  upb_Arena_GetStats(scratch, &stats);
+
+  // Final pass: the same clone into an arena whose first block holds the
+  // whole graph (a little slack covers block-start alignment rounding).
+  // Cloning from the scratch copy keeps the source pages cold and the reads
+  // cache-hot.
+  upb_ArenaPolicy policy = {0};
+  policy.initial_block_size = stats.space_used + 64;
+  upb_Arena* arena = upb_Arena_NewWithPolicy(&policy, NULL);
+  upb_Message* compacted = NULL;
+  if (arena) {
+    compacted = upb_Message_DeepClone(measured, mini_table, arena);
+    if (!compacted) upb_Arena_Free(arena);
+  }
+  upb_Arena_Free(scratch);
+  if (!compacted) return NULL;
+  *out_arena = arena;
+  return compacted;
+}
+
+/* Parallel deep clone ********************************************************/
+
+// One partitioned field: a top-level repeated sub-message field whose
+// elements are cloned by the tasks instead of the serial pass.
+typedef struct {
+  const upb_Array* src;
+  upb_Array* dst;              // Pre-sized; tasks fill disjoint slots.
+  const upb_MiniTable* sub;    // NULL only for unlinked ("empty") elements.
+  size_t flat_begin;           // First flattened element index of this field.
+} upb_ParallelClone_Range;
+
+struct upb_ParallelDeepClone {
+  upb_Message* clone;  // Trunk clone; partitioned arrays not yet filled.
+  upb_Arena* arena;    // Target arena.
+  upb_ParallelClone_Range* ranges;
+  size_t range_count;
+  size_t total_elements;
+  size_t task_count;
+  upb_Arena** task_arenas;  // One per task, pre-fused with `arena`.
+  UPB_ATOMIC(bool) failed;
+};
+
+upb_ParallelDeepClone* upb_Message_ParallelDeepClone_Start(
+    const upb_Message* message, const upb_MiniTable* mini_table,
+    size_t max_tasks, upb_Arena* arena) {
+  if (max_tasks == 0) max_tasks = 1;
+
+  upb_ParallelDeepClone* p = upb_Arena_Malloc(arena, sizeof(*p));
+  if (!p) return NULL;
+  p->arena = arena;
+  upb_Atomic_Init(&p->failed, false);
+
+  // Pick the fields worth partitioning: non-empty top-level repeated
+  // sub-message fields.  Everything else is cloned serially below.
+  p->range_count = 0;
+  p->total_elements = 0;
+  p->ranges = upb_Arena_Malloc(
+      arena, mini_table->field_count * sizeof(*p->ranges));
+  const upb_MiniTableField** skip = upb_Arena_Malloc(
+      arena, mini_table->field_count * sizeof(*skip));
+  if ((!p->ranges || !skip) && mini_table->field_count > 0) return NULL;
+  for (size_t i = 0; i < mini_table->field_count; ++i) {
+    const upb_MiniTableField* field = &mini_table->fields[i];
+    if (upb_FieldMode_Get(field) != kUpb_FieldMode_Array) continue;
+    if (upb_MiniTableField_CType(field) != kUpb_CType_Message) continue;
+    const upb_Array* array = upb_Message_GetArray(message, field);
+    if (!array || array->size == 0) continue;
+
+    upb_Array* dst = upb_Array_New(arena, kUpb_CType_Message);
+    if (!dst || !upb_Array_Resize(dst, array->size, arena)) return NULL;
+
+    upb_ParallelClone_Range* range = &p->ranges[p->range_count];
+    range->src = array;
+    range->dst = dst;
+    range->sub = field->UPB_PRIVATE(submsg_index) != kUpb_NoSub
+                     ? upb_MiniTable_GetSubMessageTable(mini_table, field)
+                     : NULL;
+    range->flat_begin = p->total_elements;
+    skip[p->range_count] = field;
+    p->range_count++;
+    p->total_elements += array->size;
+  }
+
+  // Serial trunk: everything except the partitioned elements.
+  p->clone = upb_Message_New(mini_table, arena);
+  if (!p->clone ||
+      !_upb_Message_CopyPartial(p->clone, message, mini_table, arena, skip,
+                                p->range_count)) {
+    return NULL;
+  }
+  for (size_t i = 0; i < p->range_count; ++i) {
+    _upb_Message_SetNonExtensionField(p->clone, skip[i], &p->ranges[i].dst);
+  }
+
+  // One arena per task, fused with the target up front so a fusing problem
+  // (e.g. a target arena with an initial block) fails here rather than after
+  // the cloning work is done.
+  p->task_count = UPB_MIN(max_tasks, p->total_elements);
+  p->task_arenas = NULL;
+  if (p->task_count > 0) {
+    p->task_arenas =
+        upb_Arena_Malloc(arena, p->task_count * sizeof(*p->task_arenas));
+    if (!p->task_arenas) return NULL;
+    for (size_t i = 0; i < p->task_count; ++i) {
+      upb_Arena* task_arena = upb_Arena_New();
+      if (!task_arena || !upb_Arena_Fuse(arena, task_arena)) {
+        if (task_arena) upb_Arena_Free(task_arena);
+        for (size_t j = 0; j < i; ++j) upb_Arena_Free(p->task_arenas[j]);
+        return NULL;
+      }
+      p->task_arenas[i] = task_arena;
+    }
+  }
+  return p;
+}
+
+size_t upb_ParallelDeepClone_TaskCount(const upb_ParallelDeepClone* p) {
+  return p->task_count;
+}
+
+void upb_ParallelDeepClone_RunTask(upb_ParallelDeepClone* p, size_t task) {
+  UPB_ASSERT(task < p->task_count);
+  upb_Arena* arena = p->task_arenas[task];
+
+  // Contiguous slice of the flattened element index space; the first
+  // `total_elements % task_count` tasks take one extra element.
+  size_t base = p->total_elements / p->task_count;
+  size_t extra = p->total_elements % p->task_count;
+  size_t begin = task * base + UPB_MIN(task, extra);
+  size_t end = begin + base + (task < extra ? 1 : 0);
+
+  const upb_ParallelClone_Range* range = p->ranges;
+  for (size_t flat = begin; flat < end; ++flat) {
+    while (flat - range->flat_begin >= range->src->size) range++;
+    size_t idx = flat - range->flat_begin;
+    upb_MessageValue val;
+    memcpy(&val, (const char*)_upb_array_constptr(range->src) +
+                     idx * sizeof(upb_TaggedMessagePtr),
+           sizeof(upb_TaggedMessagePtr));
+    if (!upb_Clone_MessageValue(&val, kUpb_CType_Message, range->sub, arena)) {
+      upb_Atomic_Store(&p->failed, true, memory_order_relaxed);
+      return;
+    }
+    memcpy((char*)_upb_array_ptr(range->dst) +
+               idx * sizeof(upb_TaggedMessagePtr),
+           &val, sizeof(upb_TaggedMessagePtr));
+  }
+}
+
+upb_Message* upb_ParallelDeepClone_Finish(upb_ParallelDeepClone* p) {
+  // The task arenas were fused with the target when the clone started, so
+  // dropping our references here leaves the cloned elements alive until the
+  // caller frees the target arena.
+  for (size_t i = 0; i < p->task_count; ++i) {
+    upb_Arena_Free(p->task_arenas[i]);
+  }
+  p->task_count = 0;
+  if (upb_Atomic_Load(&p->failed, memory_order_relaxed)) return NULL;
+  return p->clone;
+}
+
+/* Deep unknown-field discard *************************************************/
+
+static bool _upb_Message_DeepDiscardUnknown(upb_Message* msg,
+                                            const upb_MiniTable* m, int depth);
+
+static bool upb_DiscardUnknown_TaggedPtr(upb_TaggedMessagePtr ptr,
+                                         const upb_MiniTable* sub, int depth) {
+  // Unlinked sub-messages store their deferred payload as unknown bytes;
+  // leave them alone.
+  if (ptr == 0 || upb_TaggedMessagePtr_IsEmpty(ptr)) return true;
+  return _upb_Message_DeepDiscardUnknown(
+      upb_TaggedMessagePtr_GetNonEmptyMessage(ptr), sub, depth);
+}
+
+static bool _upb_Message_DeepDiscardUnknown(upb_Message* msg,
+                                            const upb_MiniTable* m, int depth) {
+  if (depth-- == 0) return false;
+  bool ok = true;
+  _upb_Message_DiscardUnknown_shallow(msg);
+
+  for (size_t i = 0; i < m->field_count; i++) {
+    const upb_MiniTableField* f = &m->fields[i];
+
+    if (upb_IsRepeatedOrMap(f)) {
+      if (upb_FieldMode_Get(f) == kUpb_FieldMode_Map) {
+        const upb_MiniTable* entry =
+            m->subs[f->UPB_PRIVATE(submsg_index)].submsg;
+        const upb_MiniTableField* val_f = &entry->fields[1];
+        if (upb_MiniTableField_CType(val_f) != kUpb_CType_Message) continue;
+        const upb_Map* map = *UPB_PTR_AT(msg, f->offset, upb_Map*);
+        if (!map) continue;
+        const upb_MiniTable* sub =
+            upb_MiniTable_GetSubMessageTable(entry, val_f);
+        size_t iter = kUpb_Map_Begin;
+        upb_MessageValue key, val;
+        while (upb_Map_Next(map, &key, &val, &iter)) {
+          ok &= upb_DiscardUnknown_TaggedPtr(val.tagged_msg_val, sub, depth);
+        }
+      } else if (upb_MiniTableField_CType(f) == kUpb_CType_Message) {
+        const upb_Array* arr = *UPB_PTR_AT(msg, f->offset, upb_Array*);
+        const size_t size = arr ? upb_Array_Size(arr) : 0;
+        const upb_MiniTable* sub = upb_MiniTable_GetSubMessageTable(m, f);
+        for (size_t j = 0; j < size; j++) {
+          ok &= upb_DiscardUnknown_TaggedPtr(
+              upb_Array_Get(arr, j).tagged_msg_val, sub, depth);
+        }
+      }
+      continue;
+    }
+
+    if (upb_MiniTableField_CType(f) != kUpb_CType_Message) continue;
+    const upb_MiniTable* sub = upb_MiniTable_GetSubMessageTable(m, f);
+    if (f->presence > 0) {
+      if (!_upb_hasbit_field(msg, f)) continue;
+    } else if (_upb_MiniTableField_InOneOf(f)) {
+      if (_upb_getoneofcase_field(msg, f) != f->number) continue;
+    }
+    ok &= upb_DiscardUnknown_TaggedPtr(
+        *UPB_PTR_AT(msg, f->offset, upb_TaggedMessagePtr), sub, depth);
+  }
+
+  // Message-typed extensions are always linked, but repeated ones still hold
+  // tagged pointers, so they go through the same helper.
+  size_t ext_count;
+  const upb_Message_Extension* ext = _upb_Message_Getexts(msg, &ext_count);
+  for (size_t i = 0; i < ext_count; i++) {
+    const upb_MiniTableField* f = &ext[i].ext->field;
+    if (upb_MiniTableField_CType(f) != kUpb_CType_Message) continue;
+    const upb_MiniTable* sub = ext[i].ext->sub.submsg;
+    if (upb_IsRepeatedOrMap(f)) {
+      const upb_Array* arr = ext[i].data.ptr;
+      const size_t size = arr ? upb_Array_Size(arr) : 0;
+      for (size_t j = 0; j < size; j++) {
+        ok &= upb_DiscardUnknown_TaggedPtr(upb_Array_Get(arr, j).tagged_msg_val,
+                                           sub, depth);
+      }
+    } else if (ext[i].data.ptr) {
+      ok &= _upb_Message_DeepDiscardUnknown((upb_Message*)ext[i].data.ptr, sub,
+                                            depth);
+    }
+  }
+  return ok;
+}
+
+bool upb_Message_DeepDiscardUnknown(upb_Message* msg, const upb_MiniTable* m,
+                                    int maxdepth) {
+  return _upb_Message_DeepDiscardUnknown(msg, m, maxdepth);
+}
+
+/* Arena-fused shallow merge **************************************************/
+
+static bool _upb_Message_MergeFused(upb_Message* dst, const upb_Message* src,
+                                    const upb_MiniTable* mini_table,
+                                    upb_Arena* arena);
+
+static bool upb_MergeFused_Array(upb_Array** dst_slot, const upb_Array* src_arr,
+                                 upb_Arena* arena) {
+  if (*dst_slot == NULL) {
+    *dst_slot = (upb_Array*)src_arr;
+    return true;
+  }
+  upb_Array* dst_arr = *dst_slot;
+  const size_t size = upb_Array_Size(src_arr);
+  for (size_t i = 0; i < size; i++) {
+    if (!upb_Array_Append(dst_arr, upb_Array_Get(src_arr, i), arena)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool upb_MergeFused_Map(upb_Map** dst_slot, const upb_Map* src_map,
+                               upb_Arena* arena) {
+  if (*dst_slot == NULL) {
+    *dst_slot = (upb_Map*)src_map;
+    return true;
+  }
+  upb_Map* dst_map = *dst_slot;
+  upb_MessageValue key, val;
+  size_t iter = kUpb_Map_Begin;
+  while (upb_Map_Next(src_map, &key, &val, &iter)) {
+    // Duplicate keys take the source value, like re-parsing the entry would.
+    if (!upb_Map_Set(dst_map, key, val, arena)) return false;
+  }
+  return true;
+}
+
+static bool _upb_Message_MergeFused(upb_Message* dst, const upb_Message* src,
+                                    const upb_MiniTable* mini_table,
+                                    upb_Arena* arena) {
+  _upb_Message_InvalidateWireSpan(dst);
+
+  // Every set source field is merged below, so its hasbit ends up set in the
+  // destination; or the whole hasbit region in up front, a word at a time,
+  // and let the loop update only oneof cases.
+  _upb_Message_MergeHasbits(dst, src, mini_table);
+
+  size_t iter = kUpb_Message_Begin;
+  const upb_MiniTableField* field;
+  while ((field = upb_Message_NextSetField(src, mini_table, &iter)) != NULL) {
+    if (upb_IsRepeatedOrMap(field)) {
+      if (upb_MessageField_IsMap(field)) {
+        if (!upb_MergeFused_Map(
+                UPB_PTR_AT(dst, field->offset, upb_Map*),
+                *UPB_PTR_AT(src, field->offset, const upb_Map*), arena)) {
+          return false;
+        }
+      } else {
+        if (!upb_MergeFused_Array(
+                UPB_PTR_AT(dst, field->offset, upb_Array*),
+                *UPB_PTR_AT(src, field->offset, const upb_Array*), arena)) {
+          return false;
+        }
+      }
+      continue;
+    }
+    if (upb_MiniTableField_CType(field) == kUpb_CType_Message) {
+      upb_TaggedMessagePtr* dst_slot =
+          UPB_PTR_AT(dst, field->offset, upb_TaggedMessagePtr);
+      const upb_TaggedMessagePtr src_tagged =
+          *UPB_PTR_AT(src, field->offset, const upb_TaggedMessagePtr);
+      const bool dst_has =
+          (!_upb_MiniTableField_InOneOf(field) ||
+           _upb_getoneofcase_field(dst, field) == field->number) &&
+          *dst_slot != 0;
+      if (!dst_has || upb_TaggedMessagePtr_IsEmpty(*dst_slot) ||
+          upb_TaggedMessagePtr_IsEmpty(src_tagged)) {
+        // Splice the source message wholesale.  Unlinked ("empty") messages
+        // replace the destination value rather than merging with it, for the
+        // same reason upb_Message_DeepCopy() keeps them unparsed: we don't
+        // want to deal with decode options or parse failure here.
+        *dst_slot = src_tagged;
+      } else if (!_upb_Message_MergeFused(
+                     upb_TaggedMessagePtr_GetNonEmptyMessage(*dst_slot),
+                     upb_TaggedMessagePtr_GetNonEmptyMessage(src_tagged),
+                     upb_MiniTable_GetSubMessageTable(mini_table, field),
+                     arena)) {
+        return false;
+      }
+      if (_upb_MiniTableField_InOneOf(field)) {
+        *_upb_oneofcase_field(dst, field) = field->number;
+      }
+      continue;
+    }
+    // Scalars and strings: copy the value itself; string payloads stay where
+    // they are in the (now fused) source arena.
+    _upb_MiniTable_CopyFieldData(UPB_PTR_AT(dst, field->offset, char),
+                                 UPB_PTR_AT(src, field->offset, const char),
+                                 field);
+    if (_upb_MiniTableField_InOneOf(field)) {
+      *_upb_oneofcase_field(dst, field) = field->number;
+    }
+  }
+
+  size_t ext_count;
+  const upb_Message_Extension* ext = _upb_Message_Getexts(src, &ext_count);
+  for (size_t i = 0; i < ext_count; i++) {
+    const upb_MiniTableField* ext_field = &ext[i].ext->field;
+    upb_Message_Extension* dst_ext =
+        _upb_Message_GetOrCreateExtension(dst, ext[i].ext, arena);
+    if (!dst_ext) return false;
+    if (upb_IsRepeatedOrMap(ext_field)) {
+      if (!upb_MergeFused_Array((upb_Array**)&dst_ext->data.ptr,
+                                (const upb_Array*)ext[i].data.ptr, arena)) {
+        return false;
+      }
+    } else if (upb_MiniTableField_CType(ext_field) == kUpb_CType_Message &&
+               dst_ext->data.ptr != NULL) {
+      if (!_upb_Message_MergeFused(dst_ext->data.ptr, ext[i].data.ptr,
+                                   ext[i].ext->sub.submsg, arena)) {
+        return false;
+      }
+    } else {
+      dst_ext->data = ext[i].data;
+    }
+  }
+
+  size_t unknown_size;
+  const char* unknown = upb_Message_GetUnknown(src, &unknown_size);
+  if (unknown_size != 0 &&
+      !_upb_Message_AddUnknown(dst, unknown, unknown_size, arena)) {
+    return false;
+  }
+  return true;
+}
+
+bool upb_Message_MergeFused(upb_Message* dst, const upb_Message* src,
+                            const upb_MiniTable* mini_table,
+                            upb_Arena* dst_arena, upb_Arena* src_arena) {
+  if (!upb_Arena_Fuse(dst_arena, src_arena)) return false;
+  return _upb_Message_MergeFused(dst, src, mini_table, dst_arena);
+}
@@ -43,6 +43,62 @@ upb_Message* upb_Message_DeepClone(const upb_Message* message,
                                    const upb_MiniTable* mini_table,
                                    upb_Arena* arena);
 
+// Deep clones a message into a new right-sized arena, returning the clone
+// and the arena in *out_arena.  Long-lived caches that parse and mutate
+// before caching can call this to shed the dead allocations (old array
+// generations, discarded sub-messages, unknown-field scratch) the original
+// arena still holds; the caller frees the source arena and keeps the
+// returned one.  Costs two deep copies (one to measure, one to place).
+// Returns NULL on allocation failure, in which case *out_arena is untouched.
+upb_Message* upb_Message_Compact(const upb_Message* message,
+                                 const upb_MiniTable* mini_table,
+                                 upb_Arena** out_arena);
+
+/* Parallel deep clone ********************************************************
+ *
+ * Deep clone split across a caller-supplied thread pool.  The elements of
+ * the message's top-level repeated sub-message fields -- which dominate the
+ * clone cost for the large snapshot-style messages this is meant for -- are
+ * partitioned into independent tasks; everything else is cloned serially up
+ * front.  Each task clones into its own arena, pre-fused with the target via
+ * upb_Arena_Fuse(), so the finished clone lives exactly as long as the
+ * target arena.  Typical use:
+ *
+ *   upb_ParallelDeepClone* p =
+ *       upb_Message_ParallelDeepClone_Start(msg, mt, pool_size, arena);
+ *   for (size_t i = 0; i < upb_ParallelDeepClone_TaskCount(p); i++) {
+ *     // From any pool thread, each task exactly once:
+ *     upb_ParallelDeepClone_RunTask(p, i);
+ *   }
+ *   // After ALL tasks have completed:
+ *   upb_Message* clone = upb_ParallelDeepClone_Finish(p);
+ */
+
+typedef struct upb_ParallelDeepClone upb_ParallelDeepClone;
+
+// Clones everything but the partitioned elements and sets up the tasks.
+// Returns NULL on allocation failure, or if the target arena cannot fuse
+// (e.g. it was created with an initial block); the parallel form has the
+// same restriction upb_Message_MergeFused() documents.
+UPB_API upb_ParallelDeepClone* upb_Message_ParallelDeepClone_Start(
+    const upb_Message* message, const upb_MiniTable* mini_table,
+    size_t max_tasks, upb_Arena* arena);
+
+// Number of tasks to run; at most `max_tasks`, and 0 when there is nothing
+// to partition (the trunk clone is then already complete).
+UPB_API size_t upb_ParallelDeepClone_TaskCount(const upb_ParallelDeepClone* p);
+
+// Runs one task.  Distinct tasks may run concurrently; each must run exactly
+// once.  Failures are recorded and surfaced by _Finish().
+UPB_API void upb_ParallelDeepClone_RunTask(upb_ParallelDeepClone* p,
+                                           size_t task);
+
+// Completes the clone.  Must be called exactly once, after every task has
+// finished (the caller provides that synchronization, e.g. by joining the
+// pool).  Returns NULL if any task hit an allocation failure; the target
+// arena may then hold partially-cloned garbage, as with any failed clone.
+UPB_API upb_Message* upb_ParallelDeepClone_Finish(upb_ParallelDeepClone* p);
+
 // Deep clones array contents.
 upb_Array* upb_Array_DeepClone(const upb_Array* array, upb_CType value_type,
                                const upb_MiniTable* sub, upb_Arena* arena);
@@ -57,6 +113,73 @@ upb_Map* upb_Map_DeepClone(const upb_Map* map, upb_CType key_type,
 void upb_Message_DeepCopy(upb_Message* dst, const upb_Message* src,
                           const upb_MiniTable* mini_table, upb_Arena* arena);
 
+// Merges `src` into `dst` with protobuf merge semantics (scalars from `src`
+// win, repeated fields and unknowns append, present sub-messages merge
+// recursively), splicing payloads by reference instead of copying them:
+// strings, array storage, map tables, and sub-messages not already present
+// in `dst` end up shared with `src`.  The two arenas are fused with
+// upb_Arena_Fuse() first so the spliced payloads live as long as either
+// arena does.
+//
+// On success `dst` takes over the spliced parts of `src`, so `src` must not
+// be mutated afterwards (reading it remains safe, but will observe later
+// mutations of `dst`).  An unlinked ("empty") sub-message on either side
+// replaces the destination value instead of merging with it.  Returns false
+// if the arenas cannot be fused (e.g. one was created with an initial block)
+// or on allocation failure; `dst` may then be partially merged, but `src` is
+// never modified.
+bool upb_Message_MergeFused(upb_Message* dst, const upb_Message* src,
+                            const upb_MiniTable* mini_table,
+                            upb_Arena* dst_arena, upb_Arena* src_arena);
+
+// Clones a message with copy-on-write sharing: scalar fields are copied, but
+// string payloads, the element storage of scalar/string arrays, and the
+// tables of scalar/string-valued maps are shared with the source instead of
+// copied.  Cost is proportional to the number of message tree nodes, not the
+// payload bytes, which suits clone-then-patch flows that touch only a few
+// fields.
+//
+// Contract:
+//  * `arena` must be the source's arena, or fused with it, so that the
+//    shared payloads live as long as the clone.
+//  * Shared containers are copied out automatically when mutated through the
+//    normal entry points: growing/shrinking an array (upb_Array_Resize(),
+//    upb_Array_Append(), ...) or inserting into/deleting from a map.
+//  * In-place element writes (upb_Array_Set(), upb_Array_Delete(), writes
+//    through upb_Array_MutableDataPtr()) do NOT copy on write; materialize
+//    the array first with upb_Array_Resize(arr, upb_Array_Size(arr), arena).
+//    Debug builds assert on this misuse.  Mutating a clone's map through
+//    upb_Map_SetEntryValue() is similarly unsupported.
+//
+// Neither the source nor the clone becomes immutable: each side copies a
+// shared container before changing it, so mutations never leak across.
+upb_Message* upb_Message_CloneShared(const upb_Message* message,
+                                     const upb_MiniTable* mini_table,
+                                     upb_Arena* arena);
+
+// Clones array contents with the sharing rules of upb_Message_CloneShared().
+upb_Array* upb_Array_CloneShared(const upb_Array* array, upb_CType value_type,
+                                 const upb_MiniTable* sub, upb_Arena* arena);
+
+// Clones map contents with the sharing rules of upb_Message_CloneShared().
+upb_Map* upb_Map_CloneShared(const upb_Map* map, upb_CType key_type,
+                             upb_CType value_type,
+                             const upb_MiniTable* map_entry_table,
+                             upb_Arena* arena);
+
+// Discards the unknown fields of `msg` and every reachable sub-message
+// (including map values and message-typed extensions), so a terminal
+// consumer can drop data it will never re-serialize.  The unknown buffers
+// are detached, not freed: the bytes live until the arena dies, so this
+// mainly pays off before a deep clone/copy to a fresh arena, or to keep the
+// fields from being re-encoded.  To avoid retaining them in the first place
+// use kUpb_DecodeOption_DiscardUnknown at parse time.  Unlinked ("empty")
+// sub-messages are left untouched; their deferred payload is stored through
+// the same buffer but is message content.  Returns false if `maxdepth` was
+// exceeded (the graph is then partially stripped).
+bool upb_Message_DeepDiscardUnknown(upb_Message* msg, const upb_MiniTable* m,
+                                    int maxdepth);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -58,14 +58,25 @@ typedef struct {
 extern "C" {
 #endif
 
+// Orders extensions by field number, breaking ties by the address of the
+// MiniTableExtension so that the order is total.  The in-message extension
+// array is kept sorted by this key so that lookup can binary search it.
+UPB_INLINE bool _upb_Message_ExtKeyLess(const upb_MiniTableExtension* a,
+                                        const upb_MiniTableExtension* b) {
+  if (a->field.number != b->field.number) {
+    return a->field.number < b->field.number;
+  }
+  return (uintptr_t)a < (uintptr_t)b;
+}
+
 // Adds the given extension data to the given message.
 // |ext| is copied into the message instance.
 // This logically replaces any previously-added extension with this number.
 upb_Message_Extension* _upb_Message_GetOrCreateExtension(
     upb_Message* msg, const upb_MiniTableExtension* ext, upb_Arena* arena);
 
-// Returns an array of extensions for this message.
-// Note: the array is ordered in reverse relative to the order of creation.
+// Returns an array of extensions for this message, sorted by ascending field
+// number.
 const upb_Message_Extension* _upb_Message_Getexts(const upb_Message* msg,
                                                   size_t* count);
 
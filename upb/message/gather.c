@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/message/gather.h"
+
+#include <string.h>
+
+#include "upb/collections/array_internal.h"
+#include "upb/message/accessors_internal.h"
+#include "upb/message/tagged_ptr.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+static size_t upb_Gather_ElemSize(const upb_MiniTableField* field) {
+  switch (_upb_MiniTableField_GetRep(field)) {
+    case kUpb_FieldRep_1Byte:
+      return 1;
+    case kUpb_FieldRep_4Byte:
+      return 4;
+    case kUpb_FieldRep_StringView:
+      return sizeof(upb_StringView);
+    case kUpb_FieldRep_8Byte:
+      return 8;
+  }
+  UPB_UNREACHABLE();
+}
+
+bool upb_Array_GatherColumns(const upb_Array* array, size_t start,
+                             size_t count, const upb_GatherColumn* columns,
+                             size_t column_count) {
+  if (start + count < start || start + count > array->size) return false;
+
+#ifndef NDEBUG
+  for (size_t c = 0; c < column_count; c++) {
+    const upb_MiniTableField* f = columns[c].field;
+    UPB_ASSERT(!upb_IsRepeatedOrMap(f));
+    UPB_ASSERT(!upb_MiniTableField_IsExtension(f));
+    UPB_ASSERT(upb_MiniTableField_CType(f) != kUpb_CType_Message);
+    UPB_ASSERT(columns[c].values);
+  }
+#endif
+
+  // One pass over the elements, scattering to the columns: the element
+  // stride is sequential, so the per-cell work is a predicted branch and a
+  // small fixed-size copy and throughput is bounded by memory bandwidth.
+  const upb_TaggedMessagePtr* elems =
+      (const upb_TaggedMessagePtr*)_upb_array_constptr(array) + start;
+  for (size_t i = 0; i < count; i++) {
+    const upb_TaggedMessagePtr tagged = elems[i];
+    // Unparsed ("empty") elements carry their fields as deferred payload
+    // bytes, not as slots we can read; they gather as all-absent.
+    const upb_Message* msg =
+        tagged != 0 && !upb_TaggedMessagePtr_IsEmpty(tagged)
+            ? upb_TaggedMessagePtr_GetNonEmptyMessage(tagged)
+            : NULL;
+    for (size_t c = 0; c < column_count; c++) {
+      const upb_GatherColumn* col = &columns[c];
+      const upb_MiniTableField* f = col->field;
+      const size_t size = upb_Gather_ElemSize(f);
+      char* out = (char*)col->values + i * size;
+
+      bool has = msg != NULL;
+      if (has) {
+        if (f->presence > 0) {
+          has = _upb_hasbit_field(msg, f);
+        } else if (_upb_MiniTableField_InOneOf(f)) {
+          has = _upb_getoneofcase_field(msg, f) == f->number;
+        }
+      }
+      if (!has) {
+        memset(out, 0, size);
+        if (col->present) col->present[i] = 0;
+        continue;
+      }
+
+      const void* slot = _upb_MiniTableField_GetConstPtr(msg, f);
+      if (UPB_UNLIKELY(_upb_MiniTableField_IsInlineString(f)) &&
+          _upb_InlineString_IsInline(slot)) {
+        const upb_StringView view = _upb_InlineString_Decode(slot);
+        memcpy(out, &view, sizeof(view));
+      } else {
+        _upb_MiniTable_CopyFieldData(out, slot, f);
+      }
+      if (col->present) col->present[i] = 1;
+    }
+  }
+  return true;
+}
+
+#include "upb/port/undef.inc"
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Columnar gather over repeated sub-message fields: one pass over a
+// upb_Array of messages scatters the requested scalar fields into dense,
+// per-field output buffers.  Proto-to-columnar conversion then costs one
+// message-pointer chase per element instead of one accessor call per cell.
+
+#ifndef UPB_MESSAGE_GATHER_H_
+#define UPB_MESSAGE_GATHER_H_
+
+#include "upb/collections/array.h"
+#include "upb/mini_table/field.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One output column.
+typedef struct {
+  // A scalar (non-repeated, non-map, non-extension, non-message) field of
+  // the array's element type.
+  const upb_MiniTableField* field;
+
+  // Dense output, one element per gathered message, in array order.  The
+  // element size is the field's in-message representation: 1 byte for bool,
+  // 4 for int32/uint32/float/enum, 8 for int64/uint64/double, and
+  // sizeof(upb_StringView) for string/bytes.  String views alias message
+  // data and stay valid as long as the messages' arena.
+  void* values;
+
+  // Optional presence output, one byte per element: 1 if the field was
+  // present, else 0 (the value slot is then zeroed).  Fields without
+  // presence (proto3 implicit) always report 1.  May be NULL.
+  uint8_t* present;
+} upb_GatherColumn;
+
+// Gathers elements [start, start + count) of `array`, an array of
+// sub-messages, writing element i's fields to index i of every column.
+// Unparsed ("empty") and NULL elements gather as all-absent.  Returns false
+// if the range is out of bounds.
+UPB_API bool upb_Array_GatherColumns(const upb_Array* array, size_t start,
+                                     size_t count,
+                                     const upb_GatherColumn* columns,
+                                     size_t column_count);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_MESSAGE_GATHER_H_ */
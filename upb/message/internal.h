@@ -81,10 +81,35 @@ typedef struct {
    *   extensions data: data[(ext_begin - overhead) .. (size - overhead)] */
   uint32_t unknown_end;
   uint32_t ext_begin;
+
+  /* kUpb_InternalData_* flags. */
+  uint32_t flags;
+
+  /* Original wire bytes of this message if it was parsed with
+   * kUpb_DecodeOption_RetainWireBytes and has not been mutated since; NULL
+   * otherwise.  The bytes alias the parse input buffer, so they carry the
+   * same buffer-lifetime contract as kUpb_DecodeOption_AliasString.  Every
+   * mutating accessor resets wire_data so the encoder never reuses stale
+   * bytes. */
+  uint32_t wire_size;
+
+  /* The encode-option bits (kUpb_EncodeOption_*) that wire_data corresponds
+   * to: 0 for parse-retained spans, and whatever upb_Message_Freeze()
+   * encoded with for its cached encoding.  The encoder only reuses the bytes
+   * when the caller's byte-affecting options match. */
+  uint32_t wire_options;
+  const char* wire_data;
+
   /* Data follows, as if there were an array:
    *   char data[size - sizeof(upb_Message_InternalData)]; */
 } upb_Message_InternalData;
 
+enum {
+  /* Set by upb_Message_Freeze(); the message must no longer be mutated.
+   * Mutating accessors UPB_ASSERT() this in debug builds. */
+  kUpb_InternalData_Frozen = 1,
+};
+
 typedef struct {
   upb_Message_InternalData* internal;
   /* Message data follows. */
@@ -101,10 +126,12 @@ UPB_INLINE size_t upb_msg_sizeof(const upb_MiniTable* t) {
 UPB_INLINE upb_Message* _upb_Message_New(const upb_MiniTable* mini_table,
                                          upb_Arena* arena) {
   size_t size = upb_msg_sizeof(mini_table);
-  void* mem = upb_Arena_Malloc(arena, size + sizeof(upb_Message_Internal));
+  // In a zeroed-blocks arena (upb_ArenaPolicy::zeroed_blocks) this skips the
+  // memset entirely, which for large messages is most of the creation cost.
+  void* mem =
+      upb_Arena_MallocZeroed(arena, size + sizeof(upb_Message_Internal));
   if (UPB_UNLIKELY(!mem)) return NULL;
   upb_Message* msg = UPB_PTR_AT(mem, sizeof(upb_Message_Internal), upb_Message);
-  memset(mem, 0, size);
   return msg;
 }
 
@@ -114,6 +141,47 @@ UPB_INLINE upb_Message_Internal* upb_Message_Getinternal(
   return (upb_Message_Internal*)((char*)msg - size);
 }
 
+// Returns true if the message was frozen with upb_Message_Freeze().
+UPB_INLINE bool _upb_Message_IsFrozen(const upb_Message* msg) {
+  const upb_Message_Internal* in = upb_Message_Getinternal(msg);
+  return in->internal && (in->internal->flags & kUpb_InternalData_Frozen) != 0;
+}
+
+// Marks this message (only) frozen, allocating internal data to hold the
+// flag if necessary.  Returns false on allocation failure.
+bool _upb_Message_SetFrozen(upb_Message* msg, upb_Arena* arena);
+
+// Drops the retained wire bytes for this message (if any); called by every
+// mutating accessor so a stale span is never re-serialized.
+UPB_INLINE void _upb_Message_InvalidateWireSpan(upb_Message* msg) {
+  upb_Message_Internal* in = upb_Message_Getinternal(msg);
+  // Mutating accessors funnel through here, which makes it the natural
+  // choke point for catching writes to frozen messages.
+  UPB_ASSERT(!_upb_Message_IsFrozen(msg));
+  if (in->internal) in->internal->wire_data = NULL;
+}
+
+// Returns the retained wire bytes for this message, or NULL if none.
+UPB_INLINE const char* _upb_Message_GetWireSpan(const upb_Message* msg,
+                                                size_t* size) {
+  const upb_Message_Internal* in = upb_Message_Getinternal(msg);
+  if (!in->internal || !in->internal->wire_data) return NULL;
+  *size = in->internal->wire_size;
+  return in->internal->wire_data;
+}
+
+// Returns the encode-option bits the retained wire bytes were produced
+// with.  Only meaningful after _upb_Message_GetWireSpan() returned non-NULL.
+UPB_INLINE uint32_t _upb_Message_GetWireSpanOptions(const upb_Message* msg) {
+  return upb_Message_Getinternal(msg)->internal->wire_options;
+}
+
+// Records the original wire bytes of |msg|, produced under |options| (0 for
+// bytes retained from a parse).  Returns false on allocation failure.  Spans
+// that do not fit in 32 bits are silently not recorded.
+bool _upb_Message_SetWireSpan(upb_Message* msg, const char* data, size_t size,
+                              uint32_t options, upb_Arena* arena);
+
 // Discards the unknown fields for this message only.
 void _upb_Message_DiscardUnknown_shallow(upb_Message* msg);
 
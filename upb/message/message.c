@@ -46,6 +46,42 @@ upb_Message* upb_Message_New(const upb_MiniTable* mini_table,
   return _upb_Message_New(mini_table, arena);
 }
 
+/* Per-field allowances used to size the first arena block for a message.
+ * Keep in sync with the generated Foo_kArenaHint constants (see
+ * GenerateArenaHint() in protoc-gen-upb.cc). */
+enum {
+  kUpb_ArenaHint_PerString = 32,    // Typical copied string/bytes payload.
+  kUpb_ArenaHint_PerRepeated = 64,  // upb_Array/upb_Map plus first elements.
+};
+
+upb_Arena* upb_Arena_NewForMessage(const upb_MiniTable* mini_table) {
+  size_t hint = upb_msg_sizeof(mini_table);
+  for (uint32_t i = 0; i < mini_table->field_count; i++) {
+    const upb_MiniTableField* f = upb_MiniTable_GetFieldByIndex(mini_table, i);
+    if (upb_IsRepeatedOrMap(f)) {
+      hint += kUpb_ArenaHint_PerRepeated;
+      continue;
+    }
+    switch (upb_MiniTableField_CType(f)) {
+      case kUpb_CType_String:
+      case kUpb_CType_Bytes:
+        hint += kUpb_ArenaHint_PerString;
+        break;
+      case kUpb_CType_Message: {
+        const upb_MiniTable* sub =
+            upb_MiniTable_GetSubMessageTable(mini_table, f);
+        hint += sub ? upb_msg_sizeof(sub) : kUpb_ArenaHint_PerRepeated;
+        break;
+      }
+      default:
+        break;  // Scalars live in the message struct itself.
+    }
+  }
+  upb_ArenaPolicy policy = {0};
+  policy.initial_block_size = hint;
+  return upb_Arena_NewWithPolicy(&policy, NULL);
+}
+
 static bool realloc_internal(upb_Message* msg, size_t need, upb_Arena* arena) {
   upb_Message_Internal* in = upb_Message_Getinternal(msg);
   if (!in->internal) {
@@ -56,6 +92,9 @@ static bool realloc_internal(upb_Message* msg, size_t need, upb_Arena* arena) {
     internal->size = size;
     internal->unknown_end = overhead;
     internal->ext_begin = size;
+    internal->flags = 0;
+    internal->wire_size = 0;
+    internal->wire_data = NULL;
     in->internal = internal;
   } else if (in->internal->ext_begin - in->internal->unknown_end < need) {
     /* Internal data is too small, reallocate. */
@@ -80,10 +119,29 @@ static bool realloc_internal(upb_Message* msg, size_t need, upb_Arena* arena) {
 
 bool _upb_Message_AddUnknown(upb_Message* msg, const char* data, size_t len,
                              upb_Arena* arena) {
+  UPB_ASSERT(!_upb_Message_IsFrozen(msg));
   if (!realloc_internal(msg, len, arena)) return false;
   upb_Message_Internal* in = upb_Message_Getinternal(msg);
   memcpy(UPB_PTR_AT(in->internal, in->internal->unknown_end, char), data, len);
   in->internal->unknown_end += len;
+  in->internal->wire_data = NULL;
+  return true;
+}
+
+bool _upb_Message_SetFrozen(upb_Message* msg, upb_Arena* arena) {
+  if (!realloc_internal(msg, 0, arena)) return false;
+  upb_Message_Getinternal(msg)->internal->flags |= kUpb_InternalData_Frozen;
+  return true;
+}
+
+bool _upb_Message_SetWireSpan(upb_Message* msg, const char* data, size_t size,
+                              uint32_t options, upb_Arena* arena) {
+  if (size > UINT32_MAX) return true;  // Too large to record; not an error.
+  if (!realloc_internal(msg, 0, arena)) return false;
+  upb_Message_Internal* in = upb_Message_Getinternal(msg);
+  in->internal->wire_data = data;
+  in->internal->wire_size = size;
+  in->internal->wire_options = options;
   return true;
 }
 
@@ -91,6 +149,7 @@ void _upb_Message_DiscardUnknown_shallow(upb_Message* msg) {
   upb_Message_Internal* in = upb_Message_Getinternal(msg);
   if (in->internal) {
     in->internal->unknown_end = overhead;
+    in->internal->wire_data = NULL;
   }
 }
 
@@ -121,6 +180,7 @@ void upb_Message_DeleteUnknown(upb_Message* msg, const char* data, size_t len) {
     memmove((char*)data, data + len, internal_unknown_end - data - len);
   }
   in->internal->unknown_end -= len;
+  in->internal->wire_data = NULL;
 }
 
 const upb_Message_Extension* _upb_Message_Getexts(const upb_Message* msg,
@@ -141,16 +201,20 @@ const upb_Message_Extension* _upb_Message_Getext(
   size_t n;
   const upb_Message_Extension* ext = _upb_Message_Getexts(msg, &n);
 
-  /* For now we use linear search exclusively to find extensions. If this
-   * becomes an issue due to messages with lots of extensions, we can introduce
-   * a table of some sort. */
-  for (size_t i = 0; i < n; i++) {
-    if (ext[i].ext == e) {
-      return &ext[i];
+  /* The array is kept sorted (see _upb_Message_ExtKeyLess()), so extension
+   * lookup on messages carrying hundreds of extensions is O(lg n) instead of
+   * a linear scan. */
+  size_t lo = 0;
+  size_t hi = n;
+  while (lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    if (_upb_Message_ExtKeyLess(ext[mid].ext, e)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
     }
   }
-
-  return NULL;
+  return lo < n && ext[lo].ext == e ? &ext[lo] : NULL;
 }
 
 upb_Message_Extension* _upb_Message_GetOrCreateExtension(
@@ -158,10 +222,24 @@ upb_Message_Extension* _upb_Message_GetOrCreateExtension(
   upb_Message_Extension* ext =
       (upb_Message_Extension*)_upb_Message_Getext(msg, e);
   if (ext) return ext;
+  UPB_ASSERT(!_upb_Message_IsFrozen(msg));
   if (!realloc_internal(msg, sizeof(upb_Message_Extension), arena)) return NULL;
   upb_Message_Internal* in = upb_Message_Getinternal(msg);
   in->internal->ext_begin -= sizeof(upb_Message_Extension);
-  ext = UPB_PTR_AT(in->internal, in->internal->ext_begin, void);
+  in->internal->wire_data = NULL;
+  upb_Message_Extension* base =
+      UPB_PTR_AT(in->internal, in->internal->ext_begin, void);
+  /* Slide the smaller-keyed entries into the new front slot so the array
+   * stays sorted; the new extension lands at its ordered position. */
+  upb_Message_Extension* old = base + 1;
+  const size_t old_count =
+      (in->internal->size - in->internal->ext_begin) /
+          sizeof(upb_Message_Extension) -
+      1;
+  size_t pos = 0;
+  while (pos < old_count && _upb_Message_ExtKeyLess(old[pos].ext, e)) pos++;
+  if (pos) memmove(base, old, pos * sizeof(upb_Message_Extension));
+  ext = base + pos;
   memset(ext, 0, sizeof(upb_Message_Extension));
   ext->ext = e;
   return ext;
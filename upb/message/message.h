@@ -46,6 +46,14 @@ extern "C" {
 UPB_API upb_Message* upb_Message_New(const upb_MiniTable* mini_table,
                                      upb_Arena* arena);
 
+// Creates an arena whose first block is sized to hold one |mini_table|
+// message plus a heuristic allowance for its string, repeated, and
+// sub-message fields, so that decoding a typical message stays within the
+// first block instead of chaining additional ones.  Generated code exposes
+// the same heuristic as a compile-time Foo_kArenaHint constant, which can
+// be passed to upb_Arena_NewWithPolicy() directly.
+UPB_API upb_Arena* upb_Arena_NewForMessage(const upb_MiniTable* mini_table);
+
 // Adds unknown data (serialized protobuf data) to the given message.
 // The data is copied into the message instance.
 void upb_Message_AddUnknown(upb_Message* msg, const char* data, size_t len,
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2009-2022, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/message/pool.h"
+
+#include "upb/hash/int_table.h"
+#include "upb/mem/alloc.h"
+#include "upb/message/accessors.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+// A singly-linked stack of messages returned with Put().  The nodes are
+// arena-allocated and themselves recycled (through |free_nodes|), so the
+// steady state of Get()/Put() cycles allocates nothing.
+typedef struct upb_MessagePool_Node {
+  upb_Message* msg;
+  struct upb_MessagePool_Node* next;
+} upb_MessagePool_Node;
+
+// Per-MiniTable free list.  Allocated once per type and stored as the
+// inttable value so that Put() never has to write back into the table.
+typedef struct {
+  upb_MessagePool_Node* head;
+} upb_MessagePool_List;
+
+struct upb_MessagePool {
+  upb_Arena* arena;       // Backs all messages, nodes, lists, and the table.
+  upb_inttable lists;     // (uintptr_t)MiniTable -> upb_MessagePool_List*.
+  upb_MessagePool_Node* free_nodes;  // Spare nodes from recycled messages.
+};
+
+upb_MessagePool* upb_MessagePool_New(void) {
+  upb_MessagePool* pool = upb_gmalloc(sizeof(*pool));
+  if (!pool) return NULL;
+
+  pool->arena = upb_Arena_New();
+  if (!pool->arena) goto err;
+  pool->free_nodes = NULL;
+  if (!upb_inttable_init(&pool->lists, pool->arena)) goto err;
+
+  return pool;
+
+err:
+  if (pool->arena) upb_Arena_Free(pool->arena);
+  upb_gfree(pool);
+  return NULL;
+}
+
+void upb_MessagePool_Free(upb_MessagePool* pool) {
+  if (!pool) return;
+  upb_Arena_Free(pool->arena);
+  upb_gfree(pool);
+}
+
+upb_Arena* upb_MessagePool_Arena(const upb_MessagePool* pool) {
+  return pool->arena;
+}
+
+static upb_MessagePool_List* upb_MessagePool_GetList(upb_MessagePool* pool,
+                                                     const upb_MiniTable* l) {
+  upb_value v;
+  if (upb_inttable_lookup(&pool->lists, (uintptr_t)l, &v)) {
+    return upb_value_getptr(v);
+  }
+  upb_MessagePool_List* list = upb_Arena_Malloc(pool->arena, sizeof(*list));
+  if (!list) return NULL;
+  list->head = NULL;
+  if (!upb_inttable_insert(&pool->lists, (uintptr_t)l, upb_value_ptr(list),
+                           pool->arena)) {
+    return NULL;
+  }
+  return list;
+}
+
+upb_Message* upb_MessagePool_Get(upb_MessagePool* pool, const upb_MiniTable* l) {
+  upb_MessagePool_List* list = upb_MessagePool_GetList(pool, l);
+  if (!list) return NULL;
+
+  if (list->head) {
+    upb_MessagePool_Node* node = list->head;
+    list->head = node->next;
+    upb_Message* msg = node->msg;
+    node->msg = NULL;
+    node->next = pool->free_nodes;
+    pool->free_nodes = node;
+    upb_Message_ClearAndRecycle(msg, l);
+    return msg;
+  }
+
+  return upb_Message_New(l, pool->arena);
+}
+
+void upb_MessagePool_Put(upb_MessagePool* pool, upb_Message* msg,
+                         const upb_MiniTable* l) {
+  upb_MessagePool_List* list = upb_MessagePool_GetList(pool, l);
+  if (!list) return;  // OOM: the message is simply not recycled.
+
+  upb_MessagePool_Node* node = pool->free_nodes;
+  if (node) {
+    pool->free_nodes = node->next;
+  } else {
+    node = upb_Arena_Malloc(pool->arena, sizeof(*node));
+    if (!node) return;
+  }
+  node->msg = msg;
+  node->next = list->head;
+  list->head = node;
+}
+
+bool upb_MessagePool_Reset(upb_MessagePool* pool) {
+  if (!upb_Arena_Reset(pool->arena)) return false;
+  pool->free_nodes = NULL;
+  return upb_inttable_init(&pool->lists, pool->arena);
+}
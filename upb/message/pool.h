@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2009-2022, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// upb_MessagePool: recycling of message objects keyed by MiniTable.
+//
+// A request loop that allocates the same few message types per request can
+// reach an allocation-free steady state by getting messages from a pool
+// instead of a fresh arena.  Returned messages are recycled with
+// upb_Message_ClearAndRecycle(), so their arrays, maps, and unknown-field
+// buffers keep their grown capacity, and all of their storage lives in one
+// pool-owned arena that upb_MessagePool_Reset() rewinds to warm pages.
+//
+// A pool is not thread-safe; the intended pattern is one pool per worker
+// thread (or per single-threaded event loop).
+
+#ifndef UPB_MESSAGE_POOL_H_
+#define UPB_MESSAGE_POOL_H_
+
+#include "upb/mem/arena.h"
+#include "upb/message/message.h"
+#include "upb/mini_table/message.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct upb_MessagePool upb_MessagePool;
+
+UPB_API upb_MessagePool* upb_MessagePool_New(void);
+UPB_API void upb_MessagePool_Free(upb_MessagePool* pool);
+
+// The arena backing every message handed out by the pool.  Pass this to
+// upb_Decode() etc. when filling a pooled message.  Do not free, fuse, or
+// reset it directly; its contents are invalidated by upb_MessagePool_Reset()
+// and upb_MessagePool_Free().
+UPB_API upb_Arena* upb_MessagePool_Arena(const upb_MessagePool* pool);
+
+// Returns a cleared message of type |l|: a recycled one if a message of this
+// type was returned with upb_MessagePool_Put() (retaining its container
+// capacity), otherwise a fresh one from the pool arena.  Returns NULL on
+// allocation failure.
+UPB_API upb_Message* upb_MessagePool_Get(upb_MessagePool* pool,
+                                         const upb_MiniTable* l);
+
+// Returns |msg| (previously obtained from upb_MessagePool_Get() with the
+// same |l|) to the pool for reuse.  The caller must not touch |msg|, nor
+// anything reachable from it, after this call.
+UPB_API void upb_MessagePool_Put(upb_MessagePool* pool, upb_Message* msg,
+                                 const upb_MiniTable* l);
+
+// Discards every message the pool has ever handed out -- including ones not
+// yet Put() back -- and rewinds the pool arena, keeping its blocks.  Call
+// this at a quiescent point (e.g. after an oversized request) to reclaim
+// growth; per-message recycling alone never shrinks.  Returns false and
+// changes nothing if the arena cannot be reset (see upb_Arena_Reset()).
+UPB_API bool upb_MessagePool_Reset(upb_MessagePool* pool);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_MESSAGE_POOL_H_ */
@@ -229,6 +229,29 @@ upb_DecodeStatus upb_Map_PromoteMessages(upb_Map* map,
   return kUpb_DecodeStatus_Ok;
 }
 
+upb_DecodeStatus upb_Message_PromoteAll(upb_Message* msg,
+                                        const upb_MiniTable* mini_table,
+                                        const upb_ExtensionRegistry* extreg,
+                                        int decode_options, upb_Arena* arena) {
+  size_t size;
+  const char* data = upb_Message_GetUnknown(msg, &size);
+  if (size == 0) return kUpb_DecodeStatus_Ok;
+
+  // The unknown buffer is itself valid wire format, so one pass of the
+  // decoder against the upgraded mini-table promotes every recognized field
+  // with standard merge semantics.  Detach the blob first: the decoder
+  // re-appends fields it still cannot identify, which would otherwise write
+  // into the region being read.
+  char* copy = upb_Arena_Malloc(arena, size);
+  if (!copy) return kUpb_DecodeStatus_OutOfMemory;
+  memcpy(copy, data, size);
+  upb_Message_DeleteUnknown(msg, data, size);
+
+  // `copy` is arena-owned, so aliased strings keep a valid lifetime even
+  // with kUpb_DecodeOption_AliasString.
+  return upb_Decode(copy, size, msg, mini_table, extreg, decode_options, arena);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // OLD promotion functions, will be removed!
 ////////////////////////////////////////////////////////////////////////////////
@@ -136,6 +136,25 @@ upb_DecodeStatus upb_Map_PromoteMessages(upb_Map* map,
                                          const upb_MiniTable* mini_table,
                                          int decode_options, upb_Arena* arena);
 
+// Promotes every unknown field that `mini_table` (and `extreg`, if given)
+// now recognizes in one pass over the unknown buffer, merging the promoted
+// values into `msg` with standard merge semantics.  This is the bulk
+// equivalent of calling the per-field promotion functions for every field of
+// an upgraded schema: one scan instead of one scan per field.  Fields that
+// remain unrecognized stay in the unknown buffer.  As with the per-field
+// promotion functions, `mini_table` must describe the layout `msg` was
+// allocated with, and `arena` must be the message's arena or one that
+// outlives it.
+//
+// On parse error, fields promoted before the error are kept and the
+// remaining unknown data is dropped.  Unknown buffers written by the decoder
+// are well-formed by construction, so this can only happen for unknown data
+// that was added by hand with _upb_Message_AddUnknown().
+upb_DecodeStatus upb_Message_PromoteAll(upb_Message* msg,
+                                        const upb_MiniTable* mini_table,
+                                        const upb_ExtensionRegistry* extreg,
+                                        int decode_options, upb_Arena* arena);
+
 ////////////////////////////////////////////////////////////////////////////////
 // OLD promotion interfaces, will be removed!
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/message/relocate.h"
+
+#include "upb/collections/array_internal.h"
+#include "upb/collections/map_internal.h"
+#include "upb/message/accessors_internal.h"
+#include "upb/message/internal.h"
+#include "upb/mini_table/internal/message.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+typedef struct {
+  uintptr_t old_base;
+  uintptr_t old_end;
+  ptrdiff_t delta;
+} upb_RelocateCtx;
+
+// Rebases the pointer stored at |slot|, which must point into the original
+// block.  NULL pointers are handled by the callers, which know which slots
+// may legally be empty.
+static bool upb_Relocate_Ptr(const upb_RelocateCtx* ctx, void* slot) {
+  uintptr_t p;
+  memcpy(&p, slot, sizeof(p));
+  if (p < ctx->old_base || p >= ctx->old_end) return false;
+  p += ctx->delta;
+  memcpy(slot, &p, sizeof(p));
+  return true;
+}
+
+static bool upb_Relocate_Message(const upb_RelocateCtx* ctx, upb_Message* msg,
+                                 const upb_MiniTable* m);
+
+// Rebases a tagged sub-message pointer in place, then recurses into the
+// message at its new address.
+static bool upb_Relocate_TaggedPtr(const upb_RelocateCtx* ctx,
+                                   upb_TaggedMessagePtr* slot,
+                                   const upb_MiniTable* sub) {
+  const uintptr_t tag = *slot & 1;
+  uintptr_t p = *slot & ~(uintptr_t)1;
+  if (p < ctx->old_base || p >= ctx->old_end) return false;
+  p += ctx->delta;
+  *slot = p | tag;
+  // Unlinked sub-messages have no fields of their own; recursing with the
+  // empty table still fixes up their internal (unknown-field) data.
+  return upb_Relocate_Message(ctx, (upb_Message*)p,
+                              tag ? &_kUpb_MiniTable_Empty : sub);
+}
+
+static bool upb_Relocate_Array(const upb_RelocateCtx* ctx, upb_Array** slot,
+                               upb_CType elem_type, const upb_MiniTable* sub) {
+  if (!upb_Relocate_Ptr(ctx, slot)) return false;
+  upb_Array* arr = *slot;
+
+  const uintptr_t lg2_tag = arr->data & 7;
+  uintptr_t p = arr->data & ~(uintptr_t)7;
+  if (p == 0) return true;  // Empty array that never allocated storage.
+  if (p < ctx->old_base || p >= ctx->old_end) return false;
+  p += ctx->delta;
+  arr->data = p | lg2_tag;
+
+  switch (elem_type) {
+    case kUpb_CType_Message: {
+      upb_TaggedMessagePtr* elems = (upb_TaggedMessagePtr*)p;
+      for (size_t i = 0; i < arr->size; i++) {
+        if (!upb_Relocate_TaggedPtr(ctx, &elems[i], sub)) return false;
+      }
+      return true;
+    }
+    case kUpb_CType_String:
+    case kUpb_CType_Bytes: {
+      upb_StringView* elems = (upb_StringView*)p;
+      for (size_t i = 0; i < arr->size; i++) {
+        if (elems[i].data && !upb_Relocate_Ptr(ctx, &elems[i].data)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    default:
+      return true;  // Scalar storage holds no pointers.
+  }
+}
+
+static bool upb_Relocate_Map(const upb_RelocateCtx* ctx, upb_Map** slot,
+                             const upb_MiniTable* entry) {
+  if (!upb_Relocate_Ptr(ctx, slot)) return false;
+  upb_Map* map = *slot;
+
+  // The owning arena sits at the start of the block; keep the pointer
+  // consistent even though an attached arena cannot allocate.
+  if (map->arena && !upb_Relocate_Ptr(ctx, &map->arena)) return false;
+
+  if (map->is_flat) {
+    if (!map->flat_ctrl) return true;
+    if (!upb_Relocate_Ptr(ctx, &map->flat_ctrl)) return false;
+    if (!upb_Relocate_Ptr(ctx, &map->flat_slots)) return false;
+    // Keys and scalar values are stored inline; only message values hold a
+    // pointer (a tagged pointer in the slot's value bytes).
+    const upb_MiniTableField* flat_val_f = &entry->fields[1];
+    if (upb_MiniTableField_CType(flat_val_f) != kUpb_CType_Message) {
+      return true;
+    }
+    const upb_MiniTable* flat_val_sub =
+        upb_MiniTable_GetSubMessageTable(entry, flat_val_f);
+    size_t iter = kUpb_Map_Begin;
+    char* flat_slot;
+    while ((flat_slot = _upb_FlatMap_Next(map, &iter)) != NULL) {
+      // The value bytes may be misaligned within the packed slot.
+      upb_TaggedMessagePtr tagged;
+      memcpy(&tagged, flat_slot + map->key_size, sizeof(tagged));
+      if (!upb_Relocate_TaggedPtr(ctx, &tagged, flat_val_sub)) return false;
+      memcpy(flat_slot + map->key_size, &tagged, sizeof(tagged));
+    }
+    return true;
+  }
+
+  upb_table* t = &map->table.t;
+  const size_t size = upb_table_size(t);
+  if (size == 0) return true;
+  if (!upb_Relocate_Ptr(ctx, &t->entries)) return false;
+  if (!upb_Relocate_Ptr(ctx, &t->metadata)) return false;
+
+  const upb_MiniTableField* val_f = &entry->fields[1];
+  const upb_CType val_type = upb_MiniTableField_CType(val_f);
+  const upb_MiniTable* val_sub =
+      val_f->UPB_PRIVATE(submsg_index) != kUpb_NoSub
+          ? upb_MiniTable_GetSubMessageTable(entry, val_f)
+          : NULL;
+
+  for (size_t i = 0; i < size; i++) {
+    if (t->metadata[i] & 0x80) continue;  // Empty or tombstone slot.
+    upb_tabent* e = &t->entries[i];
+    if (!upb_Relocate_Ptr(ctx, &e->key)) return false;  // Key byte storage.
+    switch (val_type) {
+      case kUpb_CType_Message:
+        if (!upb_Relocate_TaggedPtr(ctx, (upb_TaggedMessagePtr*)&e->val.val,
+                                    val_sub)) {
+          return false;
+        }
+        break;
+      case kUpb_CType_String:
+      case kUpb_CType_Bytes: {
+        // String values are boxed: val points at a upb_StringView.
+        if (!upb_Relocate_Ptr(ctx, &e->val.val)) return false;
+        upb_StringView* sv = (upb_StringView*)(uintptr_t)e->val.val;
+        if (sv->data && !upb_Relocate_Ptr(ctx, &sv->data)) return false;
+        break;
+      }
+      default:
+        break;  // Scalar values are stored inline.
+    }
+  }
+  return true;
+}
+
+static bool upb_Relocate_Message(const upb_RelocateCtx* ctx, upb_Message* msg,
+                                 const upb_MiniTable* m) {
+  upb_Message_Internal* in = upb_Message_Getinternal(msg);
+  if (in->internal) {
+    if (!upb_Relocate_Ptr(ctx, &in->internal)) return false;
+    upb_Message_InternalData* data = in->internal;
+    if (data->ext_begin != data->size) {
+      // Extensions store upb_MiniTableExtension pointers, which only mean
+      // something in the process that built the tree.
+      return false;
+    }
+    // Retained wire bytes alias the original parse buffer; drop them.
+    data->wire_data = NULL;
+    data->wire_size = 0;
+  }
+
+  for (size_t i = 0; i < m->field_count; i++) {
+    const upb_MiniTableField* f = &m->fields[i];
+    if (upb_IsRepeatedOrMap(f)) {
+      void** slot = UPB_PTR_AT(msg, f->offset, void*);
+      if (*slot == NULL) continue;
+      if (upb_FieldMode_Get(f) == kUpb_FieldMode_Map) {
+        if (!upb_Relocate_Map(ctx, (upb_Map**)slot,
+                              m->subs[f->UPB_PRIVATE(submsg_index)].submsg)) {
+          return false;
+        }
+      } else {
+        const upb_MiniTable* sub =
+            upb_MiniTableField_CType(f) == kUpb_CType_Message
+                ? upb_MiniTable_GetSubMessageTable(m, f)
+                : NULL;
+        if (!upb_Relocate_Array(ctx, (upb_Array**)slot,
+                                upb_MiniTableField_CType(f), sub)) {
+          return false;
+        }
+      }
+      continue;
+    }
+    if (f->presence > 0) {
+      if (!_upb_hasbit_field(msg, f)) continue;
+    } else if (_upb_MiniTableField_InOneOf(f)) {
+      if (_upb_getoneofcase_field(msg, f) != f->number) continue;
+    }
+    switch (upb_MiniTableField_CType(f)) {
+      case kUpb_CType_Message: {
+        upb_TaggedMessagePtr* slot =
+            UPB_PTR_AT(msg, f->offset, upb_TaggedMessagePtr);
+        if (*slot == 0) continue;
+        if (!upb_Relocate_TaggedPtr(ctx, slot,
+                                    upb_MiniTable_GetSubMessageTable(m, f))) {
+          return false;
+        }
+        break;
+      }
+      case kUpb_CType_String:
+      case kUpb_CType_Bytes: {
+        upb_StringView* sv = UPB_PTR_AT(msg, f->offset, upb_StringView);
+        // An inline-stored string lives in the slot itself; there is no
+        // pointer to fix up (and the tag byte must not be read as one).
+        if (_upb_MiniTableField_IsInlineString(f) &&
+            _upb_InlineString_IsInline(sv)) {
+          break;
+        }
+        if (sv->data && !upb_Relocate_Ptr(ctx, &sv->data)) return false;
+        break;
+      }
+      default:
+        break;  // Scalars hold no pointers.
+    }
+  }
+  return true;
+}
+
+bool upb_Message_Relocate(upb_Message* msg, const upb_MiniTable* mini_table,
+                          const void* old_base, void* new_base, size_t size) {
+  upb_RelocateCtx ctx = {
+      .old_base = (uintptr_t)old_base,
+      .old_end = (uintptr_t)old_base + size,
+      .delta = (char*)new_base - (const char*)old_base,
+  };
+  return upb_Relocate_Message(&ctx, msg, mini_table);
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UPB_MESSAGE_RELOCATE_H_
+#define UPB_MESSAGE_RELOCATE_H_
+
+#include "upb/message/message.h"
+#include "upb/mini_table/message.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fixes up the internal pointers of a message tree after the single memory
+// block containing it has been moved to a new address, e.g. copied into
+// shared memory or mmapped back from disk.  Together with upb_Arena_Init()
+// this makes parsed messages relocatable:
+//
+//   1. Create an arena over one caller-provided block with
+//      upb_Arena_Init(mem, size, NULL).  A NULL alloc means the arena cannot
+//      spill to heap blocks, so everything it allocates stays inside `mem`
+//      (allocation fails instead of escaping the block).
+//   2. Parse or upb_Message_DeepClone() the message on that arena.  All of
+//      its arrays, maps, strings, and sub-messages now live inside `mem`.
+//      Do not use kUpb_DecodeOption_AliasString: aliased strings reference
+//      the input buffer, which is outside the block.
+//   3. Persist or share the block, remembering the root message's offset.
+//   4. After mapping the block at `new_base`, call this on the root message
+//      at its new address:
+//
+//        upb_Message* msg =
+//            (upb_Message*)((char*)new_base + root_offset);
+//        upb_Message_Relocate(msg, mini_table, old_base, new_base, size);
+//
+// Returns false (possibly leaving the tree partially fixed up) if the tree
+// references memory outside [old_base, old_base + size) — for example a
+// string set to a static buffer — or if any message carries extensions,
+// whose upb_MiniTableExtension pointers are meaningful only in the original
+// process.  Relocating clears per-message caches (retained wire bytes, map
+// sort order).
+//
+// The arena header inside the block is not revived, so treat an attached
+// tree as read-only; to mutate it, upb_Message_DeepClone() it onto a live
+// arena.
+bool upb_Message_Relocate(upb_Message* msg, const upb_MiniTable* mini_table,
+                          const void* old_base, void* new_base, size_t size);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif  // UPB_MESSAGE_RELOCATE_H_
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/message/space_used.h"
+
+#include "upb/collections/array_internal.h"
+#include "upb/collections/map_internal.h"
+#include "upb/message/accessors_internal.h"
+#include "upb/message/internal.h"
+#include "upb/message/tagged_ptr.h"
+#include "upb/mini_table/internal/message.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+static size_t upb_SpaceUsed_Message(const upb_Message* msg,
+                                    const upb_MiniTable* m);
+
+static size_t upb_SpaceUsed_TaggedPtr(upb_TaggedMessagePtr ptr,
+                                      const upb_MiniTable* sub) {
+  if (ptr == 0) return 0;
+  // Unlinked ("empty") sub-messages carry their deferred payload as unknown
+  // bytes, which the empty table's internal-data accounting picks up.
+  return upb_SpaceUsed_Message(
+      _upb_TaggedMessagePtr_GetMessage(ptr),
+      upb_TaggedMessagePtr_IsEmpty(ptr) ? &_kUpb_MiniTable_Empty : sub);
+}
+
+static size_t upb_SpaceUsed_Array(const upb_Array* arr, upb_CType elem_type,
+                                  const upb_MiniTable* sub) {
+  // `capacity` measures the storage this array owns; it is zero for storage
+  // borrowed from another tree by upb_Message_CloneShared().
+  const size_t lg2 = _upb_Array_CTypeSizeLg2(elem_type);
+  size_t n = sizeof(upb_Array) + (arr->capacity << lg2);
+  switch (elem_type) {
+    case kUpb_CType_Message: {
+      const upb_TaggedMessagePtr* elems = _upb_array_constptr(arr);
+      for (size_t i = 0; i < arr->size; i++) {
+        n += upb_SpaceUsed_TaggedPtr(elems[i], sub);
+      }
+      break;
+    }
+    case kUpb_CType_String:
+    case kUpb_CType_Bytes: {
+      const upb_StringView* elems = _upb_array_constptr(arr);
+      for (size_t i = 0; i < arr->size; i++) {
+        n += elems[i].size;
+      }
+      break;
+    }
+    default:
+      break;  // Scalar payloads live in the counted element storage.
+  }
+  return n;
+}
+
+static size_t upb_SpaceUsed_Map(const upb_Map* map, const upb_MiniTable* entry) {
+  size_t n = sizeof(upb_Map);
+
+  // Borrowed storage (upb_Message_CloneShared) is charged to its owner; maps
+  // with message values are never borrowed, so nothing below is missed.
+  if (map->is_borrowed) return n;
+
+  if (map->is_flat) {
+    const size_t flat_cap = _upb_FlatMap_Capacity(map);
+    if (flat_cap == 0) return n;
+    // Slot array (inline keys and values) plus control bytes.
+    n += flat_cap * ((size_t)(map->key_size + map->val_size) + 1);
+    const upb_MiniTableField* flat_val_f = &entry->fields[1];
+    if (upb_MiniTableField_CType(flat_val_f) == kUpb_CType_Message) {
+      const upb_MiniTable* flat_val_sub =
+          upb_MiniTable_GetSubMessageTable(entry, flat_val_f);
+      size_t iter = kUpb_Map_Begin;
+      const char* flat_slot;
+      while ((flat_slot = _upb_FlatMap_Next(map, &iter)) != NULL) {
+        upb_TaggedMessagePtr tagged;
+        memcpy(&tagged, flat_slot + map->key_size, sizeof(tagged));
+        n += upb_SpaceUsed_TaggedPtr(tagged, flat_val_sub);
+      }
+    }
+    return n;
+  }
+
+  const upb_table* t = &map->table.t;
+  const size_t size = upb_table_size(t);
+  if (t->entries == NULL) return n;
+  n += size * (sizeof(upb_tabent) + 1);  // Entry slots plus control bytes.
+
+  const upb_MiniTableField* val_f = &entry->fields[1];
+  const upb_CType val_type = upb_MiniTableField_CType(val_f);
+  const upb_MiniTable* val_sub =
+      val_f->UPB_PRIVATE(submsg_index) != kUpb_NoSub
+          ? upb_MiniTable_GetSubMessageTable(entry, val_f)
+          : NULL;
+
+  for (size_t i = 0; i < size; i++) {
+    if (t->metadata[i] & 0x80) continue;  // Empty or tombstone slot.
+    const upb_tabent* e = &t->entries[i];
+    // Key byte storage, as laid out by the string table's internal copy
+    // (length prefix + bytes + NUL).
+    n += sizeof(uint32_t) + upb_tabstrview(e->key).size + 1;
+    switch (val_type) {
+      case kUpb_CType_Message:
+        n += upb_SpaceUsed_TaggedPtr((upb_TaggedMessagePtr)e->val.val, val_sub);
+        break;
+      case kUpb_CType_String:
+      case kUpb_CType_Bytes: {
+        // String values are boxed: val points at a upb_StringView.
+        const upb_StringView* sv = (const upb_StringView*)(uintptr_t)e->val.val;
+        n += sizeof(upb_StringView) + sv->size;
+        break;
+      }
+      default:
+        break;  // Scalar values are stored inline in the entry.
+    }
+  }
+  return n;
+}
+
+static size_t upb_SpaceUsed_Message(const upb_Message* msg,
+                                    const upb_MiniTable* m) {
+  size_t n = upb_msg_sizeof(m);
+
+  // The internal data block holds the unknown fields and the extension slots
+  // (and its own header); retained wire bytes alias the parse buffer and are
+  // not charged.
+  const upb_Message_Internal* in = upb_Message_Getinternal(msg);
+  if (in->internal) n += in->internal->size;
+
+  for (size_t i = 0; i < m->field_count; i++) {
+    const upb_MiniTableField* f = &m->fields[i];
+    if (upb_IsRepeatedOrMap(f)) {
+      void* const* slot = UPB_PTR_AT(msg, f->offset, void* const);
+      if (*slot == NULL) continue;
+      if (upb_FieldMode_Get(f) == kUpb_FieldMode_Map) {
+        n += upb_SpaceUsed_Map(*slot,
+                               m->subs[f->UPB_PRIVATE(submsg_index)].submsg);
+      } else {
+        n += upb_SpaceUsed_Array(
+            *slot, upb_MiniTableField_CType(f),
+            upb_MiniTableField_CType(f) == kUpb_CType_Message
+                ? upb_MiniTable_GetSubMessageTable(m, f)
+                : NULL);
+      }
+      continue;
+    }
+    if (f->presence > 0) {
+      if (!_upb_hasbit_field(msg, f)) continue;
+    } else if (_upb_MiniTableField_InOneOf(f)) {
+      if (_upb_getoneofcase_field(msg, f) != f->number) continue;
+    }
+    switch (upb_MiniTableField_CType(f)) {
+      case kUpb_CType_Message:
+        n += upb_SpaceUsed_TaggedPtr(
+            *UPB_PTR_AT(msg, f->offset, const upb_TaggedMessagePtr),
+            upb_MiniTable_GetSubMessageTable(m, f));
+        break;
+      case kUpb_CType_String:
+      case kUpb_CType_Bytes: {
+        const void* slot = _upb_MiniTableField_GetConstPtr(msg, f);
+        // Inline-stored strings occupy the slot itself, which is already
+        // counted as part of the struct.
+        if (_upb_MiniTableField_IsInlineString(f) &&
+            _upb_InlineString_IsInline(slot)) {
+          break;
+        }
+        n += ((const upb_StringView*)slot)->size;
+        break;
+      }
+      default:
+        break;  // Scalars occupy only their struct slot.
+    }
+  }
+
+  size_t ext_count;
+  const upb_Message_Extension* ext = _upb_Message_Getexts(msg, &ext_count);
+  for (size_t i = 0; i < ext_count; i++) {
+    // The extension slots themselves were counted with the internal data
+    // block above; charge only what they point at.
+    const upb_MiniTableField* f = &ext[i].ext->field;
+    if (upb_IsRepeatedOrMap(f)) {
+      const upb_Array* arr = ext[i].data.ptr;
+      if (arr) {
+        n += upb_SpaceUsed_Array(arr, upb_MiniTableField_CType(f),
+                                 ext[i].ext->sub.submsg);
+      }
+      continue;
+    }
+    switch (upb_MiniTableField_CType(f)) {
+      case kUpb_CType_Message:
+        n += upb_SpaceUsed_TaggedPtr((upb_TaggedMessagePtr)ext[i].data.ptr,
+                                     ext[i].ext->sub.submsg);
+        break;
+      case kUpb_CType_String:
+      case kUpb_CType_Bytes:
+        n += ext[i].data.str.size;
+        break;
+      default:
+        break;
+    }
+  }
+  return n;
+}
+
+size_t upb_Message_SpaceUsed(const upb_Message* msg,
+                             const upb_MiniTable* mini_table) {
+  return upb_SpaceUsed_Message(msg, mini_table);
+}
+
+#include "upb/port/undef.inc"
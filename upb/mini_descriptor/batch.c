@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/mini_descriptor/batch.h"
+
+#include "upb/mini_descriptor/link.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+typedef struct {
+  upb_MiniTableBatchItem* items;
+  upb_MiniTablePlatform platform;
+  upb_Arena* arena;
+} upb_MiniTableBatchCtx;
+
+// The per-item build task.  Everything it touches is either private to the
+// item (the item struct, a fresh arena) or safe to share between threads
+// (the input buffer, upb_Arena_Fuse() on the batch arena), so a runner may
+// execute it concurrently for distinct indices.
+static void upb_MiniTableBatch_BuildOne(void* task_ctx, size_t index) {
+  upb_MiniTableBatchCtx* ctx = task_ctx;
+  upb_MiniTableBatchItem* item = &ctx->items[index];
+
+  upb_Status_Clear(&item->status);
+  item->table = NULL;
+
+  upb_Arena* arena = upb_Arena_New();
+  if (!arena) {
+    upb_Status_SetErrorMessage(&item->status, "out of memory");
+    return;
+  }
+
+  upb_MiniTable* table =
+      _upb_MiniTable_Build(item->mini_descriptor.data,
+                           item->mini_descriptor.size, ctx->platform, arena,
+                           &item->status);
+  if (table && !upb_Arena_Fuse(ctx->arena, arena)) {
+    upb_Status_SetErrorMessage(&item->status,
+                               "cannot fuse into the batch arena");
+    table = NULL;
+  }
+  // The fused group keeps the table alive until the batch arena is freed.
+  upb_Arena_Free(arena);
+  item->table = table;
+}
+
+static void upb_MiniTableBatch_RunSerial(void* runner_ctx,
+                                         upb_MiniTableBatchTask* task,
+                                         void* task_ctx, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    task(task_ctx, i);
+  }
+}
+
+static bool upb_MiniTableBatch_LinkOne(upb_MiniTableBatchItem* items,
+                                       size_t count, size_t index,
+                                       upb_Arena* arena) {
+  upb_MiniTableBatchItem* item = &items[index];
+  if (item->sub_message_count == 0 && item->sub_enum_count == 0) return true;
+
+  const upb_MiniTable** sub_tables = NULL;
+  if (item->sub_message_count) {
+    sub_tables = upb_Arena_Malloc(
+        arena, item->sub_message_count * sizeof(*sub_tables));
+    if (!sub_tables) {
+      upb_Status_SetErrorMessage(&item->status, "out of memory");
+      return false;
+    }
+    for (size_t i = 0; i < item->sub_message_count; i++) {
+      const int32_t sub = item->sub_messages[i];
+      if (sub < 0) {
+        sub_tables[i] = NULL;  // Tree shaken.
+      } else if ((size_t)sub >= count) {
+        upb_Status_SetErrorFormat(&item->status,
+                                  "sub-message index %d out of range", sub);
+        return false;
+      } else {
+        sub_tables[i] = items[sub].table;
+      }
+    }
+  }
+
+  if (!upb_MiniTable_Link(item->table, sub_tables, item->sub_message_count,
+                          item->sub_enums, item->sub_enum_count)) {
+    upb_Status_SetErrorMessage(
+        &item->status, "sub list does not match the message's fields");
+    return false;
+  }
+  return true;
+}
+
+bool _upb_MiniTable_BuildBatch(upb_MiniTableBatchItem* items, size_t count,
+                               upb_MiniTablePlatform platform, upb_Arena* arena,
+                               upb_MiniTableBatchRunner* runner,
+                               void* runner_ctx) {
+  upb_MiniTableBatchCtx ctx = {items, platform, arena};
+  if (!runner) {
+    runner = &upb_MiniTableBatch_RunSerial;
+    runner_ctx = NULL;
+  }
+  runner(runner_ctx, &upb_MiniTableBatch_BuildOne, &ctx, count);
+
+  bool ok = true;
+  for (size_t i = 0; i < count; i++) {
+    ok &= items[i].table != NULL;
+  }
+  if (!ok) return false;
+
+  // Linking mutates tables that other items point at, so it stays serial;
+  // it is a pointer-stitching pass and a tiny fraction of the build cost.
+  for (size_t i = 0; i < count; i++) {
+    ok &= upb_MiniTableBatch_LinkOne(items, count, i, arena);
+  }
+  return ok;
+}
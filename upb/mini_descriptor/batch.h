@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Batch construction of MiniTables from MiniDescriptors.
+//
+// upb_MiniTable_Build() calls are independent of each other: each one reads
+// only its input buffer and writes only its own arena, so a large descriptor
+// set can be built on many cores at once and then linked in a single serial
+// pass.  upb itself spawns no threads (it has no threading dependency and
+// never has); instead the caller supplies the executor that runs the
+// per-message build tasks, and may run them concurrently.
+
+#ifndef UPB_MINI_DESCRIPTOR_BATCH_H_
+#define UPB_MINI_DESCRIPTOR_BATCH_H_
+
+#include "upb/base/status.h"
+#include "upb/base/string_view.h"
+#include "upb/mem/arena.h"
+#include "upb/mini_descriptor/decode.h"
+#include "upb/mini_table/enum.h"
+#include "upb/mini_table/message.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One message in a batch.  The caller fills in the inputs; the outputs are
+// written by upb_MiniTable_BuildBatch().
+typedef struct {
+  // In: the MiniDescriptor for this message.
+  upb_StringView mini_descriptor;
+
+  // In: sub-message links, as indices into the batch's `items` array.  The
+  // length and order must match the sub-message portion of
+  // upb_MiniTable_GetSubList() for this message; an index of -1 leaves that
+  // field unlinked (tree shaken), like a NULL entry to upb_MiniTable_Link().
+  const int32_t* sub_messages;
+  size_t sub_message_count;
+
+  // In: sub-enum links, in the order returned by upb_MiniTable_GetSubList().
+  // Enum tables are cheap to build and may be shared across batches, so they
+  // are passed as pointers rather than built here.
+  const upb_MiniTableEnum** sub_enums;
+  size_t sub_enum_count;
+
+  // Out: the built table (NULL if this item failed), and the reason for
+  // failure.  The table is allocated on an arena fused into the batch arena.
+  upb_MiniTable* table;
+  upb_Status status;
+} upb_MiniTableBatchItem;
+
+// A task function provided by upb_MiniTable_BuildBatch(): builds the table
+// for `items[index]`.  It touches no state shared between indices, so a
+// runner may invoke it for distinct indices from multiple threads
+// concurrently.  It must be called exactly once for every index in
+// [0, count).
+typedef void upb_MiniTableBatchTask(void* task_ctx, size_t index);
+
+// A caller-supplied executor.  It must run `task(task_ctx, i)` for every
+// i in [0, count) — serially, or distributed over a thread pool — and must
+// not return until all of them have completed.
+typedef void upb_MiniTableBatchRunner(void* runner_ctx,
+                                      upb_MiniTableBatchTask* task,
+                                      void* task_ctx, size_t count);
+
+// Builds every item in `items` via `runner` (pass NULL to run serially),
+// then links sub-messages and sub-enums in a serial pass.  Each build runs
+// on a private arena that is fused into `arena` on success, so `arena` must
+// not have been created over a caller-provided initial block (see
+// upb_Arena_Fuse()) and the resulting tables live until `arena` is freed.
+//
+// Returns true if every item built and linked; on failure the per-item
+// statuses identify the culprits, items may be left built but unlinked, and
+// `table` is NULL for items that failed to build.
+UPB_API bool _upb_MiniTable_BuildBatch(upb_MiniTableBatchItem* items,
+                                       size_t count,
+                                       upb_MiniTablePlatform platform,
+                                       upb_Arena* arena,
+                                       upb_MiniTableBatchRunner* runner,
+                                       void* runner_ctx);
+
+UPB_API_INLINE bool upb_MiniTable_BuildBatch(upb_MiniTableBatchItem* items,
+                                             size_t count, upb_Arena* arena,
+                                             upb_MiniTableBatchRunner* runner,
+                                             void* runner_ctx) {
+  return _upb_MiniTable_BuildBatch(items, count, kUpb_MiniTablePlatform_Native,
+                                   arena, runner, runner_ctx);
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif  // UPB_MINI_DESCRIPTOR_BATCH_H_
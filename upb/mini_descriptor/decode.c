@@ -58,6 +58,9 @@ typedef struct {
   uint16_t offset;
   upb_FieldRep rep;
   upb_LayoutItemType type;
+  // Access-frequency hint; for oneofs, the hottest member.  Higher is hotter,
+  // and hotter items are laid out first.  Zero unless the caller passed hints.
+  uint8_t hotness;
 } upb_LayoutItem;
 
 typedef struct {
@@ -73,8 +76,23 @@ typedef struct {
   upb_MiniTablePlatform platform;
   upb_LayoutItemVector vec;
   upb_Arena* arena;
+  // Optional access-frequency hints, sorted hottest-first by the entry point.
+  const upb_MiniTableFieldHotness* hotness;
+  size_t hotness_count;
 } upb_MtDecoder;
 
+static uint8_t upb_MtDecoder_Hotness(const upb_MtDecoder* d,
+                                     uint32_t field_number) {
+  // The hint list is small (only fields worth distinguishing are listed), so
+  // a linear scan beats setting up an index.
+  for (size_t i = 0; i < d->hotness_count; i++) {
+    if (d->hotness[i].field_number == field_number) {
+      return d->hotness[i].hotness;
+    }
+  }
+  return 0;
+}
+
 // In each field's offset, we temporarily store a presence classifier:
 enum PresenceClass {
   kNoPresence = 0,
@@ -235,6 +253,21 @@ static void upb_MtDecoder_ModifyField(upb_MtDecoder* d,
   if (required) {
     field->offset = kRequiredPresence;
   }
+
+  if (field_modifiers & kUpb_EncodedFieldModifier_IsInlineString) {
+    const upb_FieldType type = field->UPB_PRIVATE(descriptortype);
+    // Only scalar string/bytes message fields may store values inline;
+    // extension values do not live in a message slot (see d->table == NULL in
+    // upb_MtDecoder_ParseModifier()).
+    if (!d->table ||
+        (field->mode & kUpb_FieldMode_Mask) != kUpb_FieldMode_Scalar ||
+        (type != kUpb_FieldType_String && type != kUpb_FieldType_Bytes)) {
+      upb_MdDecoder_ErrorJmp(
+          &d->base, "Invalid inline-string modifier for field %" PRIu32,
+          field->number);
+    }
+    field->mode |= kUpb_LabelFlags_IsInlineString;
+  }
 }
 
 static void upb_MtDecoder_PushItem(upb_MtDecoder* d, upb_LayoutItem item) {
@@ -334,6 +367,9 @@ static const char* upb_MtDecoder_DecodeOneofField(upb_MtDecoder* d,
       upb_MtDecoder_SizeOfRep(item->rep, d->platform)) {
     item->rep = rep;
   }
+  // The oneof is as hot as its hottest member.
+  uint8_t hotness = upb_MtDecoder_Hotness(d, field_num);
+  if (hotness > item->hotness) item->hotness = hotness;
   // Prepend this field to the linked list.
   f->offset = item->field_index;
   item->field_index = (f - d->fields) + kOneofBase;
@@ -352,6 +388,7 @@ static const char* upb_MtDecoder_DecodeOneofs(upb_MtDecoder* d,
       // End of oneof.
       upb_MtDecoder_PushOneof(d, item);
       item.field_index = kUpb_LayoutItem_IndexSentinel;  // Move to next oneof.
+      item.hotness = 0;
     } else {
       ptr = upb_MtDecoder_DecodeOneofField(d, ptr, ch, &item);
     }
@@ -426,12 +463,32 @@ static const char* upb_MtDecoder_Parse(upb_MtDecoder* d, const char* ptr,
         // For extensions, consume only a single field and then return.
         return --ptr;
       }
-      upb_MiniTableField* field = fields;
-      *field_count += 1;
-      fields = (char*)fields + field_size;
-      field->number = ++last_field_number;
-      last_field = field;
-      upb_MiniTable_SetField(d, ch, field, msg_modifiers, sub_counts);
+      // Classify the whole run of consecutive field-type chars up front
+      // (vectorized where available), then decode it in a tight loop; large
+      // schemas are dominated by these runs, and this skips the dispatch
+      // above for every char after the first.  Extensions still consume one
+      // field at a time so the single-field check above stays in force.
+      size_t run = d->table ? 1 + _upb_Base92_ClassifyRun(
+                                      ptr, d->base.end,
+                                      kUpb_EncodedValue_MaxField)
+                            : 1;
+      for (;;) {
+        upb_MiniTableField* field = fields;
+        *field_count += 1;
+        fields = (char*)fields + field_size;
+        ++last_field_number;
+        // The limit is the wire-format cap, or 65535 with
+        // UPB_COMPACT_MINITABLE's 16-bit field numbers.
+        if (UPB_UNLIKELY(last_field_number > UPB_FIELDNUMBER_MAX)) {
+          upb_MdDecoder_ErrorJmp(&d->base, "Field number too large: %" PRIu32,
+                                 last_field_number);
+        }
+        field->number = last_field_number;
+        last_field = field;
+        upb_MiniTable_SetField(d, ch, field, msg_modifiers, sub_counts);
+        if (--run == 0) break;
+        ch = *ptr++;
+      }
     } else if (kUpb_EncodedValue_MinModifier <= ch &&
                ch <= kUpb_EncodedValue_MaxModifier) {
       ptr = upb_MtDecoder_ParseModifier(d, ptr, ch, last_field, &msg_modifiers);
@@ -490,18 +547,24 @@ int upb_MtDecoder_CompareFields(const void* _a, const void* _b) {
   const upb_LayoutItem* a = _a;
   const upb_LayoutItem* b = _b;
   // Currently we just sort by:
-  //  1. rep (smallest fields first)
-  //  2. type (oneof cases first)
-  //  2. field_index (smallest numbers first)
-  // The main goal of this is to reduce space lost to padding.
-  // Later we may have more subtle reasons to prefer a different ordering.
+  //  1. hotness (hottest fields first; all zero without caller hints)
+  //  2. rep (smallest fields first)
+  //  3. type (oneof cases first)
+  //  4. field_index (smallest numbers first)
+  // The main goal of this is to reduce space lost to padding; the hotness
+  // hint additionally clusters frequently-accessed fields at the start of
+  // the message so they share its first cache lines.
+  const int hot_bits = sizeof(a->hotness) * 8;
   const int rep_bits = upb_Log2Ceiling(kUpb_FieldRep_Max);
   const int type_bits = upb_Log2Ceiling(kUpb_LayoutItemType_Max);
   const int idx_bits = (sizeof(a->field_index) * 8);
-  UPB_ASSERT(idx_bits + rep_bits + type_bits < 32);
-#define UPB_COMBINE(rep, ty, idx) (((rep << type_bits) | ty) << idx_bits) | idx
-  uint32_t a_packed = UPB_COMBINE(a->rep, a->type, a->field_index);
-  uint32_t b_packed = UPB_COMBINE(b->rep, b->type, b->field_index);
+  UPB_ASSERT(idx_bits + rep_bits + type_bits + hot_bits < 32);
+#define UPB_COMBINE(cold, rep, ty, idx) \
+  (((((cold << rep_bits) | rep) << type_bits) | ty) << idx_bits) | idx
+  const uint32_t a_cold = 0xff - a->hotness;
+  const uint32_t b_cold = 0xff - b->hotness;
+  uint32_t a_packed = UPB_COMBINE(a_cold, a->rep, a->type, a->field_index);
+  uint32_t b_packed = UPB_COMBINE(b_cold, b->rep, b->type, b->field_index);
   assert(a_packed != b_packed);
 #undef UPB_COMBINE
   return a_packed < b_packed ? -1 : 1;
@@ -515,7 +578,8 @@ static bool upb_MtDecoder_SortLayoutItems(upb_MtDecoder* d) {
     if (f->offset >= kOneofBase) continue;
     upb_LayoutItem item = {.field_index = i,
                            .rep = f->mode >> kUpb_FieldRep_Shift,
-                           .type = kUpb_LayoutItemType_Field};
+                           .type = kUpb_LayoutItemType_Field,
+                           .hotness = upb_MtDecoder_Hotness(d, f->number)};
     upb_MtDecoder_PushItem(d, item);
   }
 
@@ -551,11 +615,33 @@ static void upb_MtDecoder_AssignHasbits(upb_MtDecoder* d) {
     upb_MdDecoder_ErrorJmp(&d->base, "Too many required fields");
   }
 
-  // Next assign non-required hasbit fields.
-  for (int i = 0; i < n; i++) {
-    upb_MiniTableField* field = (upb_MiniTableField*)&ret->fields[i];
-    if (field->offset == kHasbitPresence) {
-      field->presence = ++last_hasbit;
+  // Next assign non-required hasbit fields.  When hotness hints were given,
+  // hot fields get the lowest hasbits so their presence bits land in the
+  // same leading bytes as the hot data they guard.
+  if (d->hotness_count) {
+    for (int i = 0; i < n; i++) {
+      upb_MiniTableField* field = (upb_MiniTableField*)&ret->fields[i];
+      if (field->offset == kHasbitPresence) field->presence = 0;
+    }
+    for (size_t i = 0; i < d->hotness_count; i++) {
+      upb_MiniTableField* field = (upb_MiniTableField*)
+          upb_MiniTable_FindFieldByNumber(ret, d->hotness[i].field_number);
+      if (field && field->offset == kHasbitPresence && field->presence == 0) {
+        field->presence = ++last_hasbit;
+      }
+    }
+    for (int i = 0; i < n; i++) {
+      upb_MiniTableField* field = (upb_MiniTableField*)&ret->fields[i];
+      if (field->offset == kHasbitPresence && field->presence == 0) {
+        field->presence = ++last_hasbit;
+      }
+    }
+  } else {
+    for (int i = 0; i < n; i++) {
+      upb_MiniTableField* field = (upb_MiniTableField*)&ret->fields[i];
+      if (field->offset == kHasbitPresence) {
+        field->presence = ++last_hasbit;
+      }
     }
   }
 
@@ -640,6 +726,13 @@ static void upb_MtDecoder_ValidateEntryField(upb_MtDecoder* d,
         &d->base, "map %s cannot be repeated or map, or be in oneof", name);
   }
 
+  // Map keys and values are copied in and out of the map table as plain
+  // views, so the inline-string representation is not allowed here.
+  if (_upb_MiniTableField_IsInlineString(f)) {
+    upb_MdDecoder_ErrorJmp(&d->base, "map %s cannot be an inline string",
+                           name);
+  }
+
   uint32_t not_ok_types;
   if (expected_num == 1) {
     not_ok_types = (1 << kUpb_FieldType_Float) | (1 << kUpb_FieldType_Double) |
@@ -703,6 +796,7 @@ static void upb_MtDecoder_ParseMessageSet(upb_MtDecoder* d, const char* data,
   ret->dense_below = 0;
   ret->table_mask = -1;
   ret->required_count = 0;
+  ret->fast_encode = NULL;
 }
 
 static upb_MiniTable* upb_MtDecoder_DoBuildMiniTableWithBuf(
@@ -716,6 +810,7 @@ static upb_MiniTable* upb_MtDecoder_DoBuildMiniTableWithBuf(
   decoder->table->dense_below = 0;
   decoder->table->table_mask = -1;
   decoder->table->required_count = 0;
+  decoder->table->fast_encode = NULL;
 
   // Strip off and verify the version tag.
   if (!len--) goto done;
@@ -873,3 +968,47 @@ upb_MiniTable* _upb_MiniTable_Build(const char* data, size_t len,
   free(buf);
   return ret;
 }
+
+static int upb_MtDecoder_CompareHotness(const void* _a, const void* _b) {
+  const upb_MiniTableFieldHotness* a = _a;
+  const upb_MiniTableFieldHotness* b = _b;
+  if (a->hotness != b->hotness) return a->hotness > b->hotness ? -1 : 1;
+  // Tie-break on field number so the layout is deterministic regardless of
+  // the order the caller listed the hints in.
+  return a->field_number < b->field_number ? -1 : 1;
+}
+
+upb_MiniTable* _upb_MiniTable_BuildWithHotness(
+    const char* data, size_t len, const upb_MiniTableFieldHotness* hotness,
+    size_t hotness_count, upb_MiniTablePlatform platform, upb_Arena* arena,
+    upb_Status* status) {
+  // upb_MtDecoder_AssignHasbits() walks the hints hottest-first, so sort a
+  // private copy rather than imposing an order on the caller.
+  upb_MiniTableFieldHotness* sorted = NULL;
+  if (hotness_count) {
+    sorted = malloc(hotness_count * sizeof(*sorted));
+    if (!sorted) {
+      upb_Status_SetErrorMessage(status, "out of memory");
+      return NULL;
+    }
+    memcpy(sorted, hotness, hotness_count * sizeof(*sorted));
+    qsort(sorted, hotness_count, sizeof(*sorted), upb_MtDecoder_CompareHotness);
+  }
+
+  void* buf = NULL;
+  size_t size = 0;
+  upb_MtDecoder decoder = {
+      .base = {.status = status},
+      .platform = platform,
+      .arena = arena,
+      .table = upb_Arena_Malloc(arena, sizeof(*decoder.table)),
+      .hotness = sorted,
+      .hotness_count = hotness_count,
+  };
+
+  upb_MiniTable* ret =
+      upb_MtDecoder_BuildMiniTableWithBuf(&decoder, data, len, &buf, &size);
+  free(buf);
+  free(sorted);
+  return ret;
+}
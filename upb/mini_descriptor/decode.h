@@ -71,6 +71,37 @@ UPB_API_INLINE upb_MiniTable* upb_MiniTable_Build(const char* data, size_t len,
                               status);
 }
 
+// A per-field access-frequency hint for upb_MiniTable_BuildWithHotness().
+// Higher values are hotter; fields not listed are treated as hotness 0
+// (coldest).
+typedef struct {
+  uint32_t field_number;
+  uint8_t hotness;
+} upb_MiniTableFieldHotness;
+
+// Like upb_MiniTable_Build(), but lays out the message with the given
+// access-frequency hints (e.g. from production profiles): hotter fields are
+// placed at lower offsets and get lower hasbits, clustering the hot data and
+// its presence bits into the message's first cache lines.  Within one hotness
+// class the layout is identical to upb_MiniTable_Build(), so passing no hints
+// yields the same layout.  Hints for unknown field numbers are ignored.
+//
+// The hints only affect layout, never wire compatibility; however two tables
+// built with different hints have different layouts, so (as always) accessors
+// must use the same table the message was created with.
+upb_MiniTable* _upb_MiniTable_BuildWithHotness(
+    const char* data, size_t len, const upb_MiniTableFieldHotness* hotness,
+    size_t hotness_count, upb_MiniTablePlatform platform, upb_Arena* arena,
+    upb_Status* status);
+
+UPB_API_INLINE upb_MiniTable* upb_MiniTable_BuildWithHotness(
+    const char* data, size_t len, const upb_MiniTableFieldHotness* hotness,
+    size_t hotness_count, upb_Arena* arena, upb_Status* status) {
+  return _upb_MiniTable_BuildWithHotness(data, len, hotness, hotness_count,
+                                         kUpb_MiniTablePlatform_Native, arena,
+                                         status);
+}
+
 // Initializes a MiniTableExtension buffer that has already been allocated.
 // This is needed by upb_FileDef and upb_MessageDef, which allocate all of the
 // extensions together in a single contiguous array.
@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/mini_descriptor/image.h"
+
+#include <string.h>
+
+#include "upb/hash/int_table.h"
+#include "upb/mini_table/enum.h"
+#include "upb/mini_table/internal/message.h"
+#include "upb/mini_table/sub.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+// Image layout:
+//
+//   upb_MiniTableImage_Header
+//   uint32_t msg_offsets[msg_count]   // offset of each message table blob
+//   uint32_t root_indices[root_count] // writer's `tables`, as msg indices
+//   blobs, each 8-aligned:
+//     message table: upb_MiniTable, then fields[], then subs[]
+//     enum table:    upb_MiniTableEnum, then data[]
+//
+// Inside the blobs, every pointer-sized slot (fields, subs, and each subs[]
+// entry) holds an image-relative offset instead of an address; the loader
+// rewrites them in place.  Offset 0 encodes NULL and offset 1 encodes the
+// _kUpb_MiniTable_Empty sentinel used for unlinked sub-messages; both are
+// impossible blob offsets since the header comes first.
+
+#define kUpb_MiniTableImage_Magic "upbT"
+#define kUpb_MiniTableImage_Version 1
+#define kUpb_MiniTableImage_EmptySentinel 1
+
+typedef struct {
+  char magic[4];
+  uint8_t version;
+  uint8_t ptr_size;
+  uint16_t reserved;
+  uint32_t msg_count;
+  uint32_t root_count;
+  uint32_t size;
+} upb_MiniTableImage_Header;
+
+typedef struct {
+  const upb_MiniTable** msgs;
+  size_t msg_count, msg_cap;
+  const upb_MiniTableEnum** enums;
+  size_t enum_count, enum_cap;
+  upb_inttable seen_msg;   // table pointer -> index in msgs
+  upb_inttable seen_enum;  // table pointer -> index in enums
+  upb_Arena* arena;
+} upb_ImageWriter;
+
+// Number of live entries in a table's subs[] array; the array length is not
+// stored anywhere, but entries are only ever reached through a field's
+// submsg_index, so the maximum index bounds it.
+static size_t upb_Image_SubCount(const upb_MiniTable* m) {
+  size_t n = 0;
+  for (size_t i = 0; i < m->field_count; i++) {
+    const uint16_t idx = m->fields[i].UPB_PRIVATE(submsg_index);
+    if (idx != kUpb_NoSub && (size_t)idx + 1 > n) n = (size_t)idx + 1;
+  }
+  return n;
+}
+
+static size_t upb_Image_EnumDataCount(const upb_MiniTableEnum* e) {
+  return e->mask_limit / 32 + e->value_count;
+}
+
+static bool upb_ImageWriter_AddMsg(upb_ImageWriter* w, const upb_MiniTable* m,
+                                   size_t* idx) {
+  upb_value v;
+  if (upb_inttable_lookup(&w->seen_msg, (uintptr_t)m, &v)) {
+    if (idx) *idx = upb_value_getuint64(v);
+    return true;
+  }
+  if (w->msg_count == w->msg_cap) {
+    size_t new_cap = UPB_MAX(8, w->msg_cap * 2);
+    w->msgs = upb_Arena_Realloc(w->arena, w->msgs,
+                                w->msg_cap * sizeof(*w->msgs),
+                                new_cap * sizeof(*w->msgs));
+    if (!w->msgs) return false;
+    w->msg_cap = new_cap;
+  }
+  if (idx) *idx = w->msg_count;
+  if (!upb_inttable_insert(&w->seen_msg, (uintptr_t)m,
+                           upb_value_uint64(w->msg_count), w->arena)) {
+    return false;
+  }
+  w->msgs[w->msg_count++] = m;
+  return true;
+}
+
+static bool upb_ImageWriter_AddEnum(upb_ImageWriter* w,
+                                    const upb_MiniTableEnum* e) {
+  upb_value v;
+  if (upb_inttable_lookup(&w->seen_enum, (uintptr_t)e, &v)) return true;
+  if (w->enum_count == w->enum_cap) {
+    size_t new_cap = UPB_MAX(8, w->enum_cap * 2);
+    w->enums = upb_Arena_Realloc(w->arena, w->enums,
+                                 w->enum_cap * sizeof(*w->enums),
+                                 new_cap * sizeof(*w->enums));
+    if (!w->enums) return false;
+    w->enum_cap = new_cap;
+  }
+  if (!upb_inttable_insert(&w->seen_enum, (uintptr_t)e,
+                           upb_value_uint64(w->enum_count), w->arena)) {
+    return false;
+  }
+  w->enums[w->enum_count++] = e;
+  return true;
+}
+
+static bool upb_Image_FieldIsSubMsg(const upb_MiniTableField* f) {
+  const uint8_t type = f->UPB_PRIVATE(descriptortype);
+  return type == kUpb_FieldType_Message || type == kUpb_FieldType_Group;
+}
+
+char* upb_MiniTableImage_Build(const upb_MiniTable** tables, size_t count,
+                               upb_Arena* arena, size_t* size) {
+  upb_ImageWriter w = {.arena = arena};
+  if (!upb_inttable_init(&w.seen_msg, arena)) return NULL;
+  if (!upb_inttable_init(&w.seen_enum, arena)) return NULL;
+
+  uint32_t* root_indices = upb_Arena_Malloc(arena, count * sizeof(uint32_t));
+  if (!root_indices && count) return NULL;
+  for (size_t i = 0; i < count; i++) {
+    size_t idx;
+    if (!upb_ImageWriter_AddMsg(&w, tables[i], &idx)) return NULL;
+    root_indices[i] = idx;
+  }
+
+  // Worklist closure: appended tables are visited in turn.
+  for (size_t i = 0; i < w.msg_count; i++) {
+    const upb_MiniTable* m = w.msgs[i];
+    for (size_t j = 0; j < m->field_count; j++) {
+      const upb_MiniTableField* f = &m->fields[j];
+      if (f->UPB_PRIVATE(submsg_index) == kUpb_NoSub) continue;
+      const union upb_MiniTableSub* sub = &m->subs[f->UPB_PRIVATE(submsg_index)];
+      if (upb_Image_FieldIsSubMsg(f)) {
+        if (sub->submsg && sub->submsg != &_kUpb_MiniTable_Empty &&
+            !upb_ImageWriter_AddMsg(&w, sub->submsg, NULL)) {
+          return NULL;
+        }
+      } else if (sub->subenum) {
+        if (!upb_ImageWriter_AddEnum(&w, sub->subenum)) return NULL;
+      }
+    }
+  }
+
+  // Lay out the image.
+  size_t total = sizeof(upb_MiniTableImage_Header) +
+                 w.msg_count * sizeof(uint32_t) + count * sizeof(uint32_t);
+  uint32_t* msg_offsets =
+      upb_Arena_Malloc(arena, w.msg_count * sizeof(uint32_t));
+  uint32_t* enum_offsets =
+      upb_Arena_Malloc(arena, w.enum_count * sizeof(uint32_t));
+  if ((!msg_offsets && w.msg_count) || (!enum_offsets && w.enum_count)) {
+    return NULL;
+  }
+  for (size_t i = 0; i < w.msg_count; i++) {
+    total = UPB_ALIGN_UP(total, 8);
+    msg_offsets[i] = total;
+    total += sizeof(upb_MiniTable) +
+             w.msgs[i]->field_count * sizeof(upb_MiniTableField) +
+             upb_Image_SubCount(w.msgs[i]) * sizeof(union upb_MiniTableSub);
+  }
+  for (size_t i = 0; i < w.enum_count; i++) {
+    total = UPB_ALIGN_UP(total, 8);
+    enum_offsets[i] = total;
+    total += sizeof(upb_MiniTableEnum) +
+             upb_Image_EnumDataCount(w.enums[i]) * sizeof(uint32_t);
+  }
+  if (total > UINT32_MAX) return NULL;
+
+  char* image = upb_Arena_Malloc(arena, total);
+  if (!image) return NULL;
+  memset(image, 0, total);
+
+  upb_MiniTableImage_Header* hdr = (upb_MiniTableImage_Header*)image;
+  memcpy(hdr->magic, kUpb_MiniTableImage_Magic, 4);
+  hdr->version = kUpb_MiniTableImage_Version;
+  hdr->ptr_size = (uint8_t)sizeof(void*);
+  hdr->msg_count = w.msg_count;
+  hdr->root_count = count;
+  hdr->size = (uint32_t)total;
+  uint32_t* out_offsets =
+      (uint32_t*)(image + sizeof(upb_MiniTableImage_Header));
+  memcpy(out_offsets, msg_offsets, w.msg_count * sizeof(uint32_t));
+  memcpy(out_offsets + w.msg_count, root_indices, count * sizeof(uint32_t));
+
+  for (size_t i = 0; i < w.msg_count; i++) {
+    const upb_MiniTable* src = w.msgs[i];
+    upb_MiniTable* dst = (upb_MiniTable*)(image + msg_offsets[i]);
+    const size_t sub_count = upb_Image_SubCount(src);
+    memcpy(dst, src, sizeof(*dst));
+    // Fast-path function pointers cannot be serialized; runtime-built tables
+    // never have them, but clear them regardless.
+    dst->table_mask = (uint16_t)-1;
+    dst->fast_encode = NULL;
+
+    char* fields_blob = (char*)dst + sizeof(*dst);
+    char* subs_blob =
+        fields_blob + src->field_count * sizeof(upb_MiniTableField);
+    memcpy(fields_blob, src->fields,
+           src->field_count * sizeof(upb_MiniTableField));
+    dst->fields = src->field_count
+                      ? (void*)(uintptr_t)(fields_blob - image)
+                      : NULL;
+    dst->subs = sub_count ? (void*)(uintptr_t)(subs_blob - image) : NULL;
+
+    union upb_MiniTableSub* out_subs = (union upb_MiniTableSub*)subs_blob;
+    for (size_t j = 0; j < src->field_count; j++) {
+      const upb_MiniTableField* f = &src->fields[j];
+      const uint16_t idx = f->UPB_PRIVATE(submsg_index);
+      if (idx == kUpb_NoSub) continue;
+      const union upb_MiniTableSub* sub = &src->subs[idx];
+      uintptr_t encoded = 0;
+      if (upb_Image_FieldIsSubMsg(f)) {
+        if (sub->submsg == &_kUpb_MiniTable_Empty) {
+          encoded = kUpb_MiniTableImage_EmptySentinel;
+        } else if (sub->submsg) {
+          upb_value v;
+          bool found =
+              upb_inttable_lookup(&w.seen_msg, (uintptr_t)sub->submsg, &v);
+          UPB_ASSERT(found);
+          encoded = msg_offsets[upb_value_getuint64(v)];
+        }
+      } else if (sub->subenum) {
+        upb_value v;
+        bool found =
+            upb_inttable_lookup(&w.seen_enum, (uintptr_t)sub->subenum, &v);
+        UPB_ASSERT(found);
+        encoded = enum_offsets[upb_value_getuint64(v)];
+      }
+      out_subs[idx].submsg = (void*)encoded;
+    }
+  }
+
+  for (size_t i = 0; i < w.enum_count; i++) {
+    const upb_MiniTableEnum* src = w.enums[i];
+    memcpy(image + enum_offsets[i], src,
+           sizeof(*src) + upb_Image_EnumDataCount(src) * sizeof(uint32_t));
+  }
+
+  *size = total;
+  return image;
+}
+
+const upb_MiniTable** upb_MiniTableImage_Load(void* image, size_t size,
+                                              upb_Arena* arena,
+                                              size_t* count) {
+  char* base = image;
+  if (size < sizeof(upb_MiniTableImage_Header)) return NULL;
+  const upb_MiniTableImage_Header* hdr = (const upb_MiniTableImage_Header*)base;
+  if (memcmp(hdr->magic, kUpb_MiniTableImage_Magic, 4) != 0 ||
+      hdr->version != kUpb_MiniTableImage_Version ||
+      hdr->ptr_size != sizeof(void*) || hdr->size != size) {
+    return NULL;
+  }
+  const size_t index_size =
+      sizeof(upb_MiniTableImage_Header) +
+      ((size_t)hdr->msg_count + hdr->root_count) * sizeof(uint32_t);
+  if (index_size > size) return NULL;
+  const uint32_t* msg_offsets =
+      (const uint32_t*)(base + sizeof(upb_MiniTableImage_Header));
+  const uint32_t* root_indices = msg_offsets + hdr->msg_count;
+
+  for (size_t i = 0; i < hdr->msg_count; i++) {
+    if (msg_offsets[i] + sizeof(upb_MiniTable) > size) return NULL;
+    upb_MiniTable* t = (upb_MiniTable*)(base + msg_offsets[i]);
+    if (t->fields) {
+      const uintptr_t off = (uintptr_t)t->fields;
+      if (off + t->field_count * sizeof(upb_MiniTableField) > size) return NULL;
+      t->fields = (const upb_MiniTableField*)(base + off);
+    }
+    if (t->subs) {
+      const uintptr_t off = (uintptr_t)t->subs;
+      if (off >= size) return NULL;
+      t->subs = (const union upb_MiniTableSub*)(base + off);
+    }
+    for (size_t j = 0; j < t->field_count; j++) {
+      const upb_MiniTableField* f = &t->fields[j];
+      const uint16_t idx = f->UPB_PRIVATE(submsg_index);
+      if (idx == kUpb_NoSub) continue;
+      union upb_MiniTableSub* sub = (union upb_MiniTableSub*)&t->subs[idx];
+      const uintptr_t encoded = (uintptr_t)sub->submsg;
+      if (encoded == 0) {
+        sub->submsg = NULL;
+      } else if (encoded == kUpb_MiniTableImage_EmptySentinel) {
+        sub->submsg = &_kUpb_MiniTable_Empty;
+      } else if (encoded < size) {
+        sub->submsg = (const upb_MiniTable*)(base + encoded);
+      } else {
+        return NULL;
+      }
+    }
+  }
+
+  const upb_MiniTable** roots =
+      upb_Arena_Malloc(arena, hdr->root_count * sizeof(*roots));
+  if (!roots && hdr->root_count) return NULL;
+  for (size_t i = 0; i < hdr->root_count; i++) {
+    if (root_indices[i] >= hdr->msg_count) return NULL;
+    roots[i] = (const upb_MiniTable*)(base + msg_offsets[root_indices[i]]);
+  }
+  *count = hdr->root_count;
+  return roots;
+}
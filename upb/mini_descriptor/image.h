@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Serialization of fully-built, linked MiniTable sets into a single
+// relocatable image, so that table construction at process startup can be
+// replaced by mapping a cached file.
+//
+// Like link.h, these functions have upb_MiniTableImage_* names but live in
+// mini_descriptor/ because they are only relevant to runtime-built tables;
+// the interfaces in mini_table/ treat MiniTables as immutable.
+
+#ifndef UPB_MINI_DESCRIPTOR_IMAGE_H_
+#define UPB_MINI_DESCRIPTOR_IMAGE_H_
+
+#include "upb/mem/arena.h"
+#include "upb/mini_table/message.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Serializes the transitive closure of `tables` (all reachable sub-message
+// and sub-enum tables, including map entry tables) into one self-contained
+// buffer allocated on `arena`; `*size` receives its length.  All internal
+// references are stored as image-relative offsets, so the bytes can be
+// written to disk and mapped at any address later.  Returns NULL on
+// allocation failure.
+//
+// Only runtime-built tables (upb_MiniTable_Build() + linking) can be
+// imaged; generated tables carry fast-parser function pointers, which do
+// not survive serialization.  The image records the pointer size of the
+// producer, so it is only loadable by a matching build — treat it as a
+// cache keyed by binary version, not an interchange format.
+char* upb_MiniTableImage_Build(const upb_MiniTable** tables, size_t count,
+                               upb_Arena* arena, size_t* size);
+
+// Fixes up an image in place (the mapping must be writable, e.g. a private
+// file mapping) and returns the tables corresponding to the writer's
+// `tables` argument, in the same order, allocated on `arena`; `*count`
+// receives their number.  The tables point into `image`, which must outlive
+// them and must not be loaded twice.  Returns NULL if the image is invalid
+// or was produced by an incompatible build.
+const upb_MiniTable** upb_MiniTableImage_Load(void* image, size_t size,
+                                              upb_Arena* arena, size_t* count);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif  // UPB_MINI_DESCRIPTOR_IMAGE_H_
@@ -28,8 +28,17 @@
 #ifndef UPB_MINI_DESCRIPTOR_INTERNAL_BASE92_H_
 #define UPB_MINI_DESCRIPTOR_INTERNAL_BASE92_H_
 
+#include <stddef.h>
+
 #include "upb/base/log2.h"
 
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#include <emmintrin.h>
+#define UPB_BASE92_SSE2 1
+#else
+#define UPB_BASE92_SSE2 0
+#endif
+
 // Must be last.
 #include "upb/port/def.inc"
 
@@ -49,6 +58,31 @@ UPB_INLINE char _upb_FromBase92(uint8_t ch) {
   return _kUpb_FromBase92[ch - ' '];
 }
 
+// Returns the number of leading chars of [ptr, end) that are <= `max`, i.e.
+// the length of a run of same-class chars such as the plain field-type chars
+// that dominate large message mini descriptors.  Classifying a whole chunk
+// per compare lets the mini-table decoder process the run in a tight loop
+// instead of re-entering its dispatch switch for every char.
+UPB_INLINE size_t _upb_Base92_ClassifyRun(const char* ptr, const char* end,
+                                          char max) {
+  const char* p = ptr;
+#if UPB_BASE92_SSE2
+  // _mm_cmpgt_epi8() is a signed compare, matching `*p <= max` below (char
+  // is signed on x86), so bytes >= 0x80 terminate the run in both paths and
+  // fall through to the dispatch switch, which rejects them.
+  const __m128i vmax = _mm_set1_epi8(max);
+  while (end - p >= 16) {
+    const __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+    const unsigned mask =
+        (unsigned)_mm_movemask_epi8(_mm_cmpgt_epi8(chunk, vmax));
+    if (mask) return (size_t)(p - ptr) + __builtin_ctz(mask);
+    p += 16;
+  }
+#endif
+  while (p < end && *p <= max) p++;
+  return (size_t)(p - ptr);
+}
+
 UPB_INLINE const char* _upb_Base92_DecodeVarint(const char* ptr,
                                                 const char* end, char first_ch,
                                                 uint8_t min, uint8_t max,
@@ -233,6 +233,10 @@ static char* _upb_MtDataEncoder_MaybePutModifiers(upb_MtDataEncoder* e,
     encoded_modifiers |= kUpb_EncodedFieldModifier_IsRequired;
   }
 
+  if (field_mod & kUpb_FieldModifier_IsInlineString) {
+    encoded_modifiers |= kUpb_EncodedFieldModifier_IsInlineString;
+  }
+
   return upb_MtDataEncoder_PutModifier(e, ptr, encoded_modifiers);
 }
 
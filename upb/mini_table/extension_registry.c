@@ -27,17 +27,44 @@
 
 #include "upb/mini_table/extension_registry.h"
 
+#include <stdlib.h>
+
 #include "upb/hash/str_table.h"
 #include "upb/mini_table/extension.h"
+#include "upb/mini_table/internal/file.h"
+#include "upb/port/atomic.h"
 
 // Must be last.
 #include "upb/port/def.inc"
 
 #define EXTREG_KEY_SIZE (sizeof(upb_MiniTable*) + sizeof(uint32_t))
 
+// An immutable snapshot of the registry contents, sorted by (extendee,
+// number) for cache-friendly binary search.  Lookups read whichever snapshot
+// is currently published and never touch the mutable strtable, so they need
+// no synchronization; registration builds a new snapshot and publishes it
+// with a release store.  Superseded snapshots are not reclaimed until the
+// registry arena is freed, which is what makes in-flight readers safe.
+typedef struct {
+  size_t count;
+  struct upb_ExtensionSnapshotEntry {
+    const upb_MiniTable* extendee;
+    uint32_t number;
+    const upb_MiniTableExtension* ext;
+  } entries[];
+} upb_ExtensionSnapshot;
+
 struct upb_ExtensionRegistry {
   upb_Arena* arena;
   upb_strtable exts;  // Key is upb_MiniTable* concatenated with fieldnum.
+  UPB_ATOMIC(const upb_ExtensionSnapshot*) snapshot;
+  // Lookups that miss here are retried in |fallback| (may be NULL); see
+  // upb_ExtensionRegistry_SetFallback().
+  const upb_ExtensionRegistry* fallback;
+  // Registries created from a fixed array skip the strtable entirely, so
+  // they cannot accept further registrations (dedup would not see the
+  // array-provided entries).
+  bool read_only;
 };
 
 static void extreg_key(char* buf, const upb_MiniTable* l, uint32_t fieldnum) {
@@ -45,16 +72,128 @@ static void extreg_key(char* buf, const upb_MiniTable* l, uint32_t fieldnum) {
   memcpy(buf + sizeof(l), &fieldnum, sizeof(fieldnum));
 }
 
+static int extreg_entry_cmp(const void* _a, const void* _b) {
+  const struct upb_ExtensionSnapshotEntry* a = _a;
+  const struct upb_ExtensionSnapshotEntry* b = _b;
+  if (a->extendee != b->extendee) {
+    return (uintptr_t)a->extendee < (uintptr_t)b->extendee ? -1 : 1;
+  }
+  if (a->number != b->number) {
+    return a->number < b->number ? -1 : 1;
+  }
+  // Equal keys reach the comparator when DoNewFromArrays() sorts input
+  // containing duplicates before rejecting them; qsort requires a
+  // consistent answer here.
+  return 0;
+}
+
+// Builds a snapshot of the current strtable contents and publishes it for
+// lock-free readers.  Returns false on OOM (the table keeps its entries, but
+// readers keep seeing the previous snapshot).
+static bool upb_ExtensionRegistry_Publish(upb_ExtensionRegistry* r) {
+  const size_t count = upb_strtable_count(&r->exts);
+  upb_ExtensionSnapshot* snap = upb_Arena_Malloc(
+      r->arena, sizeof(*snap) + count * sizeof(snap->entries[0]));
+  if (!snap) return false;
+  snap->count = count;
+
+  size_t i = 0;
+  intptr_t iter = UPB_STRTABLE_BEGIN;
+  upb_StringView key;
+  upb_value val;
+  while (upb_strtable_next2(&r->exts, &key, &val, &iter)) {
+    const upb_MiniTableExtension* ext = upb_value_getconstptr(val);
+    UPB_ASSERT(i < count);
+    snap->entries[i].extendee = ext->extendee;
+    snap->entries[i].number = ext->field.number;
+    snap->entries[i].ext = ext;
+    i++;
+  }
+  UPB_ASSERT(i == count);
+  qsort(snap->entries, count, sizeof(snap->entries[0]), extreg_entry_cmp);
+
+  upb_Atomic_Store(&r->snapshot, snap, memory_order_release);
+  return true;
+}
+
 upb_ExtensionRegistry* upb_ExtensionRegistry_New(upb_Arena* arena) {
   upb_ExtensionRegistry* r = upb_Arena_Malloc(arena, sizeof(*r));
   if (!r) return NULL;
   r->arena = arena;
   if (!upb_strtable_init(&r->exts, 8, arena)) return NULL;
+  upb_Atomic_Init(&r->snapshot, NULL);
+  r->fallback = NULL;
+  r->read_only = false;
   return r;
 }
 
-UPB_API bool upb_ExtensionRegistry_Add(upb_ExtensionRegistry* r,
-                                       const upb_MiniTableExtension* e) {
+void upb_ExtensionRegistry_SetFallback(upb_ExtensionRegistry* r,
+                                       const upb_ExtensionRegistry* fallback) {
+  r->fallback = fallback;
+}
+
+static upb_ExtensionRegistry* upb_ExtensionRegistry_DoNewFromArrays(
+    const upb_MiniTableExtension** const* arrays, const size_t* counts,
+    size_t array_count, upb_Arena* arena) {
+  size_t total = 0;
+  for (size_t i = 0; i < array_count; i++) total += counts[i];
+
+  upb_ExtensionRegistry* r = upb_Arena_Malloc(arena, sizeof(*r));
+  upb_ExtensionSnapshot* snap = upb_Arena_Malloc(
+      arena, sizeof(*snap) + total * sizeof(snap->entries[0]));
+  if (!r || !snap) return NULL;
+
+  snap->count = total;
+  size_t n = 0;
+  for (size_t i = 0; i < array_count; i++) {
+    for (size_t j = 0; j < counts[i]; j++) {
+      const upb_MiniTableExtension* ext = arrays[i][j];
+      snap->entries[n].extendee = ext->extendee;
+      snap->entries[n].number = ext->field.number;
+      snap->entries[n].ext = ext;
+      n++;
+    }
+  }
+  qsort(snap->entries, total, sizeof(snap->entries[0]), extreg_entry_cmp);
+  for (size_t i = 1; i < total; i++) {
+    if (snap->entries[i].extendee == snap->entries[i - 1].extendee &&
+        snap->entries[i].number == snap->entries[i - 1].number) {
+      return NULL;  // Duplicate registration.
+    }
+  }
+
+  r->arena = arena;
+  r->fallback = NULL;
+  r->read_only = true;
+  upb_Atomic_Init(&r->snapshot, snap);
+  return r;
+}
+
+upb_ExtensionRegistry* upb_ExtensionRegistry_NewFromArray(
+    const upb_MiniTableExtension** exts, size_t count, upb_Arena* arena) {
+  return upb_ExtensionRegistry_DoNewFromArrays(&exts, &count, 1, arena);
+}
+
+upb_ExtensionRegistry* upb_ExtensionRegistry_NewFromFiles(
+    const upb_MiniTableFile** files, size_t count, upb_Arena* arena) {
+  const upb_MiniTableExtension*** arrays = NULL;
+  size_t* counts = NULL;
+  if (count) {
+    arrays = upb_Arena_Malloc(arena, count * sizeof(*arrays));
+    counts = upb_Arena_Malloc(arena, count * sizeof(*counts));
+    if (!arrays || !counts) return NULL;
+    for (size_t i = 0; i < count; i++) {
+      arrays[i] = (const upb_MiniTableExtension**)files[i]->exts;
+      counts[i] = files[i]->ext_count;
+    }
+  }
+  return upb_ExtensionRegistry_DoNewFromArrays(
+      (const upb_MiniTableExtension** const*)arrays, counts, count, arena);
+}
+
+static bool upb_ExtensionRegistry_Insert(upb_ExtensionRegistry* r,
+                                         const upb_MiniTableExtension* e) {
+  if (r->read_only) return false;
   char buf[EXTREG_KEY_SIZE];
   extreg_key(buf, e->extendee, e->field.number);
   if (upb_strtable_lookup2(&r->exts, buf, EXTREG_KEY_SIZE, NULL)) return false;
@@ -62,14 +201,29 @@ UPB_API bool upb_ExtensionRegistry_Add(upb_ExtensionRegistry* r,
                              upb_value_constptr(e), r->arena);
 }
 
+UPB_API bool upb_ExtensionRegistry_Add(upb_ExtensionRegistry* r,
+                                       const upb_MiniTableExtension* e) {
+  if (!upb_ExtensionRegistry_Insert(r, e)) return false;
+  if (!upb_ExtensionRegistry_Publish(r)) {
+    // Back out so failure leaves the registry unchanged.
+    char buf[EXTREG_KEY_SIZE];
+    extreg_key(buf, e->extendee, e->field.number);
+    upb_strtable_remove2(&r->exts, buf, EXTREG_KEY_SIZE, NULL);
+    return false;
+  }
+  return true;
+}
+
 bool upb_ExtensionRegistry_AddArray(upb_ExtensionRegistry* r,
                                     const upb_MiniTableExtension** e,
                                     size_t count) {
   const upb_MiniTableExtension** start = e;
   const upb_MiniTableExtension** end = UPB_PTRADD(e, count);
   for (; e < end; e++) {
-    if (!upb_ExtensionRegistry_Add(r, *e)) goto failure;
+    if (!upb_ExtensionRegistry_Insert(r, *e)) goto failure;
   }
+  // Publish once for the whole array rather than per element.
+  if (!upb_ExtensionRegistry_Publish(r)) goto failure;
   return true;
 
 failure:
@@ -85,12 +239,29 @@ failure:
 
 const upb_MiniTableExtension* upb_ExtensionRegistry_Lookup(
     const upb_ExtensionRegistry* r, const upb_MiniTable* t, uint32_t num) {
-  char buf[EXTREG_KEY_SIZE];
-  upb_value v;
-  extreg_key(buf, t, num);
-  if (upb_strtable_lookup2(&r->exts, buf, EXTREG_KEY_SIZE, &v)) {
-    return upb_value_getconstptr(v);
-  } else {
-    return NULL;
+  const upb_ExtensionSnapshot* snap =
+      upb_Atomic_Load(&((upb_ExtensionRegistry*)r)->snapshot,
+                      memory_order_acquire);
+  if (!snap) {  // Nothing has been registered yet.
+    return r->fallback ? upb_ExtensionRegistry_Lookup(r->fallback, t, num)
+                       : NULL;
+  }
+
+  // Binary search the immutable snapshot; no key pasting, no hashing, and no
+  // synchronization with writers needed.
+  size_t lo = 0;
+  size_t hi = snap->count;
+  while (lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    const struct upb_ExtensionSnapshotEntry* entry = &snap->entries[mid];
+    if (entry->extendee == t && entry->number == num) return entry->ext;
+    if ((uintptr_t)entry->extendee < (uintptr_t)t ||
+        (entry->extendee == t && entry->number < num)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
   }
+  return r->fallback ? upb_ExtensionRegistry_Lookup(r->fallback, t, num)
+                     : NULL;
 }
@@ -30,6 +30,7 @@
 
 #include "upb/mem/arena.h"
 #include "upb/mini_table/extension.h"
+#include "upb/mini_table/file.h"
 #include "upb/mini_table/message.h"
 
 // Must be last.
@@ -69,6 +70,13 @@ extern "C" {
  * extensions from a generated module and pass the extension registry to the
  * binary decoder.
  *
+ * Concurrency: lookups read an immutable published snapshot of the registry
+ * and never block or synchronize, so any number of decoders may use the
+ * registry concurrently with one thread registering new extensions; each
+ * registration atomically publishes a new snapshot, and a concurrent lookup
+ * sees either the old or the new contents.  Multiple threads registering
+ * concurrently still require external synchronization.
+ *
  * A upb_DefPool provides a upb_ExtensionRegistry, so any users who use
  * reflection do not need to populate a upb_ExtensionRegistry directly.
  */
@@ -79,9 +87,37 @@ typedef struct upb_ExtensionRegistry upb_ExtensionRegistry;
 // The arena must outlive any use of the extreg.
 UPB_API upb_ExtensionRegistry* upb_ExtensionRegistry_New(upb_Arena* arena);
 
+// Creates a read-only registry directly from an array of extensions that are
+// all known at link time, such as the per-file extension lists in generated
+// code.  This skips per-extension hash registration entirely: the lookup
+// structure is built with one allocation and one sort, so startup cost is
+// O(n log n) pointer compares instead of n hash-table inserts.  (The sort
+// cannot happen at compile time because the order depends on the link-time
+// addresses of the extendee MiniTables.)
+//
+// Returns NULL on OOM or if the same (extendee, number) pair appears twice.
+// The resulting registry rejects upb_ExtensionRegistry_Add(); the extensions
+// and the arena must outlive it.
+upb_ExtensionRegistry* upb_ExtensionRegistry_NewFromArray(
+    const upb_MiniTableExtension** exts, size_t count, upb_Arena* arena);
+
+// Like upb_ExtensionRegistry_NewFromArray(), but collects the extensions
+// from the given generated file tables (e.g. every upb_MiniTableFile linked
+// into the binary).
+upb_ExtensionRegistry* upb_ExtensionRegistry_NewFromFiles(
+    const upb_MiniTableFile** files, size_t count, upb_Arena* arena);
+
 UPB_API bool upb_ExtensionRegistry_Add(upb_ExtensionRegistry* r,
                                        const upb_MiniTableExtension* e);
 
+// Chains |r| to |fallback|: lookups that miss in |r| are retried in
+// |fallback| (and so on transitively).  upb_DefPool_Snapshot() uses this so
+// that a snapshot pool's registry sees the base pool's extensions without
+// copying them.  |fallback| must outlive |r|; registrations always go to |r|
+// and may shadow an entry in |fallback|.
+void upb_ExtensionRegistry_SetFallback(upb_ExtensionRegistry* r,
+                                       const upb_ExtensionRegistry* fallback);
+
 // Adds the given extension info for the array |e| of size |count| into the
 // registry. If there are any errors, the entire array is backed out.
 // The extensions must outlive the registry.
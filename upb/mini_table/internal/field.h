@@ -36,7 +36,8 @@
 // LINT.IfChange(mini_table_field_layout)
 
 struct upb_MiniTableField {
-  uint32_t number;
+  // uint32_t normally; uint16_t under UPB_COMPACT_MINITABLE (see def.inc).
+  UPB_FIELDNUMBER_T number;
   uint16_t offset;
   int16_t presence;       // If >0, hasbit_index.  If <0, ~oneof_index
 
@@ -71,6 +72,11 @@ typedef enum {
   //   - for Bytes, this indicates that the actual type is String (but does
   //     not require any UTF-8 check).
   kUpb_LabelFlags_IsAlternate = 16,
+  // Indicates that this scalar string/bytes field may store short values
+  // inline in its upb_StringView slot instead of pointing into the arena.
+  // See the inline-string helpers in upb/message/accessors_internal.h for the
+  // encoding; fields without this flag never hold inline values.
+  kUpb_LabelFlags_IsInlineString = 32,
 } upb_LabelFlags;
 
 // Note: we sort by this number when calculating layout order.
@@ -94,6 +100,11 @@ _upb_MiniTableField_GetRep(const struct upb_MiniTableField* field) {
   return (upb_FieldRep)(field->mode >> kUpb_FieldRep_Shift);
 }
 
+UPB_INLINE bool _upb_MiniTableField_IsInlineString(
+    const struct upb_MiniTableField* field) {
+  return (field->mode & kUpb_LabelFlags_IsInlineString) != 0;
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -44,6 +44,11 @@ typedef struct {
   _upb_FieldParser* field_parser;
 } _upb_FastTable_Entry;
 
+struct upb_Encoder;
+struct upb_MiniTable;
+typedef void _upb_FastEncoder(struct upb_Encoder* e, const upb_Message* msg,
+                              const struct upb_MiniTable* m);
+
 typedef enum {
   kUpb_ExtMode_NonExtendable = 0,  // Non-extendable message.
   kUpb_ExtMode_Extendable = 1,     // Normal extendable message.
@@ -74,9 +79,17 @@ struct upb_MiniTable {
   uint16_t field_count;
   uint8_t ext;  // upb_ExtMode, declared as uint8_t so sizeof(ext) == 1
   uint8_t dense_below;
-  uint8_t table_mask;
+  // 16 bits so that fast tables can cover two-byte tags across the full
+  // field-number range (up to 256 table slots).
+  uint16_t table_mask;
   uint8_t required_count;  // Required fields have the lowest hasbits.
 
+  // If non-NULL, a generated straight-line encoder for this message type;
+  // encode_message() dispatches to it instead of walking the field metadata.
+  // This is the encode analog of fasttable[] below, and is only generated for
+  // messages whose fields are all non-oneof scalars/strings.
+  _upb_FastEncoder* fast_encode;
+
   // To statically initialize the tables of variable length, we need a flexible
   // array member, and we need to compile in gnu99 mode (constant initialization
   // of flexible array members is a GNU extension, not in C99 unfortunately.
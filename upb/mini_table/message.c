@@ -95,3 +95,13 @@ bool upb_MiniTable_NextOneofField(const upb_MiniTable* m,
   }
   return false;
 }
+
+size_t upb_MiniTable_HasbitBytes(const upb_MiniTable* m) {
+  int max_hasbit = 0;
+  const upb_MiniTableField* end = &m->fields[m->field_count];
+  for (const upb_MiniTableField* f = m->fields; f < end; f++) {
+    if (f->presence > max_hasbit) max_hasbit = f->presence;
+  }
+  // Matches the sizing in upb_MtDecoder_AssignHasbits(): bit 0 is unused.
+  return max_hasbit ? (max_hasbit + 1 + 7) / 8 : 0;
+}
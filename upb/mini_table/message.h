@@ -96,6 +96,13 @@ const upb_MiniTableField* upb_MiniTable_GetOneof(const upb_MiniTable* m,
 bool upb_MiniTable_NextOneofField(const upb_MiniTable* m,
                                   const upb_MiniTableField** f);
 
+// Returns the size in bytes of the hasbit region at the front of messages
+// with this layout.  Within the region, bit i (byte i/8, mask 1 << (i % 8))
+// belongs to the field whose upb_MiniTableField presence value equals i; bit
+// zero is never used.  Callers doing bulk presence scans can read these
+// bytes directly from the start of the message.
+size_t upb_MiniTable_HasbitBytes(const upb_MiniTable* m);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/pipeline/batch_decode.h"
+
+#include <string.h>
+
+#include "upb/message/message.h"
+#include "upb/reflection/message_def.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+size_t upb_Pipeline_SplitNdjson(const char* buf, size_t size,
+                                upb_StringView* records, size_t max_records) {
+  const char* ptr = buf;
+  const char* end = UPB_PTRADD(buf, size);
+  size_t count = 0;
+
+  while (ptr < end) {
+    const char* nl = memchr(ptr, '\n', end - ptr);
+    const char* record_end = nl ? nl : end;
+    size_t len = record_end - ptr;
+    // Tolerate CRLF input and blank lines.
+    if (len && record_end[-1] == '\r') len--;
+    if (len) {
+      if (count < max_records) {
+        records[count] = upb_StringView_FromDataAndSize(ptr, len);
+      }
+      count++;
+    }
+    if (!nl) break;
+    ptr = nl + 1;
+  }
+  return count;
+}
+
+size_t upb_Pipeline_SplitLengthPrefixed(const char* buf, size_t size,
+                                        upb_StringView* records,
+                                        size_t max_records) {
+  const char* ptr = buf;
+  const char* end = UPB_PTRADD(buf, size);
+  size_t count = 0;
+
+  while (ptr < end) {
+    uint64_t len = 0;
+    int shift = 0;
+    for (;;) {
+      if (ptr == end || shift > 63) return (size_t)-1;
+      const uint8_t byte = (uint8_t)*ptr++;
+      len |= (uint64_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) break;
+      shift += 7;
+    }
+    if (len > (uint64_t)(end - ptr)) return (size_t)-1;
+    if (count < max_records) {
+      records[count] = upb_StringView_FromDataAndSize(ptr, len);
+    }
+    count++;
+    ptr += len;
+  }
+  return count;
+}
+
+bool upb_Pipeline_DecodeBatch(const upb_StringView* records, size_t count,
+                              const upb_MiniTable* mt,
+                              const upb_ExtensionRegistry* extreg, int options,
+                              upb_Arena* arena, upb_Message** out,
+                              size_t* error_index) {
+  for (size_t i = 0; i < count; i++) {
+    upb_Message* msg = upb_Message_New(mt, arena);
+    if (!msg || upb_Decode(records[i].data, records[i].size, msg, mt, extreg,
+                           options, arena) != kUpb_DecodeStatus_Ok) {
+      if (error_index) *error_index = i;
+      return false;
+    }
+    out[i] = msg;
+  }
+  return true;
+}
+
+bool upb_Pipeline_DecodeJsonBatch(const upb_StringView* records, size_t count,
+                                  const upb_MessageDef* m,
+                                  const upb_DefPool* pool, int options,
+                                  upb_Arena* arena, upb_Message** out,
+                                  size_t* error_index, upb_Status* status) {
+  const upb_MiniTable* mt = upb_MessageDef_MiniTable(m);
+  for (size_t i = 0; i < count; i++) {
+    upb_Message* msg = upb_Message_New(mt, arena);
+    if (!msg || !upb_JsonDecode(records[i].data, records[i].size, msg, m, pool,
+                                options, arena, status)) {
+      if (!msg && status) upb_Status_SetErrorMessage(status, "out of memory");
+      if (error_index) *error_index = i;
+      return false;
+    }
+    out[i] = msg;
+  }
+  return true;
+}
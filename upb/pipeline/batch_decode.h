@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Batch decoding of record streams (newline-delimited JSON and
+// varint-length-prefixed protobuf).  The splitters turn a buffer into an
+// array of record views without copying; the batch decoders turn a record
+// array into a message array with one call, amortizing setup across the
+// whole batch.
+//
+// None of these functions create threads, but the batch decoders are safe to
+// call concurrently on disjoint sub-ranges of the record array, so a caller
+// with a thread pool can parallelize ingest by giving each worker its own
+// upb_Arena and its own slice of |records| and |out|, then fusing the worker
+// arenas with upb_Arena_FuseAll() so that one arena owns the whole batch.
+
+#ifndef UPB_PIPELINE_BATCH_DECODE_H_
+#define UPB_PIPELINE_BATCH_DECODE_H_
+
+#include "upb/json/decode.h"
+#include "upb/reflection/def.h"
+#include "upb/wire/decode.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Splits |buf| into newline-delimited records.  Returns the total number of
+// records in the buffer and fills in at most |max_records| views, so the
+// result can be larger than |max_records|; call once with max_records=0 to
+// size the array, then again to fill it.  Blank lines are skipped and a
+// final record does not need a trailing newline.  Record views alias |buf|.
+size_t upb_Pipeline_SplitNdjson(const char* buf, size_t size,
+                                upb_StringView* records, size_t max_records);
+
+// Like upb_Pipeline_SplitNdjson() but for records framed with a varint
+// length prefix, the conventional protobuf stream framing.  Returns
+// (size_t)-1 if the buffer ends in the middle of a length or a record.
+size_t upb_Pipeline_SplitLengthPrefixed(const char* buf, size_t size,
+                                        upb_StringView* records,
+                                        size_t max_records);
+
+// Decodes |count| wire-format records into |out|, which must have room for
+// |count| messages; all messages are allocated from |arena|.  On failure
+// returns false with |*error_index| (if non-NULL) set to the offending
+// record; out[i] is valid for i < *error_index.  |extreg| may be NULL.
+bool upb_Pipeline_DecodeBatch(const upb_StringView* records, size_t count,
+                              const upb_MiniTable* mt,
+                              const upb_ExtensionRegistry* extreg, int options,
+                              upb_Arena* arena, upb_Message** out,
+                              size_t* error_index);
+
+// The JSON counterpart: decodes |count| JSON records against |m|.  |options|
+// are upb_JsonDecode options.  On failure returns false with |*error_index|
+// set as above and a description in |status|.
+bool upb_Pipeline_DecodeJsonBatch(const upb_StringView* records, size_t count,
+                                  const upb_MessageDef* m,
+                                  const upb_DefPool* pool, int options,
+                                  upb_Arena* arena, upb_Message** out,
+                                  size_t* error_index, upb_Status* status);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_PIPELINE_BATCH_DECODE_H_ */
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/port/cpu_dispatch.h"
+
+#include <stdlib.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#define UPB_CPU_DISPATCH_X86 1
+#endif
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+// Must be last.
+#include "upb/port/def.inc"
+
+// High bit marks "detection has run", so a host with no reportable features
+// still caches a nonzero value.  Never returned to callers.
+#define kUpb_CpuDispatch_Resolved 0x80000000u
+
+static uint32_t upb_CpuDispatch_cached;  // 0 = not yet resolved.
+
+#ifdef UPB_CPU_DISPATCH_X86
+
+// cpuid.h on older toolchains lacks some of these.
+#ifndef bit_SSE4_2
+#define bit_SSE4_2 (1 << 20)
+#endif
+#ifndef bit_OSXSAVE
+#define bit_OSXSAVE (1 << 27)
+#endif
+#ifndef bit_AVX
+#define bit_AVX (1 << 28)
+#endif
+#ifndef bit_AVX2
+#define bit_AVX2 (1 << 5)
+#endif
+#ifndef bit_AVX512F
+#define bit_AVX512F (1 << 16)
+#endif
+#ifndef bit_AVX512BW
+#define bit_AVX512BW (1 << 30)
+#endif
+#ifndef bit_AVX512VL
+#define bit_AVX512VL (1u << 31)
+#endif
+
+static uint64_t upb_CpuDispatch_Xgetbv(void) {
+  uint32_t lo, hi;
+  __asm__ volatile(".byte 0x0f, 0x01, 0xd0" /* xgetbv */
+                   : "=a"(lo), "=d"(hi)
+                   : "c"(0));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+static uint32_t upb_CpuDispatch_DetectX86(void) {
+  uint32_t features = 0;
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return 0;
+  if (ecx & bit_SSE4_2) features |= kUpb_CpuFeature_X86_Sse42;
+
+  // Vector extensions beyond SSE need the OS to have enabled the wider
+  // register state (XCR0), not just the CPU to implement the instructions.
+  if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) return features;
+  const uint64_t xcr0 = upb_CpuDispatch_Xgetbv();
+  const bool ymm = (xcr0 & 0x6) == 0x6;
+  const bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+  unsigned eax7, ebx7, ecx7, edx7;
+  if (!__get_cpuid_count(7, 0, &eax7, &ebx7, &ecx7, &edx7)) return features;
+  if (ymm && (ebx7 & bit_AVX2)) features |= kUpb_CpuFeature_X86_Avx2;
+  if (zmm && (ebx7 & bit_AVX512F) && (ebx7 & bit_AVX512BW) &&
+      (ebx7 & bit_AVX512VL)) {
+    features |= kUpb_CpuFeature_X86_Avx512;
+  }
+  return features;
+}
+
+#endif  // UPB_CPU_DISPATCH_X86
+
+#ifdef __aarch64__
+
+#ifndef HWCAP2_SVE2
+#define HWCAP2_SVE2 (1 << 1)
+#endif
+
+static uint32_t upb_CpuDispatch_DetectArm(void) {
+  uint32_t features = kUpb_CpuFeature_Arm_Neon;  // Baseline on AArch64.
+#if defined(__linux__) && defined(AT_HWCAP2)
+  if (getauxval(AT_HWCAP2) & HWCAP2_SVE2) {
+    features |= kUpb_CpuFeature_Arm_Sve2;
+  }
+#endif
+  return features;
+}
+
+#endif  // __aarch64__
+
+static uint32_t upb_CpuDispatch_Detect(void) {
+#ifdef UPB_FORCE_BASELINE
+  return 0;
+#else
+  const char* force = getenv("UPB_FORCE_BASELINE");
+  if (force && force[0]) return 0;
+#if defined(UPB_CPU_DISPATCH_X86)
+  return upb_CpuDispatch_DetectX86();
+#elif defined(__aarch64__)
+  return upb_CpuDispatch_DetectArm();
+#else
+  return 0;
+#endif
+#endif  // UPB_FORCE_BASELINE
+}
+
+uint32_t upb_CpuDispatch_Features(void) {
+  uint32_t cached = upb_CpuDispatch_cached;
+  if (UPB_UNLIKELY(cached == 0)) {
+    // Unsynchronized: detection is idempotent, so concurrent first callers
+    // compute and store the same value.
+    cached = upb_CpuDispatch_Detect() | kUpb_CpuDispatch_Resolved;
+    upb_CpuDispatch_cached = cached;
+  }
+  return cached & ~kUpb_CpuDispatch_Resolved;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Runtime CPU feature dispatch.
+//
+// upb's SIMD kernels are gated at compile time on the baseline ISA (__SSE2__,
+// __ARM_NEON), which wastes the wider units of newer hosts when one binary is
+// deployed across a heterogeneous fleet.  This header exposes the features of
+// the running CPU so a kernel can be picked once per process:
+//
+//   typedef int upb_SomeKernelFn(const char* p, const char* e);
+//   static upb_SomeKernelFn* some_kernel;  // NULL until first use.
+//   ...
+//   upb_SomeKernelFn* fn = some_kernel;
+//   if (UPB_UNLIKELY(fn == NULL)) {
+//     fn = upb_CpuDispatch_Has(kUpb_CpuFeature_X86_Avx2) ? &kernel_avx2
+//                                                        : &kernel_baseline;
+//     some_kernel = fn;
+//   }
+//
+// Detection runs at most once and is idempotent, so the unsynchronized
+// resolve above is a benign race: concurrent first callers store the same
+// pointer.
+//
+// Escape hatch: define UPB_FORCE_BASELINE at build time, or set the
+// UPB_FORCE_BASELINE environment variable to a nonempty value, and no
+// features are reported -- every dispatch site falls back to its portable
+// baseline kernel.
+
+#ifndef UPB_PORT_CPU_DISPATCH_H_
+#define UPB_PORT_CPU_DISPATCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  // x86-64.  SSE2 is part of the baseline and not reported separately.
+  kUpb_CpuFeature_X86_Sse42 = 1 << 0,
+  kUpb_CpuFeature_X86_Avx2 = 1 << 1,
+  // AVX512F+BW+VL with full ZMM state enabled by the OS; the byte-granular
+  // subset our kernels want.
+  kUpb_CpuFeature_X86_Avx512 = 1 << 2,
+
+  // AArch64.  NEON is part of the baseline there, reported for symmetry.
+  kUpb_CpuFeature_Arm_Neon = 1 << 8,
+  kUpb_CpuFeature_Arm_Sve2 = 1 << 9,
+} upb_CpuFeature;
+
+// Returns the bitwise OR of the upb_CpuFeature bits present on this host
+// (zero when forced to baseline).  The first call performs detection; later
+// calls return a cached value.
+uint32_t upb_CpuDispatch_Features(void);
+
+UPB_INLINE bool upb_CpuDispatch_Has(upb_CpuFeature feature) {
+  return (upb_CpuDispatch_Features() & feature) != 0;
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_PORT_CPU_DISPATCH_H_ */
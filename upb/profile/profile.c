@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/profile/profile.h"
+
+#include <string.h>
+#include <time.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef UPB_THREAD_LOCAL
+static UPB_THREAD_LOCAL upb_ProfileSnapshot upb_profile_counters;
+#else
+/* Without TLS support the counters degrade to process-wide; increments may
+ * race, which skews attribution but never corrupts memory (the counters are
+ * only ever read for reporting). */
+static upb_ProfileSnapshot upb_profile_counters;
+#endif
+
+uint64_t _upb_Profile_CycleNow(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  uint32_t lo, hi;
+  __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t)hi << 32) | lo;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t virtual_timer;
+  __asm__ volatile("mrs %0, cntvct_el0" : "=r"(virtual_timer));
+  return virtual_timer;
+#else
+  /* No cheap cycle counter; fall back to nanoseconds, which still gives
+   * correct relative attribution between subsystems. */
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void _upb_Profile_Record(upb_ProfileSubsystem subsystem, uint64_t cycles) {
+  upb_profile_counters.cycles[subsystem] += cycles;
+  upb_profile_counters.calls[subsystem]++;
+}
+
+void upb_Profile_Snapshot(upb_ProfileSnapshot* out) {
+  memcpy(out, &upb_profile_counters, sizeof(*out));
+}
+
+void upb_Profile_Reset(void) {
+  memset(&upb_profile_counters, 0, sizeof(upb_profile_counters));
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Per-thread cycle accounting for upb subsystems.
+ *
+ * Counters are only updated when the library is compiled with -DUPB_PROFILE;
+ * without it the recording hooks in the subsystem entry points compile away
+ * and snapshots read as all zeros.  This API is always present, so callers
+ * do not need their own conditional compilation.
+ *
+ * Cycles are attributed at the public entry points, so a decode that
+ * internally re-enters upb_Decode() (eg. when promoting unknown fields to
+ * extensions) has the nested interval counted in both calls. */
+
+#ifndef UPB_PROFILE_PROFILE_H_
+#define UPB_PROFILE_PROFILE_H_
+
+#include <stdint.h>
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  kUpb_ProfileSubsystem_Decode = 0,
+  kUpb_ProfileSubsystem_Encode = 1,
+  kUpb_ProfileSubsystem_JsonDecode = 2,
+  kUpb_ProfileSubsystem_ArenaAlloc = 3,
+  kUpb_ProfileSubsystem_Count = 4,
+} upb_ProfileSubsystem;
+
+typedef struct {
+  uint64_t cycles[kUpb_ProfileSubsystem_Count];
+  uint64_t calls[kUpb_ProfileSubsystem_Count];
+} upb_ProfileSnapshot;
+
+/* Copies the calling thread's counters into |out|. */
+UPB_API void upb_Profile_Snapshot(upb_ProfileSnapshot* out);
+
+/* Zeroes the calling thread's counters. */
+UPB_API void upb_Profile_Reset(void);
+
+/* Internal-only: used by the UPB_PROFILE_BEGIN()/UPB_PROFILE_END() hooks in
+ * port/def.inc. */
+uint64_t _upb_Profile_CycleNow(void);
+void _upb_Profile_Record(upb_ProfileSubsystem subsystem, uint64_t cycles);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_PROFILE_PROFILE_H_ */
@@ -25,6 +25,7 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "upb/base/log2.h"
 #include "upb/hash/int_table.h"
 #include "upb/hash/str_table.h"
 #include "upb/reflection/def_builder_internal.h"
@@ -36,15 +37,74 @@
 #include "upb/reflection/file_def_internal.h"
 #include "upb/reflection/message_def_internal.h"
 #include "upb/reflection/service_def_internal.h"
+#include "upb/port/atomic.h"
 
 // Must be last.
 #include "upb/port/def.inc"
 
+// A file that was registered lazily: we retain its parsed descriptor (and the
+// arena that owns it) and defer building its defs until the first lookup of
+// one of the file's symbols.
+typedef struct upb_DefPoolLazyFile {
+  const UPB_DESC(FileDescriptorProto) * file_proto;
+  const upb_MiniTableFile* layout;  // NULL to build layouts at runtime.
+  upb_Arena* arena;                 // Owns file_proto; freed once built.
+  struct upb_DefPoolLazyFile* next;  // Pending list, for upb_DefPool_Free().
+} upb_DefPoolLazyFile;
+
+// A generated file that is known only as a pointer to its compiled-in init
+// metadata: registered as a dependency of some _upb_DefPool_LoadDefInit()ed
+// file, but itself never loaded.  Cheaper than upb_DefPoolLazyFile (no
+// descriptor parse, no symbol scan, no arena); promoted to a real build the
+// first time the file is needed.
+typedef struct {
+  const _upb_DefPool_Init* init;
+  const upb_MiniTableFile* layout;  // NULL to build layouts at runtime.
+} upb_DefPoolPendingInit;
+
+// An immutable snapshot of the pool's lookup tables.  All Find*() calls
+// resolve against the most recently published snapshot, which makes them
+// lock-free against a concurrent writer; see the thread-safety notes in
+// def_pool.h.  The strtables below remain the canonical (writer-side) state;
+// a new snapshot is published after every mutation.  Superseded snapshots are
+// retained on the pool's arena so that in-flight readers stay valid.
+typedef struct {
+  upb_StringView name;
+  upb_value value;
+} upb_DefPool_IndexEntry;
+
+typedef struct {
+  const upb_MiniTableExtension* ext;
+  const upb_FieldDef* field;
+} upb_DefPool_ExtIndexEntry;
+
+typedef struct {
+  upb_DefPool_IndexEntry* syms;        // Sorted by name.
+  upb_DefPool_IndexEntry* files;       // Sorted by name.
+  upb_DefPool_IndexEntry* lazy_syms;   // Sorted by name.
+  upb_DefPool_IndexEntry* lazy_files;  // Sorted by name.
+  upb_DefPool_ExtIndexEntry* exts;     // Sorted by MiniTable pointer.
+  size_t sym_count;
+  size_t file_count;
+  size_t lazy_sym_count;
+  size_t lazy_file_count;
+  size_t ext_count;
+} upb_DefPool_Index;
+
 struct upb_DefPool {
   upb_Arena* arena;
-  upb_strtable syms;   // full_name -> packed def ptr
-  upb_strtable files;  // file_name -> (upb_FileDef*)
-  upb_inttable exts;   // (upb_MiniTableExtension*) -> (upb_FieldDef*)
+  // Snapshot layering: lookups that miss in this pool fall through to |base|
+  // (and so on transitively); NULL for ordinary pools.  See
+  // upb_DefPool_Snapshot().
+  const upb_DefPool* base;
+  upb_strtable syms;        // full_name -> packed def ptr
+  upb_strtable files;       // file_name -> (upb_FileDef*)
+  upb_strtable lazy_files;  // file_name -> (upb_DefPoolLazyFile*)
+  upb_strtable lazy_syms;   // full_name -> (upb_DefPoolLazyFile*)
+  upb_strtable lazy_inits;  // file_name -> (upb_DefPoolPendingInit*)
+  upb_inttable exts;        // (upb_MiniTableExtension*) -> (upb_FieldDef*)
+  UPB_ATOMIC(const upb_DefPool_Index*) index;  // NULL means "empty pool".
+  upb_DefPoolLazyFile* lazy_head;
   upb_ExtensionRegistry* extreg;
   upb_MiniTablePlatform platform;
   void* scratch_data;
@@ -53,6 +113,12 @@ struct upb_DefPool {
 };
 
 void upb_DefPool_Free(upb_DefPool* s) {
+  // Files that were registered lazily but never built still own their arenas.
+  for (upb_DefPoolLazyFile* lf = s->lazy_head; lf;) {
+    upb_DefPoolLazyFile* next = lf->next;
+    upb_Arena_Free(lf->arena);  // Also frees |lf| itself.
+    lf = next;
+  }
   upb_Arena_Free(s->arena);
   upb_gfree(s->scratch_data);
   upb_gfree(s);
@@ -63,7 +129,10 @@ upb_DefPool* upb_DefPool_New(void) {
   if (!s) return NULL;
 
   s->arena = upb_Arena_New();
+  s->base = NULL;
   s->bytes_loaded = 0;
+  s->lazy_head = NULL;
+  upb_Atomic_Init(&s->index, NULL);
 
   s->scratch_size = 240;
   s->scratch_data = upb_gmalloc(s->scratch_size);
@@ -71,8 +140,16 @@ upb_DefPool* upb_DefPool_New(void) {
 
   if (!upb_strtable_init(&s->syms, 32, s->arena)) goto err;
   if (!upb_strtable_init(&s->files, 4, s->arena)) goto err;
+  if (!upb_strtable_init(&s->lazy_files, 4, s->arena)) goto err;
+  if (!upb_strtable_init(&s->lazy_syms, 32, s->arena)) goto err;
+  if (!upb_strtable_init(&s->lazy_inits, 4, s->arena)) goto err;
   if (!upb_inttable_init(&s->exts, s->arena)) goto err;
 
+  /* The symbol tables can grow very large (one entry per def); amortize their
+   * rehashes so no single AddFile call pays for moving the whole table. */
+  upb_strtable_setincrementalrehash(&s->syms, true);
+  upb_strtable_setincrementalrehash(&s->lazy_syms, true);
+
   s->extreg = upb_ExtensionRegistry_New(s->arena);
   if (!s->extreg) goto err;
 
@@ -85,6 +162,17 @@ err:
   return NULL;
 }
 
+upb_DefPool* upb_DefPool_Snapshot(const upb_DefPool* base) {
+  upb_DefPool* s = upb_DefPool_New();
+  if (!s) return NULL;
+  s->base = base;
+  s->platform = base->platform;
+  // Extension lookups (including binary decoding through the snapshot's
+  // registry) must also see the base pool's extensions.
+  upb_ExtensionRegistry_SetFallback(s->extreg, base->extreg);
+  return s;
+}
+
 bool _upb_DefPool_InsertExt(upb_DefPool* s, const upb_MiniTableExtension* ext,
                             const upb_FieldDef* f) {
   return upb_inttable_insert(&s->exts, (uintptr_t)ext, upb_value_constptr(f),
@@ -95,7 +183,8 @@ bool _upb_DefPool_InsertSym(upb_DefPool* s, upb_StringView sym, upb_value v,
                             upb_Status* status) {
   // TODO: table should support an operation "tryinsert" to avoid the double
   // lookup.
-  if (upb_strtable_lookup2(&s->syms, sym.data, sym.size, NULL)) {
+  if (upb_strtable_lookup2(&s->syms, sym.data, sym.size, NULL) ||
+      upb_strtable_lookup2(&s->lazy_syms, sym.data, sym.size, NULL)) {
     upb_Status_SetErrorFormat(status, "duplicate symbol '%s'", sym.data);
     return false;
   }
@@ -106,17 +195,157 @@ bool _upb_DefPool_InsertSym(upb_DefPool* s, upb_StringView sym, upb_value v,
   return true;
 }
 
+static int upb_DefPool_NameCmp(const char* a, size_t a_size, const char* b,
+                               size_t b_size) {
+  const size_t min = UPB_MIN(a_size, b_size);
+  const int cmp = min ? memcmp(a, b, min) : 0;
+  if (cmp != 0) return cmp;
+  return a_size < b_size ? -1 : (a_size > b_size ? 1 : 0);
+}
+
+static int upb_DefPool_IndexEntryCmp(const void* a, const void* b) {
+  const upb_DefPool_IndexEntry* ea = a;
+  const upb_DefPool_IndexEntry* eb = b;
+  return upb_DefPool_NameCmp(ea->name.data, ea->name.size, eb->name.data,
+                             eb->name.size);
+}
+
+static int upb_DefPool_ExtIndexEntryCmp(const void* a, const void* b) {
+  const upb_DefPool_ExtIndexEntry* ea = a;
+  const upb_DefPool_ExtIndexEntry* eb = b;
+  if ((uintptr_t)ea->ext < (uintptr_t)eb->ext) return -1;
+  if ((uintptr_t)ea->ext > (uintptr_t)eb->ext) return 1;
+  return 0;
+}
+
+static bool upb_DefPool_IndexFind(const upb_DefPool_IndexEntry* entries,
+                                  size_t count, const char* name, size_t size,
+                                  upb_value* v) {
+  size_t lo = 0;
+  size_t hi = count;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    const int cmp = upb_DefPool_NameCmp(name, size, entries[mid].name.data,
+                                        entries[mid].name.size);
+    if (cmp == 0) {
+      *v = entries[mid].value;
+      return true;
+    }
+    if (cmp < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return false;
+}
+
+static const upb_DefPool_Index* _upb_DefPool_GetIndex(const upb_DefPool* s) {
+  upb_DefPool* mutable_s = (upb_DefPool*)s;
+  return upb_Atomic_Load(&mutable_s->index, memory_order_acquire);
+}
+
+static bool upb_DefPool_SnapshotStrtable(upb_DefPool* s, const upb_strtable* t,
+                                         upb_DefPool_IndexEntry** out,
+                                         size_t* count) {
+  const size_t n = upb_strtable_count(t);
+  *count = n;
+  *out = NULL;
+  if (n == 0) return true;
+
+  upb_DefPool_IndexEntry* entries =
+      upb_Arena_Malloc(s->arena, n * sizeof(*entries));
+  if (!entries) return false;
+
+  intptr_t iter = UPB_INTTABLE_BEGIN;
+  upb_StringView key;
+  upb_value val;
+  size_t i = 0;
+  while (upb_strtable_next2(t, &key, &val, &iter)) {
+    entries[i].name = key;
+    entries[i].value = val;
+    i++;
+  }
+  UPB_ASSERT(i == n);
+  qsort(entries, n, sizeof(*entries), upb_DefPool_IndexEntryCmp);
+  *out = entries;
+  return true;
+}
+
+// Publishes a fresh snapshot of the canonical tables.  Must be called (by the
+// writer) after every mutation; until then readers keep resolving against the
+// previous snapshot.
+static bool _upb_DefPool_PublishIndex(upb_DefPool* s) {
+  upb_DefPool_Index* idx = upb_Arena_Malloc(s->arena, sizeof(*idx));
+  if (!idx) return false;
+
+  if (!upb_DefPool_SnapshotStrtable(s, &s->syms, &idx->syms,
+                                    &idx->sym_count) ||
+      !upb_DefPool_SnapshotStrtable(s, &s->files, &idx->files,
+                                    &idx->file_count) ||
+      !upb_DefPool_SnapshotStrtable(s, &s->lazy_syms, &idx->lazy_syms,
+                                    &idx->lazy_sym_count) ||
+      !upb_DefPool_SnapshotStrtable(s, &s->lazy_files, &idx->lazy_files,
+                                    &idx->lazy_file_count)) {
+    return false;
+  }
+
+  const size_t ext_count = upb_inttable_count(&s->exts);
+  idx->ext_count = ext_count;
+  idx->exts = NULL;
+  if (ext_count) {
+    idx->exts = upb_Arena_Malloc(s->arena, ext_count * sizeof(*idx->exts));
+    if (!idx->exts) return false;
+    intptr_t iter = UPB_INTTABLE_BEGIN;
+    uintptr_t key;
+    upb_value val;
+    size_t i = 0;
+    while (upb_inttable_next(&s->exts, &key, &val, &iter)) {
+      idx->exts[i].ext = (const upb_MiniTableExtension*)key;
+      idx->exts[i].field = upb_value_getconstptr(val);
+      i++;
+    }
+    UPB_ASSERT(i == ext_count);
+    qsort(idx->exts, ext_count, sizeof(*idx->exts),
+          upb_DefPool_ExtIndexEntryCmp);
+  }
+
+  upb_Atomic_Store(&s->index, idx, memory_order_release);
+  return true;
+}
+
+static bool _upb_DefPool_BuildLazySym(const upb_DefPool* s,
+                                      const upb_DefPool_Index* idx,
+                                      const char* sym, size_t size);
+
 static const void* _upb_DefPool_Unpack(const upb_DefPool* s, const char* sym,
                                        size_t size, upb_deftype_t type) {
+  const upb_DefPool_Index* idx = _upb_DefPool_GetIndex(s);
   upb_value v;
-  return upb_strtable_lookup2(&s->syms, sym, size, &v)
-             ? _upb_DefType_Unpack(v, type)
-             : NULL;
+  bool found =
+      idx && upb_DefPool_IndexFind(idx->syms, idx->sym_count, sym, size, &v);
+  if (!found && idx && _upb_DefPool_BuildLazySym(s, idx, sym, size)) {
+    // The symbol belonged to a file that was registered lazily.
+    idx = _upb_DefPool_GetIndex(s);
+    found =
+        idx && upb_DefPool_IndexFind(idx->syms, idx->sym_count, sym, size, &v);
+  }
+  if (!found) {
+    // A snapshot layer falls through to its base pool.
+    return s->base ? _upb_DefPool_Unpack(s->base, sym, size, type) : NULL;
+  }
+  return _upb_DefType_Unpack(v, type);
 }
 
 bool _upb_DefPool_LookupSym(const upb_DefPool* s, const char* sym, size_t size,
                             upb_value* v) {
-  return upb_strtable_lookup2(&s->syms, sym, size, v);
+  if (upb_strtable_lookup2(&s->syms, sym, size, v)) return true;
+  if (!s->base) return false;
+  // A snapshot layer resolves against its base pool; a lazily-registered file
+  // in the base is built on demand, exactly as for a direct lookup.
+  const upb_DefPool_Index* idx = _upb_DefPool_GetIndex(s->base);
+  if (idx) _upb_DefPool_BuildLazySym(s->base, idx, sym, size);
+  return _upb_DefPool_LookupSym(s->base, sym, size, v);
 }
 
 upb_ExtensionRegistry* _upb_DefPool_ExtReg(const upb_DefPool* s) {
@@ -132,10 +361,407 @@ size_t* _upb_DefPool_ScratchSize(const upb_DefPool* s) {
 }
 
 void _upb_DefPool_SetPlatform(upb_DefPool* s, upb_MiniTablePlatform platform) {
-  assert(upb_strtable_count(&s->files) == 0);
+  assert(upb_strtable_count(&s->files) == 0 &&
+         upb_strtable_count(&s->lazy_files) == 0 &&
+         upb_strtable_count(&s->lazy_inits) == 0);
   s->platform = platform;
 }
 
+static const upb_FileDef* _upb_DefPool_AddFile(
+    upb_DefPool* s, const UPB_DESC(FileDescriptorProto) * file_proto,
+    const upb_MiniTableFile* layout, upb_Status* status);
+
+static const upb_FileDef* _upb_DefPool_AddFileEx(
+    upb_DefPool* s, const UPB_DESC(FileDescriptorProto) * file_proto,
+    const upb_MiniTableFile* layout, bool publish, upb_Status* status);
+
+// Returns the full name |prefix|.|name| (or just |name| if |prefix| is NULL),
+// allocated on the lazy file's arena.  Returns NULL on OOM.
+static const char* _upb_DefPool_LazyFullName(upb_DefPoolLazyFile* lf,
+                                             const char* prefix,
+                                             upb_StringView name) {
+  const size_t prefix_size = prefix ? strlen(prefix) + 1 : 0;
+  char* buf = upb_Arena_Malloc(lf->arena, prefix_size + name.size + 1);
+  if (!buf) return NULL;
+  if (prefix) {
+    memcpy(buf, prefix, prefix_size - 1);
+    buf[prefix_size - 1] = '.';
+  }
+  memcpy(buf + prefix_size, name.data, name.size);
+  buf[prefix_size + name.size] = '\0';
+  return buf;
+}
+
+static bool _upb_DefPool_AddLazySym(upb_DefPool* s, upb_DefPoolLazyFile* lf,
+                                    const char* sym, upb_Status* status) {
+  if (!sym) {
+    upb_Status_SetErrorMessage(status, "out of memory");
+    return false;
+  }
+  const size_t size = strlen(sym);
+  if (upb_strtable_lookup2(&s->syms, sym, size, NULL) ||
+      upb_strtable_lookup2(&s->lazy_syms, sym, size, NULL)) {
+    upb_Status_SetErrorFormat(status, "duplicate symbol '%s'", sym);
+    return false;
+  }
+  if (!upb_strtable_insert(&s->lazy_syms, sym, size, upb_value_ptr(lf),
+                           s->arena)) {
+    upb_Status_SetErrorMessage(status, "out of memory");
+    return false;
+  }
+  return true;
+}
+
+// The scan functions below mirror the names that the def builder will insert
+// into the symtab (messages, enums, enum values, extensions and services; see
+// the _upb_DefBuilder_Add() call sites), so that lookups know which pending
+// file to build and duplicate symbols are still caught at registration time.
+
+static bool _upb_DefPool_ScanLazyEnum(upb_DefPool* s, upb_DefPoolLazyFile* lf,
+                                      const char* prefix,
+                                      const UPB_DESC(EnumDescriptorProto) *
+                                          enum_proto,
+                                      upb_Status* status) {
+  const upb_StringView name = UPB_DESC(EnumDescriptorProto_name)(enum_proto);
+  if (!_upb_DefPool_AddLazySym(
+          s, lf, _upb_DefPool_LazyFullName(lf, prefix, name), status)) {
+    return false;
+  }
+
+  // Like C++, enum values are siblings of the enum itself.
+  size_t n;
+  const UPB_DESC(EnumValueDescriptorProto)* const* values =
+      UPB_DESC(EnumDescriptorProto_value)(enum_proto, &n);
+  for (size_t i = 0; i < n; i++) {
+    const upb_StringView vname =
+        UPB_DESC(EnumValueDescriptorProto_name)(values[i]);
+    if (!_upb_DefPool_AddLazySym(
+            s, lf, _upb_DefPool_LazyFullName(lf, prefix, vname), status)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool _upb_DefPool_ScanLazyMessage(upb_DefPool* s,
+                                         upb_DefPoolLazyFile* lf,
+                                         const char* prefix,
+                                         const UPB_DESC(DescriptorProto) *
+                                             msg_proto,
+                                         upb_Status* status) {
+  const upb_StringView name = UPB_DESC(DescriptorProto_name)(msg_proto);
+  const char* full = _upb_DefPool_LazyFullName(lf, prefix, name);
+  if (!_upb_DefPool_AddLazySym(s, lf, full, status)) return false;
+
+  size_t n;
+  const UPB_DESC(EnumDescriptorProto)* const* enums =
+      UPB_DESC(DescriptorProto_enum_type)(msg_proto, &n);
+  for (size_t i = 0; i < n; i++) {
+    if (!_upb_DefPool_ScanLazyEnum(s, lf, full, enums[i], status)) return false;
+  }
+
+  const UPB_DESC(FieldDescriptorProto)* const* exts =
+      UPB_DESC(DescriptorProto_extension)(msg_proto, &n);
+  for (size_t i = 0; i < n; i++) {
+    const upb_StringView ename = UPB_DESC(FieldDescriptorProto_name)(exts[i]);
+    if (!_upb_DefPool_AddLazySym(
+            s, lf, _upb_DefPool_LazyFullName(lf, full, ename), status)) {
+      return false;
+    }
+  }
+
+  const UPB_DESC(DescriptorProto)* const* nested =
+      UPB_DESC(DescriptorProto_nested_type)(msg_proto, &n);
+  for (size_t i = 0; i < n; i++) {
+    if (!_upb_DefPool_ScanLazyMessage(s, lf, full, nested[i], status)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool _upb_DefPool_ScanLazyFile(upb_DefPool* s, upb_DefPoolLazyFile* lf,
+                                      upb_Status* status) {
+  const UPB_DESC(FileDescriptorProto)* fp = lf->file_proto;
+  const char* package = NULL;
+
+  const upb_StringView pkg = UPB_DESC(FileDescriptorProto_package)(fp);
+  if (pkg.size) {
+    package = _upb_DefPool_LazyFullName(lf, NULL, pkg);
+    if (!package) {
+      upb_Status_SetErrorMessage(status, "out of memory");
+      return false;
+    }
+  }
+
+  size_t n;
+  const UPB_DESC(EnumDescriptorProto)* const* enums =
+      UPB_DESC(FileDescriptorProto_enum_type)(fp, &n);
+  for (size_t i = 0; i < n; i++) {
+    if (!_upb_DefPool_ScanLazyEnum(s, lf, package, enums[i], status)) {
+      return false;
+    }
+  }
+
+  const UPB_DESC(FieldDescriptorProto)* const* exts =
+      UPB_DESC(FileDescriptorProto_extension)(fp, &n);
+  for (size_t i = 0; i < n; i++) {
+    const upb_StringView ename = UPB_DESC(FieldDescriptorProto_name)(exts[i]);
+    if (!_upb_DefPool_AddLazySym(
+            s, lf, _upb_DefPool_LazyFullName(lf, package, ename), status)) {
+      return false;
+    }
+  }
+
+  const UPB_DESC(DescriptorProto)* const* msgs =
+      UPB_DESC(FileDescriptorProto_message_type)(fp, &n);
+  for (size_t i = 0; i < n; i++) {
+    if (!_upb_DefPool_ScanLazyMessage(s, lf, package, msgs[i], status)) {
+      return false;
+    }
+  }
+
+  const UPB_DESC(ServiceDescriptorProto)* const* services =
+      UPB_DESC(FileDescriptorProto_service)(fp, &n);
+  for (size_t i = 0; i < n; i++) {
+    const upb_StringView sname =
+        UPB_DESC(ServiceDescriptorProto_name)(services[i]);
+    if (!_upb_DefPool_AddLazySym(
+            s, lf, _upb_DefPool_LazyFullName(lf, package, sname), status)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void _upb_DefPool_RemoveLazyFile(upb_DefPool* s,
+                                        upb_DefPoolLazyFile* lf) {
+  const upb_StringView name =
+      UPB_DESC(FileDescriptorProto_name)(lf->file_proto);
+  upb_strtable_remove2(&s->lazy_files, name.data, name.size, NULL);
+
+  intptr_t iter = UPB_INTTABLE_BEGIN;
+  upb_StringView key;
+  upb_value val;
+  while (upb_strtable_next2(&s->lazy_syms, &key, &val, &iter)) {
+    if (upb_value_getptr(val) == lf) {
+      upb_strtable_removeiter(&s->lazy_syms, &iter);
+    }
+  }
+
+  for (upb_DefPoolLazyFile** p = &s->lazy_head; *p; p = &(*p)->next) {
+    if (*p == lf) {
+      *p = lf->next;
+      break;
+    }
+  }
+}
+
+// Registers |file_proto| without building its defs.  On success, ownership of
+// |arena| (which must own |file_proto|) passes to the pool; the defs are built
+// on the first lookup of one of the file's symbols.
+static bool _upb_DefPool_AddLazyFile(upb_DefPool* s,
+                                     const UPB_DESC(FileDescriptorProto) *
+                                         file_proto,
+                                     const upb_MiniTableFile* layout,
+                                     upb_Arena* arena, upb_Status* status) {
+  const upb_StringView name = UPB_DESC(FileDescriptorProto_name)(file_proto);
+
+  if (upb_strtable_lookup2(&s->files, name.data, name.size, NULL) ||
+      upb_strtable_lookup2(&s->lazy_files, name.data, name.size, NULL)) {
+    upb_Status_SetErrorFormat(status,
+                              "duplicate file name " UPB_STRINGVIEW_FORMAT,
+                              UPB_STRINGVIEW_ARGS(name));
+    return false;
+  }
+
+  upb_DefPoolLazyFile* lf = upb_Arena_Malloc(arena, sizeof(*lf));
+  if (!lf) {
+    upb_Status_SetErrorMessage(status, "out of memory");
+    return false;
+  }
+  lf->file_proto = file_proto;
+  lf->layout = layout;
+  lf->arena = arena;
+  lf->next = NULL;
+
+  if (!_upb_DefPool_ScanLazyFile(s, lf, status)) goto err;
+  if (!upb_strtable_insert(&s->lazy_files, name.data, name.size,
+                           upb_value_ptr(lf), s->arena)) {
+    upb_Status_SetErrorMessage(status, "out of memory");
+    goto err;
+  }
+
+  lf->next = s->lazy_head;
+  s->lazy_head = lf;
+
+  if (!_upb_DefPool_PublishIndex(s)) {
+    upb_Status_SetErrorMessage(status, "out of memory");
+    goto err;
+  }
+  return true;
+
+err:
+  _upb_DefPool_RemoveLazyFile(s, lf);
+  return false;
+}
+
+static void _upb_DefPool_BuildDependency(upb_DefPool* s, const char* name,
+                                         size_t len, upb_Arena* batch_arena);
+
+// Builds a lazily-registered file and (first) its pending dependencies.
+// |batch_arena| owns every descriptor parsed for the closure; the caller
+// publishes one fresh snapshot for the whole batch.
+static const upb_FileDef* _upb_DefPool_BuildLazyFileEx(upb_DefPool* s,
+                                                       upb_DefPoolLazyFile* lf,
+                                                       upb_Arena* batch_arena,
+                                                       upb_Status* status) {
+  // Drop the pending entries first so that the build can claim the same names
+  // (and so that erroneous dependency cycles terminate instead of recursing).
+  _upb_DefPool_RemoveLazyFile(s, lf);
+
+  size_t n;
+  const upb_StringView* deps =
+      UPB_DESC(FileDescriptorProto_dependency)(lf->file_proto, &n);
+  for (size_t i = 0; i < n; i++) {
+    _upb_DefPool_BuildDependency(s, deps[i].data, deps[i].size, batch_arena);
+  }
+
+  const upb_FileDef* file =
+      _upb_DefPool_AddFileEx(s, lf->file_proto, lf->layout, false, status);
+  upb_Arena_Free(lf->arena);
+  return file;
+}
+
+// Parses and builds a file known only by its compiled-in init metadata,
+// along with its whole still-pending dependency closure.  All descriptors
+// are parsed into the shared |batch_arena| and no snapshot is published;
+// the outermost caller does that once for the batch.
+static const upb_FileDef* _upb_DefPool_BuildInitClosure(
+    upb_DefPool* s, const upb_DefPoolPendingInit* pi, upb_Arena* batch_arena,
+    upb_Status* status) {
+  const _upb_DefPool_Init* init = pi->init;
+
+  // Claim the entry first so that dependency cycles (invalid metadata)
+  // terminate instead of recursing.
+  upb_strtable_remove2(&s->lazy_inits, init->filename, strlen(init->filename),
+                       NULL);
+
+  for (_upb_DefPool_Init** deps = init->deps; *deps; deps++) {
+    const char* dep_name = (*deps)->filename;
+    _upb_DefPool_BuildDependency(s, dep_name, strlen(dep_name), batch_arena);
+  }
+
+  UPB_DESC(FileDescriptorProto)* file_proto =
+      UPB_DESC(FileDescriptorProto_parse_ex)(
+          init->descriptor.data, init->descriptor.size, NULL,
+          kUpb_DecodeOption_AliasString, batch_arena);
+  s->bytes_loaded += init->descriptor.size;
+  if (!file_proto) {
+    upb_Status_SetErrorFormat(
+        status,
+        "Failed to parse compiled-in descriptor for file '%s'. This should "
+        "never happen.",
+        init->filename);
+    return NULL;
+  }
+
+  return _upb_DefPool_AddFileEx(s, file_proto, pi->layout, false, status);
+}
+
+// Ensures the named dependency is built, whether it is a lazily-registered
+// file or only a pending init.  Failures (including a dependency that was
+// never registered at all) are left for the dependent file's build to
+// report, as a missing dependency with the file's name.
+static void _upb_DefPool_BuildDependency(upb_DefPool* s, const char* name,
+                                         size_t len, upb_Arena* batch_arena) {
+  if (upb_strtable_lookup2(&s->files, name, len, NULL)) return;
+
+  upb_Status status;
+  upb_Status_Clear(&status);
+  upb_value v;
+  if (upb_strtable_lookup2(&s->lazy_files, name, len, &v)) {
+    _upb_DefPool_BuildLazyFileEx(s, upb_value_getptr(v), batch_arena, &status);
+  } else if (upb_strtable_lookup2(&s->lazy_inits, name, len, &v)) {
+    _upb_DefPool_BuildInitClosure(s, upb_value_getptr(v), batch_arena,
+                                  &status);
+  }
+}
+
+static const upb_FileDef* _upb_DefPool_BuildLazyFile(upb_DefPool* s,
+                                                     upb_DefPoolLazyFile* lf,
+                                                     upb_Status* status) {
+  upb_Arena* batch_arena = upb_Arena_New();
+  const upb_FileDef* file =
+      _upb_DefPool_BuildLazyFileEx(s, lf, batch_arena, status);
+  upb_Arena_Free(batch_arena);
+
+  // Publish a fresh snapshot even after a failed build, which may have
+  // removed partially-added symbols.
+  if (!_upb_DefPool_PublishIndex(s) && file) {
+    upb_Status_SetErrorMessage(status, "out of memory");
+    return NULL;
+  }
+  return file;
+}
+
+// Builds a file that was registered only as a pending init (plus its pending
+// dependency closure, batched).  As with _upb_DefPool_BuildLazyFileByName(),
+// errors go to stderr because lookups have no status to return them through.
+static const upb_FileDef* _upb_DefPool_BuildPendingInitByName(
+    const upb_DefPool* s, const char* name, size_t len) {
+  upb_DefPool* mutable_s = (upb_DefPool*)s;
+  upb_value v;
+  if (!upb_strtable_lookup2(&mutable_s->lazy_inits, name, len, &v)) {
+    return NULL;
+  }
+
+  upb_Status status;
+  upb_Status_Clear(&status);
+  upb_Arena* batch_arena = upb_Arena_New();
+  const upb_FileDef* file = _upb_DefPool_BuildInitClosure(
+      mutable_s, upb_value_getptr(v), batch_arena, &status);
+  upb_Arena_Free(batch_arena);
+
+  if (!_upb_DefPool_PublishIndex(mutable_s) && file) {
+    upb_Status_SetErrorMessage(&status, "out of memory");
+    file = NULL;
+  }
+  if (!file) {
+    fprintf(stderr,
+            "Error building compiled-in descriptor for file '%.*s' (this "
+            "should never happen): %s\n",
+            (int)len, name, upb_Status_ErrorMessage(&status));
+  }
+  return file;
+}
+
+// If |sym| belongs to a pending file, builds that file (making the symbol
+// visible in the symtab) and returns true.  Lookups have no status to report
+// through, so build errors go to stderr, as in _upb_DefPool_LoadDefInitEx();
+// they indicate an invalid lazily-registered descriptor.  The pool is mutated
+// even though the lookup APIs are const, so a lookup that can hit a pending
+// file counts as a write for synchronization purposes (see def_pool.h).
+static bool _upb_DefPool_BuildLazySym(const upb_DefPool* s,
+                                      const upb_DefPool_Index* idx,
+                                      const char* sym, size_t size) {
+  upb_value v;
+  if (!upb_DefPool_IndexFind(idx->lazy_syms, idx->lazy_sym_count, sym, size,
+                             &v)) {
+    return false;
+  }
+
+  upb_Status status;
+  upb_Status_Clear(&status);
+  if (!_upb_DefPool_BuildLazyFile((upb_DefPool*)s, upb_value_getptr(v),
+                                  &status)) {
+    fprintf(stderr, "Error building lazily-loaded file for symbol '%.*s': %s\n",
+            (int)size, sym, upb_Status_ErrorMessage(&status));
+    return false;
+  }
+  return true;
+}
+
 const upb_MessageDef* upb_DefPool_FindMessageByName(const upb_DefPool* s,
                                                     const char* sym) {
   return _upb_DefPool_Unpack(s, sym, strlen(sym), UPB_DEFTYPE_MSG);
@@ -156,26 +782,82 @@ const upb_EnumValueDef* upb_DefPool_FindEnumByNameval(const upb_DefPool* s,
   return _upb_DefPool_Unpack(s, sym, strlen(sym), UPB_DEFTYPE_ENUMVAL);
 }
 
-const upb_FileDef* upb_DefPool_FindFileByName(const upb_DefPool* s,
-                                              const char* name) {
+// As with _upb_DefPool_BuildLazySym(), build errors are reported to stderr
+// because these lookups have no status to return them through.
+static const upb_FileDef* _upb_DefPool_BuildLazyFileByName(
+    const upb_DefPool* s, const upb_DefPool_Index* idx, const char* name,
+    size_t len) {
   upb_value v;
-  return upb_strtable_lookup(&s->files, name, &v) ? upb_value_getconstptr(v)
-                                                  : NULL;
+  if (!upb_DefPool_IndexFind(idx->lazy_files, idx->lazy_file_count, name, len,
+                             &v)) {
+    return NULL;
+  }
+
+  upb_Status status;
+  upb_Status_Clear(&status);
+  const upb_FileDef* file = _upb_DefPool_BuildLazyFile(
+      (upb_DefPool*)s, upb_value_getptr(v), &status);
+  if (!file) {
+    fprintf(stderr, "Error building lazily-loaded file '%.*s': %s\n", (int)len,
+            name, upb_Status_ErrorMessage(&status));
+  }
+  return file;
 }
 
 const upb_FileDef* upb_DefPool_FindFileByNameWithSize(const upb_DefPool* s,
                                                       const char* name,
                                                       size_t len) {
+  const upb_DefPool_Index* idx = _upb_DefPool_GetIndex(s);
+  if (!idx) {
+    return s->base ? upb_DefPool_FindFileByNameWithSize(s->base, name, len)
+                   : NULL;
+  }
+
   upb_value v;
-  return upb_strtable_lookup2(&s->files, name, len, &v)
-             ? upb_value_getconstptr(v)
-             : NULL;
+  if (upb_DefPool_IndexFind(idx->files, idx->file_count, name, len, &v)) {
+    return upb_value_getconstptr(v);
+  }
+  const upb_FileDef* file = _upb_DefPool_BuildLazyFileByName(s, idx, name, len);
+  // The file may be known only as a pending init (a dependency of some
+  // generated file that was itself never loaded).
+  if (!file) file = _upb_DefPool_BuildPendingInitByName(s, name, len);
+  if (!file && s->base) {
+    file = upb_DefPool_FindFileByNameWithSize(s->base, name, len);
+  }
+  return file;
+}
+
+const upb_FileDef* upb_DefPool_FindFileByName(const upb_DefPool* s,
+                                              const char* name) {
+  return upb_DefPool_FindFileByNameWithSize(s, name, strlen(name));
+}
+
+const upb_FileDef* _upb_DefPool_FindFileForBuild(const upb_DefPool* s,
+                                                 const char* name,
+                                                 size_t len) {
+  upb_value v;
+  if (upb_strtable_lookup2(&s->files, name, len, &v)) {
+    return upb_value_getconstptr(v);
+  }
+  return upb_DefPool_FindFileByNameWithSize(s, name, len);
 }
 
 const upb_FieldDef* upb_DefPool_FindExtensionByNameWithSize(
     const upb_DefPool* s, const char* name, size_t size) {
+  const upb_DefPool_Index* idx = _upb_DefPool_GetIndex(s);
   upb_value v;
-  if (!upb_strtable_lookup2(&s->syms, name, size, &v)) return NULL;
+  bool found =
+      idx && upb_DefPool_IndexFind(idx->syms, idx->sym_count, name, size, &v);
+  if (!found && idx && _upb_DefPool_BuildLazySym(s, idx, name, size)) {
+    idx = _upb_DefPool_GetIndex(s);
+    found =
+        idx && upb_DefPool_IndexFind(idx->syms, idx->sym_count, name, size, &v);
+  }
+  if (!found) {
+    return s->base ? upb_DefPool_FindExtensionByNameWithSize(s->base, name,
+                                                             size)
+                   : NULL;
+  }
 
   switch (_upb_DefType_Type(v)) {
     case UPB_DEFTYPE_FIELD:
@@ -212,7 +894,16 @@ const upb_FileDef* upb_DefPool_FindFileContainingSymbol(const upb_DefPool* s,
                                                         const char* name) {
   upb_value v;
   // TODO(haberman): non-extension fields and oneofs.
-  if (upb_strtable_lookup(&s->syms, name, &v)) {
+  const size_t size = strlen(name);
+  const upb_DefPool_Index* idx = _upb_DefPool_GetIndex(s);
+  bool found =
+      idx && upb_DefPool_IndexFind(idx->syms, idx->sym_count, name, size, &v);
+  if (!found && idx && _upb_DefPool_BuildLazySym(s, idx, name, size)) {
+    idx = _upb_DefPool_GetIndex(s);
+    found =
+        idx && upb_DefPool_IndexFind(idx->syms, idx->sym_count, name, size, &v);
+  }
+  if (found) {
     switch (_upb_DefType_Type(v)) {
       case UPB_DEFTYPE_EXT: {
         const upb_FieldDef* f = _upb_DefType_Unpack(v, UPB_DEFTYPE_EXT);
@@ -254,9 +945,139 @@ const upb_FileDef* upb_DefPool_FindFileContainingSymbol(const upb_DefPool* s,
     }
   }
 
+  return s->base ? upb_DefPool_FindFileContainingSymbol(s->base, name) : NULL;
+}
+
+// Compares |name| against the prefix "|package|." (which is never
+// materialized).  Returns 0 if |name| starts with the prefix, otherwise the
+// sign of the lexicographic comparison; used to binary-search for the
+// contiguous run of a package's symbols in a sorted snapshot.
+static int upb_DefPool_PackagePrefixCmp(upb_StringView name,
+                                        const char* package, size_t pkg_len) {
+  const size_t min = UPB_MIN(name.size, pkg_len);
+  const int cmp = min ? memcmp(name.data, package, min) : 0;
+  if (cmp != 0) return cmp;
+  if (name.size <= pkg_len) return -1;  // Shorter than "package.".
+  const unsigned char next = (unsigned char)name.data[pkg_len];
+  if (next != '.') return next < '.' ? -1 : 1;
+  return 0;
+}
+
+// Returns the lower (or, if |upper|, one-past-the-upper) bound of the entries
+// whose names start with "|package|.".  |pkg_len| must be nonzero.
+static size_t upb_DefPool_PackageBound(const upb_DefPool_IndexEntry* entries,
+                                       size_t count, const char* package,
+                                       size_t pkg_len, bool upper) {
+  size_t lo = 0;
+  size_t hi = count;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    const int cmp =
+        upb_DefPool_PackagePrefixCmp(entries[mid].name, package, pkg_len);
+    if (cmp < 0 || (cmp == 0 && upper)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+bool upb_DefPool_OpenPackageScope(const upb_DefPool* s, const char* package,
+                                  upb_DefPool_PackageScope* scope) {
+  const size_t pkg_len = strlen(package);
+
+  // Build any pending files with symbols under this package so that the scope
+  // sees them.  Each build removes its entries from the lazy table and
+  // publishes a fresh snapshot, so the range shrinks until it is empty (even
+  // when a build fails).
+  for (;;) {
+    const upb_DefPool_Index* idx = _upb_DefPool_GetIndex(s);
+    if (!idx || !idx->lazy_sym_count) break;
+    const size_t lo = pkg_len ? upb_DefPool_PackageBound(
+                                    idx->lazy_syms, idx->lazy_sym_count,
+                                    package, pkg_len, false)
+                              : 0;
+    const size_t hi = pkg_len ? upb_DefPool_PackageBound(
+                                    idx->lazy_syms, idx->lazy_sym_count,
+                                    package, pkg_len, true)
+                              : idx->lazy_sym_count;
+    if (lo == hi) break;
+    const upb_StringView sym = idx->lazy_syms[lo].name;
+    _upb_DefPool_BuildLazySym(s, idx, sym.data, sym.size);
+    if (_upb_DefPool_GetIndex(s) == idx) break;  // OOM: no new snapshot.
+  }
+
+  const upb_DefPool_Index* idx = _upb_DefPool_GetIndex(s);
+  if (!idx) {
+    scope->index = NULL;
+    scope->start = scope->count = scope->prefix_len = 0;
+    return false;
+  }
+
+  size_t lo = 0;
+  size_t hi = idx->sym_count;
+  if (pkg_len) {
+    lo = upb_DefPool_PackageBound(idx->syms, idx->sym_count, package, pkg_len,
+                                  false);
+    hi = upb_DefPool_PackageBound(idx->syms, idx->sym_count, package, pkg_len,
+                                  true);
+  }
+
+  scope->index = idx;
+  scope->start = lo;
+  scope->count = hi - lo;
+  scope->prefix_len = pkg_len ? pkg_len + 1 : 0;
+  return hi > lo;
+}
+
+// Looks up |name| relative to the scope's package, comparing only the bytes
+// after the shared "package." prefix.
+static const void* upb_DefPool_PackageScope_Find(
+    const upb_DefPool_PackageScope* scope, const char* name,
+    upb_deftype_t type) {
+  if (!scope->count) return NULL;
+  const upb_DefPool_Index* idx = scope->index;
+  const upb_DefPool_IndexEntry* entries = idx->syms + scope->start;
+  const size_t size = strlen(name);
+  size_t lo = 0;
+  size_t hi = scope->count;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    const upb_StringView full = entries[mid].name;
+    const int cmp =
+        upb_DefPool_NameCmp(name, size, full.data + scope->prefix_len,
+                            full.size - scope->prefix_len);
+    if (cmp == 0) return _upb_DefType_Unpack(entries[mid].value, type);
+    if (cmp < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
   return NULL;
 }
 
+const upb_MessageDef* upb_DefPool_PackageScope_FindMessage(
+    const upb_DefPool_PackageScope* scope, const char* name) {
+  return upb_DefPool_PackageScope_Find(scope, name, UPB_DEFTYPE_MSG);
+}
+
+const upb_EnumDef* upb_DefPool_PackageScope_FindEnum(
+    const upb_DefPool_PackageScope* scope, const char* name) {
+  return upb_DefPool_PackageScope_Find(scope, name, UPB_DEFTYPE_ENUM);
+}
+
+const upb_FieldDef* upb_DefPool_PackageScope_FindExtension(
+    const upb_DefPool_PackageScope* scope, const char* name) {
+  return upb_DefPool_PackageScope_Find(scope, name, UPB_DEFTYPE_EXT);
+}
+
+const upb_ServiceDef* upb_DefPool_PackageScope_FindService(
+    const upb_DefPool_PackageScope* scope, const char* name) {
+  return upb_DefPool_PackageScope_Find(scope, name, UPB_DEFTYPE_SERVICE);
+}
+
 static void remove_filedef(upb_DefPool* s, upb_FileDef* file) {
   intptr_t iter = UPB_INTTABLE_BEGIN;
   upb_StringView key;
@@ -304,6 +1125,8 @@ static const upb_FileDef* upb_DefBuilder_AddFileToPool(
     _upb_FileDef_Create(builder, file_proto);
     upb_strtable_insert(&s->files, name.data, name.size,
                         upb_value_constptr(builder->file), builder->arena);
+    // A pending init entry for the same file (if any) is now stale.
+    upb_strtable_remove2(&s->lazy_inits, name.data, name.size, NULL);
     UPB_ASSERT(upb_Status_IsOk(status));
     upb_Arena_Fuse(s->arena, builder->arena);
   }
@@ -313,15 +1136,16 @@ static const upb_FileDef* upb_DefBuilder_AddFileToPool(
   return builder->file;
 }
 
-static const upb_FileDef* _upb_DefPool_AddFile(
+static const upb_FileDef* _upb_DefPool_AddFileEx(
     upb_DefPool* s, const UPB_DESC(FileDescriptorProto) * file_proto,
-    const upb_MiniTableFile* layout, upb_Status* status) {
+    const upb_MiniTableFile* layout, bool publish, upb_Status* status) {
   const upb_StringView name = UPB_DESC(FileDescriptorProto_name)(file_proto);
 
   // Determine whether we already know about this file.
   {
     upb_value v;
-    if (upb_strtable_lookup2(&s->files, name.data, name.size, &v)) {
+    if (upb_strtable_lookup2(&s->files, name.data, name.size, &v) ||
+        upb_strtable_lookup2(&s->lazy_files, name.data, name.size, &v)) {
       upb_Status_SetErrorFormat(status,
                                 "duplicate file name " UPB_STRINGVIEW_FORMAT,
                                 UPB_STRINGVIEW_ARGS(name));
@@ -342,7 +1166,25 @@ static const upb_FileDef* _upb_DefPool_AddFile(
       .tmp_arena = upb_Arena_New(),
   };
 
-  return upb_DefBuilder_AddFileToPool(&ctx, s, file_proto, name, status);
+  const upb_FileDef* file =
+      upb_DefBuilder_AddFileToPool(&ctx, s, file_proto, name, status);
+
+  // Publish a fresh snapshot even after a failed build, which may have
+  // removed partially-added symbols.  If publishing fails the new file is
+  // invisible to lookups, so report the failure to the caller.  Bulk loads
+  // (upb_DefPool_AddSet()) suppress the per-file publish and publish once at
+  // the end instead.
+  if (publish && !_upb_DefPool_PublishIndex(s) && file) {
+    upb_Status_SetErrorMessage(status, "out of memory");
+    return NULL;
+  }
+  return file;
+}
+
+static const upb_FileDef* _upb_DefPool_AddFile(
+    upb_DefPool* s, const UPB_DESC(FileDescriptorProto) * file_proto,
+    const upb_MiniTableFile* layout, upb_Status* status) {
+  return _upb_DefPool_AddFileEx(s, file_proto, layout, true, status);
 }
 
 const upb_FileDef* upb_DefPool_AddFile(upb_DefPool* s,
@@ -352,26 +1194,242 @@ const upb_FileDef* upb_DefPool_AddFile(upb_DefPool* s,
   return _upb_DefPool_AddFile(s, file_proto, NULL, status);
 }
 
+// The Count functions below mirror the names that the def builder inserts
+// into the symtab (see the Scan functions above), so a bulk load can size the
+// symbol table for its total symbol count up front.
+
+static size_t _upb_DefPool_CountEnumSyms(const UPB_DESC(EnumDescriptorProto) *
+                                         enum_proto) {
+  size_t n;
+  UPB_DESC(EnumDescriptorProto_value)(enum_proto, &n);
+  return 1 + n;  // The enum itself plus its values.
+}
+
+static size_t _upb_DefPool_CountMessageSyms(const UPB_DESC(DescriptorProto) *
+                                            msg_proto) {
+  size_t count = 1;
+  size_t n;
+  const UPB_DESC(EnumDescriptorProto)* const* enums =
+      UPB_DESC(DescriptorProto_enum_type)(msg_proto, &n);
+  for (size_t i = 0; i < n; i++) {
+    count += _upb_DefPool_CountEnumSyms(enums[i]);
+  }
+  UPB_DESC(DescriptorProto_extension)(msg_proto, &n);
+  count += n;
+  const UPB_DESC(DescriptorProto)* const* nested =
+      UPB_DESC(DescriptorProto_nested_type)(msg_proto, &n);
+  for (size_t i = 0; i < n; i++) {
+    count += _upb_DefPool_CountMessageSyms(nested[i]);
+  }
+  return count;
+}
+
+static size_t _upb_DefPool_CountFileSyms(const UPB_DESC(FileDescriptorProto) *
+                                         file_proto) {
+  size_t count = 0;
+  size_t n;
+  const UPB_DESC(EnumDescriptorProto)* const* enums =
+      UPB_DESC(FileDescriptorProto_enum_type)(file_proto, &n);
+  for (size_t i = 0; i < n; i++) {
+    count += _upb_DefPool_CountEnumSyms(enums[i]);
+  }
+  UPB_DESC(FileDescriptorProto_extension)(file_proto, &n);
+  count += n;
+  const UPB_DESC(DescriptorProto)* const* msgs =
+      UPB_DESC(FileDescriptorProto_message_type)(file_proto, &n);
+  for (size_t i = 0; i < n; i++) {
+    count += _upb_DefPool_CountMessageSyms(msgs[i]);
+  }
+  UPB_DESC(FileDescriptorProto_service)(file_proto, &n);
+  count += n;
+  return count;
+}
+
+typedef struct {
+  const UPB_DESC(FileDescriptorProto)* const* files;
+  upb_strtable index;  // file name -> index into |files|.
+  uint8_t* state;      // 0 = unvisited, 1 = visiting, 2 = done/skip.
+  const UPB_DESC(FileDescriptorProto)** order;
+  size_t order_count;
+} upb_DefPool_SetSorter;
+
+static void _upb_DefPool_TopoVisit(upb_DefPool_SetSorter* sorter, size_t i) {
+  if (sorter->state[i]) return;
+  sorter->state[i] = 1;
+
+  size_t n;
+  const upb_StringView* deps =
+      UPB_DESC(FileDescriptorProto_dependency)(sorter->files[i], &n);
+  for (size_t j = 0; j < n; j++) {
+    upb_value v;
+    if (upb_strtable_lookup2(&sorter->index, deps[j].data, deps[j].size, &v)) {
+      // A dependency cycle (invalid input) re-enters a file in state 1; the
+      // visit terminates and the per-file build reports the bad dependency.
+      _upb_DefPool_TopoVisit(sorter, upb_value_getuint64(v));
+    }
+    // Dependencies not present in the set must already be registered in the
+    // pool; if one is not, the per-file build reports it as missing.
+  }
+
+  sorter->state[i] = 2;
+  sorter->order[sorter->order_count++] = sorter->files[i];
+}
+
+bool upb_DefPool_AddSet(upb_DefPool* s, const char* buf, size_t size,
+                        upb_Status* status) {
+  bool ok = false;
+  upb_Arena* arena = upb_Arena_New();
+  if (!arena) {
+    upb_Status_SetErrorMessage(status, "out of memory");
+    return false;
+  }
+
+  const UPB_DESC(FileDescriptorSet)* set =
+      UPB_DESC(FileDescriptorSet_parse)(buf, size, arena);
+  if (!set) {
+    upb_Status_SetErrorMessage(status, "could not parse FileDescriptorSet");
+    goto done;
+  }
+
+  size_t n;
+  const UPB_DESC(FileDescriptorProto)* const* files =
+      UPB_DESC(FileDescriptorSet_file)(set, &n);
+  if (n == 0) {
+    ok = true;
+    goto done;
+  }
+
+  upb_DefPool_SetSorter sorter;
+  sorter.files = files;
+  sorter.order_count = 0;
+  sorter.state = upb_Arena_Malloc(arena, n);
+  sorter.order = upb_Arena_Malloc(arena, n * sizeof(*sorter.order));
+  if (!sorter.state || !sorter.order ||
+      !upb_strtable_init(&sorter.index, n, arena)) {
+    upb_Status_SetErrorMessage(status, "out of memory");
+    goto done;
+  }
+  memset(sorter.state, 0, n);
+
+  // Index the set by file name.  Files already registered in the pool (e.g.
+  // well-known types repeated across schema pushes) and duplicates within the
+  // set are marked done up front so that the visit skips them.
+  size_t total_syms = 0;
+  for (size_t i = 0; i < n; i++) {
+    const upb_StringView name = UPB_DESC(FileDescriptorProto_name)(files[i]);
+    if (upb_strtable_lookup2(&s->files, name.data, name.size, NULL) ||
+        upb_strtable_lookup2(&s->lazy_files, name.data, name.size, NULL) ||
+        upb_strtable_lookup2(&sorter.index, name.data, name.size, NULL)) {
+      sorter.state[i] = 2;
+      continue;
+    }
+    if (!upb_strtable_insert(&sorter.index, name.data, name.size,
+                             upb_value_uint64(i), arena)) {
+      upb_Status_SetErrorMessage(status, "out of memory");
+      goto done;
+    }
+    total_syms += _upb_DefPool_CountFileSyms(files[i]);
+  }
+
+  // Size the symbol table once for the total count, instead of letting it
+  // double repeatedly as the files trickle in (sizing as in
+  // upb_strtable_init()).
+  if (total_syms) {
+    const size_t need =
+        (upb_strtable_count(&s->syms) + total_syms + 1) * 1204 / 1024;
+    const int size_lg2 = upb_Log2Ceiling(need);
+    if (size_lg2 > s->syms.t.size_lg2 &&
+        !upb_strtable_resize(&s->syms, size_lg2, s->arena)) {
+      upb_Status_SetErrorMessage(status, "out of memory");
+      goto done;
+    }
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    _upb_DefPool_TopoVisit(&sorter, i);
+  }
+
+  for (size_t i = 0; i < sorter.order_count; i++) {
+    if (!_upb_DefPool_AddFileEx(s, sorter.order[i], NULL, false, status)) {
+      // Keep lookups consistent with the files that did build.
+      _upb_DefPool_PublishIndex(s);
+      goto done;
+    }
+  }
+  s->bytes_loaded += size;
+
+  if (!_upb_DefPool_PublishIndex(s)) {
+    upb_Status_SetErrorMessage(status, "out of memory");
+    goto done;
+  }
+  ok = true;
+
+done:
+  upb_Arena_Free(arena);
+  return ok;
+}
+
+// Records |init| and its transitive dependencies as pending inits: pointer
+// registrations only, with no descriptor parse and no symbol scan.  Files
+// already known to the pool in any form are skipped, which also prunes the
+// walk (a shared subtree is only ever traversed once).  Returns false on OOM.
+static bool _upb_DefPool_RegisterPendingInit(upb_DefPool* s,
+                                             const _upb_DefPool_Init* init,
+                                             bool rebuild_minitable) {
+  const size_t len = strlen(init->filename);
+  if (upb_strtable_lookup2(&s->files, init->filename, len, NULL) ||
+      upb_strtable_lookup2(&s->lazy_files, init->filename, len, NULL) ||
+      upb_strtable_lookup2(&s->lazy_inits, init->filename, len, NULL)) {
+    return true;
+  }
+
+  upb_DefPoolPendingInit* pi = upb_Arena_Malloc(s->arena, sizeof(*pi));
+  if (!pi) return false;
+  pi->init = init;
+  pi->layout = rebuild_minitable ? NULL : init->layout;
+  if (!upb_strtable_insert(&s->lazy_inits, init->filename, len,
+                           upb_value_ptr(pi), s->arena)) {
+    return false;
+  }
+
+  for (_upb_DefPool_Init** deps = init->deps; *deps; deps++) {
+    if (!_upb_DefPool_RegisterPendingInit(s, *deps, rebuild_minitable)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool _upb_DefPool_LoadDefInitEx(upb_DefPool* s, const _upb_DefPool_Init* init,
                                 bool rebuild_minitable) {
   /* Since this function should never fail (it would indicate a bug in upb) we
    * print errors to stderr instead of returning error status to the user. */
-  _upb_DefPool_Init** deps = init->deps;
   UPB_DESC(FileDescriptorProto) * file;
   upb_Arena* arena;
   upb_Status status;
 
   upb_Status_Clear(&status);
 
-  if (upb_DefPool_FindFileByName(s, init->filename)) {
+  // Note: we must not use upb_DefPool_FindFileByName() here, since that would
+  // force a build of a file that was itself only registered lazily.
+  if (upb_strtable_lookup(&s->files, init->filename, NULL) ||
+      upb_strtable_lookup(&s->lazy_files, init->filename, NULL)) {
     return true;
   }
 
   arena = upb_Arena_New();
 
-  for (; *deps; deps++) {
-    if (!_upb_DefPool_LoadDefInitEx(s, *deps, rebuild_minitable)) goto err;
+  // Dependencies are registered as pending init pointers only; they are not
+  // parsed (let alone built) until some file that needs them is.  This file
+  // itself may have been registered that way earlier, as a dependency of
+  // another file; it is promoted to a full lazy registration below.
+  for (_upb_DefPool_Init** deps = init->deps; *deps; deps++) {
+    if (!_upb_DefPool_RegisterPendingInit(s, *deps, rebuild_minitable)) {
+      upb_Status_SetErrorMessage(&status, "out of memory");
+      goto err;
+    }
   }
+  upb_strtable_remove(&s->lazy_inits, init->filename, NULL);
 
   file = UPB_DESC(FileDescriptorProto_parse_ex)(
       init->descriptor.data, init->descriptor.size, NULL,
@@ -387,12 +1445,15 @@ bool _upb_DefPool_LoadDefInitEx(upb_DefPool* s, const _upb_DefPool_Init* init,
     goto err;
   }
 
+  // Register the file lazily: defs are only built if one of the file's
+  // symbols is ever looked up.  This is safe because the parse above aliased
+  // its strings into the compiled-in descriptor, which is immortal.  On
+  // success, ownership of |arena| passes to the pool.
   const upb_MiniTableFile* mt = rebuild_minitable ? NULL : init->layout;
-  if (!_upb_DefPool_AddFile(s, file, mt, &status)) {
+  if (!_upb_DefPool_AddLazyFile(s, file, mt, arena, &status)) {
     goto err;
   }
 
-  upb_Arena_Free(arena);
   return true;
 
 err:
@@ -412,10 +1473,21 @@ upb_Arena* _upb_DefPool_Arena(const upb_DefPool* s) { return s->arena; }
 
 const upb_FieldDef* upb_DefPool_FindExtensionByMiniTable(
     const upb_DefPool* s, const upb_MiniTableExtension* ext) {
-  upb_value v;
-  bool ok = upb_inttable_lookup(&s->exts, (uintptr_t)ext, &v);
-  UPB_ASSERT(ok);
-  return upb_value_getconstptr(v);
+  const upb_DefPool_Index* idx = _upb_DefPool_GetIndex(s);
+  size_t lo = 0;
+  size_t hi = idx ? idx->ext_count : 0;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (idx->exts[mid].ext == ext) return idx->exts[mid].field;
+    if ((uintptr_t)ext < (uintptr_t)idx->exts[mid].ext) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  if (s->base) return upb_DefPool_FindExtensionByMiniTable(s->base, ext);
+  UPB_ASSERT(false);  // |ext| is not registered in this pool.
+  return NULL;
 }
 
 const upb_FieldDef* upb_DefPool_FindExtensionByNumber(const upb_DefPool* s,
@@ -435,25 +1507,32 @@ const upb_ExtensionRegistry* upb_DefPool_ExtensionRegistry(
 const upb_FieldDef** upb_DefPool_GetAllExtensions(const upb_DefPool* s,
                                                   const upb_MessageDef* m,
                                                   size_t* count) {
+  // A snapshot layer contributes its own extensions on top of the base
+  // pool's.  There is no overlap to dedup: a file re-added in the snapshot
+  // builds new MessageDefs, so its extensions never extend the same
+  // upb_MessageDef as the base's.
+  size_t base_n = 0;
+  const upb_FieldDef** base_exts =
+      s->base ? upb_DefPool_GetAllExtensions(s->base, m, &base_n) : NULL;
+
+  const upb_DefPool_Index* idx = _upb_DefPool_GetIndex(s);
+  const size_t total = idx ? idx->ext_count : 0;
   size_t n = 0;
-  intptr_t iter = UPB_INTTABLE_BEGIN;
-  uintptr_t key;
-  upb_value val;
   // This is O(all exts) instead of O(exts for m).  If we need this to be
   // efficient we may need to make extreg into a two-level table, or have a
   // second per-message index.
-  while (upb_inttable_next(&s->exts, &key, &val, &iter)) {
-    const upb_FieldDef* f = upb_value_getconstptr(val);
-    if (upb_FieldDef_ContainingType(f) == m) n++;
+  for (size_t i = 0; i < total; i++) {
+    if (upb_FieldDef_ContainingType(idx->exts[i].field) == m) n++;
   }
-  const upb_FieldDef** exts = malloc(n * sizeof(*exts));
-  iter = UPB_INTTABLE_BEGIN;
-  size_t i = 0;
-  while (upb_inttable_next(&s->exts, &key, &val, &iter)) {
-    const upb_FieldDef* f = upb_value_getconstptr(val);
-    if (upb_FieldDef_ContainingType(f) == m) exts[i++] = f;
+  const upb_FieldDef** exts = malloc((n + base_n) * sizeof(*exts));
+  size_t out = 0;
+  for (size_t i = 0; i < total; i++) {
+    const upb_FieldDef* f = idx->exts[i].field;
+    if (upb_FieldDef_ContainingType(f) == m) exts[out++] = f;
   }
-  *count = n;
+  if (base_n) memcpy(exts + out, base_exts, base_n * sizeof(*exts));
+  free((void*)base_exts);
+  *count = n + base_n;
   return exts;
 }
 
@@ -46,6 +46,29 @@ void upb_DefPool_Free(upb_DefPool* s);
 
 upb_DefPool* upb_DefPool_New(void);
 
+// Creates a copy-on-write layer over |base|: the snapshot shares every def
+// already in |base| (nothing is copied or rebuilt) and accepts new files of
+// its own with upb_DefPool_AddFile()/upb_DefPool_AddSet().  Lookups resolve
+// in the snapshot first and fall through to |base|, so a file re-added to the
+// snapshot shadows the base's version while files that depend on unchanged
+// base types resolve against them directly; updating a schema costs only the
+// delta instead of rebuilding the whole pool.  Snapshots may be layered.
+//
+// |base| must outlive the snapshot, and defs obtained through the snapshot
+// may point into |base| (e.g. as dependencies).  Adding files to the snapshot
+// does not mutate |base|, with one caveat: a lookup (or dependency) that hits
+// a lazily-registered file in |base| builds that file's defs there, and so
+// counts as a write to |base| for the thread-safety rules below.
+upb_DefPool* upb_DefPool_Snapshot(const upb_DefPool* base);
+
+// Thread safety: the Find*() lookups below resolve against an immutable,
+// atomically-published snapshot of the pool's tables, so they may run
+// lock-free on any number of threads concurrently with one thread adding
+// files.  Multiple threads adding files concurrently must synchronize with
+// each other (but not with readers).  One caveat: a lookup of a symbol from a
+// file that was registered lazily (see _upb_DefPool_LoadDefInit()) builds
+// that file's defs on the spot, and therefore counts as a write.
+
 const upb_MessageDef* upb_DefPool_FindMessageByName(const upb_DefPool* s,
                                                     const char* sym);
 
@@ -92,6 +115,17 @@ const upb_FileDef* upb_DefPool_AddFile(upb_DefPool* s,
                                            file_proto,
                                        upb_Status* status);
 
+// Adds every file in a serialized FileDescriptorSet to the pool.  Files are
+// added in dependency order regardless of their order in the set, the symbol
+// table is sized once for the set's total symbol count, and the lookup
+// snapshot is rebuilt once at the end rather than after every file, so
+// loading a large set is much cheaper than N upb_DefPool_AddFile() calls.
+// Files whose names are already registered in the pool (and duplicates within
+// the set) are skipped.  Returns false and sets |status| if any file fails to
+// build; files added before the failure remain in the pool.
+bool upb_DefPool_AddSet(upb_DefPool* s, const char* buf, size_t size,
+                        upb_Status* status);
+
 const upb_ExtensionRegistry* upb_DefPool_ExtensionRegistry(
     const upb_DefPool* s);
 
@@ -99,6 +133,45 @@ const upb_FieldDef** upb_DefPool_GetAllExtensions(const upb_DefPool* s,
                                                   const upb_MessageDef* m,
                                                   size_t* count);
 
+// A pinned lookup scope for one package.  Opening a scope captures the pool's
+// current snapshot and the contiguous run of the package's symbols within it;
+// lookups through the scope take names relative to the package and compare
+// only the bytes after the shared prefix, so callers resolving many names
+// under one package avoid rebuilding and re-hashing full names.  A scope does
+// not see files added to the pool after it was opened, and a scope opened on
+// a snapshot pool (upb_DefPool_Snapshot()) covers only the snapshot's own
+// layer — open a second scope on the base pool for inherited symbols.  All
+// fields are private.
+typedef struct {
+  const void* index;
+  size_t start;
+  size_t count;
+  size_t prefix_len;
+} upb_DefPool_PackageScope;
+
+// Pins |scope| to |package| ("" scopes the whole pool).  Any lazily-registered
+// files with symbols under the package are built first, so opening a scope
+// counts as a write (see above); lookups through the scope are then pure
+// reads.  Returns false if the package has no symbols (the scope is still
+// valid and all lookups through it will miss).
+bool upb_DefPool_OpenPackageScope(const upb_DefPool* s, const char* package,
+                                  upb_DefPool_PackageScope* scope);
+
+// Looks up |name| relative to the scope's package, so that "C.D" in a scope
+// pinned to "a.b" finds "a.b.C.D".
+
+const upb_MessageDef* upb_DefPool_PackageScope_FindMessage(
+    const upb_DefPool_PackageScope* scope, const char* name);
+
+const upb_EnumDef* upb_DefPool_PackageScope_FindEnum(
+    const upb_DefPool_PackageScope* scope, const char* name);
+
+const upb_FieldDef* upb_DefPool_PackageScope_FindExtension(
+    const upb_DefPool_PackageScope* scope, const char* name);
+
+const upb_ServiceDef* upb_DefPool_PackageScope_FindService(
+    const upb_DefPool_PackageScope* scope, const char* name);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
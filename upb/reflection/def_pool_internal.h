@@ -49,11 +49,31 @@ bool _upb_DefPool_InsertSym(upb_DefPool* s, upb_StringView sym, upb_value v,
 bool _upb_DefPool_LookupSym(const upb_DefPool* s, const char* sym, size_t size,
                             upb_value* v);
 
+// Like upb_DefPool_FindFileByNameWithSize(), but consults the writer-side
+// file table before the published lookup snapshot.  Def builds must use this
+// to resolve dependencies: during a bulk load (upb_DefPool_AddSet()) files
+// are added without republishing the snapshot after each one.
+const upb_FileDef* _upb_DefPool_FindFileForBuild(const upb_DefPool* s,
+                                                 const char* name, size_t len);
+
 void** _upb_DefPool_ScratchData(const upb_DefPool* s);
 size_t* _upb_DefPool_ScratchSize(const upb_DefPool* s);
 void _upb_DefPool_SetPlatform(upb_DefPool* s, upb_MiniTablePlatform platform);
 
-// For generated code only: loads a generated descriptor.
+// For generated code only: loads a generated descriptor.  Registration is
+// lazy: the file's defs (and their MiniTables, when rebuilt at runtime) are
+// only constructed when one of the file's symbols is first looked up, so
+// binaries that link in many descriptors but reflect over few types do not
+// pay the construction cost for the rest.  Dependencies are lazier still:
+// they are recorded as pointers to their init metadata, with their
+// descriptors neither parsed nor scanned, and the whole still-pending
+// dependency closure of a file is built in one batch when the file is.
+// Consequently a dependency's symbols only become visible to Find*ByName()
+// once that file has been loaded with this function itself (the generated
+// getters do this) or built as a dependency; upb_DefPool_FindFileByName()
+// finds (and builds) pending dependencies by file name at any point.  Note
+// that a file's extensions are only visible in
+// upb_DefPool_ExtensionRegistry() once the file is built.
 typedef struct _upb_DefPool_Init {
   struct _upb_DefPool_Init** deps;  // Dependencies of this file.
   const upb_MiniTableFile* layout;
@@ -27,6 +27,7 @@
 
 #include "upb/reflection/def_builder_internal.h"
 #include "upb/reflection/def_pool.h"
+#include "upb/reflection/def_pool_internal.h"
 #include "upb/reflection/enum_def_internal.h"
 #include "upb/reflection/field_def_internal.h"
 #include "upb/reflection/file_def_internal.h"
@@ -61,6 +62,11 @@ struct upb_FileDef {
   int service_count;
   int ext_count;  // All exts in the file.
   upb_Syntax syntax;
+
+  // Serialized FileDescriptorProto, built on demand by
+  // _upb_FileDef_SetCachedProto() (see upb_FileDef_SerializedProto()).
+  const char* cached_proto;
+  size_t cached_proto_size;
 };
 
 const UPB_DESC(FileOptions) * upb_FileDef_Options(const upb_FileDef* f) {
@@ -83,6 +89,24 @@ const char* upb_FileDef_Edition(const upb_FileDef* f) {
 
 const char* _upb_FileDef_RawPackage(const upb_FileDef* f) { return f->package; }
 
+const char* _upb_FileDef_CachedProto(const upb_FileDef* f, size_t* size) {
+  *size = f->cached_proto_size;
+  return f->cached_proto;
+}
+
+bool _upb_FileDef_SetCachedProto(const upb_FileDef* f, const char* data,
+                                 size_t size) {
+  char* copy = upb_Arena_Malloc(_upb_DefPool_Arena(f->symtab), size);
+  if (!copy) return false;
+  memcpy(copy, data, size);
+  // FileDefs are immutable once built; installing the cache is the one
+  // exception, so it counts as a write for synchronization purposes.
+  upb_FileDef* mutable_f = (upb_FileDef*)f;
+  mutable_f->cached_proto = copy;
+  mutable_f->cached_proto_size = size;
+  return true;
+}
+
 upb_Syntax upb_FileDef_Syntax(const upb_FileDef* f) { return f->syntax; }
 
 int upb_FileDef_TopLevelMessageCount(const upb_FileDef* f) {
@@ -199,6 +223,8 @@ void _upb_FileDef_Create(upb_DefBuilder* ctx,
   size_t n;
 
   file->symtab = ctx->symtab;
+  file->cached_proto = NULL;
+  file->cached_proto_size = 0;
 
   // Count all extensions in the file, to build a flat array of layouts.
   UPB_DESC(FileDescriptorProto_extension)(file_proto, &n);
@@ -281,7 +307,7 @@ void _upb_FileDef_Create(upb_DefBuilder* ctx,
   for (size_t i = 0; i < n; i++) {
     upb_StringView str = strs[i];
     file->deps[i] =
-        upb_DefPool_FindFileByNameWithSize(ctx->symtab, str.data, str.size);
+        _upb_DefPool_FindFileForBuild(ctx->symtab, str.data, str.size);
     if (!file->deps[i]) {
       _upb_DefBuilder_Errf(ctx,
                            "Depends on file '" UPB_STRINGVIEW_FORMAT
@@ -45,6 +45,13 @@ const int32_t* _upb_FileDef_WeakDependencyIndexes(const upb_FileDef* f);
 // upb_FileDef_Package() returns "" if f->package is NULL, this does not.
 const char* _upb_FileDef_RawPackage(const upb_FileDef* f);
 
+// Cached serialized FileDescriptorProto, or NULL if none has been installed.
+// The setter copies |data| onto the pool's arena; it is used by
+// upb_FileDef_SerializedProto() to make repeat conversions cheap.
+const char* _upb_FileDef_CachedProto(const upb_FileDef* f, size_t* size);
+bool _upb_FileDef_SetCachedProto(const upb_FileDef* f, const char* data,
+                                 size_t size);
+
 void _upb_FileDef_Create(upb_DefBuilder* ctx,
                          const UPB_DESC(FileDescriptorProto) * file_proto);
 
@@ -68,7 +68,14 @@ upb_MessageValue upb_Message_GetFieldByDef(const upb_Message* msg,
                                            const upb_FieldDef* f) {
   upb_MessageValue default_val = upb_FieldDef_Default(f);
   upb_MessageValue ret;
-  _upb_Message_GetField(msg, upb_FieldDef_MiniTable(f), &default_val, &ret);
+  const upb_MiniTableField* field = upb_FieldDef_MiniTable(f);
+  if (UPB_UNLIKELY(_upb_MiniTableField_IsInlineString(field))) {
+    // The raw slot bytes may be an inline-stored string; decode them instead
+    // of exposing them as a view.
+    ret.str_val = upb_Message_GetString(msg, field, default_val.str_val);
+    return ret;
+  }
+  _upb_Message_GetField(msg, field, &default_val, &ret);
   return ret;
 }
 
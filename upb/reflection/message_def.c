@@ -67,6 +67,10 @@ struct upb_MessageDef {
   const upb_EnumDef* nested_enums;
   const upb_FieldDef* nested_exts;
 
+  // Indexes into |fields|, sorted by layout offset; see
+  // upb_MessageDef_FieldByLayoutOrder().  NULL when field_count == 0.
+  const uint16_t* layout_order;
+
   // TODO(salo): These counters don't need anywhere near 32 bits.
   int field_count;
   int real_oneof_count;
@@ -79,10 +83,11 @@ struct upb_MessageDef {
   int nested_ext_count;
   bool in_message_set;
   bool is_sorted;
+  // Lazily-computed upb_RequiredReach cache; see message_def_internal.h.
+  uint8_t required_reach;
   upb_WellKnown well_known_type;
-#if UINTPTR_MAX == 0xffffffff
-  uint32_t padding;  // Increase size to a multiple of 8.
-#endif
+  // Note: on 32-bit platforms the layout_order pointer above supplies the 4
+  // bytes of explicit padding that used to keep the size a multiple of 8.
 };
 
 static void assign_msg_wellknowntype(upb_MessageDef* m) {
@@ -299,6 +304,12 @@ const upb_FieldDef* upb_MessageDef_Field(const upb_MessageDef* m, int i) {
   return _upb_FieldDef_At(m->fields, i);
 }
 
+const upb_FieldDef* upb_MessageDef_FieldByLayoutOrder(const upb_MessageDef* m,
+                                                      int i) {
+  UPB_ASSERT(0 <= i && i < m->field_count);
+  return _upb_FieldDef_At(m->fields, m->layout_order[i]);
+}
+
 const upb_OneofDef* upb_MessageDef_Oneof(const upb_MessageDef* m, int i) {
   UPB_ASSERT(0 <= i && i < m->oneof_count);
   return _upb_OneofDef_At(m->oneofs, i);
@@ -329,6 +340,17 @@ bool _upb_MessageDef_InMessageSet(const upb_MessageDef* m) {
   return m->in_message_set;
 }
 
+upb_RequiredReach _upb_MessageDef_RequiredReach(const upb_MessageDef* m) {
+  return m->required_reach;
+}
+
+void _upb_MessageDef_SetRequiredReach(const upb_MessageDef* m,
+                                      upb_RequiredReach r) {
+  // Defs are immutable once built; this cache is the one exception, so
+  // installing it counts as a write for synchronization purposes.
+  ((upb_MessageDef*)m)->required_reach = r;
+}
+
 const upb_FieldDef* upb_MessageDef_FindFieldByName(const upb_MessageDef* m,
                                                    const char* name) {
   return upb_MessageDef_FindFieldByNameWithSize(m, name, strlen(name));
@@ -433,6 +455,47 @@ void _upb_MessageDef_InsertField(upb_DefBuilder* ctx, upb_MessageDef* m,
   if (!ok) _upb_DefBuilder_OomErr(ctx);
 }
 
+typedef struct {
+  uint32_t offset;
+  uint32_t number;  // Tie-break: oneof members share a data offset.
+  uint16_t index;
+} upb_MessageDef_LayoutOrderEntry;
+
+static int _upb_MessageDef_LayoutOrderCmp(const void* _a, const void* _b) {
+  const upb_MessageDef_LayoutOrderEntry* a = _a;
+  const upb_MessageDef_LayoutOrderEntry* b = _b;
+  if (a->offset != b->offset) return a->offset < b->offset ? -1 : 1;
+  return a->number < b->number ? -1 : 1;
+}
+
+// Precomputes the offset-sorted field index used by
+// upb_MessageDef_FieldByLayoutOrder().  Must run after |m->layout| is
+// assigned and the fields' layout_index values are filled in.
+static void _upb_MessageDef_MakeLayoutOrder(upb_DefBuilder* ctx,
+                                            upb_MessageDef* m) {
+  if (m->field_count == 0) return;
+
+  upb_MessageDef_LayoutOrderEntry* entries = upb_Arena_Malloc(
+      ctx->tmp_arena, sizeof(*entries) * m->field_count);
+  if (!entries) _upb_DefBuilder_OomErr(ctx);
+
+  for (int i = 0; i < m->field_count; i++) {
+    const upb_FieldDef* f = upb_MessageDef_Field(m, i);
+    entries[i].offset = upb_FieldDef_MiniTable(f)->offset;
+    entries[i].number = upb_FieldDef_Number(f);
+    entries[i].index = (uint16_t)i;
+  }
+  qsort(entries, m->field_count, sizeof(*entries),
+        _upb_MessageDef_LayoutOrderCmp);
+
+  uint16_t* order =
+      _upb_DefBuilder_Alloc(ctx, sizeof(*order) * m->field_count);
+  for (int i = 0; i < m->field_count; i++) {
+    order[i] = entries[i].index;
+  }
+  m->layout_order = order;
+}
+
 void _upb_MessageDef_CreateMiniTable(upb_DefBuilder* ctx, upb_MessageDef* m) {
   if (ctx->layout == NULL) {
     m->layout = _upb_MessageDef_MakeMiniTable(ctx, m);
@@ -446,6 +509,8 @@ void _upb_MessageDef_CreateMiniTable(upb_DefBuilder* ctx, upb_MessageDef* m) {
     _upb_FieldDefs_Sorted(m->fields, m->field_count, ctx->tmp_arena);
   }
 
+  _upb_MessageDef_MakeLayoutOrder(ctx, m);
+
   for (int i = 0; i < m->nested_msg_count; i++) {
     upb_MessageDef* nested =
         (upb_MessageDef*)upb_MessageDef_NestedMessage(m, i);
@@ -635,6 +700,8 @@ static void create_msgdef(upb_DefBuilder* ctx, const char* prefix,
 
   m->containing_type = containing_type;
   m->is_sorted = true;
+  m->required_reach = kUpb_RequiredReach_Unknown;
+  m->layout_order = NULL;  // Filled in by _upb_MessageDef_CreateMiniTable().
 
   name = UPB_DESC(DescriptorProto_name)(msg_proto);
 
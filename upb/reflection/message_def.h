@@ -90,6 +90,17 @@ const upb_ExtensionRange* upb_MessageDef_ExtensionRange(const upb_MessageDef* m,
 int upb_MessageDef_ExtensionRangeCount(const upb_MessageDef* m);
 
 const upb_FieldDef* upb_MessageDef_Field(const upb_MessageDef* m, int i);
+
+// Returns the i-th field in layout order: the message's fields sorted by
+// their offset in the message layout (ties broken by field number, which
+// occur between members of the same oneof).  upb_MessageDef_Field() returns
+// declaration order, which bears no relation to the layout, so a generic
+// walker using it jumps around the message struct; iterating in layout order
+// touches message memory monotonically.  Takes the same range of |i| as
+// upb_MessageDef_Field().
+const upb_FieldDef* upb_MessageDef_FieldByLayoutOrder(const upb_MessageDef* m,
+                                                      int i);
+
 int upb_MessageDef_FieldCount(const upb_MessageDef* m);
 
 const upb_FileDef* upb_MessageDef_File(const upb_MessageDef* m);
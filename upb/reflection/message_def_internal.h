@@ -39,6 +39,21 @@ extern "C" {
 
 upb_MessageDef* _upb_MessageDef_At(const upb_MessageDef* m, int i);
 bool _upb_MessageDef_InMessageSet(const upb_MessageDef* m);
+
+// Lazily-computed cache of whether a message of this type can (transitively
+// through its fields) contain a required field.  Computed and consumed by
+// upb_util_HasUnsetRequired() to prune its walk; Computing marks a node on
+// the in-progress DFS so that type cycles terminate.
+typedef enum {
+  kUpb_RequiredReach_Unknown = 0,
+  kUpb_RequiredReach_Computing = 1,
+  kUpb_RequiredReach_No = 2,
+  kUpb_RequiredReach_Yes = 3,
+} upb_RequiredReach;
+
+upb_RequiredReach _upb_MessageDef_RequiredReach(const upb_MessageDef* m);
+void _upb_MessageDef_SetRequiredReach(const upb_MessageDef* m,
+                                      upb_RequiredReach r);
 bool _upb_MessageDef_Insert(upb_MessageDef* m, const char* name, size_t size,
                             upb_value v, upb_Arena* a);
 void _upb_MessageDef_InsertField(upb_DefBuilder* ctx, upb_MessageDef* m,
@@ -0,0 +1,499 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/text/decode.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "upb/collections/map.h"
+#include "upb/io/string.h"
+#include "upb/io/tokenizer.h"
+#include "upb/port/vsnprintf_compat.h"
+#include "upb/reflection/message.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+typedef struct {
+  upb_Tokenizer* t;
+  const upb_DefPool* symtab;
+  int depth;
+  int options;
+  upb_Status* status;
+  jmp_buf err;
+  upb_Arena* arena;
+  bool peeked;  // The current token was looked at but not yet consumed.
+} txtdec;
+
+UPB_PRINTF(2, 3)
+UPB_NORETURN static void txtdec_errf(txtdec* d, const char* fmt, ...) {
+  char msg[128];
+  va_list argp;
+  va_start(argp, fmt);
+  _upb_vsnprintf(msg, sizeof(msg), fmt, argp);
+  va_end(argp);
+  upb_Status_SetErrorFormat(d->status, "%d:%d: %s",
+                            upb_Tokenizer_Line(d->t) + 1,
+                            upb_Tokenizer_Column(d->t) + 1, msg);
+  UPB_LONGJMP(d->err, 1);
+}
+
+// Advances to the next token.  Returns false on end of input; tokenization
+// errors do not return.
+static bool txtdec_next(txtdec* d) {
+  if (d->peeked) {
+    d->peeked = false;
+    return true;
+  }
+  upb_Status status;
+  upb_Status_Clear(&status);
+  if (upb_Tokenizer_Next(d->t, &status)) return true;
+  if (!upb_Status_IsOk(&status)) {
+    txtdec_errf(d, "%s", upb_Status_ErrorMessage(&status));
+  }
+  return false;
+}
+
+static void txtdec_nexttoken(txtdec* d, const char* where) {
+  if (!txtdec_next(d)) txtdec_errf(d, "Unexpected end of input %s", where);
+}
+
+// Marks the current token as unconsumed; the next txtdec_next() returns it.
+static void txtdec_unget(txtdec* d) { d->peeked = true; }
+
+static bool txtdec_issymbol(txtdec* d, char ch) {
+  return upb_Tokenizer_Type(d->t) == kUpb_TokenType_Symbol &&
+         upb_Tokenizer_TextData(d->t)[0] == ch;
+}
+
+static bool txtdec_isident(txtdec* d, const char* name) {
+  return upb_Tokenizer_Type(d->t) == kUpb_TokenType_Identifier &&
+         strcmp(upb_Tokenizer_TextData(d->t), name) == 0;
+}
+
+// Case-insensitive identifier compare, for "inf"/"NaN" style keywords.
+static bool txtdec_isidentcase(txtdec* d, const char* name) {
+  if (upb_Tokenizer_Type(d->t) != kUpb_TokenType_Identifier) return false;
+  const char* text = upb_Tokenizer_TextData(d->t);
+  while (*name && *text) {
+    if ((*text | 0x20) != (*name | 0x20)) return false;
+    text++;
+    name++;
+  }
+  return *name == *text;
+}
+
+static void txtdec_msgbody(txtdec* d, upb_Message* msg, const upb_MessageDef* m,
+                           char delim);
+
+/* Scalar values **************************************************************/
+
+static uint64_t txtdec_integer(txtdec* d, uint64_t max) {
+  uint64_t val;
+  if (upb_Tokenizer_Type(d->t) != kUpb_TokenType_Integer ||
+      !upb_Parse_Integer(upb_Tokenizer_TextData(d->t), max, &val)) {
+    txtdec_errf(d, "Expected integer, got '%s'", upb_Tokenizer_TextData(d->t));
+  }
+  return val;
+}
+
+static double txtdec_double(txtdec* d, bool neg) {
+  double val;
+  if (upb_Tokenizer_Type(d->t) == kUpb_TokenType_Float) {
+    val = upb_Parse_Float(upb_Tokenizer_TextData(d->t));
+  } else if (upb_Tokenizer_Type(d->t) == kUpb_TokenType_Integer) {
+    uint64_t ival;
+    if (!upb_Parse_Integer(upb_Tokenizer_TextData(d->t), UINT64_MAX, &ival)) {
+      txtdec_errf(d, "Integer out of range: '%s'",
+                  upb_Tokenizer_TextData(d->t));
+    }
+    val = (double)ival;
+  } else if (txtdec_isidentcase(d, "inf") || txtdec_isidentcase(d, "infinity")) {
+    val = INFINITY;
+  } else if (txtdec_isidentcase(d, "nan")) {
+    val = NAN;
+  } else {
+    txtdec_errf(d, "Expected number, got '%s'", upb_Tokenizer_TextData(d->t));
+  }
+  return neg ? -val : val;
+}
+
+static upb_StringView txtdec_string(txtdec* d) {
+  if (upb_Tokenizer_Type(d->t) != kUpb_TokenType_String) {
+    txtdec_errf(d, "Expected string, got '%s'", upb_Tokenizer_TextData(d->t));
+  }
+  upb_StringView ret =
+      upb_Parse_String(upb_Tokenizer_TextData(d->t), d->arena);
+
+  // Adjacent string literals are concatenated, C style.
+  if (txtdec_next(d)) {
+    if (upb_Tokenizer_Type(d->t) != kUpb_TokenType_String) {
+      txtdec_unget(d);
+      return ret;
+    }
+    upb_String str;
+    upb_String_Init(&str, d->arena);
+    upb_String_Append(&str, ret.data, ret.size);
+    do {
+      upb_StringView part =
+          upb_Parse_String(upb_Tokenizer_TextData(d->t), d->arena);
+      upb_String_Append(&str, part.data, part.size);
+      if (!txtdec_next(d)) break;
+      if (upb_Tokenizer_Type(d->t) != kUpb_TokenType_String) {
+        txtdec_unget(d);
+        break;
+      }
+    } while (true);
+    ret = upb_StringView_FromDataAndSize(upb_String_Data(&str),
+                                         upb_String_Size(&str));
+  }
+  return ret;
+}
+
+// Parses one scalar value; the current token is the first token of the value.
+static upb_MessageValue txtdec_scalar(txtdec* d, const upb_FieldDef* f) {
+  upb_MessageValue val;
+  bool neg = false;
+
+  if (txtdec_issymbol(d, '-')) {
+    neg = true;
+    txtdec_nexttoken(d, "after '-'");
+  }
+
+  switch (upb_FieldDef_CType(f)) {
+    case kUpb_CType_Bool:
+      if (txtdec_isident(d, "true") || txtdec_isident(d, "True") ||
+          txtdec_isident(d, "t")) {
+        val.bool_val = true;
+      } else if (txtdec_isident(d, "false") || txtdec_isident(d, "False") ||
+                 txtdec_isident(d, "f")) {
+        val.bool_val = false;
+      } else {
+        val.bool_val = txtdec_integer(d, 1) != 0;
+      }
+      if (neg) txtdec_errf(d, "Invalid '-' before boolean");
+      break;
+    case kUpb_CType_Int32:
+      if (neg) {
+        val.int32_val = (int32_t)-(int64_t)txtdec_integer(d, 2147483648ULL);
+      } else {
+        val.int32_val = (int32_t)txtdec_integer(d, INT32_MAX);
+      }
+      break;
+    case kUpb_CType_Int64:
+      if (neg) {
+        const uint64_t mag = txtdec_integer(d, 9223372036854775808ULL);
+        val.int64_val =
+            mag == 9223372036854775808ULL ? INT64_MIN : -(int64_t)mag;
+      } else {
+        val.int64_val = (int64_t)txtdec_integer(d, INT64_MAX);
+      }
+      break;
+    case kUpb_CType_UInt32:
+      if (neg) txtdec_errf(d, "Negative value for unsigned field");
+      val.uint32_val = (uint32_t)txtdec_integer(d, UINT32_MAX);
+      break;
+    case kUpb_CType_UInt64:
+      if (neg) txtdec_errf(d, "Negative value for unsigned field");
+      val.uint64_val = txtdec_integer(d, UINT64_MAX);
+      break;
+    case kUpb_CType_Float:
+      val.float_val = (float)txtdec_double(d, neg);
+      break;
+    case kUpb_CType_Double:
+      val.double_val = txtdec_double(d, neg);
+      break;
+    case kUpb_CType_Enum:
+      if (upb_Tokenizer_Type(d->t) == kUpb_TokenType_Identifier) {
+        const upb_EnumDef* e = upb_FieldDef_EnumSubDef(f);
+        const upb_EnumValueDef* ev =
+            upb_EnumDef_FindValueByName(e, upb_Tokenizer_TextData(d->t));
+        if (ev) {
+          val.int32_val = upb_EnumValueDef_Number(ev);
+        } else if (d->options & UPB_TXTDEC_IGNOREUNKNOWN) {
+          val.int32_val = 0;
+        } else {
+          txtdec_errf(d, "Unknown enumerator '%s'",
+                      upb_Tokenizer_TextData(d->t));
+        }
+        if (neg) txtdec_errf(d, "Invalid '-' before enumerator");
+      } else if (neg) {
+        val.int32_val = (int32_t)-(int64_t)txtdec_integer(d, 2147483648ULL);
+      } else {
+        val.int32_val = (int32_t)txtdec_integer(d, INT32_MAX);
+      }
+      break;
+    case kUpb_CType_String:
+    case kUpb_CType_Bytes:
+      if (neg) txtdec_errf(d, "Invalid '-' before string");
+      val.str_val = txtdec_string(d);
+      break;
+    default:
+      UPB_UNREACHABLE();
+  }
+  return val;
+}
+
+/* Fields *********************************************************************/
+
+// Returns the closing delimiter for a message value; the current token must
+// be the opening '{' or '<'.
+static char txtdec_openmsg(txtdec* d) {
+  if (txtdec_issymbol(d, '{')) return '}';
+  if (txtdec_issymbol(d, '<')) return '>';
+  txtdec_errf(d, "Expected '{' or '<', got '%s'", upb_Tokenizer_TextData(d->t));
+}
+
+static void txtdec_mapentry(txtdec* d, upb_Message* msg,
+                            const upb_FieldDef* f) {
+  upb_Map* map = upb_Message_Mutable(msg, f, d->arena).map;
+  const upb_MessageDef* entry_m = upb_FieldDef_MessageSubDef(f);
+  const upb_FieldDef* key_f = upb_MessageDef_FindFieldByNumber(entry_m, 1);
+  const upb_FieldDef* val_f = upb_MessageDef_FindFieldByNumber(entry_m, 2);
+  const char delim = txtdec_openmsg(d);
+
+  upb_Message* entry =
+      upb_Message_New(upb_MessageDef_MiniTable(entry_m), d->arena);
+  if (!entry) txtdec_errf(d, "Out of memory");
+  txtdec_msgbody(d, entry, entry_m, delim);
+
+  // Absent message-typed values become empty messages, matching absent
+  // scalar values becoming defaults.
+  if (upb_FieldDef_IsSubMessage(val_f)) {
+    (void)upb_Message_Mutable(entry, val_f, d->arena);
+  }
+  upb_Map_Set(map, upb_Message_GetFieldByDef(entry, key_f),
+              upb_Message_GetFieldByDef(entry, val_f), d->arena);
+}
+
+// Parses one value occurrence for |f|; the current token is the first token
+// of the value.
+static void txtdec_single(txtdec* d, upb_Message* msg, const upb_FieldDef* f,
+                          bool has_colon) {
+  if (upb_FieldDef_IsMap(f)) {
+    txtdec_mapentry(d, msg, f);
+  } else if (upb_FieldDef_IsSubMessage(f)) {
+    const upb_MessageDef* subm = upb_FieldDef_MessageSubDef(f);
+    const char delim = txtdec_openmsg(d);
+    upb_Message* sub;
+    if (upb_FieldDef_IsRepeated(f)) {
+      upb_Array* arr = upb_Message_Mutable(msg, f, d->arena).array;
+      sub = upb_Message_New(upb_MessageDef_MiniTable(subm), d->arena);
+      if (!sub) txtdec_errf(d, "Out of memory");
+      upb_MessageValue elem = {.msg_val = sub};
+      upb_Array_Append(arr, elem, d->arena);
+    } else {
+      sub = upb_Message_Mutable(msg, f, d->arena).msg;
+    }
+    txtdec_msgbody(d, sub, subm, delim);
+  } else {
+    if (!has_colon) {
+      txtdec_errf(d, "Expected ':' for field '%s'", upb_FieldDef_Name(f));
+    }
+    upb_MessageValue val = txtdec_scalar(d, f);
+    if (upb_FieldDef_IsRepeated(f)) {
+      upb_Array* arr = upb_Message_Mutable(msg, f, d->arena).array;
+      upb_Array_Append(arr, val, d->arena);
+    } else {
+      upb_Message_SetFieldByDef(msg, f, val, d->arena);
+    }
+  }
+}
+
+// Skips the value of an unknown field; the current token is the first token
+// of the value, and |has_colon| tells whether a ':' was seen.
+static void txtdec_skipvalue(txtdec* d, bool has_colon) {
+  if (txtdec_issymbol(d, '{') || txtdec_issymbol(d, '<')) {
+    const char delim = txtdec_issymbol(d, '{') ? '}' : '>';
+    for (;;) {
+      txtdec_nexttoken(d, "inside skipped message");
+      if (txtdec_issymbol(d, delim)) return;
+      if (txtdec_issymbol(d, '{') || txtdec_issymbol(d, '<')) {
+        txtdec_skipvalue(d, true);
+      }
+    }
+  }
+  if (!has_colon) txtdec_errf(d, "Expected ':' after unknown field");
+  if (txtdec_issymbol(d, '[')) {
+    for (;;) {
+      txtdec_nexttoken(d, "inside skipped list");
+      if (txtdec_issymbol(d, ']')) return;
+      if (txtdec_issymbol(d, '{') || txtdec_issymbol(d, '<')) {
+        txtdec_skipvalue(d, true);
+      }
+    }
+  }
+  if (txtdec_issymbol(d, '-')) txtdec_nexttoken(d, "after '-'");
+  // A scalar: current token is the whole value, except that adjacent string
+  // literals form one value.
+  if (upb_Tokenizer_Type(d->t) == kUpb_TokenType_String) {
+    while (txtdec_next(d)) {
+      if (upb_Tokenizer_Type(d->t) != kUpb_TokenType_String) {
+        txtdec_unget(d);
+        break;
+      }
+    }
+  }
+}
+
+// Parses one `name: value` / `name { ... }` entry; the current token is the
+// start of the field name.
+static void txtdec_fieldentry(txtdec* d, upb_Message* msg,
+                              const upb_MessageDef* m) {
+  const upb_FieldDef* f = NULL;
+
+  if (txtdec_issymbol(d, '[')) {
+    // Extension field: [full.name].
+    upb_String name;
+    upb_String_Init(&name, d->arena);
+    for (;;) {
+      txtdec_nexttoken(d, "in extension name");
+      if (upb_Tokenizer_Type(d->t) != kUpb_TokenType_Identifier) {
+        txtdec_errf(d, "Expected extension name, got '%s'",
+                    upb_Tokenizer_TextData(d->t));
+      }
+      upb_String_Append(&name, upb_Tokenizer_TextData(d->t),
+                        upb_Tokenizer_TextSize(d->t));
+      txtdec_nexttoken(d, "in extension name");
+      if (txtdec_issymbol(d, ']')) break;
+      if (!txtdec_issymbol(d, '.')) {
+        txtdec_errf(d, "Expected '.' or ']' in extension name");
+      }
+      upb_String_PushBack(&name, '.');
+    }
+    if (d->symtab) {
+      f = upb_DefPool_FindExtensionByName(d->symtab, upb_String_Data(&name));
+    }
+    if (f && upb_FieldDef_ContainingType(f) != m) f = NULL;
+    if (!f && !(d->options & UPB_TXTDEC_IGNOREUNKNOWN)) {
+      txtdec_errf(d, "Unknown extension '%s'", upb_String_Data(&name));
+    }
+  } else if (upb_Tokenizer_Type(d->t) == kUpb_TokenType_Identifier) {
+    f = upb_MessageDef_FindFieldByName(m, upb_Tokenizer_TextData(d->t));
+    if (!f) {
+      // Groups are keyed by their capitalized message name in text format;
+      // the field itself has the lowercased name.
+      char lower[128];
+      const int size = upb_Tokenizer_TextSize(d->t);
+      if (size < (int)sizeof(lower)) {
+        const char* text = upb_Tokenizer_TextData(d->t);
+        for (int i = 0; i < size; i++) lower[i] = text[i] | 0x20;
+        lower[size] = '\0';
+        f = upb_MessageDef_FindFieldByName(m, lower);
+      }
+    }
+    if (!f && !(d->options & UPB_TXTDEC_IGNOREUNKNOWN)) {
+      txtdec_errf(d, "Unknown field '%s'", upb_Tokenizer_TextData(d->t));
+    }
+  } else {
+    txtdec_errf(d, "Expected field name, got '%s'",
+                upb_Tokenizer_TextData(d->t));
+  }
+
+  bool has_colon = false;
+  txtdec_nexttoken(d, "after field name");
+  if (txtdec_issymbol(d, ':')) {
+    has_colon = true;
+    txtdec_nexttoken(d, "after ':'");
+  }
+
+  if (!f) {
+    txtdec_skipvalue(d, has_colon);
+    return;
+  }
+
+  if (has_colon && txtdec_issymbol(d, '[') && upb_FieldDef_IsRepeated(f)) {
+    // List syntax: field: [v, v, v].
+    txtdec_nexttoken(d, "in list");
+    if (txtdec_issymbol(d, ']')) return;
+    for (;;) {
+      txtdec_single(d, msg, f, has_colon);
+      txtdec_nexttoken(d, "in list");
+      if (txtdec_issymbol(d, ']')) return;
+      if (!txtdec_issymbol(d, ',')) {
+        txtdec_errf(d, "Expected ',' or ']' in list");
+      }
+      txtdec_nexttoken(d, "in list");
+    }
+  }
+
+  txtdec_single(d, msg, f, has_colon);
+}
+
+// Parses fields until |delim| (or end of input when |delim| is zero, for the
+// top-level message).
+static void txtdec_msgbody(txtdec* d, upb_Message* msg, const upb_MessageDef* m,
+                           char delim) {
+  if (--d->depth < 0) txtdec_errf(d, "Message too deeply nested");
+  for (;;) {
+    if (!txtdec_next(d)) {
+      if (delim) txtdec_errf(d, "Unexpected end of input inside message");
+      break;
+    }
+    if (delim && txtdec_issymbol(d, delim)) break;
+    // Fields may optionally be separated by ',' or ';'.
+    if (txtdec_issymbol(d, ',') || txtdec_issymbol(d, ';')) continue;
+    txtdec_fieldentry(d, msg, m);
+  }
+  d->depth++;
+}
+
+bool upb_TextDecode(const char* buf, size_t size, upb_Message* msg,
+                    const upb_MessageDef* m, const upb_DefPool* symtab,
+                    int options, upb_Arena* arena, upb_Status* status) {
+  upb_Arena* tok_arena = upb_Arena_New();
+  if (!tok_arena) {
+    if (status) upb_Status_SetErrorMessage(status, "Out of memory");
+    return false;
+  }
+
+  txtdec d;
+  d.symtab = symtab;
+  d.depth = 64;
+  d.options = options;
+  d.status = status;
+  d.arena = arena;
+  d.peeked = false;
+  d.t = upb_Tokenizer_New(buf, size, NULL,
+                          kUpb_TokenizerOption_AllowFAfterFloat |
+                              kUpb_TokenizerOption_CommentStyleShell,
+                          tok_arena);
+
+  bool ok = false;
+  if (!UPB_SETJMP(d.err)) {
+    txtdec_msgbody(&d, msg, m, 0);
+    ok = true;
+  }
+
+  upb_Tokenizer_Fini(d.t);
+  upb_Arena_Free(tok_arena);
+  return ok;
+}
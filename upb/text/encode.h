@@ -29,6 +29,7 @@
 #define UPB_TEXT_ENCODE_H_
 
 #include "upb/reflection/def.h"
+#include "upb/text/options.h"
 
 // Must be last.
 #include "upb/port/def.inc"
@@ -37,17 +38,6 @@
 extern "C" {
 #endif
 
-enum {
-  // When set, prints everything on a single line.
-  UPB_TXTENC_SINGLELINE = 1,
-
-  // When set, unknown fields are not printed.
-  UPB_TXTENC_SKIPUNKNOWN = 2,
-
-  // When set, maps are *not* sorted (this avoids allocating tmp mem).
-  UPB_TXTENC_NOSORT = 4
-};
-
 /* Encodes the given |msg| to text format.  The message's reflection is given in
  * |m|.  The symtab in |symtab| is used to find extensions (if NULL, extensions
  * will not be printed).
@@ -60,6 +50,20 @@ size_t upb_TextEncode(const upb_Message* msg, const upb_MessageDef* m,
                       const upb_DefPool* ext_pool, int options, char* buf,
                       size_t size);
 
+/* Returns a fast upper-bound estimate of upb_TextEncode()'s result for the
+ * same arguments, without formatting or escaping anything: it walks the
+ * message once, charging each value its worst-case printed width (every
+ * string byte as a `\ooo` escape, every integer at full width, and a coarse
+ * per-buffer bound for unknown fields).  Useful for sizing a buffer so the
+ * usual encode-twice dance is skipped.
+ *
+ * The estimate is generous but heuristic -- pathological unknown-field
+ * nesting can exceed it -- so callers must still check the size returned by
+ * upb_TextEncode() as usual. */
+size_t upb_TextEncode_EstimateSize(const upb_Message* msg,
+                                   const upb_MessageDef* m,
+                                   const upb_DefPool* ext_pool, int options);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/text/encode_internal.h"
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "upb/lex/itoa.h"
+#include "upb/port/vsnprintf_compat.h"
+#include "upb/text/options.h"
+#include "upb/wire/reader.h"
+#include "upb/wire/types.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+void _upb_TextEncoder_PutBytes(upb_TextEncoder* e, const void* data,
+                               size_t len) {
+  size_t have = e->end - e->ptr;
+  if (UPB_LIKELY(have >= len)) {
+    memcpy(e->ptr, data, len);
+    e->ptr += len;
+  } else {
+    if (have) {
+      memcpy(e->ptr, data, have);
+      e->ptr += have;
+    }
+    e->overflow += (len - have);
+  }
+}
+
+void _upb_TextEncoder_PutStr(upb_TextEncoder* e, const char* str) {
+  _upb_TextEncoder_PutBytes(e, str, strlen(str));
+}
+
+void _upb_TextEncoder_Printf(upb_TextEncoder* e, const char* fmt, ...) {
+  size_t n;
+  size_t have = e->end - e->ptr;
+  va_list args;
+
+  va_start(args, fmt);
+  n = _upb_vsnprintf(e->ptr, have, fmt, args);
+  va_end(args);
+
+  if (UPB_LIKELY(have > n)) {
+    e->ptr += n;
+  } else {
+    e->ptr = UPB_PTRADD(e->ptr, have);
+    e->overflow += (n - have);
+  }
+}
+
+void _upb_TextEncoder_PutInt(upb_TextEncoder* e, int64_t val) {
+  char buf[kUpb_Int64ToStringBufferSize];
+  _upb_TextEncoder_PutBytes(e, buf, upb_Int64ToString(val, buf));
+}
+
+void _upb_TextEncoder_PutUInt(upb_TextEncoder* e, uint64_t val) {
+  char buf[kUpb_Int64ToStringBufferSize];
+  _upb_TextEncoder_PutBytes(e, buf, upb_UInt64ToString(val, buf));
+}
+
+void _upb_TextEncoder_Indent(upb_TextEncoder* e) {
+  if ((e->options & UPB_TXTENC_SINGLELINE) == 0) {
+    int i = e->indent_depth;
+    while (i-- > 0) {
+      _upb_TextEncoder_PutStr(e, "  ");
+    }
+  }
+}
+
+void _upb_TextEncoder_EndField(upb_TextEncoder* e) {
+  if (e->options & UPB_TXTENC_SINGLELINE) {
+    _upb_TextEncoder_PutStr(e, " ");
+  } else {
+    _upb_TextEncoder_PutStr(e, "\n");
+  }
+}
+
+void _upb_TextEncoder_PutEscapedString(upb_TextEncoder* e, upb_StringView str,
+                                       bool bytes) {
+  const char* ptr = str.data;
+  const char* end = ptr + str.size;
+  _upb_TextEncoder_PutStr(e, "\"");
+
+  while (ptr < end) {
+    switch (*ptr) {
+      case '\n':
+        _upb_TextEncoder_PutStr(e, "\\n");
+        break;
+      case '\r':
+        _upb_TextEncoder_PutStr(e, "\\r");
+        break;
+      case '\t':
+        _upb_TextEncoder_PutStr(e, "\\t");
+        break;
+      case '\"':
+        _upb_TextEncoder_PutStr(e, "\\\"");
+        break;
+      case '\'':
+        _upb_TextEncoder_PutStr(e, "\\'");
+        break;
+      case '\\':
+        _upb_TextEncoder_PutStr(e, "\\\\");
+        break;
+      default:
+        if ((bytes || (uint8_t)*ptr < 0x80) && !isprint(*ptr)) {
+          const uint8_t c = (uint8_t)*ptr;
+          const char esc[4] = {'\\', (char)('0' + (c >> 6)),
+                               (char)('0' + ((c >> 3) & 7)),
+                               (char)('0' + (c & 7))};
+          _upb_TextEncoder_PutBytes(e, esc, sizeof(esc));
+        } else {
+          _upb_TextEncoder_PutBytes(e, ptr, 1);
+        }
+        break;
+    }
+    ptr++;
+  }
+
+  _upb_TextEncoder_PutStr(e, "\"");
+}
+
+#define CHK(x)      \
+  do {              \
+    if (!(x)) {     \
+      return false; \
+    }               \
+  } while (0)
+
+/*
+ * Unknown fields are printed by number.
+ *
+ * 1001: 123
+ * 1002: "hello"
+ * 1006: 0xdeadbeef
+ * 1003: {
+ *   1: 111
+ * }
+ */
+const char* _upb_TextEncoder_PutUnknown(upb_TextEncoder* e, const char* ptr,
+                                        upb_EpsCopyInputStream* stream,
+                                        int groupnum) {
+  // We are guaranteed that the unknown data is valid wire format, and will not
+  // contain tag zero.
+  uint32_t end_group = groupnum > 0
+                           ? ((groupnum << kUpb_WireReader_WireTypeBits) |
+                              kUpb_WireType_EndGroup)
+                           : 0;
+
+  while (!upb_EpsCopyInputStream_IsDone(stream, &ptr)) {
+    uint32_t tag;
+    CHK(ptr = upb_WireReader_ReadTag(ptr, &tag));
+    if (tag == end_group) return ptr;
+
+    _upb_TextEncoder_Indent(e);
+    _upb_TextEncoder_PutUInt(e, upb_WireReader_GetFieldNumber(tag));
+    _upb_TextEncoder_PutStr(e, ": ");
+
+    switch (upb_WireReader_GetWireType(tag)) {
+      case kUpb_WireType_Varint: {
+        uint64_t val;
+        CHK(ptr = upb_WireReader_ReadVarint(ptr, &val));
+        _upb_TextEncoder_PutUInt(e, val);
+        break;
+      }
+      case kUpb_WireType_32Bit: {
+        uint32_t val;
+        ptr = upb_WireReader_ReadFixed32(ptr, &val);
+        _upb_TextEncoder_Printf(e, "0x%08" PRIu32, val);
+        break;
+      }
+      case kUpb_WireType_64Bit: {
+        uint64_t val;
+        ptr = upb_WireReader_ReadFixed64(ptr, &val);
+        _upb_TextEncoder_Printf(e, "0x%016" PRIu64, val);
+        break;
+      }
+      case kUpb_WireType_Delimited: {
+        int size;
+        char* start = e->ptr;
+        size_t start_overflow = e->overflow;
+        CHK(ptr = upb_WireReader_ReadSize(ptr, &size));
+        CHK(upb_EpsCopyInputStream_CheckDataSizeAvailable(stream, ptr, size));
+
+        // Speculatively try to parse as message.
+        _upb_TextEncoder_PutStr(e, "{");
+        _upb_TextEncoder_EndField(e);
+
+        // EpsCopyInputStream can't back up, so create a sub-stream for the
+        // speculative parse.
+        upb_EpsCopyInputStream sub_stream;
+        const char* sub_ptr = upb_EpsCopyInputStream_GetAliasedPtr(stream, ptr);
+        upb_EpsCopyInputStream_Init(&sub_stream, &sub_ptr, size, true);
+
+        e->indent_depth++;
+        if (_upb_TextEncoder_PutUnknown(e, sub_ptr, &sub_stream, -1)) {
+          ptr = upb_EpsCopyInputStream_Skip(stream, ptr, size);
+          e->indent_depth--;
+          _upb_TextEncoder_Indent(e);
+          _upb_TextEncoder_PutStr(e, "}");
+        } else {
+          // Didn't work out, print as raw bytes.
+          e->indent_depth--;
+          e->ptr = start;
+          e->overflow = start_overflow;
+          const char* str = ptr;
+          ptr = upb_EpsCopyInputStream_ReadString(stream, &str, size, NULL);
+          assert(ptr);
+          _upb_TextEncoder_PutEscapedString(
+              e, (upb_StringView){.data = str, .size = size}, true);
+        }
+        break;
+      }
+      case kUpb_WireType_StartGroup:
+        _upb_TextEncoder_PutStr(e, "{");
+        _upb_TextEncoder_EndField(e);
+        e->indent_depth++;
+        CHK(ptr = _upb_TextEncoder_PutUnknown(
+                e, ptr, stream, upb_WireReader_GetFieldNumber(tag)));
+        e->indent_depth--;
+        _upb_TextEncoder_Indent(e);
+        _upb_TextEncoder_PutStr(e, "}");
+        break;
+      default:
+        return NULL;
+    }
+    _upb_TextEncoder_EndField(e);
+  }
+
+  return end_group == 0 && !upb_EpsCopyInputStream_IsError(stream) ? ptr : NULL;
+}
+
+#undef CHK
+
+size_t _upb_TextEncoder_Nullz(upb_TextEncoder* e, size_t size) {
+  size_t ret = e->ptr - e->buf + e->overflow;
+
+  if (size > 0) {
+    if (e->ptr == e->end) e->ptr--;
+    *e->ptr = '\0';
+  }
+
+  return ret;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Output machinery shared by the reflection-based text encoder (encode.c) and
+// the MiniTable-only one (encode_minitable.c): the overflow-counting writer,
+// string escaping, and the wire-format printer for unknown fields.  None of
+// it touches reflection, so encode_minitable.c stays linkable without it.
+
+#ifndef UPB_TEXT_ENCODE_INTERNAL_H_
+#define UPB_TEXT_ENCODE_INTERNAL_H_
+
+#include "upb/base/string_view.h"
+#include "upb/collections/map_sorter_internal.h"
+#include "upb/wire/eps_copy_input_stream.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  char *buf, *ptr, *end;
+  size_t overflow;
+  int indent_depth;
+  int options;
+  const struct upb_DefPool* ext_pool;  // NULL in the MiniTable-only encoder.
+  _upb_mapsorter sorter;
+} upb_TextEncoder;
+
+void _upb_TextEncoder_PutBytes(upb_TextEncoder* e, const void* data,
+                               size_t len);
+void _upb_TextEncoder_PutStr(upb_TextEncoder* e, const char* str);
+void _upb_TextEncoder_Printf(upb_TextEncoder* e, const char* fmt, ...)
+    UPB_PRINTF(2, 3);
+void _upb_TextEncoder_PutInt(upb_TextEncoder* e, int64_t val);
+void _upb_TextEncoder_PutUInt(upb_TextEncoder* e, uint64_t val);
+void _upb_TextEncoder_Indent(upb_TextEncoder* e);
+void _upb_TextEncoder_EndField(upb_TextEncoder* e);
+
+/* Emits |str| quoted, escaping unprintable bytes; |bytes| also escapes
+ * non-ASCII bytes instead of passing them through as UTF-8. */
+void _upb_TextEncoder_PutEscapedString(upb_TextEncoder* e, upb_StringView str,
+                                       bool bytes);
+
+/* Prints a run of wire-format fields by number (see the comment in
+ * encode_internal.c for the output shape).  |groupnum| > 0 terminates at that
+ * group's end tag; -1 prints to the end of the stream.  Returns NULL if the
+ * data is not valid wire format (output may be partially written). */
+const char* _upb_TextEncoder_PutUnknown(upb_TextEncoder* e, const char* ptr,
+                                        upb_EpsCopyInputStream* stream,
+                                        int groupnum);
+
+/* NUL-terminates the output (truncating if needed) and returns the full size
+ * the encoding would have taken, not counting the terminator. */
+size_t _upb_TextEncoder_Nullz(upb_TextEncoder* e, size_t size);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_TEXT_ENCODE_INTERNAL_H_ */
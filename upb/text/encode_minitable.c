@@ -0,0 +1,412 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/text/encode_minitable.h"
+
+#include <string.h>
+
+#include "upb/collections/array_internal.h"
+#include "upb/collections/map.h"
+#include "upb/collections/map_sorter_internal.h"
+#include "upb/lex/round_trip.h"
+#include "upb/message/accessors_internal.h"
+#include "upb/message/extension_internal.h"
+#include "upb/message/tagged_ptr.h"
+#include "upb/mini_table/sub.h"
+#include "upb/text/encode_internal.h"
+#include "upb/wire/eps_copy_input_stream.h"
+#include "upb/wire/types.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+const upb_TextNamesField* upb_TextNames_Find(const upb_TextNames* names,
+                                             uint32_t number) {
+  if (!names) return NULL;
+  size_t lo = 0, hi = names->field_count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (names->fields[mid].number < number) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo < names->field_count && names->fields[lo].number == number
+             ? &names->fields[lo]
+             : NULL;
+}
+
+static void txtmt_msg(upb_TextEncoder* e, const upb_Message* msg,
+                      const upb_MiniTable* m, const upb_TextNames* names);
+
+/* Prints `name` when the sidecar has one, else the bare field number. */
+static void txtmt_fieldname(upb_TextEncoder* e, const upb_TextNamesField* n,
+                            uint32_t number, bool is_ext) {
+  if (is_ext) _upb_TextEncoder_PutStr(e, "[");
+  if (n && n->name) {
+    _upb_TextEncoder_PutStr(e, n->name);
+  } else {
+    _upb_TextEncoder_PutUInt(e, number);
+  }
+  if (is_ext) _upb_TextEncoder_PutStr(e, "]");
+}
+
+/* Prints the value of a non-message field from raw field memory (|from_msg|)
+ * or from a upb_MessageValue-shaped buffer (map entries, where strings are
+ * never stored inline). */
+static void txtmt_scalarvalue(upb_TextEncoder* e, const void* mem,
+                              const upb_MiniTableField* f, bool from_msg) {
+  switch (f->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Bool: {
+      bool b;
+      memcpy(&b, mem, 1);
+      _upb_TextEncoder_PutStr(e, b ? "true" : "false");
+      break;
+    }
+    case kUpb_FieldType_Float: {
+      float fl;
+      char buf[32];
+      memcpy(&fl, mem, 4);
+      _upb_EncodeRoundTripFloat(fl, buf, sizeof(buf));
+      _upb_TextEncoder_PutStr(e, buf);
+      break;
+    }
+    case kUpb_FieldType_Double: {
+      double d;
+      char buf[32];
+      memcpy(&d, mem, 8);
+      _upb_EncodeRoundTripDouble(d, buf, sizeof(buf));
+      _upb_TextEncoder_PutStr(e, buf);
+      break;
+    }
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_SInt32:
+    case kUpb_FieldType_SFixed32:
+    case kUpb_FieldType_Enum: {  // No reflection, so enums print by number.
+      int32_t i32;
+      memcpy(&i32, mem, 4);
+      _upb_TextEncoder_PutInt(e, i32);
+      break;
+    }
+    case kUpb_FieldType_UInt32:
+    case kUpb_FieldType_Fixed32: {
+      uint32_t u32;
+      memcpy(&u32, mem, 4);
+      _upb_TextEncoder_PutUInt(e, u32);
+      break;
+    }
+    case kUpb_FieldType_Int64:
+    case kUpb_FieldType_SInt64:
+    case kUpb_FieldType_SFixed64: {
+      int64_t i64;
+      memcpy(&i64, mem, 8);
+      _upb_TextEncoder_PutInt(e, i64);
+      break;
+    }
+    case kUpb_FieldType_UInt64:
+    case kUpb_FieldType_Fixed64: {
+      uint64_t u64;
+      memcpy(&u64, mem, 8);
+      _upb_TextEncoder_PutUInt(e, u64);
+      break;
+    }
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes: {
+      upb_StringView view;
+      if (from_msg && UPB_UNLIKELY(_upb_MiniTableField_IsInlineString(f)) &&
+          _upb_InlineString_IsInline(mem)) {
+        view = _upb_InlineString_Decode(mem);
+      } else {
+        memcpy(&view, mem, sizeof(view));
+      }
+      _upb_TextEncoder_PutEscapedString(
+          e, view, f->UPB_PRIVATE(descriptortype) == kUpb_FieldType_Bytes);
+      break;
+    }
+    default:
+      UPB_UNREACHABLE();
+  }
+}
+
+static void txtmt_scalarfield(upb_TextEncoder* e, const void* mem,
+                              const upb_MiniTableField* f,
+                              const upb_TextNamesField* n, bool is_ext) {
+  _upb_TextEncoder_Indent(e);
+  txtmt_fieldname(e, n, f->number, is_ext);
+  _upb_TextEncoder_PutStr(e, ": ");
+  txtmt_scalarvalue(e, mem, f, true);
+  _upb_TextEncoder_EndField(e);
+}
+
+static void txtmt_submsg(upb_TextEncoder* e, const upb_Message* msg,
+                         const upb_MiniTable* subm, const upb_TextNamesField* n,
+                         uint32_t number, bool is_ext) {
+  _upb_TextEncoder_Indent(e);
+  txtmt_fieldname(e, n, number, is_ext);
+  _upb_TextEncoder_PutStr(e, " {");
+  _upb_TextEncoder_EndField(e);
+  e->indent_depth++;
+  txtmt_msg(e, msg, subm, n ? n->sub : NULL);
+  e->indent_depth--;
+  _upb_TextEncoder_Indent(e);
+  _upb_TextEncoder_PutStr(e, "}");
+  _upb_TextEncoder_EndField(e);
+}
+
+static size_t txtmt_elemsize(const upb_MiniTableField* f) {
+  switch (f->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Bool:
+      return 1;
+    case kUpb_FieldType_Float:
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_SInt32:
+    case kUpb_FieldType_SFixed32:
+    case kUpb_FieldType_Enum:
+    case kUpb_FieldType_UInt32:
+    case kUpb_FieldType_Fixed32:
+      return 4;
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes:
+      return sizeof(upb_StringView);
+    default:
+      return 8;
+  }
+}
+
+static void txtmt_array(upb_TextEncoder* e, const upb_Array* arr,
+                        const upb_MiniTableSub* subs,
+                        const upb_MiniTableField* f, const upb_TextNamesField* n,
+                        bool is_ext) {
+  const int type = f->UPB_PRIVATE(descriptortype);
+  if (type == kUpb_FieldType_Message || type == kUpb_FieldType_Group) {
+    const upb_TaggedMessagePtr* elems = _upb_array_constptr(arr);
+    const upb_MiniTable* subm = subs[f->UPB_PRIVATE(submsg_index)].submsg;
+    for (size_t i = 0; i < arr->size; i++) {
+      txtmt_submsg(e, _upb_TaggedMessagePtr_GetMessage(elems[i]), subm, n,
+                   f->number, is_ext);
+    }
+  } else {
+    const char* ptr = _upb_array_constptr(arr);
+    const size_t elem_size = txtmt_elemsize(f);
+    for (size_t i = 0; i < arr->size; i++) {
+      _upb_TextEncoder_Indent(e);
+      txtmt_fieldname(e, n, f->number, is_ext);
+      _upb_TextEncoder_PutStr(e, ": ");
+      txtmt_scalarvalue(e, ptr + i * elem_size, f, false);
+      _upb_TextEncoder_EndField(e);
+    }
+  }
+}
+
+static void txtmt_mapentry(upb_TextEncoder* e, upb_MessageValue key,
+                           upb_MessageValue val, const upb_MiniTable* entry,
+                           const upb_MiniTableField* f,
+                           const upb_TextNamesField* n) {
+  const upb_MiniTableField* val_f = &entry->fields[1];
+  _upb_TextEncoder_Indent(e);
+  txtmt_fieldname(e, n, f->number, false);
+  _upb_TextEncoder_PutStr(e, " {");
+  _upb_TextEncoder_EndField(e);
+  e->indent_depth++;
+
+  _upb_TextEncoder_Indent(e);
+  _upb_TextEncoder_PutStr(e, "key: ");
+  txtmt_scalarvalue(e, &key, &entry->fields[0], false);
+  _upb_TextEncoder_EndField(e);
+
+  if (val_f->UPB_PRIVATE(descriptortype) == kUpb_FieldType_Message) {
+    const upb_MiniTable* subm =
+        entry->subs[val_f->UPB_PRIVATE(submsg_index)].submsg;
+    _upb_TextEncoder_Indent(e);
+    _upb_TextEncoder_PutStr(e, "value {");
+    _upb_TextEncoder_EndField(e);
+    e->indent_depth++;
+    txtmt_msg(e, val.msg_val, subm, n ? n->sub : NULL);
+    e->indent_depth--;
+    _upb_TextEncoder_Indent(e);
+    _upb_TextEncoder_PutStr(e, "}");
+    _upb_TextEncoder_EndField(e);
+  } else {
+    _upb_TextEncoder_Indent(e);
+    _upb_TextEncoder_PutStr(e, "value: ");
+    txtmt_scalarvalue(e, &val, val_f, false);
+    _upb_TextEncoder_EndField(e);
+  }
+
+  e->indent_depth--;
+  _upb_TextEncoder_Indent(e);
+  _upb_TextEncoder_PutStr(e, "}");
+  _upb_TextEncoder_EndField(e);
+}
+
+static void txtmt_map(upb_TextEncoder* e, const upb_Map* map,
+                      const upb_MiniTableSub* subs, const upb_MiniTableField* f,
+                      const upb_TextNamesField* n) {
+  const upb_MiniTable* entry = subs[f->UPB_PRIVATE(submsg_index)].submsg;
+  UPB_ASSERT(entry->field_count == 2);
+
+  if (e->options & UPB_TXTENC_NOSORT) {
+    size_t iter = kUpb_Map_Begin;
+    upb_MessageValue key, val;
+    while (upb_Map_Next(map, &key, &val, &iter)) {
+      txtmt_mapentry(e, key, val, entry, f, n);
+    }
+  } else {
+    _upb_sortedmap sorted;
+    upb_MapEntry ent;
+    _upb_mapsorter_pushmap(
+        &e->sorter, entry->fields[0].UPB_PRIVATE(descriptortype), map, &sorted);
+    while (_upb_sortedmap_next(&e->sorter, map, &sorted, &ent)) {
+      upb_MessageValue key, val;
+      memcpy(&key, &ent.data.k, sizeof(key));
+      memcpy(&val, &ent.data.v, sizeof(val));
+      txtmt_mapentry(e, key, val, entry, f, n);
+    }
+    _upb_mapsorter_popmap(&e->sorter, &sorted);
+  }
+}
+
+/* Same presence test the wire encoder applies (encode_shouldencode). */
+static bool txtmt_shouldencode(const upb_Message* msg,
+                               const upb_MiniTableField* f) {
+  if (f->presence == 0) {
+    const void* mem = UPB_PTR_AT(msg, f->offset, void);
+    switch (_upb_MiniTableField_GetRep(f)) {
+      case kUpb_FieldRep_1Byte: {
+        char ch;
+        memcpy(&ch, mem, 1);
+        return ch != 0;
+      }
+      case kUpb_FieldRep_4Byte: {
+        uint32_t u32;
+        memcpy(&u32, mem, 4);
+        return u32 != 0;
+      }
+      case kUpb_FieldRep_8Byte: {
+        uint64_t u64;
+        memcpy(&u64, mem, 8);
+        return u64 != 0;
+      }
+      case kUpb_FieldRep_StringView: {
+        const upb_StringView* str = (const upb_StringView*)mem;
+        return str->size != 0;
+      }
+      default:
+        UPB_UNREACHABLE();
+    }
+  } else if (f->presence > 0) {
+    return _upb_hasbit_field(msg, f);
+  } else {
+    return _upb_getoneofcase_field(msg, f) == f->number;
+  }
+}
+
+static void txtmt_field(upb_TextEncoder* e, const upb_Message* msg,
+                        const upb_MiniTableSub* subs,
+                        const upb_MiniTableField* f, const upb_TextNames* names,
+                        bool is_ext) {
+  const upb_TextNamesField* n = upb_TextNames_Find(names, f->number);
+  const int type = f->UPB_PRIVATE(descriptortype);
+
+  switch (upb_FieldMode_Get(f)) {
+    case kUpb_FieldMode_Array: {
+      const upb_Array* arr = *UPB_PTR_AT(msg, f->offset, upb_Array*);
+      if (arr && arr->size) txtmt_array(e, arr, subs, f, n, is_ext);
+      break;
+    }
+    case kUpb_FieldMode_Map: {
+      const upb_Map* map = *UPB_PTR_AT(msg, f->offset, const upb_Map*);
+      if (map) txtmt_map(e, map, subs, f, n);
+      break;
+    }
+    case kUpb_FieldMode_Scalar:
+      if (type == kUpb_FieldType_Message || type == kUpb_FieldType_Group) {
+        upb_TaggedMessagePtr tagged =
+            *UPB_PTR_AT(msg, f->offset, upb_TaggedMessagePtr);
+        if (tagged != 0) {
+          txtmt_submsg(e, _upb_TaggedMessagePtr_GetMessage(tagged),
+                       subs[f->UPB_PRIVATE(submsg_index)].submsg, n, f->number,
+                       is_ext);
+        }
+      } else {
+        txtmt_scalarfield(e, UPB_PTR_AT(msg, f->offset, void), f, n, is_ext);
+      }
+      break;
+  }
+}
+
+static void txtmt_msg(upb_TextEncoder* e, const upb_Message* msg,
+                      const upb_MiniTable* m, const upb_TextNames* names) {
+  for (uint32_t i = 0; i < m->field_count; i++) {
+    const upb_MiniTableField* f = &m->fields[i];
+    if (!txtmt_shouldencode(msg, f)) continue;
+    txtmt_field(e, msg, m->subs, f, names, false);
+  }
+
+  size_t ext_count;
+  const upb_Message_Extension* ext = _upb_Message_Getexts(msg, &ext_count);
+  for (size_t i = 0; i < ext_count; i++) {
+    // Extension values are stored like a one-field message rooted at the
+    // data union; no sidecar entry exists, so they print as `[N]`.
+    txtmt_field(e, (const upb_Message*)&ext[i].data, &ext[i].ext->sub,
+                &ext[i].ext->field, NULL, true);
+  }
+
+  if ((e->options & UPB_TXTENC_SKIPUNKNOWN) == 0) {
+    size_t size;
+    const char* ptr = upb_Message_GetUnknown(msg, &size);
+    if (size != 0) {
+      char* start = e->ptr;
+      upb_EpsCopyInputStream stream;
+      upb_EpsCopyInputStream_Init(&stream, &ptr, size, true);
+      if (!_upb_TextEncoder_PutUnknown(e, ptr, &stream, -1)) {
+        /* Unknown failed to parse, back up and don't print it at all. */
+        e->ptr = start;
+      }
+    }
+  }
+}
+
+size_t upb_TextEncodeMiniTable(const upb_Message* msg, const upb_MiniTable* l,
+                               const upb_TextNames* names, int options,
+                               char* buf, size_t size) {
+  upb_TextEncoder e;
+
+  e.buf = buf;
+  e.ptr = buf;
+  e.end = UPB_PTRADD(buf, size);
+  e.overflow = 0;
+  e.indent_depth = 0;
+  e.options = options;
+  e.ext_pool = NULL;
+  _upb_mapsorter_init(&e.sorter);
+
+  txtmt_msg(&e, msg, l, names);
+  _upb_mapsorter_destroy(&e.sorter);
+  return _upb_TextEncoder_Nullz(&e, size);
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Text encoding from a upb_MiniTable alone, for binaries that do not link
+// reflection.  Field names come from an optional compact sidecar table
+// (upb_TextNames) that protoc-gen-upb emits as a separate linkable unit when
+// invoked with the `textnames` option; without one (or for numbers missing
+// from it) fields print by number, like unknown fields.  Enum values always
+// print numerically, and extensions print by field number.
+
+#ifndef UPB_TEXT_ENCODE_MINITABLE_H_
+#define UPB_TEXT_ENCODE_MINITABLE_H_
+
+#include "upb/message/message.h"
+#include "upb/mini_table/message.h"
+#include "upb/text/options.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct upb_TextNames upb_TextNames;
+
+typedef struct {
+  uint32_t number;
+  const char* name;
+  // For message and group fields, the sub-message's names; for map fields
+  // with message values, the value message's names.  Otherwise NULL.
+  const upb_TextNames* sub;
+} upb_TextNamesField;
+
+struct upb_TextNames {
+  uint32_t field_count;
+  const upb_TextNamesField* fields;  // Sorted by field number.
+};
+
+/* Encodes |msg| (whose layout is |l|) to text format, like upb_TextEncode()
+ * but driven by the MiniTable instead of reflection.  |names| may be NULL.
+ * The output matches upb_TextEncode() except where names are unavailable:
+ * nameless fields print by number, enums print numerically, and extensions
+ * print as `[N]: value` with their field number.
+ *
+ * Output is placed in the given buffer, and always NULL-terminated.  The
+ * output size (excluding NULL) is returned, so a return value >= |size|
+ * implies truncation (snprintf() semantics). */
+size_t upb_TextEncodeMiniTable(const upb_Message* msg, const upb_MiniTable* l,
+                               const upb_TextNames* names, int options,
+                               char* buf, size_t size);
+
+/* Returns the entry for |number| in |names|, or NULL.  Exposed so generated
+ * code and other tooling can reuse the lookup. */
+const upb_TextNamesField* upb_TextNames_Find(const upb_TextNames* names,
+                                             uint32_t number);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_TEXT_ENCODE_MINITABLE_H_ */
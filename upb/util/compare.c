@@ -29,7 +29,12 @@
 
 #include <stdlib.h>
 
+#include "upb/collections/array_internal.h"
+#include "upb/collections/map_internal.h"
+#include "upb/message/accessors_internal.h"
+#include "upb/message/internal.h"
 #include "upb/upb.h"
+#include "upb/wire/common.h"
 #include "upb/wire/eps_copy_input_stream.h"
 #include "upb/wire/reader.h"
 #include "upb/wire/types.h"
@@ -87,42 +92,37 @@ static void upb_UnknownFields_Grow(upb_UnknownField_Context* ctx,
   *end = *base + new;
 }
 
-// We have to implement our own sort here, since qsort() is not an in-order
-// sort. Here we use merge sort, the simplest in-order sort.
-static void upb_UnknownFields_Merge(upb_UnknownField* arr, size_t start,
-                                    size_t mid, size_t end,
-                                    upb_UnknownField* tmp) {
-  memcpy(tmp, &arr[start], (end - start) * sizeof(*tmp));
-
-  upb_UnknownField* ptr1 = tmp;
-  upb_UnknownField* end1 = &tmp[mid - start];
-  upb_UnknownField* ptr2 = &tmp[mid - start];
-  upb_UnknownField* end2 = &tmp[end - start];
-  upb_UnknownField* out = &arr[start];
-
-  while (ptr1 < end1 && ptr2 < end2) {
-    if (ptr1->tag <= ptr2->tag) {
-      *out++ = *ptr1++;
-    } else {
-      *out++ = *ptr2++;
+// We have to implement our own sort here, since qsort() is not a stable
+// sort and repeated occurrences of the same tag must keep their relative
+// order.  A stable LSD radix sort on the 32-bit tag (four 8-bit counting
+// passes) is linear in the number of fields, which matters for messages
+// carrying thousands of unknown fields from newer writers.
+static void upb_UnknownFields_RadixSort(upb_UnknownField* arr, size_t n,
+                                        upb_UnknownField* tmp) {
+  if (n < 2) return;
+  upb_UnknownField* src = arr;
+  upb_UnknownField* dst = tmp;
+  for (int shift = 0; shift < 32; shift += 8) {
+    size_t counts[256] = {0};
+    for (size_t i = 0; i < n; i++) {
+      counts[(src[i].tag >> shift) & 0xff]++;
     }
+    // If every key has the same byte this pass would be a straight copy.
+    if (counts[(src[0].tag >> shift) & 0xff] == n) continue;
+    size_t pos = 0;
+    for (int b = 0; b < 256; b++) {
+      size_t count = counts[b];
+      counts[b] = pos;
+      pos += count;
+    }
+    for (size_t i = 0; i < n; i++) {
+      dst[counts[(src[i].tag >> shift) & 0xff]++] = src[i];
+    }
+    upb_UnknownField* swap = src;
+    src = dst;
+    dst = swap;
   }
-
-  if (ptr1 < end1) {
-    memcpy(out, ptr1, (end1 - ptr1) * sizeof(*out));
-  } else if (ptr2 < end2) {
-    memcpy(out, ptr1, (end2 - ptr2) * sizeof(*out));
-  }
-}
-
-static void upb_UnknownFields_SortRecursive(upb_UnknownField* arr, size_t start,
-                                            size_t end, upb_UnknownField* tmp) {
-  if (end - start > 1) {
-    size_t mid = start + ((end - start) / 2);
-    upb_UnknownFields_SortRecursive(arr, start, mid, tmp);
-    upb_UnknownFields_SortRecursive(arr, mid, end, tmp);
-    upb_UnknownFields_Merge(arr, start, mid, end, tmp);
-  }
+  if (src != arr) memcpy(arr, src, n * sizeof(*arr));
 }
 
 static void upb_UnknownFields_Sort(upb_UnknownField_Context* ctx,
@@ -132,7 +132,7 @@ static void upb_UnknownFields_Sort(upb_UnknownField_Context* ctx,
     while (ctx->tmp_size < fields->size) ctx->tmp_size *= 2;
     ctx->tmp = realloc(ctx->tmp, ctx->tmp_size * sizeof(*ctx->tmp));
   }
-  upb_UnknownFields_SortRecursive(fields->fields, 0, fields->size, ctx->tmp);
+  upb_UnknownFields_RadixSort(fields->fields, fields->size, ctx->tmp);
 }
 
 static upb_UnknownFields* upb_UnknownFields_DoBuild(
@@ -306,3 +306,290 @@ upb_UnknownCompareResult upb_Message_UnknownFieldsAreEqual(const char* buf1,
 
   return upb_UnknownField_Compare(&ctx, buf1, size1, buf2, size2);
 }
+
+// Equality over the MiniTable layout (see compare.h for semantics).  The
+// entry point seeds the same depth limit the wire format uses; every
+// sub-message hop decrements it.
+
+static bool upb_Message_IsEqualRecursive(const upb_Message* msg1,
+                                         const upb_Message* msg2,
+                                         const upb_MiniTable* m, int depth);
+
+static bool upb_FieldData_IsEqual(const void* data1, const void* data2,
+                                  const upb_MiniTableField* f) {
+  switch (_upb_MiniTableField_GetRep(f)) {
+    case kUpb_FieldRep_1Byte:
+      return memcmp(data1, data2, 1) == 0;
+    case kUpb_FieldRep_4Byte:
+      return memcmp(data1, data2, 4) == 0;
+    case kUpb_FieldRep_8Byte:
+      return memcmp(data1, data2, 8) == 0;
+    case kUpb_FieldRep_StringView: {
+      // Inline-stored small strings pack their bytes into the slot itself,
+      // so equal values may be inline on one side and out-of-line on the
+      // other; decode both slots to views before comparing.
+      upb_StringView sv1, sv2;
+      if (_upb_MiniTableField_IsInlineString(f) &&
+          _upb_InlineString_IsInline(data1)) {
+        sv1 = _upb_InlineString_Decode(data1);
+      } else {
+        sv1 = *(const upb_StringView*)data1;
+      }
+      if (_upb_MiniTableField_IsInlineString(f) &&
+          _upb_InlineString_IsInline(data2)) {
+        sv2 = _upb_InlineString_Decode(data2);
+      } else {
+        sv2 = *(const upb_StringView*)data2;
+      }
+      return sv1.size == sv2.size && memcmp(sv1.data, sv2.data, sv1.size) == 0;
+    }
+  }
+  UPB_UNREACHABLE();
+}
+
+static bool upb_TaggedMessagePtrs_AreEqual(upb_TaggedMessagePtr ptr1,
+                                           upb_TaggedMessagePtr ptr2,
+                                           const upb_MiniTable* sub,
+                                           int depth) {
+  const bool empty1 = upb_TaggedMessagePtr_IsEmpty(ptr1);
+  if (empty1 != upb_TaggedMessagePtr_IsEmpty(ptr2)) return false;
+  if (empty1) {
+    // Unlinked sub-messages carry their contents as unknown bytes; compare
+    // those the same way we compare top-level unknown fields.
+    size_t size1, size2;
+    const char* uf1 = upb_Message_GetUnknown(
+        _upb_TaggedMessagePtr_GetEmptyMessage(ptr1), &size1);
+    const char* uf2 = upb_Message_GetUnknown(
+        _upb_TaggedMessagePtr_GetEmptyMessage(ptr2), &size2);
+    return upb_Message_UnknownFieldsAreEqual(uf1, size1, uf2, size2, depth) ==
+           kUpb_UnknownCompareResult_Equal;
+  }
+  return upb_Message_IsEqualRecursive(
+      upb_TaggedMessagePtr_GetNonEmptyMessage(ptr1),
+      upb_TaggedMessagePtr_GetNonEmptyMessage(ptr2), sub, depth);
+}
+
+static bool upb_Arrays_AreEqual(const upb_Array* arr1, const upb_Array* arr2,
+                                const upb_MiniTableField* f,
+                                const upb_MiniTable* sub, int depth) {
+  const size_t size1 = arr1 ? arr1->size : 0;
+  const size_t size2 = arr2 ? arr2->size : 0;
+  if (size1 != size2) return false;
+  if (size1 == 0) return true;
+
+  switch (upb_MiniTableField_CType(f)) {
+    case kUpb_CType_Message:
+      for (size_t i = 0; i < size1; i++) {
+        if (!upb_TaggedMessagePtrs_AreEqual(
+                upb_Array_Get(arr1, i).tagged_msg_val,
+                upb_Array_Get(arr2, i).tagged_msg_val, sub, depth)) {
+          return false;
+        }
+      }
+      return true;
+    case kUpb_CType_String:
+    case kUpb_CType_Bytes: {
+      const upb_StringView* sv1 = _upb_array_constptr(arr1);
+      const upb_StringView* sv2 = _upb_array_constptr(arr2);
+      for (size_t i = 0; i < size1; i++) {
+        if (sv1[i].size != sv2[i].size ||
+            memcmp(sv1[i].data, sv2[i].data, sv1[i].size) != 0) {
+          return false;
+        }
+      }
+      return true;
+    }
+    default:
+      // Scalar elements are stored flat, so the whole array is one memcmp.
+      return memcmp(_upb_array_constptr(arr1), _upb_array_constptr(arr2),
+                    size1 << _upb_Array_ElementSizeLg2(arr1)) == 0;
+  }
+}
+
+static bool upb_Maps_AreEqual(const upb_Map* map1, const upb_Map* map2,
+                              const upb_MiniTable* entry, int depth) {
+  const size_t size1 = map1 ? _upb_Map_Size(map1) : 0;
+  const size_t size2 = map2 ? _upb_Map_Size(map2) : 0;
+  if (size1 != size2) return false;
+  if (size1 == 0) return true;
+
+  const upb_MiniTableField* val_f = &entry->fields[1];
+  const upb_CType val_type = upb_MiniTableField_CType(val_f);
+  size_t iter = kUpb_Map_Begin;
+  upb_MessageValue key, val1, val2;
+  while (upb_Map_Next(map1, &key, &val1, &iter)) {
+    if (!upb_Map_Get(map2, key, &val2)) return false;
+    switch (val_type) {
+      case kUpb_CType_Message:
+        if (!upb_TaggedMessagePtrs_AreEqual(
+                val1.tagged_msg_val, val2.tagged_msg_val,
+                entry->subs[val_f->UPB_PRIVATE(submsg_index)].submsg, depth)) {
+          return false;
+        }
+        break;
+      case kUpb_CType_String:
+      case kUpb_CType_Bytes:
+        if (val1.str_val.size != val2.str_val.size ||
+            memcmp(val1.str_val.data, val2.str_val.data, val1.str_val.size) !=
+                0) {
+          return false;
+        }
+        break;
+      default:
+        // Only the map's value size is copied out, so compare just that much.
+        if (memcmp(&val1, &val2, map1->val_size) != 0) return false;
+        break;
+    }
+  }
+  return true;
+}
+
+static bool upb_Message_IsEqualRecursive(const upb_Message* msg1,
+                                         const upb_Message* msg2,
+                                         const upb_MiniTable* m, int depth) {
+  if (msg1 == msg2) return true;
+  if (--depth == 0) return false;
+
+  // One-shot compare of the hasbit region.  Differing presence for any field
+  // with explicit presence shows up here without touching the fields.
+  const size_t hasbit_bytes = upb_MiniTable_HasbitBytes(m);
+  if (hasbit_bytes && memcmp(msg1, msg2, hasbit_bytes) != 0) return false;
+
+  const size_t count = m->field_count;
+  for (size_t i = 0; i < count; i++) {
+    const upb_MiniTableField* f = &m->fields[i];
+
+    if (upb_IsRepeatedOrMap(f)) {
+      if (upb_FieldMode_Get(f) == kUpb_FieldMode_Map) {
+        if (!upb_Maps_AreEqual(
+                *UPB_PTR_AT(msg1, f->offset, const upb_Map*),
+                *UPB_PTR_AT(msg2, f->offset, const upb_Map*),
+                m->subs[f->UPB_PRIVATE(submsg_index)].submsg, depth)) {
+          return false;
+        }
+      } else {
+        const upb_MiniTable* sub =
+            upb_MiniTableField_CType(f) == kUpb_CType_Message
+                ? upb_MiniTable_GetSubMessageTable(m, f)
+                : NULL;
+        if (!upb_Arrays_AreEqual(*UPB_PTR_AT(msg1, f->offset, const upb_Array*),
+                                 *UPB_PTR_AT(msg2, f->offset, const upb_Array*),
+                                 f, sub, depth)) {
+          return false;
+        }
+      }
+      continue;
+    }
+
+    if (f->presence > 0) {
+      // The hasbit regions already compared equal; skip fields both messages
+      // have unset (their payloads may hold stale bytes).
+      if (!_upb_hasbit_field(msg1, f)) continue;
+    } else if (_upb_MiniTableField_InOneOf(f)) {
+      const uint32_t oneof_case = _upb_getoneofcase_field(msg1, f);
+      if (oneof_case != _upb_getoneofcase_field(msg2, f)) return false;
+      if (oneof_case != f->number) continue;
+    }
+    // Implicit-presence fields fall through and compare their (possibly
+    // zero) payloads directly.
+
+    if (upb_MiniTableField_CType(f) == kUpb_CType_Message) {
+      const upb_TaggedMessagePtr ptr1 =
+          *UPB_PTR_AT(msg1, f->offset, const upb_TaggedMessagePtr);
+      const upb_TaggedMessagePtr ptr2 =
+          *UPB_PTR_AT(msg2, f->offset, const upb_TaggedMessagePtr);
+      if (ptr1 == 0 || ptr2 == 0) {
+        if (ptr1 != ptr2) return false;
+      } else if (!upb_TaggedMessagePtrs_AreEqual(
+                     ptr1, ptr2, upb_MiniTable_GetSubMessageTable(m, f),
+                     depth)) {
+        return false;
+      }
+    } else if (!upb_FieldData_IsEqual(UPB_PTR_AT(msg1, f->offset, const void),
+                                      UPB_PTR_AT(msg2, f->offset, const void),
+                                      f)) {
+      return false;
+    }
+  }
+
+  // Both extension arrays are sorted by the same key, so equal extension sets
+  // line up pairwise.
+  size_t ext_count1, ext_count2;
+  const upb_Message_Extension* ext1 = _upb_Message_Getexts(msg1, &ext_count1);
+  const upb_Message_Extension* ext2 = _upb_Message_Getexts(msg2, &ext_count2);
+  if (ext_count1 != ext_count2) return false;
+  for (size_t i = 0; i < ext_count1; i++) {
+    if (ext1[i].ext != ext2[i].ext) return false;
+    const upb_MiniTableField* f = &ext1[i].ext->field;
+    if (upb_IsRepeatedOrMap(f)) {
+      if (!upb_Arrays_AreEqual(ext1[i].data.ptr, ext2[i].data.ptr, f,
+                               ext1[i].ext->sub.submsg, depth)) {
+        return false;
+      }
+    } else if (upb_MiniTableField_CType(f) == kUpb_CType_Message) {
+      // Promoted extensions always hold linked messages, so no tag bits.
+      if (!upb_Message_IsEqualRecursive(ext1[i].data.ptr, ext2[i].data.ptr,
+                                        ext1[i].ext->sub.submsg, depth)) {
+        return false;
+      }
+    } else if (!upb_FieldData_IsEqual(&ext1[i].data, &ext2[i].data, f)) {
+      return false;
+    }
+  }
+
+  size_t unknown_size1, unknown_size2;
+  const char* uf1 = upb_Message_GetUnknown(msg1, &unknown_size1);
+  const char* uf2 = upb_Message_GetUnknown(msg2, &unknown_size2);
+  return upb_Message_UnknownFieldsAreEqual(uf1, unknown_size1, uf2,
+                                           unknown_size2, depth) ==
+         kUpb_UnknownCompareResult_Equal;
+}
+
+bool upb_Message_IsEqual(const upb_Message* msg1, const upb_Message* msg2,
+                         const upb_MiniTable* m) {
+  return upb_Message_IsEqualRecursive(msg1, msg2, m,
+                                      kUpb_WireFormat_DefaultDepthLimit);
+}
+
+bool upb_Message_FieldIsEqual(const upb_Message* msg1, const upb_Message* msg2,
+                              const upb_MiniTable* m,
+                              const upb_MiniTableField* f) {
+  const int depth = kUpb_WireFormat_DefaultDepthLimit;
+
+  if (upb_IsRepeatedOrMap(f)) {
+    if (upb_FieldMode_Get(f) == kUpb_FieldMode_Map) {
+      return upb_Maps_AreEqual(*UPB_PTR_AT(msg1, f->offset, const upb_Map*),
+                               *UPB_PTR_AT(msg2, f->offset, const upb_Map*),
+                               m->subs[f->UPB_PRIVATE(submsg_index)].submsg,
+                               depth);
+    }
+    const upb_MiniTable* sub = upb_MiniTableField_CType(f) == kUpb_CType_Message
+                                   ? upb_MiniTable_GetSubMessageTable(m, f)
+                                   : NULL;
+    return upb_Arrays_AreEqual(*UPB_PTR_AT(msg1, f->offset, const upb_Array*),
+                               *UPB_PTR_AT(msg2, f->offset, const upb_Array*),
+                               f, sub, depth);
+  }
+
+  if (f->presence > 0) {
+    const bool has1 = _upb_hasbit_field(msg1, f);
+    if (has1 != _upb_hasbit_field(msg2, f)) return false;
+    if (!has1) return true;  // Both unset; payloads may hold stale bytes.
+  } else if (_upb_MiniTableField_InOneOf(f)) {
+    const uint32_t oneof_case = _upb_getoneofcase_field(msg1, f);
+    if (oneof_case != _upb_getoneofcase_field(msg2, f)) return false;
+    if (oneof_case != f->number) return true;
+  }
+
+  if (upb_MiniTableField_CType(f) == kUpb_CType_Message) {
+    const upb_TaggedMessagePtr ptr1 =
+        *UPB_PTR_AT(msg1, f->offset, const upb_TaggedMessagePtr);
+    const upb_TaggedMessagePtr ptr2 =
+        *UPB_PTR_AT(msg2, f->offset, const upb_TaggedMessagePtr);
+    if (ptr1 == 0 || ptr2 == 0) return ptr1 == ptr2;
+    return upb_TaggedMessagePtrs_AreEqual(
+        ptr1, ptr2, upb_MiniTable_GetSubMessageTable(m, f), depth);
+  }
+  return upb_FieldData_IsEqual(UPB_PTR_AT(msg1, f->offset, const void),
+                               UPB_PTR_AT(msg2, f->offset, const void), f);
+}
@@ -30,6 +30,9 @@
 
 #include <stddef.h>
 
+#include "upb/message/message.h"
+#include "upb/mini_table/message.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -59,6 +62,31 @@ upb_UnknownCompareResult upb_Message_UnknownFieldsAreEqual(const char* buf1,
                                                            size_t size2,
                                                            int max_depth);
 
+// Returns true if `msg1` and `msg2` (which must both have layout `m`) have the
+// same set of present fields and equal values for them, plus equal extensions
+// and unknown fields.  Unlike upb_Message_IsExactlyEqual() this does not
+// serialize either message: it compares the hasbit region and scalar payloads
+// with memcmp against the layout and recurses only for strings, arrays, maps,
+// and sub-messages, which is much cheaper for mostly-scalar messages.
+//
+// Values are compared bitwise, so NaN == NaN and -0.0 != 0.0 (the same
+// results upb_Message_IsExactlyEqual() gives for those values).  Unknown
+// fields are compared with upb_Message_UnknownFieldsAreEqual() and share its
+// caveats; an unlinked ("empty") sub-message compares equal only to another
+// unlinked sub-message with equal unknown bytes.  Returns false if the
+// comparison runs out of memory or exceeds the depth limit.
+bool upb_Message_IsEqual(const upb_Message* msg1, const upb_Message* msg2,
+                         const upb_MiniTable* m);
+
+// Like upb_Message_IsEqual(), but compares only the single (non-extension)
+// field `f`, which must belong to layout `m`.  Presence must match for the
+// field to compare equal; two absent fields are equal regardless of any stale
+// payload bytes.  Used by the diff engine in util/diff.h, where per-field
+// granularity is needed.
+bool upb_Message_FieldIsEqual(const upb_Message* msg1, const upb_Message* msg2,
+                              const upb_MiniTable* m,
+                              const upb_MiniTableField* f);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -659,8 +659,53 @@ google_protobuf_FileDescriptorProto* upb_ToProto_ConvertFileDef(
   return filedef_toproto(ctx, f);
 }
 
+const char* upb_FileDef_SerializedProto(const upb_FileDef* f, size_t* size) {
+  const char* bytes = _upb_FileDef_CachedProto(f, size);
+  if (bytes) return bytes;
+
+  // First request: build the proto once and cache its serialized form on the
+  // FileDef (it is immutable after load, so the bytes never go stale).
+  upb_Arena* tmp = upb_Arena_New();
+  if (!tmp) return NULL;
+  upb_ToProto_Context ctx = {tmp};
+  google_protobuf_FileDescriptorProto* proto = upb_ToProto_ConvertFileDef(&ctx, f);
+  char* buf = NULL;
+  size_t len = 0;
+  if (proto) {
+    buf = google_protobuf_FileDescriptorProto_serialize(proto, tmp, &len);
+  }
+  const bool ok = buf && _upb_FileDef_SetCachedProto(f, buf, len);
+  upb_Arena_Free(tmp);
+  return ok ? _upb_FileDef_CachedProto(f, size) : NULL;
+}
+
+const char* upb_FileDef_ToProtoSerialized(const upb_FileDef* f, upb_Arena* a,
+                                          size_t* size) {
+  size_t len;
+  const char* bytes = upb_FileDef_SerializedProto(f, &len);
+  if (bytes) {
+    char* copy = upb_Arena_Malloc(a, len);
+    if (!copy) return NULL;
+    memcpy(copy, bytes, len);
+    *size = len;
+    return copy;
+  }
+  // Could not build the cache (OOM); convert and serialize directly on the
+  // caller's arena.
+  upb_ToProto_Context ctx = {a};
+  google_protobuf_FileDescriptorProto* proto = upb_ToProto_ConvertFileDef(&ctx, f);
+  if (!proto) return NULL;
+  return google_protobuf_FileDescriptorProto_serialize(proto, a, size);
+}
+
 google_protobuf_FileDescriptorProto* upb_FileDef_ToProto(const upb_FileDef* f,
                                                 upb_Arena* a) {
+  size_t size;
+  const char* bytes = upb_FileDef_SerializedProto(f, &size);
+  if (bytes) {
+    return google_protobuf_FileDescriptorProto_parse(bytes, size, a);
+  }
+  // Could not build the cache (OOM); fall back to a direct conversion.
   upb_ToProto_Context ctx = {a};
   return upb_ToProto_ConvertFileDef(&ctx, f);
 }
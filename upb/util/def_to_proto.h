@@ -50,6 +50,23 @@ google_protobuf_OneofDescriptorProto* upb_OneofDef_ToProto(
     const upb_OneofDef* o, upb_Arena* a);
 google_protobuf_FileDescriptorProto* upb_FileDef_ToProto(const upb_FileDef* f,
                                                          upb_Arena* a);
+
+// Returns the serialized form of `f`'s FileDescriptorProto, or NULL if memory
+// allocation failed.  The bytes are built once on the first request, cached on
+// the FileDef, and remain valid for the life of the pool; servers that hand
+// out descriptors repeatedly can copy them directly instead of re-converting
+// the defs on every request.
+const char* upb_FileDef_SerializedProto(const upb_FileDef* f, size_t* size);
+
+// Returns a copy, allocated in `a`, of the serialized form of `f`'s
+// FileDescriptorProto, writing its length to `*size`; NULL if memory
+// allocation failed.  For callers that only serve the bytes this skips
+// materializing a google_protobuf_FileDescriptorProto graph per call:
+// after the first request the cached bytes are memcpy'd straight into the
+// caller's arena.  The copy outlives the pool, unlike
+// upb_FileDef_SerializedProto()'s return value.
+const char* upb_FileDef_ToProtoSerialized(const upb_FileDef* f, upb_Arena* a,
+                                          size_t* size);
 google_protobuf_MethodDescriptorProto* upb_MethodDef_ToProto(
     const upb_MethodDef* m, upb_Arena* a);
 google_protobuf_ServiceDescriptorProto* upb_ServiceDef_ToProto(
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/util/diff.h"
+
+#include <string.h>
+
+#include "upb/collections/array_internal.h"
+#include "upb/collections/map_internal.h"
+#include "upb/message/accessors.h"
+#include "upb/util/compare.h"
+#include "upb/wire/decode.h"
+#include "upb/wire/encode.h"
+// Must be last.
+#include "upb/port/def.inc"
+
+static size_t upb_Diff_VarintSize(uint64_t val) {
+  size_t n = 1;
+  while (val >= 0x80) {
+    n++;
+    val >>= 7;
+  }
+  return n;
+}
+
+static char* upb_Diff_WriteVarint(char* ptr, uint64_t val) {
+  while (val >= 0x80) {
+    *ptr++ = (char)(0x80 | (val & 0x7f));
+    val >>= 7;
+  }
+  *ptr++ = (char)val;
+  return ptr;
+}
+
+// Returns NULL if the varint is truncated or longer than ten bytes.
+static const char* upb_Diff_ReadVarint(const char* ptr, const char* end,
+                                       uint64_t* val) {
+  uint64_t out = 0;
+  for (int shift = 0; shift < 70 && ptr < end; shift += 7) {
+    const uint8_t byte = (uint8_t)*ptr++;
+    out |= (uint64_t)(byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      *val = out;
+      return ptr;
+    }
+  }
+  return NULL;
+}
+
+// Returns true if the field holds no data in `msg`: unset for explicit
+// presence, zero/empty for implicit presence, empty for repeated/map.  A
+// clear is enough to reproduce such a field on the far side.
+static bool upb_Diff_FieldIsEmpty(const upb_Message* msg,
+                                  const upb_MiniTableField* f) {
+  if (upb_IsRepeatedOrMap(f)) {
+    if (upb_FieldMode_Get(f) == kUpb_FieldMode_Map) {
+      const upb_Map* map = *UPB_PTR_AT(msg, f->offset, const upb_Map*);
+      return !map || _upb_Map_Size(map) == 0;
+    }
+    const upb_Array* arr = *UPB_PTR_AT(msg, f->offset, const upb_Array*);
+    return !arr || arr->size == 0;
+  }
+  if (upb_MiniTableField_HasPresence(f)) {
+    return !_upb_Message_HasNonExtensionField(msg, f);
+  }
+  upb_MessageValue val;
+  memset(&val, 0, sizeof(val));
+  _upb_Message_GetField(msg, f, &val, &val);
+  return !_upb_MiniTable_ValueIsNonZero(&val, f);
+}
+
+bool upb_Message_Diff(const upb_Message* old_msg, const upb_Message* new_msg,
+                      const upb_MiniTable* m, upb_Arena* arena, char** buf,
+                      size_t* size) {
+  // Changed fields are shallow-copied into a scratch message and serialized
+  // with the stock encoder, so the "set" bytes are plain wire format.
+  upb_Message* scratch = upb_Message_New(m, arena);
+  if (!scratch) return false;
+
+  uint32_t* clears = NULL;
+  if (m->field_count) {
+    clears = upb_Arena_Malloc(arena, m->field_count * sizeof(*clears));
+    if (!clears) return false;
+  }
+  size_t clear_count = 0;
+  bool any_set = false;
+
+  for (size_t i = 0; i < m->field_count; i++) {
+    const upb_MiniTableField* f = &m->fields[i];
+    if (upb_Message_FieldIsEqual(old_msg, new_msg, m, f)) continue;
+
+    if (upb_Diff_FieldIsEmpty(new_msg, f)) {
+      // A merge cannot remove data, so absent/zeroed fields ride the clear
+      // list instead of the set bytes.
+      clears[clear_count++] = f->number;
+      continue;
+    }
+
+    // Repeated, map, and sub-message fields merge by appending, so a changed
+    // field with a stale counterpart must be cleared before the merge to get
+    // whole-field-replace semantics.  Scalars and strings just overwrite.
+    if ((upb_IsRepeatedOrMap(f) ||
+         upb_MiniTableField_CType(f) == kUpb_CType_Message) &&
+        !upb_Diff_FieldIsEmpty(old_msg, f)) {
+      clears[clear_count++] = f->number;
+    }
+
+    upb_MessageValue val;
+    memset(&val, 0, sizeof(val));
+    _upb_Message_GetField(new_msg, f, &val, &val);
+    _upb_Message_SetField(scratch, f, &val, arena);
+    any_set = true;
+  }
+
+  char* set_buf = NULL;
+  size_t set_size = 0;
+  if (any_set &&
+      upb_Encode(scratch, m, 0, arena, &set_buf, &set_size) !=
+          kUpb_EncodeStatus_Ok) {
+    return false;
+  }
+
+  size_t header_size = upb_Diff_VarintSize(clear_count);
+  for (size_t i = 0; i < clear_count; i++) {
+    header_size += upb_Diff_VarintSize(clears[i]);
+  }
+  char* out = upb_Arena_Malloc(arena, header_size + set_size);
+  if (!out) return false;
+  char* ptr = upb_Diff_WriteVarint(out, clear_count);
+  for (size_t i = 0; i < clear_count; i++) {
+    ptr = upb_Diff_WriteVarint(ptr, clears[i]);
+  }
+  UPB_ASSERT(ptr == out + header_size);
+  if (set_size) memcpy(ptr, set_buf, set_size);
+
+  *buf = out;
+  *size = header_size + set_size;
+  return true;
+}
+
+bool upb_Message_ApplyPatch(upb_Message* msg, const upb_MiniTable* m,
+                            const char* buf, size_t size, upb_Arena* arena) {
+  const char* ptr = buf;
+  const char* end = buf + size;
+
+  uint64_t clear_count;
+  ptr = upb_Diff_ReadVarint(ptr, end, &clear_count);
+  if (!ptr) return false;
+  for (uint64_t i = 0; i < clear_count; i++) {
+    uint64_t number;
+    ptr = upb_Diff_ReadVarint(ptr, end, &number);
+    if (!ptr || number == 0 || number > UINT32_MAX) return false;
+    const upb_MiniTableField* f =
+        upb_MiniTable_FindFieldByNumber(m, (uint32_t)number);
+    if (f) upb_Message_ClearField(msg, f);
+  }
+
+  // Clears always land before the merge, so a patch that both clears and
+  // re-ships a field replaces it rather than appending.
+  return upb_Decode(ptr, end - ptr, msg, m, NULL, 0, arena) ==
+         kUpb_DecodeStatus_Ok;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Field-level message diffs.
+//
+// upb_Message_Diff() compares two messages with the same layout and emits a
+// compact patch covering only the fields that differ, so replicas of a
+// large, mostly-stable message can be kept in sync by shipping a few bytes
+// per update instead of re-serializing the whole message.
+//
+// Patch wire format:
+//
+//   varint  clear_count
+//   varint  field_number   (x clear_count)
+//   bytes   standard wire-format encoding of the changed fields
+//
+// The trailing bytes are ordinary protobuf, so the "set" half of a patch
+// costs exactly what those fields cost in a full serialization.  The clear
+// list exists because a wire-format merge cannot remove data: it carries
+// fields that became absent (or zero, for implicit presence), plus changed
+// repeated/map/sub-message fields, which must be cleared first so the merge
+// replaces them instead of appending to the stale value.
+//
+// Granularity is whole top-level fields: a one-element change to a repeated
+// field re-ships the field.  Extensions and unknown fields are not diffed;
+// both messages should be fully reflected in the layout `m`.
+
+#ifndef UPB_UTIL_DIFF_H_
+#define UPB_UTIL_DIFF_H_
+
+#include "upb/mem/arena.h"
+#include "upb/message/message.h"
+#include "upb/mini_table/message.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Computes a patch that transforms `old_msg` into `new_msg` (both with layout
+// `m`).  On success returns true and stores an arena-allocated patch in
+// `*buf`/`*size`; equal messages yield a valid one-byte patch.  Returns false
+// on allocation failure or if encoding the changed fields fails.
+bool upb_Message_Diff(const upb_Message* old_msg, const upb_Message* new_msg,
+                      const upb_MiniTable* m, upb_Arena* arena, char** buf,
+                      size_t* size);
+
+// Applies a patch produced by upb_Message_Diff() to `msg`, which should hold
+// the same contents as the `old_msg` the patch was computed from.  Clear
+// entries whose field numbers are not in `m` are skipped, so patches from a
+// newer schema degrade the same way unknown fields do on parse.  Returns
+// false on a malformed patch or allocation failure; `msg` may be partially
+// updated in that case.
+bool upb_Message_ApplyPatch(upb_Message* msg, const upb_MiniTable* m,
+                            const char* buf, size_t size, upb_Arena* arena);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* UPB_UTIL_DIFF_H_ */
@@ -31,8 +31,11 @@
 #include <stdarg.h>
 
 #include "upb/collections/map.h"
+#include "upb/mini_table/internal/message.h"
 #include "upb/port/vsnprintf_compat.h"
 #include "upb/reflection/message.h"
+#include "upb/reflection/message_def_internal.h"
+#include "upb/wire/swap_internal.h"
 
 // Must be last.
 #include "upb/port/def.inc"
@@ -200,9 +203,87 @@ static void upb_FindContext_Pop(upb_FindContext* ctx) {
   ctx->stack.size--;
 }
 
+// Computes whether a message of type |m| can possibly contain a required
+// field, directly or through any reachable sub-message, caching the result on
+// the MessageDef (required-ness is static, so the cache never goes stale;
+// installing it counts as a write for synchronization purposes).  A node that
+// only closes a cycle back onto an in-progress ancestor cannot cache a "no"
+// safely, so it is left Unknown and resolved by a later query.
+static upb_RequiredReach upb_util_RequiredReach(const upb_MessageDef* m) {
+  switch (_upb_MessageDef_RequiredReach(m)) {
+    case kUpb_RequiredReach_Yes:
+      return kUpb_RequiredReach_Yes;
+    case kUpb_RequiredReach_No:
+      return kUpb_RequiredReach_No;
+    case kUpb_RequiredReach_Computing:
+      return kUpb_RequiredReach_Computing;  // Cycle; see caller.
+    case kUpb_RequiredReach_Unknown:
+      break;
+  }
+
+  _upb_MessageDef_SetRequiredReach(m, kUpb_RequiredReach_Computing);
+
+  // Messages with extension ranges may carry arbitrary sub-messages, so the
+  // walk can never skip them.
+  bool yes = upb_MessageDef_ExtensionRangeCount(m) > 0;
+  bool in_cycle = false;
+  for (int i = 0, n = upb_MessageDef_FieldCount(m); !yes && i < n; i++) {
+    const upb_FieldDef* f = upb_MessageDef_Field(m, i);
+    if (upb_FieldDef_Label(f) == kUpb_Label_Required) {
+      yes = true;
+    } else if (upb_FieldDef_IsSubMessage(f)) {
+      switch (upb_util_RequiredReach(upb_FieldDef_MessageSubDef(f))) {
+        case kUpb_RequiredReach_Yes:
+          yes = true;
+          break;
+        case kUpb_RequiredReach_Computing:
+          in_cycle = true;
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+  const upb_RequiredReach result = yes         ? kUpb_RequiredReach_Yes
+                                   : in_cycle  ? kUpb_RequiredReach_Unknown
+                                               : kUpb_RequiredReach_No;
+  _upb_MessageDef_SetRequiredReach(m, result);
+  return result;
+}
+
+static bool upb_util_CanReachRequired(const upb_MessageDef* m) {
+  const upb_RequiredReach r = upb_util_RequiredReach(m);
+  if (r == kUpb_RequiredReach_Unknown) {
+    // No DFS was in progress when we were called, so the only cycles ran
+    // through |m| itself: its entire component was explored without finding a
+    // required field, which makes "no" definitive for |m|.
+    _upb_MessageDef_SetRequiredReach(m, kUpb_RequiredReach_No);
+    return false;
+  }
+  return r == kUpb_RequiredReach_Yes;
+}
+
 static void upb_util_FindUnsetInMessage(upb_FindContext* ctx,
                                         const upb_Message* msg,
                                         const upb_MessageDef* m) {
+  // Required fields occupy the lowest hasbits, so the common "any missing?"
+  // query is a single mask test (mirroring the encoder's
+  // kUpb_EncodeOption_CheckRequired check); the reflective walk below only
+  // runs to name the missing fields.
+  const upb_MiniTable* l = upb_MessageDef_MiniTable(m);
+  if (l) {
+    if (!l->required_count) return;
+    if (msg) {
+      uint64_t msg_head;
+      memcpy(&msg_head, msg, 8);
+      msg_head = _upb_BigEndian_Swap64(msg_head);
+      if ((upb_MiniTable_requiredmask(l) & ~msg_head) == 0) return;
+    }
+    ctx->has_unset_required = true;
+    if (!ctx->save_paths) return;
+  }
+
   // Iterate over all fields to see if any required fields are missing.
   for (int i = 0, n = upb_MessageDef_FieldCount(m); i < n; i++) {
     const upb_FieldDef* f = upb_MessageDef_Field(m, i);
@@ -233,9 +314,12 @@ static void upb_util_FindUnsetInMessage(upb_FindContext* ctx,
 static void upb_util_FindUnsetRequiredInternal(upb_FindContext* ctx,
                                                const upb_Message* msg,
                                                const upb_MessageDef* m) {
-  // OPT: add markers in the schema for where we can avoid iterating:
-  // 1. messages with no required fields.
-  // 2. messages that cannot possibly reach any required fields.
+  // Once the yes/no answer is known there is nothing more to learn.
+  if (ctx->has_unset_required && !ctx->save_paths) return;
+
+  // Skip subtrees whose message types cannot possibly reach a required field;
+  // they contribute neither an answer nor any paths.
+  if (!upb_util_CanReachRequired(m)) return;
 
   upb_util_FindUnsetInMessage(ctx, msg, m);
   if (!msg) return;
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/wire/canonicalize.h"
+
+#include <string.h>
+
+#include "upb/base/descriptor_constants.h"
+#include "upb/message/message.h"
+#include "upb/mini_table/internal/message.h"
+#include "upb/wire/common.h"
+#include "upb/wire/decode_internal.h"
+#include "upb/wire/encode.h"
+#include "upb/wire/types.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+/* Canonical-form scanner *****************************************************
+ *
+ * A single wire-to-wire pass that answers: would a deterministic re-encode of
+ * this buffer reproduce it byte for byte?  It must never return true for a
+ * buffer the round trip would change (or reject), so anything it cannot
+ * cheaply prove canonical -- unknown fields, maps, groups, closed enums,
+ * oneof duplicates past a small tracking window -- just returns false and
+ * falls back to the decode + encode path. */
+
+// The wire type a canonical encoding uses for each descriptor type.
+static const int8_t kUpb_Canon_WireTypes[] = {
+    [kUpb_FieldType_Double] = kUpb_WireType_64Bit,
+    [kUpb_FieldType_Float] = kUpb_WireType_32Bit,
+    [kUpb_FieldType_Int64] = kUpb_WireType_Varint,
+    [kUpb_FieldType_UInt64] = kUpb_WireType_Varint,
+    [kUpb_FieldType_Int32] = kUpb_WireType_Varint,
+    [kUpb_FieldType_Fixed64] = kUpb_WireType_64Bit,
+    [kUpb_FieldType_Fixed32] = kUpb_WireType_32Bit,
+    [kUpb_FieldType_Bool] = kUpb_WireType_Varint,
+    [kUpb_FieldType_String] = kUpb_WireType_Delimited,
+    [kUpb_FieldType_Group] = kUpb_WireType_StartGroup,
+    [kUpb_FieldType_Message] = kUpb_WireType_Delimited,
+    [kUpb_FieldType_Bytes] = kUpb_WireType_Delimited,
+    [kUpb_FieldType_UInt32] = kUpb_WireType_Varint,
+    [kUpb_FieldType_Enum] = kUpb_WireType_Varint,
+    [kUpb_FieldType_SFixed32] = kUpb_WireType_32Bit,
+    [kUpb_FieldType_SFixed64] = kUpb_WireType_64Bit,
+    [kUpb_FieldType_SInt32] = kUpb_WireType_Varint,
+    [kUpb_FieldType_SInt64] = kUpb_WireType_Varint,
+};
+
+// Reads a varint with bounds checking, returning NULL if it is malformed or
+// not the minimal encoding of its value (a shorter encoding exists, or bits
+// beyond 64 are set that the decoder would discard).
+static const char* upb_CanonScan_Varint(const char* ptr, const char* end,
+                                        uint64_t* val) {
+  uint64_t out = 0;
+  for (int i = 0; i < 10 && ptr + i < end; i++) {
+    uint8_t byte = (uint8_t)ptr[i];
+    out |= (uint64_t)(byte & 0x7f) << (i * 7);
+    if (!(byte & 0x80)) {
+      if (i > 0 && (byte & 0x7f) == 0) return NULL;  // Trailing zero byte.
+      if (i == 9 && byte > 1) return NULL;           // Bits beyond 64.
+      *val = out;
+      return ptr + i + 1;
+    }
+  }
+  return NULL;
+}
+
+// Returns true if re-encoding |val| through this field's in-memory
+// representation reproduces the same varint (no truncation on the way in).
+static bool upb_CanonScan_VarintRoundTrips(const upb_MiniTableField* f,
+                                           uint64_t val) {
+  switch (f->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Bool:
+      return val <= 1;
+    case kUpb_FieldType_Int32:
+      return val == (uint64_t)(int64_t)(int32_t)val;
+    case kUpb_FieldType_UInt32:
+    case kUpb_FieldType_SInt32:
+      return val <= UINT32_MAX;
+    default:
+      return true;
+  }
+}
+
+// True for fields with implicit (proto3) presence, whose default value is
+// never re-emitted by the encoder.
+static bool upb_CanonScan_HasImplicitPresence(const upb_MiniTableField* f,
+                                              upb_FieldMode mode) {
+  return mode == kUpb_FieldMode_Scalar && f->presence == 0;
+}
+
+static bool upb_CanonScan_Message(const char* ptr, const char* end,
+                                  const upb_MiniTable* l, int depth) {
+  uint32_t prev_number = 0;
+  uint32_t seen_oneofs[16];
+  size_t seen_oneof_count = 0;
+
+  if (--depth < 0) return false;
+
+  while (ptr < end) {
+    uint64_t tag;
+    ptr = upb_CanonScan_Varint(ptr, end, &tag);
+    if (!ptr || tag > UINT32_MAX) return false;
+    uint32_t field_number = (uint32_t)(tag >> 3);
+    int wire_type = (int)(tag & 7);
+    if (field_number == 0) return false;
+
+    const upb_MiniTableField* f =
+        upb_MiniTable_FindFieldByNumber(l, field_number);
+    if (!f) return false;  // Unknown field or extension.
+
+    upb_FieldMode mode = upb_FieldMode_Get(f);
+    if (mode == kUpb_FieldMode_Map) return false;
+    if (f->UPB_PRIVATE(descriptortype) == kUpb_FieldType_Enum) {
+      return false;  // Unrecognized closed-enum values detour into unknowns.
+    }
+    bool packed = mode == kUpb_FieldMode_Array &&
+                  (f->mode & kUpb_LabelFlags_IsPacked);
+    int expected = packed
+                       ? kUpb_WireType_Delimited
+                       : kUpb_Canon_WireTypes[f->UPB_PRIVATE(descriptortype)];
+    if (wire_type != expected || wire_type == kUpb_WireType_StartGroup) {
+      return false;  // Mismatches become unknowns; groups we do not prove.
+    }
+
+    // Canonical field order is strictly ascending; a repeated tag is only
+    // legal for an unpacked repeated field (a packed one encodes as a single
+    // run, and a repeated scalar keeps just the last value).
+    if (field_number < prev_number) return false;
+    if (field_number == prev_number &&
+        (mode != kUpb_FieldMode_Array || packed)) {
+      return false;
+    }
+    prev_number = field_number;
+
+    // A oneof emits only its last-set member; any two distinct members in
+    // one buffer re-encode differently.
+    if (f->presence < 0) {
+      uint32_t ofs = (uint32_t)-f->presence;
+      for (size_t i = 0; i < seen_oneof_count; i++) {
+        if (seen_oneofs[i] == ofs) return false;
+      }
+      if (seen_oneof_count ==
+          sizeof(seen_oneofs) / sizeof(seen_oneofs[0])) {
+        return false;
+      }
+      seen_oneofs[seen_oneof_count++] = ofs;
+    }
+
+    switch (wire_type) {
+      case kUpb_WireType_Varint: {
+        uint64_t val;
+        ptr = upb_CanonScan_Varint(ptr, end, &val);
+        if (!ptr || !upb_CanonScan_VarintRoundTrips(f, val)) return false;
+        if (val == 0 && upb_CanonScan_HasImplicitPresence(f, mode)) {
+          return false;  // Default value: the encoder would omit it.
+        }
+        break;
+      }
+      case kUpb_WireType_64Bit: {
+        if (end - ptr < 8) return false;
+        static const char kZero8[8] = {0};
+        if (memcmp(ptr, kZero8, 8) == 0 &&
+            upb_CanonScan_HasImplicitPresence(f, mode)) {
+          return false;
+        }
+        ptr += 8;
+        break;
+      }
+      case kUpb_WireType_32Bit: {
+        if (end - ptr < 4) return false;
+        static const char kZero4[4] = {0};
+        if (memcmp(ptr, kZero4, 4) == 0 &&
+            upb_CanonScan_HasImplicitPresence(f, mode)) {
+          return false;
+        }
+        ptr += 4;
+        break;
+      }
+      case kUpb_WireType_Delimited: {
+        uint64_t size;
+        ptr = upb_CanonScan_Varint(ptr, end, &size);
+        if (!ptr || size > (uint64_t)(end - ptr)) return false;
+        const char* field_end = ptr + size;
+        if (packed) {
+          if (size == 0) return false;  // An empty array is not re-emitted.
+          switch (kUpb_Canon_WireTypes[f->UPB_PRIVATE(descriptortype)]) {
+            case kUpb_WireType_64Bit:
+              if (size % 8 != 0) return false;
+              break;
+            case kUpb_WireType_32Bit:
+              if (size % 4 != 0) return false;
+              break;
+            default:  // Varint elements are checked individually.
+              while (ptr < field_end) {
+                uint64_t val;
+                ptr = upb_CanonScan_Varint(ptr, field_end, &val);
+                if (!ptr || !upb_CanonScan_VarintRoundTrips(f, val)) {
+                  return false;
+                }
+              }
+              break;
+          }
+        } else if (f->UPB_PRIVATE(descriptortype) == kUpb_FieldType_Message) {
+          const upb_MiniTable* subl =
+              l->subs[f->UPB_PRIVATE(submsg_index)].submsg;
+          UPB_ASSERT(subl);
+          if (subl == &_kUpb_MiniTable_Empty) return false;  // Unlinked.
+          if (!upb_CanonScan_Message(ptr, field_end, subl, depth)) {
+            return false;
+          }
+        } else if (f->UPB_PRIVATE(descriptortype) == kUpb_FieldType_String) {
+          if (!_upb_Decoder_VerifyUtf8Inline(ptr, (int)size)) return false;
+          if (size == 0 && upb_CanonScan_HasImplicitPresence(f, mode)) {
+            return false;
+          }
+        } else if (f->UPB_PRIVATE(descriptortype) == kUpb_FieldType_Bytes &&
+                   size == 0 && upb_CanonScan_HasImplicitPresence(f, mode)) {
+          return false;
+        }
+        ptr = field_end;
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  return ptr == end;
+}
+
+upb_DecodeStatus upb_Wire_Canonicalize(const char* buf, size_t size,
+                                       const upb_MiniTable* l,
+                                       upb_Arena* arena, char** out,
+                                       size_t* out_size) {
+  if (upb_CanonScan_Message(buf, buf + size, l,
+                            kUpb_WireFormat_DefaultDepthLimit)) {
+    // Already canonical: hand back a copy without building a message.
+    char* copy = upb_Arena_Malloc(arena, size);
+    if (!copy) return kUpb_DecodeStatus_OutOfMemory;
+    memcpy(copy, buf, size);
+    *out = copy;
+    *out_size = size;
+    return kUpb_DecodeStatus_Ok;
+  }
+
+  upb_Message* msg = upb_Message_New(l, arena);
+  if (!msg) return kUpb_DecodeStatus_OutOfMemory;
+  upb_DecodeStatus status = upb_Decode(buf, size, msg, l, NULL, 0, arena);
+  if (status != kUpb_DecodeStatus_Ok) return status;
+
+  switch (upb_Encode(msg, l, kUpb_EncodeOption_Deterministic, arena, out,
+                     out_size)) {
+    case kUpb_EncodeStatus_Ok:
+      return kUpb_DecodeStatus_Ok;
+    case kUpb_EncodeStatus_OutOfMemory:
+      return kUpb_DecodeStatus_OutOfMemory;
+    case kUpb_EncodeStatus_MaxDepthExceeded:
+      return kUpb_DecodeStatus_MaxDepthExceeded;
+    default:
+      return kUpb_DecodeStatus_Malformed;
+  }
+}
+
+#include "upb/port/undef.inc"
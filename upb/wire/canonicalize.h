@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2009-2023, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// upb_Wire_Canonicalize: rewriting binary wire format into canonical bytes.
+
+#ifndef UPB_WIRE_CANONICALIZE_H_
+#define UPB_WIRE_CANONICALIZE_H_
+
+#include "upb/mem/arena.h"
+#include "upb/mini_table/message.h"
+#include "upb/wire/decode.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Re-emits the serialized message in [buf, buf + size) in canonical form:
+// fields in ascending field-number order, map entries sorted by key, and all
+// varints minimal -- the bytes a deterministic upb_Encode() of the message
+// would produce.  Two buffers that decode to the same message canonicalize
+// to the same bytes, so the output is suitable for hashing, signing and
+// deduplication.
+//
+// On success returns kUpb_DecodeStatus_Ok and points *out at an
+// arena-allocated buffer of *out_size bytes.  Input that is already
+// canonical is detected with a single wire-level scan and copied straight
+// through without materializing a message; everything else round-trips
+// through upb_Decode() + deterministic upb_Encode() and fails with the
+// decode error for malformed input.  Unknown fields are preserved verbatim
+// by the round trip but appear after all known fields, so writers with
+// different schema versions only converge on schema-complete mini tables.
+UPB_API upb_DecodeStatus upb_Wire_Canonicalize(const char* buf, size_t size,
+                                               const upb_MiniTable* l,
+                                               upb_Arena* arena, char** out,
+                                               size_t* out_size);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_WIRE_CANONICALIZE_H_ */
@@ -32,14 +32,20 @@
 #include "upb/base/descriptor_constants.h"
 #include "upb/collections/array_internal.h"
 #include "upb/collections/map_internal.h"
+#include "upb/hash/str_table.h"
 #include "upb/mem/arena_internal.h"
 #include "upb/message/accessors_internal.h"
 #include "upb/message/internal/map_entry.h"
 #include "upb/mini_table/sub.h"
 #include "upb/port/atomic.h"
+#ifdef UPB_PROFILE
+#include "upb/profile/profile.h"
+#endif
 #include "upb/wire/common.h"
 #include "upb/wire/common_internal.h"
 #include "upb/wire/decode_internal.h"
+#include "upb/wire/decode_telemetry.h"
+#include "upb/wire/decode_trace.h"
 #include "upb/wire/encode.h"
 #include "upb/wire/eps_copy_input_stream.h"
 #include "upb/wire/reader.h"
@@ -113,6 +119,10 @@ static void _upb_Decoder_VerifyUtf8(upb_Decoder* d, const char* buf, int len) {
 }
 
 static bool _upb_Decoder_Reserve(upb_Decoder* d, upb_Array* arr, size_t elem) {
+  if (UPB_UNLIKELY(elem > d->elem_budget)) {
+    _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_QuotaExceeded);
+  }
+  d->elem_budget -= elem;
   bool need_realloc = arr->capacity - arr->size < elem;
   if (need_realloc && !_upb_array_realloc(arr, arr->size + elem, &d->arena)) {
     _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
@@ -147,7 +157,7 @@ UPB_FORCEINLINE
 static const char* _upb_Decoder_DecodeVarint(upb_Decoder* d, const char* ptr,
                                              uint64_t* val) {
   uint64_t byte = (uint8_t)*ptr;
-  if (UPB_LIKELY((byte & 0x80) == 0)) {
+  if (UPB_DECODE_BRANCH(ShortVarint, (byte & 0x80) == 0)) {
     *val = byte;
     return ptr + 1;
   } else {
@@ -162,7 +172,7 @@ UPB_FORCEINLINE
 static const char* _upb_Decoder_DecodeTag(upb_Decoder* d, const char* ptr,
                                           uint32_t* val) {
   uint64_t byte = (uint8_t)*ptr;
-  if (UPB_LIKELY((byte & 0x80) == 0)) {
+  if (UPB_DECODE_BRANCH(ShortTag, (byte & 0x80) == 0)) {
     *val = byte;
     return ptr + 1;
   } else {
@@ -266,8 +276,50 @@ static upb_Message* _upb_Decoder_ReuseSubMessage(
   return promoted;
 }
 
+// Interning thresholds: strings shorter than the minimum save less than the
+// table costs to track them; strings longer than the maximum are rarely
+// duplicated and are expensive to hash on every occurrence.
+#define kUpb_Decoder_MinInternSize 4
+#define kUpb_Decoder_MaxInternSize 256
+
+// Returns the canonical arena-resident copy of [ptr, size), creating the
+// per-arena intern table on first use.  The table's own key copy (made by
+// upb_strtable_insert()) is the canonical string, so a unique string is
+// stored exactly once.  Returns NULL on allocation failure.
+static const char* _upb_Decoder_InternString(upb_Decoder* d, const char* ptr,
+                                             int size) {
+  upb_strtable* pool = d->arena.intern_pool;
+  if (!pool) {
+    pool = upb_Arena_Malloc(&d->arena, sizeof(*pool));
+    if (!pool || !upb_strtable_init(pool, 8, &d->arena)) return NULL;
+    d->arena.intern_pool = pool;
+  }
+  upb_StringView interned;
+  if (upb_strtable_lookup3(pool, ptr, size, NULL, &interned)) {
+    return interned.data;
+  }
+  if (!upb_strtable_insert(pool, ptr, size, upb_value_bool(true), &d->arena)) {
+    return NULL;
+  }
+  bool ok = upb_strtable_lookup3(pool, ptr, size, NULL, &interned);
+  UPB_ASSERT(ok);
+  UPB_UNUSED(ok);
+  return interned.data;
+}
+
 static const char* _upb_Decoder_ReadString(upb_Decoder* d, const char* ptr,
                                            int size, upb_StringView* str) {
+  if (UPB_UNLIKELY(d->options & kUpb_DecodeOption_InternStrings) &&
+      size >= kUpb_Decoder_MinInternSize &&
+      size <= kUpb_Decoder_MaxInternSize &&
+      !upb_EpsCopyInputStream_AliasingAvailable(&d->input, ptr, size) &&
+      upb_EpsCopyInputStream_CheckDataSizeAvailable(&d->input, ptr, size)) {
+    const char* interned = _upb_Decoder_InternString(d, ptr, size);
+    if (!interned) _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
+    str->data = interned;
+    str->size = size;
+    return ptr + size;
+  }
   const char* str_ptr = ptr;
   ptr = upb_EpsCopyInputStream_ReadString(&d->input, &str_ptr, size, &d->arena);
   if (!ptr) _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
@@ -276,6 +328,26 @@ static const char* _upb_Decoder_ReadString(upb_Decoder* d, const char* ptr,
   return ptr;
 }
 
+// Stores a short string for a kUpb_LabelFlags_IsInlineString field directly
+// in its slot (see the inline-string helpers in accessors_internal.h),
+// skipping the arena copy the generic path would make.
+static const char* _upb_Decoder_ReadInlineString(upb_Decoder* d,
+                                                 const char* ptr, int size,
+                                                 void* slot) {
+  if (UPB_DECODE_BRANCH(InlineStringDirect,
+                        upb_EpsCopyInputStream_CheckDataSizeAvailable(
+                            &d->input, ptr, size))) {
+    _upb_InlineString_Encode(slot, ptr, size);
+    return ptr + size;
+  }
+  // The value straddles a buffer seam; read it the generic way, then encode
+  // the (stitched) copy into the slot.
+  upb_StringView str;
+  ptr = _upb_Decoder_ReadString(d, ptr, size, &str);
+  _upb_InlineString_Encode(slot, str.data, str.size);
+  return ptr;
+}
+
 UPB_FORCEINLINE
 static const char* _upb_Decoder_RecurseSubMessage(upb_Decoder* d,
                                                   const char* ptr,
@@ -293,15 +365,76 @@ static const char* _upb_Decoder_RecurseSubMessage(upb_Decoder* d,
   return ptr;
 }
 
+// Whether sub-messages with layout |l| should record their original wire
+// bytes (kUpb_DecodeOption_RetainWireBytes).  Extendable layouts and layouts
+// with map fields are excluded: their sub-objects can be mutated without
+// going through any per-message accessor funnel, so a recorded span could go
+// stale without being invalidated.
+static bool _upb_Decoder_ShouldRecordWireSpan(upb_Decoder* d,
+                                              const upb_MiniTable* l) {
+  if (!(d->options & kUpb_DecodeOption_RetainWireBytes)) return false;
+  if (l->ext != kUpb_ExtMode_NonExtendable) return false;
+  for (int i = 0; i < l->field_count; i++) {
+    if (upb_FieldMode_Get(&l->fields[i]) == kUpb_FieldMode_Map) return false;
+  }
+  return true;
+}
+
 UPB_FORCEINLINE
 static const char* _upb_Decoder_DecodeSubMessage(
     upb_Decoder* d, const char* ptr, upb_Message* submsg,
-    const upb_MiniTableSub* subs, const upb_MiniTableField* field, int size) {
+    const upb_MiniTableSub* subs, const upb_MiniTableField* field, int size,
+    bool fresh) {
   int saved_delta = upb_EpsCopyInputStream_PushLimit(&d->input, ptr, size);
   const upb_MiniTable* subl = subs[field->UPB_PRIVATE(submsg_index)].submsg;
   UPB_ASSERT(subl);
+  const char* span_start = NULL;
+  if (fresh && _upb_Decoder_ShouldRecordWireSpan(d, subl) &&
+      upb_EpsCopyInputStream_AliasingAvailable(&d->input, ptr, size)) {
+    span_start = upb_EpsCopyInputStream_GetAliasedPtr(&d->input, ptr);
+  } else if (!fresh) {
+    // This parse merges into an existing message, so any span it recorded
+    // earlier no longer reflects its contents.
+    _upb_Message_InvalidateWireSpan(submsg);
+  }
   ptr = _upb_Decoder_RecurseSubMessage(d, ptr, submsg, subl, DECODE_NOGROUP);
   upb_EpsCopyInputStream_PopLimit(&d->input, ptr, saved_delta);
+  if (span_start &&
+      !_upb_Message_SetWireSpan(submsg, span_start, size, 0, &d->arena)) {
+    _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
+  }
+  return ptr;
+}
+
+UPB_FORCEINLINE
+static bool _upb_Decoder_IsLazyField(upb_Decoder* d,
+                                     const upb_MiniTableField* field) {
+  return (d->options & kUpb_DecodeOption_LazySubMessage) != 0 &&
+         field->UPB_PRIVATE(descriptortype) == kUpb_FieldType_Message &&
+         !(field->mode & kUpb_LabelFlags_IsExtension);
+}
+
+static upb_Message* _upb_Decoder_NewLazySubMessage(
+    upb_Decoder* d, upb_TaggedMessagePtr* target) {
+  upb_Message* msg = _upb_Message_New(&_kUpb_MiniTable_Empty, &d->arena);
+  if (!msg) _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
+  upb_TaggedMessagePtr tagged = _upb_TaggedMessagePtr_Pack(msg, true);
+  memcpy(target, &tagged, sizeof(tagged));
+  return msg;
+}
+
+// Stores a deferred sub-message: the delimited region is parsed against the
+// "empty" mini table so that every field lands in the unknown fields of
+// |submsg|, to be decoded for real when the message is first promoted through
+// message/promote.h.
+static const char* _upb_Decoder_DecodeLazySubMessage(upb_Decoder* d,
+                                                     const char* ptr,
+                                                     upb_Message* submsg,
+                                                     int size) {
+  int saved_delta = upb_EpsCopyInputStream_PushLimit(&d->input, ptr, size);
+  ptr = _upb_Decoder_RecurseSubMessage(d, ptr, submsg, &_kUpb_MiniTable_Empty,
+                                       DECODE_NOGROUP);
+  upb_EpsCopyInputStream_PopLimit(&d->input, ptr, saved_delta);
   return ptr;
 }
 
@@ -346,6 +479,7 @@ static char* upb_Decoder_EncodeVarint32(uint32_t val, char* ptr) {
 
 static void _upb_Decoder_AddUnknownVarints(upb_Decoder* d, upb_Message* msg,
                                            uint32_t val1, uint32_t val2) {
+  if (d->options & kUpb_DecodeOption_DiscardUnknown) return;
   char buf[20];
   char* end = buf;
   end = upb_Decoder_EncodeVarint32(val1, end);
@@ -382,7 +516,10 @@ static bool _upb_Decoder_CheckEnum(upb_Decoder* d, const char* ptr,
   uint32_t v = val->uint32_val;
 
   _kUpb_FastEnumCheck_Status status = _upb_MiniTable_CheckEnumValueFast(e, v);
-  if (UPB_LIKELY(status == _kUpb_FastEnumCheck_ValueIsInEnum)) return true;
+  if (UPB_DECODE_BRANCH(EnumInRange,
+                        status == _kUpb_FastEnumCheck_ValueIsInEnum)) {
+    return true;
+  }
   return _upb_Decoder_CheckEnumSlow(d, ptr, msg, e, field, v);
 }
 
@@ -416,22 +553,23 @@ static const char* _upb_Decoder_DecodeFixedPacked(
   arr->size += count;
   // Note: if/when the decoder supports multi-buffer input, we will need to
   // handle buffer seams here.
-  if (_upb_IsLittleEndian()) {
-    ptr = upb_EpsCopyInputStream_Copy(&d->input, ptr, mem, val->size);
-  } else {
-    int delta = upb_EpsCopyInputStream_PushLimit(&d->input, ptr, val->size);
-    char* dst = mem;
-    while (!_upb_Decoder_IsDone(d, &ptr)) {
-      if (lg2 == 2) {
-        ptr = upb_WireReader_ReadFixed32(ptr, dst);
-        dst += 4;
-      } else {
-        UPB_ASSERT(lg2 == 3);
-        ptr = upb_WireReader_ReadFixed64(ptr, dst);
-        dst += 8;
+  ptr = upb_EpsCopyInputStream_Copy(&d->input, ptr, mem, val->size);
+  if (!_upb_IsLittleEndian()) {
+    // Swap each element in place. This loop is branch-free and the compiler
+    // can vectorize it (byte shuffles on SSE2/NEON), unlike the previous
+    // element-at-a-time walk through the input stream.
+    if (lg2 == 2) {
+      uint32_t* elems = mem;
+      for (size_t i = 0; i < count; i++) {
+        elems[i] = _upb_BigEndian_Swap32(elems[i]);
+      }
+    } else {
+      UPB_ASSERT(lg2 == 3);
+      uint64_t* elems = mem;
+      for (size_t i = 0; i < count; i++) {
+        elems[i] = _upb_BigEndian_Swap64(elems[i]);
       }
     }
-    upb_EpsCopyInputStream_PopLimit(&d->input, ptr, delta);
   }
 
   return ptr;
@@ -445,6 +583,23 @@ static const char* _upb_Decoder_DecodeVarintPacked(
   int saved_limit = upb_EpsCopyInputStream_PushLimit(&d->input, ptr, val->size);
   char* out = UPB_PTR_AT(_upb_array_ptr(arr), arr->size << lg2, void);
   while (!_upb_Decoder_IsDone(d, &ptr)) {
+    uint64_t word;
+    while (_upb_Decoder_PeekEightOneByteVarints(d, ptr, &word)) {
+      // Batch path: eight single-byte varints decoded with one bounds check.
+      if (_upb_Decoder_Reserve(d, arr, 8)) {
+        out = UPB_PTR_AT(_upb_array_ptr(arr), arr->size << lg2, void);
+      }
+      for (int i = 0; i < 8; i++) {
+        wireval elem;
+        elem.uint64_val = (word >> (i * 8)) & 0xff;
+        _upb_Decoder_Munge(field->UPB_PRIVATE(descriptortype), &elem);
+        memcpy(out, &elem, scale);
+        out += scale;
+      }
+      arr->size += 8;
+      ptr += 8;
+    }
+    if (_upb_Decoder_IsDone(d, &ptr)) break;
     wireval elem;
     ptr = _upb_Decoder_DecodeVarint(d, ptr, &elem.uint64_val);
     _upb_Decoder_Munge(field->UPB_PRIVATE(descriptortype), &elem);
@@ -465,9 +620,36 @@ static const char* _upb_Decoder_DecodeEnumPacked(
     const upb_MiniTableSub* subs, const upb_MiniTableField* field,
     wireval* val) {
   const upb_MiniTableEnum* e = subs[field->UPB_PRIVATE(submsg_index)].subenum;
+  // The first 64 enum values are always covered by the table's bitmask words
+  // (see build_enum.c), so a run of small values validates against a single
+  // register instead of one upb_MiniTableEnum_CheckValue() call per element.
+  const uint64_t mask = e->data[0] | ((uint64_t)e->data[1] << 32);
   int saved_limit = upb_EpsCopyInputStream_PushLimit(&d->input, ptr, val->size);
   char* out = UPB_PTR_AT(_upb_array_ptr(arr), arr->size * 4, void);
   while (!_upb_Decoder_IsDone(d, &ptr)) {
+    uint64_t word;
+    while (_upb_Decoder_PeekEightOneByteVarints(d, ptr, &word)) {
+      // Batch path: eight single-byte varints, all testable off the mask.
+      bool all_valid = true;
+      for (int i = 0; i < 8; i++) {
+        uint32_t v = (word >> (i * 8)) & 0xff;
+        all_valid = all_valid && v < 64 && ((mask >> v) & 1);
+      }
+      // On any miss fall through to the per-element path, which knows how to
+      // consult the enum's value list and route misses to unknown fields.
+      if (!all_valid) break;
+      if (_upb_Decoder_Reserve(d, arr, 8)) {
+        out = UPB_PTR_AT(_upb_array_ptr(arr), arr->size * 4, void);
+      }
+      uint32_t* out32 = (uint32_t*)out;
+      for (int i = 0; i < 8; i++) {
+        out32[i] = (word >> (i * 8)) & 0xff;
+      }
+      out += 8 * 4;
+      arr->size += 8;
+      ptr += 8;
+    }
+    if (_upb_Decoder_IsDone(d, &ptr)) break;
     wireval elem;
     ptr = _upb_Decoder_DecodeVarint(d, ptr, &elem.uint64_val);
     _upb_Decoder_MungeInt32(&elem);
@@ -511,7 +693,16 @@ upb_Array* _upb_Decoder_CreateArray(upb_Decoder* d,
   };
 
   size_t lg2 = kElemSizeLg2[field->UPB_PRIVATE(descriptortype)];
-  upb_Array* ret = _upb_Array_New(&d->arena, 4, lg2);
+  size_t init_capacity = _upb_Array_InitialCapacity(lg2);
+  if (UPB_UNLIKELY(d->presize_counts != NULL) &&
+      d->depth == d->select_depth) {
+    size_t idx = (size_t)(field - d->presize_layout->fields);
+    if (idx < d->presize_layout->field_count &&
+        d->presize_counts[idx] > init_capacity) {
+      init_capacity = d->presize_counts[idx];
+    }
+  }
+  upb_Array* ret = _upb_Array_New(&d->arena, init_capacity, lg2);
   if (!ret) _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
   return ret;
 }
@@ -554,6 +745,11 @@ static const char* _upb_Decoder_DecodeToArray(upb_Decoder* d, const char* ptr,
       /* Append submessage / group. */
       upb_TaggedMessagePtr* target = UPB_PTR_AT(
           _upb_array_ptr(arr), arr->size * sizeof(void*), upb_TaggedMessagePtr);
+      if (UPB_DECODE_BRANCH(LazyField, _upb_Decoder_IsLazyField(d, field))) {
+        upb_Message* lazy = _upb_Decoder_NewLazySubMessage(d, target);
+        arr->size++;
+        return _upb_Decoder_DecodeLazySubMessage(d, ptr, lazy, val->size);
+      }
       upb_Message* submsg = _upb_Decoder_NewSubMessage(d, subs, field, target);
       arr->size++;
       if (UPB_UNLIKELY(field->UPB_PRIVATE(descriptortype) ==
@@ -561,7 +757,7 @@ static const char* _upb_Decoder_DecodeToArray(upb_Decoder* d, const char* ptr,
         return _upb_Decoder_DecodeKnownGroup(d, ptr, submsg, subs, field);
       } else {
         return _upb_Decoder_DecodeSubMessage(d, ptr, submsg, subs, field,
-                                             val->size);
+                                             val->size, /*fresh=*/true);
       }
     }
     case OP_FIXPCK_LG2(2):
@@ -614,6 +810,8 @@ upb_Map* _upb_Decoder_CreateMap(upb_Decoder* d, const upb_MiniTable* entry) {
   UPB_ASSERT(val_field->offset == offsetof(upb_MapEntryData, v));
   upb_Map* ret = _upb_Map_New(&d->arena, key_size, val_size);
   if (!ret) _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
+  // The map must not retain the decoder's temporary arena copy.
+  ret->arena = d->original_arena;
   return ret;
 }
 
@@ -636,6 +834,14 @@ static const char* _upb_Decoder_DecodeToMap(upb_Decoder* d, const char* ptr,
   if (!map) {
     map = _upb_Decoder_CreateMap(d, entry);
     *map_p = map;
+    if (UPB_UNLIKELY(d->presize_counts != NULL) &&
+        d->depth == d->select_depth) {
+      size_t idx = (size_t)(field - d->presize_layout->fields);
+      if (idx < d->presize_layout->field_count && d->presize_counts[idx] > 4 &&
+          !upb_Map_Reserve(map, d->presize_counts[idx], &d->arena)) {
+        _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
+      }
+    }
   }
 
   // Parse map entry.
@@ -649,8 +855,8 @@ static const char* _upb_Decoder_DecodeToMap(upb_Decoder* d, const char* ptr,
     ent.data.v.val = upb_value_uintptr(msg);
   }
 
-  ptr =
-      _upb_Decoder_DecodeSubMessage(d, ptr, &ent.data, subs, field, val->size);
+  ptr = _upb_Decoder_DecodeSubMessage(d, ptr, &ent.data, subs, field,
+                                      val->size, /*fresh=*/false);
   // check if ent had any unknown fields
   size_t size;
   upb_Message_GetUnknown(&ent.data, &size);
@@ -668,6 +874,10 @@ static const char* _upb_Decoder_DecodeToMap(upb_Decoder* d, const char* ptr,
       _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
     }
   } else {
+    if (UPB_UNLIKELY(d->elem_budget == 0)) {
+      _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_QuotaExceeded);
+    }
+    d->elem_budget--;
     if (_upb_Map_Insert(map, &ent.data.k, map->key_size, &ent.data.v,
                         map->val_size,
                         &d->arena) == kUpb_MapInsertStatus_OutOfMemory) {
@@ -684,7 +894,7 @@ static const char* _upb_Decoder_DecodeToSubMessage(
   void* mem = UPB_PTR_AT(msg, field->offset, void);
   int type = field->UPB_PRIVATE(descriptortype);
 
-  if (UPB_UNLIKELY(op == kUpb_DecodeOp_Enum) &&
+  if (UPB_DECODE_BRANCH(EnumOp, op == kUpb_DecodeOp_Enum) &&
       !_upb_Decoder_CheckEnum(d, ptr, msg,
                               subs[field->UPB_PRIVATE(submsg_index)].subenum,
                               field, val)) {
@@ -708,16 +918,28 @@ static const char* _upb_Decoder_DecodeToSubMessage(
     case kUpb_DecodeOp_SubMessage: {
       upb_TaggedMessagePtr* submsgp = mem;
       upb_Message* submsg;
-      if (*submsgp) {
-        submsg = _upb_Decoder_ReuseSubMessage(d, subs, field, submsgp);
-      } else {
+      if (UPB_UNLIKELY(_upb_Decoder_IsLazyField(d, field)) &&
+          (!*submsgp || upb_TaggedMessagePtr_IsEmpty(*submsgp))) {
+        // Defer parsing: this occurrence's bytes accumulate in the empty
+        // message's unknown fields, so wire-format concatenation preserves
+        // merge semantics when the field is eventually promoted.  If the field
+        // already holds a parsed message we fall through to an eager merge.
+        submsg = *submsgp ? _upb_TaggedMessagePtr_GetEmptyMessage(*submsgp)
+                          : _upb_Decoder_NewLazySubMessage(d, submsgp);
+        ptr = _upb_Decoder_DecodeLazySubMessage(d, ptr, submsg, val->size);
+        break;
+      }
+      bool fresh = *submsgp == 0;
+      if (fresh) {
         submsg = _upb_Decoder_NewSubMessage(d, subs, field, submsgp);
+      } else {
+        submsg = _upb_Decoder_ReuseSubMessage(d, subs, field, submsgp);
       }
-      if (UPB_UNLIKELY(type == kUpb_FieldType_Group)) {
+      if (UPB_DECODE_BRANCH(GroupField, type == kUpb_FieldType_Group)) {
         ptr = _upb_Decoder_DecodeKnownGroup(d, ptr, submsg, subs, field);
       } else {
         ptr = _upb_Decoder_DecodeSubMessage(d, ptr, submsg, subs, field,
-                                            val->size);
+                                            val->size, fresh);
       }
       break;
     }
@@ -725,6 +947,10 @@ static const char* _upb_Decoder_DecodeToSubMessage(
       _upb_Decoder_VerifyUtf8(d, ptr, val->size);
       /* Fallthrough. */
     case kUpb_DecodeOp_Bytes:
+      if (UPB_UNLIKELY(_upb_MiniTableField_IsInlineString(field)) &&
+          _upb_InlineString_CanStore(val->size)) {
+        return _upb_Decoder_ReadInlineString(d, ptr, val->size, mem);
+      }
       return _upb_Decoder_ReadString(d, ptr, val->size, mem);
     case kUpb_DecodeOp_Scalar8Byte:
       memcpy(mem, val, 8);
@@ -748,7 +974,8 @@ const char* _upb_Decoder_CheckRequired(upb_Decoder* d, const char* ptr,
                                        const upb_Message* msg,
                                        const upb_MiniTable* l) {
   assert(l->required_count);
-  if (UPB_LIKELY((d->options & kUpb_DecodeOption_CheckRequired) == 0)) {
+  if (UPB_DECODE_BRANCH(SkipRequiredCheck,
+                        (d->options & kUpb_DecodeOption_CheckRequired) == 0)) {
     return ptr;
   }
   uint64_t msg_head;
@@ -765,7 +992,16 @@ static bool _upb_Decoder_TryFastDispatch(upb_Decoder* d, const char** ptr,
                                          upb_Message* msg,
                                          const upb_MiniTable* layout) {
 #if UPB_FASTTABLE
-  if (layout && layout->table_mask != (unsigned char)-1) {
+  // The fast-table parsers always decode sub-messages eagerly, so they are
+  // skipped entirely when lazy sub-message decoding was requested.
+  // The fast paths also copy strings without consulting the intern table,
+  // and append array elements without charging the element quota.
+  if (layout && layout->table_mask != (uint16_t)-1 &&
+      !(d->options &
+        (kUpb_DecodeOption_LazySubMessage | kUpb_DecodeOption_InternStrings)) &&
+      d->elem_budget == SIZE_MAX &&
+      UPB_LIKELY(!d->select_fields || d->depth != d->select_depth)) {
+    UPB_DECODE_TELEMETRY_DISPATCH(layout);
     uint16_t tag = _upb_FastDecoder_LoadTag(*ptr);
     intptr_t table = decode_totable(layout);
     *ptr = _upb_FastDecoder_TagDispatch(d, *ptr, msg, table, 0, tag);
@@ -775,6 +1011,15 @@ static bool _upb_Decoder_TryFastDispatch(upb_Decoder* d, const char** ptr,
   return false;
 }
 
+UPB_INLINE bool _upb_Decoder_FieldIsSelected(upb_Decoder* d, int field_number) {
+  // The selection sets we see are tiny (a handful of fields), so a linear
+  // scan beats anything fancier.
+  for (size_t i = 0; i < d->select_count; i++) {
+    if (d->select_fields[i] == (uint32_t)field_number) return true;
+  }
+  return false;
+}
+
 static const char* upb_Decoder_SkipField(upb_Decoder* d, const char* ptr,
                                          uint32_t tag) {
   int field_number = tag >> 3;
@@ -827,6 +1072,7 @@ static void upb_Decoder_AddUnknownMessageSetItem(upb_Decoder* d,
                                                  uint32_t type_id,
                                                  const char* message_data,
                                                  uint32_t message_size) {
+  if (d->options & kUpb_DecodeOption_DiscardUnknown) return;
   char buf[60];
   char* ptr = buf;
   ptr = upb_Decoder_EncodeVarint32(kStartItemTag, ptr);
@@ -927,19 +1173,38 @@ static const upb_MiniTableField* _upb_Decoder_FindField(upb_Decoder* d,
   }
 
   if (t->dense_below < t->field_count) {
-    /* Linear search non-dense fields. Resume scanning from last_field_index
-     * since fields are usually in order. */
+    /* Fields are usually encoded in number order, so probe the previous
+     * match and its successor before searching: repeated and split fields
+     * re-hit `last`, in-order wire hits `last + 1`. */
     size_t last = *last_field_index;
-    for (idx = last; idx < t->field_count; idx++) {
-      if (t->fields[idx].number == field_number) {
-        goto found;
-      }
+    if (t->fields[last].number == field_number) {
+      idx = last;
+      goto found;
+    }
+    if (last + 1 < t->field_count && t->fields[last + 1].number == field_number) {
+      idx = last + 1;
+      goto found;
     }
 
-    for (idx = t->dense_below; idx < last; idx++) {
-      if (t->fields[idx].number == field_number) {
+    /* Out-of-order wire: binary search. The non-dense fields are sorted by
+     * number (upb_MiniTable_FindFieldByNumber() relies on the same
+     * invariant), so the field array doubles as the lookup index and
+     * out-of-order messages with many fields stay O(lg n) per field instead
+     * of degenerating to a linear scan. */
+    size_t lo = t->dense_below;
+    size_t hi = t->field_count;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      uint32_t num = t->fields[mid].number;
+      if (num == field_number) {
+        idx = mid;
         goto found;
       }
+      if (num < field_number) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
     }
   }
 
@@ -1146,7 +1411,7 @@ static const char* _upb_Decoder_DecodeKnownField(
   const upb_MiniTableSub* subs = layout->subs;
   uint8_t mode = field->mode;
 
-  if (UPB_UNLIKELY(mode & kUpb_LabelFlags_IsExtension)) {
+  if (UPB_DECODE_BRANCH(ExtensionField, mode & kUpb_LabelFlags_IsExtension)) {
     const upb_MiniTableExtension* ext_layout =
         (const upb_MiniTableExtension*)field;
     upb_Message_Extension* ext =
@@ -1234,11 +1499,152 @@ static const char* _upb_Decoder_DecodeUnknownField(upb_Decoder* d,
   return ptr;
 }
 
+static void _upb_Decoder_PushFrame(upb_Decoder* d, upb_Message* msg,
+                                   const upb_MiniTable* layout,
+                                   int last_field_index, int saved_delta,
+                                   uint32_t group_number,
+                                   const char* span_start,
+                                   uint32_t span_size) {
+  if (d->frame_count == d->frame_capacity) {
+    size_t new_capacity = d->frame_capacity ? d->frame_capacity * 2 : 16;
+    _upb_DecoderFrame* frames =
+        upb_Arena_Malloc(&d->arena, new_capacity * sizeof(*frames));
+    if (!frames) _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
+    if (d->frame_count) {
+      memcpy(frames, d->frames, d->frame_count * sizeof(*frames));
+    }
+    d->frames = frames;
+    d->frame_capacity = new_capacity;
+  }
+  _upb_DecoderFrame* f = &d->frames[d->frame_count++];
+  f->msg = msg;
+  f->layout = layout;
+  f->last_field_index = last_field_index;
+  f->saved_delta = saved_delta;
+  f->group_number = group_number;
+  f->span_start = span_start;
+  f->span_size = span_size;
+}
+
+// Returns true if this sub-message field can be decoded iteratively in the
+// main loop.  Maps, extensions, and lazy fields keep the recursive path: they
+// all perform work after the sub-message is parsed (map insertion, extension
+// bookkeeping) that does not fit a flat frame.
+UPB_INLINE bool _upb_Decoder_CanDecodeIteratively(
+    upb_Decoder* d, const upb_MiniTableField* field) {
+  return !(field->mode & kUpb_LabelFlags_IsExtension) &&
+         (field->mode & kUpb_FieldMode_Mask) != kUpb_FieldMode_Map &&
+         !_upb_Decoder_IsLazyField(d, field);
+}
+
+// Begins iterative decoding of a sub-message or group field: allocates the
+// sub-message, pushes a frame recording the parent, and repoints the decode
+// loop at the child.  This replaces the C recursion previously performed by
+// _upb_Decoder_DecodeSubMessage()/_upb_Decoder_DecodeKnownGroup() for plain
+// fields.  The field-storing logic mirrors _upb_Decoder_DecodeToArray() and
+// _upb_Decoder_DecodeToSubMessage(), which still own the recursive cases.
+static const char* _upb_Decoder_BeginSubMessage(
+    upb_Decoder* d, const char* ptr, upb_Message** msg,
+    const upb_MiniTable** layout, const upb_MiniTableField* field,
+    int wire_type, wireval* val, int* last_field_index) {
+  const upb_MiniTableSub* subs = (*layout)->subs;
+  upb_Message* parent = *msg;
+  upb_Message* submsg;
+  bool fresh = true;
+
+  if ((field->mode & kUpb_FieldMode_Mask) == kUpb_FieldMode_Array) {
+    upb_Array** arrp = UPB_PTR_AT(parent, field->offset, void);
+    upb_Array* arr = *arrp;
+    if (arr) {
+      _upb_Decoder_Reserve(d, arr, 1);
+    } else {
+      arr = _upb_Decoder_CreateArray(d, field);
+      *arrp = arr;
+    }
+    upb_TaggedMessagePtr* target = UPB_PTR_AT(
+        _upb_array_ptr(arr), arr->size * sizeof(void*), upb_TaggedMessagePtr);
+    submsg = _upb_Decoder_NewSubMessage(d, subs, field, target);
+    arr->size++;
+  } else {
+    void* mem = UPB_PTR_AT(parent, field->offset, void);
+    if (field->presence > 0) {
+      _upb_sethas_field(parent, field);
+    } else if (field->presence < 0) {
+      uint32_t* oneof_case = _upb_oneofcase_field(parent, field);
+      if (*oneof_case != field->number) memset(mem, 0, sizeof(void*));
+      *oneof_case = field->number;
+    }
+    upb_TaggedMessagePtr* submsgp = mem;
+    if (*submsgp) {
+      submsg = _upb_Decoder_ReuseSubMessage(d, subs, field, submsgp);
+      // Merging into an existing message invalidates any recorded span.
+      _upb_Message_InvalidateWireSpan(submsg);
+      fresh = false;
+    } else {
+      submsg = _upb_Decoder_NewSubMessage(d, subs, field, submsgp);
+    }
+  }
+
+  if (--d->depth < 0) {
+    _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_MaxDepthExceeded);
+  }
+
+  int saved_delta = 0;
+  uint32_t group_number = DECODE_NOGROUP;
+  const char* span_start = NULL;
+  if (wire_type == kUpb_WireType_Delimited) {
+    if (fresh &&
+        _upb_Decoder_ShouldRecordWireSpan(
+            d, subs[field->UPB_PRIVATE(submsg_index)].submsg) &&
+        upb_EpsCopyInputStream_AliasingAvailable(&d->input, ptr, val->size)) {
+      span_start = upb_EpsCopyInputStream_GetAliasedPtr(&d->input, ptr);
+    }
+    saved_delta = upb_EpsCopyInputStream_PushLimit(&d->input, ptr, val->size);
+  } else {
+    group_number = field->number;
+  }
+  _upb_Decoder_PushFrame(d, parent, *layout, *last_field_index, saved_delta,
+                         group_number, span_start, val->size);
+
+  *msg = submsg;
+  *layout = subs[field->UPB_PRIVATE(submsg_index)].submsg;
+  *last_field_index = 0;
+  return ptr;
+}
+
+// Finishes the sub-message on top of the frame stack and restores the decode
+// loop to its parent level.
+static const char* _upb_Decoder_PopFrame(upb_Decoder* d, const char* ptr,
+                                         upb_Message** msg,
+                                         const upb_MiniTable** layout,
+                                         int* last_field_index) {
+  _upb_DecoderFrame* f = &d->frames[d->frame_count - 1];
+  if (UPB_DECODE_BRANCH(RequiredFields,
+                        *layout && (*layout)->required_count)) {
+    ptr = _upb_Decoder_CheckRequired(d, ptr, *msg, *layout);
+  }
+  if (f->group_number == DECODE_NOGROUP) {
+    upb_EpsCopyInputStream_PopLimit(&d->input, ptr, f->saved_delta);
+  }
+  if (f->span_start &&
+      !_upb_Message_SetWireSpan(*msg, f->span_start, f->span_size, 0,
+                                &d->arena)) {
+    _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
+  }
+  d->frame_count--;
+  d->depth++;
+  *msg = f->msg;
+  *layout = f->layout;
+  *last_field_index = f->last_field_index;
+  return ptr;
+}
+
 UPB_NOINLINE
 static const char* _upb_Decoder_DecodeMessage(upb_Decoder* d, const char* ptr,
                                               upb_Message* msg,
                                               const upb_MiniTable* layout) {
   int last_field_index = 0;
+  const size_t frame_base = d->frame_count;
 
 #if UPB_FASTTABLE
   // The first time we want to skip fast dispatch, because we may have just been
@@ -1246,7 +1652,17 @@ static const char* _upb_Decoder_DecodeMessage(upb_Decoder* d, const char* ptr,
   if (!_upb_Decoder_IsDone(d, &ptr)) goto nofast;
 #endif
 
-  while (!_upb_Decoder_IsDone(d, &ptr)) {
+  for (;;) {
+    if (_upb_Decoder_IsDone(d, &ptr)) {
+      if (d->frame_count == frame_base) break;
+      if (d->frames[d->frame_count - 1].group_number != DECODE_NOGROUP) {
+        // Input ended inside a group.
+        _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_Malformed);
+      }
+      ptr = _upb_Decoder_PopFrame(d, ptr, &msg, &layout, &last_field_index);
+      continue;
+    }
+
     uint32_t tag;
     const upb_MiniTableField* field;
     int field_number;
@@ -1254,7 +1670,24 @@ static const char* _upb_Decoder_DecodeMessage(upb_Decoder* d, const char* ptr,
     wireval val;
     int op;
 
-    if (_upb_Decoder_TryFastDispatch(d, &ptr, msg, layout)) break;
+    if (_upb_Decoder_TryFastDispatch(d, &ptr, msg, layout)) {
+      if (d->frame_count == frame_base) break;
+      // The fast parser finished the current level: either it hit the
+      // delimited limit or it bailed on an END_GROUP tag.
+      _upb_DecoderFrame* f = &d->frames[d->frame_count - 1];
+      if (f->group_number == DECODE_NOGROUP) {
+        if (d->end_group != DECODE_NOGROUP) {
+          _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_Malformed);
+        }
+      } else {
+        if (d->end_group != f->group_number) {
+          _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_Malformed);
+        }
+        d->end_group = DECODE_NOGROUP;
+      }
+      ptr = _upb_Decoder_PopFrame(d, ptr, &msg, &layout, &last_field_index);
+      continue;
+    }
 
 #if UPB_FASTTABLE
   nofast:
@@ -1274,22 +1707,54 @@ static const char* _upb_Decoder_DecodeMessage(upb_Decoder* d, const char* ptr,
 #endif
 
     if (wire_type == kUpb_WireType_EndGroup) {
+      if (d->frame_count > frame_base) {
+        _upb_DecoderFrame* f = &d->frames[d->frame_count - 1];
+        if (f->group_number != (uint32_t)field_number) {
+          _upb_Decoder_ErrorJmp(d, kUpb_DecodeStatus_Malformed);
+        }
+        ptr = _upb_Decoder_PopFrame(d, ptr, &msg, &layout, &last_field_index);
+        continue;
+      }
       d->end_group = field_number;
       return ptr;
     }
 
+    if (UPB_UNLIKELY(d->select_fields != NULL) &&
+        d->depth == d->select_depth && field_number != 0 &&
+        !_upb_Decoder_FieldIsSelected(d, field_number)) {
+      ptr = upb_Decoder_SkipField(d, ptr, tag);
+      continue;
+    }
+
     field = _upb_Decoder_FindField(d, layout, field_number, &last_field_index);
     ptr = _upb_Decoder_DecodeWireValue(d, ptr, layout, field, wire_type, &val,
                                        &op);
 
+    if (op == kUpb_DecodeOp_SubMessage &&
+        _upb_Decoder_CanDecodeIteratively(d, field)) {
+      ptr = _upb_Decoder_BeginSubMessage(d, ptr, &msg, &layout, field,
+                                         wire_type, &val, &last_field_index);
+      continue;
+    }
+
     if (op >= 0) {
       ptr = _upb_Decoder_DecodeKnownField(d, ptr, msg, layout, field, op, &val);
     } else {
       switch (op) {
-        case kUpb_DecodeOp_UnknownField:
-          ptr = _upb_Decoder_DecodeUnknownField(d, ptr, msg, field_number,
-                                                wire_type, val);
+        case kUpb_DecodeOp_UnknownField: {
+          // With DiscardUnknown, pass msg=NULL so the field is skipped
+          // instead of retained -- except when parsing against the empty
+          // mini table, where the "unknown" bytes are the deferred payload
+          // of a lazy or unlinked sub-message.
+          upb_Message* unknown_msg =
+              (d->options & kUpb_DecodeOption_DiscardUnknown) &&
+                      layout != &_kUpb_MiniTable_Empty
+                  ? NULL
+                  : msg;
+          ptr = _upb_Decoder_DecodeUnknownField(d, ptr, unknown_msg,
+                                                field_number, wire_type, val);
           break;
+        }
         case kUpb_DecodeOp_MessageSetItem:
           ptr = upb_Decoder_DecodeMessageSetItem(d, ptr, msg, layout);
           break;
@@ -1340,19 +1805,162 @@ static upb_DecodeStatus upb_Decoder_Decode(upb_Decoder* const decoder,
     UPB_ASSERT(decoder->status != kUpb_DecodeStatus_Ok);
   }
 
+  if (UPB_UNLIKELY(decoder->mem_budget.exceeded) &&
+      decoder->status == kUpb_DecodeStatus_OutOfMemory) {
+    decoder->status = kUpb_DecodeStatus_QuotaExceeded;
+  }
+
   _upb_MemBlock* blocks =
       upb_Atomic_Load(&decoder->arena.blocks, memory_order_relaxed);
   arena->head = decoder->arena.head;
+  arena->intern_pool = decoder->arena.intern_pool;
   upb_Atomic_Store(&arena->blocks, blocks, memory_order_relaxed);
   return decoder->status;
 }
 
-upb_DecodeStatus upb_Decode(const char* buf, size_t size, void* msg,
-                            const upb_MiniTable* l,
-                            const upb_ExtensionRegistry* extreg, int options,
-                            upb_Arena* arena) {
+static const char* _upb_Decoder_PreScanVarint(const char* ptr, const char* end,
+                                              uint64_t* val) {
+  uint64_t out = 0;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    if (ptr == end || shift >= 70) return NULL;
+    byte = (uint8_t)*ptr++;
+    out |= (uint64_t)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  *val = out;
+  return ptr;
+}
+
+// Best-effort structural pass over the buffer that counts elements of the
+// top-level repeated and map fields, so _upb_Decoder_CreateArray() can
+// allocate each array at its final size and _upb_Decoder_DecodeToMap() can
+// pre-size each map's table.  The scan bails out silently on anything
+// malformed, leaving the remaining counts partial; the real parse will report
+// the error.  Counts may overshoot when a wire-type mismatch later demotes an
+// occurrence to an unknown field, which merely over-reserves.
+static void _upb_Decoder_PreScanArraySizes(upb_Decoder* d, const char* ptr,
+                                           size_t size,
+                                           const upb_MiniTable* l) {
+  if (!l || l->field_count == 0) return;
+  uint32_t* counts =
+      upb_Arena_Malloc(&d->arena, l->field_count * sizeof(*counts));
+  if (!counts) return;  // Presizing is optional; parse proceeds without it.
+  memset(counts, 0, l->field_count * sizeof(*counts));
+  d->presize_layout = l;
+  d->presize_counts = counts;
+
+  const char* end = ptr + size;
+  int group_depth = 0;
+  while (ptr < end) {
+    uint64_t tag;
+    ptr = _upb_Decoder_PreScanVarint(ptr, end, &tag);
+    if (!ptr || tag > UINT32_MAX || (tag >> 3) == 0) return;
+    uint32_t field_number = (uint32_t)(tag >> 3);
+    int wire_type = tag & 7;
+
+    const upb_MiniTableField* field =
+        group_depth == 0 ? upb_MiniTable_FindFieldByNumber(l, field_number)
+                         : NULL;
+    uint32_t* count =
+        field && upb_FieldMode_Get(field) != kUpb_FieldMode_Scalar
+            ? &counts[field - l->fields]
+            : NULL;
+
+    switch (wire_type) {
+      case kUpb_WireType_Varint: {
+        uint64_t v;
+        ptr = _upb_Decoder_PreScanVarint(ptr, end, &v);
+        if (!ptr) return;
+        if (count) (*count)++;
+        break;
+      }
+      case kUpb_WireType_32Bit:
+        if (end - ptr < 4) return;
+        ptr += 4;
+        if (count) (*count)++;
+        break;
+      case kUpb_WireType_64Bit:
+        if (end - ptr < 8) return;
+        ptr += 8;
+        if (count) (*count)++;
+        break;
+      case kUpb_WireType_Delimited: {
+        uint64_t len;
+        ptr = _upb_Decoder_PreScanVarint(ptr, end, &len);
+        if (!ptr || len > (uint64_t)(end - ptr)) return;
+        if (count) {
+          switch (field->UPB_PRIVATE(descriptortype)) {
+            case kUpb_FieldType_String:
+            case kUpb_FieldType_Bytes:
+            case kUpb_FieldType_Message:
+            case kUpb_FieldType_Group:
+              (*count)++;  // One string, bytes, or sub-message element.
+              break;
+            // The rest are packed runs.  Fixed-width types divide exactly;
+            // varint types count one element per terminating byte.
+            case kUpb_FieldType_Fixed64:
+            case kUpb_FieldType_SFixed64:
+            case kUpb_FieldType_Double:
+              *count += len / 8;
+              break;
+            case kUpb_FieldType_Fixed32:
+            case kUpb_FieldType_SFixed32:
+            case kUpb_FieldType_Float:
+              *count += len / 4;
+              break;
+            default:
+              for (uint64_t i = 0; i < len; i++) {
+                if (!(ptr[i] & 0x80)) (*count)++;
+              }
+              break;
+          }
+        }
+        ptr += len;
+        break;
+      }
+      case kUpb_WireType_StartGroup:
+        if (count) (*count)++;
+        group_depth++;
+        break;
+      case kUpb_WireType_EndGroup:
+        if (group_depth == 0) return;
+        group_depth--;
+        break;
+      default:
+        return;
+    }
+  }
+}
+
+// upb_alloc_func charging the decode's byte quota; see _upb_DecoderMemBudget.
+static void* _upb_Decoder_BudgetAlloc(upb_alloc* alloc, void* ptr,
+                                      size_t oldsize, size_t size) {
+  _upb_DecoderMemBudget* b = (_upb_DecoderMemBudget*)alloc;
+  const size_t growth = size > oldsize ? size - oldsize : 0;
+  if (UPB_UNLIKELY(growth > b->remaining)) {
+    // Returning NULL surfaces as an arena allocation failure; the decoder
+    // rewrites the resulting OutOfMemory status to QuotaExceeded.
+    b->exceeded = true;
+    return NULL;
+  }
+  void* ret = b->parent->func(b->parent, ptr, oldsize, size);
+  if (ret) b->remaining -= growth;
+  return ret;
+}
+
+static upb_DecodeStatus _upb_Decode(const char* buf, size_t size, void* msg,
+                                    const upb_MiniTable* l,
+                                    const upb_ExtensionRegistry* extreg,
+                                    int options, upb_Arena* arena,
+                                    const uint32_t* select_fields,
+                                    size_t select_count,
+                                    const upb_DecodeLimits* limits) {
+  UPB_PROFILE_BEGIN(profile_start);
   upb_Decoder decoder;
   unsigned depth = (unsigned)options >> 16;
+  const char* scan_buf = buf;  // Init() below may repoint buf at the patch.
 
   upb_EpsCopyInputStream_Init(&decoder.input, &buf, size,
                               options & kUpb_DecodeOption_AliasString);
@@ -1361,8 +1969,19 @@ upb_DecodeStatus upb_Decode(const char* buf, size_t size, void* msg,
   decoder.unknown = NULL;
   decoder.depth = depth ? depth : kUpb_WireFormat_DefaultDepthLimit;
   decoder.end_group = DECODE_NOGROUP;
+  decoder.select_fields = select_fields;
+  decoder.select_count = select_count;
+  decoder.select_depth = decoder.depth;
+  decoder.frames = NULL;
+  decoder.frame_count = 0;
+  decoder.frame_capacity = 0;
+  decoder.presize_layout = NULL;
+  decoder.presize_counts = NULL;
   decoder.options = (uint16_t)options;
   decoder.missing_required = false;
+  decoder.elem_budget = limits && limits->max_elements ? limits->max_elements
+                                                       : SIZE_MAX;
+  decoder.mem_budget.exceeded = false;
   decoder.status = kUpb_DecodeStatus_Ok;
 
   // Violating the encapsulation of the arena for performance reasons.
@@ -1373,9 +1992,75 @@ upb_DecodeStatus upb_Decode(const char* buf, size_t size, void* msg,
   _upb_MemBlock* blocks = upb_Atomic_Load(&arena->blocks, memory_order_relaxed);
   decoder.arena.head = arena->head;
   decoder.arena.block_alloc = arena->block_alloc;
+  decoder.arena.growth_factor = arena->growth_factor;
+  decoder.arena.max_block_size = arena->max_block_size;
+  decoder.arena.numa_node = arena->numa_node;
+  decoder.arena.zeroed_blocks = arena->zeroed_blocks;
+  decoder.arena.intern_pool = arena->intern_pool;
+  decoder.original_arena = arena;
   upb_Atomic_Init(&decoder.arena.blocks, blocks);
 
-  return upb_Decoder_Decode(&decoder, buf, msg, l, arena);
+  if (UPB_UNLIKELY(limits && limits->max_arena_bytes)) {
+    // Interpose on the temporary arena's block allocator; the swap is local
+    // to the decode, and the blocks it grants are freed later through the
+    // same underlying allocator.
+    decoder.mem_budget.alloc.func = &_upb_Decoder_BudgetAlloc;
+    // No aligned/zeroed entry points: every block the budget grants must be
+    // metered through the plain path.
+    decoder.mem_budget.alloc.aligned_func = NULL;
+    decoder.mem_budget.alloc.zeroed_func = NULL;
+    decoder.mem_budget.parent = upb_Arena_BlockAlloc(arena);
+    decoder.mem_budget.remaining = limits->max_arena_bytes;
+    decoder.arena.block_alloc =
+        upb_Arena_MakeBlockAlloc(&decoder.mem_budget.alloc, false);
+  }
+
+  if (UPB_UNLIKELY(options & kUpb_DecodeOption_PreScanArrays)) {
+    _upb_Decoder_PreScanArraySizes(&decoder, scan_buf, size, l);
+  }
+
+  upb_DecodeStatus status = upb_Decoder_Decode(&decoder, buf, msg, l, arena);
+  UPB_PROFILE_END(profile_start, kUpb_ProfileSubsystem_Decode);
+  return status;
+}
+
+upb_DecodeStatus upb_Decode(const char* buf, size_t size, void* msg,
+                            const upb_MiniTable* l,
+                            const upb_ExtensionRegistry* extreg, int options,
+                            upb_Arena* arena) {
+  return _upb_Decode(buf, size, msg, l, extreg, options, arena, NULL, 0, NULL);
+}
+
+upb_DecodeStatus upb_Decode_WithLimits(const char* buf, size_t size,
+                                       upb_Message* msg,
+                                       const upb_MiniTable* l,
+                                       const upb_ExtensionRegistry* extreg,
+                                       int options, upb_Arena* arena,
+                                       const upb_DecodeLimits* limits) {
+  return _upb_Decode(buf, size, msg, l, extreg, options, arena, NULL, 0,
+                     limits);
+}
+
+upb_DecodeStatus upb_Decode_Shared(upb_SharedBuffer* buf, upb_Message* msg,
+                                   const upb_MiniTable* l,
+                                   const upb_ExtensionRegistry* extreg,
+                                   int options, upb_Arena* arena) {
+  if (!upb_Arena_AttachSharedBuffer(arena, buf)) {
+    return kUpb_DecodeStatus_OutOfMemory;
+  }
+  return upb_Decode(upb_SharedBuffer_Data(buf), upb_SharedBuffer_Size(buf),
+                    msg, l, extreg, options | kUpb_DecodeOption_AliasString,
+                    arena);
+}
+
+upb_DecodeStatus upb_Decode_Selective(const char* buf, size_t size, void* msg,
+                                      const upb_MiniTable* l,
+                                      const upb_ExtensionRegistry* extreg,
+                                      int options, upb_Arena* arena,
+                                      const uint32_t* field_numbers,
+                                      size_t field_count) {
+  return _upb_Decode(buf, size, msg, l, extreg, options, arena, field_numbers,
+                     field_count, NULL);
 }
 
 #undef OP_FIXPCK_LG2
@@ -31,6 +31,7 @@
 #define UPB_WIRE_DECODE_H_
 
 #include "upb/mem/arena.h"
+#include "upb/mem/shared_buffer.h"
 #include "upb/message/message.h"
 #include "upb/mini_table/extension_registry.h"
 
@@ -99,6 +100,61 @@ enum {
    *    be created by the parser or the message-copying logic in message/copy.h.
    */
   kUpb_DecodeOption_ExperimentalAllowUnlinked = 4,
+
+  // If set, non-extension sub-message fields are not parsed eagerly. Instead
+  // each sub-message's bytes are retained verbatim as the unknown fields of an
+  // "empty" message (see upb/message/tagged_ptr.h), exactly as if the field
+  // were unlinked, and are parsed on first access through the promotion API in
+  // upb/message/promote.h (upb_Message_PromoteMessage() etc.). This defers
+  // sub-message parsing (including UTF-8 validation within sub-messages) for
+  // consumers that touch only a few fields of large messages. Group fields,
+  // map entries, and extensions are always parsed eagerly.
+  kUpb_DecodeOption_LazySubMessage = 8,
+
+  // If set, the decoder makes a cheap structural pre-pass over the buffer
+  // that counts elements of the message's top-level repeated fields, and
+  // creates each array at its final size instead of growing it by doubling.
+  // Worthwhile for messages dominated by large repeated fields, where it
+  // removes every intermediate array copy; a small waste of work otherwise.
+  // The pre-pass is best-effort and purely structural: malformed input simply
+  // leaves the remaining counts partial and is rejected by the real parse.
+  kUpb_DecodeOption_PreScanArrays = 16,
+
+  // If set, each parsed sub-message additionally records the offset and
+  // length of its original wire bytes (no effect unless
+  // kUpb_DecodeOption_AliasString is also set).  As long as a sub-message
+  // and everything below it have not been touched through a mutating
+  // accessor, upb_Encode() copies the retained bytes verbatim instead of
+  // re-walking the subtree, which makes read-modify-write round trips of
+  // large messages proportional to the part that changed.  The retained
+  // spans alias the input buffer and carry the same buffer-lifetime contract
+  // as kUpb_DecodeOption_AliasString.
+  // Extendable sub-messages and sub-messages whose layout contains a map
+  // field never record a span.
+  kUpb_DecodeOption_RetainWireBytes = 32,
+
+  // If set, string and bytes fields above a small length threshold are
+  // interned in a per-arena table instead of each occurrence getting its own
+  // arena copy, so identical strings (enum-like labels, hostnames, etc.)
+  // share one allocation.  The table persists on the arena, deduplicating
+  // across every parse into it.  No effect on fields that alias the input
+  // buffer (kUpb_DecodeOption_AliasString), which already share storage, and
+  // the fast-table parsers are bypassed when this option is set.  Interning
+  // hashes every eligible string, so this is a net win only for inputs with
+  // substantial duplication.
+  kUpb_DecodeOption_InternStrings = 64,
+
+  // If set, unknown fields are validated and skipped instead of being
+  // retained in the message's unknown-field buffer, including unrecognized
+  // closed-enum values and unknown MessageSet items.  For terminal consumers
+  // of mixed-version traffic this reclaims the memory (and copying) spent
+  // preserving data that will never be re-serialized; proxies that re-encode
+  // must not use it, since the dropped fields cannot be round-tripped.  Does
+  // not affect the deferred payloads of kUpb_DecodeOption_LazySubMessage or
+  // unlinked sub-messages, which are stored through the same buffer but are
+  // message content, not unknown fields.  For stripping already-parsed
+  // graphs, see upb_Message_DeepDiscardUnknown() in message/copy.h.
+  kUpb_DecodeOption_DiscardUnknown = 128,
 };
 
 UPB_INLINE uint32_t upb_DecodeOptions_MaxDepth(uint16_t depth) {
@@ -132,13 +188,69 @@ typedef enum {
   // kUpb_DecodeOptions_ExperimentalAllowUnlinked was not specified in the list
   // of options.
   kUpb_DecodeStatus_UnlinkedSubMessage = 6,
+
+  // A quota given to upb_Decode_WithLimits() was exhausted.  The message is
+  // partially decoded; the input may well have been valid.
+  kUpb_DecodeStatus_QuotaExceeded = 7,
+
+  // Returned by upb_Decode_Resumable() (see decode_resumable.h) when the
+  // byte budget ran out before the end of the input; call again to continue.
+  // Never returned by upb_Decode().
+  kUpb_DecodeStatus_Suspended = 8,
 } upb_DecodeStatus;
 
+// Per-decode resource quotas, enforced inside the decoder so a pathological
+// input (e.g. a packed array that expands 30x in memory) fails fast with
+// kUpb_DecodeStatus_QuotaExceeded instead of exhausting the process.  A zero
+// in either field means that resource is unlimited.
+typedef struct {
+  // Maximum bytes of new arena block memory this decode may allocate.  Space
+  // already available in the arena's current block is not charged, so this
+  // bounds the decode's memory growth, not the arena's total size.
+  size_t max_arena_bytes;
+
+  // Maximum number of array elements and map entries this decode may create,
+  // totaled across the whole message tree.  Enforcing an element quota
+  // disables the fast-table parsers, which do not meter their appends.
+  size_t max_elements;
+} upb_DecodeLimits;
+
 UPB_API upb_DecodeStatus upb_Decode(const char* buf, size_t size,
                                     upb_Message* msg, const upb_MiniTable* l,
                                     const upb_ExtensionRegistry* extreg,
                                     int options, upb_Arena* arena);
 
+// Like upb_Decode(), but enforces the quotas in |limits| (which may be NULL
+// for no quotas).  On kUpb_DecodeStatus_QuotaExceeded the arena retains what
+// was allocated before the quota tripped, as with any failed decode.
+UPB_API upb_DecodeStatus upb_Decode_WithLimits(
+    const char* buf, size_t size, upb_Message* msg, const upb_MiniTable* l,
+    const upb_ExtensionRegistry* extreg, int options, upb_Arena* arena,
+    const upb_DecodeLimits* limits);
+
+// Like upb_Decode(), but only parses the top-level fields of |l| whose field
+// numbers appear in |field_numbers| (|field_count| entries, in any order).
+// All other top-level fields are skipped structurally -- no arrays, strings,
+// maps, or sub-messages are allocated for them, and they are NOT preserved as
+// unknown fields, so cost is proportional to the selected data.  Fields inside
+// selected sub-messages are parsed in full.  Note that a skipped required
+// field will trip kUpb_DecodeOption_CheckRequired.
+UPB_API upb_DecodeStatus upb_Decode_Selective(
+    const char* buf, size_t size, upb_Message* msg, const upb_MiniTable* l,
+    const upb_ExtensionRegistry* extreg, int options, upb_Arena* arena,
+    const uint32_t* field_numbers, size_t field_count);
+
+// Decodes from a refcounted buffer (see mem/shared_buffer.h), implying
+// kUpb_DecodeOption_AliasString.  A reference to |buf| is attached to |arena|
+// so that aliased upb_StringViews in the decoded message remain valid until
+// the arena (or the fused group it joins) is freed.  This makes aliasing safe
+// without the caller reasoning about buffer lifetime.
+UPB_API upb_DecodeStatus upb_Decode_Shared(upb_SharedBuffer* buf,
+                                           upb_Message* msg,
+                                           const upb_MiniTable* l,
+                                           const upb_ExtensionRegistry* extreg,
+                                           int options, upb_Arena* arena);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
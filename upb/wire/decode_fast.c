@@ -38,7 +38,12 @@
 #include "upb/wire/decode_fast.h"
 
 #include "upb/collections/array_internal.h"
+#include "upb/collections/map_internal.h"
+#include "upb/message/internal/map_entry.h"
+#include "upb/mini_table/enum.h"
 #include "upb/wire/decode_internal.h"
+#include "upb/wire/decode_telemetry.h"
+#include "upb/wire/types.h"
 
 // Must be last.
 #include "upb/port/def.inc"
@@ -53,11 +58,14 @@
 
 #define UPB_PARSE_ARGS d, ptr, msg, table, hasbits, data
 
-#define RETURN_GENERIC(m)                                 \
-  /* Uncomment either of these for debugging purposes. */ \
-  /* fprintf(stderr, m); */                               \
-  /*__builtin_trap(); */                                  \
-  return _upb_FastDecoder_DecodeGeneric(d, ptr, msg, table, hasbits, 0);
+#define RETURN_GENERIC(m)                                                  \
+  do {                                                                     \
+    /* Uncomment either of these for debugging purposes. */                \
+    /* fprintf(stderr, m); */                                              \
+    /*__builtin_trap(); */                                                 \
+    UPB_DECODE_TELEMETRY_FALLBACK(decode_totablep(table), m);              \
+    return _upb_FastDecoder_DecodeGeneric(d, ptr, msg, table, hasbits, 0); \
+  } while (0)
 
 typedef enum {
   CARD_s = 0, /* Singular (optional, non-repeated) */
@@ -404,6 +412,19 @@ static const char* fastdecode_topackedvarint(upb_EpsCopyInputStream* e,
   uint64_t val;
 
   while (!_upb_Decoder_IsDone(d, &ptr)) {
+    uint64_t word;
+    while (_upb_Decoder_PeekEightOneByteVarints(d, ptr, &word)) {
+      // Batch path: eight single-byte varints decoded with one bounds check.
+      for (int i = 0; i < 8; i++) {
+        dst = fastdecode_resizearr(d, dst, &data->farr, data->valbytes);
+        val = fastdecode_munge((word >> (i * 8)) & 0xff, data->valbytes,
+                               data->zigzag);
+        memcpy(dst, &val, data->valbytes);
+        dst = (char*)dst + data->valbytes;
+      }
+      ptr += 8;
+    }
+    if (_upb_Decoder_IsDone(d, &ptr)) break;
     dst = fastdecode_resizearr(d, dst, &data->farr, data->valbytes);
     ptr = fastdecode_varint64(ptr, &val);
     if (ptr == NULL) return NULL;
@@ -492,6 +513,98 @@ TAGBYTES(p)
 #undef FASTDECODE_PACKEDVARINT
 #undef FASTDECODE_VARINT
 
+/* closed enum fields *********************************************************/
+
+// Closed enums must check each value against the enum table, routing
+// out-of-range values to the unknown fields.  The check itself is cheap (for
+// values below 64 it is a single bitmask test), so it runs inline; only the
+// rare out-of-range value falls back to the generic parser, which owns the
+// unknown-field bookkeeping.  The enum sub-table index rides in the byte of
+// |data| that message fields use for their sub-table index.
+
+UPB_FORCEINLINE
+static bool fastdecode_checkenum(const char* ptr, const upb_MiniTableEnum* e) {
+  uint64_t val;
+  return fastdecode_varint64(ptr, &val) != NULL &&
+         upb_MiniTableEnum_CheckValue(e, (uint32_t)val);
+}
+
+#define FASTDECODE_ENUM(d, ptr, msg, table, hasbits, data, tagbytes, card)     \
+  uint64_t val;                                                                \
+  void* dst;                                                                   \
+  fastdecode_arr farr;                                                         \
+  const upb_MiniTableEnum* enumtable;                                          \
+                                                                               \
+  if (UPB_UNLIKELY(!fastdecode_checktag(data, tagbytes))) {                    \
+    /* Includes the packed representation of a repeated closed enum; the */    \
+    /* generic path batch-validates those runs off the bitmask. */             \
+    RETURN_GENERIC("enum field tag mismatch\n");                               \
+  }                                                                            \
+                                                                               \
+  enumtable = decode_totablep(table)->subs[(data >> 16) & 0xff].subenum;       \
+                                                                               \
+  if (UPB_UNLIKELY(!fastdecode_checkenum(ptr + tagbytes, enumtable))) {        \
+    /* Out-of-range (or malformed) value: fall back before any hasbit, */      \
+    /* oneof case, or array store becomes visible. */                          \
+    RETURN_GENERIC("closed enum value out of range\n");                        \
+  }                                                                            \
+                                                                               \
+  dst = fastdecode_getfield(d, ptr, msg, &data, &hasbits, &farr, 4, card);     \
+                                                                               \
+  again:                                                                       \
+  if (card == CARD_r) {                                                        \
+    dst = fastdecode_resizearr(d, dst, &farr, 4);                              \
+  }                                                                            \
+                                                                               \
+  ptr += tagbytes;                                                             \
+  ptr = fastdecode_varint64(ptr, &val);                                        \
+  UPB_ASSERT(ptr != NULL); /* Validated by fastdecode_checkenum(). */          \
+  memcpy(dst, &val, 4);                                                        \
+                                                                               \
+  if (card == CARD_r) {                                                        \
+    fastdecode_nextret ret =                                                   \
+        fastdecode_nextrepeated(d, dst, &ptr, &farr, data, tagbytes, 4);       \
+    switch (ret.next) {                                                        \
+      case FD_NEXT_SAMEFIELD:                                                  \
+        dst = ret.dst;                                                         \
+        if (UPB_LIKELY(fastdecode_checkenum(ptr + tagbytes, enumtable))) {     \
+          goto again;                                                          \
+        }                                                                      \
+        /* Commit what we have; the generic path takes over at this tag. */    \
+        fastdecode_commitarr(dst, &farr, 4);                                   \
+        RETURN_GENERIC("closed enum value out of range\n");                    \
+      case FD_NEXT_OTHERFIELD:                                                 \
+        data = ret.tag;                                                        \
+        UPB_MUSTTAIL return _upb_FastDecoder_TagDispatch(UPB_PARSE_ARGS);      \
+      case FD_NEXT_ATLIMIT:                                                    \
+        return ptr;                                                            \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  UPB_MUSTTAIL return fastdecode_dispatch(UPB_PARSE_ARGS);
+
+/* Generate all combinations:
+ * {s,o,r} x e4 x {1bt,2bt} */
+
+#define F(card, tagbytes)                                                   \
+  UPB_NOINLINE                                                              \
+  const char* upb_p##card##e4_##tagbytes##bt(UPB_PARSE_PARAMS) {            \
+    FASTDECODE_ENUM(d, ptr, msg, table, hasbits, data, tagbytes,            \
+                    CARD_##card);                                           \
+  }
+
+#define TAGBYTES(card) \
+  F(card, 1)           \
+  F(card, 2)
+
+TAGBYTES(s)
+TAGBYTES(o)
+TAGBYTES(r)
+
+#undef F
+#undef TAGBYTES
+#undef FASTDECODE_ENUM
+
 /* fixed fields ***************************************************************/
 
 #define FASTDECODE_UNPACKEDFIXED(d, ptr, msg, table, hasbits, data, tagbytes, \
@@ -934,7 +1047,7 @@ static const char* fastdecode_tosubmsg(upb_EpsCopyInputStream* e,
   fastdecode_submsgdata submsg = {decode_totable(subtablep)};             \
   fastdecode_arr farr;                                                    \
                                                                           \
-  if (subtablep->table_mask == (uint8_t)-1) {                             \
+  if (subtablep->table_mask == (uint16_t)-1) {                            \
     RETURN_GENERIC("submessage doesn't have fast tables.");               \
   }                                                                       \
                                                                           \
@@ -1011,4 +1124,214 @@ TAGBYTES(r)
 #undef F
 #undef FASTDECODE_SUBMSG
 
+/* map fields *****************************************************************/
+
+// Returns the one-byte tag we expect for the given map entry field, or zero if
+// this field cannot be handled by the fast path (message/group values and
+// closed enums, which require validation against the enum table).
+UPB_FORCEINLINE
+static uint8_t fastdecode_mapentrytag(const upb_MiniTableField* f,
+                                      int field_number) {
+  uint8_t wire_type;
+  switch (f->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Bool:
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_UInt32:
+    case kUpb_FieldType_Int64:
+    case kUpb_FieldType_UInt64:
+    case kUpb_FieldType_SInt32:
+    case kUpb_FieldType_SInt64:
+      wire_type = kUpb_WireType_Varint;
+      break;
+    case kUpb_FieldType_Fixed32:
+    case kUpb_FieldType_SFixed32:
+    case kUpb_FieldType_Float:
+      wire_type = kUpb_WireType_32Bit;
+      break;
+    case kUpb_FieldType_Fixed64:
+    case kUpb_FieldType_SFixed64:
+    case kUpb_FieldType_Double:
+      wire_type = kUpb_WireType_64Bit;
+      break;
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes:
+      wire_type = kUpb_WireType_Delimited;
+      break;
+    default:
+      return 0;
+  }
+  return (field_number << 3) | wire_type;
+}
+
+// Parses one scalar key or value of a map entry into |dst|, bounded by |end|.
+// Returns NULL if the value is malformed or doesn't fit in the entry; the
+// caller falls back to the generic path in that case without having consumed
+// anything from the input stream.
+UPB_FORCEINLINE
+static const char* fastdecode_mapvalue(upb_Decoder* d, const char* ptr,
+                                       const char* end,
+                                       const upb_MiniTableField* f, void* dst) {
+  uint64_t val;
+  int valbytes;
+  bool zigzag = false;
+  switch (f->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes: {
+      if (ptr == end) return NULL;
+      int size = (uint8_t)*ptr++;
+      // The whole entry is < 128 bytes, so a valid size is one byte.
+      if (UPB_UNLIKELY((size & 0x80) || size > end - ptr)) return NULL;
+      const char* s_ptr = ptr;
+      const char* ret = upb_EpsCopyInputStream_ReadString(&d->input, &s_ptr,
+                                                          size, &d->arena);
+      if (!ret) _upb_FastDecoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);
+      if (f->UPB_PRIVATE(descriptortype) == kUpb_FieldType_String &&
+          !_upb_Decoder_VerifyUtf8Inline(s_ptr, size)) {
+        _upb_FastDecoder_ErrorJmp(d, kUpb_DecodeStatus_BadUtf8);
+      }
+      upb_StringView* view = dst;
+      view->data = s_ptr;
+      view->size = size;
+      return ret;
+    }
+    case kUpb_FieldType_Fixed64:
+    case kUpb_FieldType_SFixed64:
+    case kUpb_FieldType_Double:
+      if (end - ptr < 8) return NULL;
+      memcpy(dst, ptr, 8);
+      return ptr + 8;
+    case kUpb_FieldType_Fixed32:
+    case kUpb_FieldType_SFixed32:
+    case kUpb_FieldType_Float:
+      if (end - ptr < 4) return NULL;
+      memcpy(dst, ptr, 4);
+      return ptr + 4;
+    case kUpb_FieldType_Bool:
+      valbytes = 1;
+      break;
+    case kUpb_FieldType_SInt32:
+      zigzag = true;
+      valbytes = 4;
+      break;
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_UInt32:
+      valbytes = 4;
+      break;
+    case kUpb_FieldType_SInt64:
+      zigzag = true;
+      valbytes = 8;
+      break;
+    default:
+      valbytes = 8;
+      break;
+  }
+
+  // Bounded varint parse: a varint must not extend past the entry.
+  int shift = 0;
+  uint8_t byte;
+  val = 0;
+  do {
+    if (UPB_UNLIKELY(ptr == end || shift >= 70)) return NULL;
+    byte = (uint8_t)*ptr++;
+    val += (uint64_t)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  val = fastdecode_munge(val, valbytes, zigzag);
+  memcpy(dst, &val, valbytes);
+  return ptr;
+}
+
+#define FASTDECODE_MAP(d, ptr, msg, table, hasbits, data, tagbytes)           \
+  if (UPB_UNLIKELY(!fastdecode_checktag(data, tagbytes))) {                   \
+    RETURN_GENERIC("map field tag mismatch\n");                               \
+  }                                                                           \
+                                                                              \
+  uint32_t submsg_idx = (data >> 16) & 0xff;                                  \
+  const upb_MiniTable* tablep = decode_totablep(table);                       \
+  const upb_MiniTable* entry = tablep->subs[submsg_idx].submsg;               \
+  const upb_MiniTableField* kf = &entry->fields[0];                           \
+  const upb_MiniTableField* vf = &entry->fields[1];                           \
+  uint8_t ktag = fastdecode_mapentrytag(kf, 1);                               \
+  uint8_t vtag = fastdecode_mapentrytag(vf, 2);                               \
+                                                                              \
+  if (UPB_UNLIKELY(ktag == 0 || vtag == 0)) {                                 \
+    RETURN_GENERIC("unsupported map entry type\n");                           \
+  }                                                                           \
+                                                                              \
+  /* Fast path requires a one-byte size with the whole entry available in */  \
+  /* the current buffer; longer entries take the generic path.            */  \
+  int len = (int8_t)ptr[tagbytes];                                            \
+  const char* entry_start = ptr + tagbytes + 1;                               \
+  if (UPB_UNLIKELY(len < 0 || !upb_EpsCopyInputStream_CheckDataSizeAvailable( \
+                                  &d->input, entry_start, len))) {            \
+    RETURN_GENERIC("long or split map entry\n");                              \
+  }                                                                           \
+                                                                              \
+  upb_MapEntry ent;                                                           \
+  memset(&ent, 0, sizeof(ent));                                               \
+  const char* p = entry_start;                                                \
+  const char* end = entry_start + len;                                        \
+                                                                              \
+  while (p < end) {                                                           \
+    uint8_t tag = (uint8_t)*p++;                                              \
+    if (tag == ktag) {                                                        \
+      p = fastdecode_mapvalue(d, p, end, kf, &ent.data.k);                    \
+    } else if (tag == vtag) {                                                 \
+      p = fastdecode_mapvalue(d, p, end, vf, &ent.data.v);                    \
+    } else {                                                                  \
+      /* Unknown field in the entry; the generic path preserves it. */        \
+      p = NULL;                                                               \
+    }                                                                         \
+    if (p == NULL) {                                                          \
+      /* Nothing has been consumed yet, so a full reparse is safe. */         \
+      RETURN_GENERIC("malformed or unknown data in map entry\n");             \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  upb_Map** map_p = fastdecode_fieldmem(msg, data);                           \
+  upb_Map* map = *map_p;                                                      \
+  if (!map) {                                                                 \
+    map = _upb_Decoder_CreateMap(d, entry);                                   \
+    *map_p = map;                                                             \
+  }                                                                           \
+                                                                              \
+  if (_upb_Map_Insert(map, &ent.data.k, map->key_size, &ent.data.v,           \
+                      map->val_size,                                          \
+                      &d->arena) == kUpb_MapInsertStatus_OutOfMemory) {       \
+    _upb_FastDecoder_ErrorJmp(d, kUpb_DecodeStatus_OutOfMemory);              \
+  }                                                                           \
+                                                                              \
+  ptr = end;                                                                  \
+  UPB_MUSTTAIL return fastdecode_dispatch(UPB_PARSE_ARGS);
+
+#define F(tagbytes)                                             \
+  UPB_NOINLINE                                                  \
+  const char* upb_pmm_##tagbytes##bt(UPB_PARSE_PARAMS) {        \
+    FASTDECODE_MAP(d, ptr, msg, table, hasbits, data, tagbytes) \
+  }
+
+F(1)
+F(2)
+
+#undef F
+#undef FASTDECODE_MAP
+
+/* custom parser re-entry (see decode_fast_plugin.h) **************************/
+
+// Out-of-line wrapper around fastdecode_dispatch() for custom parsers in
+// other translation units, which cannot reach the static inline directly.
+const char* upb_FastParser_Resume(UPB_PARSE_PARAMS) {
+  UPB_MUSTTAIL return fastdecode_dispatch(UPB_PARSE_ARGS);
+}
+
+#else /* !UPB_FASTTABLE */
+
+// Fast dispatch never runs on this platform, but custom parsers written
+// against decode_fast_plugin.h must still link.
+const char* upb_FastParser_Resume(struct upb_Decoder* d, const char* ptr,
+                                  upb_Message* msg, intptr_t table,
+                                  uint64_t hasbits, uint64_t data) {
+  return _upb_FastDecoder_DecodeGeneric(d, ptr, msg, table, hasbits, data);
+}
+
 #endif /* UPB_FASTTABLE */
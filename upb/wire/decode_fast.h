@@ -42,6 +42,7 @@
 //   - 'o' for oneof
 //   - 'r' for non-packed repeated
 //   - 'p' for packed repeated
+//   - 'm' for map
 //
 // In position 3 (type):
 //   - 'b1' for bool
@@ -49,6 +50,7 @@
 //   - 'v8' for 8-byte varint
 //   - 'z4' for zig-zag-encoded 4-byte varint
 //   - 'z8' for zig-zag-encoded 8-byte varint
+//   - 'e4' for closed enum (validated against the enum table)
 //   - 'f4' for 4-byte fixed
 //   - 'f8' for 8-byte fixed
 //   - 'm' for sub-message
@@ -111,6 +113,26 @@ TAGBYTES(p)
 #undef TYPES
 #undef TAGBYTES
 
+/* closed enum fields *********************************************************/
+
+// Closed enums validate inline against the enum table, whose sub-table index
+// is carried in the data word.  Packed closed enums use the generic path,
+// which batch-validates whole runs.
+
+#define F(card, tagbytes) \
+  const char* upb_p##card##e4_##tagbytes##bt(UPB_PARSE_PARAMS);
+
+#define TAGBYTES(card) \
+  F(card, 1)           \
+  F(card, 2)
+
+TAGBYTES(s)
+TAGBYTES(o)
+TAGBYTES(r)
+
+#undef F
+#undef TAGBYTES
+
 /* string fields **************************************************************/
 
 #define F(card, tagbytes, type)                                     \
@@ -156,6 +178,13 @@ TAGBYTES(r)
 #undef SIZES
 #undef F
 
+/* map fields *****************************************************************/
+
+// Map entries with scalar keys and values are parsed with a single function
+// per tag length; the key/value types are read from the entry mini table.
+const char* upb_pmm_1bt(UPB_PARSE_PARAMS);
+const char* upb_pmm_2bt(UPB_PARSE_PARAMS);
+
 #undef UPB_PARSE_PARAMS
 
 #ifdef __cplusplus
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2009-2022, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/wire/decode_fast_plugin.h"
+
+#include <string.h>
+
+// Must be last.
+#include "upb/port/def.inc"
+
+// Computes the fast-table slot for |field_number|/|wire_type| and writes the
+// two-byte-little-endian encoded tag to |encoded_tag|.  The slot is selected
+// by tag bits 3..10, matching GetTableSlot() in the generator, so it depends
+// only on the field number.  Returns -1 if the tag needs more than two bytes.
+static int upb_FastTable_Slot(uint32_t field_number, upb_WireType wire_type,
+                              uint64_t* encoded_tag) {
+  uint32_t tag = (field_number << 3) | wire_type;
+  if (tag > 0x3fff) return -1;  // Needs a three-byte varint.
+  uint64_t encoded =
+      tag < 0x80 ? tag : (tag & 0x7f) | 0x80 | ((uint64_t)(tag >> 7) << 8);
+  *encoded_tag = encoded;
+  return (encoded & 0x7f8) >> 3;
+}
+
+upb_MiniTable* upb_MiniTable_CloneWithFastTable(const upb_MiniTable* m,
+                                                uint32_t max_field_number,
+                                                upb_Arena* arena) {
+  uint64_t encoded_tag;
+  int max_slot = upb_FastTable_Slot(max_field_number, 0, &encoded_tag);
+  if (max_slot < 0) return NULL;
+
+  const size_t old_slots =
+      m->table_mask == (uint16_t)-1 ? 0 : (m->table_mask >> 3) + 1;
+  size_t slots = 1;
+  while (slots < old_slots || (int)slots <= max_slot) slots *= 2;
+
+  upb_MiniTable* clone = upb_Arena_Malloc(
+      arena, sizeof(*clone) + slots * sizeof(_upb_FastTable_Entry));
+  if (!clone) return NULL;
+
+  memcpy(clone, m, sizeof(*clone));
+  clone->table_mask = (uint16_t)((slots - 1) << 3);
+
+  // Occupied slots were assigned from tag bits 3..10, so they keep their
+  // index under the (equal or wider) new mask.
+  memcpy(clone->fasttable, m->fasttable,
+         old_slots * sizeof(_upb_FastTable_Entry));
+  for (size_t i = old_slots; i < slots; i++) {
+    clone->fasttable[i].field_data = 0;
+    clone->fasttable[i].field_parser = &_upb_FastDecoder_DecodeGeneric;
+  }
+  return clone;
+}
+
+bool upb_MiniTable_SetFastTableEntry(upb_MiniTable* m, uint32_t field_number,
+                                     upb_WireType wire_type,
+                                     upb_FastFieldParser* parser,
+                                     uint64_t data) {
+  UPB_ASSERT((data & 0xffff) == 0);
+
+  uint64_t encoded_tag;
+  int slot = upb_FastTable_Slot(field_number, wire_type, &encoded_tag);
+  if (slot < 0 || m->table_mask == (uint16_t)-1 ||
+      (size_t)slot > (size_t)(m->table_mask >> 3)) {
+    return false;
+  }
+
+  // For a one-byte tag the dispatcher's slot index includes bits of the
+  // (junk) byte following the tag, so the entry must occupy every slot the
+  // index can alias to; otherwise it would only be hit for some junk bytes.
+  // Each entry verifies the tag before committing, so displaced entries
+  // degrade to the generic path rather than misparsing.
+  const size_t stride = encoded_tag <= 0xff ? 32 : (size_t)(m->table_mask >> 3) + 1;
+  for (size_t idx = slot; idx <= (size_t)(m->table_mask >> 3); idx += stride) {
+    _upb_FastTable_Entry* ent = &m->fasttable[idx];
+    ent->field_data = data | encoded_tag;
+    ent->field_parser = parser;
+  }
+  return true;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2009-2022, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Registration of custom field parsers into the fast-table dispatch.
+//
+// The fast parser dispatches on the first two tag bytes through a per-message
+// table of function pointers (upb_MiniTable.fasttable); the functions are
+// normally the generated upb_p* parsers from decode_fast.h.  The interface
+// here lets a user install their own parser for a specific (message, field)
+// pair -- for example a domain-specific decoder for a bytes field -- without
+// modifying decode_fast.c.  Because generated MiniTables are const and
+// runtime-built MiniTables have no fasttable region at all, registration
+// operates on a copy:
+//
+//   upb_MiniTable* mt = upb_MiniTable_CloneWithFastTable(src, 5, arena);
+//   upb_MiniTable_SetFastTableEntry(mt, 5, kUpb_WireType_Delimited,
+//                                   &MyParser, my_data << 16);
+//
+// and the copy is then passed to upb_Decode() in place of the original.
+//
+// A custom parser runs under the same contract as the generated parsers:
+//  - It is invoked whenever dispatch selects its slot, which can happen for
+//    tags other than its own (colliding slots, or a partial mask match).  It
+//    must verify the tag with upb_FastParser_TagMatches() and tail-call
+//    _upb_FastDecoder_DecodeGeneric() on a mismatch, leaving |ptr| untouched.
+//  - |data| is the registered data word XOR the two tag bytes loaded from the
+//    input; the registered payload is recovered with upb_FastParser_Data().
+//  - On success it must tail-call upb_FastParser_Resume() with |ptr| past the
+//    consumed field and |hasbits| preserved, to continue fast parsing.
+//  - On malformed or unsupported input it may always fall back to
+//    _upb_FastDecoder_DecodeGeneric(), which re-parses the field generically
+//    and reports any error.
+
+#ifndef UPB_WIRE_DECODE_FAST_PLUGIN_H_
+#define UPB_WIRE_DECODE_FAST_PLUGIN_H_
+
+#include "upb/mem/arena.h"
+#include "upb/mini_table/message.h"
+#include "upb/wire/decode_fast.h"
+#include "upb/wire/types.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The function type of a fast-table entry.  The signature (and therefore the
+// ABI contract with the dispatcher) is the same one the generated parsers use.
+typedef _upb_FieldParser upb_FastFieldParser;
+
+// Recovers the payload registered with upb_MiniTable_SetFastTableEntry() from
+// the |data| argument (whose low 16 bits carry the XOR'd tag bytes).
+UPB_INLINE uint64_t upb_FastParser_Data(uint64_t data) { return data >> 16; }
+
+// Returns true if |data| indicates that dispatch matched this entry's
+// registered tag.  |tagbytes| is 1 for field numbers 1-15 and 2 for 16-2047;
+// for one-byte tags the high byte of |data| is the (junk) byte after the tag.
+UPB_INLINE bool upb_FastParser_TagMatches(uint64_t data, int tagbytes) {
+  return tagbytes == 1 ? (data & 0xff) == 0 : (data & 0xffff) == 0;
+}
+
+// Continues fast-table parsing at |ptr|, which must point just past the
+// consumed field.  Custom parsers tail-call this on success, passing their
+// other arguments through unchanged (in particular |hasbits|).
+const char* upb_FastParser_Resume(struct upb_Decoder* d, const char* ptr,
+                                  upb_Message* msg, intptr_t table,
+                                  uint64_t hasbits, uint64_t data);
+
+// Returns a copy of |m| in |arena| whose fasttable region has a slot for
+// every field number up to |max_field_number| (at most 2047; one slot can
+// serve several field numbers, see below).  Entries present in |m| -- the
+// generated fast parsers -- are preserved; new slots dispatch to the generic
+// parser, so the copy parses identically until entries are registered.  The
+// field and sub-table arrays are shared with |m|, not copied, and the copy
+// must not outlive them.  Returns NULL on allocation failure or if
+// |max_field_number| cannot be dispatched.
+upb_MiniTable* upb_MiniTable_CloneWithFastTable(const upb_MiniTable* m,
+                                                uint32_t max_field_number,
+                                                upb_Arena* arena);
+
+// Installs |parser| as the fast-table entry for |field_number| parsed with
+// |wire_type|.  |m| must have been returned by
+// upb_MiniTable_CloneWithFastTable() with a covering field number.  |data| is
+// the payload passed to the parser; its low 16 bits must be zero (they carry
+// the encoded tag).  Replaces whatever entry occupied the slot, including a
+// generated parser for a different field number that happens to share it; a
+// displaced field keeps parsing correctly through the new entry's generic
+// fallback, just without the fast path.  One-byte-tag entries are written to
+// every aliasing slot (in tables of more than 32 slots the dispatch index
+// includes bits of the byte after the tag), so they may displace several
+// entries.  Returns false if |field_number|'s tag cannot be dispatched by
+// |m|'s table.
+bool upb_MiniTable_SetFastTableEntry(upb_MiniTable* m, uint32_t field_number,
+                                     upb_WireType wire_type,
+                                     upb_FastFieldParser* parser,
+                                     uint64_t data);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_WIRE_DECODE_FAST_PLUGIN_H_ */
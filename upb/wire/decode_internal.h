@@ -39,11 +39,43 @@
 #include "upb/wire/eps_copy_input_stream.h"
 #include "utf8_range.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 // Must be last.
 #include "upb/port/def.inc"
 
 #define DECODE_NOGROUP (uint32_t) - 1
 
+// One level of message nesting for the explicit-stack decode loop in
+// _upb_Decoder_DecodeMessage().  Frames live in a decoder-managed array
+// allocated from the arena, so nesting depth is bounded only by d->depth,
+// not by thread stack.
+typedef struct {
+  upb_Message* msg;
+  const upb_MiniTable* layout;
+  int last_field_index;
+  int saved_delta;        // PushLimit() delta, for delimited frames.
+  uint32_t group_number;  // Field number of the group, else DECODE_NOGROUP.
+  // Original wire bytes to record on the sub-message when the frame is
+  // popped (kUpb_DecodeOption_RetainWireBytes), or NULL.
+  const char* span_start;
+  uint32_t span_size;
+} _upb_DecoderFrame;
+
+// Charges upb_DecodeLimits::max_arena_bytes against every new arena block
+// the decode requests, delegating the actual allocation to |parent| (the
+// arena's real block allocator).
+typedef struct {
+  upb_alloc alloc;  // Must be first so upb_alloc* casts back to this struct.
+  upb_alloc* parent;
+  size_t remaining;
+  bool exceeded;
+} _upb_DecoderMemBudget;
+
 typedef struct upb_Decoder {
   upb_EpsCopyInputStream input;
   const upb_ExtensionRegistry* extreg;
@@ -51,9 +83,27 @@ typedef struct upb_Decoder {
   upb_Message* unknown_msg;  // Pointer to preserve data to
   int depth;                 // Tracks recursion depth to bound stack usage.
   uint32_t end_group;  // field number of END_GROUP tag, else DECODE_NOGROUP.
+  const uint32_t* select_fields;  // Top-level field filter; NULL = all fields.
+  size_t select_count;
+  int select_depth;  // The d->depth value of the top-level message.
+  _upb_DecoderFrame* frames;  // Explicit stack for sub-message decoding.
+  size_t frame_count;
+  size_t frame_capacity;
+  // Element counts for top-level repeated fields, indexed parallel to
+  // presize_layout->fields; NULL unless kUpb_DecodeOption_PreScanArrays.
+  const upb_MiniTable* presize_layout;
+  const uint32_t* presize_counts;
   uint16_t options;
   bool missing_required;
+  // Remaining array-element/map-entry quota
+  // (upb_DecodeLimits::max_elements), or SIZE_MAX when unmetered.
+  size_t elem_budget;
+  _upb_DecoderMemBudget mem_budget;  // Only wired up when a byte quota is set.
   upb_Arena arena;
+  // The caller's arena that |arena| above is a temporary copy of.  For
+  // objects that store their arena (eg. upb_Map), since a pointer to the
+  // copy would dangle once the decode returns.
+  upb_Arena* original_arena;
   upb_DecodeStatus status;
   jmp_buf err;
 
@@ -78,6 +128,21 @@ UPB_INLINE
 bool _upb_Decoder_VerifyUtf8Inline(const char* ptr, int len) {
   const char* end = ptr + len;
 
+#if defined(__SSE2__)
+  // Check 16 bytes at a time for any non-ASCII char.
+  while (end - ptr >= 16) {
+    __m128i data = _mm_loadu_si128((const __m128i*)ptr);
+    if (_mm_movemask_epi8(data) != 0) goto non_ascii;
+    ptr += 16;
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  while (end - ptr >= 16) {
+    uint8x16_t data = vld1q_u8((const uint8_t*)ptr);
+    if (vmaxvq_u8(data) >= 0x80) goto non_ascii;
+    ptr += 16;
+  }
+#endif
+
   // Check 8 bytes at a time for any non-ASCII char.
   while (end - ptr >= 8) {
     uint64_t data;
@@ -102,14 +167,19 @@ const char* _upb_Decoder_CheckRequired(upb_Decoder* d, const char* ptr,
                                        const upb_Message* msg,
                                        const upb_MiniTable* l);
 
+struct upb_Map;
+struct upb_Map* _upb_Decoder_CreateMap(upb_Decoder* d,
+                                       const upb_MiniTable* entry);
+
 /* x86-64 pointers always have the high 16 bits matching. So we can shift
- * left 8 and right 8 without loss of information. */
+ * left 16 and (arithmetic) right 16 without loss of information. This leaves
+ * room to carry the full 16-bit table mask alongside the table pointer. */
 UPB_INLINE intptr_t decode_totable(const upb_MiniTable* tablep) {
-  return ((intptr_t)tablep << 8) | tablep->table_mask;
+  return ((intptr_t)tablep << 16) | tablep->table_mask;
 }
 
 UPB_INLINE const upb_MiniTable* decode_totablep(intptr_t table) {
-  return (const upb_MiniTable*)(table >> 8);
+  return (const upb_MiniTable*)(table >> 16);
 }
 
 const char* _upb_Decoder_IsDoneFallback(upb_EpsCopyInputStream* e,
@@ -120,6 +190,19 @@ UPB_INLINE bool _upb_Decoder_IsDone(upb_Decoder* d, const char** ptr) {
       &d->input, ptr, &_upb_Decoder_IsDoneFallback);
 }
 
+// Loads the next eight input bytes into |*word| and returns true if they are
+// all single-byte varints (no continuation bits). Packed varint decoders use
+// this to bulk-decode runs of small values, which is by far the common case;
+// the widening stores vectorize well. Returns false near the end of the
+// current limit or buffer, where the scalar loop must take over.
+UPB_INLINE bool _upb_Decoder_PeekEightOneByteVarints(upb_Decoder* d,
+                                                     const char* ptr,
+                                                     uint64_t* word) {
+  if (d->input.limit_ptr - ptr < 8) return false;
+  memcpy(word, ptr, 8);
+  return (*word & 0x8080808080808080) == 0;
+}
+
 UPB_INLINE const char* _upb_Decoder_BufferFlipCallback(
     upb_EpsCopyInputStream* e, const char* old_end, const char* new_start) {
   upb_Decoder* d = (upb_Decoder*)e;
@@ -141,7 +224,7 @@ const char* _upb_FastDecoder_TagDispatch(upb_Decoder* d, const char* ptr,
                                          upb_Message* msg, intptr_t table,
                                          uint64_t hasbits, uint64_t tag) {
   const upb_MiniTable* table_p = decode_totablep(table);
-  uint8_t mask = table;
+  uint16_t mask = table;
   uint64_t data;
   size_t idx = tag & mask;
   UPB_ASSUME((idx & 7) == 0);
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/wire/decode_resumable.h"
+
+#include "upb/wire/types.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+// Reads a varint at |*ofs|, bounded by |size|.  Returns false if the buffer
+// ends mid-varint; overlong varints are left for upb_Decode() to reject.
+static bool upb_ResumableDecoder_ReadVarint(const char* buf, size_t size,
+                                            size_t* ofs, uint64_t* val) {
+  uint64_t out = 0;
+  int shift = 0;
+  while (*ofs < size && shift < 70) {
+    uint8_t byte = (uint8_t)buf[(*ofs)++];
+    out |= (uint64_t)(byte & 0x7f) << shift;
+    shift += 7;
+    if (!(byte & 0x80)) {
+      *val = out;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Advances |*ofs| past one whole top-level field (a group counts as one
+// field).  Returns false on truncated or structurally invalid data, which the
+// caller hands to upb_Decode() for a proper diagnosis.
+static bool upb_ResumableDecoder_SkipField(const char* buf, size_t size,
+                                           size_t* ofs) {
+  int group_depth = 0;
+  do {
+    uint64_t tag;
+    if (!upb_ResumableDecoder_ReadVarint(buf, size, ofs, &tag)) return false;
+    switch (tag & 7) {
+      case kUpb_WireType_Varint: {
+        uint64_t ignore;
+        if (!upb_ResumableDecoder_ReadVarint(buf, size, ofs, &ignore)) {
+          return false;
+        }
+        break;
+      }
+      case kUpb_WireType_64Bit:
+        if (size - *ofs < 8) return false;
+        *ofs += 8;
+        break;
+      case kUpb_WireType_32Bit:
+        if (size - *ofs < 4) return false;
+        *ofs += 4;
+        break;
+      case kUpb_WireType_Delimited: {
+        uint64_t len;
+        if (!upb_ResumableDecoder_ReadVarint(buf, size, ofs, &len) ||
+            size - *ofs < len) {
+          return false;
+        }
+        *ofs += len;
+        break;
+      }
+      case kUpb_WireType_StartGroup:
+        group_depth++;
+        break;
+      case kUpb_WireType_EndGroup:
+        if (group_depth == 0) return false;
+        group_depth--;
+        break;
+      default:
+        return false;  // Invalid wire type.
+    }
+  } while (group_depth > 0);
+  return true;
+}
+
+// Returns the end offset of the next slice: the largest top-level field
+// boundary within |max_bytes| of |d->offset|, but always at least one whole
+// field.  A truncated or invalid tail extends the slice to the end of the
+// buffer so that upb_Decode() reports the error.
+static size_t upb_ResumableDecoder_SliceEnd(const upb_ResumableDecoder* d,
+                                            size_t max_bytes) {
+  size_t end = d->offset;
+  while (end < d->size) {
+    size_t next = end;
+    if (!upb_ResumableDecoder_SkipField(d->buf, d->size, &next)) {
+      return d->size;
+    }
+    if (end != d->offset && next - d->offset > max_bytes) break;
+    end = next;
+    if (end - d->offset >= max_bytes) break;
+  }
+  return end;
+}
+
+void upb_ResumableDecoder_Init(upb_ResumableDecoder* d, const char* buf,
+                               size_t size, upb_Message* msg,
+                               const upb_MiniTable* l,
+                               const upb_ExtensionRegistry* extreg, int options,
+                               upb_Arena* arena) {
+  d->buf = buf;
+  d->size = size;
+  d->offset = 0;
+  d->msg = msg;
+  d->mt = l;
+  d->extreg = extreg;
+  d->options = options;
+  d->arena = arena;
+  d->status = kUpb_DecodeStatus_Ok;
+}
+
+upb_DecodeStatus upb_Decode_Resumable(upb_ResumableDecoder* d,
+                                      size_t max_bytes) {
+  if (d->status != kUpb_DecodeStatus_Ok) return d->status;
+  if (d->offset == d->size) return kUpb_DecodeStatus_Ok;
+
+  const size_t end = upb_ResumableDecoder_SliceEnd(d, max_bytes);
+  const bool final_slice = end == d->size;
+
+  // Required fields may legitimately occur in a later slice, so the check
+  // runs only over the final one (by which point the whole message has been
+  // merged in).
+  int options = d->options;
+  if (!final_slice) options &= ~kUpb_DecodeOption_CheckRequired;
+
+  const upb_DecodeStatus status =
+      upb_Decode(d->buf + d->offset, end - d->offset, d->msg, d->mt, d->extreg,
+                 options, d->arena);
+  if (status != kUpb_DecodeStatus_Ok) {
+    d->status = status;
+    return status;
+  }
+
+  d->offset = end;
+  return final_slice ? kUpb_DecodeStatus_Ok : kUpb_DecodeStatus_Suspended;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// upb_Decode_Resumable: decoding a fully-buffered message in bounded slices.
+//
+// For callers on a latency-sensitive thread (eg. an event loop) that must not
+// spend an unbounded amount of time in one upb_Decode() call.  Each call
+// decodes up to (roughly) |max_bytes| more of the input and then returns, so
+// the caller can interleave decode slices with other work instead of handing
+// the message to another thread.
+//
+// Slices are cut at top-level field boundaries; because the wire format
+// defines concatenation as field merging, the result after the final slice is
+// identical to a single upb_Decode() call over the whole buffer.  The byte
+// budget is therefore best-effort: a call always makes progress by decoding
+// at least one whole top-level field, so a single field larger than
+// |max_bytes| (eg. one giant sub-message) is decoded in one go.  This is the
+// pull-side counterpart of upb_DecodeStream (decode_stream.h), which cuts the
+// same boundaries on the push side.
+//
+// Unlike upb_DecodeStream, the input is one caller-owned flat buffer, so
+// kUpb_DecodeOption_AliasString works as usual (the buffer must outlive the
+// decoded message).  kUpb_DecodeOption_CheckRequired, if given, is applied
+// once, over the whole message, by the final slice.
+
+#ifndef UPB_WIRE_DECODE_RESUMABLE_H_
+#define UPB_WIRE_DECODE_RESUMABLE_H_
+
+#include "upb/wire/decode.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The continuation token for a resumable decode.  All fields are private; a
+// freshly zero-initialized struct is not valid, use
+// upb_ResumableDecoder_Init().
+typedef struct {
+  const char* buf;
+  size_t size;
+  size_t offset;
+  upb_Message* msg;
+  const upb_MiniTable* mt;
+  const upb_ExtensionRegistry* extreg;
+  int options;
+  upb_Arena* arena;
+  upb_DecodeStatus status;
+} upb_ResumableDecoder;
+
+// Prepares |d| to decode the |size| bytes at |buf| into |msg|.  No decoding
+// happens yet.  |buf|, |msg|, |l| and |extreg| must remain valid until the
+// decode completes (and beyond, for |buf|, if aliasing is requested).
+UPB_API void upb_ResumableDecoder_Init(upb_ResumableDecoder* d,
+                                       const char* buf, size_t size,
+                                       upb_Message* msg,
+                                       const upb_MiniTable* l,
+                                       const upb_ExtensionRegistry* extreg,
+                                       int options, upb_Arena* arena);
+
+// Decodes up to (roughly, see above) |max_bytes| more of the input.  Returns
+// kUpb_DecodeStatus_Suspended if input remains, kUpb_DecodeStatus_Ok when the
+// whole buffer has been decoded, and any other status on error.  Errors are
+// sticky: once a call fails, all subsequent calls return the same status.
+UPB_API upb_DecodeStatus upb_Decode_Resumable(upb_ResumableDecoder* d,
+                                              size_t max_bytes);
+
+// Returns the number of input bytes not yet decoded.
+UPB_API_INLINE size_t
+upb_ResumableDecoder_BytesRemaining(const upb_ResumableDecoder* d) {
+  return d->size - d->offset;
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_WIRE_DECODE_RESUMABLE_H_ */
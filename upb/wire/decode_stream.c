@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/wire/decode_stream.h"
+
+#include <string.h>
+
+#include "upb/wire/types.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+struct upb_DecodeStream {
+  upb_Message* msg;
+  const upb_MiniTable* mt;
+  const upb_ExtensionRegistry* extreg;
+  int options;
+  upb_Arena* arena;
+
+  // Bytes that have been pushed but not yet decoded because they end in the
+  // middle of a top-level field.
+  char* pending;
+  size_t pending_size;
+  size_t pending_cap;
+
+  upb_DecodeStatus status;  // Sticky; all calls fail once an error occurs.
+};
+
+// Reads a varint at |*ofs|, bounded by |size|. Returns false if the buffer
+// ends mid-varint; overlong varints are left for upb_Decode() to reject.
+static bool upb_DecodeStream_ReadVarint(const char* buf, size_t size,
+                                        size_t* ofs, uint64_t* val) {
+  uint64_t out = 0;
+  int shift = 0;
+  while (*ofs < size && shift < 70) {
+    uint8_t byte = (uint8_t)buf[(*ofs)++];
+    out |= (uint64_t)(byte & 0x7f) << shift;
+    shift += 7;
+    if (!(byte & 0x80)) {
+      *val = out;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the length of the longest prefix of |buf| that contains only whole
+// top-level fields. The scan is purely structural; malformed data simply
+// stops the scan and is diagnosed later by upb_Decode().
+static size_t upb_DecodeStream_FieldBoundary(const char* buf, size_t size) {
+  size_t ofs = 0;
+  size_t boundary = 0;
+  int group_depth = 0;
+
+  while (ofs < size) {
+    uint64_t tag;
+    if (!upb_DecodeStream_ReadVarint(buf, size, &ofs, &tag)) break;
+    switch (tag & 7) {
+      case kUpb_WireType_Varint: {
+        uint64_t ignore;
+        if (!upb_DecodeStream_ReadVarint(buf, size, &ofs, &ignore)) {
+          return boundary;
+        }
+        break;
+      }
+      case kUpb_WireType_64Bit:
+        if (size - ofs < 8) return boundary;
+        ofs += 8;
+        break;
+      case kUpb_WireType_32Bit:
+        if (size - ofs < 4) return boundary;
+        ofs += 4;
+        break;
+      case kUpb_WireType_Delimited: {
+        uint64_t len;
+        if (!upb_DecodeStream_ReadVarint(buf, size, &ofs, &len) ||
+            size - ofs < len) {
+          return boundary;
+        }
+        ofs += len;
+        break;
+      }
+      case kUpb_WireType_StartGroup:
+        group_depth++;
+        break;
+      case kUpb_WireType_EndGroup:
+        if (group_depth == 0) return boundary;  // Malformed; stop scanning.
+        group_depth--;
+        break;
+      default:
+        return boundary;  // Invalid wire type; stop scanning.
+    }
+    if (group_depth == 0) boundary = ofs;
+  }
+  return boundary;
+}
+
+static bool upb_DecodeStream_Append(upb_DecodeStream* s, const char* buf,
+                                    size_t size) {
+  if (s->pending_cap - s->pending_size < size) {
+    size_t need = s->pending_size + size;
+    size_t cap = UPB_MAX(s->pending_cap, 128);
+    while (cap < need) cap *= 2;
+    char* mem = upb_Arena_Realloc(s->arena, s->pending, s->pending_cap, cap);
+    if (!mem) return false;
+    s->pending = mem;
+    s->pending_cap = cap;
+  }
+  memcpy(s->pending + s->pending_size, buf, size);
+  s->pending_size += size;
+  return true;
+}
+
+static upb_DecodeStatus upb_DecodeStream_Decode(upb_DecodeStream* s,
+                                                const char* buf, size_t size) {
+  // Required fields may legitimately arrive in a later chunk, so the check is
+  // deferred to Finish().
+  int options = s->options & ~kUpb_DecodeOption_CheckRequired;
+  s->status = upb_Decode(buf, size, s->msg, s->mt, s->extreg, options,
+                         s->arena);
+  return s->status;
+}
+
+upb_DecodeStream* upb_DecodeStream_New(upb_Message* msg, const upb_MiniTable* l,
+                                       const upb_ExtensionRegistry* extreg,
+                                       int options, upb_Arena* arena) {
+  upb_DecodeStream* s = upb_Arena_Malloc(arena, sizeof(*s));
+  if (!s) return NULL;
+  s->msg = msg;
+  s->mt = l;
+  s->extreg = extreg;
+  // Pushed buffers are transient, so aliasing into them would dangle.
+  s->options = options & ~kUpb_DecodeOption_AliasString;
+  s->arena = arena;
+  s->pending = NULL;
+  s->pending_size = 0;
+  s->pending_cap = 0;
+  s->status = kUpb_DecodeStatus_Ok;
+  return s;
+}
+
+upb_DecodeStatus upb_DecodeStream_PushBuffer(upb_DecodeStream* s,
+                                             const char* buf, size_t size) {
+  if (s->status != kUpb_DecodeStatus_Ok) return s->status;
+
+  if (s->pending_size == 0) {
+    // Common case: decode whole fields straight out of the caller's buffer
+    // and only copy the incomplete tail.
+    size_t n = upb_DecodeStream_FieldBoundary(buf, size);
+    if (n && upb_DecodeStream_Decode(s, buf, n) != kUpb_DecodeStatus_Ok) {
+      return s->status;
+    }
+    buf += n;
+    size -= n;
+    if (size && !upb_DecodeStream_Append(s, buf, size)) {
+      s->status = kUpb_DecodeStatus_OutOfMemory;
+    }
+    return s->status;
+  }
+
+  if (!upb_DecodeStream_Append(s, buf, size)) {
+    s->status = kUpb_DecodeStatus_OutOfMemory;
+    return s->status;
+  }
+
+  size_t n = upb_DecodeStream_FieldBoundary(s->pending, s->pending_size);
+  if (n) {
+    if (upb_DecodeStream_Decode(s, s->pending, n) != kUpb_DecodeStatus_Ok) {
+      return s->status;
+    }
+    memmove(s->pending, s->pending + n, s->pending_size - n);
+    s->pending_size -= n;
+  }
+  return s->status;
+}
+
+upb_DecodeStatus upb_DecodeStream_Finish(upb_DecodeStream* s) {
+  if (s->status != kUpb_DecodeStatus_Ok) return s->status;
+  // An empty final decode still performs the CheckRequired pass.
+  s->status = upb_Decode(s->pending ? s->pending : "", s->pending_size, s->msg,
+                         s->mt, s->extreg, s->options, s->arena);
+  s->pending_size = 0;
+  return s->status;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// upb_DecodeStream: a push-style front end for upb_Decode().
+//
+// This lets callers feed a serialized message in arbitrary chunks (eg. as
+// network frames arrive) instead of coalescing it into one flat buffer first.
+// Because the wire format defines concatenation as field merging, each chunk
+// is decoded as soon as it contains complete top-level fields; only the bytes
+// of a field that is still incomplete are buffered internally. The result
+// after Finish() is identical to a single upb_Decode() call over the
+// concatenated input.
+//
+// Progress is made at top-level field granularity: a single field larger than
+// every pushed chunk (eg. one giant sub-message) is buffered until complete.
+//
+// kUpb_DecodeOption_AliasString is ignored, since pushed buffers need not
+// outlive the call.
+
+#ifndef UPB_WIRE_DECODE_STREAM_H_
+#define UPB_WIRE_DECODE_STREAM_H_
+
+#include "upb/wire/decode.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct upb_DecodeStream upb_DecodeStream;
+
+// Creates a decode stream that parses into |msg|. The message, the internal
+// buffer, and the stream object itself are allocated from |arena|; |msg|, |l|
+// and |extreg| must outlive the stream. Returns NULL on allocation failure.
+UPB_API upb_DecodeStream* upb_DecodeStream_New(
+    upb_Message* msg, const upb_MiniTable* l,
+    const upb_ExtensionRegistry* extreg, int options, upb_Arena* arena);
+
+// Feeds the next |size| bytes of the serialized message. Decodes any complete
+// top-level fields immediately and buffers the rest. |buf| only needs to be
+// valid for the duration of the call. Errors are sticky: once a call fails,
+// all subsequent calls return the same status.
+UPB_API upb_DecodeStatus upb_DecodeStream_PushBuffer(upb_DecodeStream* s,
+                                                     const char* buf,
+                                                     size_t size);
+
+// Signals the end of input and decodes any buffered bytes. Returns
+// kUpb_DecodeStatus_Malformed if the input ends mid-field, and performs the
+// kUpb_DecodeOption_CheckRequired check (if requested) over the whole message.
+UPB_API upb_DecodeStatus upb_DecodeStream_Finish(upb_DecodeStream* s);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_WIRE_DECODE_STREAM_H_ */
@@ -0,0 +1,110 @@
+// Copyright (c) 2009-2021, Google LLC
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Google LLC nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "upb/message/accessors.h"
+#include "upb/mini_descriptor/decode.h"
+#include "upb/mini_descriptor/internal/encode.h"
+#include "upb/wire/test_util.h"
+#include "upb/wire/decode_stream.h"
+
+namespace {
+
+using upb_test::NestedMessagePayload;
+using upb_test::RecursiveMiniTable;
+using upb_test::TestMiniTable;
+
+// i = 42, s = "hello world".
+const char kPayload[] = "\x08\x2a\x12\x0bhello world";
+const size_t kPayloadSize = sizeof(kPayload) - 1;
+
+TEST(DecodeStreamTest, ChunkedDecodeMatchesFlatDecode) {
+  // Push the payload in every chunk size, including chunks that split tags,
+  // varints and string bodies; the result must always match a flat decode.
+  for (size_t chunk = 1; chunk <= kPayloadSize; chunk++) {
+    upb_Arena* arena = upb_Arena_New();
+    const upb_MiniTable* mt = TestMiniTable(arena);
+    upb_Message* msg = upb_Message_New(mt, arena);
+    upb_DecodeStream* s = upb_DecodeStream_New(msg, mt, nullptr, 0, arena);
+    ASSERT_NE(s, nullptr);
+    for (size_t i = 0; i < kPayloadSize; i += chunk) {
+      size_t n = std::min(chunk, kPayloadSize - i);
+      ASSERT_EQ(upb_DecodeStream_PushBuffer(s, kPayload + i, n),
+                kUpb_DecodeStatus_Ok);
+    }
+    ASSERT_EQ(upb_DecodeStream_Finish(s), kUpb_DecodeStatus_Ok);
+
+    const upb_MiniTableField* f1 = upb_MiniTable_FindFieldByNumber(mt, 1);
+    const upb_MiniTableField* f2 = upb_MiniTable_FindFieldByNumber(mt, 2);
+    EXPECT_EQ(upb_Message_GetInt32(msg, f1, 0), 42);
+    upb_StringView sv =
+        upb_Message_GetString(msg, f2, upb_StringView_FromString(""));
+    EXPECT_EQ(std::string(sv.data, sv.size), "hello world");
+    upb_Arena_Free(arena);
+  }
+}
+
+TEST(DecodeStreamTest, TruncatedInputFailsAtFinish) {
+  upb_Arena* arena = upb_Arena_New();
+  const upb_MiniTable* mt = TestMiniTable(arena);
+  upb_Message* msg = upb_Message_New(mt, arena);
+  upb_DecodeStream* s = upb_DecodeStream_New(msg, mt, nullptr, 0, arena);
+  ASSERT_NE(s, nullptr);
+  // String field claims 11 bytes but only 5 arrive.
+  EXPECT_EQ(upb_DecodeStream_PushBuffer(s, "\x12\x0bhello", 7),
+            kUpb_DecodeStatus_Ok);
+  EXPECT_EQ(upb_DecodeStream_Finish(s), kUpb_DecodeStatus_Malformed);
+  upb_Arena_Free(arena);
+}
+
+TEST(DecodeStreamTest, NestedMessagesAcrossChunks) {
+  // Sub-message frames push delimited limits that must survive being
+  // suspended and resumed at every possible buffer boundary.
+  upb_Arena* arena = upb_Arena_New();
+  const upb_MiniTable* mt = RecursiveMiniTable(arena);
+  std::string payload = NestedMessagePayload(40);
+  upb_Message* msg = upb_Message_New(mt, arena);
+  upb_DecodeStream* s = upb_DecodeStream_New(msg, mt, nullptr, 0, arena);
+  ASSERT_NE(s, nullptr);
+  for (size_t i = 0; i < payload.size(); i++) {
+    ASSERT_EQ(upb_DecodeStream_PushBuffer(s, payload.data() + i, 1),
+              kUpb_DecodeStatus_Ok);
+  }
+  ASSERT_EQ(upb_DecodeStream_Finish(s), kUpb_DecodeStatus_Ok);
+
+  const upb_MiniTableField* f1 = upb_MiniTable_FindFieldByNumber(mt, 1);
+  int depth = 0;
+  const upb_Message* walk = msg;
+  while ((walk = upb_Message_GetMessage(walk, f1, nullptr)) != nullptr) {
+    depth++;
+  }
+  EXPECT_EQ(depth, 40);
+  upb_Arena_Free(arena);
+}
+
+}  // namespace
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/wire/decode_telemetry.h"
+
+#include <string.h>
+
+#include "upb/port/atomic.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef UPB_FASTTABLE_TELEMETRY
+
+// Fixed-size, lock-free counter table keyed by (mini table, reason).  Distinct
+// (table, reason) pairs are few in practice -- one per message type plus one
+// per fallback site that actually fires -- so open addressing with a bounded
+// probe length is plenty; overflowing events are counted in |dropped|.
+
+#define kUpb_DecodeTelemetry_Slots 1024  // Must be a power of two.
+#define kUpb_DecodeTelemetry_MaxProbes 32
+
+typedef struct {
+  UPB_ATOMIC(const upb_MiniTable*) m;
+  UPB_ATOMIC(const char*) reason;
+  UPB_ATOMIC(uint64_t) count;
+} upb_DecodeTelemetry_Slot;
+
+static upb_DecodeTelemetry_Slot
+    upb_DecodeTelemetry_slots[kUpb_DecodeTelemetry_Slots];
+static UPB_ATOMIC(uint64_t) upb_DecodeTelemetry_dropped;
+
+// Slots are claimed by CAS on |m|; |reason| is stored by the winner before
+// the first count lands.  A reader may see a claimed slot whose count is
+// still zero, which visits as a zero-count entry -- harmless for telemetry.
+void _upb_DecodeTelemetry_Count(const upb_MiniTable* m, const char* reason) {
+  uintptr_t h = (uintptr_t)m * 2654435761u;
+  h ^= (uintptr_t)reason >> 4;
+  for (int probe = 0; probe < kUpb_DecodeTelemetry_MaxProbes; probe++) {
+    upb_DecodeTelemetry_Slot* slot =
+        &upb_DecodeTelemetry_slots[(h + probe) &
+                                   (kUpb_DecodeTelemetry_Slots - 1)];
+    const upb_MiniTable* seen = upb_Atomic_Load(&slot->m, memory_order_acquire);
+    if (seen == NULL) {
+      const upb_MiniTable* expected = NULL;
+      if (upb_Atomic_CompareExchangeStrong(&slot->m, &expected, m,
+                                           memory_order_acq_rel,
+                                           memory_order_acquire)) {
+        upb_Atomic_Store(&slot->reason, reason, memory_order_release);
+        seen = m;
+      } else {
+        seen = expected;
+      }
+    }
+    if (seen == m &&
+        upb_Atomic_Load(&slot->reason, memory_order_acquire) == reason) {
+      upb_Atomic_Add(&slot->count, 1, memory_order_relaxed);
+      return;
+    }
+  }
+  upb_Atomic_Add(&upb_DecodeTelemetry_dropped, 1, memory_order_relaxed);
+}
+
+void upb_DecodeTelemetry_Visit(upb_DecodeTelemetry_Visitor* visitor,
+                               void* ctx) {
+  for (int i = 0; i < kUpb_DecodeTelemetry_Slots; i++) {
+    upb_DecodeTelemetry_Slot* slot = &upb_DecodeTelemetry_slots[i];
+    const upb_MiniTable* m = upb_Atomic_Load(&slot->m, memory_order_acquire);
+    if (!m) continue;
+    visitor(m, upb_Atomic_Load(&slot->reason, memory_order_acquire),
+            upb_Atomic_Load(&slot->count, memory_order_relaxed), ctx);
+  }
+}
+
+void upb_DecodeTelemetry_Reset(void) {
+  for (int i = 0; i < kUpb_DecodeTelemetry_Slots; i++) {
+    upb_DecodeTelemetry_Slot* slot = &upb_DecodeTelemetry_slots[i];
+    upb_Atomic_Store(&slot->count, 0, memory_order_relaxed);
+    upb_Atomic_Store(&slot->reason, NULL, memory_order_relaxed);
+    upb_Atomic_Store(&slot->m, NULL, memory_order_release);
+  }
+  upb_Atomic_Store(&upb_DecodeTelemetry_dropped, 0, memory_order_relaxed);
+}
+
+uint64_t upb_DecodeTelemetry_Dropped(void) {
+  return upb_Atomic_Load(&upb_DecodeTelemetry_dropped, memory_order_relaxed);
+}
+
+#else  // !UPB_FASTTABLE_TELEMETRY
+
+void upb_DecodeTelemetry_Visit(upb_DecodeTelemetry_Visitor* visitor,
+                               void* ctx) {
+  (void)visitor;
+  (void)ctx;
+}
+
+void upb_DecodeTelemetry_Reset(void) {}
+
+uint64_t upb_DecodeTelemetry_Dropped(void) { return 0; }
+
+#endif  // UPB_FASTTABLE_TELEMETRY
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Optional decoder hot-path telemetry.
+//
+// Compile with -DUPB_FASTTABLE_TELEMETRY (in addition to fasttable support)
+// to record, per mini table, how often the fast-table parser was dispatched
+// and how often it fell back to the generic parser, attributed to the
+// RETURN_GENERIC reason string in decode_fast.c.  This makes silent fast-path
+// regressions (e.g. a schema change pushing a field off the fast table)
+// observable in production.  When the macro is not defined, the hooks compile
+// to nothing and the read API reports no data.
+
+#ifndef UPB_WIRE_DECODE_TELEMETRY_H_
+#define UPB_WIRE_DECODE_TELEMETRY_H_
+
+#include "upb/mini_table/message.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Called once per visited counter.  |reason| is NULL for fast-table dispatch
+// counts, and the RETURN_GENERIC reason string for fallback counts.  The
+// counter set is sampled without locks, so counts from concurrent decodes may
+// be slightly stale.
+typedef void upb_DecodeTelemetry_Visitor(const upb_MiniTable* m,
+                                         const char* reason, uint64_t count,
+                                         void* ctx);
+
+void upb_DecodeTelemetry_Visit(upb_DecodeTelemetry_Visitor* visitor, void* ctx);
+
+// Zeroes all counters.
+void upb_DecodeTelemetry_Reset(void);
+
+// Number of events that could not be recorded because the (fixed-size)
+// counter table was full.
+uint64_t upb_DecodeTelemetry_Dropped(void);
+
+#ifdef UPB_FASTTABLE_TELEMETRY
+
+void _upb_DecodeTelemetry_Count(const upb_MiniTable* m, const char* reason);
+
+#define UPB_DECODE_TELEMETRY_DISPATCH(m) _upb_DecodeTelemetry_Count(m, NULL)
+#define UPB_DECODE_TELEMETRY_FALLBACK(m, reason) \
+  _upb_DecodeTelemetry_Count(m, reason)
+
+#else
+
+#define UPB_DECODE_TELEMETRY_DISPATCH(m)
+#define UPB_DECODE_TELEMETRY_FALLBACK(m, reason)
+
+#endif  // UPB_FASTTABLE_TELEMETRY
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_WIRE_DECODE_TELEMETRY_H_ */
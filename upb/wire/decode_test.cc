@@ -0,0 +1,143 @@
+// Copyright (c) 2009-2021, Google LLC
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Google LLC nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "upb/message/accessors.h"
+#include "upb/mini_descriptor/decode.h"
+#include "upb/mini_descriptor/internal/encode.h"
+#include "upb/wire/common.h"
+#include "upb/wire/decode.h"
+#include "upb/wire/test_util.h"
+
+namespace {
+
+using upb_test::NestedGroupPayload;
+using upb_test::NestedMessagePayload;
+using upb_test::RecursiveMiniTable;
+
+int NestedMessageDepth(const upb_Message* msg, const upb_MiniTable* mt) {
+  const upb_MiniTableField* f1 = upb_MiniTable_FindFieldByNumber(mt, 1);
+  int depth = 0;
+  while ((msg = upb_Message_GetMessage(msg, f1, nullptr)) != nullptr) depth++;
+  return depth;
+}
+
+int NestedGroupDepth(const upb_Message* msg, const upb_MiniTable* mt) {
+  const upb_MiniTableField* f2 = upb_MiniTable_FindFieldByNumber(mt, 2);
+  int depth = 0;
+  while ((msg = upb_Message_GetMessage(msg, f2, nullptr)) != nullptr) depth++;
+  return depth;
+}
+
+TEST(DecodeTest, NestedMessageGrowsFrameStack) {
+  // 64 levels is well past the decoder's initial frame-stack capacity, so
+  // this exercises frame-array growth mid-decode.
+  upb_Arena* arena = upb_Arena_New();
+  const upb_MiniTable* mt = RecursiveMiniTable(arena);
+  std::string payload = NestedMessagePayload(64);
+  upb_Message* msg = upb_Message_New(mt, arena);
+  ASSERT_EQ(upb_Decode(payload.data(), payload.size(), msg, mt, nullptr, 0,
+                       arena),
+            kUpb_DecodeStatus_Ok);
+  EXPECT_EQ(NestedMessageDepth(msg, mt), 64);
+  upb_Arena_Free(arena);
+}
+
+TEST(DecodeTest, NestedMessageDepthLimit) {
+  upb_Arena* arena = upb_Arena_New();
+  const upb_MiniTable* mt = RecursiveMiniTable(arena);
+  const int options = upb_DecodeOptions_MaxDepth(10);
+
+  std::string ok_payload = NestedMessagePayload(10);
+  upb_Message* msg = upb_Message_New(mt, arena);
+  EXPECT_EQ(upb_Decode(ok_payload.data(), ok_payload.size(), msg, mt, nullptr,
+                       options, arena),
+            kUpb_DecodeStatus_Ok);
+  EXPECT_EQ(NestedMessageDepth(msg, mt), 10);
+
+  std::string deep_payload = NestedMessagePayload(11);
+  msg = upb_Message_New(mt, arena);
+  EXPECT_EQ(upb_Decode(deep_payload.data(), deep_payload.size(), msg, mt,
+                       nullptr, options, arena),
+            kUpb_DecodeStatus_MaxDepthExceeded);
+
+  // The default limit applies when no explicit one is given.
+  std::string very_deep =
+      NestedMessagePayload(kUpb_WireFormat_DefaultDepthLimit + 1);
+  msg = upb_Message_New(mt, arena);
+  EXPECT_EQ(upb_Decode(very_deep.data(), very_deep.size(), msg, mt, nullptr, 0,
+                       arena),
+            kUpb_DecodeStatus_MaxDepthExceeded);
+  upb_Arena_Free(arena);
+}
+
+TEST(DecodeTest, NestedGroups) {
+  upb_Arena* arena = upb_Arena_New();
+  const upb_MiniTable* mt = RecursiveMiniTable(arena);
+  std::string payload = NestedGroupPayload(30);
+  upb_Message* msg = upb_Message_New(mt, arena);
+  ASSERT_EQ(upb_Decode(payload.data(), payload.size(), msg, mt, nullptr, 0,
+                       arena),
+            kUpb_DecodeStatus_Ok);
+  EXPECT_EQ(NestedGroupDepth(msg, mt), 30);
+  upb_Arena_Free(arena);
+}
+
+TEST(DecodeTest, GroupDepthLimit) {
+  upb_Arena* arena = upb_Arena_New();
+  const upb_MiniTable* mt = RecursiveMiniTable(arena);
+  const int options = upb_DecodeOptions_MaxDepth(10);
+  std::string payload = NestedGroupPayload(11);
+  upb_Message* msg = upb_Message_New(mt, arena);
+  EXPECT_EQ(upb_Decode(payload.data(), payload.size(), msg, mt, nullptr,
+                       options, arena),
+            kUpb_DecodeStatus_MaxDepthExceeded);
+  upb_Arena_Free(arena);
+}
+
+TEST(DecodeTest, MismatchedGroupTagsAreMalformed) {
+  upb_Arena* arena = upb_Arena_New();
+  const upb_MiniTable* mt = RecursiveMiniTable(arena);
+
+  // End-group without a matching start.
+  upb_Message* msg = upb_Message_New(mt, arena);
+  EXPECT_EQ(upb_Decode("\x14", 1, msg, mt, nullptr, 0, arena),
+            kUpb_DecodeStatus_Malformed);
+
+  // Start-group closed by the wrong field's end tag.
+  msg = upb_Message_New(mt, arena);
+  EXPECT_EQ(upb_Decode("\x13\x0c", 2, msg, mt, nullptr, 0, arena),
+            kUpb_DecodeStatus_Malformed);
+
+  // Start-group never closed.
+  msg = upb_Message_New(mt, arena);
+  EXPECT_EQ(upb_Decode("\x13", 1, msg, mt, nullptr, 0, arena),
+            kUpb_DecodeStatus_Malformed);
+  upb_Arena_Free(arena);
+}
+
+}  // namespace
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/wire/decode_trace.h"
+
+#include <string.h>
+
+// Must be last.
+#include "upb/port/def.inc"
+
+typedef struct {
+  uint64_t taken;
+  uint64_t total;
+} upb_DecodeBranchTrace_Counter;
+
+static upb_DecodeBranchTrace_Counter
+    upb_DecodeBranchTrace_counters[kUpb_DecodeBranchSite_Count];
+
+static const char* const upb_DecodeBranchTrace_names[] = {
+#define UPB_DECODE_BRANCH_SITE_NAME(site) #site,
+    UPB_DECODE_BRANCH_SITES(UPB_DECODE_BRANCH_SITE_NAME)
+#undef UPB_DECODE_BRANCH_SITE_NAME
+};
+
+#ifdef UPB_DECODE_BRANCH_TRACE
+
+bool _upb_DecodeBranchTrace_Record(upb_DecodeBranchSite site, bool cond) {
+  upb_DecodeBranchTrace_Counter* c = &upb_DecodeBranchTrace_counters[site];
+  c->total++;
+  c->taken += cond;
+  return cond;
+}
+
+#endif  // UPB_DECODE_BRANCH_TRACE
+
+void upb_DecodeBranchTrace_Dump(FILE* f) {
+  for (int i = 0; i < kUpb_DecodeBranchSite_Count; i++) {
+    const upb_DecodeBranchTrace_Counter* c = &upb_DecodeBranchTrace_counters[i];
+    fprintf(f, "%s %llu %llu\n", upb_DecodeBranchTrace_names[i],
+            (unsigned long long)c->taken, (unsigned long long)c->total);
+  }
+}
+
+void upb_DecodeBranchTrace_Reset(void) {
+  memset(upb_DecodeBranchTrace_counters, 0,
+         sizeof(upb_DecodeBranchTrace_counters));
+}
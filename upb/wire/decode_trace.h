@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Workload-driven branch hints for the generic decoder.
+//
+// The hand-placed UPB_LIKELY/UPB_UNLIKELY annotations in decode.c encode
+// expectations tuned for descriptor.proto-like data.  Workloads can disagree
+// (mostly-absent optional fields, giant strings, dense enums), so the hottest
+// of those branches go through the UPB_DECODE_BRANCH() macro below, which
+// supports three modes:
+//
+//   - Default: each site expands to __builtin_expect() with the decoder's
+//     original expectation.  Zero overhead, identical code to hand hints.
+//   - Trace (-DUPB_DECODE_BRANCH_TRACE): each site counts taken/total
+//     outcomes into a small global table.  Run a representative workload,
+//     then dump the counters with upb_DecodeBranchTrace_Dump().
+//   - Override (-DUPB_DECODE_HINTS_FILE='"myhints.h"'): the named header --
+//     generated from a trace by tools/decode_trace_to_hints.py -- redefines
+//     per-site expectations, building a workload-specialized decoder without
+//     forking the source.
+
+#ifndef UPB_WIRE_DECODE_TRACE_H_
+#define UPB_WIRE_DECODE_TRACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Must be last.
+#include "upb/port/def.inc"
+
+// The traced call sites.  Each entry names one conditional in decode.c; the
+// site name appears in trace dumps and in the generated hints macros.
+#define UPB_DECODE_BRANCH_SITES(X) \
+  X(ShortVarint)                   \
+  X(ShortTag)                      \
+  X(InlineStringDirect)            \
+  X(EnumInRange)                   \
+  X(LazyField)                     \
+  X(EnumOp)                        \
+  X(GroupField)                    \
+  X(SkipRequiredCheck)             \
+  X(ExtensionField)                \
+  X(RequiredFields)
+
+typedef enum {
+#define UPB_DECODE_BRANCH_SITE_ENUM(site) kUpb_DecodeBranchSite_##site,
+  UPB_DECODE_BRANCH_SITES(UPB_DECODE_BRANCH_SITE_ENUM)
+#undef UPB_DECODE_BRANCH_SITE_ENUM
+      kUpb_DecodeBranchSite_Count,
+} upb_DecodeBranchSite;
+
+// Per-site expectations.  A hints header generated from a trace may redefine
+// any subset; unmentioned sites keep the defaults below, which reproduce the
+// decoder's original hand placements.
+#ifdef UPB_DECODE_HINTS_FILE
+#include UPB_DECODE_HINTS_FILE
+#endif
+
+#ifndef UPB_DECODE_BRANCH_HINT_ShortVarint
+#define UPB_DECODE_BRANCH_HINT_ShortVarint 1
+#endif
+#ifndef UPB_DECODE_BRANCH_HINT_ShortTag
+#define UPB_DECODE_BRANCH_HINT_ShortTag 1
+#endif
+#ifndef UPB_DECODE_BRANCH_HINT_InlineStringDirect
+#define UPB_DECODE_BRANCH_HINT_InlineStringDirect 1
+#endif
+#ifndef UPB_DECODE_BRANCH_HINT_EnumInRange
+#define UPB_DECODE_BRANCH_HINT_EnumInRange 1
+#endif
+#ifndef UPB_DECODE_BRANCH_HINT_LazyField
+#define UPB_DECODE_BRANCH_HINT_LazyField 0
+#endif
+#ifndef UPB_DECODE_BRANCH_HINT_EnumOp
+#define UPB_DECODE_BRANCH_HINT_EnumOp 0
+#endif
+#ifndef UPB_DECODE_BRANCH_HINT_GroupField
+#define UPB_DECODE_BRANCH_HINT_GroupField 0
+#endif
+#ifndef UPB_DECODE_BRANCH_HINT_SkipRequiredCheck
+#define UPB_DECODE_BRANCH_HINT_SkipRequiredCheck 1
+#endif
+#ifndef UPB_DECODE_BRANCH_HINT_ExtensionField
+#define UPB_DECODE_BRANCH_HINT_ExtensionField 0
+#endif
+#ifndef UPB_DECODE_BRANCH_HINT_RequiredFields
+#define UPB_DECODE_BRANCH_HINT_RequiredFields 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef UPB_DECODE_BRANCH_TRACE
+
+// Records one outcome and returns |cond| unchanged.  Counters are plain
+// (non-atomic) increments: trace builds are meant for single-threaded
+// profiling runs, where this keeps the probe cost to a couple of stores.
+bool _upb_DecodeBranchTrace_Record(upb_DecodeBranchSite site, bool cond);
+
+#define UPB_DECODE_BRANCH(site, cond) \
+  _upb_DecodeBranchTrace_Record(kUpb_DecodeBranchSite_##site, (cond))
+
+#elif defined(__GNUC__)
+
+#define UPB_DECODE_BRANCH(site, cond) \
+  __builtin_expect(!!(cond), UPB_DECODE_BRANCH_HINT_##site)
+
+#else
+
+#define UPB_DECODE_BRANCH(site, cond) (cond)
+
+#endif  // UPB_DECODE_BRANCH_TRACE
+
+// Writes one "site taken total" line per site, the input format expected by
+// tools/decode_trace_to_hints.py.  All zeroes unless the binary was built
+// with UPB_DECODE_BRANCH_TRACE and has decoded something.
+void upb_DecodeBranchTrace_Dump(FILE* f);
+
+// Zeroes all counters.
+void upb_DecodeBranchTrace_Reset(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_WIRE_DECODE_TRACE_H_ */
@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/wire/decode_visit.h"
+
+#include <string.h>
+
+#include "upb/mini_table/internal/field.h"
+#include "upb/mini_table/internal/message.h"
+#include "upb/wire/common.h"
+#include "upb/wire/eps_copy_input_stream.h"
+#include "upb/wire/reader.h"
+#include "upb/wire/types.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+typedef struct {
+  upb_EpsCopyInputStream input;
+  const upb_DecodeVisitor* visitor;
+  void* ctx;
+  upb_DecodeStatus status;  // Valid once the visit has unwound with NULL.
+  bool stopped;             // A callback returned false; not an error.
+} upb_VisitState;
+
+// Errors and callback stops both unwind by returning NULL; |s->status| and
+// |s->stopped| say which happened.
+static const char* upb_DecodeVisit_Err(upb_VisitState* s,
+                                       upb_DecodeStatus status) {
+  s->status = status;
+  return NULL;
+}
+
+static int64_t upb_DecodeVisit_ZigZag(uint64_t v) {
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// Delivers one varint-encoded value according to the field's declared type.
+// Returns false to unwind (callback stop); fields without a callback are
+// silently skipped.
+static bool upb_DecodeVisit_Varint(upb_VisitState* s,
+                                   const upb_MiniTableField* f, uint64_t val) {
+  const upb_DecodeVisitor* v = s->visitor;
+  switch (f->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Bool:
+      if (v->visit_bool) return v->visit_bool(s->ctx, f, val != 0);
+      return true;
+    case kUpb_FieldType_Int32:
+      if (v->visit_int32) return v->visit_int32(s->ctx, f, (int32_t)val);
+      return true;
+    case kUpb_FieldType_Enum:
+      if (v->visit_int32) return v->visit_int32(s->ctx, f, (int32_t)val);
+      return true;
+    case kUpb_FieldType_SInt32:
+      if (v->visit_int32) {
+        return v->visit_int32(s->ctx, f,
+                              (int32_t)upb_DecodeVisit_ZigZag(val));
+      }
+      return true;
+    case kUpb_FieldType_UInt32:
+      if (v->visit_uint32) return v->visit_uint32(s->ctx, f, (uint32_t)val);
+      return true;
+    case kUpb_FieldType_Int64:
+      if (v->visit_int64) return v->visit_int64(s->ctx, f, (int64_t)val);
+      return true;
+    case kUpb_FieldType_SInt64:
+      if (v->visit_int64) {
+        return v->visit_int64(s->ctx, f, upb_DecodeVisit_ZigZag(val));
+      }
+      return true;
+    case kUpb_FieldType_UInt64:
+      if (v->visit_uint64) return v->visit_uint64(s->ctx, f, val);
+      return true;
+    default:
+      return true;  // Wire/declared type mismatch: value already consumed.
+  }
+}
+
+static bool upb_DecodeVisit_Fixed32(upb_VisitState* s,
+                                    const upb_MiniTableField* f,
+                                    uint32_t val) {
+  const upb_DecodeVisitor* v = s->visitor;
+  switch (f->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Fixed32:
+      if (v->visit_uint32) return v->visit_uint32(s->ctx, f, val);
+      return true;
+    case kUpb_FieldType_SFixed32:
+      if (v->visit_int32) return v->visit_int32(s->ctx, f, (int32_t)val);
+      return true;
+    case kUpb_FieldType_Float:
+      if (v->visit_float) {
+        float fval;
+        memcpy(&fval, &val, sizeof(fval));
+        return v->visit_float(s->ctx, f, fval);
+      }
+      return true;
+    default:
+      return true;
+  }
+}
+
+static bool upb_DecodeVisit_Fixed64(upb_VisitState* s,
+                                    const upb_MiniTableField* f,
+                                    uint64_t val) {
+  const upb_DecodeVisitor* v = s->visitor;
+  switch (f->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Fixed64:
+      if (v->visit_uint64) return v->visit_uint64(s->ctx, f, val);
+      return true;
+    case kUpb_FieldType_SFixed64:
+      if (v->visit_int64) return v->visit_int64(s->ctx, f, (int64_t)val);
+      return true;
+    case kUpb_FieldType_Double:
+      if (v->visit_double) {
+        double dval;
+        memcpy(&dval, &val, sizeof(dval));
+        return v->visit_double(s->ctx, f, dval);
+      }
+      return true;
+    default:
+      return true;
+  }
+}
+
+// Whether a delimited wire value on this field is a packed repeated numeric
+// (any scalar numeric declared type; strings/bytes/messages are delimited in
+// their own right).
+static bool upb_DecodeVisit_IsPackable(const upb_MiniTableField* f) {
+  switch (f->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes:
+    case kUpb_FieldType_Message:
+    case kUpb_FieldType_Group:
+      return false;
+    default:
+      return true;
+  }
+}
+
+static const char* upb_DecodeVisit_Msg(upb_VisitState* s, const char* ptr,
+                                       const upb_MiniTable* mt,
+                                       uint32_t end_group, int depth);
+
+// Dispatches one packed element stream.  |ptr| is positioned just past the
+// length prefix, with a stream limit pushed for the payload.
+static const char* upb_DecodeVisit_Packed(upb_VisitState* s, const char* ptr,
+                                          const upb_MiniTableField* f) {
+  const int type = f->UPB_PRIVATE(descriptortype);
+  while (!upb_EpsCopyInputStream_IsDone(&s->input, &ptr)) {
+    bool ok;
+    switch (type) {
+      case kUpb_FieldType_Fixed32:
+      case kUpb_FieldType_SFixed32:
+      case kUpb_FieldType_Float: {
+        uint32_t val;
+        ptr = upb_WireReader_ReadFixed32(ptr, &val);
+        ok = upb_DecodeVisit_Fixed32(s, f, val);
+        break;
+      }
+      case kUpb_FieldType_Fixed64:
+      case kUpb_FieldType_SFixed64:
+      case kUpb_FieldType_Double: {
+        uint64_t val;
+        ptr = upb_WireReader_ReadFixed64(ptr, &val);
+        ok = upb_DecodeVisit_Fixed64(s, f, val);
+        break;
+      }
+      default: {
+        uint64_t val;
+        ptr = upb_WireReader_ReadVarint(ptr, &val);
+        if (!ptr) return upb_DecodeVisit_Err(s, kUpb_DecodeStatus_Malformed);
+        ok = upb_DecodeVisit_Varint(s, f, val);
+        break;
+      }
+    }
+    if (!ok) {
+      s->stopped = true;
+      return NULL;
+    }
+  }
+  if (upb_EpsCopyInputStream_IsError(&s->input)) {
+    return upb_DecodeVisit_Err(s, kUpb_DecodeStatus_Malformed);
+  }
+  return ptr;
+}
+
+static const char* upb_DecodeVisit_Delimited(upb_VisitState* s,
+                                             const char* ptr,
+                                             const upb_MiniTable* mt,
+                                             const upb_MiniTableField* f,
+                                             int depth) {
+  int size;
+  ptr = upb_WireReader_ReadSize(ptr, &size);
+  if (!ptr || !upb_EpsCopyInputStream_CheckSize(&s->input, ptr, size)) {
+    return upb_DecodeVisit_Err(s, kUpb_DecodeStatus_Malformed);
+  }
+
+  const int type = f ? f->UPB_PRIVATE(descriptortype) : 0;
+
+  if (f && (type == kUpb_FieldType_String || type == kUpb_FieldType_Bytes) &&
+      s->visitor->visit_string) {
+    if (!upb_EpsCopyInputStream_CheckDataSizeAvailable(&s->input, ptr, size)) {
+      return upb_DecodeVisit_Err(s, kUpb_DecodeStatus_Malformed);
+    }
+    const char* data = ptr;
+    ptr = upb_EpsCopyInputStream_ReadStringAliased(&s->input, &data, size);
+    upb_StringView sv = {data, (size_t)size};
+    if (!s->visitor->visit_string(s->ctx, f, sv)) {
+      s->stopped = true;
+      return NULL;
+    }
+    return ptr;
+  }
+
+  if (f && type == kUpb_FieldType_Message && s->visitor->visit_submessage) {
+    const upb_MiniTable* sub =
+        mt->subs[f->UPB_PRIVATE(submsg_index)].submsg;
+    bool descend = false;
+    if (!s->visitor->visit_submessage(s->ctx, f, &descend)) {
+      s->stopped = true;
+      return NULL;
+    }
+    if (descend && sub) {
+      if (depth == 0) {
+        return upb_DecodeVisit_Err(s, kUpb_DecodeStatus_MaxDepthExceeded);
+      }
+      int delta = upb_EpsCopyInputStream_PushLimit(&s->input, ptr, size);
+      ptr = upb_DecodeVisit_Msg(s, ptr, sub, 0, depth - 1);
+      if (!ptr) return NULL;
+      upb_EpsCopyInputStream_PopLimit(&s->input, ptr, delta);
+      if (s->visitor->end_submessage &&
+          !s->visitor->end_submessage(s->ctx, f)) {
+        s->stopped = true;
+        return NULL;
+      }
+      return ptr;
+    }
+    // Fall through to the skip below.
+  }
+
+  if (f && upb_DecodeVisit_IsPackable(f)) {
+    int delta = upb_EpsCopyInputStream_PushLimit(&s->input, ptr, size);
+    ptr = upb_DecodeVisit_Packed(s, ptr, f);
+    if (!ptr) return NULL;
+    upb_EpsCopyInputStream_PopLimit(&s->input, ptr, delta);
+    return ptr;
+  }
+
+  // Uninteresting payload: skip it by its length prefix.
+  ptr = upb_EpsCopyInputStream_Skip(&s->input, ptr, size);
+  if (!ptr) return upb_DecodeVisit_Err(s, kUpb_DecodeStatus_Malformed);
+  return ptr;
+}
+
+static const char* upb_DecodeVisit_Msg(upb_VisitState* s, const char* ptr,
+                                       const upb_MiniTable* mt,
+                                       uint32_t end_group, int depth) {
+  while (!upb_EpsCopyInputStream_IsDone(&s->input, &ptr)) {
+    uint32_t tag;
+    ptr = upb_WireReader_ReadTag(ptr, &tag);
+    if (!ptr) return upb_DecodeVisit_Err(s, kUpb_DecodeStatus_Malformed);
+    const uint32_t field_number = upb_WireReader_GetFieldNumber(tag);
+    const int wire_type = upb_WireReader_GetWireType(tag);
+
+    if (wire_type == kUpb_WireType_EndGroup) {
+      if (field_number != end_group) {
+        return upb_DecodeVisit_Err(s, kUpb_DecodeStatus_Malformed);
+      }
+      return ptr;
+    }
+
+    const upb_MiniTableField* f =
+        upb_MiniTable_FindFieldByNumber(mt, field_number);
+
+    switch (wire_type) {
+      case kUpb_WireType_Varint: {
+        uint64_t val;
+        ptr = upb_WireReader_ReadVarint(ptr, &val);
+        if (!ptr) return upb_DecodeVisit_Err(s, kUpb_DecodeStatus_Malformed);
+        if (f && !upb_DecodeVisit_Varint(s, f, val)) {
+          s->stopped = true;
+          return NULL;
+        }
+        break;
+      }
+      case kUpb_WireType_32Bit: {
+        uint32_t val;
+        ptr = upb_WireReader_ReadFixed32(ptr, &val);
+        if (f && !upb_DecodeVisit_Fixed32(s, f, val)) {
+          s->stopped = true;
+          return NULL;
+        }
+        break;
+      }
+      case kUpb_WireType_64Bit: {
+        uint64_t val;
+        ptr = upb_WireReader_ReadFixed64(ptr, &val);
+        if (f && !upb_DecodeVisit_Fixed64(s, f, val)) {
+          s->stopped = true;
+          return NULL;
+        }
+        break;
+      }
+      case kUpb_WireType_Delimited:
+        ptr = upb_DecodeVisit_Delimited(s, ptr, mt, f, depth);
+        if (!ptr) return NULL;
+        break;
+      case kUpb_WireType_StartGroup: {
+        if (f && f->UPB_PRIVATE(descriptortype) == kUpb_FieldType_Group &&
+            s->visitor->visit_submessage) {
+          const upb_MiniTable* sub =
+              mt->subs[f->UPB_PRIVATE(submsg_index)].submsg;
+          bool descend = false;
+          if (!s->visitor->visit_submessage(s->ctx, f, &descend)) {
+            s->stopped = true;
+            return NULL;
+          }
+          if (descend && sub) {
+            if (depth == 0) {
+              return upb_DecodeVisit_Err(s,
+                                         kUpb_DecodeStatus_MaxDepthExceeded);
+            }
+            ptr = upb_DecodeVisit_Msg(s, ptr, sub, field_number, depth - 1);
+            if (!ptr) return NULL;
+            if (s->visitor->end_submessage &&
+                !s->visitor->end_submessage(s->ctx, f)) {
+              s->stopped = true;
+              return NULL;
+            }
+            break;
+          }
+        }
+        ptr = upb_WireReader_SkipGroup(ptr, tag, &s->input);
+        if (!ptr) return upb_DecodeVisit_Err(s, kUpb_DecodeStatus_Malformed);
+        break;
+      }
+      default:
+        return upb_DecodeVisit_Err(s, kUpb_DecodeStatus_Malformed);
+    }
+  }
+
+  if (end_group != 0) {
+    // Input (or the enclosing limit) ended inside a group.
+    return upb_DecodeVisit_Err(s, kUpb_DecodeStatus_Malformed);
+  }
+  if (upb_EpsCopyInputStream_IsError(&s->input)) {
+    return upb_DecodeVisit_Err(s, kUpb_DecodeStatus_Malformed);
+  }
+  return ptr;
+}
+
+upb_DecodeStatus upb_DecodeVisit(const char* buf, size_t size,
+                                 const upb_MiniTable* mt,
+                                 const upb_DecodeVisitor* visitor, void* ctx) {
+  upb_VisitState state;
+  state.visitor = visitor;
+  state.ctx = ctx;
+  state.status = kUpb_DecodeStatus_Ok;
+  state.stopped = false;
+  upb_EpsCopyInputStream_Init(&state.input, &buf, size, true);
+
+  const char* ptr = upb_DecodeVisit_Msg(&state, buf, mt, 0,
+                                        kUpb_WireFormat_DefaultDepthLimit);
+  if (!ptr && state.stopped) return kUpb_DecodeStatus_Ok;
+  if (!ptr) return state.status;
+  return kUpb_DecodeStatus_Ok;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Visitor-mode decoding: invokes typed callbacks for fields of interest
+ * while skipping everything else at tag-skip speed.  No message is
+ * materialized and no arena is needed, which suits streaming aggregation
+ * (e.g. summing a few numeric fields out of a firehose of messages that are
+ * then dropped).  Where upb_Wire_ExtractField() works without a schema and
+ * reports raw wire values, this entry point uses the MiniTable to deliver
+ * decoded, correctly-typed values -- including the elements of packed
+ * repeated fields -- and can descend into sub-messages. */
+
+#ifndef UPB_WIRE_DECODE_VISIT_H_
+#define UPB_WIRE_DECODE_VISIT_H_
+
+#include "upb/base/string_view.h"
+#include "upb/mini_table/field.h"
+#include "upb/mini_table/message.h"
+#include "upb/wire/decode.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Callbacks for upb_DecodeVisit().  Any member may be NULL, in which case
+ * fields of that type are skipped.  Each callback receives the caller's
+ * |ctx|, the field being visited, and the decoded value; returning false
+ * stops the visit early (upb_DecodeVisit() then returns kUpb_DecodeStatus_Ok,
+ * as for an aggregator that has seen everything it needs).
+ *
+ * Numeric callbacks are chosen by the field's declared type, with zigzag
+ * and width handling already applied: {int32, sint32, sfixed32, enum} ->
+ * visit_int32, {uint32, fixed32} -> visit_uint32, and likewise for the
+ * 64-bit and floating-point types.  Packed repeated fields deliver one
+ * callback per element.  String values alias the input buffer and are valid
+ * only for the duration of the callback unless the caller copies them. */
+typedef struct {
+  bool (*visit_bool)(void* ctx, const upb_MiniTableField* f, bool val);
+  bool (*visit_int32)(void* ctx, const upb_MiniTableField* f, int32_t val);
+  bool (*visit_uint32)(void* ctx, const upb_MiniTableField* f, uint32_t val);
+  bool (*visit_int64)(void* ctx, const upb_MiniTableField* f, int64_t val);
+  bool (*visit_uint64)(void* ctx, const upb_MiniTableField* f, uint64_t val);
+  bool (*visit_float)(void* ctx, const upb_MiniTableField* f, float val);
+  bool (*visit_double)(void* ctx, const upb_MiniTableField* f, double val);
+  bool (*visit_string)(void* ctx, const upb_MiniTableField* f,
+                       upb_StringView val);
+
+  /* Called for each sub-message or group field (including map entries).
+   * Sets |*descend|: when true the nested fields are visited with these same
+   * callbacks, and end_submessage() fires when the nested message ends.
+   * When visit_submessage is NULL, sub-messages are skipped wholesale. */
+  bool (*visit_submessage)(void* ctx, const upb_MiniTableField* f,
+                           bool* descend);
+  bool (*end_submessage)(void* ctx, const upb_MiniTableField* f);
+} upb_DecodeVisitor;
+
+/* Scans [buf, buf+size) as a message of type |mt|, invoking |visitor|
+ * callbacks as described above.  Fields not in the MiniTable, fields whose
+ * wire type does not match their declared type, and fields without a
+ * callback are skipped via their length prefixes.  Returns
+ * kUpb_DecodeStatus_Ok on a complete (or callback-stopped) visit, otherwise
+ * the same malformed/depth statuses as upb_Decode(). */
+UPB_API upb_DecodeStatus upb_DecodeVisit(const char* buf, size_t size,
+                                         const upb_MiniTable* mt,
+                                         const upb_DecodeVisitor* visitor,
+                                         void* ctx);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_WIRE_DECODE_VISIT_H_ */
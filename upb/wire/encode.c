@@ -29,6 +29,9 @@
 
 #include "upb/wire/encode.h"
 
+#include "upb/wire/encode_fast.h"
+
+#include <stdlib.h>
 #include <string.h>
 
 #include "upb/collections/array_internal.h"
@@ -36,6 +39,9 @@
 #include "upb/message/accessors_internal.h"
 #include "upb/message/extension_internal.h"
 #include "upb/mini_table/sub.h"
+#ifdef UPB_PROFILE
+#include "upb/profile/profile.h"
+#endif
 #include "upb/wire/common.h"
 #include "upb/wire/common_internal.h"
 #include "upb/wire/swap_internal.h"
@@ -65,7 +71,58 @@ static uint64_t encode_zz64(int64_t n) {
   return ((uint64_t)n << 1) ^ (n >> 63);
 }
 
+typedef enum {
+  ENC_FRAME_MSG,              /* Walk a message: unknown, extensions, fields */
+  ENC_FRAME_MSGARRAY,         /* Remaining elements of a repeated (sub)message
+                               * or group field */
+  ENC_FRAME_MAP,              /* Remaining entries of a map with message
+                               * values */
+  ENC_FRAME_FINISH_DELIMITED, /* Child done: length varint + delimited tag */
+  ENC_FRAME_FINISH_GROUP,     /* Child done: start-group tag */
+  ENC_FRAME_FINISH_MAPENTRY,  /* Child (map value) done: value length + tag,
+                               * key, entry length + tag */
+  ENC_FRAME_FINISH_MSGSET,    /* Child done: message-set item wrapper */
+} encode_framekind;
+
+/* One suspended level of the iterative traversal in encode_message().  The
+ * encoder writes back-to-front, so whenever a sub-message must be encoded we
+ * push a "finish" frame recording what to emit once the child's size is
+ * known, then a frame for the child itself. */
 typedef struct {
+  uint8_t kind;   // encode_framekind
+  uint8_t phase;  // ENC_FRAME_MSG only; see encode_stepmsg().
+  bool is_group;  // ENC_FRAME_MSGARRAY: elements are groups.
+  uint32_t number;
+  size_t pre_len;  // Output size when the frame was pushed.
+  union {
+    struct {
+      const upb_Message* msg;
+      const upb_MiniTable* mt;
+      uint32_t field_idx;  // Fields left; the next one is fields[field_idx-1].
+      const upb_Message_Extension* ext_ptr;
+      const upb_Message_Extension* ext_end;
+      _upb_sortedmap sorted_exts;
+      bool sorted_active;
+    } msg;
+    struct {
+      const upb_TaggedMessagePtr* elems;
+      size_t remaining;  // The next element is elems[remaining-1].
+      const upb_MiniTable* subm;
+    } arr;
+    struct {
+      const upb_Map* map;
+      const upb_MiniTable* layout;
+      intptr_t iter;
+      _upb_sortedmap sorted;
+    } map;
+    struct {
+      const upb_MiniTable* layout;
+      upb_MapEntry ent;  // Only the key half is still needed at finish time.
+    } mapent;
+  } u;
+} upb_EncodeFrame;
+
+typedef struct upb_Encoder {
   upb_EncodeStatus status;
   jmp_buf err;
   upb_Arena* arena;
@@ -73,6 +130,12 @@ typedef struct {
   int options;
   int depth;
   _upb_mapsorter sorter;
+  // Explicit traversal stack; grows on demand, freed per encode like the
+  // sorter.  C-stack usage is constant regardless of message nesting, so the
+  // depth limit (options >> 16) can be raised freely for deep trees.
+  upb_EncodeFrame* stack;
+  size_t stack_len;
+  size_t stack_cap;
 } upb_encstate;
 
 static size_t upb_roundup_pow2(size_t bytes) {
@@ -91,6 +154,10 @@ UPB_NORETURN static void encode_err(upb_encstate* e, upb_EncodeStatus s) {
 
 UPB_NOINLINE
 static void encode_growbuffer(upb_encstate* e, size_t bytes) {
+  if (!e->arena) {
+    // upb_Encode_IntoBuffer(): the caller-provided buffer cannot grow.
+    encode_err(e, kUpb_EncodeStatus_OutOfMemory);
+  }
   size_t old_size = e->limit - e->buf;
   size_t new_size = upb_roundup_pow2(bytes + (e->limit - e->ptr));
   char* new_buf = upb_Arena_Realloc(e->arena, e->buf, old_size, new_size);
@@ -162,6 +229,101 @@ static void encode_varint(upb_encstate* e, uint64_t val) {
   }
 }
 
+// Wide varint stores: the varint (or a tag+value pair) is composed in a
+// 128-bit register and written with one unaligned 16-byte store instead of a
+// byte-at-a-time loop.  The store is right-aligned at e->ptr - 16, so the
+// unused low bytes land below the cursor, where this back-to-front writer
+// either overwrites them later or leaves them outside the final output.
+// Requires the compiler's __int128 and a little-endian target (the runtime
+// check constant-folds).
+#ifdef __SIZEOF_INT128__
+#define UPB_WIDE_VARINT 1
+#endif
+
+#ifdef UPB_WIDE_VARINT
+
+// Composes the varint encoding of |val| into the low bytes of a 128-bit
+// register (first wire byte lowest) and writes the encoded size to |len|.
+UPB_FORCEINLINE
+static unsigned __int128 encode_varint128(uint64_t val, size_t* len) {
+  size_t n = (size_t)(64 - __builtin_clzll(val | 1) + 6) / 7;
+  unsigned __int128 out = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t byte = (val >> (7 * i)) & 0x7f;
+    if (i + 1 != n) byte |= 0x80;
+    out |= (unsigned __int128)byte << (8 * i);
+  }
+  *len = n;
+  return out;
+}
+
+// Emits the low |len| bytes of |bytes| with a single 16-byte store.  The
+// caller must have checked that 16 bytes are available below e->ptr.
+UPB_FORCEINLINE
+static void encode_widestore(upb_encstate* e, unsigned __int128 bytes,
+                             size_t len) {
+  UPB_ASSERT(len <= 16 && (size_t)(e->ptr - e->buf) >= 16);
+  bytes <<= 8 * (16 - len);
+  memcpy(e->ptr - 16, &bytes, 16);
+  e->ptr -= len;
+}
+
+#endif /* UPB_WIDE_VARINT */
+
+UPB_FORCEINLINE
+static bool encode_wide_ok(upb_encstate* e, size_t bytes) {
+#ifdef UPB_WIDE_VARINT
+  return _upb_IsLittleEndian() && (size_t)(e->ptr - e->buf) >= bytes;
+#else
+  UPB_UNUSED(e);
+  UPB_UNUSED(bytes);
+  return false;
+#endif
+}
+
+// True if a packed run of |count| varints fits below e->ptr even in the worst
+// case, so each element can be emitted without its own space check.
+UPB_FORCEINLINE
+static bool encode_wide_bulk_ok(upb_encstate* e, size_t count) {
+  size_t avail = (size_t)(e->ptr - e->buf);
+  return encode_wide_ok(e, 16) &&
+         count <= (avail - 16) / UPB_PB_VARINT_MAX_LEN;
+}
+
+/* Emits |tag| followed (in stream order) by the varint |val|: one fused store
+ * when possible, since the pair is at most 5 + 10 <= 16 bytes. */
+UPB_FORCEINLINE
+static void encode_tagvarint(upb_encstate* e, uint32_t tag, uint64_t val) {
+#ifdef UPB_WIDE_VARINT
+  if (encode_wide_ok(e, 16)) {
+    size_t vlen, tlen;
+    unsigned __int128 v = encode_varint128(val, &vlen);
+    unsigned __int128 t = encode_varint128(tag, &tlen);
+    encode_widestore(e, t | (v << (8 * tlen)), tlen + vlen);
+    return;
+  }
+#endif
+  encode_varint(e, val);
+  encode_varint(e, tag);
+}
+
+/* One element of a packed varint run; |fits| is the run's hoisted space
+ * check from encode_wide_bulk_ok(). */
+UPB_FORCEINLINE
+static void encode_packedvarint(upb_encstate* e, uint64_t val, bool fits) {
+#ifdef UPB_WIDE_VARINT
+  if (fits) {
+    size_t len;
+    unsigned __int128 v = encode_varint128(val, &len);
+    encode_widestore(e, v, len);
+    return;
+  }
+#else
+  UPB_UNUSED(fits);
+#endif
+  encode_varint(e, val);
+}
+
 static void encode_double(upb_encstate* e, double d) {
   uint64_t u64;
   UPB_ASSERT(sizeof(double) == sizeof(uint64_t));
@@ -211,18 +373,9 @@ static void encode_fixedarray(upb_encstate* e, const upb_Array* arr,
   }
 }
 
-static void encode_message(upb_encstate* e, const upb_Message* msg,
-                           const upb_MiniTable* m, size_t* size);
-
-static void encode_TaggedMessagePtr(upb_encstate* e,
-                                    upb_TaggedMessagePtr tagged,
-                                    const upb_MiniTable* m, size_t* size) {
-  if (upb_TaggedMessagePtr_IsEmpty(tagged)) {
-    m = &_kUpb_MiniTable_Empty;
-  }
-  encode_message(e, _upb_TaggedMessagePtr_GetMessage(tagged), m, size);
-}
-
+/* Encodes a scalar of any non-message type.  Sub-message and group fields
+ * suspend the traversal instead and are handled by the frame machinery in
+ * encode_message(). */
 static void encode_scalar(upb_encstate* e, const void* _field_mem,
                           const upb_MiniTableSub* subs,
                           const upb_MiniTableField* f) {
@@ -237,6 +390,15 @@ static void encode_scalar(upb_encstate* e, const void* _field_mem,
     break;                                  \
   }
 
+/* Varint-typed fields emit tag and value in one fused store. */
+#define VCASE(ctype, encodeval)                                            \
+  {                                                                        \
+    ctype val = *(ctype*)field_mem;                                        \
+    encode_tagvarint(e, (f->number << 3) | kUpb_WireType_Varint,           \
+                     encodeval);                                           \
+    return;                                                                \
+  }
+
   switch (f->UPB_PRIVATE(descriptortype)) {
     case kUpb_FieldType_Double:
       CASE(double, double, kUpb_WireType_64Bit, val);
@@ -244,12 +406,12 @@ static void encode_scalar(upb_encstate* e, const void* _field_mem,
       CASE(float, float, kUpb_WireType_32Bit, val);
     case kUpb_FieldType_Int64:
     case kUpb_FieldType_UInt64:
-      CASE(uint64_t, varint, kUpb_WireType_Varint, val);
+      VCASE(uint64_t, val);
     case kUpb_FieldType_UInt32:
-      CASE(uint32_t, varint, kUpb_WireType_Varint, val);
+      VCASE(uint32_t, val);
     case kUpb_FieldType_Int32:
     case kUpb_FieldType_Enum:
-      CASE(int32_t, varint, kUpb_WireType_Varint, (int64_t)val);
+      VCASE(int32_t, (int64_t)val);
     case kUpb_FieldType_SFixed64:
     case kUpb_FieldType_Fixed64:
       CASE(uint64_t, fixed64, kUpb_WireType_64Bit, val);
@@ -257,51 +419,30 @@ static void encode_scalar(upb_encstate* e, const void* _field_mem,
     case kUpb_FieldType_SFixed32:
       CASE(uint32_t, fixed32, kUpb_WireType_32Bit, val);
     case kUpb_FieldType_Bool:
-      CASE(bool, varint, kUpb_WireType_Varint, val);
+      VCASE(bool, val);
     case kUpb_FieldType_SInt32:
-      CASE(int32_t, varint, kUpb_WireType_Varint, encode_zz32(val));
+      VCASE(int32_t, encode_zz32(val));
     case kUpb_FieldType_SInt64:
-      CASE(int64_t, varint, kUpb_WireType_Varint, encode_zz64(val));
+      VCASE(int64_t, encode_zz64(val));
     case kUpb_FieldType_String:
     case kUpb_FieldType_Bytes: {
-      upb_StringView view = *(upb_StringView*)field_mem;
-      encode_bytes(e, view.data, view.size);
-      encode_varint(e, view.size);
-      wire_type = kUpb_WireType_Delimited;
-      break;
-    }
-    case kUpb_FieldType_Group: {
-      size_t size;
-      upb_TaggedMessagePtr submsg = *(upb_TaggedMessagePtr*)field_mem;
-      const upb_MiniTable* subm = subs[f->UPB_PRIVATE(submsg_index)].submsg;
-      if (submsg == 0) {
-        return;
-      }
-      if (--e->depth == 0) encode_err(e, kUpb_EncodeStatus_MaxDepthExceeded);
-      encode_tag(e, f->number, kUpb_WireType_EndGroup);
-      encode_TaggedMessagePtr(e, submsg, subm, &size);
-      wire_type = kUpb_WireType_StartGroup;
-      e->depth++;
-      break;
-    }
-    case kUpb_FieldType_Message: {
-      size_t size;
-      upb_TaggedMessagePtr submsg = *(upb_TaggedMessagePtr*)field_mem;
-      const upb_MiniTable* subm = subs[f->UPB_PRIVATE(submsg_index)].submsg;
-      if (submsg == 0) {
-        return;
+      upb_StringView view;
+      if (UPB_UNLIKELY(_upb_MiniTableField_IsInlineString(f)) &&
+          _upb_InlineString_IsInline(field_mem)) {
+        view = _upb_InlineString_Decode(field_mem);
+      } else {
+        view = *(upb_StringView*)field_mem;
       }
-      if (--e->depth == 0) encode_err(e, kUpb_EncodeStatus_MaxDepthExceeded);
-      encode_TaggedMessagePtr(e, submsg, subm, &size);
-      encode_varint(e, size);
-      wire_type = kUpb_WireType_Delimited;
-      e->depth++;
-      break;
+      encode_bytes(e, view.data, view.size);
+      encode_tagvarint(e, (f->number << 3) | kUpb_WireType_Delimited,
+                       view.size);
+      return;
     }
     default:
       UPB_UNREACHABLE();
   }
 #undef CASE
+#undef VCASE
 
   encode_tag(e, f->number, wire_type);
 }
@@ -322,10 +463,14 @@ static void encode_array(upb_encstate* e, const upb_Message* msg,
     const ctype* start = _upb_array_constptr(arr);                       \
     const ctype* ptr = start + arr->size;                                \
     uint32_t tag = packed ? 0 : (f->number << 3) | kUpb_WireType_Varint; \
+    const bool fits = !tag && encode_wide_bulk_ok(e, arr->size);         \
     do {                                                                 \
       ptr--;                                                             \
-      encode_varint(e, encode);                                          \
-      if (tag) encode_varint(e, tag);                                    \
+      if (tag) {                                                         \
+        encode_tagvarint(e, tag, encode);                                \
+      } else {                                                           \
+        encode_packedvarint(e, encode, fits);                            \
+      }                                                                  \
     } while (ptr != start);                                              \
   }                                                                      \
   break;
@@ -368,47 +513,21 @@ static void encode_array(upb_encstate* e, const upb_Message* msg,
       do {
         ptr--;
         encode_bytes(e, ptr->data, ptr->size);
-        encode_varint(e, ptr->size);
-        encode_tag(e, f->number, kUpb_WireType_Delimited);
+        encode_tagvarint(e, (f->number << 3) | kUpb_WireType_Delimited,
+                         ptr->size);
       } while (ptr != start);
       return;
     }
-    case kUpb_FieldType_Group: {
-      const upb_TaggedMessagePtr* start = _upb_array_constptr(arr);
-      const upb_TaggedMessagePtr* ptr = start + arr->size;
-      const upb_MiniTable* subm = subs[f->UPB_PRIVATE(submsg_index)].submsg;
-      if (--e->depth == 0) encode_err(e, kUpb_EncodeStatus_MaxDepthExceeded);
-      do {
-        size_t size;
-        ptr--;
-        encode_tag(e, f->number, kUpb_WireType_EndGroup);
-        encode_TaggedMessagePtr(e, *ptr, subm, &size);
-        encode_tag(e, f->number, kUpb_WireType_StartGroup);
-      } while (ptr != start);
-      e->depth++;
-      return;
-    }
-    case kUpb_FieldType_Message: {
-      const upb_TaggedMessagePtr* start = _upb_array_constptr(arr);
-      const upb_TaggedMessagePtr* ptr = start + arr->size;
-      const upb_MiniTable* subm = subs[f->UPB_PRIVATE(submsg_index)].submsg;
-      if (--e->depth == 0) encode_err(e, kUpb_EncodeStatus_MaxDepthExceeded);
-      do {
-        size_t size;
-        ptr--;
-        encode_TaggedMessagePtr(e, *ptr, subm, &size);
-        encode_varint(e, size);
-        encode_tag(e, f->number, kUpb_WireType_Delimited);
-      } while (ptr != start);
-      e->depth++;
-      return;
-    }
+    case kUpb_FieldType_Group:
+    case kUpb_FieldType_Message:
+      // Handled by the frame machinery in encode_message().
+      UPB_UNREACHABLE();
   }
 #undef VARINT_CASE
 
   if (packed) {
-    encode_varint(e, e->limit - e->ptr - pre_len);
-    encode_tag(e, f->number, kUpb_WireType_Delimited);
+    encode_tagvarint(e, (f->number << 3) | kUpb_WireType_Delimited,
+                     e->limit - e->ptr - pre_len);
   }
 }
 
@@ -422,8 +541,7 @@ static void encode_mapentry(upb_encstate* e, uint32_t number,
   encode_scalar(e, &ent->data.v, layout->subs, val_field);
   encode_scalar(e, &ent->data.k, layout->subs, key_field);
   size = (e->limit - e->ptr) - pre_len;
-  encode_varint(e, size);
-  encode_tag(e, number, kUpb_WireType_Delimited);
+  encode_tagvarint(e, (number << 3) | kUpb_WireType_Delimited, size);
 }
 
 static void encode_map(upb_encstate* e, const upb_Message* msg,
@@ -445,6 +563,15 @@ static void encode_map(upb_encstate* e, const upb_Message* msg,
       encode_mapentry(e, f->number, layout, &ent);
     }
     _upb_mapsorter_popmap(&e->sorter, &sorted);
+  } else if (map->is_flat) {
+    size_t iter = kUpb_Map_Begin;
+    const char* slot;
+    while ((slot = _upb_FlatMap_Next(map, &iter)) != NULL) {
+      upb_MapEntry ent;
+      memcpy(&ent.data.k, slot, map->key_size);
+      memcpy(&ent.data.v, slot + map->key_size, map->val_size);
+      encode_mapentry(e, f->number, layout, &ent);
+    }
   } else {
     intptr_t iter = UPB_STRTABLE_BEGIN;
     upb_StringView key;
@@ -496,104 +623,467 @@ static bool encode_shouldencode(upb_encstate* e, const upb_Message* msg,
   }
 }
 
-static void encode_field(upb_encstate* e, const upb_Message* msg,
-                         const upb_MiniTableSub* subs,
-                         const upb_MiniTableField* field) {
-  switch (upb_FieldMode_Get(field)) {
-    case kUpb_FieldMode_Array:
-      encode_array(e, msg, subs, field);
-      break;
-    case kUpb_FieldMode_Map:
-      encode_map(e, msg, subs, field);
-      break;
-    case kUpb_FieldMode_Scalar:
-      encode_scalar(e, UPB_PTR_AT(msg, field->offset, void), subs, field);
-      break;
-    default:
-      UPB_UNREACHABLE();
+/* Incremental re-encode (kUpb_DecodeOption_RetainWireBytes): a message whose
+ * retained wire span is still valid can be copied to the output verbatim.
+ * Mutating accessors drop the span of the message they touch, but a mutable
+ * sub-message handle is handed out without going through the parent, so
+ * before reusing a span we verify that every reachable sub-message still has
+ * a span of its own nested inside ours.  A dirty child forces a re-walk of
+ * this message only; clean subtrees below it are still copied verbatim. */
+static bool encode_spanclean(const upb_Message* msg, const upb_MiniTable* m,
+                             const char* span, size_t span_size);
+
+static bool encode_childspanclean(const upb_Message* child,
+                                  const upb_MiniTable* subm, const char* span,
+                                  size_t span_size) {
+  size_t child_size;
+  const char* child_span = _upb_Message_GetWireSpan(child, &child_size);
+  if (!child_span) return false;
+  if (child_span < span || child_span + child_size > span + span_size) {
+    return false;
   }
+  return encode_spanclean(child, subm, child_span, child_size);
 }
 
-static void encode_msgset_item(upb_encstate* e,
-                               const upb_Message_Extension* ext) {
-  size_t size;
-  encode_tag(e, kUpb_MsgSet_Item, kUpb_WireType_EndGroup);
-  encode_message(e, ext->data.ptr, ext->ext->sub.submsg, &size);
-  encode_varint(e, size);
-  encode_tag(e, kUpb_MsgSet_Message, kUpb_WireType_Delimited);
-  encode_varint(e, ext->ext->field.number);
-  encode_tag(e, kUpb_MsgSet_TypeId, kUpb_WireType_Varint);
-  encode_tag(e, kUpb_MsgSet_Item, kUpb_WireType_StartGroup);
-}
-
-static void encode_ext(upb_encstate* e, const upb_Message_Extension* ext,
-                       bool is_message_set) {
-  if (UPB_UNLIKELY(is_message_set)) {
-    encode_msgset_item(e, ext);
-  } else {
-    encode_field(e, &ext->data, &ext->ext->sub, &ext->ext->field);
+static bool encode_spanclean(const upb_Message* msg, const upb_MiniTable* m,
+                             const char* span, size_t span_size) {
+  for (int i = 0; i < m->field_count; i++) {
+    const upb_MiniTableField* f = &m->fields[i];
+    if (f->UPB_PRIVATE(descriptortype) != kUpb_FieldType_Message &&
+        f->UPB_PRIVATE(descriptortype) != kUpb_FieldType_Group) {
+      continue;
+    }
+    const upb_MiniTable* subm = m->subs[f->UPB_PRIVATE(submsg_index)].submsg;
+    switch (upb_FieldMode_Get(f)) {
+      case kUpb_FieldMode_Array: {
+        const upb_Array* arr = *UPB_PTR_AT(msg, f->offset, const upb_Array*);
+        if (!arr) break;
+        const upb_TaggedMessagePtr* elems = _upb_array_constptr(arr);
+        for (size_t j = 0; j < arr->size; j++) {
+          if (!encode_childspanclean(_upb_TaggedMessagePtr_GetMessage(elems[j]),
+                                     subm, span, span_size)) {
+            return false;
+          }
+        }
+        break;
+      }
+      case kUpb_FieldMode_Map:
+        /* Maps have no message-level mutation funnel, so a recorded span can
+         * go stale undetected; the decoder never records one for map-bearing
+         * layouts and we never trust one here. */
+        return false;
+      case kUpb_FieldMode_Scalar: {
+        upb_TaggedMessagePtr submsg =
+            *UPB_PTR_AT(msg, f->offset, upb_TaggedMessagePtr);
+        if (submsg == 0) break;
+        if (!encode_childspanclean(_upb_TaggedMessagePtr_GetMessage(submsg),
+                                   subm, span, span_size)) {
+          return false;
+        }
+        break;
+      }
+      default:
+        UPB_UNREACHABLE();
+    }
   }
+  return true;
 }
 
-static void encode_message(upb_encstate* e, const upb_Message* msg,
-                           const upb_MiniTable* m, size_t* size) {
-  size_t pre_len = e->limit - e->ptr;
+/* frame machinery ************************************************************/
 
-  if ((e->options & kUpb_EncodeOption_CheckRequired) && m->required_count) {
-    uint64_t msg_head;
-    memcpy(&msg_head, msg, 8);
-    msg_head = _upb_BigEndian_Swap64(msg_head);
-    if (upb_MiniTable_requiredmask(m) & ~msg_head) {
-      encode_err(e, kUpb_EncodeStatus_MissingRequired);
-    }
+/* The traversal below is iterative: instead of C recursion, suspended levels
+ * live on an explicit heap-grown stack of upb_EncodeFrames.  C-stack usage is
+ * therefore constant no matter how deep the tree is, and the nesting limit
+ * (options >> 16) is a pure wire-format policy that callers can raise for
+ * deep document trees without provisioning thread stacks.  Leaf work (scalar
+ * fields, packed arrays, string copies) still runs in straight-line code. */
+
+static upb_EncodeFrame* encode_pushframe(upb_encstate* e) {
+  if (UPB_UNLIKELY(e->stack_len == e->stack_cap)) {
+    size_t new_cap = e->stack_cap ? e->stack_cap * 2 : 16;
+    upb_EncodeFrame* stack = realloc(e->stack, new_cap * sizeof(*stack));
+    if (!stack) encode_err(e, kUpb_EncodeStatus_OutOfMemory);
+    e->stack = stack;
+    e->stack_cap = new_cap;
   }
+  return &e->stack[e->stack_len++];
+}
 
-  if ((e->options & kUpb_EncodeOption_SkipUnknown) == 0) {
-    size_t unknown_size;
-    const char* unknown = upb_Message_GetUnknown(msg, &unknown_size);
+static upb_EncodeFrame* encode_pushfinish(upb_encstate* e,
+                                          encode_framekind kind,
+                                          uint32_t number) {
+  upb_EncodeFrame* fr = encode_pushframe(e);
+  fr->kind = kind;
+  fr->number = number;
+  fr->pre_len = e->limit - e->ptr;
+  return fr;
+}
 
-    if (unknown) {
-      encode_bytes(e, unknown, unknown_size);
-    }
+static void encode_pushmsg(upb_encstate* e, const upb_Message* msg,
+                           const upb_MiniTable* m) {
+  upb_EncodeFrame* fr = encode_pushframe(e);
+  fr->kind = ENC_FRAME_MSG;
+  fr->phase = 0;
+  fr->u.msg.msg = msg;
+  fr->u.msg.mt = m;
+}
+
+static void encode_pushchild(upb_encstate* e, upb_TaggedMessagePtr tagged,
+                             const upb_MiniTable* m) {
+  if (upb_TaggedMessagePtr_IsEmpty(tagged)) {
+    m = &_kUpb_MiniTable_Empty;
   }
+  encode_pushmsg(e, _upb_TaggedMessagePtr_GetMessage(tagged), m);
+}
+
+/* Encodes one present field.  Leaf fields are written immediately and false
+ * is returned; fields that contain sub-messages push frames and return true,
+ * in which case the caller must return to the driver loop (its frame pointer
+ * may have been invalidated by stack growth). */
+static bool encode_visitfield(upb_encstate* e, const upb_Message* msg,
+                              const upb_MiniTableSub* subs,
+                              const upb_MiniTableField* f) {
+  const int type = f->UPB_PRIVATE(descriptortype);
+  const bool is_submsg =
+      type == kUpb_FieldType_Message || type == kUpb_FieldType_Group;
 
-  if (m->ext != kUpb_ExtMode_NonExtendable) {
-    /* Encode all extensions together. Unlike C++, we do not attempt to keep
-     * these in field number order relative to normal fields or even to each
-     * other. */
-    size_t ext_count;
-    const upb_Message_Extension* ext = _upb_Message_Getexts(msg, &ext_count);
-    if (ext_count) {
+  switch (upb_FieldMode_Get(f)) {
+    case kUpb_FieldMode_Array: {
+      if (!is_submsg) {
+        encode_array(e, msg, subs, f);
+        return false;
+      }
+      const upb_Array* arr = *UPB_PTR_AT(msg, f->offset, upb_Array*);
+      if (!arr || !arr->size) return false;
+      upb_EncodeFrame* fr = encode_pushframe(e);
+      fr->kind = ENC_FRAME_MSGARRAY;
+      fr->is_group = type == kUpb_FieldType_Group;
+      fr->number = f->number;
+      fr->u.arr.elems = _upb_array_constptr(arr);
+      fr->u.arr.remaining = arr->size;
+      fr->u.arr.subm = subs[f->UPB_PRIVATE(submsg_index)].submsg;
+      return true;
+    }
+    case kUpb_FieldMode_Map: {
+      const upb_Map* map = *UPB_PTR_AT(msg, f->offset, const upb_Map*);
+      if (!map) return false;
+      const upb_MiniTable* layout = subs[f->UPB_PRIVATE(submsg_index)].submsg;
+      UPB_ASSERT(layout->field_count == 2);
+      if (layout->fields[1].UPB_PRIVATE(descriptortype) !=
+          kUpb_FieldType_Message) {
+        encode_map(e, msg, subs, f);
+        return false;
+      }
+      upb_EncodeFrame* fr = encode_pushframe(e);
+      fr->kind = ENC_FRAME_MAP;
+      fr->number = f->number;
+      fr->u.map.map = map;
+      fr->u.map.layout = layout;
+      fr->u.map.iter = UPB_STRTABLE_BEGIN;
       if (e->options & kUpb_EncodeOption_Deterministic) {
-        _upb_sortedmap sorted;
-        _upb_mapsorter_pushexts(&e->sorter, ext, ext_count, &sorted);
-        while (_upb_sortedmap_nextext(&e->sorter, &sorted, &ext)) {
-          encode_ext(e, ext, m->ext == kUpb_ExtMode_IsMessageSet);
-        }
-        _upb_mapsorter_popmap(&e->sorter, &sorted);
+        _upb_mapsorter_pushmap(&e->sorter,
+                               layout->fields[0].UPB_PRIVATE(descriptortype),
+                               map, &fr->u.map.sorted);
+      }
+      return true;
+    }
+    case kUpb_FieldMode_Scalar: {
+      if (!is_submsg) {
+        encode_scalar(e, UPB_PTR_AT(msg, f->offset, void), subs, f);
+        return false;
+      }
+      upb_TaggedMessagePtr tagged =
+          *UPB_PTR_AT(msg, f->offset, upb_TaggedMessagePtr);
+      if (tagged == 0) return false;
+      if (--e->depth == 0) encode_err(e, kUpb_EncodeStatus_MaxDepthExceeded);
+      if (type == kUpb_FieldType_Group) {
+        encode_tag(e, f->number, kUpb_WireType_EndGroup);
+        encode_pushfinish(e, ENC_FRAME_FINISH_GROUP, f->number);
       } else {
-        const upb_Message_Extension* end = ext + ext_count;
-        for (; ext != end; ext++) {
-          encode_ext(e, ext, m->ext == kUpb_ExtMode_IsMessageSet);
+        encode_pushfinish(e, ENC_FRAME_FINISH_DELIMITED, f->number);
+      }
+      encode_pushchild(e, tagged, subs[f->UPB_PRIVATE(submsg_index)].submsg);
+      return true;
+    }
+    default:
+      UPB_UNREACHABLE();
+  }
+}
+
+static void encode_stepmsg(upb_encstate* e, upb_EncodeFrame* fr) {
+  const upb_Message* msg = fr->u.msg.msg;
+  const upb_MiniTable* m = fr->u.msg.mt;
+
+  if (fr->phase == 0) {
+    if ((e->options & kUpb_EncodeOption_CheckRequired) && m->required_count) {
+      uint64_t msg_head;
+      memcpy(&msg_head, msg, 8);
+      msg_head = _upb_BigEndian_Swap64(msg_head);
+      if (upb_MiniTable_requiredmask(m) & ~msg_head) {
+        encode_err(e, kUpb_EncodeStatus_MissingRequired);
+      }
+    }
+
+    {
+      size_t span_size;
+      const char* span = _upb_Message_GetWireSpan(msg, &span_size);
+      if (span) {
+        /* The span is usable only if the byte-affecting options match the
+         * ones it was produced with (0 for parse-retained bytes). */
+        const uint32_t byte_options =
+            e->options &
+            (kUpb_EncodeOption_SkipUnknown | kUpb_EncodeOption_Deterministic);
+        if (byte_options == _upb_Message_GetWireSpanOptions(msg) &&
+            (_upb_Message_IsFrozen(msg) ||
+             encode_spanclean(msg, m, span, span_size))) {
+          /* The retained bytes already contain this message's fields, unknown
+           * fields and extensions.  A frozen message cannot have been mutated
+           * since upb_Message_Freeze() cached its encoding, so the per-child
+           * span check is unnecessary. */
+          encode_bytes(e, span, span_size);
+          e->stack_len--;
+          return;
         }
       }
     }
+
+    if ((e->options & kUpb_EncodeOption_SkipUnknown) == 0) {
+      size_t unknown_size;
+      const char* unknown = upb_Message_GetUnknown(msg, &unknown_size);
+
+      if (unknown) {
+        encode_bytes(e, unknown, unknown_size);
+      }
+    }
+
+    fr->u.msg.ext_ptr = NULL;
+    fr->u.msg.ext_end = NULL;
+    fr->u.msg.sorted_active = false;
+    if (m->ext != kUpb_ExtMode_NonExtendable) {
+      /* Encode all extensions together. Unlike C++, we do not attempt to keep
+       * these in field number order relative to normal fields or even to each
+       * other. */
+      size_t ext_count;
+      const upb_Message_Extension* ext = _upb_Message_Getexts(msg, &ext_count);
+      if (ext_count) {
+        if (e->options & kUpb_EncodeOption_Deterministic) {
+          _upb_mapsorter_pushexts(&e->sorter, ext, ext_count,
+                                  &fr->u.msg.sorted_exts);
+          fr->u.msg.sorted_active = true;
+        } else {
+          fr->u.msg.ext_ptr = ext;
+          fr->u.msg.ext_end = ext + ext_count;
+        }
+      }
+    }
+    fr->phase = 1;
   }
 
-  if (m->field_count) {
-    const upb_MiniTableField* f = &m->fields[m->field_count];
-    const upb_MiniTableField* first = &m->fields[0];
-    while (f != first) {
-      f--;
-      if (encode_shouldencode(e, msg, m->subs, f)) {
-        encode_field(e, msg, m->subs, f);
+  if (fr->phase == 1) {
+    const bool is_msgset = m->ext == kUpb_ExtMode_IsMessageSet;
+    for (;;) {
+      const upb_Message_Extension* ext;
+      if (fr->u.msg.sorted_active) {
+        if (!_upb_sortedmap_nextext(&e->sorter, &fr->u.msg.sorted_exts,
+                                    &ext)) {
+          _upb_mapsorter_popmap(&e->sorter, &fr->u.msg.sorted_exts);
+          break;
+        }
+      } else {
+        if (fr->u.msg.ext_ptr == fr->u.msg.ext_end) break;
+        ext = fr->u.msg.ext_ptr++;
+      }
+      if (UPB_UNLIKELY(is_msgset)) {
+        encode_tag(e, kUpb_MsgSet_Item, kUpb_WireType_EndGroup);
+        encode_pushfinish(e, ENC_FRAME_FINISH_MSGSET, ext->ext->field.number);
+        encode_pushmsg(e, ext->data.ptr, ext->ext->sub.submsg);
+        return;
       }
+      if (encode_visitfield(e, &ext->data, &ext->ext->sub, &ext->ext->field)) {
+        return;
+      }
+    }
+
+    if (m->fast_encode) {
+      // Generated straight-line encoder; covers exactly what the metadata
+      // walk below would do for this message type (see upb/wire/encode_fast.h)
+      // and never contains sub-message fields.
+      m->fast_encode(e, msg, m);
+      fr->u.msg.field_idx = 0;
+    } else {
+      fr->u.msg.field_idx = m->field_count;
+    }
+    fr->phase = 2;
+  }
+
+  while (fr->u.msg.field_idx) {
+    const upb_MiniTableField* f = &m->fields[--fr->u.msg.field_idx];
+    if (!encode_shouldencode(e, msg, m->subs, f)) continue;
+    if (encode_visitfield(e, msg, m->subs, f)) return;
+  }
+  e->stack_len--;
+}
+
+static void encode_steparray(upb_encstate* e, upb_EncodeFrame* fr) {
+  if (fr->u.arr.remaining == 0) {
+    e->stack_len--;
+    return;
+  }
+  upb_TaggedMessagePtr tagged = fr->u.arr.elems[--fr->u.arr.remaining];
+  const uint32_t number = fr->number;
+  const bool is_group = fr->is_group;
+  const upb_MiniTable* subm = fr->u.arr.subm;
+
+  if (--e->depth == 0) encode_err(e, kUpb_EncodeStatus_MaxDepthExceeded);
+  if (is_group) {
+    encode_tag(e, number, kUpb_WireType_EndGroup);
+    encode_pushfinish(e, ENC_FRAME_FINISH_GROUP, number);
+  } else {
+    encode_pushfinish(e, ENC_FRAME_FINISH_DELIMITED, number);
+  }
+  encode_pushchild(e, tagged, subm);
+}
+
+static void encode_stepmap(upb_encstate* e, upb_EncodeFrame* fr) {
+  const upb_Map* map = fr->u.map.map;
+  const upb_MiniTable* layout = fr->u.map.layout;
+  const uint32_t number = fr->number;
+  upb_MapEntry ent;
+  bool got;
+
+  if (e->options & kUpb_EncodeOption_Deterministic) {
+    got = _upb_sortedmap_next(&e->sorter, map, &fr->u.map.sorted, &ent);
+    if (!got) _upb_mapsorter_popmap(&e->sorter, &fr->u.map.sorted);
+  } else if (map->is_flat) {
+    const char* slot = _upb_FlatMap_Next(map, (size_t*)&fr->u.map.iter);
+    got = slot != NULL;
+    if (got) {
+      memcpy(&ent.data.k, slot, map->key_size);
+      memcpy(&ent.data.v, slot + map->key_size, map->val_size);
+    }
+  } else {
+    upb_StringView key;
+    upb_value val;
+    got = upb_strtable_next2(&map->table, &key, &val, &fr->u.map.iter);
+    if (got) {
+      _upb_map_fromkey(key, &ent.data.k, map->key_size);
+      _upb_map_fromvalue(val, &ent.data.v, map->val_size);
+    }
+  }
+  if (!got) {
+    e->stack_len--;
+    return;
+  }
+
+  upb_TaggedMessagePtr tagged;
+  memcpy(&tagged, &ent.data.v, sizeof(tagged));
+  if (tagged == 0) {
+    /* An unset message value encodes as an entry holding only the key,
+     * matching the recursive encoder's early return for NULL sub-messages. */
+    size_t entry_pre_len = e->limit - e->ptr;
+    encode_scalar(e, &ent.data.k, layout->subs, &layout->fields[0]);
+    encode_tagvarint(e, (number << 3) | kUpb_WireType_Delimited,
+                     (e->limit - e->ptr) - entry_pre_len);
+    return;
+  }
+
+  if (--e->depth == 0) encode_err(e, kUpb_EncodeStatus_MaxDepthExceeded);
+  upb_EncodeFrame* fin =
+      encode_pushfinish(e, ENC_FRAME_FINISH_MAPENTRY, number);
+  fin->u.mapent.layout = layout;
+  fin->u.mapent.ent = ent;
+  encode_pushchild(
+      e, tagged,
+      layout->subs[layout->fields[1].UPB_PRIVATE(submsg_index)].submsg);
+}
+
+static void encode_finish(upb_encstate* e, upb_EncodeFrame* fr) {
+  const size_t size = (e->limit - e->ptr) - fr->pre_len;
+  switch (fr->kind) {
+    case ENC_FRAME_FINISH_DELIMITED:
+      encode_tagvarint(e, (fr->number << 3) | kUpb_WireType_Delimited, size);
+      e->depth++;
+      break;
+    case ENC_FRAME_FINISH_GROUP:
+      encode_tag(e, fr->number, kUpb_WireType_StartGroup);
+      e->depth++;
+      break;
+    case ENC_FRAME_FINISH_MAPENTRY: {
+      const upb_MiniTable* layout = fr->u.mapent.layout;
+      /* The message value's length. */
+      encode_tagvarint(
+          e, (layout->fields[1].number << 3) | kUpb_WireType_Delimited, size);
+      encode_scalar(e, &fr->u.mapent.ent.data.k, layout->subs,
+                    &layout->fields[0]);
+      encode_tagvarint(e, (fr->number << 3) | kUpb_WireType_Delimited,
+                       (e->limit - e->ptr) - fr->pre_len);
+      e->depth++;
+      break;
+    }
+    case ENC_FRAME_FINISH_MSGSET:
+      encode_tagvarint(e, (kUpb_MsgSet_Message << 3) | kUpb_WireType_Delimited,
+                       size);
+      /* The extension's type id. */
+      encode_tagvarint(e, (kUpb_MsgSet_TypeId << 3) | kUpb_WireType_Varint,
+                       fr->number);
+      encode_tag(e, kUpb_MsgSet_Item, kUpb_WireType_StartGroup);
+      break;
+    default:
+      UPB_UNREACHABLE();
+  }
+  e->stack_len--;
+}
+
+static void encode_message(upb_encstate* e, const upb_Message* msg,
+                           const upb_MiniTable* m, size_t* size) {
+  size_t pre_len = e->limit - e->ptr;
+  size_t base = e->stack_len;
+
+  encode_pushmsg(e, msg, m);
+  while (e->stack_len > base) {
+    upb_EncodeFrame* fr = &e->stack[e->stack_len - 1];
+    switch (fr->kind) {
+      case ENC_FRAME_MSG:
+        encode_stepmsg(e, fr);
+        break;
+      case ENC_FRAME_MSGARRAY:
+        encode_steparray(e, fr);
+        break;
+      case ENC_FRAME_MAP:
+        encode_stepmap(e, fr);
+        break;
+      default:
+        encode_finish(e, fr);
+        break;
     }
   }
 
   *size = (e->limit - e->ptr) - pre_len;
 }
 
+void _upb_Encoder_FastVarint(struct upb_Encoder* e, uint64_t val,
+                             uint32_t tag) {
+  encode_tagvarint(e, tag, val);
+}
+
+void _upb_Encoder_FastFixed64(struct upb_Encoder* e, uint64_t val,
+                              uint32_t tag) {
+  encode_fixed64(e, val);
+  encode_varint(e, tag);
+}
+
+void _upb_Encoder_FastFixed32(struct upb_Encoder* e, uint32_t val,
+                              uint32_t tag) {
+  encode_fixed32(e, val);
+  encode_varint(e, tag);
+}
+
+void _upb_Encoder_FastString(struct upb_Encoder* e, upb_StringView val,
+                             uint32_t tag) {
+  encode_bytes(e, val.data, val.size);
+  encode_tagvarint(e, tag, val.size);
+}
+
 static upb_EncodeStatus upb_Encoder_Encode(upb_encstate* const encoder,
                                            const void* const msg,
                                            const upb_MiniTable* const l,
@@ -620,12 +1110,14 @@ static upb_EncodeStatus upb_Encoder_Encode(upb_encstate* const encoder,
   }
 
   _upb_mapsorter_destroy(&encoder->sorter);
+  free(encoder->stack);
   return encoder->status;
 }
 
-upb_EncodeStatus upb_Encode(const void* msg, const upb_MiniTable* l,
-                            int options, upb_Arena* arena, char** buf,
-                            size_t* size) {
+static upb_EncodeStatus _upb_Encode(const void* msg, const upb_MiniTable* l,
+                                    int options, upb_Arena* arena, char** buf,
+                                    size_t* size, size_t size_hint) {
+  UPB_PROFILE_BEGIN(profile_start);
   upb_encstate e;
   unsigned depth = (unsigned)options >> 16;
 
@@ -636,7 +1128,81 @@ upb_EncodeStatus upb_Encode(const void* msg, const upb_MiniTable* l,
   e.ptr = NULL;
   e.depth = depth ? depth : kUpb_WireFormat_DefaultDepthLimit;
   e.options = options;
+  e.stack = NULL;
+  e.stack_len = 0;
+  e.stack_cap = 0;
+  _upb_mapsorter_init(&e.sorter);
+
+  if (size_hint) {
+    // Pre-size the buffer so that an accurate hint encodes with a single
+    // arena allocation and no encode_growbuffer() memmoves.  An undersized
+    // hint is harmless; the buffer grows as usual.
+    e.buf = upb_Arena_Malloc(arena, size_hint);
+    if (e.buf) {
+      e.limit = e.buf + size_hint;
+      e.ptr = e.limit;
+    }
+  }
+
+  upb_EncodeStatus status = upb_Encoder_Encode(&e, msg, l, buf, size);
+  UPB_PROFILE_END(profile_start, kUpb_ProfileSubsystem_Encode);
+  return status;
+}
+
+upb_EncodeStatus upb_Encode(const void* msg, const upb_MiniTable* l,
+                            int options, upb_Arena* arena, char** buf,
+                            size_t* size) {
+  return _upb_Encode(msg, l, options, arena, buf, size, 0);
+}
+
+upb_EncodeStatus upb_Encode_WithSizeHint(const void* msg,
+                                         const upb_MiniTable* l, int options,
+                                         upb_Arena* arena, char** buf,
+                                         size_t* size, size_t size_hint) {
+  return _upb_Encode(msg, l, options, arena, buf, size, size_hint);
+}
+
+upb_EncodeStatus upb_Encode_GetSize(const void* msg, const upb_MiniTable* l,
+                                    int options, size_t* size) {
+  upb_Arena* arena = upb_Arena_New();
+  char* buf;
+  upb_EncodeStatus status;
+
+  *size = 0;
+  if (!arena) return kUpb_EncodeStatus_OutOfMemory;
+  status = upb_Encode(msg, l, options, arena, &buf, size);
+  upb_Arena_Free(arena);
+  return status;
+}
+
+upb_EncodeStatus upb_Encode_IntoBuffer(const void* msg, const upb_MiniTable* l,
+                                       int options, char* buf, size_t capacity,
+                                       size_t* size) {
+  UPB_PROFILE_BEGIN(profile_start);
+  upb_encstate e;
+  unsigned depth = (unsigned)options >> 16;
+  char* out;
+  upb_EncodeStatus status;
+
+  e.status = kUpb_EncodeStatus_Ok;
+  e.arena = NULL;  // Flags the buffer as non-growable in encode_growbuffer().
+  e.buf = buf;
+  e.limit = buf + capacity;
+  e.ptr = e.limit;
+  e.depth = depth ? depth : kUpb_WireFormat_DefaultDepthLimit;
+  e.options = options;
+  e.stack = NULL;
+  e.stack_len = 0;
+  e.stack_cap = 0;
   _upb_mapsorter_init(&e.sorter);
 
-  return upb_Encoder_Encode(&e, msg, l, buf, size);
+  status = upb_Encoder_Encode(&e, msg, l, &out, size);
+
+  // The encoder writes back-to-front, so a generous buffer leaves the result
+  // at the tail; normalize so the caller always finds it at buf[0].
+  if (status == kUpb_EncodeStatus_Ok && *size != 0 && out != buf) {
+    memmove(buf, out, *size);
+  }
+  UPB_PROFILE_END(profile_start, kUpb_ProfileSubsystem_Encode);
+  return status;
 }
@@ -62,6 +62,9 @@ typedef enum {
 
   // kUpb_EncodeOption_CheckRequired failed but the parse otherwise succeeded.
   kUpb_EncodeStatus_MissingRequired = 3,
+
+  // upb_Encode_ToStream() could not write to the output stream.
+  kUpb_EncodeStatus_StreamError = 4,
 } upb_EncodeStatus;
 
 UPB_INLINE uint32_t upb_EncodeOptions_MaxDepth(uint16_t depth) {
@@ -83,6 +86,32 @@ upb_EncodeStatus upb_Encode(const void* msg, const upb_MiniTable* l,
                             int options, upb_Arena* arena, char** buf,
                             size_t* size);
 
+// Like upb_Encode(), but pre-sizes the output buffer to |size_hint| bytes.
+// When the hint matches the encoded size (eg. the |*size| returned by a
+// previous encode of the same unmodified message), serialization performs a
+// single exact-size arena allocation and never moves bytes already written.
+// An inaccurate hint only costs the usual buffer growth; the output is
+// identical either way.
+upb_EncodeStatus upb_Encode_WithSizeHint(const void* msg,
+                                         const upb_MiniTable* l, int options,
+                                         upb_Arena* arena, char** buf,
+                                         size_t* size, size_t size_hint);
+
+// Computes the serialized size of |msg| without returning the bytes.  This
+// performs a full encode into a scratch arena, so callers that also need the
+// bytes should prefer a single upb_Encode()/upb_Encode_WithSizeHint() call.
+upb_EncodeStatus upb_Encode_GetSize(const void* msg, const upb_MiniTable* l,
+                                    int options, size_t* size);
+
+// Serializes |msg| into the caller-provided |buf| of |capacity| bytes with no
+// internal allocation (except the malloc()s required by
+// kUpb_EncodeOption_Deterministic map sorting).  On success the bytes start
+// at buf[0] and |*size| is set; if |capacity| is too small the encode fails
+// with kUpb_EncodeStatus_OutOfMemory.
+upb_EncodeStatus upb_Encode_IntoBuffer(const void* msg, const upb_MiniTable* l,
+                                       int options, char* buf, size_t capacity,
+                                       size_t* size);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
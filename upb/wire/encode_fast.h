@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Write primitives for generated fast encoders (the encode analog of the
+// fasttable parsers in decode_fast.h).  upbc emits a straight-line
+// `<Msg>_fast_encode()` function for messages whose fields are all non-oneof
+// scalars/strings, stores it in upb_MiniTable.fast_encode, and
+// encode_message() dispatches to it in place of the interpretive field walk.
+//
+// Like the rest of the encoder these write back-to-front: generated code
+// emits fields in descending field-number order, calling one helper per
+// present field with the value and the precomputed tag
+// (field_number << 3 | wire_type).  Errors (out of memory) longjmp out of the
+// encoder, so the helpers do not return a status.
+
+#ifndef UPB_WIRE_ENCODE_FAST_H_
+#define UPB_WIRE_ENCODE_FAST_H_
+
+#include "upb/base/string_view.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct upb_Encoder;
+
+void _upb_Encoder_FastVarint(struct upb_Encoder* e, uint64_t val, uint32_t tag);
+void _upb_Encoder_FastFixed64(struct upb_Encoder* e, uint64_t val,
+                              uint32_t tag);
+void _upb_Encoder_FastFixed32(struct upb_Encoder* e, uint32_t val,
+                              uint32_t tag);
+void _upb_Encoder_FastString(struct upb_Encoder* e, upb_StringView val,
+                             uint32_t tag);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_WIRE_ENCODE_FAST_H_ */
@@ -0,0 +1,182 @@
+// Copyright (c) 2009-2021, Google LLC
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Google LLC nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "upb/message/accessors.h"
+#include "upb/mini_descriptor/decode.h"
+#include "upb/mini_descriptor/internal/encode.h"
+#include "upb/mini_table/extension_registry.h"
+#include "upb/wire/common.h"
+#include "upb/wire/decode.h"
+#include "upb/wire/encode.h"
+#include "upb/wire/test_util.h"
+
+namespace {
+
+using upb_test::NestedGroupPayload;
+using upb_test::NestedMessagePayload;
+using upb_test::RecursiveMiniTable;
+using upb_test::TestMiniTable;
+
+std::string Encode(const upb_Message* msg, const upb_MiniTable* mt,
+                   int options, upb_Arena* arena,
+                   upb_EncodeStatus expected = kUpb_EncodeStatus_Ok) {
+  char* buf;
+  size_t size;
+  upb_EncodeStatus status =
+      upb_Encode(msg, mt, options, arena, &buf, &size);
+  EXPECT_EQ(status, expected);
+  return status == kUpb_EncodeStatus_Ok ? std::string(buf, size)
+                                        : std::string();
+}
+
+// Builds a chain of |depth| sub-messages through |field_num| (1 for the
+// delimited field, 2 for the group).
+upb_Message* NestedMessageChain(const upb_MiniTable* mt, int field_num,
+                                int depth, upb_Arena* arena) {
+  const upb_MiniTableField* f = upb_MiniTable_FindFieldByNumber(mt, field_num);
+  upb_Message* top = upb_Message_New(mt, arena);
+  upb_Message* msg = top;
+  for (int i = 0; i < depth; i++) {
+    msg = upb_Message_GetOrCreateMutableMessage(msg, mt, f, arena);
+    EXPECT_NE(msg, nullptr);
+  }
+  return top;
+}
+
+TEST(EncodeTest, DeepNestingRoundTrip) {
+  // 64 levels exceeds the encoder's initial frame-stack capacity, so the
+  // stack must grow mid-encode and still produce the original bytes.
+  upb_Arena* arena = upb_Arena_New();
+  const upb_MiniTable* mt = RecursiveMiniTable(arena);
+  std::string payload = NestedMessagePayload(64);
+  upb_Message* msg = upb_Message_New(mt, arena);
+  ASSERT_EQ(upb_Decode(payload.data(), payload.size(), msg, mt, nullptr, 0,
+                       arena),
+            kUpb_DecodeStatus_Ok);
+  EXPECT_EQ(Encode(msg, mt, 0, arena), payload);
+  upb_Arena_Free(arena);
+}
+
+TEST(EncodeTest, DepthLimit) {
+  upb_Arena* arena = upb_Arena_New();
+  const upb_MiniTable* mt = RecursiveMiniTable(arena);
+  const int options = upb_EncodeOptions_MaxDepth(10);
+
+  // The top-level message counts against the encoder's limit, so 9 levels
+  // of nesting is the deepest tree MaxDepth(10) can emit.
+  upb_Message* at_limit = NestedMessageChain(mt, 1, 9, arena);
+  EXPECT_EQ(Encode(at_limit, mt, options, arena), NestedMessagePayload(9));
+
+  upb_Message* over_limit = NestedMessageChain(mt, 1, 10, arena);
+  Encode(over_limit, mt, options, arena, kUpb_EncodeStatus_MaxDepthExceeded);
+
+  // The default limit applies when no explicit one is given.
+  upb_Message* way_over = NestedMessageChain(
+      mt, 1, kUpb_WireFormat_DefaultDepthLimit + 1, arena);
+  Encode(way_over, mt, 0, arena, kUpb_EncodeStatus_MaxDepthExceeded);
+  upb_Arena_Free(arena);
+}
+
+TEST(EncodeTest, NestedGroups) {
+  upb_Arena* arena = upb_Arena_New();
+  const upb_MiniTable* mt = RecursiveMiniTable(arena);
+
+  upb_Message* msg = NestedMessageChain(mt, 2, 30, arena);
+  EXPECT_EQ(Encode(msg, mt, 0, arena), NestedGroupPayload(30));
+
+  upb_Message* over_limit = NestedMessageChain(mt, 2, 11, arena);
+  Encode(over_limit, mt, upb_EncodeOptions_MaxDepth(10), arena,
+         kUpb_EncodeStatus_MaxDepthExceeded);
+  upb_Arena_Free(arena);
+}
+
+TEST(EncodeTest, MessageSetRoundTrip) {
+  upb_Arena* arena = upb_Arena_New();
+
+  // message-set extendee plus one message extension of it.
+  upb_MtDataEncoder e;
+  char buf[64];
+  char* ptr = upb_MtDataEncoder_EncodeMessageSet(&e, buf);
+  upb_Status status;
+  upb_Status_Clear(&status);
+  upb_MiniTable* msgset_mt =
+      upb_MiniTable_Build(buf, ptr - buf, arena, &status);
+  ASSERT_NE(msgset_mt, nullptr) << upb_Status_ErrorMessage(&status);
+
+  upb_MiniTable* item_mt = (upb_MiniTable*)TestMiniTable(arena);
+  ptr = upb_MtDataEncoder_EncodeExtension(&e, buf, kUpb_FieldType_Message,
+                                          4071, 0);
+  const upb_MiniTableExtension* ext = upb_MiniTableExtension_BuildMessage(
+      buf, ptr - buf, msgset_mt, item_mt, arena, &status);
+  ASSERT_NE(ext, nullptr) << upb_Status_ErrorMessage(&status);
+  upb_ExtensionRegistry* extreg = upb_ExtensionRegistry_New(arena);
+  ASSERT_TRUE(upb_ExtensionRegistry_Add(extreg, ext));
+
+  // One message-set item: group-framed type_id 4071 with payload i = 42.
+  const std::string payload(
+      "\x0b"              // Item, start group.
+      "\x10\xe7\x1f"      // type_id = 4071.
+      "\x1a\x02\x08\x2a"  // message: i = 42.
+      "\x0c",             // Item, end group.
+      9);
+  upb_Message* msg = upb_Message_New(msgset_mt, arena);
+  ASSERT_EQ(upb_Decode(payload.data(), payload.size(), msg, msgset_mt, extreg,
+                       0, arena),
+            kUpb_DecodeStatus_Ok);
+  EXPECT_EQ(Encode(msg, msgset_mt, 0, arena), payload);
+  upb_Arena_Free(arena);
+}
+
+TEST(EncodeTest, BufferGrowthBoundaries) {
+  // The encoder reserves and writes in wide chunks; sweeping the payload
+  // size byte-by-byte walks every internal buffer-growth boundary.
+  upb_Arena* arena = upb_Arena_New();
+  const upb_MiniTable* mt = TestMiniTable(arena);
+  const upb_MiniTableField* f1 = upb_MiniTable_FindFieldByNumber(mt, 1);
+  const upb_MiniTableField* f2 = upb_MiniTable_FindFieldByNumber(mt, 2);
+  for (size_t len = 0; len <= 600; len++) {
+    std::string body(len, 'x');
+    upb_Message* msg = upb_Message_New(mt, arena);
+    upb_Message_SetInt32(msg, f1, 42, arena);
+    upb_Message_SetString(
+        msg, f2, upb_StringView_FromDataAndSize(body.data(), body.size()),
+        arena);
+
+    std::string expected("\x08\x2a\x12", 3);
+    size_t l = len;
+    do {  // Varint-encoded length.
+      expected.push_back((l & 0x7f) | (l >= 0x80 ? 0x80 : 0));
+      l >>= 7;
+    } while (l);
+    expected += body;
+    EXPECT_EQ(Encode(msg, mt, 0, arena), expected);
+  }
+  upb_Arena_Free(arena);
+}
+
+}  // namespace
@@ -45,7 +45,21 @@ extern "C" {
 // the decoder can read this many bytes without performing another bounds
 // check.  The stream will copy into a patch buffer as necessary to guarantee
 // this invariant.
-#define kUpb_EpsCopyInputStream_SlopBytes 16
+//
+// The slop size may be raised at build time with -DUPB_EPSCOPY_SLOP_BYTES=N
+// (N >= 16).  A larger slop region makes the patch-buffer flips in
+// _upb_EpsCopyInputStream_IsDoneFallbackInline() trigger proportionally less
+// often near the end of the buffer, at the cost of a larger stream struct;
+// payloads with many small fields near buffer boundaries benefit from 64.
+// All copies of the patch region are compile-time-constant sized so the
+// compiler emits wide (SSE/AVX/NEON) register moves for them.
+#ifndef UPB_EPSCOPY_SLOP_BYTES
+#define UPB_EPSCOPY_SLOP_BYTES 16
+#endif
+#if UPB_EPSCOPY_SLOP_BYTES < 16
+#error UPB_EPSCOPY_SLOP_BYTES must be at least 16 (the maximum wire size of a single field, which the decoders rely on).
+#endif
+#define kUpb_EpsCopyInputStream_SlopBytes UPB_EPSCOPY_SLOP_BYTES
 
 enum {
   kUpb_EpsCopyInputStream_NoAliasing = 0,
@@ -82,7 +96,7 @@ UPB_INLINE void upb_EpsCopyInputStream_Init(upb_EpsCopyInputStream* e,
                                             const char** ptr, size_t size,
                                             bool enable_aliasing) {
   if (size <= kUpb_EpsCopyInputStream_SlopBytes) {
-    memset(&e->patch, 0, 32);
+    memset(&e->patch, 0, 2 * kUpb_EpsCopyInputStream_SlopBytes);
     if (size) memcpy(&e->patch, *ptr, size);
     e->aliasing = enable_aliasing ? (uintptr_t)*ptr - (uintptr_t)e->patch
                                   : kUpb_EpsCopyInputStream_NoAliasing;
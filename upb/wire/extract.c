@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/wire/extract.h"
+
+#include <string.h>
+
+#include "upb/wire/common.h"
+#include "upb/wire/eps_copy_input_stream.h"
+#include "upb/wire/reader.h"
+#include "upb/wire/types.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+static upb_ExtractedField* upb_Wire_FindTarget(upb_ExtractedField* fields,
+                                               size_t count,
+                                               uint32_t field_number) {
+  size_t lo = 0;
+  size_t hi = count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (fields[mid].field_number < field_number) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo < count && fields[lo].field_number == field_number) {
+    return &fields[lo];
+  }
+  return NULL;
+}
+
+bool upb_Wire_ExtractFields(const char* buf, size_t size,
+                            upb_ExtractedField* fields, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    UPB_ASSERT(i == 0 || fields[i - 1].field_number < fields[i].field_number);
+    fields[i].found = false;
+    fields[i].wire_type = 0;
+    memset(&fields[i].data, 0, sizeof(fields[i].data));
+  }
+
+  upb_EpsCopyInputStream stream;
+  upb_EpsCopyInputStream_Init(&stream, &buf, size, true);
+  const char* ptr = buf;
+
+  while (!upb_EpsCopyInputStream_IsDone(&stream, &ptr)) {
+    uint32_t tag;
+    ptr = upb_WireReader_ReadTag(ptr, &tag);
+    if (!ptr) return false;
+    int wire_type = upb_WireReader_GetWireType(tag);
+    if (wire_type == kUpb_WireType_EndGroup) return false;  // Unbalanced.
+
+    upb_ExtractedField* target = upb_Wire_FindTarget(
+        fields, count, upb_WireReader_GetFieldNumber(tag));
+    if (!target) {
+      ptr = _upb_WireReader_SkipValue(ptr, tag,
+                                      kUpb_WireFormat_DefaultDepthLimit,
+                                      &stream);
+      if (!ptr) return false;
+      continue;
+    }
+
+    target->found = true;
+    target->wire_type = wire_type;
+    switch (wire_type) {
+      case kUpb_WireType_Varint:
+        ptr = upb_WireReader_ReadVarint(ptr, &target->data.varint);
+        break;
+      case kUpb_WireType_64Bit:
+        ptr = upb_WireReader_ReadFixed64(ptr, &target->data.fixed64);
+        break;
+      case kUpb_WireType_32Bit:
+        ptr = upb_WireReader_ReadFixed32(ptr, &target->data.fixed32);
+        break;
+      case kUpb_WireType_Delimited: {
+        int delimited_size;
+        ptr = upb_WireReader_ReadSize(ptr, &delimited_size);
+        if (!ptr) return false;
+        if (!upb_EpsCopyInputStream_CheckDataSizeAvailable(&stream, ptr,
+                                                           delimited_size)) {
+          return false;  // Truncated.
+        }
+        const char* s_ptr = ptr;
+        ptr = upb_EpsCopyInputStream_ReadStringAliased(&stream, &s_ptr,
+                                                       delimited_size);
+        target->data.delimited.data = s_ptr;
+        target->data.delimited.size = delimited_size;
+        break;
+      }
+      case kUpb_WireType_StartGroup:
+        // Groups don't carry a length prefix, so presence is all we report.
+        memset(&target->data, 0, sizeof(target->data));
+        ptr = upb_WireReader_SkipGroup(ptr, tag, &stream);
+        break;
+      default:
+        return false;
+    }
+    if (!ptr) return false;
+  }
+
+  return !upb_EpsCopyInputStream_IsError(&stream);
+}
+
+bool upb_Wire_ExtractField(const char* buf, size_t size, uint32_t field_number,
+                           upb_ExtractedField* value) {
+  value->field_number = field_number;
+  return upb_Wire_ExtractFields(buf, size, value, 1);
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Extracts individual fields from serialized wire data without building a
+ * message: no arena, no MiniTable, no allocation.  Unwanted fields are
+ * skipped via their length prefixes.  This is intended for callers like
+ * routers that need one or two key fields out of a payload they otherwise
+ * never decode. */
+
+#ifndef UPB_WIRE_EXTRACT_H_
+#define UPB_WIRE_EXTRACT_H_
+
+#include "upb/base/string_view.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  uint32_t field_number;  // In: the field to extract.
+  bool found;             // Out: whether any occurrence was seen.
+  uint8_t wire_type;      // Out: kUpb_WireType_* of the last occurrence.
+  union {
+    uint64_t varint;
+    uint64_t fixed64;
+    uint32_t fixed32;
+    upb_StringView delimited;  // Aliases the input buffer.
+  } data;  // Out: value of the last occurrence (zeroed for groups).
+} upb_ExtractedField;
+
+/* Scans [buf, buf+size) and extracts the top-level field |field_number| into
+ * |value|.  The last occurrence wins, matching upb_Decode()'s semantics for
+ * non-repeated fields.  Delimited values alias |buf| and remain valid only as
+ * long as the caller's buffer does.  Group-typed matches report presence and
+ * wire type only.
+ *
+ * Returns false if the wire data is malformed; |value->found| distinguishes
+ * "field absent" from "field present" on success. */
+UPB_API bool upb_Wire_ExtractField(const char* buf, size_t size,
+                                   uint32_t field_number,
+                                   upb_ExtractedField* value);
+
+/* Multi-field variant: extracts all of |fields| (an array of |count| entries
+ * whose field_number members must be sorted ascending) in a single pass. */
+UPB_API bool upb_Wire_ExtractFields(const char* buf, size_t size,
+                                    upb_ExtractedField* fields, size_t count);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_WIRE_EXTRACT_H_ */
@@ -0,0 +1,113 @@
+// Copyright (c) 2009-2021, Google LLC
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Google LLC nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef UPB_WIRE_TEST_UTIL_H_
+#define UPB_WIRE_TEST_UTIL_H_
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "upb/mini_descriptor/decode.h"
+#include "upb/mini_descriptor/internal/encode.h"
+#include "upb/mini_descriptor/link.h"
+
+namespace upb_test {
+
+// Builds a mini table for:
+//   message M {
+//     optional int32 i = 1;
+//     optional string s = 2;
+//   }
+inline const upb_MiniTable* TestMiniTable(upb_Arena* arena) {
+  upb_MtDataEncoder e;
+  char buf[64];
+  char* ptr = buf;
+  e.end = buf + sizeof(buf);
+  ptr = upb_MtDataEncoder_StartMessage(&e, ptr, 0);
+  ptr = upb_MtDataEncoder_PutField(&e, ptr, kUpb_FieldType_Int32, 1, 0);
+  ptr = upb_MtDataEncoder_PutField(&e, ptr, kUpb_FieldType_String, 2, 0);
+  upb_Status status;
+  upb_Status_Clear(&status);
+  const upb_MiniTable* mt = upb_MiniTable_Build(buf, ptr - buf, arena, &status);
+  EXPECT_NE(mt, nullptr) << upb_Status_ErrorMessage(&status);
+  return mt;
+}
+
+// Builds a mini table for:
+//   message M {
+//     optional M m = 1;
+//     optional group G g = 2;  // G is also M.
+//   }
+// so payloads can nest to arbitrary depth through either field.
+inline const upb_MiniTable* RecursiveMiniTable(upb_Arena* arena) {
+  upb_MtDataEncoder e;
+  char buf[64];
+  char* ptr = buf;
+  e.end = buf + sizeof(buf);
+  ptr = upb_MtDataEncoder_StartMessage(&e, ptr, 0);
+  ptr = upb_MtDataEncoder_PutField(&e, ptr, kUpb_FieldType_Message, 1, 0);
+  ptr = upb_MtDataEncoder_PutField(&e, ptr, kUpb_FieldType_Group, 2, 0);
+  upb_Status status;
+  upb_Status_Clear(&status);
+  upb_MiniTable* mt = upb_MiniTable_Build(buf, ptr - buf, arena, &status);
+  EXPECT_NE(mt, nullptr) << upb_Status_ErrorMessage(&status);
+  upb_MiniTableField* f1 =
+      (upb_MiniTableField*)upb_MiniTable_FindFieldByNumber(mt, 1);
+  upb_MiniTableField* f2 =
+      (upb_MiniTableField*)upb_MiniTable_FindFieldByNumber(mt, 2);
+  EXPECT_TRUE(upb_MiniTable_SetSubMessage(mt, f1, mt));
+  EXPECT_TRUE(upb_MiniTable_SetSubMessage(mt, f2, mt));
+  return mt;
+}
+
+// m = 1 nested |depth| levels deep: m { m { ... } }.
+inline std::string NestedMessagePayload(int depth) {
+  std::string out;
+  for (int i = 0; i < depth; i++) {
+    std::string wrapped;
+    wrapped.push_back('\x0a');  // Field 1, delimited.
+    size_t len = out.size();
+    do {  // Varint-encoded length.
+      wrapped.push_back((len & 0x7f) | (len >= 0x80 ? 0x80 : 0));
+      len >>= 7;
+    } while (len);
+    wrapped += out;
+    out = wrapped;
+  }
+  return out;
+}
+
+// g = 2 nested |depth| levels deep: g { g { ... } }.
+inline std::string NestedGroupPayload(int depth) {
+  std::string out;
+  for (int i = 0; i < depth; i++) {
+    out = '\x13' + out + '\x14';  // Field 2, start group / end group.
+  }
+  return out;
+}
+
+}  // namespace upb_test
+
+#endif  // UPB_WIRE_TEST_UTIL_H_
@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "upb/wire/verify.h"
+
+#include <string.h>
+
+#include "upb/base/descriptor_constants.h"
+#include "upb/message/accessors_internal.h"
+#include "upb/mini_table/internal/message.h"
+#include "upb/mini_table/sub.h"
+#include "upb/wire/common.h"
+#include "upb/wire/decode_internal.h"
+#include "upb/wire/eps_copy_input_stream.h"
+#include "upb/wire/reader.h"
+#include "upb/wire/types.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#define VERIFY_NOGROUP (uint32_t)-1
+
+typedef struct {
+  upb_EpsCopyInputStream input;
+  uint32_t end_group;  // field number of END_GROUP tag, else VERIFY_NOGROUP.
+  int depth;
+  uint16_t options;
+  bool missing_required;
+  upb_DecodeStatus status;
+  jmp_buf err;
+} upb_Verifier;
+
+UPB_NORETURN static void upb_Verifier_ErrorJmp(upb_Verifier* v,
+                                               upb_DecodeStatus status) {
+  v->status = status;
+  UPB_LONGJMP(v->err, 1);
+}
+
+// The wire type we expect for each descriptor type; a tag carrying any other
+// wire type makes the field an unknown field (matching the decoder).
+static const int8_t kUpb_Verifier_WireTypes[] = {
+    [kUpb_FieldType_Double] = kUpb_WireType_64Bit,
+    [kUpb_FieldType_Float] = kUpb_WireType_32Bit,
+    [kUpb_FieldType_Int64] = kUpb_WireType_Varint,
+    [kUpb_FieldType_UInt64] = kUpb_WireType_Varint,
+    [kUpb_FieldType_Int32] = kUpb_WireType_Varint,
+    [kUpb_FieldType_Fixed64] = kUpb_WireType_64Bit,
+    [kUpb_FieldType_Fixed32] = kUpb_WireType_32Bit,
+    [kUpb_FieldType_Bool] = kUpb_WireType_Varint,
+    [kUpb_FieldType_String] = kUpb_WireType_Delimited,
+    [kUpb_FieldType_Group] = kUpb_WireType_StartGroup,
+    [kUpb_FieldType_Message] = kUpb_WireType_Delimited,
+    [kUpb_FieldType_Bytes] = kUpb_WireType_Delimited,
+    [kUpb_FieldType_UInt32] = kUpb_WireType_Varint,
+    [kUpb_FieldType_Enum] = kUpb_WireType_Varint,
+    [kUpb_FieldType_SFixed32] = kUpb_WireType_32Bit,
+    [kUpb_FieldType_SFixed64] = kUpb_WireType_64Bit,
+    [kUpb_FieldType_SInt32] = kUpb_WireType_Varint,
+    [kUpb_FieldType_SInt64] = kUpb_WireType_Varint,
+};
+
+static const char* upb_Verifier_VerifyMessage(upb_Verifier* v, const char* ptr,
+                                              const upb_MiniTable* l);
+
+static const char* upb_Verifier_SkipDelimited(upb_Verifier* v,
+                                              const char* ptr) {
+  int size;
+  ptr = upb_WireReader_ReadSize(ptr, &size);
+  if (!ptr) upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+  ptr = upb_EpsCopyInputStream_Skip(&v->input, ptr, size);
+  if (!ptr) upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+  return ptr;
+}
+
+// Skips an unknown or wire-type-mismatched field, verifying only its wire
+// structure.  Groups recurse through the generic message walker with a NULL
+// mini table so that nested fields are bounds-checked and balanced.
+static const char* upb_Verifier_SkipField(upb_Verifier* v, const char* ptr,
+                                          uint32_t tag) {
+  switch (upb_WireReader_GetWireType(tag)) {
+    case kUpb_WireType_Varint:
+      ptr = upb_WireReader_SkipVarint(ptr);
+      if (!ptr) upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+      return ptr;
+    case kUpb_WireType_64Bit:
+      return ptr + 8;
+    case kUpb_WireType_32Bit:
+      return ptr + 4;
+    case kUpb_WireType_Delimited:
+      return upb_Verifier_SkipDelimited(v, ptr);
+    case kUpb_WireType_StartGroup: {
+      uint32_t number = upb_WireReader_GetFieldNumber(tag);
+      ptr = upb_Verifier_VerifyMessage(v, ptr, NULL);
+      if (v->end_group != number) {
+        upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+      }
+      v->end_group = VERIFY_NOGROUP;
+      return ptr;
+    }
+    default:
+      upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+  }
+}
+
+static const char* upb_Verifier_VerifyDelimited(
+    upb_Verifier* v, const char* ptr, const upb_MiniTable* l,
+    const upb_MiniTableField* field) {
+  int size;
+  ptr = upb_WireReader_ReadSize(ptr, &size);
+  if (!ptr || !upb_EpsCopyInputStream_CheckDataSizeAvailable(&v->input, ptr,
+                                                             size)) {
+    upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+  }
+  switch (field->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Message: {
+      const upb_MiniTable* subl =
+          l->subs[field->UPB_PRIVATE(submsg_index)].submsg;
+      UPB_ASSERT(subl);
+      if (subl == &_kUpb_MiniTable_Empty) {
+        // Unlinked sub-message: contents are opaque to us, as they are to the
+        // decoder when promotion is requested.
+        return ptr + size;
+      }
+      int saved_delta = upb_EpsCopyInputStream_PushLimit(&v->input, ptr, size);
+      ptr = upb_Verifier_VerifyMessage(v, ptr, subl);
+      if (v->end_group != VERIFY_NOGROUP) {
+        upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+      }
+      upb_EpsCopyInputStream_PopLimit(&v->input, ptr, saved_delta);
+      return ptr;
+    }
+    case kUpb_FieldType_String:
+      if (!_upb_Decoder_VerifyUtf8Inline(ptr, size)) {
+        upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_BadUtf8);
+      }
+      return ptr + size;
+    default:
+      return ptr + size;
+  }
+}
+
+// Verifies the contents of a packed repeated field.  Fixed-width elements only
+// need a size check; varint elements are walked individually.
+static const char* upb_Verifier_VerifyPacked(
+    upb_Verifier* v, const char* ptr, const upb_MiniTableField* field) {
+  int size;
+  ptr = upb_WireReader_ReadSize(ptr, &size);
+  if (!ptr || !upb_EpsCopyInputStream_CheckDataSizeAvailable(&v->input, ptr,
+                                                             size)) {
+    upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+  }
+  switch (kUpb_Verifier_WireTypes[field->UPB_PRIVATE(descriptortype)]) {
+    case kUpb_WireType_64Bit:
+      if (size % 8 != 0) upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+      return ptr + size;
+    case kUpb_WireType_32Bit:
+      if (size % 4 != 0) upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+      return ptr + size;
+    case kUpb_WireType_Varint: {
+      int saved_delta = upb_EpsCopyInputStream_PushLimit(&v->input, ptr, size);
+      while (!upb_EpsCopyInputStream_IsDone(&v->input, &ptr)) {
+        ptr = upb_WireReader_SkipVarint(ptr);
+        if (!ptr) upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+      }
+      if (upb_EpsCopyInputStream_IsError(&v->input)) {
+        upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+      }
+      upb_EpsCopyInputStream_PopLimit(&v->input, ptr, saved_delta);
+      return ptr;
+    }
+    default:
+      UPB_UNREACHABLE();
+  }
+}
+
+static const char* upb_Verifier_VerifyField(upb_Verifier* v, const char* ptr,
+                                            const upb_MiniTable* l,
+                                            const upb_MiniTableField* field,
+                                            uint32_t tag, uint64_t* hasmask) {
+  int wire_type = upb_WireReader_GetWireType(tag);
+  int expected = kUpb_Verifier_WireTypes[field->UPB_PRIVATE(descriptortype)];
+
+  if (wire_type != expected) {
+    // Packed encodings of packable repeated scalars are the only legal
+    // wire-type substitution; everything else is an unknown field.
+    if (wire_type == kUpb_WireType_Delimited &&
+        expected != kUpb_WireType_StartGroup &&
+        upb_FieldMode_Get(field) == kUpb_FieldMode_Array) {
+      return upb_Verifier_VerifyPacked(v, ptr, field);
+    }
+    return upb_Verifier_SkipField(v, ptr, tag);
+  }
+
+  if (field->presence > 0) {
+    size_t idx = _upb_Message_Hasidx(field);
+    if (idx < 64) *hasmask |= 1ull << idx;
+  }
+
+  switch (wire_type) {
+    case kUpb_WireType_Varint: {
+      uint64_t val;
+      ptr = upb_WireReader_ReadVarint(ptr, &val);
+      if (!ptr) upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+      return ptr;
+    }
+    case kUpb_WireType_64Bit:
+      return ptr + 8;
+    case kUpb_WireType_32Bit:
+      return ptr + 4;
+    case kUpb_WireType_Delimited:
+      return upb_Verifier_VerifyDelimited(v, ptr, l, field);
+    case kUpb_WireType_StartGroup: {
+      const upb_MiniTable* subl =
+          l->subs[field->UPB_PRIVATE(submsg_index)].submsg;
+      UPB_ASSERT(subl);
+      ptr = upb_Verifier_VerifyMessage(
+          v, ptr, subl == &_kUpb_MiniTable_Empty ? NULL : subl);
+      if (v->end_group != field->number) {
+        upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+      }
+      v->end_group = VERIFY_NOGROUP;
+      return ptr;
+    }
+    default:
+      UPB_UNREACHABLE();
+  }
+}
+
+// Walks one message (or group, or unknown group when |l| is NULL) until the
+// current limit or an END_GROUP tag, whose field number is left in
+// v->end_group for the caller to check.
+static const char* upb_Verifier_VerifyMessage(upb_Verifier* v, const char* ptr,
+                                              const upb_MiniTable* l) {
+  uint64_t hasmask = 0;
+
+  if (--v->depth < 0) {
+    upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_MaxDepthExceeded);
+  }
+
+  while (!upb_EpsCopyInputStream_IsDone(&v->input, &ptr)) {
+    uint32_t tag;
+    ptr = upb_WireReader_ReadTag(ptr, &tag);
+    if (!ptr) upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+
+    uint32_t field_number = upb_WireReader_GetFieldNumber(tag);
+    if (field_number == 0) upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+
+    if (upb_WireReader_GetWireType(tag) == kUpb_WireType_EndGroup) {
+      v->end_group = field_number;
+      break;
+    }
+
+    const upb_MiniTableField* field =
+        l ? upb_MiniTable_FindFieldByNumber(l, field_number) : NULL;
+    if (field) {
+      ptr = upb_Verifier_VerifyField(v, ptr, l, field, tag, &hasmask);
+    } else {
+      ptr = upb_Verifier_SkipField(v, ptr, tag);
+    }
+  }
+
+  if (upb_EpsCopyInputStream_IsError(&v->input)) {
+    upb_Verifier_ErrorJmp(v, kUpb_DecodeStatus_Malformed);
+  }
+
+  if (l && l->required_count &&
+      (v->options & kUpb_DecodeOption_CheckRequired) &&
+      (upb_MiniTable_requiredmask(l) & ~hasmask)) {
+    v->missing_required = true;
+  }
+
+  v->depth++;
+  return ptr;
+}
+
+upb_DecodeStatus upb_Verify(const char* buf, size_t size,
+                            const upb_MiniTable* l, int options) {
+  upb_Verifier v;
+  unsigned depth = (unsigned)options >> 16;
+
+  upb_EpsCopyInputStream_Init(&v.input, &buf, size, false);
+  v.end_group = VERIFY_NOGROUP;
+  v.depth = depth ? depth : kUpb_WireFormat_DefaultDepthLimit;
+  v.options = (uint16_t)options;
+  v.missing_required = false;
+  v.status = kUpb_DecodeStatus_Ok;
+
+  if (UPB_SETJMP(v.err) == 0) {
+    upb_Verifier_VerifyMessage(&v, buf, l);
+    if (v.end_group != VERIFY_NOGROUP) {
+      v.status = kUpb_DecodeStatus_Malformed;
+    } else if (v.missing_required) {
+      v.status = kUpb_DecodeStatus_MissingRequired;
+    }
+  }
+
+  return v.status;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2009-2021, Google LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Google LLC nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// upb_Verify: validating binary wire format without building a message.
+
+#ifndef UPB_WIRE_VERIFY_H_
+#define UPB_WIRE_VERIFY_H_
+
+#include "upb/mini_table/message.h"
+#include "upb/wire/decode.h"
+
+// Must be last.
+#include "upb/port/def.inc"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Walks the wire format in [buf, buf + size) and verifies that it is a valid
+// encoding of a message described by |l|, without materializing a upb_Message
+// and without allocating.  Verified properties match what upb_Decode() would
+// reject: tag and varint well-formedness, delimited lengths within bounds,
+// balanced groups, recursion depth, and UTF-8 validity of proto3 string
+// fields.  Wire-type mismatches and unrecognized field numbers are skipped as
+// unknown fields, exactly as the decoder would preserve them.
+//
+// |options| accepts the kUpb_DecodeOption_* flags.  With
+// kUpb_DecodeOption_CheckRequired, returns kUpb_DecodeStatus_MissingRequired
+// if any required field (of |l| or a verified sub-message) is absent; the
+// caveats documented for that option in decode.h apply here too.  Options
+// that only affect message construction (AliasString etc.) are ignored.
+UPB_API upb_DecodeStatus upb_Verify(const char* buf, size_t size,
+                                    const upb_MiniTable* l, int options);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#include "upb/port/undef.inc"
+
+#endif /* UPB_WIRE_VERIFY_H_ */
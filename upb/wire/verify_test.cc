@@ -0,0 +1,100 @@
+// Copyright (c) 2009-2021, Google LLC
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Google LLC nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Google LLC BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "upb/wire/verify.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "upb/mini_descriptor/decode.h"
+#include "upb/mini_descriptor/internal/encode.h"
+#include "upb/mini_descriptor/internal/modifiers.h"
+#include "upb/wire/test_util.h"
+
+namespace {
+
+using upb_test::TestMiniTable;
+
+// Like TestMiniTable(), but with UTF-8 validation requested for the
+// message, so the string field stays a validated string rather than being
+// downgraded to bytes.
+const upb_MiniTable* Utf8MiniTable(upb_Arena* arena) {
+  upb_MtDataEncoder e;
+  char buf[64];
+  char* ptr = buf;
+  e.end = buf + sizeof(buf);
+  ptr = upb_MtDataEncoder_StartMessage(&e, ptr,
+                                       kUpb_MessageModifier_ValidateUtf8);
+  ptr = upb_MtDataEncoder_PutField(&e, ptr, kUpb_FieldType_Int32, 1, 0);
+  ptr = upb_MtDataEncoder_PutField(&e, ptr, kUpb_FieldType_String, 2, 0);
+  upb_Status status;
+  upb_Status_Clear(&status);
+  const upb_MiniTable* mt = upb_MiniTable_Build(buf, ptr - buf, arena, &status);
+  EXPECT_NE(mt, nullptr) << upb_Status_ErrorMessage(&status);
+  return mt;
+}
+
+upb_DecodeStatus Verify(const std::string& payload, const upb_MiniTable* mt,
+                        int options = 0) {
+  return upb_Verify(payload.data(), payload.size(), mt, options);
+}
+
+TEST(VerifyTest, AcceptsValidPayload) {
+  upb_Arena* arena = upb_Arena_New();
+  const upb_MiniTable* mt = TestMiniTable(arena);
+  // i = 42, s = "hello world", plus an unknown field 99.
+  EXPECT_EQ(Verify(std::string("\x08\x2a\x12\x0bhello world\xf8\x06\x01", 18),
+                   mt),
+            kUpb_DecodeStatus_Ok);
+  upb_Arena_Free(arena);
+}
+
+TEST(VerifyTest, RejectsMalformedPayload) {
+  upb_Arena* arena = upb_Arena_New();
+  const upb_MiniTable* mt = TestMiniTable(arena);
+  // String field claims 11 bytes but only 5 are present.
+  EXPECT_EQ(Verify(std::string("\x12\x0bhello", 7), mt),
+            kUpb_DecodeStatus_Malformed);
+  // Tag with field number zero.
+  EXPECT_EQ(Verify(std::string("\x00", 1), mt), kUpb_DecodeStatus_Malformed);
+  upb_Arena_Free(arena);
+}
+
+TEST(VerifyTest, RejectsBadUtf8InStringField) {
+  upb_Arena* arena = upb_Arena_New();
+  const upb_MiniTable* mt = Utf8MiniTable(arena);
+  EXPECT_EQ(Verify(std::string("\x12\x06h\xc3\xa9llo", 8), mt),
+            kUpb_DecodeStatus_Ok);
+  EXPECT_EQ(Verify(std::string("\x12\x02\xff\xff", 4), mt),
+            kUpb_DecodeStatus_BadUtf8);
+
+  // Without the ValidateUtf8 modifier the field decodes as bytes, so the
+  // same payload must pass.
+  EXPECT_EQ(Verify(std::string("\x12\x02\xff\xff", 4), TestMiniTable(arena)),
+            kUpb_DecodeStatus_Ok);
+  upb_Arena_Free(arena);
+}
+
+}  // namespace
@@ -28,6 +28,9 @@
 #ifndef UPBC_COMMON_H
 #define UPBC_COMMON_H
 
+#include <algorithm>
+#include <cassert>
+#include <string>
 #include <vector>
 
 #include "absl/strings/str_replace.h"
@@ -36,6 +39,9 @@
 
 namespace upbc {
 
+// Accumulates generated code.  Appends land in fixed-size chunks so that
+// already-written text is never copied as the output grows; the chunks are
+// joined with a single allocation when output() is first called.
 class Output {
  public:
   template <class... Arg>
@@ -43,7 +49,15 @@ class Output {
     Write(absl::Substitute(format, arg...));
   }
 
-  absl::string_view output() const { return output_; }
+  absl::string_view output() const {
+    if (flat_.empty() && !chunks_.empty()) {
+      size_t total = 0;
+      for (const auto& chunk : chunks_) total += chunk.size();
+      flat_.reserve(total);
+      for (const auto& chunk : chunks_) flat_.append(chunk);
+    }
+    return flat_;
+  }
 
  private:
   void Write(absl::string_view data) {
@@ -67,10 +81,27 @@ class Output {
         data = stripped;
       }
     }
-    absl::StrAppend(&output_, data);
+    Append(data);
   }
 
-  std::string output_;
+  void Append(absl::string_view data) {
+    assert(flat_.empty());  // No appending after output() has been taken.
+    while (!data.empty()) {
+      if (chunks_.empty() || chunks_.back().size() == kChunkSize) {
+        chunks_.emplace_back();
+        chunks_.back().reserve(kChunkSize);
+      }
+      std::string& chunk = chunks_.back();
+      const size_t n = std::min(data.size(), kChunkSize - chunk.size());
+      chunk.append(data.data(), n);
+      data.remove_prefix(n);
+    }
+  }
+
+  static constexpr size_t kChunkSize = 64 * 1024;
+
+  std::vector<std::string> chunks_;
+  mutable std::string flat_;
 };
 
 std::string StripExtension(absl::string_view fname);
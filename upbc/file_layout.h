@@ -100,6 +100,22 @@ class DefPoolPair {
     return GetFieldFromPool(&pool64_, f);
   }
 
+  // Lookups by name, for generators that work off google::protobuf
+  // descriptors rather than upb defs (e.g. protos_generator).
+  const upb_MiniTableField* GetField32(const char* msg_full_name,
+                                       uint32_t number) const {
+    return pool32_.FindMessageByName(msg_full_name)
+        .FindFieldByNumber(number)
+        .mini_table();
+  }
+
+  const upb_MiniTableField* GetField64(const char* msg_full_name,
+                                       uint32_t number) const {
+    return pool64_.FindMessageByName(msg_full_name)
+        .FindFieldByNumber(number)
+        .mini_table();
+  }
+
  private:
   static const upb_MiniTableField* GetFieldFromPool(const upb::DefPool* pool,
                                                     upb::FieldDefPtr f) {
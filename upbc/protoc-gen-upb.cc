@@ -24,15 +24,18 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <fstream>
 #include <limits>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -40,12 +43,16 @@
 #include "absl/container/flat_hash_set.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
+#include "absl/strings/ascii.h"
 #include "absl/strings/escaping.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/strings/substitute.h"
 #include "upb/base/descriptor_constants.h"
 #include "upb/base/string_view.h"
 #include "upb/reflection/def.hpp"
+#include "upb/wire/reader.h"
 #include "upb/wire/types.h"
 #include "upbc/common.h"
 #include "upbc/file_layout.h"
@@ -60,6 +67,18 @@ namespace {
 
 struct Options {
   bool bootstrap = false;
+  // When > 0, emit fully-inlined Foo_parse_inline()/Foo_serialize_inline()
+  // specializations for scalar-only messages with at most this many fields.
+  int inline_parse_max_fields = 0;
+  // Tree-shaking allowlist: maps a message's full name to the field names we
+  // keep for it.  Messages that appear here lose all other (non-required)
+  // fields from their mini tables and accessors, so the decoder skips those
+  // fields as unknown; messages that don't appear keep every field.
+  absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>> allowlist;
+  // Also emit foo.upb.textnames.h/.c with upb_TextNames tables (field number
+  // -> name) for upb_TextEncodeMiniTable(), as a separately linkable unit so
+  // reflection-free binaries only pay for names they reference.
+  bool textnames = false;
 };
 
 // Returns fields in order of "hotness", eg. how frequently they appear in
@@ -85,6 +104,18 @@ std::string SourceFilename(upb::FileDefPtr file) {
   return StripExtension(file.name()) + ".upb.c";
 }
 
+std::string TextNamesHeaderFilename(upb::FileDefPtr file) {
+  return StripExtension(file.name()) + ".upb.textnames.h";
+}
+
+std::string TextNamesSourceFilename(upb::FileDefPtr file) {
+  return StripExtension(file.name()) + ".upb.textnames.c";
+}
+
+std::string TextNamesSymbol(upb::MessageDefPtr descriptor) {
+  return absl::StrCat(MessageName(descriptor), "_text_names");
+}
+
 std::string MessageInitName(upb::MessageDefPtr descriptor) {
   return absl::StrCat(MessageName(descriptor), "_msg_init");
 }
@@ -388,6 +419,8 @@ void GenerateMessageFunctionsInHeader(upb::MessageDefPtr message,
       MessageName(message), MessageMiniTableRef(message, options));
 }
 
+uint32_t FieldIndexCount(const DefPoolPair& pools, upb::MessageDefPtr message);
+
 void GenerateOneofInHeader(upb::OneofDefPtr oneof, const DefPoolPair& pools,
                            absl::string_view msg_name, const Options& options,
                            Output& output) {
@@ -410,6 +443,26 @@ void GenerateOneofInHeader(upb::OneofDefPtr oneof, const DefPoolPair& pools,
       )cc",
       fullname, msg_name, oneof.name(),
       FieldInitializer(pools, oneof.field(0), options));
+  // One-call case+value read for switch-based dispatch; the dense field index
+  // (when the message has one) maps the case to the member's layout without a
+  // search, and members beyond its range fall back inside
+  // upb_Message_OneofValue().
+  upb::MessageDefPtr message = oneof.containing_type();
+  const bool has_index =
+      !options.bootstrap && FieldIndexCount(pools, message) > 0;
+  output(
+      R"cc(
+        UPB_INLINE $0_oneofcases $1_$2_value(const $1* msg,
+                                             upb_MessageValue* val) {
+          const upb_MiniTableField field = $3;
+          return ($0_oneofcases)upb_Message_OneofValue(msg, $4, $5, &field,
+                                                       val);
+        }
+      )cc",
+      fullname, msg_name, oneof.name(),
+      FieldInitializer(pools, oneof.field(0), options),
+      MessageMiniTableRef(message, options),
+      has_index ? absl::StrCat("&", msg_name, "_field_index") : "NULL");
 }
 
 void GenerateHazzer(upb::FieldDefPtr field, const DefPoolPair& pools,
@@ -797,6 +850,499 @@ void GenerateSetters(upb::FieldDefPtr field, const DefPoolPair& pools,
   }
 }
 
+// Returns true if |message| qualifies for the fully-inlined parse/serialize
+// specializations: scalar fields only (no oneofs, strings, submessages,
+// repeated fields or maps), single-byte tags, and at most the configured
+// number of fields.  Closed enums are excluded because unknown values would
+// have to be routed to the unknown field set.
+bool HasInlineParse(upb::MessageDefPtr message, const Options& options) {
+  if (options.inline_parse_max_fields <= 0) return false;
+  if (UPB_DESC(MessageOptions_map_entry)(message.options())) return false;
+  if (message.field_count() > options.inline_parse_max_fields) return false;
+  if (message.real_oneof_count() > 0) return false;
+  for (int i = 0; i < message.field_count(); i++) {
+    upb::FieldDefPtr field = message.field(i);
+    if (field.IsSequence() || field.IsMap() || field.is_required()) {
+      return false;
+    }
+    if (field.number() > 15) return false;  // Keep tags to a single byte.
+    switch (field.ctype()) {
+      case kUpb_CType_String:
+      case kUpb_CType_Bytes:
+      case kUpb_CType_Message:
+        return false;
+      case kUpb_CType_Enum:
+        if (field.enum_subdef().is_closed()) return false;
+        break;
+      default:
+        break;
+    }
+  }
+  return true;
+}
+
+// The wire type each scalar field type encodes with.
+upb_WireType InlineParseWireType(upb::FieldDefPtr field) {
+  switch (field.type()) {
+    case kUpb_FieldType_Double:
+    case kUpb_FieldType_Fixed64:
+    case kUpb_FieldType_SFixed64:
+      return kUpb_WireType_64Bit;
+    case kUpb_FieldType_Float:
+    case kUpb_FieldType_Fixed32:
+    case kUpb_FieldType_SFixed32:
+      return kUpb_WireType_32Bit;
+    default:
+      return kUpb_WireType_Varint;
+  }
+}
+
+void GenerateInlineParse(upb::MessageDefPtr message,
+                         const NameToFieldDefMap& field_names,
+                         absl::string_view msg_name, Output& output) {
+  output(
+      R"cc(
+        UPB_INLINE $0* $0_parse_inline(const char* buf, size_t size,
+                                       upb_Arena* arena) {
+          const char* ptr = buf;
+          const char* end = buf + size;
+          $0* msg = $0_new(arena);
+          if (!msg) return NULL;
+          while (ptr < end) {
+            switch ((uint8_t)*ptr++) {
+      )cc",
+      msg_name);
+  for (auto field : FieldNumberOrder(message)) {
+    std::string resolved_name = ResolveFieldName(field, field_names);
+    const uint32_t tag =
+        (field.number() << kUpb_WireReader_WireTypeBits) |
+        InlineParseWireType(field);
+    switch (InlineParseWireType(field)) {
+      case kUpb_WireType_Varint: {
+        std::string value_expr;
+        switch (field.type()) {
+          case kUpb_FieldType_Bool:
+            value_expr = "val != 0";
+            break;
+          case kUpb_FieldType_Int32:
+          case kUpb_FieldType_Enum:
+            value_expr = "(int32_t)val";
+            break;
+          case kUpb_FieldType_Int64:
+            value_expr = "(int64_t)val";
+            break;
+          case kUpb_FieldType_UInt32:
+            value_expr = "(uint32_t)val";
+            break;
+          case kUpb_FieldType_UInt64:
+            value_expr = "val";
+            break;
+          case kUpb_FieldType_SInt32:
+            value_expr =
+                "(int32_t)((uint32_t)(val >> 1) ^ "
+                "(uint32_t) - (int32_t)(val & 1))";
+            break;
+          case kUpb_FieldType_SInt64:
+            value_expr = "(int64_t)((val >> 1) ^ (uint64_t) - (int64_t)(val & 1))";
+            break;
+          default:
+            ABSL_LOG(FATAL) << "unexpected varint type";
+        }
+        output(
+            R"cc(
+              case $0: { /* $1 */
+                uint64_t val = 0;
+                int shift = 0;
+                uint8_t byte;
+                do {
+                  if (ptr == end || shift == 70) return NULL;
+                  byte = (uint8_t)*ptr++;
+                  val |= (uint64_t)(byte & 0x7f) << shift;
+                  shift += 7;
+                } while (byte & 0x80);
+                $2_set_$1(msg, $3);
+                break;
+              }
+            )cc",
+            tag, resolved_name, msg_name, value_expr);
+        break;
+      }
+      case kUpb_WireType_32Bit: {
+        output(
+            R"cc(
+              case $0: { /* $1 */
+                uint32_t val;
+                if ((size_t)(end - ptr) < 4) return NULL;
+                val = (uint32_t)(uint8_t)ptr[0] | ((uint32_t)(uint8_t)ptr[1] << 8) |
+                      ((uint32_t)(uint8_t)ptr[2] << 16) |
+                      ((uint32_t)(uint8_t)ptr[3] << 24);
+                ptr += 4;
+            )cc",
+            tag, resolved_name);
+        if (field.type() == kUpb_FieldType_Float) {
+          output(
+              R"cc(
+                float fval;
+                memcpy(&fval, &val, 4);
+                $0_set_$1(msg, fval);
+                break;
+                }
+              )cc",
+              msg_name, resolved_name);
+        } else {
+          output(
+              R"cc(
+                $0_set_$1(msg, ($2)val);
+                break;
+                }
+              )cc",
+              msg_name, resolved_name,
+              field.type() == kUpb_FieldType_SFixed32 ? "int32_t" : "uint32_t");
+        }
+        break;
+      }
+      case kUpb_WireType_64Bit: {
+        output(
+            R"cc(
+              case $0: { /* $1 */
+                uint64_t val;
+                if ((size_t)(end - ptr) < 8) return NULL;
+                val = (uint64_t)(uint8_t)ptr[0] | ((uint64_t)(uint8_t)ptr[1] << 8) |
+                      ((uint64_t)(uint8_t)ptr[2] << 16) |
+                      ((uint64_t)(uint8_t)ptr[3] << 24) |
+                      ((uint64_t)(uint8_t)ptr[4] << 32) |
+                      ((uint64_t)(uint8_t)ptr[5] << 40) |
+                      ((uint64_t)(uint8_t)ptr[6] << 48) |
+                      ((uint64_t)(uint8_t)ptr[7] << 56);
+                ptr += 8;
+            )cc",
+            tag, resolved_name);
+        if (field.type() == kUpb_FieldType_Double) {
+          output(
+              R"cc(
+                double dval;
+                memcpy(&dval, &val, 8);
+                $0_set_$1(msg, dval);
+                break;
+                }
+              )cc",
+              msg_name, resolved_name);
+        } else {
+          output(
+              R"cc(
+                $0_set_$1(msg, ($2)val);
+                break;
+                }
+              )cc",
+              msg_name, resolved_name,
+              field.type() == kUpb_FieldType_SFixed64 ? "int64_t" : "uint64_t");
+        }
+        break;
+      }
+      default:
+        ABSL_LOG(FATAL) << "unexpected wire type";
+    }
+  }
+  // Unknown or multi-byte tags (unknown fields, extensions, packed data from
+  // schema changes): re-parse the whole buffer with the generic decoder.
+  output(
+      R"cc(
+        default:
+          return $0_parse_ex(buf, size, NULL, 0, arena);
+          }
+          }
+          return msg;
+        }
+      )cc",
+      msg_name);
+}
+
+void GenerateInlineSerialize(upb::MessageDefPtr message,
+                             const NameToFieldDefMap& field_names,
+                             absl::string_view msg_name, Output& output) {
+  // Worst-case encoded size: one tag byte plus the largest value encoding.
+  size_t max_size = 1;  // At least 1 so that upb_Arena_Malloc(0) is avoided.
+  for (auto field : FieldNumberOrder(message)) {
+    switch (InlineParseWireType(field)) {
+      case kUpb_WireType_Varint:
+        max_size += 1 + 10;
+        break;
+      case kUpb_WireType_32Bit:
+        max_size += 1 + 4;
+        break;
+      default:
+        max_size += 1 + 8;
+        break;
+    }
+  }
+  output(
+      R"cc(
+        UPB_INLINE char* $0_serialize_inline(const $0* msg, upb_Arena* arena,
+                                             size_t* len) {
+          char* buf = (char*)upb_Arena_Malloc(arena, $1);
+          char* ptr = buf;
+          if (!buf) {
+            *len = 0;
+            return NULL;
+          }
+      )cc",
+      msg_name, max_size);
+  for (auto field : FieldNumberOrder(message)) {
+    std::string resolved_name = ResolveFieldName(field, field_names);
+    const uint32_t tag =
+        (field.number() << kUpb_WireReader_WireTypeBits) |
+        InlineParseWireType(field);
+    // Compute the value bits, then decide presence: explicit-presence fields
+    // consult the hazzer, implicit-presence fields are skipped when zero.
+    std::string bits_expr;
+    std::string bits_type = "uint64_t";
+    switch (field.type()) {
+      case kUpb_FieldType_Bool:
+        bits_expr = "(uint64_t)$0_$1(msg)";
+        break;
+      case kUpb_FieldType_Int32:
+      case kUpb_FieldType_Enum:
+        bits_expr = "(uint64_t)(int64_t)$0_$1(msg)";
+        break;
+      case kUpb_FieldType_Int64:
+        bits_expr = "(uint64_t)$0_$1(msg)";
+        break;
+      case kUpb_FieldType_UInt32:
+        bits_expr = "(uint64_t)$0_$1(msg)";
+        break;
+      case kUpb_FieldType_UInt64:
+        bits_expr = "$0_$1(msg)";
+        break;
+      case kUpb_FieldType_SInt32: {
+        bits_expr =
+            "(uint64_t)(((uint32_t)$0_$1(msg) << 1) ^ "
+            "(uint32_t)($0_$1(msg) >> 31))";
+        break;
+      }
+      case kUpb_FieldType_SInt64: {
+        bits_expr =
+            "(((uint64_t)$0_$1(msg) << 1) ^ (uint64_t)($0_$1(msg) >> 63))";
+        break;
+      }
+      case kUpb_FieldType_Fixed32:
+        bits_expr = "$0_$1(msg)";
+        bits_type = "uint32_t";
+        break;
+      case kUpb_FieldType_SFixed32:
+        bits_expr = "(uint32_t)$0_$1(msg)";
+        bits_type = "uint32_t";
+        break;
+      case kUpb_FieldType_Fixed64:
+        bits_expr = "$0_$1(msg)";
+        break;
+      case kUpb_FieldType_SFixed64:
+        bits_expr = "(uint64_t)$0_$1(msg)";
+        break;
+      case kUpb_FieldType_Float:
+        bits_type = "uint32_t";
+        break;
+      case kUpb_FieldType_Double:
+        break;
+      default:
+        ABSL_LOG(FATAL) << "unexpected field type";
+    }
+    output("  { /* $0 */\n", resolved_name);
+    if (field.type() == kUpb_FieldType_Float ||
+        field.type() == kUpb_FieldType_Double) {
+      // Compare the raw bits so that -0.0 and NaN round-trip.
+      output(
+          R"cc(
+            $0 fval = $1_$2(msg);
+            $3 val;
+            memcpy(&val, &fval, sizeof(val));
+          )cc",
+          field.type() == kUpb_FieldType_Float ? "float" : "double", msg_name,
+          resolved_name, bits_type);
+    } else {
+      output("    $0 val = $1;\n", bits_type,
+             absl::Substitute(bits_expr, msg_name, resolved_name));
+    }
+    if (field.has_presence()) {
+      output("    if ($0_has_$1(msg)) {\n", msg_name, resolved_name);
+    } else {
+      output("    if (val) {\n");
+    }
+    output("      *ptr++ = (char)$0;\n", tag);
+    switch (InlineParseWireType(field)) {
+      case kUpb_WireType_Varint:
+        output(
+            R"cc(
+              while (val >= 0x80) {
+                *ptr++ = (char)(val | 0x80);
+                val >>= 7;
+              }
+              *ptr++ = (char)val;
+            )cc");
+        break;
+      case kUpb_WireType_32Bit:
+        output(
+            R"cc(
+              ptr[0] = (char)(val & 0xff);
+              ptr[1] = (char)((val >> 8) & 0xff);
+              ptr[2] = (char)((val >> 16) & 0xff);
+              ptr[3] = (char)((val >> 24) & 0xff);
+              ptr += 4;
+            )cc");
+        break;
+      default:
+        output(
+            R"cc(
+              ptr[0] = (char)(val & 0xff);
+              ptr[1] = (char)((val >> 8) & 0xff);
+              ptr[2] = (char)((val >> 16) & 0xff);
+              ptr[3] = (char)((val >> 24) & 0xff);
+              ptr[4] = (char)((val >> 32) & 0xff);
+              ptr[5] = (char)((val >> 40) & 0xff);
+              ptr[6] = (char)((val >> 48) & 0xff);
+              ptr[7] = (char)((val >> 56) & 0xff);
+              ptr += 8;
+            )cc");
+        break;
+    }
+    output("    }\n  }\n");
+  }
+  output(
+      R"cc(
+        *len = (size_t)(ptr - buf);
+        return buf;
+        }
+      )cc");
+}
+
+std::string ArchDependentSize(int64_t size32, int64_t size64);
+
+// Cap on the field numbers covered by the generated dense field index;
+// beyond this the zero-filled gaps would likely outweigh the entries.
+constexpr uint32_t kFieldIndexMaxNumber = 64;
+
+// Highest field number covered by the message's dense field index, or 0 if
+// no index is emitted (no fields in the covered range).
+uint32_t FieldIndexCount(const DefPoolPair& pools,
+                         upb::MessageDefPtr message) {
+  const upb_MiniTable* mt = pools.GetMiniTable64(message);
+  uint32_t count = 0;
+  for (int i = 0; i < mt->field_count; i++) {
+    const uint32_t number = mt->fields[i].number;
+    if (number <= kFieldIndexMaxNumber && number > count) count = number;
+  }
+  return count;
+}
+
+// Emits a const static default instance (a zeroed message in .rodata) plus
+// an accessor returning it, so read paths that just need an immutable empty
+// message don't have to arena-allocate one with Foo_new().
+void GenerateDefaultInstanceInHeader(upb::MessageDefPtr message,
+                                     const DefPoolPair& pools,
+                                     absl::string_view msg_name,
+                                     Output& output) {
+  output(
+      R"cc(
+        extern const struct $0_default_instance_s {
+          upb_Message_Internal internal;
+          union {
+            char data[$1];
+            int64_t align64;
+            double aligndbl;
+          } msg;
+        } $0_default_instance_storage;
+        /* An immutable empty $0; all getters return default values.  Must
+         * not be passed to mutating functions. */
+        UPB_INLINE const $0* $0_default_instance(void) {
+          return (const $0*)&$0_default_instance_storage.msg;
+        }
+      )cc",
+      msg_name,
+      ArchDependentSize(pools.GetMiniTable32(message)->size,
+                        pools.GetMiniTable64(message)->size));
+}
+
+// Per-field allowances for the Foo_kArenaHint constants.  Keep in sync with
+// upb_Arena_NewForMessage() in upb/message/message.c.
+constexpr int64_t kArenaHintPerString = 32;
+constexpr int64_t kArenaHintPerRepeated = 64;
+
+// Emits Foo_kArenaHint: a heuristic first-block size for an arena that will
+// hold one Foo, covering the message struct plus typical satellite
+// allocations for its string, repeated, and sub-message fields.
+void GenerateArenaHint(upb::MessageDefPtr message, const DefPoolPair& pools,
+                       absl::string_view msg_name, Output& output) {
+  int64_t extra32 = 0;
+  int64_t extra64 = 0;
+  int64_t internal_count = 1;  // The message's own upb_Message_Internal.
+  for (int i = 0; i < message.field_count(); i++) {
+    upb::FieldDefPtr field = message.field(i);
+    if (field.IsSequence() || field.IsMap()) {
+      extra32 += kArenaHintPerRepeated;
+      extra64 += kArenaHintPerRepeated;
+    } else if (field.ctype() == kUpb_CType_String ||
+               field.ctype() == kUpb_CType_Bytes) {
+      extra32 += kArenaHintPerString;
+      extra64 += kArenaHintPerString;
+    } else if (field.ctype() == kUpb_CType_Message) {
+      extra32 += pools.GetMiniTable32(field.message_type())->size;
+      extra64 += pools.GetMiniTable64(field.message_type())->size;
+      internal_count++;  // One header per nested message instance.
+    }
+  }
+  output(
+      "/* Heuristic size for the first block of an arena holding one $0\n"
+      " * (message struct plus typical string/repeated/sub-message\n"
+      " * allocations).  Pass as upb_ArenaPolicy.initial_block_size to\n"
+      " * upb_Arena_NewWithPolicy() to avoid block chaining on typical\n"
+      " * payloads. */\n"
+      "#define $0_kArenaHint \\\n"
+      "  ($1 * sizeof(upb_Message_Internal) + $2)\n\n",
+      msg_name, internal_count,
+      ArchDependentSize(pools.GetMiniTable32(message)->size + extra32,
+                        pools.GetMiniTable64(message)->size + extra64));
+}
+
+// Emits Foo_Columns and Foo_extract(): a struct holding every non-repeated
+// scalar/string field of Foo, and one call that fills it in ascending field
+// offset order.  Bulk extraction of several fields then compiles to a single
+// forward sweep through the message instead of one random hop per accessor.
+void GenerateColumnsExtract(upb::MessageDefPtr message,
+                            const DefPoolPair& pools,
+                            absl::string_view msg_name,
+                            const NameToFieldDefMap& field_names,
+                            Output& output) {
+  std::vector<upb::FieldDefPtr> columns;
+  for (int i = 0; i < message.field_count(); i++) {
+    upb::FieldDefPtr field = message.field(i);
+    if (field.IsSequence() || field.IsMap() ||
+        field.ctype() == kUpb_CType_Message) {
+      continue;
+    }
+    columns.push_back(field);
+  }
+  if (columns.empty()) return;
+  std::sort(columns.begin(), columns.end(),
+            [&](upb::FieldDefPtr a, upb::FieldDefPtr b) {
+              return pools.GetField64(a)->offset < pools.GetField64(b)->offset;
+            });
+  output(
+      "/* Struct-of-fields view of $0 for bulk extraction; members are in\n"
+      " * field offset order.  Unset fields read as their defaults. */\n",
+      message.full_name());
+  output("typedef struct {\n");
+  for (auto field : columns) {
+    output("  $0 $1;\n", CType(field), ResolveFieldName(field, field_names));
+  }
+  output("} $0_Columns;\n\n", msg_name);
+  output("UPB_INLINE void $0_extract(const $0* msg, $0_Columns* out) {\n",
+         msg_name);
+  for (auto field : columns) {
+    std::string resolved_name = ResolveFieldName(field, field_names);
+    output("  out->$0 = $1_$0(msg);\n", resolved_name, msg_name);
+  }
+  output("}\n\n");
+}
+
 void GenerateMessageInHeader(upb::MessageDefPtr message,
                              const DefPoolPair& pools, const Options& options,
                              Output& output) {
@@ -804,6 +1350,17 @@ void GenerateMessageInHeader(upb::MessageDefPtr message,
   std::string msg_name = ToCIdent(message.full_name());
   if (!UPB_DESC(MessageOptions_map_entry)(message.options())) {
     GenerateMessageFunctionsInHeader(message, options, output);
+    if (!options.bootstrap) {
+      GenerateDefaultInstanceInHeader(message, pools, msg_name, output);
+      GenerateArenaHint(message, pools, msg_name, output);
+      if (FieldIndexCount(pools, message) > 0) {
+        output(
+            "/* Dense field-number index for $0; use with\n"
+            " * upb_Message_GetByNumberFast(). */\n"
+            "extern const upb_FieldIndex $1_field_index;\n\n",
+            message.full_name(), msg_name);
+      }
+    }
   }
 
   for (int i = 0; i < message.real_oneof_count(); i++) {
@@ -823,6 +1380,16 @@ void GenerateMessageInHeader(upb::MessageDefPtr message,
     GenerateSetters(field, pools, msg_name, field_names, options, output);
   }
 
+  if (!options.bootstrap &&
+      !UPB_DESC(MessageOptions_map_entry)(message.options())) {
+    GenerateColumnsExtract(message, pools, msg_name, field_names, output);
+  }
+
+  if (HasInlineParse(message, options)) {
+    GenerateInlineParse(message, field_names, msg_name, output);
+    GenerateInlineSerialize(message, field_names, msg_name, output);
+  }
+
   output("\n");
 }
 
@@ -1044,7 +1611,63 @@ int GetTableSlot(upb::FieldDefPtr field) {
     // Tag must fit within a two-byte varint.
     return -1;
   }
-  return (tag & 0xf8) >> 3;
+  // The slot is selected by tag bits 3..10: the high five bits of the first
+  // tag byte plus the low three bits of the second. With the 16-bit table
+  // mask this gives two-byte tags distinct slots in tables of up to 256
+  // entries, instead of folding every high field number into slots 16-31.
+  return (tag & 0x7f8) >> 3;
+}
+
+// Returns true if this map entry key or value type can be parsed by the
+// upb_pmm_* fast functions. Message/group values and closed enums require the
+// generic path (the latter because the parser must check the value against the
+// enum table).
+bool IsFastMapEntryType(const upb_MiniTableField* f) {
+  switch (f->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Bool:
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_UInt32:
+    case kUpb_FieldType_Int64:
+    case kUpb_FieldType_UInt64:
+    case kUpb_FieldType_SInt32:
+    case kUpb_FieldType_SInt64:
+    case kUpb_FieldType_Fixed32:
+    case kUpb_FieldType_SFixed32:
+    case kUpb_FieldType_Float:
+    case kUpb_FieldType_Fixed64:
+    case kUpb_FieldType_SFixed64:
+    case kUpb_FieldType_Double:
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool TryFillMapEntry(const DefPoolPair& pools, upb::FieldDefPtr field,
+                     TableEntry& ent) {
+  const upb_MiniTable* mt = pools.GetMiniTable64(field.containing_type());
+  const upb_MiniTableField* mt_f =
+      upb_MiniTable_FindFieldByNumber(mt, field.number());
+  const upb_MiniTable* entry = pools.GetMiniTable64(field.message_type());
+  if (!IsFastMapEntryType(&entry->fields[0]) ||
+      !IsFastMapEntryType(&entry->fields[1])) {
+    return false;
+  }
+
+  uint64_t idx = mt_f->UPB_PRIVATE(submsg_index);
+  if (idx > 255) return false;
+
+  uint64_t expected_tag = GetEncodedTag(field);
+  uint64_t data = static_cast<uint64_t>(mt_f->offset) << 48 |
+                  (uint64_t{63} << 24) |  // No hasbit.
+                  idx << 16 | expected_tag;
+
+  ent.first =
+      absl::Substitute("upb_pmm_$0bt", expected_tag > 0xff ? "2" : "1");
+  ent.second = data;
+  return true;
 }
 
 bool TryFillTableEntry(const DefPoolPair& pools, upb::FieldDefPtr field,
@@ -1052,16 +1675,23 @@ bool TryFillTableEntry(const DefPoolPair& pools, upb::FieldDefPtr field,
   const upb_MiniTable* mt = pools.GetMiniTable64(field.containing_type());
   const upb_MiniTableField* mt_f =
       upb_MiniTable_FindFieldByNumber(mt, field.number());
+  if (upb_FieldMode_Get(mt_f) == kUpb_FieldMode_Map) {
+    return TryFillMapEntry(pools, field, ent);
+  }
   std::string type = "";
   std::string cardinality = "";
+  bool closed_enum = false;
   switch (upb_MiniTableField_Type(mt_f)) {
     case kUpb_FieldType_Bool:
       type = "b1";
       break;
     case kUpb_FieldType_Enum:
       if (upb_MiniTableField_IsClosedEnum(mt_f)) {
-        // We don't have the means to test proto2 enum fields for valid values.
-        return false;
+        // The upb_p*e4_* parsers validate against the enum table, whose
+        // sub-table index we stash in the data word below.
+        closed_enum = true;
+        type = "e4";
+        break;
       }
       [[fallthrough]];
     case kUpb_FieldType_Int32:
@@ -1103,7 +1733,7 @@ bool TryFillTableEntry(const DefPoolPair& pools, upb::FieldDefPtr field,
 
   switch (upb_FieldMode_Get(mt_f)) {
     case kUpb_FieldMode_Map:
-      return false;  // Not supported yet (ever?).
+      UPB_UNREACHABLE();  // Handled above.
     case kUpb_FieldMode_Array:
       if (mt_f->mode & kUpb_LabelFlags_IsPacked) {
         cardinality = "p";
@@ -1150,6 +1780,15 @@ bool TryFillTableEntry(const DefPoolPair& pools, upb::FieldDefPtr field,
     data |= hasbit_index << 24;
   }
 
+  if (closed_enum) {
+    // Packed closed enums stay on the generic path, which batch-validates
+    // whole runs off the enum bitmask.
+    if (cardinality == "p") return false;
+    uint64_t idx = mt_f->UPB_PRIVATE(submsg_index);
+    if (idx > 255) return false;
+    data |= idx << 16;
+  }
+
   if (field.ctype() == kUpb_CType_Message) {
     uint64_t idx = mt_f->UPB_PRIVATE(submsg_index);
     if (idx > 255) return false;
@@ -1334,6 +1973,140 @@ std::string GetSub(upb::FieldDefPtr field) {
   return std::string("{.submsg = NULL}");
 }
 
+// A message qualifies for a generated straight-line encoder when every field
+// can be emitted with a single encode_fast.h helper call: non-oneof scalar or
+// string/bytes fields only.  Repeated/map/submessage fields and extendable
+// messages fall back to the interpretive walk in encode_message().
+bool QualifiesForFastEncode(const upb_MiniTable* mt_32,
+                            const upb_MiniTable* mt_64) {
+  if (mt_64->ext != kUpb_ExtMode_NonExtendable) return false;
+  if (mt_64->field_count == 0) return false;
+  for (int i = 0; i < mt_64->field_count; i++) {
+    const upb_MiniTableField* f64 = &mt_64->fields[i];
+    const upb_MiniTableField* f32 = &mt_32->fields[i];
+    if ((f64->mode & kUpb_FieldMode_Mask) != kUpb_FieldMode_Scalar) {
+      return false;
+    }
+    if (f64->presence < 0 || f64->presence != f32->presence) return false;
+    switch (f64->UPB_PRIVATE(descriptortype)) {
+      case kUpb_FieldType_Message:
+      case kUpb_FieldType_Group:
+        return false;
+      default:
+        break;
+    }
+  }
+  return true;
+}
+
+// Emits the straight-line encode of one field.  The encoder writes
+// back-to-front, so the caller feeds us fields in descending field-number
+// order.  Values are read raw (fixed-width fields as uintN bits) so that the
+// implicit-presence `!= 0` checks match encode_shouldencode() exactly.
+void WriteFastEncodeField(const upb_MiniTableField* f64,
+                          const upb_MiniTableField* f32, Output& output) {
+  const std::string ofs = ArchDependentSize(f32->offset, f64->offset);
+  std::string ctype;
+  std::string helper;
+  std::string val_expr = "val";
+  int wire_type;
+  switch (f64->UPB_PRIVATE(descriptortype)) {
+    case kUpb_FieldType_Double:
+    case kUpb_FieldType_Fixed64:
+    case kUpb_FieldType_SFixed64:
+      ctype = "uint64_t";
+      helper = "_upb_Encoder_FastFixed64";
+      wire_type = kUpb_WireType_64Bit;
+      break;
+    case kUpb_FieldType_Float:
+    case kUpb_FieldType_Fixed32:
+    case kUpb_FieldType_SFixed32:
+      ctype = "uint32_t";
+      helper = "_upb_Encoder_FastFixed32";
+      wire_type = kUpb_WireType_32Bit;
+      break;
+    case kUpb_FieldType_Int64:
+    case kUpb_FieldType_UInt64:
+      ctype = "uint64_t";
+      helper = "_upb_Encoder_FastVarint";
+      wire_type = kUpb_WireType_Varint;
+      break;
+    case kUpb_FieldType_Int32:
+    case kUpb_FieldType_Enum:
+      ctype = "int32_t";
+      helper = "_upb_Encoder_FastVarint";
+      val_expr = "(uint64_t)(int64_t)val";
+      wire_type = kUpb_WireType_Varint;
+      break;
+    case kUpb_FieldType_UInt32:
+      ctype = "uint32_t";
+      helper = "_upb_Encoder_FastVarint";
+      wire_type = kUpb_WireType_Varint;
+      break;
+    case kUpb_FieldType_Bool:
+      ctype = "bool";
+      helper = "_upb_Encoder_FastVarint";
+      wire_type = kUpb_WireType_Varint;
+      break;
+    case kUpb_FieldType_SInt32:
+      ctype = "int32_t";
+      helper = "_upb_Encoder_FastVarint";
+      val_expr = "((uint32_t)val << 1) ^ (uint32_t)(val >> 31)";
+      wire_type = kUpb_WireType_Varint;
+      break;
+    case kUpb_FieldType_SInt64:
+      ctype = "int64_t";
+      helper = "_upb_Encoder_FastVarint";
+      val_expr = "((uint64_t)val << 1) ^ (uint64_t)(val >> 63)";
+      wire_type = kUpb_WireType_Varint;
+      break;
+    case kUpb_FieldType_String:
+    case kUpb_FieldType_Bytes:
+      ctype = "upb_StringView";
+      helper = "_upb_Encoder_FastString";
+      wire_type = kUpb_WireType_Delimited;
+      break;
+    default:
+      ABSL_CHECK(false);  // Excluded by QualifiesForFastEncode().
+      return;
+  }
+  std::string cond;
+  if (f64->presence > 0) {
+    cond = absl::Substitute("_upb_hasbit(msg, $0)", f64->presence);
+  } else if (ctype == "upb_StringView") {
+    cond = "val.size != 0";
+  } else if (ctype == "bool") {
+    cond = "val";
+  } else {
+    cond = "val != 0";
+  }
+  const uint32_t tag = (f64->number << 3) | wire_type;
+  output(
+      "  {\n"
+      "    $0 val = *UPB_PTR_AT(msg, $1, $0);\n"
+      "    if ($2) $3(e, $4, $5);\n"
+      "  }\n",
+      ctype, ofs, cond, helper, val_expr, tag);
+}
+
+void WriteFastEncoder(const std::string& msg_name, const upb_MiniTable* mt_32,
+                      const upb_MiniTable* mt_64, Output& output) {
+  output(
+      "static void $0_fast_encode(struct upb_Encoder* e, const upb_Message* "
+      "msg, const upb_MiniTable* m) {\n"
+      "  (void)m;\n",
+      msg_name);
+  std::vector<int> indexes(mt_64->field_count);
+  for (int i = 0; i < mt_64->field_count; i++) indexes[i] = i;
+  std::sort(indexes.begin(), indexes.end(), [mt_64](int a, int b) {
+    return mt_64->fields[a].number > mt_64->fields[b].number;
+  });
+  for (int i : indexes) {
+    WriteFastEncodeField(&mt_64->fields[i], &mt_32->fields[i], output);
+  }
+  output("}\n\n");
+}
+
 // Writes a single message into a .upb.c source file.
 void WriteMessage(upb::MessageDefPtr message, const DefPoolPair& pools,
                   const Options& options, Output& output) {
@@ -1382,8 +2155,39 @@ void WriteMessage(upb::MessageDefPtr message, const DefPoolPair& pools,
     output("};\n\n");
   }
 
+  if (!UPB_DESC(MessageOptions_map_entry)(message.options())) {
+    // Dense field-number -> field index for the low-number range, so
+    // dynamic access by number is one array load (see
+    // upb_Message_GetByNumberFast()).
+    const uint32_t index_count = FieldIndexCount(pools, message);
+    if (index_count > 0) {
+      std::vector<int> slot(index_count, -1);
+      for (int i = 0; i < mt_64->field_count; i++) {
+        const uint32_t number = mt_64->fields[i].number;
+        if (number <= index_count) slot[number - 1] = i;
+      }
+      output("static const upb_MiniTableField $0__field_index_entries[$1] = {\n",
+             msg_name, index_count);
+      for (uint32_t n = 1; n <= index_count; n++) {
+        const int i = slot[n - 1];
+        if (i < 0) {
+          output("  {0, 0, 0, kUpb_NoSub, 0, 0},\n");
+        } else {
+          WriteMessageField(message.FindFieldByNumber(n), &mt_64->fields[i],
+                            &mt_32->fields[i], options, output);
+        }
+      }
+      output("};\n\n");
+      output(
+          "const upb_FieldIndex $0_field_index = {\n"
+          "  &$0__field_index_entries[0], $1,\n"
+          "};\n\n",
+          msg_name, index_count);
+    }
+  }
+
   std::vector<TableEntry> table;
-  uint8_t table_mask = -1;
+  uint16_t table_mask = -1;
 
   table = FastDecodeTable(message, pools);
 
@@ -1402,12 +2206,19 @@ void WriteMessage(upb::MessageDefPtr message, const DefPoolPair& pools,
     }
   }
 
+  std::string fast_encode_ref = "NULL";
+  if (QualifiesForFastEncode(mt_32, mt_64)) {
+    fast_encode_ref = msg_name + "_fast_encode";
+    WriteFastEncoder(msg_name, mt_32, mt_64, output);
+  }
+
   output("const upb_MiniTable $0 = {\n", MessageInitName(message));
   output("  $0,\n", submsgs_array_ref);
   output("  $0,\n", fields_array_ref);
-  output("  $0, $1, $2, $3, UPB_FASTTABLE_MASK($4), $5,\n",
+  output("  $0, $1, $2, $3, UPB_FASTTABLE_MASK($4), $5, $6,\n",
          ArchDependentSize(mt_32->size, mt_64->size), mt_64->field_count,
-         msgext, mt_64->dense_below, table_mask, mt_64->required_count);
+         msgext, mt_64->dense_below, table_mask, mt_64->required_count,
+         fast_encode_ref);
   if (!table.empty()) {
     output("  UPB_FASTTABLE_INIT({\n");
     for (const auto& ent : table) {
@@ -1417,6 +2228,13 @@ void WriteMessage(upb::MessageDefPtr message, const DefPoolPair& pools,
     output("  })\n");
   }
   output("};\n\n");
+
+  if (!UPB_DESC(MessageOptions_map_entry)(message.options())) {
+    output(
+        "const struct $0_default_instance_s $0_default_instance_storage = "
+        "{{NULL}, {{0}}};\n\n",
+        msg_name);
+  }
 }
 
 void WriteEnum(upb::EnumDefPtr e, Output& output) {
@@ -1666,21 +2484,245 @@ void WriteSource(const DefPoolPair& pools, upb::FileDefPtr file,
   }
 }
 
+// The `textnames` option: a compact (field number -> name) sidecar for
+// upb_TextEncodeMiniTable(), emitted as its own translation unit so that
+// reflection-free binaries only link the tables they reference.  Map-entry
+// messages get no table; the encoder prints "key"/"value" itself.
+
+void WriteTextNamesHeader(upb::FileDefPtr file, Output& output) {
+  EmitFileWarning(file.name(), output);
+  output(
+      "#ifndef $0_UPB_TEXTNAMES_H_\n"
+      "#define $0_UPB_TEXTNAMES_H_\n\n"
+      "#include \"upb/text/encode_minitable.h\"\n"
+      "\n"
+      "#ifdef __cplusplus\n"
+      "extern \"C\" {\n"
+      "#endif\n"
+      "\n",
+      ToPreproc(file.name()));
+
+  for (auto message : SortedMessages(file)) {
+    if (message.mapentry()) continue;
+    output("extern const upb_TextNames $0;\n", TextNamesSymbol(message));
+  }
+
+  output(
+      "\n"
+      "#ifdef __cplusplus\n"
+      "}  /* extern \"C\" */\n"
+      "#endif\n"
+      "\n"
+      "#endif  /* $0_UPB_TEXTNAMES_H_ */\n",
+      ToPreproc(file.name()));
+}
+
+// Returns the initializer for a field's `sub` link: the names table of the
+// sub-message (for map fields, of the value message), or NULL.
+std::string TextNamesSubRef(upb::FieldDefPtr field) {
+  if (field.IsMap()) {
+    upb::FieldDefPtr value = field.message_type().map_value();
+    if (value.ctype() != kUpb_CType_Message) return "NULL";
+    return absl::StrCat("&", TextNamesSymbol(value.message_type()));
+  }
+  if (field.ctype() != kUpb_CType_Message) return "NULL";
+  return absl::StrCat("&", TextNamesSymbol(field.message_type()));
+}
+
+void WriteTextNamesSource(upb::FileDefPtr file, Output& output) {
+  EmitFileWarning(file.name(), output);
+  output("#include \"$0\"\n", TextNamesHeaderFilename(file));
+  for (int i = 0; i < file.dependency_count(); i++) {
+    output("#include \"$0\"\n", TextNamesHeaderFilename(file.dependency(i)));
+  }
+  output("\n");
+
+  for (auto message : SortedMessages(file)) {
+    if (message.mapentry()) continue;
+    const std::vector<upb::FieldDefPtr> fields = FieldNumberOrder(message);
+    if (fields.empty()) {
+      output("const upb_TextNames $0 = {0, NULL};\n\n",
+             TextNamesSymbol(message));
+      continue;
+    }
+    output("static const upb_TextNamesField $0__fields[$1] = {\n",
+           TextNamesSymbol(message), fields.size());
+    for (auto field : fields) {
+      output("  {$0, \"$1\", $2},\n", field.number(), field.name(),
+             TextNamesSubRef(field));
+    }
+    output("};\n");
+    output("const upb_TextNames $0 = {$1, $0__fields};\n\n",
+           TextNamesSymbol(message), fields.size());
+  }
+}
+
+void GenerateFileInto(const DefPoolPair& pools, upb::FileDefPtr file,
+                      const Options& options, Output& h_output,
+                      Output& c_output) {
+  WriteHeader(pools, file, options, h_output);
+  WriteSource(pools, file, options, c_output);
+}
+
 void GenerateFile(const DefPoolPair& pools, upb::FileDefPtr file,
                   const Options& options, Plugin* plugin) {
   Output h_output;
-  WriteHeader(pools, file, options, h_output);
-  plugin->AddOutputFile(HeaderFilename(file), h_output.output());
-
   Output c_output;
-  WriteSource(pools, file, options, c_output);
+  GenerateFileInto(pools, file, options, h_output, c_output);
+  plugin->AddOutputFile(HeaderFilename(file), h_output.output());
   plugin->AddOutputFile(SourceFilename(file), c_output.output());
+
+  if (options.textnames) {
+    Output names_h_output;
+    Output names_c_output;
+    WriteTextNamesHeader(file, names_h_output);
+    WriteTextNamesSource(file, names_c_output);
+    plugin->AddOutputFile(TextNamesHeaderFilename(file),
+                          names_h_output.output());
+    plugin->AddOutputFile(TextNamesSourceFilename(file),
+                          names_c_output.output());
+  }
+}
+
+absl::string_view ToStringView(upb_StringView str);
+
+// Drops non-allowlisted fields from |msg| and its nested messages, along
+// with any oneof declarations left with no fields (including the synthetic
+// oneofs of removed proto3 optional fields, which the def builder rejects if
+// left dangling).  Required fields are always kept, since dropping one would
+// make every instance of the message fail its required-field check.
+void PruneMessageForAllowlist(UPB_DESC(DescriptorProto) * msg,
+                              absl::string_view scope, const Options& options,
+                              upb_Arena* arena) {
+  const std::string full_name = absl::StrCat(
+      scope, scope.empty() ? "" : ".",
+      ToStringView(UPB_DESC(DescriptorProto_name)(msg)));
+
+  const auto it = options.allowlist.find(full_name);
+  if (it != options.allowlist.end()) {
+    const absl::flat_hash_set<std::string>& keep = it->second;
+
+    size_t oneof_count;
+    UPB_DESC(OneofDescriptorProto)** oneofs =
+        UPB_DESC(DescriptorProto_mutable_oneof_decl)(msg, &oneof_count);
+    std::vector<bool> oneof_used(oneof_count, false);
+
+    size_t field_count;
+    UPB_DESC(FieldDescriptorProto)** fields =
+        UPB_DESC(DescriptorProto_mutable_field)(msg, &field_count);
+    size_t fields_kept = 0;
+    for (size_t i = 0; i < field_count; i++) {
+      UPB_DESC(FieldDescriptorProto)* field = fields[i];
+      const bool required = UPB_DESC(FieldDescriptorProto_label)(field) ==
+                            kUpb_Label_Required;
+      if (!required &&
+          !keep.contains(
+              ToStringView(UPB_DESC(FieldDescriptorProto_name)(field)))) {
+        continue;
+      }
+      if (UPB_DESC(FieldDescriptorProto_has_oneof_index)(field)) {
+        oneof_used[UPB_DESC(FieldDescriptorProto_oneof_index)(field)] = true;
+      }
+      fields[fields_kept++] = field;
+    }
+    UPB_DESC(DescriptorProto_resize_field)(msg, fields_kept, arena);
+
+    // Compact the surviving oneof declarations and remap field indices.
+    std::vector<int32_t> remap(oneof_count, -1);
+    size_t oneofs_kept = 0;
+    for (size_t i = 0; i < oneof_count; i++) {
+      if (!oneof_used[i]) continue;
+      remap[i] = static_cast<int32_t>(oneofs_kept);
+      oneofs[oneofs_kept++] = oneofs[i];
+    }
+    UPB_DESC(DescriptorProto_resize_oneof_decl)(msg, oneofs_kept, arena);
+    fields = UPB_DESC(DescriptorProto_mutable_field)(msg, &field_count);
+    for (size_t i = 0; i < field_count; i++) {
+      if (UPB_DESC(FieldDescriptorProto_has_oneof_index)(fields[i])) {
+        UPB_DESC(FieldDescriptorProto_set_oneof_index)
+        (fields[i], remap[UPB_DESC(FieldDescriptorProto_oneof_index)(
+            fields[i])]);
+      }
+    }
+  }
+
+  size_t nested_count;
+  UPB_DESC(DescriptorProto)** nested =
+      UPB_DESC(DescriptorProto_mutable_nested_type)(msg, &nested_count);
+  for (size_t i = 0; i < nested_count; i++) {
+    PruneMessageForAllowlist(nested[i], full_name, options, arena);
+  }
+}
+
+// Returns a copy of |file| with non-allowlisted fields removed.  The input
+// is immutable, so round-trip through the wire format to get a mutable copy
+// on |arena|, which must outlive the returned proto.
+const UPB_DESC(FileDescriptorProto) *
+    PruneFileForAllowlist(const UPB_DESC(FileDescriptorProto) * file,
+                          const Options& options, upb_Arena* arena) {
+  size_t size;
+  char* buf = UPB_DESC(FileDescriptorProto_serialize)(file, arena, &size);
+  ABSL_CHECK(buf);
+  UPB_DESC(FileDescriptorProto)* copy =
+      UPB_DESC(FileDescriptorProto_parse)(buf, size, arena);
+  ABSL_CHECK(copy);
+
+  const std::string package(
+      ToStringView(UPB_DESC(FileDescriptorProto_package)(copy)));
+  size_t message_count;
+  UPB_DESC(DescriptorProto)** messages =
+      UPB_DESC(FileDescriptorProto_mutable_message_type)(copy, &message_count);
+  for (size_t i = 0; i < message_count; i++) {
+    PruneMessageForAllowlist(messages[i], package, options, arena);
+  }
+  return copy;
+}
+
+// Loads a tree-shaking allowlist: one `full.message.Name.field_name` entry
+// per line; blank lines and lines starting with '#' are ignored.  Such a
+// list is typically derived from linker gc-sections output or a field
+// access profile.
+bool ReadFieldAllowlist(const std::string& path, Options* options,
+                        Plugin* plugin) {
+  std::ifstream in(path);
+  if (!in) {
+    plugin->SetError(
+        absl::Substitute("Can't read field_allowlist file: $0", path));
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    absl::string_view entry = absl::StripAsciiWhitespace(line);
+    if (entry.empty() || entry[0] == '#') continue;
+    const size_t dot = entry.rfind('.');
+    if (dot == absl::string_view::npos || dot == 0 ||
+        dot + 1 == entry.size()) {
+      plugin->SetError(
+          absl::Substitute("Bad field_allowlist entry: $0", entry));
+      return false;
+    }
+    options->allowlist[std::string(entry.substr(0, dot))].insert(
+        std::string(entry.substr(dot + 1)));
+  }
+  return true;
 }
 
 bool ParseOptions(Plugin* plugin, Options* options) {
   for (const auto& pair : ParseGeneratorParameter(plugin->parameter())) {
     if (pair.first == "bootstrap_upb") {
       options->bootstrap = true;
+    } else if (pair.first == "inline_parse") {
+      options->inline_parse_max_fields = 4;  // Default threshold.
+      if (!pair.second.empty() &&
+          !absl::SimpleAtoi(pair.second, &options->inline_parse_max_fields)) {
+        plugin->SetError(
+            absl::Substitute("Bad inline_parse value: $0", pair.second));
+        return false;
+      }
+    } else if (pair.first == "field_allowlist") {
+      if (!ReadFieldAllowlist(pair.second, options, plugin)) return false;
+    } else if (pair.first == "textnames") {
+      options->textnames = true;
     } else {
       plugin->SetError(absl::Substitute("Unknown parameter: $0", pair.first));
       return false;
@@ -1703,9 +2745,19 @@ int main(int argc, char** argv) {
   upbc::Plugin plugin;
   upbc::Options options;
   if (!ParseOptions(&plugin, &options)) return 0;
+  upb::Arena prune_arena;  // Owns the pruned copies of the file protos.
+
+  // Pass 1: build the defs.  The request lists files in dependency order,
+  // so this must stay sequential.
+  std::vector<upb::FileDefPtr> to_generate;
+  const unsigned thread_count = std::thread::hardware_concurrency();
   plugin.GenerateFilesRaw([&](const UPB_DESC(FileDescriptorProto) * file_proto,
                               bool generate) {
     upb::Status status;
+    if (!options.allowlist.empty()) {
+      file_proto = upbc::PruneFileForAllowlist(file_proto, options,
+                                               prune_arena.ptr());
+    }
     upb::FileDefPtr file = pools.AddFile(file_proto, &status);
     if (!file) {
       absl::string_view name =
@@ -1713,7 +2765,41 @@ int main(int argc, char** argv) {
       ABSL_LOG(FATAL) << "Couldn't add file " << name
                       << " to DefPool: " << status.error_message();
     }
-    if (generate) GenerateFile(pools, file, options, &plugin);
+    if (generate) to_generate.push_back(file);
   });
+
+  if (to_generate.size() <= 1 || thread_count <= 1) {
+    for (upb::FileDefPtr file : to_generate) {
+      GenerateFile(pools, file, options, &plugin);
+    }
+    return 0;
+  }
+
+  // Files are independent once the defs are built, so generate them
+  // concurrently; only building the response below must be single-threaded.
+  std::vector<std::pair<upbc::Output, upbc::Output>> outputs(
+      to_generate.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  const size_t worker_count = std::min<size_t>(thread_count,
+                                               to_generate.size());
+  workers.reserve(worker_count);
+  for (size_t i = 0; i < worker_count; i++) {
+    workers.emplace_back([&] {
+      size_t index;
+      while ((index = next.fetch_add(1)) < to_generate.size()) {
+        upbc::GenerateFileInto(pools, to_generate[index], options,
+                               outputs[index].first, outputs[index].second);
+      }
+    });
+  }
+  for (std::thread& worker : workers) worker.join();
+
+  for (size_t i = 0; i < to_generate.size(); i++) {
+    plugin.AddOutputFile(upbc::HeaderFilename(to_generate[i]),
+                         outputs[i].first.output());
+    plugin.AddOutputFile(upbc::SourceFilename(to_generate[i]),
+                         outputs[i].second.output());
+  }
   return 0;
 }